@@ -0,0 +1,154 @@
+#include "../include/shell/shell.h"
+#include "../include/video/vga.h"
+#include "../include/block/bcache.h"
+#include "../include/lib/string.h"
+#include "../include/lib/math64.h"
+
+#define SCAN_BLOCK_SIZE   4096
+#define SCAN_DEFAULT      1024
+
+static void cachestat_usage(void) {
+    vga_puts("Usage: cachestat                          Show block cache statistics\n");
+    vga_puts("       cachestat reset                    Clear the counters\n");
+    vga_puts("       cachestat sync                     Write back dirty buffers\n");
+    vga_puts("       cachestat scan <dev> [n] [random]  Read n 4K blocks through the cache\n");
+}
+
+static void print_label(const char* label) {
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts("  ");
+    vga_puts(label);
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+}
+
+static void print_percent(uint32_t part, uint32_t whole) {
+    vga_set_color(VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK);
+    vga_puts(" (");
+    vga_putdec(whole ? part * 100 / whole : 0, 0);
+    vga_puts("%)");
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+}
+
+static void cachestat_show(void) {
+    bcache_stats_t st;
+    bcache_get_stats(&st);
+
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLUE);
+    vga_puts(" BLOCK CACHE ");
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    vga_putchar('\n');
+
+    print_label("Buffers:    ");
+    vga_putdec(st.buffers, 0);
+    vga_puts(", ");
+    vga_putdec(st.bytes / 1024, 0);
+    vga_puts(" KB of ");
+    vga_putdec(st.budget / 1024, 0);
+    vga_puts(" KB, ");
+    vga_putdec(st.dirty, 0);
+    vga_puts(" dirty\n");
+
+    print_label("Lookups:    ");
+    vga_putdec(st.lookups, 0);
+    vga_puts("  hits ");
+    vga_putdec(st.hits, 0);
+    print_percent(st.hits, st.lookups);
+    vga_puts("  misses ");
+    vga_putdec(st.misses, 0);
+    vga_putchar('\n');
+
+    print_label("Read-ahead: ");
+    vga_putdec(st.ra_blocks, 0);
+    vga_puts(" blocks, used ");
+    vga_putdec(st.ra_used, 0);
+    print_percent(st.ra_used, st.ra_blocks);
+    vga_puts(", wasted ");
+    vga_putdec(st.ra_wasted, 0);
+    vga_putchar('\n');
+
+    print_label("Evictions:  ");
+    vga_putdec(st.evictions, 0);
+    vga_puts("  write-backs ");
+    vga_putdec(st.writebacks, 0);
+    vga_putchar('\n');
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+}
+
+// Read blocks through the cache so read-ahead behaviour can be observed
+static int cachestat_scan(blkdev_t* dev, uint32_t count, bool random) {
+    uint64_t blocks = div_u64(dev->sectors, SCAN_BLOCK_SIZE / BLK_SECTOR_SIZE);
+    uint32_t state = 2463534242u;
+
+    if (blocks == 0) return 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t block = i;
+        if (random) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            block = state;
+        }
+        buffer_t* buf;
+        uint32_t rem;
+        div_u64_rem(block, (uint32_t)blocks, &rem);
+        int err = bcache_read(dev, rem, SCAN_BLOCK_SIZE, &buf);
+        if (err) return err;
+        bcache_release(buf);
+    }
+    return 0;
+}
+
+void cachestat_command(const char *args) {
+    if (args == NULL || *args == '\0') {
+        cachestat_show();
+        last_exit_status = 0;
+        return;
+    }
+
+    char *arg = strtok((char *)args, " ");
+    if (strcmp(arg, "reset") == 0) {
+        bcache_reset_stats();
+        last_exit_status = 0;
+        return;
+    }
+    if (strcmp(arg, "sync") == 0) {
+        int err = bcache_sync(NULL);
+        if (err) vga_puts("cachestat: write-back failed\n");
+        last_exit_status = err ? 1 : 0;
+        return;
+    }
+    if (strcmp(arg, "scan") != 0) {
+        cachestat_usage();
+        last_exit_status = 1;
+        return;
+    }
+
+    char *name = strtok(NULL, " ");
+    blkdev_t* dev = name ? blkdev_find(name) : NULL;
+    if (!dev) {
+        vga_puts("cachestat: no such block device\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    uint32_t count = SCAN_DEFAULT;
+    bool random = false;
+    while ((arg = strtok(NULL, " ")) != NULL) {
+        if (strcmp(arg, "random") == 0) {
+            random = true;
+        } else if (*arg >= '0' && *arg <= '9') {
+            count = 0;
+            while (*arg >= '0' && *arg <= '9') count = count * 10 + (*arg++ - '0');
+        }
+    }
+
+    if (cachestat_scan(dev, count, random) != 0) {
+        vga_puts("cachestat: read error on ");
+        vga_puts(dev->name);
+        vga_putchar('\n');
+        last_exit_status = 1;
+        return;
+    }
+    cachestat_show();
+    last_exit_status = 0;
+}
@@ -0,0 +1,241 @@
+#include "../include/shell/shell.h"
+#include "../include/shell/cmdutil.h"
+#include "../include/video/vga.h"
+#include "../include/kernel/perf/callgraph.h"
+#include "../include/kernel/panic/ksym.h"
+#include "../include/kernel/time/clocksource.h"
+#include "../include/mm/kmalloc.h"
+#include "../include/lib/string.h"
+#include "../include/lib/math64.h"
+#include "../include/lib/errno.h"
+
+// callgraph start | stop | report [n] | run <command> [args]
+//
+// The report replays the recorded calls and returns on a shadow stack.
+// A function's exclusive time is what it spent outside its callees; its
+// inclusive time counts only the outermost of any recursive activations,
+// so recursion is not counted twice. Returns with no matching call
+// (functions already running when recording started) are skipped, and
+// calls still open at the end are closed at the last event. Times
+// include the hooks' own overhead.
+#define CALLGRAPH_REPORT_DEFAULT 20
+#define CALLGRAPH_REPORT_MAX     200
+#define CALLGRAPH_MAX_DEPTH      512
+
+typedef struct {
+    uint32_t calls;
+    uint32_t active;              // Activations on the shadow stack
+    uint64_t inclusive;           // Cycles
+    uint64_t exclusive;
+} fn_stats_t;
+
+typedef struct {
+    int index;                    // Symbol index, -1 outside the table
+    uint64_t start;
+    uint64_t children;            // Cycles spent in callees
+} shadow_frame_t;
+
+// Cycles to microseconds, or left as cycles when the rate is unknown
+static uint64_t to_us(uint64_t cycles, uint32_t tsc_khz) {
+    return tsc_khz ? div_u64(cycles * 1000, tsc_khz) : cycles;
+}
+
+static void close_frame(fn_stats_t* stats, shadow_frame_t* stack, uint32_t depth, uint64_t tsc) {
+    shadow_frame_t* f = &stack[depth - 1];
+    uint64_t elapsed = tsc - f->start;
+
+    if (f->index >= 0) {
+        fn_stats_t* s = &stats[f->index];
+        s->exclusive += elapsed - f->children;
+        if (--s->active == 0) s->inclusive += elapsed;
+    }
+    if (depth > 1) stack[depth - 2].children += elapsed;
+}
+
+// Replay the events into per-symbol stats; -E2BIG if calls nest deeper
+// than the shadow stack
+static int replay(const callgraph_event_t* events, uint32_t count, fn_stats_t* stats) {
+    shadow_frame_t* stack = kmalloc(CALLGRAPH_MAX_DEPTH * sizeof(shadow_frame_t));
+    uint32_t depth = 0;
+    if (!stack) return -ENOMEM;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const callgraph_event_t* e = &events[i];
+        int index = ksym_index(e->fn);
+
+        if (e->kind == CALLGRAPH_ENTER) {
+            if (depth == CALLGRAPH_MAX_DEPTH) {
+                kfree(stack);
+                return -E2BIG;
+            }
+            stack[depth].index = index;
+            stack[depth].start = e->tsc;
+            stack[depth].children = 0;
+            depth++;
+            if (index >= 0) {
+                stats[index].calls++;
+                stats[index].active++;
+            }
+            continue;
+        }
+
+        // Find the matching call; frames above it were left without a
+        // return of their own
+        uint32_t match = depth;
+        while (match > 0 && stack[match - 1].index != index) match--;
+        if (match == 0) continue;
+        while (depth >= match) close_frame(stats, stack, depth--, e->tsc);
+    }
+
+    if (count) {
+        while (depth > 0) close_frame(stats, stack, depth--, events[count - 1].tsc);
+    }
+    kfree(stack);
+    return 0;
+}
+
+static void callgraph_report(uint32_t limit) {
+    callgraph_stats_t st;
+    uint32_t count, nsyms = ksym_total();
+
+    callgraph_get_stats(&st);
+    const callgraph_event_t* events = callgraph_events(&count);
+    if (!events) {
+        vga_puts("callgraph: still recording, 'callgraph stop' first\n");
+        last_exit_status = 1;
+        return;
+    }
+    if (!count || !nsyms) {
+        vga_puts(count ? "callgraph: kernel built without a symbol table\n"
+                       : "callgraph: nothing recorded\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    fn_stats_t* stats = kzalloc(nsyms * sizeof(fn_stats_t));
+    if (!stats) {
+        vga_puts("callgraph: out of memory\n");
+        last_exit_status = 1;
+        return;
+    }
+    int err = replay(events, count, stats);
+    if (err) {
+        vga_puts(err == -E2BIG ? "callgraph: calls nest too deep to replay\n"
+                               : "callgraph: out of memory\n");
+        kfree(stats);
+        last_exit_status = 1;
+        return;
+    }
+
+    clocksource_t* tsc = clocksource_find("tsc");
+    uint32_t tsc_khz = tsc ? (uint32_t)div_u64(tsc->freq_hz, 1000) : 0;
+    uint64_t span = events[count - 1].tsc - events[0].tsc;
+
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_putdec(count, 0);
+    vga_puts(" events over ");
+    print_u64(to_us(span, tsc_khz), 0);
+    vga_puts(tsc_khz ? " us" : " cycles");
+    if (st.full) vga_puts(" (buffer filled, recording stopped early)");
+    vga_puts(tsc_khz ? "\n\n    Calls   Incl(us)   Excl(us)  Excl%  Function\n"
+                     : "\n\n    Calls  Incl(cyc)  Excl(cyc)  Excl%  Function\n");
+
+    // Highest exclusive time first; a picked entry is zeroed so it is
+    // not picked again
+    for (uint32_t n = 0; n < limit; n++) {
+        uint32_t best = 0;
+        uint64_t best_excl = 0;
+        for (uint32_t i = 0; i < nsyms; i++) {
+            if (stats[i].exclusive > best_excl) {
+                best = i;
+                best_excl = stats[i].exclusive;
+            }
+        }
+        if (!best_excl) break;
+
+        ksym_t sym;
+        ksym_get(best, &sym);
+        uint32_t percent = span ? (uint32_t)div64_u64(best_excl * 100, span) : 0;
+
+        vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+        print_u64(stats[best].calls, 9);
+        print_u64(to_us(stats[best].inclusive, tsc_khz), 11);
+        print_u64(to_us(best_excl, tsc_khz), 11);
+        print_u64(percent, 6);
+        vga_putchar('%');
+        vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+        vga_puts("  ");
+        vga_puts(sym.name);
+        vga_putchar('\n');
+        stats[best].exclusive = 0;
+    }
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    kfree(stats);
+    last_exit_status = 0;
+}
+
+static void callgraph_run(char* name, char* rest) {
+    const Command* cmd = name ? find_command(name) : NULL;
+    if (!cmd) {
+        vga_puts(name ? "callgraph: command not found\n" : "Usage: callgraph run <command> [args]\n");
+        last_exit_status = 1;
+        return;
+    }
+    if (callgraph_start() != 0) {
+        vga_puts("callgraph: already recording\n");
+        last_exit_status = 1;
+        return;
+    }
+    cmd->func(rest);
+    callgraph_stop();
+    vga_putchar('\n');
+    callgraph_report(CALLGRAPH_REPORT_DEFAULT);
+}
+
+static void callgraph_usage(void) {
+    vga_puts("Usage: callgraph start | stop | report [n] | run <command> [args]\n");
+    last_exit_status = 1;
+}
+
+void callgraph_command(const char *args) {
+    char *cmd = args ? strtok((char *)args, " ") : NULL;
+    char *arg = cmd ? strtok(NULL, " ") : NULL;
+
+    if (!cmd) {
+        callgraph_usage();
+    } else if (strcmp(cmd, "start") == 0) {
+        if (callgraph_start() != 0) {
+            vga_puts("callgraph: already recording\n");
+            last_exit_status = 1;
+            return;
+        }
+        vga_puts("Recording calls\n");
+        last_exit_status = 0;
+    } else if (strcmp(cmd, "stop") == 0) {
+        int err = callgraph_stop();
+        if (err == -EINVAL) {
+            vga_puts("callgraph: not recording\n");
+            last_exit_status = 1;
+            return;
+        }
+        callgraph_stats_t st;
+        callgraph_get_stats(&st);
+        vga_putdec(st.events, 0);
+        vga_puts(err ? " events recorded; the buffer filled and recording had already stopped\n"
+                     : " events recorded\n");
+        last_exit_status = err ? 1 : 0;
+    } else if (strcmp(cmd, "report") == 0) {
+        uint32_t limit = arg ? parse_uint(arg, CALLGRAPH_REPORT_MAX) : CALLGRAPH_REPORT_DEFAULT;
+        if (!limit || limit > CALLGRAPH_REPORT_MAX) {
+            vga_puts("Usage: callgraph report [n (1-200)]\n");
+            last_exit_status = 1;
+            return;
+        }
+        callgraph_report(limit);
+    } else if (strcmp(cmd, "run") == 0) {
+        callgraph_run(arg, arg ? strtok(NULL, "\0") : NULL);
+    } else {
+        callgraph_usage();
+    }
+}
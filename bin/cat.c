@@ -0,0 +1,71 @@
+#include "../include/shell/shell.h"
+#include "../include/video/vga.h"
+#include "../include/fs/vfs.h"
+#include "../include/mm/filemap.h"
+#include "../include/mm/vmm.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+
+#define CAT_CHUNK 512
+
+// Print straight out of the page cache, without copying, when the file
+// lives there; -EINVAL when it does not
+static int cat_cached(vfs_inode_t *inode) {
+    vfs_off_t size = inode->size;
+
+    for (uint32_t index = 0; (vfs_off_t)index * PAGE_SIZE < size; index++) {
+        const uint8_t *data;
+        int err = filemap_get_page(inode, index, &data);
+        if (err) return index ? err : -EINVAL;
+
+        vfs_off_t left = size - index * PAGE_SIZE;
+        uint32_t n = left < PAGE_SIZE ? left : PAGE_SIZE;
+        for (uint32_t i = 0; i < n; i++) vga_putchar(data[i]);
+        filemap_put_page(inode, index);
+    }
+    return 0;
+}
+
+static int cat_file(const char *path) {
+    int fd = vfs_open(path, O_RDONLY);
+    if (fd < 0) return fd;
+
+    int err = cat_cached(vfs_get_file(fd)->inode);
+    if (err != -EINVAL) {
+        vfs_close(fd);
+        return err;
+    }
+
+    char buf[CAT_CHUNK];
+    int n;
+    while ((n = vfs_read(fd, buf, sizeof(buf))) > 0) {
+        for (int i = 0; i < n; i++) vga_putchar(buf[i]);
+    }
+    vfs_close(fd);
+    return n < 0 ? n : 0;
+}
+
+void cat_command(const char *args) {
+    if (args == NULL || *args == '\0') {
+        vga_puts("cat: missing operand\nUsage: cat <file>...\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    last_exit_status = 0;
+    char *path = strtok((char *)args, " ");
+    while (path) {
+        int err = cat_file(path);
+        if (err) {
+            vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+            vga_puts("cat: ");
+            vga_puts(path);
+            vga_puts(": ");
+            vga_puts(vfs_strerror(err));
+            vga_putchar('\n');
+            vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+            last_exit_status = 1;
+        }
+        path = strtok(NULL, " ");
+    }
+}
@@ -0,0 +1,113 @@
+#include "../include/shell/shell.h"
+#include "../include/shell/cmdutil.h"
+#include "../include/video/vga.h"
+#include "../include/kernel/time/clocksource.h"
+#include "../include/lib/string.h"
+#include "../include/lib/math64.h"
+
+// Every counter the kernel found, what a read of it costs, and which one
+// timekeeping runs off. "clocksource <name>" switches by hand, even to
+// a source the watchdog gave up on, to compare them.
+
+// MHz with three decimals
+static void print_mhz(uint64_t hz, int width) {
+    uint32_t rem;
+    uint32_t mhz = (uint32_t)div_u64_rem(div_u64(hz + 500, 1000), 1000, &rem);
+    print_padded(mhz, width - 4);
+    vga_putchar('.');
+    vga_putdec(rem, 3);
+}
+
+static int counter_bits(uint64_t mask) {
+    int bits = 0;
+    while (mask) {
+        bits++;
+        mask >>= 1;
+    }
+    return bits;
+}
+
+static void print_us(int64_t ns) {
+    if (ns < 0) {
+        vga_putchar('-');
+        ns = -ns;
+    }
+    vga_putdec((uint32_t)div_u64((uint64_t)ns, 1000), 0);
+    vga_puts(" us");
+}
+
+static void clocksource_row(clocksource_t* cs) {
+    vga_set_color(cs == clocksource_current() ? VGA_COLOR_WHITE : VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    print_name(cs->name, 8);
+    vga_putchar(cs == clocksource_current() ? '*' : ' ');
+    print_padded(cs->rating, 7);
+    print_mhz(cs->freq_hz, 12);
+    print_padded(counter_bits(cs->mask), 6);
+    print_padded(cs->read_ns, 9);
+    vga_puts("  ");
+    if (cs->flags & CLOCK_SOURCE_UNSTABLE) {
+        vga_set_color(VGA_COLOR_RED, VGA_COLOR_BLACK);
+        vga_puts("unstable");
+    } else if (cs->flags & CLOCK_SOURCE_MUST_VERIFY) {
+        vga_puts("verified");
+    } else if (cs->flags & CLOCK_SOURCE_WATCHDOG) {
+        vga_puts("watchdog");
+    }
+    vga_putchar('\n');
+}
+
+void clocksource_command(const char *args) {
+    char *arg = args ? strtok((char *)args, " ") : NULL;
+
+    if (arg) {
+        if (clocksource_select(arg) != 0) {
+            vga_puts("clocksource: ");
+            vga_puts(arg);
+            vga_puts(": no such clock source\n");
+            last_exit_status = 1;
+            return;
+        }
+        vga_puts("Timekeeping now reads ");
+        vga_puts(arg);
+        vga_putchar('\n');
+        last_exit_status = 0;
+        return;
+    }
+
+    size_t count = clocksource_count();
+    if (!count) {
+        vga_puts("clocksource: none registered\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts("source    rating    freq MHz  bits  read ns\n");
+    for (size_t i = 0; i < count; i++) clocksource_row(clocksource_get(i));
+
+    clocksource_watchdog_t wd;
+    clocksource_watchdog_stats(&wd);
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    if (wd.checked) {
+        vga_puts("watchdog: ");
+        vga_puts(wd.checked->name);
+        vga_puts(" against ");
+        vga_puts(wd.reference->name);
+        vga_puts(", ");
+        vga_putdec(wd.checks, 0);
+        vga_puts(" checks, last skew ");
+        print_us(wd.last_skew_ns);
+        vga_puts(", worst ");
+        print_us(wd.max_skew_ns);
+        vga_putchar('\n');
+    }
+
+    uint32_t rem;
+    uint64_t sec = div_u64_rem(ktime_get_ns(), 1000000000, &rem);
+    vga_puts("monotonic: ");
+    vga_putdec((uint32_t)sec, 0);
+    vga_putchar('.');
+    vga_putdec(rem / 1000, 6);
+    vga_puts(" s\n");
+    last_exit_status = 0;
+}
@@ -22,7 +22,7 @@ void print_cpu_row(const char* label, const char* value) {
     vga_puts("\n");
 }
 
-void print_feature(cpu_info_t* cpu, const char* label, bool feature) {
+void print_feature(const char* label, bool feature) {
     vga_set_color(feature ? VGA_COLOR_GREEN : VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK);
     vga_puts(feature ? " ✓ " : " ✗ ");
     vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
@@ -70,8 +70,7 @@ static void itoa(int num, char* str, int base) {
 }
 
 void cpuinfo_command(const char *args) {
-    cpu_info_t cpu;
-    cpu_identify(&cpu);
+    const cpu_info_t* cpu = cpu_identify();
     uint8_t original_color = vga_get_color();
 
     // Main header
@@ -83,32 +82,32 @@ void cpuinfo_command(const char *args) {
     vga_puts("╚════════════════════════════════════════════╝\n");
 
     // Basic information
-    print_cpu_row("Vendor ID    ", cpu.identity.vendor_id);
-    print_cpu_row("Brand String ", cpu.identity.brand_string);
-    print_cpu_row("Architecture ", cpu.features.lm ? "x86_64" : "i386");
+    print_cpu_row("Vendor ID    ", cpu->identity.vendor_id);
+    print_cpu_row("Brand String ", cpu->identity.brand_string);
+    print_cpu_row("Architecture ", cpu_has(X86_FEATURE_LM) ? "x86_64" : "i386");
     
     // Format family/model/stepping manually
     char buf[32];
     char num_buf[12];
     
     // Family
-    itoa(cpu.identity.family, num_buf, 10);
+    itoa(cpu->identity.family, num_buf, 10);
     strcpy(buf, num_buf);
     strcat(buf, "/");
     
     // Model
-    itoa(cpu.identity.model, num_buf, 10);
+    itoa(cpu->identity.model, num_buf, 10);
     strcat(buf, num_buf);
     strcat(buf, "/");
     
     // Stepping
-    itoa(cpu.identity.stepping, num_buf, 10);
+    itoa(cpu->identity.stepping, num_buf, 10);
     strcat(buf, num_buf);
     
     print_cpu_row("Family/Model ", buf);
 
     // TSC Frequency
-    uint32_t mhz = cpu.tsc_frequency / 1000;
+    uint32_t mhz = cpu->tsc_frequency / 1000;
     itoa(mhz, num_buf, 10);
     strcpy(buf, num_buf);
     strcat(buf, " MHz");
@@ -120,12 +119,12 @@ void cpuinfo_command(const char *args) {
     vga_set_color(VGA_COLOR_BLACK, VGA_COLOR_LIGHT_GREY);
     vga_puts("\n");
 
-    print_feature(&cpu, "FPU     ", cpu.features.fpu);
-    print_feature(&cpu, "SSE4.2  ", cpu.features.sse4_2);
-    print_feature(&cpu, "AVX2    ", cpu.features.avx2);
+    print_feature("FPU     ", cpu_has(X86_FEATURE_FPU));
+    print_feature("SSE4.2  ", cpu_has(X86_FEATURE_SSE4_2));
+    print_feature("AVX2    ", cpu_has(X86_FEATURE_AVX2));
     vga_puts("\n");
-    print_feature(&cpu, "AES-NI  ", cpu.features.aes);
-    print_feature(&cpu, "AVX512F ", cpu.features.avx512f);
+    print_feature("AES-NI  ", cpu_has(X86_FEATURE_AES));
+    print_feature("AVX512F ", cpu_has(X86_FEATURE_AVX512F));
     vga_puts("\n\n");
 
     // Cache information
@@ -134,8 +133,8 @@ void cpuinfo_command(const char *args) {
     vga_set_color(VGA_COLOR_BLACK, VGA_COLOR_LIGHT_GREY);
     vga_puts("\n");
 
-    for (uint8_t i = 0; i < cpu.num_caches; i++) {
-        const cache_descriptor_t* c = &cpu.caches[i];
+    for (uint8_t i = 0; i < cpu->num_caches; i++) {
+        const cache_descriptor_t* c = &cpu->caches[i];
         vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
         vga_puts("  L");
         vga_putdec(c->level, 0);
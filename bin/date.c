@@ -1,6 +1,7 @@
 #include "../include/shell/shell.h"
 #include "../include/video/vga.h"
-#include "../include/kernel/rtc/rtc.h"
+#include "../include/kernel/time/clocksource.h"
+#include "../include/lib/calendar.h"
 
 // Constants for weekday names
 static const char *weekday_names[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
@@ -9,26 +10,22 @@ void date_command(const char *args) {
     // Ignore unused arguments
     (void)args;
 
-    struct rtc_date date;
-    rtc_read_full(&date); // Assuming this populates the `date` struct
+    // The cached wall clock, decoded in closed form
+    int32_t days = ktime_get_real_seconds() / SECS_PER_DAY;
+    int32_t year;
+    uint32_t month, day;
+    civil_from_days(days, &year, &month, &day);
 
     // Print the date in DD/MM/YYYY format
     vga_puts("Date: ");
-    vga_putdec(date.day, 2);
+    vga_putdec(day, 2);
     vga_putchar('/');
-    vga_putdec(date.month, 2);
+    vga_putdec(month, 2);
     vga_putchar('/');
-    vga_putdec(date.year, 4);
-
-    // Calculate the weekday using the function from rtc.c
-    uint8_t weekday = day_of_week(date.day, date.month, date.year);
+    vga_putdec(year, 4);
 
     // Print the weekday
     vga_puts(" (");
-    if (weekday < 7) {
-        vga_puts(weekday_names[weekday]);
-    } else {
-        vga_puts("???");
-    }
+    vga_puts(weekday_names[weekday_from_days(days)]);
     vga_puts(")\n");
 }
@@ -0,0 +1,448 @@
+#include "../include/shell/shell.h"
+#include "../include/shell/cmdutil.h"
+#include "../include/video/vga.h"
+#include "../include/block/blkdev.h"
+#include "../include/block/elevator.h"
+#include "../include/kernel/arch/x86/cpu.h"
+#include "../include/kernel/arch/x86/irq.h"
+#include "../include/kernel/arch/x86/apic.h"
+#include "../include/mm/vmm.h"
+#include "../include/lib/string.h"
+#include "../include/lib/math64.h"
+#include "../include/lib/errno.h"
+
+// Raw read benchmark against whole-disk block devices (qemu -hda, virtio,
+// NVMe). Random reads are swept over queue depth and submitter count: a
+// driver that really keeps several requests in flight scales, one that
+// serializes them stays flat. There are no kernel threads yet, so each
+// submitter is an independent stream of requests with its own random
+// sequence, refilled from its own completions.
+//
+// "diskbench -w <dev>" adds a mixed read/write run under each I/O
+// scheduler. It overwrites the last BENCH_MIX_REGION_MB of the disk (the
+// second half of a small one), so it only runs when asked for.
+#define BENCH_BUFFER_PAGES   32          // 128KB, reused as 4KB read targets
+#define BENCH_SEQ_MB         32
+#define BENCH_RANDOM_OPS     2000
+#define BENCH_RANDOM_SECTORS 8           // 4KB
+#define BENCH_MAX_QD         32
+#define BENCH_MAX_STREAMS    4
+#define BENCH_MIX_OPS        4000
+#define BENCH_MIX_STREAMS    4
+#define BENCH_MIX_QD         16          // Total, shared by the streams
+#define BENCH_MIX_READ_PCT   70
+#define BENCH_MIX_REGION_MB  32
+
+struct qd_stream {
+    uint32_t rand_state;
+    uint32_t issued;
+    uint32_t total;
+};
+
+struct qd_run {
+    blkdev_t* dev;
+    uint32_t slots;                      // Random LBA range, in 4KB units
+    volatile uint32_t issued;
+    volatile uint32_t completed;
+    volatile int error;
+    struct qd_stream streams[BENCH_MAX_STREAMS];
+    blk_request_t reqs[BENCH_MAX_QD * BENCH_MAX_STREAMS];
+};
+
+static struct qd_run run;
+
+// Each mixed stream reads one file-like range and writes another, both
+// sequentially, so same-direction neighbours can merge
+struct mix_stream {
+    uint32_t rand_state;
+    uint64_t read_lba;
+    uint64_t write_lba;
+    uint64_t first_lba;
+    uint64_t end_lba;
+};
+
+struct mix_run {
+    blkdev_t* dev;
+    uint32_t remaining;
+    volatile uint32_t issued;
+    volatile uint32_t completed;
+    volatile int error;
+    struct mix_stream streams[BENCH_MIX_STREAMS];
+    blk_request_t reqs[BENCH_MIX_QD];
+};
+
+static struct mix_run mix;
+
+static uint32_t total_irqs(void) {
+    uint32_t n = 0;
+    for (int irq = 0; irq < IRQ_LINES; irq++) n += irq_get_count(irq);
+    for (int vector = LAPIC_FIRST_VECTOR; vector < LAPIC_SPURIOUS_VECTOR; vector++) {
+        n += lapic_vector_count(vector);    // MSI and MSI-X
+    }
+    return n;
+}
+
+// Average latency is elapsed time times the number of requests in flight
+static void print_result(const char* label, uint64_t bytes, uint32_t ops, uint32_t us, uint32_t depth) {
+    uint32_t kbps = (uint32_t)div_u64((bytes / 1024) * 1000000ull, us);
+    uint32_t iops = (uint32_t)div_u64((uint64_t)ops * 1000000ull, us);
+    uint32_t latency = (uint32_t)div_u64((uint64_t)us * depth, ops);
+
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts("  ");
+    vga_puts(label);
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    vga_putdec(kbps / 1024, 0);
+    vga_putchar('.');
+    vga_putdec((kbps % 1024) * 10 / 1024, 1);
+    vga_puts(" MB/s\t");
+    vga_putdec(iops, 0);
+    vga_puts(" IOPS\t");
+    vga_putdec(latency, 0);
+    vga_puts(" us/op\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+}
+
+static int bench_sequential(blkdev_t* dev, uint8_t* buffer, uint32_t mb) {
+    uint32_t chunk = dev->max_sectors;
+    if (chunk * dev->sector_size > BENCH_BUFFER_PAGES * PAGE_SIZE) {
+        chunk = BENCH_BUFFER_PAGES * PAGE_SIZE / dev->sector_size;
+    }
+
+    uint64_t total = div_u64((uint64_t)mb * 1024 * 1024, dev->sector_size);
+    if (total > dev->sectors) total = dev->sectors;
+
+    uint32_t ops = 0;
+    uint64_t start = cpu_rdtsc();
+    for (uint64_t lba = 0; lba < total; lba += chunk) {
+        uint32_t count = (total - lba < chunk) ? (uint32_t)(total - lba) : chunk;
+        int err = blkdev_read(dev, lba, count, buffer);
+        if (err) return err;
+        ops++;
+    }
+    uint32_t us = elapsed_us(start);
+
+    print_result("sequential read  ", total * dev->sector_size, ops, us, 1);
+    return 0;
+}
+
+static void qd_complete(blk_request_t* req);
+
+// Aim a slot at a fresh random 4KB block and send it off
+static void qd_issue(blk_request_t* req) {
+    struct qd_stream* stream = req->private;
+
+    req->dev = run.dev;
+    req->op = BLK_OP_READ;
+    req->lba = (uint64_t)(xorshift32(&stream->rand_state) % run.slots) * BENCH_RANDOM_SECTORS;
+    req->count = BENCH_RANDOM_SECTORS;
+    req->complete = qd_complete;
+    stream->issued++;
+    run.issued++;
+
+    int err = blkdev_submit(req);
+    if (err) {
+        run.error = err;
+        run.completed++;
+    }
+}
+
+// Interrupt context: keep the slot busy until its stream is done
+static void qd_complete(blk_request_t* req) {
+    struct qd_stream* stream = req->private;
+
+    run.completed++;
+    if (req->status) run.error = req->status;
+    if (stream->issued < stream->total && !run.error) qd_issue(req);
+}
+
+// Fills in IOPS; returns 0 or -errno
+static int bench_random_qd(blkdev_t* dev, uint8_t* buffer, uint32_t depth, uint32_t streams,
+                           uint32_t* iops) {
+    memset(&run, 0, sizeof(run));
+    run.dev = dev;
+    run.slots = (uint32_t)div_u64(dev->sectors, BENCH_RANDOM_SECTORS);
+    if (run.slots == 0) return -EINVAL;
+
+    for (uint32_t s = 0; s < streams; s++) {
+        run.streams[s].rand_state = 2463534242u + s * 0x9E3779B9u;
+        run.streams[s].total = BENCH_RANDOM_OPS / streams;
+    }
+
+    // Slot i belongs to stream i % streams so the first wave interleaves
+    uint32_t nreqs = depth * streams;
+    uint32_t buffers = BENCH_BUFFER_PAGES * PAGE_SIZE / (BENCH_RANDOM_SECTORS * BLK_SECTOR_SIZE);
+    for (uint32_t i = 0; i < nreqs; i++) {
+        run.reqs[i].buffer = buffer + (i % buffers) * BENCH_RANDOM_SECTORS * BLK_SECTOR_SIZE;
+        run.reqs[i].private = &run.streams[i % streams];
+    }
+
+    uint64_t start = cpu_rdtsc();
+    uint32_t flags = irq_save();
+    for (uint32_t i = 0; i < nreqs && !run.error; i++) qd_issue(&run.reqs[i]);
+    while (run.completed < run.issued) cpu_sleep();
+    irq_restore(flags);
+    uint32_t us = elapsed_us(start);
+
+    if (run.error) return run.error;
+    *iops = (uint32_t)div_u64((uint64_t)run.completed * 1000000ull, us);
+    return 0;
+}
+
+// Rows are queue depth per submitter, columns the number of submitters
+static int bench_random_grid(blkdev_t* dev, uint8_t* buffer) {
+    vga_puts("  random 4K read IOPS, queue depth x submitters:\n");
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts("    qd");
+    for (uint32_t streams = 1; streams <= BENCH_MAX_STREAMS; streams *= 2) {
+        vga_puts("      x");
+        vga_putdec(streams, 0);
+    }
+    vga_putchar('\n');
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    for (uint32_t depth = 1; depth <= BENCH_MAX_QD; depth *= 2) {
+        vga_puts("  ");
+        print_padded(depth, 4);
+        for (uint32_t streams = 1; streams <= BENCH_MAX_STREAMS; streams *= 2) {
+            uint32_t iops = 0;
+            int err = bench_random_qd(dev, buffer, depth, streams, &iops);
+            if (err) return err;
+            print_padded(iops, 8);
+        }
+        vga_putchar('\n');
+    }
+    return 0;
+}
+
+static void mix_complete(blk_request_t* req);
+
+static uint64_t mix_advance(struct mix_stream* stream, uint64_t* lba) {
+    uint64_t at = *lba;
+    *lba += BENCH_RANDOM_SECTORS;
+    if (*lba >= stream->end_lba) *lba = stream->first_lba;
+    return at;
+}
+
+static void mix_issue(blk_request_t* req) {
+    struct mix_stream* stream = req->private;
+    bool read = xorshift32(&stream->rand_state) % 100 < BENCH_MIX_READ_PCT;
+
+    req->dev = mix.dev;
+    req->op = read ? BLK_OP_READ : BLK_OP_WRITE;
+    req->lba = mix_advance(stream, read ? &stream->read_lba : &stream->write_lba);
+    req->count = BENCH_RANDOM_SECTORS;
+    req->complete = mix_complete;
+    mix.remaining--;
+    mix.issued++;
+
+    int err = blkdev_submit(req);
+    if (err) {
+        mix.error = err;
+        mix.completed++;
+    }
+}
+
+// Interrupt context
+static void mix_complete(blk_request_t* req) {
+    mix.completed++;
+    if (req->status) mix.error = req->status;
+    if (mix.remaining && !mix.error) mix_issue(req);
+}
+
+static void print_latency(const char* label, const uint32_t* hist) {
+    vga_puts(label);
+    vga_putdec(blk_latency_percentile(hist, 50), 0);
+    vga_putchar('/');
+    vga_putdec(blk_latency_percentile(hist, 99), 0);
+    vga_puts(" us");
+}
+
+static int bench_mixed_run(blkdev_t* dev, uint8_t* buffer, uint64_t first, uint64_t sectors) {
+    blkdev_stats_t before = dev->stats;
+
+    memset(&mix, 0, sizeof(mix));
+    mix.dev = dev;
+    mix.remaining = BENCH_MIX_OPS;
+
+    // Each stream gets its own slice: reads from the front, writes from the middle
+    uint64_t slice = div_u64(sectors, BENCH_MIX_STREAMS * BENCH_RANDOM_SECTORS) * BENCH_RANDOM_SECTORS;
+    for (uint32_t s = 0; s < BENCH_MIX_STREAMS; s++) {
+        struct mix_stream* stream = &mix.streams[s];
+        stream->rand_state = 2463534242u + s * 0x9E3779B9u;
+        stream->first_lba = first + s * slice;
+        stream->end_lba = stream->first_lba + slice;
+        stream->read_lba = stream->first_lba;
+        stream->write_lba = stream->first_lba + div_u64(slice, 2 * BENCH_RANDOM_SECTORS) * BENCH_RANDOM_SECTORS;
+    }
+    for (uint32_t i = 0; i < BENCH_MIX_QD; i++) {
+        mix.reqs[i].buffer = buffer + i * BENCH_RANDOM_SECTORS * BLK_SECTOR_SIZE;
+        mix.reqs[i].private = &mix.streams[i % BENCH_MIX_STREAMS];
+    }
+
+    // The first wave goes out under a plug so the scheduler sees it whole
+    blk_plug_t plug;
+    uint64_t start = cpu_rdtsc();
+    uint32_t flags = irq_save();
+    blk_start_plug(&plug);
+    for (uint32_t i = 0; i < BENCH_MIX_QD && !mix.error; i++) mix_issue(&mix.reqs[i]);
+    blk_finish_plug(&plug);
+    while (mix.completed < mix.issued) cpu_sleep();
+    irq_restore(flags);
+    uint32_t us = elapsed_us(start);
+
+    if (mix.error) return mix.error;
+
+    uint32_t read_hist[BLK_LAT_BUCKETS];
+    uint32_t write_hist[BLK_LAT_BUCKETS];
+    for (int i = 0; i < BLK_LAT_BUCKETS; i++) {
+        read_hist[i] = dev->stats.read_latency[i] - before.read_latency[i];
+        write_hist[i] = dev->stats.write_latency[i] - before.write_latency[i];
+    }
+
+    print_result("", (uint64_t)mix.completed * BENCH_RANDOM_SECTORS * BLK_SECTOR_SIZE, mix.completed, us,
+                 BENCH_MIX_QD);
+    vga_puts("            merges ");
+    vga_putdec(dev->stats.merges - before.merges, 0);
+    vga_puts(", driver requests ");
+    vga_putdec(dev->stats.dispatched - before.dispatched, 0);
+    print_latency(", read p50/p99 ", read_hist);
+    print_latency(", write ", write_hist);
+    vga_putchar('\n');
+    return 0;
+}
+
+// Same workload under every registered scheduler
+static int bench_mixed(blkdev_t* dev, uint8_t* buffer) {
+    uint64_t region = div_u64((uint64_t)BENCH_MIX_REGION_MB * 1024 * 1024, BLK_SECTOR_SIZE);
+    if (region > dev->sectors / 2) region = dev->sectors / 2;
+    if (region < BENCH_MIX_STREAMS * 2 * BENCH_RANDOM_SECTORS) return -EINVAL;
+    uint64_t first = dev->sectors - region;
+
+    vga_puts("  mixed 4K I/O, ");
+    vga_putdec(BENCH_MIX_READ_PCT, 0);
+    vga_puts("% reads, ");
+    vga_putdec(BENCH_MIX_STREAMS, 0);
+    vga_puts(" sequential streams, queue depth ");
+    vga_putdec(BENCH_MIX_QD, 0);
+    vga_puts(":\n");
+
+    const char* saved = blkdev_elevator_name(dev);
+    elevator_type_t* type;
+    int err = 0;
+    for (int i = 0; !err && (type = elevator_get(i)) != NULL; i++) {
+        err = blkdev_set_elevator(dev, type->name);
+        if (err) break;
+
+        vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+        vga_puts("  ");
+        vga_puts(type->name);
+        for (int pad = strlen(type->name); pad < 10; pad++) vga_putchar(' ');
+        err = bench_mixed_run(dev, buffer, first, region);
+    }
+    blkdev_set_elevator(dev, saved);
+    return err;
+}
+
+static int bench_device(blkdev_t* dev, uint8_t* buffer, uint32_t mb, bool mixed) {
+    vga_puts("Disk benchmark: ");
+    vga_puts(dev->name);
+    vga_puts(", ");
+    vga_putdec((uint32_t)((dev->sectors * dev->sector_size) >> 20), 0);
+    vga_puts(" MB, up to ");
+    vga_putdec(dev->max_sectors * dev->sector_size / 1024, 0);
+    vga_puts(" KB per request, hardware queue depth ");
+    vga_putdec(dev->queue_depth, 0);
+    vga_putchar('\n');
+
+    uint32_t irqs_before = total_irqs();
+    uint32_t requests_before = dev->stats.reads;
+    uint32_t doorbells_before = dev->stats.doorbells;
+    int err = bench_sequential(dev, buffer, mb);
+    if (err) return err;
+
+    err = bench_random_grid(dev, buffer);
+    if (err) return err;
+
+    if (mixed) {
+        err = bench_mixed(dev, buffer);
+        if (err) return err;
+    }
+
+    vga_puts("  interrupts taken: ");
+    vga_putdec(total_irqs() - irqs_before, 0);
+    vga_puts(", doorbells per 100 requests: ");
+    uint32_t requests = dev->stats.reads - requests_before;
+    vga_putdec(requests ? (dev->stats.doorbells - doorbells_before) * 100 / requests : 0, 0);
+    vga_putchar('\n');
+    return 0;
+}
+
+void diskbench_command(const char *args) {
+    char name[BLKDEV_NAME_MAX] = "";
+    uint32_t mb = BENCH_SEQ_MB;
+    bool mixed = false;
+
+    // diskbench [-w device] [device] [megabytes]
+    while (args && *args) {
+        while (*args == ' ') args++;
+        if (args[0] == '-' && args[1] == 'w' && (args[2] == ' ' || args[2] == '\0')) {
+            mixed = true;
+            args += 2;
+        } else if (*args >= '0' && *args <= '9') {
+            mb = 0;
+            while (*args >= '0' && *args <= '9') mb = mb * 10 + (*args++ - '0');
+        } else if (*args) {
+            int n = 0;
+            while (*args && *args != ' ' && n < BLKDEV_NAME_MAX - 1) name[n++] = *args++;
+            name[n] = '\0';
+            while (*args && *args != ' ') args++;
+        }
+    }
+
+    if (mixed && !name[0]) {
+        vga_puts("diskbench: -w overwrites data, name the device\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    blkdev_t* dev = name[0] ? blkdev_find(name) : blkdev_get(0);
+    if (!dev) {
+        vga_puts("diskbench: no such block device");
+        if (name[0]) {
+            vga_puts(": ");
+            vga_puts(name);
+        }
+        vga_putchar('\n');
+        last_exit_status = 1;
+        return;
+    }
+
+    uint8_t* buffer = (uint8_t*)vmm_alloc_pages(BENCH_BUFFER_PAGES);
+    if (!buffer) {
+        vga_puts("diskbench: out of memory\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    // Without a name, run every disk back to back so they can be compared
+    int err = 0;
+    if (name[0]) {
+        err = bench_device(dev, buffer, mb, mixed);
+    } else {
+        for (size_t i = 0; !err && (dev = blkdev_get(i)) != NULL; i++) {
+            err = bench_device(dev, buffer, mb, false);
+        }
+    }
+
+    vmm_free_pages((uint32_t*)buffer, BENCH_BUFFER_PAGES);
+
+    if (err) {
+        vga_puts("diskbench: I/O error on ");
+        vga_puts(dev->name);
+        vga_putchar('\n');
+        last_exit_status = 1;
+        return;
+    }
+    last_exit_status = 0;
+}
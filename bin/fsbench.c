@@ -0,0 +1,161 @@
+#include "../include/shell/shell.h"
+#include "../include/shell/cmdutil.h"
+#include "../include/video/vga.h"
+#include "../include/fs/vfs.h"
+#include "../include/fs/fat32.h"
+#include "../include/block/blkdev.h"
+#include "../include/kernel/arch/x86/cpu.h"
+#include "../include/mm/vmm.h"
+#include "../include/lib/string.h"
+#include "../include/lib/math64.h"
+#include "../include/lib/errno.h"
+
+// File throughput through the VFS: write the file if it is missing or
+// short, then read it back start to finish in large chunks. The device
+// request count shows whether the filesystem turns a sequential read
+// into big contiguous requests or one request per block.
+#define FSBENCH_DEFAULT_MB   100
+#define FSBENCH_CHUNK_PAGES  16          // 64KB per read()/write()
+
+static uint32_t device_requests(void) {
+    uint32_t n = 0;
+    blkdev_t* dev;
+    for (size_t i = 0; (dev = blkdev_get(i)) != NULL; i++) n += dev->stats.dispatched;
+    return n;
+}
+
+static void print_rate(const char* label, uint32_t bytes, uint32_t us, uint32_t requests) {
+    uint32_t kbps = (uint32_t)div_u64((uint64_t)(bytes / 1024) * 1000000ull, us);
+
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts("  ");
+    vga_puts(label);
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    vga_putdec(kbps / 1024, 0);
+    vga_putchar('.');
+    vga_putdec((kbps % 1024) * 10 / 1024, 1);
+    vga_puts(" MB/s");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_puts("  ");
+    vga_putdec(requests, 0);
+    vga_puts(" device requests, ");
+    vga_putdec(requests ? bytes / 1024 / requests : 0, 0);
+    vga_puts(" KB each\n");
+}
+
+static int fsbench_write(const char* path, uint8_t* buffer, uint32_t bytes) {
+    int fd = vfs_open(path, O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd < 0) return fd;
+
+    uint32_t chunk = FSBENCH_CHUNK_PAGES * PAGE_SIZE;
+    uint32_t requests = device_requests();
+    uint64_t start = cpu_rdtsc();
+    int err = 0;
+    for (uint32_t done = 0; done < bytes && !err; done += chunk) {
+        uint32_t n = bytes - done < chunk ? bytes - done : chunk;
+        for (uint32_t i = 0; i < n; i += 4) *(uint32_t*)(buffer + i) = done + i;
+        int written = vfs_write(fd, buffer, n);
+        if (written < 0) err = written;
+        else if ((uint32_t)written != n) err = -ENOSPC;
+    }
+    vfs_close(fd);
+    if (err) return err;
+
+    print_rate("write  ", bytes, elapsed_us(start), device_requests() - requests);
+    return 0;
+}
+
+// Reads and checks the pattern fsbench_write() left
+static int fsbench_read(const char* path, uint8_t* buffer, uint32_t size) {
+    int fd = vfs_open(path, O_RDONLY);
+    if (fd < 0) return fd;
+
+    uint32_t chunk = FSBENCH_CHUNK_PAGES * PAGE_SIZE;
+    uint32_t requests = device_requests();
+    uint32_t mismatches = 0;
+    uint64_t start = cpu_rdtsc();
+    uint32_t done = 0;
+    int n;
+    while ((n = vfs_read(fd, buffer, chunk)) > 0) {
+        if (*(uint32_t*)buffer != done) mismatches++;
+        done += n;
+    }
+    uint32_t us = elapsed_us(start);
+    vfs_close(fd);
+    if (n < 0) return n;
+    if (done != size) return -EIO;
+
+    print_rate("read   ", done, us, device_requests() - requests);
+    if (mismatches) {
+        vga_puts("  (");
+        vga_putdec(mismatches, 0);
+        vga_puts(" chunks did not hold the fsbench pattern)\n");
+    }
+    return 0;
+}
+
+void fsbench_command(const char *args) {
+    char *path = args ? strtok((char *)args, " ") : NULL;
+    char *arg = path ? strtok(NULL, " ") : NULL;
+    if (!path) {
+        vga_puts("Usage: fsbench <file> [MB]   Write (if needed) and read back a file\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    uint32_t mb = FSBENCH_DEFAULT_MB;
+    if (arg && *arg >= '0' && *arg <= '9') {
+        mb = 0;
+        while (*arg >= '0' && *arg <= '9') mb = mb * 10 + (*arg++ - '0');
+    }
+    if (mb == 0 || mb > 2048) {
+        vga_puts("fsbench: size must be 1-2048 MB\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    uint8_t* buffer = (uint8_t*)vmm_alloc_pages(FSBENCH_CHUNK_PAGES);
+    if (!buffer) {
+        vga_puts("fsbench: out of memory\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    vga_puts("File benchmark: ");
+    vga_puts(path);
+    vga_puts(", ");
+    vga_putdec(mb, 0);
+    vga_puts(" MB in ");
+    vga_putdec(FSBENCH_CHUNK_PAGES * PAGE_SIZE / 1024, 0);
+    vga_puts(" KB chunks\n");
+
+    uint32_t bytes = mb * 1024 * 1024;
+    vfs_stat_t st;
+    int err = 0;
+    if (vfs_stat(path, &st) != 0 || st.size != bytes) err = fsbench_write(path, buffer, bytes);
+
+    fat32_stats_t before, after;
+    fat32_get_stats(&before);
+    if (!err) err = fsbench_read(path, buffer, bytes);
+    fat32_get_stats(&after);
+    vmm_free_pages((uint32_t*)buffer, FSBENCH_CHUNK_PAGES);
+
+    if (!err && after.chains_mapped != before.chains_mapped) {
+        vga_puts("  FAT32 cluster chain: ");
+        vga_putdec(after.clusters - before.clusters, 0);
+        vga_puts(" clusters in ");
+        vga_putdec(after.extents - before.extents, 0);
+        vga_puts(" extents\n");
+    }
+
+    if (err) {
+        vga_puts("fsbench: ");
+        vga_puts(path);
+        vga_puts(": ");
+        vga_puts(vfs_strerror(err));
+        vga_putchar('\n');
+        last_exit_status = 1;
+        return;
+    }
+    last_exit_status = 0;
+}
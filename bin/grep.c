@@ -1,11 +1,58 @@
 #include "../include/shell/shell.h"
 #include "../include/video/vga.h"
 #include "../include/keyboard/kb.h"
+#include "../include/fs/vfs.h"
 #include <string.h>
 
+static void grep_print_match(const char *line) {
+    vga_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
+    vga_puts("MATCH: ");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_puts(line);
+    vga_putchar('\n');
+}
+
+// Scan a file line by line; lines longer than the buffer are split
+static int grep_file(const char *pattern, const char *path) {
+    int fd = vfs_open(path, O_RDONLY);
+    if (fd < 0) return fd;
+
+    char buf[256];
+    char line[256];
+    int pos = 0;
+    int matches = 0;
+    int n;
+
+    while ((n = vfs_read(fd, buf, sizeof(buf))) > 0) {
+        for (int i = 0; i < n; i++) {
+            if (buf[i] != '\n' && pos < (int)sizeof(line) - 1) {
+                line[pos++] = buf[i];
+                if (pos < (int)sizeof(line) - 1) continue;
+            }
+            line[pos] = '\0';
+            if (strstr(line, pattern) != NULL) {
+                grep_print_match(line);
+                matches++;
+            }
+            pos = 0;
+        }
+    }
+    if (pos > 0) {
+        line[pos] = '\0';
+        if (strstr(line, pattern) != NULL) {
+            grep_print_match(line);
+            matches++;
+        }
+    }
+
+    vfs_close(fd);
+    if (n < 0) return n;
+    return matches;
+}
+
 void grep_command(const char *args) {
     if (args == NULL || *args == '\0') {
-        vga_puts("grep: missing pattern\nUsage: grep PATTERN\n");
+        vga_puts("grep: missing pattern\nUsage: grep PATTERN [FILE]\n");
         return;
     }
 
@@ -13,6 +60,24 @@ void grep_command(const char *args) {
     while (*args == ' ') args++;
     const char *pattern = args;
 
+    // A trailing absolute path names the file to search
+    char *file = strrchr(args, ' ');
+    if (file && file[1] == '/') {
+        *file++ = '\0';
+        int ret = grep_file(pattern, file);
+        if (ret < 0) {
+            vga_puts("grep: ");
+            vga_puts(file);
+            vga_puts(": ");
+            vga_puts(vfs_strerror(ret));
+            vga_putchar('\n');
+            last_exit_status = 2;
+        } else {
+            last_exit_status = ret > 0 ? 0 : 1;
+        }
+        return;
+    }
+
     char line[256] = {0};
     int pos = 0;
     bool active = true;
@@ -44,11 +109,7 @@ void grep_command(const char *args) {
             
             // Check for match
             if (strstr(line, pattern) != NULL) {
-                vga_set_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
-                vga_puts("MATCH: ");
-                vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
-                vga_puts(line);
-                vga_putchar('\n');
+                grep_print_match(line);
             }
             
             // Reset for next line
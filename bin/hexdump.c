@@ -2,6 +2,7 @@
 #include <stddef.h>
 #include "../include/mm/vmm.h"
 #include "../include/video/vga.h"
+#include "../include/fs/vfs.h"
 
 static void print_byte(uint8_t byte) {
     const char hex_chars[] = "0123456789ABCDEF";
@@ -23,25 +24,15 @@ static void print_ascii(uint8_t* data, size_t count) {
     vga_puts(" |\n");
 }
 
-void hexdump(uint32_t* virtual_addr, size_t bytes_to_dump) {
-    if (!virtual_addr || bytes_to_dump == 0) {
-        vga_puts("Invalid parameters\n");
-        return;
-    }
-
-    uint8_t original_color = vga_get_color();
-    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
-
-    uint8_t* current = (uint8_t*)virtual_addr;
-    uint8_t* end = current + bytes_to_dump;
-
-    while (current < end) {
-        print_address((uint32_t)current);
+// Print data in 16-byte lines, labelling each line with base + offset
+static void hexdump_lines(const uint8_t* data, size_t count, uint32_t base) {
+    for (size_t off = 0; off < count; off += 16) {
+        print_address(base + off);
         
         // Print 16 bytes per line
-        for (int i = 0; i < 16; i++) {
-            if (current + i < end) {
-                print_byte(current[i]);
+        for (size_t i = 0; i < 16; i++) {
+            if (off + i < count) {
+                print_byte(data[off + i]);
             } else {
                 vga_puts("  "); // Padding
             }
@@ -57,17 +48,47 @@ void hexdump(uint32_t* virtual_addr, size_t bytes_to_dump) {
 
         // ASCII representation
         vga_puts("|");
-        for (int i = 0; i < 16; i++) {
-            if (current + i >= end) break;
-            uint8_t c = current[i];
+        for (size_t i = 0; i < 16 && off + i < count; i++) {
+            uint8_t c = data[off + i];
             vga_putchar((c >= 32 && c <= 126) ? c : '.');
         }
         vga_puts("|\n");
+    }
+}
+
+void hexdump(uint32_t* virtual_addr, size_t bytes_to_dump) {
+    if (!virtual_addr || bytes_to_dump == 0) {
+        vga_puts("Invalid parameters\n");
+        return;
+    }
+
+    uint8_t original_color = vga_get_color();
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+
+    hexdump_lines((const uint8_t*)virtual_addr, bytes_to_dump, (uint32_t)virtual_addr);
+
+    vga_set_color(original_color & 0x0F, (original_color >> 4) & 0x0F);
+}
+
+// Dump a file through the VFS, labelling lines with file offsets
+static int hexdump_file(const char* path) {
+    int fd = vfs_open(path, O_RDONLY);
+    if (fd < 0) return fd;
+
+    uint8_t original_color = vga_get_color();
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
 
-        current += 16;
+    uint8_t buf[256];
+    uint32_t offset = 0;
+    int n;
+    while ((n = vfs_read(fd, buf, sizeof(buf))) > 0) {
+        hexdump_lines(buf, n, offset);
+        offset += n;
     }
 
     vga_set_color(original_color & 0x0F, (original_color >> 4) & 0x0F);
+    vfs_close(fd);
+    return n < 0 ? n : 0;
 }
 
 // Safe memory test function
@@ -83,6 +104,20 @@ static void safe_memory_test(void) {
 }
 
 int hexdump_command(const char *args) {
+    if (args && *args) {
+        while (*args == ' ') args++;
+        int err = hexdump_file(args);
+        if (err) {
+            vga_puts("hexdump: ");
+            vga_puts(args);
+            vga_puts(": ");
+            vga_puts(vfs_strerror(err));
+            vga_putchar('\n');
+            return 1;
+        }
+        return 0;
+    }
+
     // 1. Dump known-safe VGA memory (first 128 bytes only)
     vga_puts("Hexdump of VGA memory (first 128 bytes):\n");
     hexdump((uint32_t*)0xB8000, 128);
@@ -0,0 +1,162 @@
+#include "../include/shell/shell.h"
+#include "../include/video/vga.h"
+#include "../include/net/netdev.h"
+#include "../include/net/inet.h"
+#include "../include/lib/string.h"
+#include "../include/lib/math64.h"
+
+static void ifconfig_usage(void) {
+    vga_puts("Usage: ifconfig                        List network devices\n");
+    vga_puts("       ifconfig <dev>                  Show one device\n");
+    vga_puts("       ifconfig <dev> <addr>[/prefix]  Set the IPv4 address (default /24)\n");
+    vga_puts("       ifconfig <dev> up|down\n");
+    vga_puts("       ifconfig <dev> coalesce <irqs/s>  Cap the interrupt rate, 0 for none\n");
+}
+
+static void print_hex_byte(uint8_t b) {
+    const char* digits = "0123456789abcdef";
+    vga_putchar(digits[b >> 4]);
+    vga_putchar(digits[b & 0xF]);
+}
+
+static int mask_prefix(uint32_t mask) {
+    int prefix = 0;
+    for (uint32_t m = ntohl(mask); m & 0x80000000u; m <<= 1) prefix++;
+    return prefix;
+}
+
+static void print_counters(const char* label, uint64_t packets, uint64_t bytes,
+                           uint32_t dropped, uint32_t errors) {
+    vga_puts(label);
+    vga_putdec((uint32_t)packets, 0);
+    vga_puts(" packets  ");
+    vga_putdec((uint32_t)div_u64(bytes, 1024), 0);
+    vga_puts(" KB  dropped ");
+    vga_putdec(dropped, 0);
+    vga_puts("  errors ");
+    vga_putdec(errors, 0);
+    vga_putchar('\n');
+}
+
+static void ifconfig_show(netdev_t* dev) {
+    char addr[INET_ADDRSTRLEN];
+
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    vga_puts(dev->name);
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_puts(": ");
+    vga_puts(dev->flags & IFF_UP ? "UP" : "DOWN");
+    if (dev->flags & IFF_LOOPBACK) vga_puts(" LOOPBACK");
+    vga_puts("  mtu ");
+    vga_putdec(dev->mtu, 0);
+    if (dev->features & NETIF_F_HW_CSUM) vga_puts("  tx-csum");
+    if (dev->features & NETIF_F_RXCSUM) vga_puts("  rx-csum");
+    if (dev->ops->set_coalesce) {
+        vga_puts("  coalesce ");
+        if (dev->coalesce_rate) {
+            vga_putdec(dev->coalesce_rate, 0);
+            vga_puts(" irq/s");
+        } else {
+            vga_puts("off");
+        }
+    }
+    vga_putchar('\n');
+
+    vga_puts("    inet ");
+    if (dev->ipv4_addr) {
+        vga_puts(inet_ntoa_r(dev->ipv4_addr, addr));
+        vga_putchar('/');
+        vga_putdec(mask_prefix(dev->ipv4_mask), 0);
+    } else {
+        vga_puts("none");
+    }
+    if (dev->hard_header_len) {
+        vga_puts("  ether ");
+        for (int i = 0; i < 6; i++) {
+            if (i) vga_putchar(':');
+            print_hex_byte(dev->mac[i]);
+        }
+    }
+    vga_putchar('\n');
+
+    print_counters("    rx ", dev->stats.rx_packets, dev->stats.rx_bytes,
+                   dev->stats.rx_dropped, dev->stats.rx_errors);
+    print_counters("    tx ", dev->stats.tx_packets, dev->stats.tx_bytes,
+                   dev->stats.tx_dropped, dev->stats.tx_errors);
+    if (dev->ops->poll || dev->ops->flush) {
+        vga_puts("    interrupts ");
+        vga_putdec(dev->stats.interrupts, 0);
+        vga_puts("  polls ");
+        vga_putdec(dev->stats.polls, 0);
+        vga_puts("  doorbells ");
+        vga_putdec(dev->stats.doorbells, 0);
+        vga_putchar('\n');
+    }
+}
+
+// "a.b.c.d" or "a.b.c.d/n"
+static bool parse_cidr(char* arg, uint32_t* addr, uint32_t* mask) {
+    int prefix = 24;
+    char* slash = strchr(arg, '/');
+    if (slash) {
+        *slash++ = '\0';
+        prefix = 0;
+        if (!*slash) return false;
+        while (*slash >= '0' && *slash <= '9' && prefix <= 32) prefix = prefix * 10 + (*slash++ - '0');
+        if (*slash || prefix < 1 || prefix > 32) return false;
+    }
+    if (!inet_aton(arg, addr)) return false;
+    *mask = htonl(prefix == 32 ? 0xFFFFFFFFu : ~(0xFFFFFFFFu >> prefix));
+    return true;
+}
+
+void ifconfig_command(const char *args) {
+    char *name = args ? strtok((char *)args, " ") : NULL;
+    char *arg = name ? strtok(NULL, " ") : NULL;
+
+    if (!name) {
+        for (size_t i = 0; i < netdev_count(); i++) ifconfig_show(netdev_get(i));
+        last_exit_status = 0;
+        return;
+    }
+
+    netdev_t* dev = netdev_find(name);
+    if (!dev) {
+        vga_puts("ifconfig: ");
+        vga_puts(name);
+        vga_puts(": no such device\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    uint32_t addr, mask;
+    if (!arg) {
+        ifconfig_show(dev);
+    } else if (strcmp(arg, "up") == 0) {
+        dev->flags |= IFF_UP;
+    } else if (strcmp(arg, "down") == 0) {
+        dev->flags &= ~IFF_UP;
+    } else if (strcmp(arg, "coalesce") == 0) {
+        char *rate = strtok(NULL, " ");
+        uint32_t v = 0;
+        if (!rate || !dev->ops->set_coalesce) {
+            ifconfig_usage();
+            last_exit_status = 1;
+            return;
+        }
+        while (*rate >= '0' && *rate <= '9' && v < 1000000) v = v * 10 + (*rate++ - '0');
+        if (*rate || dev->ops->set_coalesce(dev, v) != 0) {
+            ifconfig_usage();
+            last_exit_status = 1;
+            return;
+        }
+    } else if (parse_cidr(arg, &addr, &mask) && !(dev->flags & IFF_LOOPBACK)) {
+        dev->ipv4_addr = addr;
+        dev->ipv4_mask = mask;
+    } else {
+        ifconfig_usage();
+        last_exit_status = 1;
+        return;
+    }
+    last_exit_status = 0;
+}
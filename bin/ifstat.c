@@ -0,0 +1,89 @@
+#include "../include/shell/shell.h"
+#include "../include/shell/cmdutil.h"
+#include "../include/video/vga.h"
+#include "../include/net/netdev.h"
+#include "../include/kernel/arch/x86/cpu.h"
+#include "../include/kernel/sched/idle.h"
+#include "../include/lib/string.h"
+#include "../include/lib/math64.h"
+
+// Rates over a sampling window, with the interrupt rate next to the
+// packet rate it bought: packets per interrupt is what moderation
+// trades against latency. The window keeps the network running, so it
+// can be taken while a stream arrives from outside.
+#define IFSTAT_DEFAULT_SECONDS 1
+#define IFSTAT_MAX_SECONDS     60
+
+static netdev_stats_t before[NETDEV_MAX];
+
+static uint32_t per_second(uint64_t count, uint32_t us) {
+    return (uint32_t)div_u64(count * 1000000ull, us);
+}
+
+static void ifstat_row(netdev_t* dev, const netdev_stats_t* old, uint32_t us) {
+    uint64_t rx = dev->stats.rx_packets - old->rx_packets;
+    uint64_t tx = dev->stats.tx_packets - old->tx_packets;
+    uint32_t irqs = dev->stats.interrupts - old->interrupts;
+
+    print_name(dev->name, 8);
+    print_padded(per_second(rx, us), 10);
+    print_padded((uint32_t)div_u64((dev->stats.rx_bytes - old->rx_bytes) * 8, us), 8);
+    print_padded(per_second(tx, us), 10);
+    print_padded((uint32_t)div_u64((dev->stats.tx_bytes - old->tx_bytes) * 8, us), 8);
+    print_padded(per_second(irqs, us), 9);
+    print_padded(irqs ? (uint32_t)div_u64(rx + tx, irqs) : 0, 8);
+    if (!dev->ops->set_coalesce) vga_puts("       -");
+    else if (!dev->coalesce_rate) vga_puts("     off");
+    else print_padded(dev->coalesce_rate, 8);
+    vga_putchar('\n');
+}
+
+void ifstat_command(const char *args) {
+    char *arg = args ? strtok((char *)args, " ") : NULL;
+    netdev_t* only = NULL;
+    uint32_t seconds = IFSTAT_DEFAULT_SECONDS;
+
+    if (arg && !(arg[0] >= '0' && arg[0] <= '9')) {
+        only = netdev_find(arg);
+        if (!only) {
+            vga_puts("ifstat: ");
+            vga_puts(arg);
+            vga_puts(": no such device\n");
+            last_exit_status = 1;
+            return;
+        }
+        arg = strtok(NULL, " ");
+    }
+    if (arg) {
+        seconds = 0;
+        while (*arg >= '0' && *arg <= '9' && seconds <= IFSTAT_MAX_SECONDS) seconds = seconds * 10 + (*arg++ - '0');
+        if (*arg || seconds == 0 || seconds > IFSTAT_MAX_SECONDS) {
+            vga_puts("Usage: ifstat [dev] [seconds]   Packet and interrupt rates, 1-60 s window\n");
+            last_exit_status = 1;
+            return;
+        }
+    }
+
+    size_t count = netdev_count();
+    for (size_t i = 0; i < count; i++) before[i] = netdev_get(i)->stats;
+
+    uint64_t start = cpu_rdtsc();
+    uint64_t window = (uint64_t)seconds * 1000000000ull;
+    while (cpu_tsc_to_ns(cpu_rdtsc() - start) < window) {
+        if (!net_poll()) {
+            idle_poll();
+            cpu_pause();
+        }
+    }
+    uint32_t us = (uint32_t)div_u64(cpu_tsc_to_ns(cpu_rdtsc() - start), 1000);
+    if (!us) us = 1;
+
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts("device   rx pkt/s  rx Mb/s  tx pkt/s  tx Mb/s    irq/s pkt/irq coalesce\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    for (size_t i = 0; i < count; i++) {
+        netdev_t* dev = netdev_get(i);
+        if (!only || dev == only) ifstat_row(dev, &before[i], us);
+    }
+    last_exit_status = 0;
+}
@@ -0,0 +1,119 @@
+#include "../include/shell/shell.h"
+#include "../include/shell/cmdutil.h"
+#include "../include/video/vga.h"
+#include "../include/block/blkdev.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+#include "../include/lib/math64.h"
+
+static void iostat_usage(void) {
+    vga_puts("Usage: iostat                           Per-device request counters\n");
+    vga_puts("       iostat <dev>                     Latency histograms\n");
+    vga_puts("       iostat <dev> scheduler <name>    Switch I/O scheduler (noop, deadline)\n");
+    vga_puts("       iostat <dev> reset               Clear the counters\n");
+}
+
+static void iostat_list(void) {
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts("device    sched        reads    writes    merges  dispatch  inflight\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    blkdev_t* dev;
+    for (size_t i = 0; (dev = blkdev_get(i)) != NULL; i++) {
+        print_name(dev->name, 10);
+        print_name(blkdev_elevator_name(dev), 9);
+        print_padded(dev->stats.reads, 9);
+        print_padded(dev->stats.writes, 10);
+        print_padded(dev->stats.merges, 10);
+        print_padded(dev->stats.dispatched, 10);
+        print_padded(dev->stats.in_flight, 10);
+        vga_putchar('\n');
+    }
+}
+
+// One row per non-empty bucket: upper bound in microseconds and count
+static void print_histogram(const char* label, const uint32_t* hist) {
+    uint32_t total = 0;
+    for (int i = 0; i < BLK_LAT_BUCKETS; i++) total += hist[i];
+
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts(label);
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    vga_putdec(total, 0);
+    vga_puts(" requests, p50 ");
+    vga_putdec(blk_latency_percentile(hist, 50), 0);
+    vga_puts(" us, p99 ");
+    vga_putdec(blk_latency_percentile(hist, 99), 0);
+    vga_puts(" us\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    for (int i = 0; i < BLK_LAT_BUCKETS; i++) {
+        if (!hist[i]) continue;
+        vga_puts("    < ");
+        print_padded(1u << i, 8);
+        vga_puts(" us ");
+        print_padded(hist[i], 8);
+        vga_puts("  ");
+        for (uint32_t n = (uint32_t)div_u64((uint64_t)hist[i] * 40, total); n > 0; n--) vga_putchar('#');
+        vga_putchar('\n');
+    }
+}
+
+static void iostat_device(blkdev_t* dev) {
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    vga_puts(dev->name);
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_puts(": scheduler ");
+    vga_puts(blkdev_elevator_name(dev));
+    vga_puts(", ");
+    vga_putdec(dev->stats.merges, 0);
+    vga_puts(" merges, ");
+    vga_putdec(dev->stats.dispatched, 0);
+    vga_puts(" driver requests, ");
+    vga_putdec(dev->stats.errors, 0);
+    vga_puts(" errors\n");
+
+    print_histogram("  reads:  ", dev->stats.read_latency);
+    print_histogram("  writes: ", dev->stats.write_latency);
+}
+
+void iostat_command(const char *args) {
+    if (args == NULL || *args == '\0') {
+        iostat_list();
+        last_exit_status = 0;
+        return;
+    }
+
+    char *name = strtok((char *)args, " ");
+    blkdev_t* dev = blkdev_find(name);
+    if (!dev) {
+        vga_puts("iostat: no such block device: ");
+        vga_puts(name);
+        vga_putchar('\n');
+        last_exit_status = 1;
+        return;
+    }
+
+    char *arg = strtok(NULL, " ");
+    if (arg == NULL) {
+        iostat_device(dev);
+        last_exit_status = 0;
+    } else if (strcmp(arg, "reset") == 0) {
+        blkdev_reset_stats(dev);
+        last_exit_status = 0;
+    } else if (strcmp(arg, "scheduler") == 0) {
+        char *sched = strtok(NULL, " ");
+        int err = sched ? blkdev_set_elevator(dev, sched) : -EINVAL;
+        if (err == -ENOENT) {
+            vga_puts("iostat: unknown scheduler\n");
+        } else if (err == -EBUSY) {
+            vga_puts("iostat: device busy\n");
+        } else if (err) {
+            iostat_usage();
+        }
+        last_exit_status = err ? 1 : 0;
+    } else {
+        iostat_usage();
+        last_exit_status = 1;
+    }
+}
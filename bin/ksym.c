@@ -0,0 +1,103 @@
+#include "../include/shell/shell.h"
+#include "../include/shell/cmdutil.h"
+#include "../include/video/vga.h"
+#include "../include/kernel/panic/ksym.h"
+#include "../include/kernel/time/clocksource.h"
+#include "../include/kernel/arch/x86/cpu.h"
+#include "../include/lib/string.h"
+#include "../include/lib/math64.h"
+
+// ksym [address...]: resolve kernel addresses to function+offset. With
+// no arguments, time lookups of random addresses across kernel text:
+// binary search plus decoding one block of prefix-compressed names.
+#define KSYM_BENCH_LOOKUPS 100000
+
+// Hex, with or without 0x; 0 when malformed
+static uint32_t parse_hex(const char* s) {
+    uint32_t v = 0;
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) s += 2;
+    if (!*s) return 0;
+    for (; *s; s++) {
+        uint32_t d;
+        if (*s >= '0' && *s <= '9') d = *s - '0';
+        else if (*s >= 'a' && *s <= 'f') d = *s - 'a' + 10;
+        else if (*s >= 'A' && *s <= 'F') d = *s - 'A' + 10;
+        else return 0;
+        v = (v << 4) | d;
+    }
+    return v;
+}
+
+static void ksym_resolve(const char* arg) {
+    uint32_t addr = parse_hex(arg);
+    ksym_t sym;
+
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    vga_puthex(addr);
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    if (ksym_lookup(addr, &sym)) {
+        vga_puts("  ");
+        vga_puts(sym.name);
+        vga_puts("+");
+        vga_putdec(sym.offset, 0);
+        vga_puts("/");
+        vga_putdec(sym.size, 0);
+        vga_putchar('\n');
+    } else {
+        vga_puts("  not in kernel text\n");
+        last_exit_status = 1;
+    }
+}
+
+static void ksym_bench(void) {
+    uint32_t total = ksym_total();
+    if (!total) {
+        vga_puts("ksym: kernel built without a symbol table\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    ksym_t first, last;
+    ksym_get(0, &first);
+    ksym_get(total - 1, &last);
+    uint32_t span = last.addr + last.size - first.addr;
+    uint32_t rng = (uint32_t)cpu_rdtsc() | 1;
+    uint32_t found = 0;
+
+    uint64_t start = ktime_get_ns();
+    for (uint32_t i = 0; i < KSYM_BENCH_LOOKUPS; i++) {
+        ksym_t sym;
+        found += ksym_lookup(first.addr + xorshift32(&rng) % span, &sym);
+    }
+    uint64_t elapsed = ktime_get_ns() - start;
+
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_putdec(total, 0);
+    vga_puts(" symbols, ");
+    vga_puthex(first.addr);
+    vga_puts("-");
+    vga_puthex(first.addr + span);
+    vga_puts("\n");
+    vga_putdec(KSYM_BENCH_LOOKUPS, 0);
+    vga_puts(" lookups, ");
+    vga_putdec(found, 0);
+    vga_puts(" resolved: ");
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    vga_putdec((uint32_t)div_u64(elapsed, KSYM_BENCH_LOOKUPS), 0);
+    vga_puts(" ns");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_puts(" per lookup\n");
+    last_exit_status = 0;
+}
+
+void ksym_command(const char *args) {
+    char *arg = args ? strtok((char *)args, " ") : NULL;
+    if (!arg) {
+        ksym_bench();
+        return;
+    }
+
+    last_exit_status = 0;
+    for (; arg; arg = strtok(NULL, " ")) ksym_resolve(arg);
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+}
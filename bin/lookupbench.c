@@ -0,0 +1,147 @@
+#include "../include/shell/shell.h"
+#include "../include/video/vga.h"
+#include "../include/fs/vfs.h"
+#include "../include/fs/dcache.h"
+#include "../include/kernel/arch/x86/cpu.h"
+#include "../include/lib/string.h"
+#include "../include/lib/math64.h"
+#include "../include/lib/errno.h"
+
+// Benchmark tree: /bench/l00/l01/.../l15, every level padded with siblings
+// so an uncached lookup has to scan a realistically sized directory.
+#define BENCH_DEPTH       16
+#define BENCH_SIBLINGS    24
+#define BENCH_DEFAULT_ITERS 100000
+
+static char deep_path[VFS_PATH_MAX];
+static char missing_path[VFS_PATH_MAX];
+
+static void append_level(char *path, const char *prefix, int level) {
+    char name[8];
+    strcat(path, "/");
+    strcat(path, prefix);
+    name[0] = '0' + level / 10;
+    name[1] = '0' + level % 10;
+    name[2] = '\0';
+    strcat(path, name);
+}
+
+static int build_tree(void) {
+    char sibling[VFS_PATH_MAX];
+    int err;
+
+    strcpy(deep_path, "/bench");
+    err = vfs_mkdir(deep_path);
+    if (err && err != -EEXIST) return err;
+
+    for (int level = 0; level < BENCH_DEPTH; level++) {
+        // Siblings first so the real path component sits at the end
+        for (int s = 0; s < BENCH_SIBLINGS; s++) {
+            strcpy(sibling, deep_path);
+            append_level(sibling, "s", s);
+            err = vfs_mkdir(sibling);
+            if (err && err != -EEXIST) return err;
+        }
+        append_level(deep_path, "l", level);
+        err = vfs_mkdir(deep_path);
+        if (err && err != -EEXIST) return err;
+    }
+
+    strcpy(missing_path, deep_path);
+    strcat(missing_path, "/missing");
+    return 0;
+}
+
+// Resolve path iterations times and return average nanoseconds per lookup
+static uint32_t time_lookups(const char *path, uint32_t iterations, bool expect_found) {
+    vfs_inode_t *inode;
+
+    uint64_t start = cpu_rdtsc();
+    for (uint32_t i = 0; i < iterations; i++) {
+        int err = vfs_resolve(path, &inode);
+        if (err == 0) vfs_inode_put(inode);
+        else if (expect_found) return 0;
+    }
+    uint64_t cycles = cpu_rdtsc() - start;
+
+    return (uint32_t)div_u64(cpu_tsc_to_ns(cycles), iterations);
+}
+
+static void print_result(const char *label, uint32_t ns_cached, uint32_t ns_uncached) {
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts("  ");
+    vga_puts(label);
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    vga_putdec(ns_cached, 0);
+    vga_puts(" ns\t");
+    vga_putdec(ns_uncached, 0);
+    vga_puts(" ns\t");
+    if (ns_cached > 0) {
+        vga_putdec(ns_uncached / ns_cached, 0);
+        vga_putchar('.');
+        vga_putdec((ns_uncached * 10 / ns_cached) % 10, 1);
+        vga_puts("x");
+    }
+    vga_putchar('\n');
+}
+
+void lookupbench_command(const char *args) {
+    uint32_t iterations = BENCH_DEFAULT_ITERS;
+    if (args && *args) {
+        iterations = 0;
+        while (*args >= '0' && *args <= '9') {
+            iterations = iterations * 10 + (*args - '0');
+            args++;
+        }
+        if (iterations == 0) iterations = 1;
+    }
+
+    int err = build_tree();
+    if (err) {
+        vga_puts("lookupbench: cannot build tree: ");
+        vga_puts(vfs_strerror(err));
+        vga_putchar('\n');
+        last_exit_status = 1;
+        return;
+    }
+
+    bool was_enabled = dcache_is_enabled();
+
+    vga_puts("Path lookup benchmark: ");
+    vga_putdec(iterations, 0);
+    vga_puts(" lookups, depth ");
+    vga_putdec(BENCH_DEPTH + 1, 0);
+    vga_puts(", ");
+    vga_putdec(BENCH_SIBLINGS + 1, 0);
+    vga_puts(" entries per directory\n");
+    vga_puts("                dcache on\tdcache off\tspeedup\n");
+
+    dcache_set_enabled(true);
+    dcache_reset_stats();
+    uint32_t hit_cached = time_lookups(deep_path, iterations, true);
+    uint32_t miss_cached = time_lookups(missing_path, iterations, false);
+
+    dcache_stats_t stats;
+    dcache_get_stats(&stats);
+
+    dcache_set_enabled(false);
+    uint32_t hit_uncached = time_lookups(deep_path, iterations, true);
+    uint32_t miss_uncached = time_lookups(missing_path, iterations, false);
+
+    dcache_set_enabled(was_enabled);
+
+    print_result("existing path ", hit_cached, hit_uncached);
+    print_result("missing path  ", miss_cached, miss_uncached);
+
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_puts("dcache: ");
+    vga_putdec(stats.hits, 0);
+    vga_puts(" hits, ");
+    vga_putdec(stats.negative_hits, 0);
+    vga_puts(" negative hits, ");
+    vga_putdec(stats.misses, 0);
+    vga_puts(" misses, ");
+    vga_putdec(stats.entries, 0);
+    vga_puts(" entries\n");
+    last_exit_status = 0;
+}
@@ -0,0 +1,101 @@
+#include "../include/shell/shell.h"
+#include "../include/video/vga.h"
+#include "../include/fs/vfs.h"
+#include "../include/lib/string.h"
+
+static void ls_error(const char *path, int err) {
+    vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+    vga_puts("ls: cannot access '");
+    vga_puts(path);
+    vga_puts("': ");
+    vga_puts(vfs_strerror(err));
+    vga_putchar('\n');
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+}
+
+static void ls_print_entry(const char *name, const vfs_stat_t *st, bool long_format) {
+    if (long_format) {
+        vga_putchar(st->type == VFS_TYPE_DIR ? 'd' : '-');
+        const char *rwx = "rwxrwxrwx";
+        for (int i = 0; i < 9; i++) {
+            vga_putchar((st->mode & (0400 >> i)) ? rwx[i] : '-');
+        }
+        vga_puts(" ");
+        vga_putdec(st->nlink, 0);
+        vga_puts(" root root ");
+        vga_putdec(st->size, 0);
+        vga_puts(" ");
+    }
+
+    if (st->type == VFS_TYPE_DIR) {
+        vga_set_color(VGA_COLOR_LIGHT_BLUE, VGA_COLOR_BLACK);
+    }
+    vga_puts(name);
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_puts(long_format ? "\n" : "  ");
+}
+
+void ls_command(const char *args) {
+    const char *path = "/";
+    bool long_format = false;
+    char path_buf[VFS_PATH_MAX];
+
+    if (args) {
+        char *arg = strtok((char *)args, " ");
+        while (arg) {
+            if (strcmp(arg, "-l") == 0) {
+                long_format = true;
+            } else {
+                path = arg;
+            }
+            arg = strtok(NULL, " ");
+        }
+    }
+
+    vfs_stat_t st;
+    int err = vfs_stat(path, &st);
+    if (err) {
+        ls_error(path, err);
+        last_exit_status = 1;
+        return;
+    }
+
+    // Plain files list themselves
+    if (st.type != VFS_TYPE_DIR) {
+        ls_print_entry(path, &st, long_format);
+        if (!long_format) vga_putchar('\n');
+        last_exit_status = 0;
+        return;
+    }
+
+    int fd = vfs_open(path, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        ls_error(path, fd);
+        last_exit_status = 1;
+        return;
+    }
+
+    vfs_dirent_t ent;
+    int count = 0;
+    while (vfs_readdir(fd, &ent) > 0) {
+        // Stat through the full path so mount points show the mounted root
+        size_t len = strlen(path);
+        if (len + strlen(ent.name) + 2 < sizeof(path_buf)) {
+            strcpy(path_buf, path);
+            if (len == 0 || path[len - 1] != '/') strcat(path_buf, "/");
+            strcat(path_buf, ent.name);
+            if (vfs_stat(path_buf, &st) != 0) {
+                st.type = ent.type;
+                st.mode = 0;
+                st.nlink = 0;
+                st.size = 0;
+            }
+        }
+        ls_print_entry(ent.name, &st, long_format);
+        count++;
+    }
+    vfs_close(fd);
+
+    if (!long_format && count > 0) vga_putchar('\n');
+    last_exit_status = 0;
+}
@@ -2,6 +2,11 @@
 #include "../include/shell/shell.h"
 #include "../include/video/vga.h"
 #include "../include/mm/vmm.h"
+#include "../include/fs/tmpfs.h"
+#include "../include/mm/filemap.h"
+#include "../include/mm/zram.h"
+#include "../include/mm/reclaim.h"
+#include "../include/lib/math64.h"
 
 void print_mem_stat(const char* label, uint64_t value_mb, size_t pages) {
     vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
@@ -42,6 +47,98 @@ void meminfo_command(const char *args) {
     print_mem_stat("Used ", used_memory_mb, used_pages);
     print_mem_stat("Free ", free_memory_mb, free_pages);
 
+    // tmpfs pages count as used; break them out so /tmp growth is visible
+    tmpfs_usage_t tmpfs;
+    tmpfs_get_usage(&tmpfs);
+    print_mem_stat("Tmpfs", (tmpfs.data_pages * PAGE_SIZE) / (1024 * 1024), tmpfs.data_pages);
+    vga_set_color(VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK);
+    vga_puts("         ");
+    vga_putdec(tmpfs.files, 0);
+    vga_puts(" files, ");
+    vga_putdec(tmpfs.directories, 0);
+    vga_puts(" dirs, ");
+    vga_putdec(tmpfs.index_nodes, 0);
+    vga_puts(" index nodes, ");
+    vga_putdec(tmpfs.swapped_pages, 0);
+    vga_puts(" pages in zram\n");
+
+    // Page cache pages count as used too, but are given back under pressure
+    filemap_stats_t cache;
+    filemap_get_stats(&cache);
+    print_mem_stat("Cache", (cache.pages * PAGE_SIZE) / (1024 * 1024), cache.pages);
+    vga_set_color(VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK);
+    vga_puts("         ");
+    vga_putdec(cache.lookups ? (uint32_t)div_u64((uint64_t)cache.hits * 100, cache.lookups) : 0, 0);
+    vga_puts("% hit rate, ");
+    vga_putdec(cache.lookups, 0);
+    vga_puts(" lookups, ");
+    vga_putdec(cache.readahead, 0);
+    vga_puts(" read ahead, ");
+    vga_putdec(cache.evictions, 0);
+    vga_puts(" evicted, limit ");
+    vga_putdec(cache.limit, 0);
+    vga_puts(" pages\n");
+
+    // Compressed store: what it holds against what it costs
+    zram_stats_t zram;
+    zram_get_stats(&zram);
+    uint32_t zram_kb = (zram.compressed_bytes + 1023) / 1024;
+    print_mem_stat("Zram ", zram_kb / 1024, zram.pages);
+    vga_set_color(VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK);
+    vga_puts("         ");
+    vga_putdec(zram.same_filled, 0);
+    vga_puts(" same-filled, ");
+    vga_putdec(zram_kb, 0);
+    vga_puts(" KB compressed");
+    uint32_t compressed = zram.pages - zram.same_filled;
+    if (compressed) {
+        // Ratio of the pages LZ4 actually had to compress, to two places
+        uint32_t ratio = (uint32_t)div_u64((uint64_t)compressed * PAGE_SIZE * 100, zram.compressed_bytes);
+        vga_puts(", ratio ");
+        vga_putdec(ratio / 100, 0);
+        vga_putchar('.');
+        vga_putdec((ratio / 10) % 10, 0);
+        vga_putdec(ratio % 10, 0);
+        vga_putchar(':');
+        vga_putchar('1');
+    }
+    vga_puts(", ");
+    vga_putdec(zram.rejects, 0);
+    vga_puts(" refused\n");
+
+    reclaim_stats_t rs;
+    reclaim_get_stats(&rs);
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts("  Reclaim: ");
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    vga_putdec(rs.reclaimed, 0);
+    vga_puts(" pages");
+    if (rs.busy_ns >= 1000) {
+        vga_puts(" at ");
+        vga_putdec((uint32_t)div_u64((uint64_t)rs.reclaimed * 1000000, (uint32_t)div_u64(rs.busy_ns, 1000)), 0);
+        vga_puts(" pages/s");
+    }
+    vga_set_color(VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK);
+    for (const reclaim_source_t* src = reclaim_sources(); src; src = src->next) {
+        vga_puts(", ");
+        vga_putdec(src->reclaimed, 0);
+        vga_putchar(' ');
+        vga_puts(src->name);
+    }
+    vga_puts("\n         free ");
+    vga_putdec(vmm_get_free_pages(), 0);
+    vga_puts(", watermarks ");
+    vga_putdec(rs.low, 0);
+    vga_putchar('/');
+    vga_putdec(rs.high, 0);
+    vga_puts(", ");
+    vga_putdec(rs.wakeups, 0);
+    vga_puts(" wakeups, ");
+    vga_putdec(rs.direct, 0);
+    vga_puts(" direct, ");
+    vga_putdec(tmpfs.swapins, 0);
+    vga_puts(" swap-ins\n");
+
     // Usage bar
     vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
     vga_puts("  Utilization: ");
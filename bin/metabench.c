@@ -0,0 +1,178 @@
+#include "../include/shell/shell.h"
+#include "../include/shell/cmdutil.h"
+#include "../include/video/vga.h"
+#include "../include/fs/vfs.h"
+#include "../include/fs/dcache.h"
+#include "../include/fs/ext2.h"
+#include "../include/kernel/arch/x86/cpu.h"
+#include "../include/lib/string.h"
+#include "../include/lib/math64.h"
+#include "../include/lib/errno.h"
+
+// Metadata throughput through the VFS: create count empty files in one
+// directory, stat each of them with the dcache on and off, list the
+// directory and remove the files again. With the dcache off every stat
+// goes to the filesystem's own lookup, which is what a hashed directory
+// index speeds up.
+#define METABENCH_DEFAULT_FILES 10000
+#define METABENCH_MAX_FILES     99999
+
+static char bench_path[VFS_PATH_MAX];
+static size_t bench_dir_len;
+
+// <dir>/fNNNNN
+static const char* file_path(uint32_t i) {
+    char* p = bench_path + bench_dir_len;
+    *p++ = 'f';
+    for (uint32_t div = 10000; div; div /= 10) *p++ = '0' + (i / div) % 10;
+    *p = '\0';
+    return bench_path;
+}
+
+static void print_phase(const char* label, uint32_t ops, uint32_t us) {
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts("  ");
+    vga_puts(label);
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    vga_putdec(us / ops, 0);
+    vga_putchar('.');
+    vga_putdec((us % ops) * 10 / ops, 1);
+    vga_puts(" us/op\t");
+    vga_putdec((uint32_t)div_u64((uint64_t)ops * 1000000ull, us), 0);
+    vga_puts(" ops/s\n");
+}
+
+static int bench_create(uint32_t count) {
+    uint64_t start = cpu_rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        int fd = vfs_open(file_path(i), O_WRONLY | O_CREAT);
+        if (fd < 0) return fd;
+        vfs_close(fd);
+    }
+    print_phase("create     ", count, elapsed_us(start));
+    return 0;
+}
+
+static int bench_stat(const char* label, uint32_t count) {
+    vfs_stat_t st;
+    uint64_t start = cpu_rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        int err = vfs_stat(file_path(i), &st);
+        if (err) return err;
+    }
+    print_phase(label, count, elapsed_us(start));
+    return 0;
+}
+
+static int bench_readdir(uint32_t count) {
+    bench_path[bench_dir_len] = '\0';
+    int fd = vfs_open(bench_path, O_RDONLY);
+    if (fd < 0) return fd;
+
+    vfs_dirent_t de;
+    uint32_t n = 0;
+    int ret;
+    uint64_t start = cpu_rdtsc();
+    while ((ret = vfs_readdir(fd, &de)) > 0) n++;
+    uint32_t us = elapsed_us(start);
+    vfs_close(fd);
+    if (ret < 0) return ret;
+    if (n < count) return -EIO;
+
+    print_phase("readdir    ", n, us);
+    return 0;
+}
+
+static int bench_unlink(uint32_t count) {
+    uint64_t start = cpu_rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        int err = vfs_unlink(file_path(i));
+        if (err) return err;
+    }
+    print_phase("unlink     ", count, elapsed_us(start));
+    return 0;
+}
+
+static void print_ext2_stats(const ext2_stats_t* before, const ext2_stats_t* after) {
+    if (after->inode_reads == before->inode_reads && after->inode_writes == before->inode_writes) return;
+
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_puts("ext2: ");
+    vga_putdec(after->inode_reads - before->inode_reads, 0);
+    vga_puts(" inode reads, ");
+    vga_putdec(after->inode_writes - before->inode_writes, 0);
+    vga_puts(" inode writes, ");
+    vga_putdec(after->index_lookups - before->index_lookups, 0);
+    vga_puts(" hashed and ");
+    vga_putdec(after->linear_lookups - before->linear_lookups, 0);
+    vga_puts(" linear lookups\n      ");
+    vga_putdec(after->blocks_allocated - before->blocks_allocated, 0);
+    vga_puts(" blocks allocated, ");
+    vga_putdec(after->blocks_at_goal - before->blocks_at_goal, 0);
+    vga_puts(" at the goal\n");
+}
+
+void metabench_command(const char *args) {
+    char *dir = args ? strtok((char *)args, " ") : NULL;
+    char *arg = dir ? strtok(NULL, " ") : NULL;
+    if (!dir) {
+        vga_puts("Usage: metabench <dir> [files]   Create, stat and remove many files\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    uint32_t count = METABENCH_DEFAULT_FILES;
+    if (arg && *arg >= '0' && *arg <= '9') {
+        count = 0;
+        while (*arg >= '0' && *arg <= '9' && count <= METABENCH_MAX_FILES) count = count * 10 + (*arg++ - '0');
+    }
+    bench_dir_len = strlen(dir);
+    if (count == 0 || count > METABENCH_MAX_FILES) {
+        vga_puts("metabench: file count must be 1-99999\n");
+        last_exit_status = 1;
+        return;
+    }
+    if (bench_dir_len + 8 > VFS_PATH_MAX) {
+        vga_puts("metabench: path too long\n");
+        last_exit_status = 1;
+        return;
+    }
+    strcpy(bench_path, dir);
+    if (bench_path[bench_dir_len - 1] != '/') bench_path[bench_dir_len++] = '/';
+
+    vga_puts("Metadata benchmark: ");
+    vga_putdec(count, 0);
+    vga_puts(" files in ");
+    vga_puts(dir);
+    vga_putchar('\n');
+
+    bool was_enabled = dcache_is_enabled();
+    ext2_stats_t before, after;
+    ext2_get_stats(&before);
+
+    int err = bench_create(count);
+    if (!err) {
+        dcache_set_enabled(true);
+        err = bench_stat("stat       ", count);
+    }
+    if (!err) {
+        dcache_set_enabled(false);
+        err = bench_stat("stat nodc  ", count);
+        dcache_set_enabled(was_enabled);
+    }
+    if (!err) err = bench_readdir(count);
+    if (!err) err = bench_unlink(count);
+    dcache_set_enabled(was_enabled);
+
+    ext2_get_stats(&after);
+    print_ext2_stats(&before, &after);
+
+    if (err) {
+        vga_puts("metabench: ");
+        vga_puts(vfs_strerror(err));
+        vga_putchar('\n');
+        last_exit_status = 1;
+        return;
+    }
+    last_exit_status = 0;
+}
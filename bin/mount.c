@@ -0,0 +1,76 @@
+#include "../include/shell/shell.h"
+#include "../include/video/vga.h"
+#include "../include/fs/vfs.h"
+#include "../include/lib/string.h"
+
+static void mount_usage(void) {
+    vga_puts("Usage: mount                              List mounted filesystems\n");
+    vga_puts("       mount -t <type> [-r] <source> <dir> Mount a filesystem\n");
+}
+
+static void mount_list(void) {
+    for (int i = 0; i < VFS_MAX_MOUNTS; i++) {
+        vfs_superblock_t *sb = vfs_get_mount(i);
+        if (!sb) continue;
+
+        vga_puts(sb->source);
+        vga_puts(" on ");
+        vga_set_color(VGA_COLOR_LIGHT_BLUE, VGA_COLOR_BLACK);
+        vga_puts(sb->target);
+        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        vga_puts(" type ");
+        vga_puts(sb->type->name);
+        vga_puts((sb->flags & VFS_MNT_RDONLY) ? " (ro)\n" : " (rw)\n");
+    }
+}
+
+void mount_command(const char *args) {
+    if (args == NULL || *args == '\0') {
+        mount_list();
+        last_exit_status = 0;
+        return;
+    }
+
+    const char *type = NULL;
+    const char *source = NULL;
+    const char *target = NULL;
+    uint32_t flags = 0;
+
+    char *arg = strtok((char *)args, " ");
+    while (arg) {
+        if (strcmp(arg, "-t") == 0) {
+            type = strtok(NULL, " ");
+        } else if (strcmp(arg, "-r") == 0) {
+            flags |= VFS_MNT_RDONLY;
+        } else if (!source) {
+            source = arg;
+        } else if (!target) {
+            target = arg;
+        } else {
+            mount_usage();
+            last_exit_status = 1;
+            return;
+        }
+        arg = strtok(NULL, " ");
+    }
+
+    if (!type || !source || !target) {
+        mount_usage();
+        last_exit_status = 1;
+        return;
+    }
+
+    int err = vfs_mount(type, source, target, flags);
+    if (err) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_puts("mount: ");
+        vga_puts(target);
+        vga_puts(": ");
+        vga_puts(vfs_strerror(err));
+        vga_putchar('\n');
+        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        last_exit_status = 1;
+        return;
+    }
+    last_exit_status = 0;
+}
@@ -0,0 +1,216 @@
+#include "../include/shell/shell.h"
+#include "../include/shell/cmdutil.h"
+#include "../include/video/vga.h"
+#include "../include/net/socket.h"
+#include "../include/net/inet.h"
+#include "../include/kernel/syscall/syscall.h"
+#include "../include/kernel/arch/x86/cpu.h"
+#include "../include/mm/kmalloc.h"
+#include "../include/lib/string.h"
+#include "../include/lib/math64.h"
+#include "../include/lib/sort.h"
+#include "../include/fs/vfs.h"
+#include "../include/lib/errno.h"
+
+// Echo round trips over 127.0.0.1. The client is an ordinary program: it
+// goes through the system calls and copies its message in and out. The
+// server is kernel code and never copies: it takes each skb off its
+// socket and sends the very same buffer back. Both run in this one
+// context, so a round trip is send, server step, receive, and its time
+// covers the whole path through the stack twice.
+#define NETBENCH_PORT          7777
+#define NETBENCH_DEFAULT_COUNT 10000
+#define NETBENCH_MAX_COUNT     1000000
+#define NETBENCH_DEFAULT_SIZE  64
+#define NETBENCH_MAX_SIZE      8192
+#define NETBENCH_TIMEOUT_MS    1000
+
+static uint8_t message[NETBENCH_MAX_SIZE];
+
+static void set_timeout(int fd, bool kernel) {
+    uint32_t ms = NETBENCH_TIMEOUT_MS;
+    if (kernel) socket_setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &ms, sizeof(ms));
+    else sys_setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &ms, sizeof(ms));
+}
+
+// The last run's connection may still be closing on the port
+static void set_reuseaddr(int fd) {
+    uint32_t on = 1;
+    socket_setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+}
+
+// Echo 'len' bytes back, skb by skb
+static int server_echo(int fd, uint32_t len) {
+    struct sockaddr_in from;
+    uint32_t done = 0;
+
+    while (done < len) {
+        sk_buff_t* skb;
+        int n = socket_recv_skb(fd, &skb, 0, &from);
+        if (n <= 0) return n ? n : -ECONNRESET;
+        done += n;
+        int err = socket_send_skb(fd, skb, 0, &from);
+        if (err < 0) return err;
+    }
+    return 0;
+}
+
+static int client_recv(int fd, uint32_t len) {
+    uint32_t done = 0;
+    while (done < len) {
+        int n = sys_recv(fd, message + done, len - done, 0);
+        if (n <= 0) return n ? n : -ECONNRESET;
+        done += n;
+    }
+    return 0;
+}
+
+static int run(int type, uint32_t count, uint32_t size, uint32_t* samples) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(NETBENCH_PORT);
+    addr.sin_addr = htonl(INADDR_LOOPBACK);
+
+    int server = -1, client = -1, conn = -1;
+    int err = socket_create(AF_INET, type, 0);
+    if (err < 0) return err;
+    server = err;
+    set_timeout(server, true);
+    set_reuseaddr(server);
+    err = socket_bind(server, (struct sockaddr*)&addr, sizeof(addr));
+    if (!err && type == SOCK_STREAM) err = socket_listen(server, 1);
+    if (err) goto out;
+
+    err = client = sys_socket(AF_INET, type, 0);
+    if (client < 0) goto out;
+    set_timeout(client, false);
+    err = sys_connect(client, (struct sockaddr*)&addr, sizeof(addr));
+    if (err) goto out;
+
+    conn = server;
+    if (type == SOCK_STREAM) {
+        err = conn = socket_accept(server, NULL, NULL);
+        if (conn < 0) goto out;
+        set_timeout(conn, true);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        message[0] = (uint8_t)i;
+        uint64_t start = cpu_rdtsc();
+        err = sys_send(client, message, size, 0);
+        if (err >= 0 && (uint32_t)err != size) err = -EMSGSIZE;
+        if (err >= 0) err = server_echo(conn, size);
+        if (err >= 0) err = client_recv(client, size);
+        if (err < 0) goto out;
+        samples[i] = (uint32_t)(cpu_rdtsc() - start);
+        if (message[0] != (uint8_t)i) {
+            err = -EIO;
+            goto out;
+        }
+    }
+    err = 0;
+
+out:
+    if (client >= 0) sys_close(client);
+    if (conn >= 0 && conn != server) socket_close(conn);
+    if (server >= 0) socket_close(server);
+    return err;
+}
+
+static void print_latency(const char* label, uint32_t cycles) {
+    uint64_t ns = cpu_tsc_to_ns(cycles);
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts("  ");
+    vga_puts(label);
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    if (ns < 100000) {
+        vga_putdec((uint32_t)ns, 0);
+        vga_puts(" ns\n");
+    } else {
+        vga_putdec((uint32_t)div_u64(ns, 1000), 0);
+        vga_puts(" us\n");
+    }
+}
+
+void netbench_command(const char *args) {
+    char *arg = args ? strtok((char *)args, " ") : NULL;
+    int type = SOCK_DGRAM;
+    uint32_t count = NETBENCH_DEFAULT_COUNT;
+    uint32_t size = NETBENCH_DEFAULT_SIZE;
+
+    if (arg && (strcmp(arg, "udp") == 0 || strcmp(arg, "tcp") == 0)) {
+        if (arg[0] == 't') type = SOCK_STREAM;
+        arg = strtok(NULL, " ");
+    }
+    if (arg) {
+        count = parse_uint(arg, NETBENCH_MAX_COUNT);
+        arg = strtok(NULL, " ");
+    }
+    if (arg) size = parse_uint(arg, NETBENCH_MAX_SIZE);
+    if (count == 0 || count > NETBENCH_MAX_COUNT || size == 0 || size > NETBENCH_MAX_SIZE) {
+        vga_puts("Usage: netbench [udp|tcp] [count] [size]   Echo round trips over loopback\n");
+        vga_puts("       count 1-1000000, size 1-8192 bytes\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    uint32_t* samples = kmalloc(count * sizeof(uint32_t));
+    if (!samples) {
+        vga_puts("netbench: out of memory\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    vga_puts("Echo benchmark: ");
+    vga_putdec(count, 0);
+    vga_puts(type == SOCK_STREAM ? " TCP" : " UDP");
+    vga_puts(" round trips of ");
+    vga_putdec(size, 0);
+    vga_puts(" bytes over 127.0.0.1\n");
+
+    skb_stats_t before, after;
+    skb_get_stats(&before);
+    uint64_t start = cpu_rdtsc();
+    int err = run(type, count, size, samples);
+    uint64_t total_ns = cpu_tsc_to_ns(cpu_rdtsc() - start);
+    skb_get_stats(&after);
+
+    if (err) {
+        vga_puts("netbench: ");
+        vga_puts(vfs_strerror(err));
+        vga_putchar('\n');
+        kfree(samples);
+        last_exit_status = 1;
+        return;
+    }
+
+    uint32_t us = (uint32_t)div_u64(total_ns, 1000);
+    if (!us) us = 1;
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts("  messages/s ");
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    vga_putdec((uint32_t)div_u64((uint64_t)count * 1000000ull, us), 0);
+    vga_puts("  (");
+    vga_putdec((uint32_t)div_u64((uint64_t)count * size * 2, us), 0);
+    vga_puts(" MB/s both ways)\n");
+
+    sort_u32(samples, count);
+    print_latency("p50        ", sort_percentile_u32(samples, count, 500));
+    print_latency("p90        ", sort_percentile_u32(samples, count, 900));
+    print_latency("p99        ", sort_percentile_u32(samples, count, 990));
+    print_latency("p99.9      ", sort_percentile_u32(samples, count, 999));
+    print_latency("max        ", samples[count - 1]);
+
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_puts("skb: ");
+    vga_putdec(after.allocs - before.allocs, 0);
+    vga_puts(" allocated, ");
+    vga_putdec(after.total, 0);
+    vga_puts(" in pool, ");
+    vga_putdec(after.failures - before.failures, 0);
+    vga_puts(" failures\n");
+
+    kfree(samples);
+    last_exit_status = 0;
+}
@@ -0,0 +1,113 @@
+#include "../include/shell/shell.h"
+#include "../include/shell/cmdutil.h"
+#include "../include/video/vga.h"
+#include "../include/kernel/arch/x86/pmu.h"
+#include "../include/kernel/time/clocksource.h"
+#include "../include/lib/string.h"
+#include "../include/lib/math64.h"
+
+// perfstat <command> [args]: run a shell command with the hardware
+// counters on and report what it cost, perf stat style. The counters are
+// on only around the command itself, so the figures include whatever
+// interrupts arrive while it runs but none of the shell's own work.
+
+// num/den with two decimals: scale 100 for a ratio, 10000 for a percentage
+static void print_ratio(uint64_t num, uint64_t den, uint32_t scale) {
+    uint64_t hundredths = den ? div64_u64(num * scale, den) : 0;
+    vga_putdec((uint32_t)div_u64(hundredths, 100), 0);
+    vga_putchar('.');
+    vga_putdec((uint32_t)(hundredths - div_u64(hundredths, 100) * 100), 2);
+}
+
+static void print_event(const pmu_counters_t* pc, pmu_event_t e) {
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    if (pc->counting & PMU_EVENT_BIT(e)) {
+        print_u64(pmu_counters_read(pc, e), 16);
+    } else {
+        vga_puts("   <not counted>");
+    }
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts("  ");
+    vga_puts(pmu_event_name(e));
+}
+
+static void print_note(const char* text) {
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_puts(text);
+}
+
+void perfstat_command(const char *args) {
+    char *name = args ? strtok((char *)args, " ") : NULL;
+    char *rest = name ? strtok(NULL, "\0") : NULL;
+    const Command *cmd = name ? find_command(name) : NULL;
+    if (!cmd) {
+        vga_puts(name ? "perfstat: command not found\n" : "Usage: perfstat <command> [args]\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    pmu_counters_t pc;
+    bool counting = pmu_counters_init(&pc, PMU_EVENTS_ALL) == 0 && pmu_counters_enable(&pc) == 0;
+
+    uint64_t start = ktime_get_ns();
+    cmd->func(rest);
+    uint64_t elapsed = ktime_get_ns() - start;
+    int status = last_exit_status;
+
+    if (counting) pmu_counters_disable(&pc);
+
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_puts("\n Performance counters for '");
+    vga_puts(name);
+    vga_puts("':\n\n");
+
+    if (counting) {
+        uint64_t cycles = pmu_counters_read(&pc, PMU_EVENT_CYCLES);
+        uint64_t insns = pmu_counters_read(&pc, PMU_EVENT_INSTRUCTIONS);
+
+        print_event(&pc, PMU_EVENT_CYCLES);
+        vga_putchar('\n');
+        print_event(&pc, PMU_EVENT_INSTRUCTIONS);
+        if (cycles && (pc.counting & PMU_EVENT_BIT(PMU_EVENT_INSTRUCTIONS))) {
+            print_note("    # ");
+            print_ratio(insns, cycles, 100);
+            print_note(" insn per cycle");
+        }
+        vga_putchar('\n');
+        print_event(&pc, PMU_EVENT_REF_CYCLES);
+        vga_putchar('\n');
+        print_event(&pc, PMU_EVENT_LLC_REFERENCES);
+        vga_putchar('\n');
+        print_event(&pc, PMU_EVENT_LLC_MISSES);
+        if (pc.counting & PMU_EVENT_BIT(PMU_EVENT_LLC_REFERENCES)) {
+            print_note("    # ");
+            print_ratio(pmu_counters_read(&pc, PMU_EVENT_LLC_MISSES),
+                        pmu_counters_read(&pc, PMU_EVENT_LLC_REFERENCES), 10000);
+            print_note("% of LLC references");
+        }
+        vga_putchar('\n');
+        print_event(&pc, PMU_EVENT_BRANCHES);
+        vga_putchar('\n');
+        print_event(&pc, PMU_EVENT_BRANCH_MISSES);
+        if (pc.counting & PMU_EVENT_BIT(PMU_EVENT_BRANCHES)) {
+            print_note("    # ");
+            print_ratio(pmu_counters_read(&pc, PMU_EVENT_BRANCH_MISSES),
+                        pmu_counters_read(&pc, PMU_EVENT_BRANCHES), 10000);
+            print_note("% of all branches");
+        }
+        vga_putchar('\n');
+    } else {
+        print_note("   (no architectural PMU on this CPU: elapsed time only)\n");
+    }
+
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    uint32_t ns;
+    uint64_t secs = div_u64_rem(elapsed, 1000000000, &ns);
+    vga_puts("\n   ");
+    print_u64(secs, 0);
+    vga_putchar('.');
+    vga_putdec(ns, 9);
+    print_note(" seconds elapsed\n");
+
+    last_exit_status = status;
+}
@@ -0,0 +1,304 @@
+#include "../include/shell/shell.h"
+#include "../include/shell/cmdutil.h"
+#include "../include/video/vga.h"
+#include "../include/serial/serial.h"
+#include "../include/kernel/perf/profile.h"
+#include "../include/kernel/panic/ksym.h"
+#include "../include/mm/kmalloc.h"
+#include "../include/lib/string.h"
+#include "../include/lib/math64.h"
+#include "../include/lib/errno.h"
+
+// profile start [hz | <event> [period]] | stop | report [n] | folded
+//
+// 'report' charges each sample to the function it landed in (self) and
+// once to every function on its call chain (total). 'folded' writes one
+// "outer;...;inner 1" line per sample to COM1, the input format of
+// flamegraph.pl and speedscope; the host side adds up repeats.
+#define PROFILE_REPORT_DEFAULT 20
+#define PROFILE_REPORT_MAX     200
+
+typedef struct {
+    uint32_t* self;               // Per symbol index
+    uint32_t* total;
+    uint32_t samples;
+    uint32_t unknown;             // Landed outside the symbol table
+} profile_report_t;
+
+// count/samples as a percentage with two decimals, 7 columns wide
+static void print_percent(uint32_t count, uint32_t samples) {
+    uint32_t hundredths = samples ? (uint32_t)div_u64((uint64_t)count * 10000, samples) : 0;
+    print_padded(hundredths / 100, 3);
+    vga_putchar('.');
+    vga_putdec(hundredths % 100, 2);
+    vga_putchar('%');
+}
+
+static void print_seconds(uint64_t ns) {
+    uint32_t rem;
+    uint64_t secs = div_u64_rem(ns, 1000000000, &rem);
+    vga_putdec((uint32_t)secs, 0);
+    vga_putchar('.');
+    vga_putdec(rem / 1000000, 3);
+    vga_puts(" s");
+}
+
+static void print_source(const profile_stats_t* st) {
+    if (st->source == PROFILE_SOURCE_TIMER) {
+        vga_putdec(1000000000u / st->period, 0);
+        vga_puts(" Hz timer");
+    } else {
+        vga_puts("every ");
+        vga_putdec(st->period, 0);
+        vga_putchar(' ');
+        vga_puts(pmu_event_name(st->event));
+    }
+}
+
+static int find_event(const char* name) {
+    for (int e = 0; e < PMU_EVENT_MAX; e++) {
+        if (strcmp(pmu_event_name(e), name) == 0) return e;
+    }
+    return -1;
+}
+
+// A return address points after the call, which may be past the end of
+// the caller when the call is its last instruction
+static int caller_index(uint32_t return_addr) {
+    return ksym_index(return_addr - 1);
+}
+
+static void account_sample(const profile_sample_t* sample, void* ctx) {
+    profile_report_t* r = ctx;
+    int seen[PROFILE_MAX_DEPTH + 1];
+    uint32_t nseen = 0;
+
+    r->samples++;
+    int index = ksym_index(sample->eip);
+    if (index < 0) {
+        r->unknown++;
+    } else {
+        r->self[index]++;
+        r->total[index]++;
+        seen[nseen++] = index;
+    }
+
+    // Recursion puts a function on the chain more than once; count it once
+    for (uint32_t d = 0; d < sample->depth; d++) {
+        index = caller_index(sample->callers[d]);
+        if (index < 0) continue;
+        uint32_t i = 0;
+        while (i < nseen && seen[i] != index) i++;
+        if (i < nseen) continue;
+        r->total[index]++;
+        seen[nseen++] = index;
+    }
+}
+
+static void profile_report(uint32_t limit) {
+    profile_stats_t st;
+    profile_report_t r = { NULL, NULL, 0, 0 };
+    uint32_t nsyms = ksym_total();
+
+    profile_get_stats(&st);
+    if (st.running) {
+        vga_puts("profile: still running, 'profile stop' first\n");
+        last_exit_status = 1;
+        return;
+    }
+    if (!st.taken) {
+        vga_puts("profile: no samples, run 'profile start' first\n");
+        last_exit_status = 1;
+        return;
+    }
+    if (nsyms) {
+        r.self = kzalloc(nsyms * sizeof(uint32_t));
+        r.total = kzalloc(nsyms * sizeof(uint32_t));
+        if (!r.self || !r.total) {
+            kfree(r.self);
+            kfree(r.total);
+            vga_puts("profile: out of memory\n");
+            last_exit_status = 1;
+            return;
+        }
+    }
+    profile_for_each(account_sample, &r);
+
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_puts("Samples: ");
+    vga_putdec(st.taken, 0);
+    vga_puts(" (");
+    print_source(&st);
+    vga_puts(", ");
+    print_seconds(st.elapsed_ns);
+    vga_puts(")");
+    if (st.held < st.taken) {
+        vga_puts(", newest ");
+        vga_putdec(st.held, 0);
+        vga_puts(" kept");
+    }
+    vga_puts("\n\n   Self    Total  Samples  Function\n");
+
+    // Highest self count first; a picked entry is zeroed so it is not
+    // picked again
+    for (uint32_t n = 0; n < limit; n++) {
+        uint32_t best = 0, best_self = 0;
+        for (uint32_t i = 0; i < nsyms; i++) {
+            if (r.self[i] > best_self) {
+                best = i;
+                best_self = r.self[i];
+            }
+        }
+        if (!best_self) break;
+
+        ksym_t sym;
+        ksym_get(best, &sym);
+        vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+        print_percent(best_self, r.samples);
+        vga_putchar(' ');
+        print_percent(r.total[best], r.samples);
+        print_padded(best_self, 9);
+        vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+        vga_puts("  ");
+        vga_puts(sym.name);
+        vga_putchar('\n');
+        r.self[best] = 0;
+    }
+    if (r.unknown) {
+        vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+        print_percent(r.unknown, r.samples);
+        vga_puts("        -");
+        print_padded(r.unknown, 9);
+        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        vga_puts("  [outside kernel text]\n");
+    }
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    kfree(r.self);
+    kfree(r.total);
+    last_exit_status = 0;
+}
+
+static void emit_frame(uint32_t addr) {
+    ksym_t sym;
+    if (ksym_lookup(addr, &sym)) {
+        serial_puts(sym.name);
+    } else {
+        serial_puthex(addr);
+    }
+}
+
+static void emit_folded(const profile_sample_t* sample, void* ctx) {
+    (void)ctx;
+    for (uint32_t d = sample->depth; d-- > 0; ) {
+        emit_frame(sample->callers[d] - 1);
+        serial_putchar(';');
+    }
+    emit_frame(sample->eip);
+    serial_puts(" 1\n");
+}
+
+static void profile_folded(void) {
+    if (!serial_available()) {
+        vga_puts("profile: no serial port\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    int n = profile_for_each(emit_folded, NULL);
+    if (n < 0) {
+        vga_puts("profile: still running, 'profile stop' first\n");
+        last_exit_status = 1;
+        return;
+    }
+    vga_putdec(n, 0);
+    vga_puts(" stacks written to COM1\n");
+    last_exit_status = 0;
+}
+
+static void profile_start(char* arg) {
+    int err;
+    char* period_arg = arg ? strtok(NULL, " ") : NULL;
+    int event = arg ? find_event(arg) : -1;
+
+    if (event >= 0) {
+        uint32_t period = period_arg ? parse_uint(period_arg, 100000000) : PROFILE_DEFAULT_PERIOD;
+        err = period ? profile_start_pmu(event, period) : -EINVAL;
+    } else {
+        uint32_t hz = arg ? parse_uint(arg, PROFILE_MAX_HZ) : PROFILE_DEFAULT_HZ;
+        err = period_arg ? -EINVAL : profile_start_timer(hz);
+    }
+
+    switch (err) {
+    case 0: {
+        profile_stats_t st;
+        profile_get_stats(&st);
+        vga_puts("Profiling: ");
+        print_source(&st);
+        vga_putchar('\n');
+        last_exit_status = 0;
+        return;
+    }
+    case -EBUSY:
+        vga_puts("profile: already running, or the PMU is in use\n");
+        break;
+    case -ENODEV:
+        vga_puts(event >= 0 ? "profile: no PMU interrupt on this machine\n"
+                            : "profile: no timer interrupt on this machine\n");
+        break;
+    case -ENOENT:
+        vga_puts("profile: this CPU does not count that event\n");
+        break;
+    case -ENOMEM:
+        vga_puts("profile: out of memory\n");
+        break;
+    default:
+        vga_puts("Usage: profile start [hz (1-20000) | <event> [period]]\n");
+        break;
+    }
+    last_exit_status = 1;
+}
+
+static void profile_usage(void) {
+    vga_puts("Usage: profile start [hz | <event> [period]]   Sample the timer or a PMU event\n");
+    vga_puts("       profile stop\n");
+    vga_puts("       profile report [n]                       Top functions by samples\n");
+    vga_puts("       profile folded                           Folded stacks to COM1\n");
+    last_exit_status = 1;
+}
+
+void profile_command(const char *args) {
+    char *cmd = args ? strtok((char *)args, " ") : NULL;
+    char *arg = cmd ? strtok(NULL, " ") : NULL;
+
+    if (!cmd) {
+        profile_usage();
+    } else if (strcmp(cmd, "start") == 0) {
+        profile_start(arg);
+    } else if (strcmp(cmd, "stop") == 0) {
+        if (profile_stop() != 0) {
+            vga_puts("profile: not running\n");
+            last_exit_status = 1;
+            return;
+        }
+        profile_stats_t st;
+        profile_get_stats(&st);
+        vga_putdec(st.taken, 0);
+        vga_puts(" samples in ");
+        print_seconds(st.elapsed_ns);
+        vga_putchar('\n');
+        last_exit_status = 0;
+    } else if (strcmp(cmd, "report") == 0) {
+        uint32_t limit = arg ? parse_uint(arg, PROFILE_REPORT_MAX) : PROFILE_REPORT_DEFAULT;
+        if (!limit || limit > PROFILE_REPORT_MAX) {
+            vga_puts("Usage: profile report [n (1-200)]\n");
+            last_exit_status = 1;
+        } else {
+            profile_report(limit);
+        }
+    } else if (strcmp(cmd, "folded") == 0) {
+        profile_folded();
+    } else {
+        profile_usage();
+    }
+}
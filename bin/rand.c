@@ -1,14 +1,12 @@
 #include "../include/shell/shell.h"
+#include "../include/shell/cmdutil.h"
 #include "../include/video/vga.h"
 
 // Xorshift32 PRNG (fast and decent randomness)
-static unsigned int rand_state = 1;
+static uint32_t rand_state = 1;
 
 unsigned int rand(void) {
-    rand_state ^= rand_state << 13;
-    rand_state ^= rand_state >> 17;
-    rand_state ^= rand_state << 5;
-    return rand_state;
+    return xorshift32(&rand_state);
 }
 
 // Convert unsigned int to string
@@ -0,0 +1,70 @@
+#include "../include/shell/shell.h"
+#include "../include/video/vga.h"
+#include "../include/fs/vfs.h"
+#include "../include/lib/string.h"
+
+static void stat_label(const char *label) {
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts(label);
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+}
+
+static void stat_put_octal(uint32_t value) {
+    char buf[5];
+    for (int i = 3; i >= 0; i--) {
+        buf[i] = '0' + (value & 7);
+        value >>= 3;
+    }
+    buf[4] = '\0';
+    vga_puts(buf);
+}
+
+static const char *stat_type_name(uint32_t type) {
+    switch (type) {
+        case VFS_TYPE_FILE: return "regular file";
+        case VFS_TYPE_DIR:  return "directory";
+        case VFS_TYPE_DEV:  return "device";
+        default:            return "unknown";
+    }
+}
+
+void stat_command(const char *args) {
+    if (args == NULL || *args == '\0') {
+        vga_puts("stat: missing operand\nUsage: stat <path>\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    while (*args == ' ') args++;
+
+    vfs_stat_t st;
+    int err = vfs_stat(args, &st);
+    if (err) {
+        vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+        vga_puts("stat: cannot stat '");
+        vga_puts(args);
+        vga_puts("': ");
+        vga_puts(vfs_strerror(err));
+        vga_putchar('\n');
+        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        last_exit_status = 1;
+        return;
+    }
+
+    stat_label("  File: ");   vga_puts(args); vga_putchar('\n');
+    stat_label("  Size: ");   vga_putdec(st.size, 0);
+    stat_label("  Blocks: "); vga_putdec(st.blocks, 0);
+    stat_label("  IO Block: "); vga_putdec(st.blksize, 0);
+    vga_puts("  ");
+    vga_puts(stat_type_name(st.type));
+    vga_putchar('\n');
+    stat_label("Device: ");   vga_putdec(st.dev, 0);
+    stat_label("  Inode: ");  vga_putdec(st.ino, 0);
+    stat_label("  Links: ");  vga_putdec(st.nlink, 0);
+    vga_putchar('\n');
+    stat_label("Access: (");  stat_put_octal(st.mode);
+    vga_puts(")  Uid: (0/root)  Gid: (0/root)\n");
+
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    last_exit_status = 0;
+}
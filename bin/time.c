@@ -1,81 +1,90 @@
 #include "../include/shell/shell.h"
 #include "../include/video/vga.h"
-#include "../include/kernel/rtc/rtc.h"
+#include "../include/kernel/time/clocksource.h"
+#include "../include/lib/calendar.h"
 #include "../include/lib/string.h"
 
+// Everything here works on seconds since 1970: a zone is an offset, and
+// daylight saving is a pair of transition instants worked out in closed
+// form for the current year.
+
+enum dst_rule { DST_NONE, DST_EU, DST_US };
+
+struct timezone {
+    const char *name;
+    int32_t offset;            // Standard time, seconds east of UTC
+    enum dst_rule dst;
+    const char *std_label;
+    const char *dst_label;
+};
+
+static const struct timezone timezones[] = {
+    {"de", 3600,       DST_EU,   "CET Time:",  "CEST Time:"},
+    {"us", -5 * 3600,  DST_US,   "EST Time:",  "EDT Time:"},
+    {"jp", 9 * 3600,   DST_NONE, "JST Time:",  NULL},
+    {"in", 19800,      DST_NONE, "IST Time:",  NULL},
+    {"uk", 0,          DST_EU,   "GMT Time:",  "BST Time:"},
+};
+
 // Function to display time in a formatted way
-void display_time(const struct rtc_date *date, const char *label) {
+static void display_time(uint32_t t, const char *label) {
+    uint32_t s = t % SECS_PER_DAY;
     vga_puts(label);
     vga_putchar(' ');
-    vga_putdec(date->hour, 2);
+    vga_putdec(s / 3600, 2);
     vga_putchar(':');
-    vga_putdec(date->minute, 2);
+    vga_putdec(s / 60 % 60, 2);
     vga_putchar(':');
-    vga_putdec(date->second, 2);
-
-    if (!date->is_24hour) {
-        vga_puts(date->is_pm ? " PM" : " AM");
-    }
+    vga_putdec(s % 60, 2);
     vga_puts("\n");
 }
 
-// Function to check if the given timezone is valid
-int is_valid_timezone(const char *timezone) {
-    const char *valid_timezones[] = {"de", "us", "jp", "in", "uk"};
-    for (int i = 0; i < sizeof(valid_timezones) / sizeof(valid_timezones[0]); i++) {
-        if (strcmp(timezone, valid_timezones[i]) == 0) {
-            return 1;
-        }
-    }
-    return 0;
+// Day number of the last Sunday on or before the given date
+static int32_t sunday_before(int32_t year, uint32_t month, uint32_t day) {
+    int32_t days = days_from_civil(year, month, day);
+    return days - (int32_t)weekday_from_days(days);
 }
 
-// Function to get the timezone offset and label
-void get_timezone_info(const char *timezone, struct rtc_date *date, int *offset, const char **label) {
-    if (strcmp(timezone, "de") == 0) {
-        // Germany timezone (CET/CEST)
-        *offset = is_dst_eu(date->month, date->day, date->year) ? 2 : 1;
-        *label = is_dst_eu(date->month, date->day, date->year) ? "CEST Time:" : "CET Time:";
-    } else if (strcmp(timezone, "us") == 0) {
-        // US Eastern timezone (EST/EDT)
-        *offset = is_dst_us(date->month, date->day, date->year) ? -4 : -5;
-        *label = is_dst_us(date->month, date->day, date->year) ? "EDT Time:" : "EST Time:";
-    } else if (strcmp(timezone, "jp") == 0) {
-        // Japan timezone (JST)
-        *offset = 9;
-        *label = "JST Time:";
-    } else if (strcmp(timezone, "in") == 0) {
-        // India timezone (IST)
-        *offset = 5;
-        *label = "IST Time:";
-    } else if (strcmp(timezone, "uk") == 0) {
-        // UK timezone (GMT/BST)
-        *offset = is_dst_eu(date->month, date->day, date->year) ? 1 : 0;
-        *label = is_dst_eu(date->month, date->day, date->year) ? "BST Time:" : "GMT Time:";
+static bool in_dst(enum dst_rule rule, uint32_t utc) {
+    int32_t year;
+    uint32_t month, day;
+    civil_from_days(utc / SECS_PER_DAY, &year, &month, &day);
+
+    uint32_t start, end;
+    if (rule == DST_EU) {
+        // 01:00 UTC on the last Sundays of March and October
+        start = sunday_before(year, 3, 31) * SECS_PER_DAY + 3600;
+        end = sunday_before(year, 10, 31) * SECS_PER_DAY + 3600;
+    } else if (rule == DST_US) {
+        // 02:00 local on the second Sunday of March and the first of
+        // November: 07:00 and 06:00 UTC on the east coast
+        start = sunday_before(year, 3, 14) * SECS_PER_DAY + 7 * 3600;
+        end = sunday_before(year, 11, 7) * SECS_PER_DAY + 6 * 3600;
+    } else {
+        return false;
     }
+    return utc >= start && utc < end;
 }
 
 // Main time command function
 void time_command(const char *args) {
-    struct rtc_date date;
-    rtc_read_full(&date);
+    uint32_t now = ktime_get_real_seconds();
 
     // Display UTC time
-    display_time(&date, "UTC Time:");
+    display_time(now, "UTC Time:");
 
     // Handle timezone arguments
     if (args != NULL) {
-        if (!is_valid_timezone(args)) {
+        const struct timezone *tz = NULL;
+        for (size_t i = 0; i < sizeof(timezones) / sizeof(timezones[0]); i++) {
+            if (strcmp(args, timezones[i].name) == 0) tz = &timezones[i];
+        }
+        if (!tz) {
             vga_puts("Invalid timezone. Use 'de' for Germany, 'us' for US, 'jp' for Japan, 'in' for India, or 'uk' for UK\n");
             return;
         }
 
-        struct rtc_date local = date;
-        int offset;
-        const char *label;
-
-        get_timezone_info(args, &local, &offset, &label);
-        rtc_adjust_timezone(&local, offset);
-        display_time(&local, label);
+        bool dst = in_dst(tz->dst, now);
+        display_time(now + tz->offset + (dst ? 3600 : 0), dst ? tz->dst_label : tz->std_label);
     }
 }
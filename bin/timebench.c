@@ -0,0 +1,107 @@
+#include "../include/shell/shell.h"
+#include "../include/shell/cmdutil.h"
+#include "../include/video/vga.h"
+#include "../include/kernel/time/vdso.h"
+#include "../include/kernel/time/clocksource.h"
+#include "../include/kernel/syscall/syscall.h"
+#include "../include/kernel/arch/x86/cpu.h"
+#include "../include/lib/time.h"
+#include "../include/lib/string.h"
+#include "../include/lib/math64.h"
+
+// Cost of reading the clock from user code: clock_gettime() off the time
+// page against the int 0x80 system call, with a bare rdtsc for scale. The
+// page is then checked against the kernel's own clock by reading both in
+// turn. They share a base, so apart from the nanosecond the kernel may
+// round away at a fold, neither may come out ahead of a later read.
+#define TIMEBENCH_DEFAULT_COUNT 100000
+#define TIMEBENCH_MAX_COUNT     10000000
+#define TIMEBENCH_CHECKS        10000
+
+// Tenths of a nanosecond per call
+static uint32_t per_call(uint64_t start, uint64_t end, uint32_t count) {
+    return (uint32_t)div_u64(cpu_tsc_to_ns(end - start) * 10, count);
+}
+
+static void print_result(const char* label, uint32_t tenths, uint32_t base) {
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts("  ");
+    vga_puts(label);
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    vga_putdec(tenths / 10, 0);
+    vga_putchar('.');
+    vga_putdec(tenths % 10, 0);
+    vga_puts(" ns/call");
+    if (base && tenths) {
+        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        vga_puts("  (x");
+        vga_putdec(base / tenths, 0);
+        vga_puts(" faster than the syscall)");
+    }
+    vga_putchar('\n');
+}
+
+void timebench_command(const char *args) {
+    char *arg = args ? strtok((char *)args, " ") : NULL;
+    uint32_t count = arg ? parse_uint(arg, TIMEBENCH_MAX_COUNT) : TIMEBENCH_DEFAULT_COUNT;
+    if (count == 0 || count > TIMEBENCH_MAX_COUNT) {
+        vga_puts("Usage: timebench [count]   Time clock_gettime via the time page and the syscall\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    struct timespec ts;
+    volatile uint64_t sink = 0;
+    uint64_t start, end;
+
+    start = cpu_rdtsc();
+    for (uint32_t i = 0; i < count; i++) sink += cpu_rdtsc();
+    end = cpu_rdtsc();
+    uint32_t rdtsc_cost = per_call(start, end, count);
+
+    start = cpu_rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        sink += ts.tv_nsec;
+    }
+    end = cpu_rdtsc();
+    uint32_t page_cost = per_call(start, end, count);
+
+    start = cpu_rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        sys_clock_gettime(CLOCK_MONOTONIC, &ts);
+        sink += ts.tv_nsec;
+    }
+    end = cpu_rdtsc();
+    uint32_t syscall_cost = per_call(start, end, count);
+
+    // Page, kernel, page: each read must be no earlier than the one before
+    uint32_t backwards = 0;
+    for (uint32_t i = 0; i < TIMEBENCH_CHECKS; i++) {
+        uint64_t a = clock_gettime_ns(CLOCK_MONOTONIC);
+        uint64_t b = ktime_get_ns();
+        uint64_t c = clock_gettime_ns(CLOCK_MONOTONIC);
+        if (b + 1 < a || c + 1 < b) backwards++;
+    }
+
+    bool fast = vdso_time_page.mode == VDSO_CLOCK_TSC;
+    clocksource_t* cs = clocksource_current();
+
+    vga_puts("clock_gettime(CLOCK_MONOTONIC), ");
+    vga_putdec(count, 0);
+    vga_puts(" calls each, clock source ");
+    vga_puts(cs ? cs->name : "none");
+    vga_puts(fast ? "\n" : " (no time page: calls fall back to the syscall)\n");
+
+    print_result("rdtsc        ", rdtsc_cost, 0);
+    print_result("time page    ", page_cost, fast ? syscall_cost : 0);
+    print_result("int 0x80     ", syscall_cost, 0);
+
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_putdec(backwards, 0);
+    vga_puts(" of ");
+    vga_putdec(TIMEBENCH_CHECKS, 0);
+    vga_puts(" page/kernel/page reads out of order\n");
+
+    last_exit_status = backwards ? 1 : 0;
+}
@@ -0,0 +1,148 @@
+#include "../include/shell/shell.h"
+#include "../include/shell/cmdutil.h"
+#include "../include/video/vga.h"
+#include "../include/kernel/time/hrtimer.h"
+#include "../include/kernel/time/clocksource.h"
+#include "../include/kernel/arch/x86/irq.h"
+#include "../include/kernel/arch/x86/cpu.h"
+#include "../include/mm/kmalloc.h"
+#include "../include/lib/string.h"
+#include "../include/lib/math64.h"
+#include "../include/lib/sort.h"
+
+// Wakeup latency of one-shot timers. Each sample arms a timer somewhere
+// between 10 us and 10 ms out (log-spread, so every decade is covered),
+// halts, and records how late the callback ran against the expiry it
+// was given. The interrupt count should track the sample count: there
+// is no tick underneath, only the odd idle housekeeping wakeup.
+#define TIMERLAT_DEFAULT_COUNT 1000
+#define TIMERLAT_MAX_COUNT     100000
+#define TIMERLAT_MIN_NS        10000
+#define TIMERLAT_MAX_NS        10000000
+#define TIMERLAT_BUCKETS       10
+
+static const uint32_t bucket_limit_ns[TIMERLAT_BUCKETS - 1] = {
+    1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000,
+};
+
+static const char* const bucket_label[TIMERLAT_BUCKETS] = {
+    "   < 1 us", "   < 2 us", "   < 5 us", "  < 10 us", "  < 20 us",
+    "  < 50 us", " < 100 us", " < 200 us", " < 500 us", ">= 500 us",
+};
+
+static volatile uint64_t fired_at;
+
+static hrtimer_restart_t timerlat_fire(hrtimer_t* timer) {
+    (void)timer;
+    fired_at = ktime_get_ns();
+    return HRTIMER_NORESTART;
+}
+
+// 10 us << k for a random k, plus up to as much again
+static uint32_t pick_delay(uint32_t* rng) {
+    uint32_t base = TIMERLAT_MIN_NS << (xorshift32(rng) % 10);
+    uint32_t delay = base + xorshift32(rng) % base;
+    return delay > TIMERLAT_MAX_NS ? TIMERLAT_MAX_NS : delay;
+}
+
+static void print_latency(const char* label, uint32_t ns) {
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts("  ");
+    vga_puts(label);
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    if (ns < 100000) {
+        vga_putdec(ns, 0);
+        vga_puts(" ns\n");
+    } else {
+        vga_putdec(ns / 1000, 0);
+        vga_puts(" us\n");
+    }
+}
+
+static void print_histogram(const uint32_t* sorted, uint32_t n) {
+    uint32_t counts[TIMERLAT_BUCKETS] = {0};
+    uint32_t b = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        while (b < TIMERLAT_BUCKETS - 1 && sorted[i] >= bucket_limit_ns[b]) b++;
+        counts[b]++;
+    }
+
+    uint32_t most = 1;
+    for (b = 0; b < TIMERLAT_BUCKETS; b++) if (counts[b] > most) most = counts[b];
+    for (b = 0; b < TIMERLAT_BUCKETS; b++) {
+        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        vga_puts("  ");
+        vga_puts(bucket_label[b]);
+        print_padded(counts[b], 8);
+        vga_puts("  ");
+        vga_set_color(VGA_COLOR_GREEN, VGA_COLOR_BLACK);
+        uint32_t bar = (uint32_t)div_u64((uint64_t)counts[b] * 40 + most - 1, most);
+        for (uint32_t i = 0; i < bar; i++) vga_putchar('#');
+        vga_putchar('\n');
+    }
+}
+
+void timerlat_command(const char *args) {
+    char *arg = args ? strtok((char *)args, " ") : NULL;
+    uint32_t count = arg ? parse_uint(arg, TIMERLAT_MAX_COUNT) : TIMERLAT_DEFAULT_COUNT;
+    if (count == 0 || count > TIMERLAT_MAX_COUNT) {
+        vga_puts("Usage: timerlat [count]   Late wakeups of timers armed 10 us-10 ms out\n");
+        last_exit_status = 1;
+        return;
+    }
+    if (!hrtimer_can_wake()) {
+        vga_puts("timerlat: no timer interrupt on this machine\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    uint32_t* late = kmalloc(count * sizeof(uint32_t));
+    if (!late) {
+        vga_puts("timerlat: out of memory\n");
+        last_exit_status = 1;
+        return;
+    }
+
+    hrtimer_stats_t before, after;
+    hrtimer_t timer;
+    hrtimer_init(&timer, timerlat_fire, NULL);
+    uint32_t rng = (uint32_t)cpu_rdtsc() | 1;
+
+    vga_puts("Timer wakeup latency: ");
+    vga_putdec(count, 0);
+    vga_puts(" one-shot timers, 10 us to 10 ms out\n");
+
+    hrtimer_get_stats(&before);
+    for (uint32_t i = 0; i < count; i++) {
+        fired_at = 0;
+        uint64_t expires = ktime_get_ns() + pick_delay(&rng);
+        hrtimer_start(&timer, expires, HRTIMER_MODE_ABS);
+
+        uint32_t flags = irq_save();
+        while (!fired_at) cpu_sleep();
+        irq_restore(flags);
+
+        uint64_t ns = fired_at - expires;
+        late[i] = ns > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)ns;
+    }
+    hrtimer_get_stats(&after);
+
+    sort_u32(late, count);
+    print_histogram(late, count);
+    print_latency("p50        ", sort_percentile_u32(late, count, 500));
+    print_latency("p90        ", sort_percentile_u32(late, count, 900));
+    print_latency("p99        ", sort_percentile_u32(late, count, 990));
+    print_latency("max        ", late[count - 1]);
+
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_puts("via ");
+    vga_puts(after.mode);
+    vga_puts(": ");
+    vga_putdec(after.interrupts - before.interrupts, 0);
+    vga_puts(" interrupts, ");
+    vga_putdec(after.programmed - before.programmed, 0);
+    vga_puts(" armings\n");
+
+    kfree(late);
+    last_exit_status = 0;
+}
@@ -0,0 +1,135 @@
+#include "../include/shell/shell.h"
+#include "../include/video/vga.h"
+#include "../include/kernel/perf/trace.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+
+// trace start [group,...|all] | stop | status | list
+//
+// Records stream to COM1 while the shell idles. To look at them, run
+// under "make run" and convert the serial log on the host:
+//   scripts/trace2json.py serial.log > trace.json
+// then open trace.json in chrome://tracing or ui.perfetto.dev.
+
+// "mm,kb" or "all"; 0 if any name is unknown
+static uint32_t parse_groups(char* list) {
+    uint32_t groups = 0;
+    if (strcmp(list, "all") == 0) return TRACE_GROUPS_ALL;
+
+    while (*list) {
+        char* name = list;
+        while (*list && *list != ',') list++;
+        if (*list) *list++ = '\0';
+
+        uint32_t g = 0;
+        while (g < TRACE_GROUPS && strcmp(trace_group_name(g), name) != 0) g++;
+        if (g == TRACE_GROUPS) return 0;
+        groups |= TRACE_GROUP_BIT(g);
+    }
+    return groups;
+}
+
+static void print_groups(uint32_t groups) {
+    bool first = true;
+    for (uint32_t g = 0; g < TRACE_GROUPS; g++) {
+        if (!(groups & TRACE_GROUP_BIT(g))) continue;
+        if (!first) vga_putchar(',');
+        vga_puts(trace_group_name(g));
+        first = false;
+    }
+    if (first) vga_puts("none");
+}
+
+static void print_stats(void) {
+    trace_stats_t st;
+    trace_get_stats(&st);
+
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_puts("groups: ");
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    print_groups(st.groups);
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_puts("\nstreamed: ");
+    vga_putdec(st.written, 0);
+    vga_puts("  lost: ");
+    vga_putdec(st.lost, 0);
+    vga_puts("  pending: ");
+    vga_putdec(st.pending, 0);
+    vga_putchar('\n');
+}
+
+static void list_events(void) {
+    uint32_t count;
+    const trace_event_desc_t* descs = trace_event_descs(&count);
+
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    vga_puts("Group    Event       Ph  Arguments\n");
+    for (uint32_t i = 0; i < count; i++) {
+        const trace_event_desc_t* d = &descs[i];
+        vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+        vga_puts(d->group);
+        for (size_t n = strlen(d->group); n < 9; n++) vga_putchar(' ');
+        vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+        vga_puts(d->name);
+        for (size_t n = strlen(d->name); n < 12; n++) vga_putchar(' ');
+        vga_putchar(d->phase);
+        vga_puts("   ");
+        vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+        vga_puts(d->args);
+        vga_putchar('\n');
+    }
+}
+
+static void trace_usage(void) {
+    vga_puts("Usage: trace start [group,...|all]   Stream events to COM1\n");
+    vga_puts("       trace stop | status | list\n");
+    vga_puts("Groups: mm, kb, vga, syscall\n");
+    last_exit_status = 1;
+}
+
+void trace_command(const char *args) {
+    char *cmd = args ? strtok((char *)args, " ") : NULL;
+    char *arg = cmd ? strtok(NULL, " ") : NULL;
+
+    if (!cmd || strcmp(cmd, "status") == 0) {
+        print_stats();
+        last_exit_status = 0;
+    } else if (strcmp(cmd, "list") == 0) {
+        list_events();
+        last_exit_status = 0;
+    } else if (strcmp(cmd, "start") == 0) {
+        uint32_t groups = arg ? parse_groups(arg) : TRACE_GROUPS_ALL;
+        int err = groups ? trace_start(groups) : -EINVAL;
+        switch (err) {
+        case 0:
+            vga_puts("Tracing ");
+            print_groups(groups);
+            vga_puts(" to COM1\n");
+            last_exit_status = 0;
+            return;
+        case -EBUSY:
+            vga_puts("trace: already running\n");
+            break;
+        case -ENODEV:
+            vga_puts("trace: no serial port\n");
+            break;
+        case -ENOMEM:
+            vga_puts("trace: out of memory\n");
+            break;
+        default:
+            trace_usage();
+            return;
+        }
+        last_exit_status = 1;
+    } else if (strcmp(cmd, "stop") == 0) {
+        if (trace_stop() != 0) {
+            vga_puts("trace: not running\n");
+            last_exit_status = 1;
+            return;
+        }
+        print_stats();
+        last_exit_status = 0;
+    } else {
+        trace_usage();
+    }
+}
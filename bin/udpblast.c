@@ -0,0 +1,274 @@
+#include "../include/shell/shell.h"
+#include "../include/shell/cmdutil.h"
+#include "../include/video/vga.h"
+#include "../include/net/socket.h"
+#include "../include/net/netdev.h"
+#include "../include/net/ip.h"
+#include "../include/net/inet.h"
+#include "../include/kernel/arch/x86/cpu.h"
+#include "../include/lib/string.h"
+#include "../include/lib/math64.h"
+#include "../include/fs/vfs.h"
+#include "../include/lib/errno.h"
+
+// A one-way UDP stream, for measuring a link rather than round trips.
+// The sender builds each datagram in an skb and hands it down without a
+// copy, a burst at a time inside a transmit batch, so the NIC hears one
+// doorbell per burst. Datagrams carry a sequence number and the sink
+// counts what arrived and what went missing on the way.
+#define UDPBLAST_PORT            9000
+#define UDPBLAST_DEFAULT_SECONDS 5
+#define UDPBLAST_MAX_SECONDS     60
+#define UDPBLAST_DEFAULT_SIZE    64
+#define UDPBLAST_MIN_SIZE        4      // Room for the sequence number
+#define UDPBLAST_BURST           32
+#define UDPBLAST_IDLE_MS         1000   // The sink stops after this long without data
+#define UDPBLAST_RCVBUF          (1u << 20)
+
+typedef struct {
+    uint32_t packets;
+    uint32_t lost;                      // Sink: sequence gaps
+    uint32_t dropped;                   // Sender: ring full or out of skbs
+    uint64_t bytes;
+    uint64_t ns;
+} blast_result_t;
+
+static netdev_stats_t before[NETDEV_MAX];
+
+static int blast(uint32_t daddr, uint16_t port, uint32_t seconds, uint32_t size,
+                 blast_result_t* r) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr = daddr;
+
+    int fd = socket_create(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return fd;
+    int err = socket_connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+    if (err) goto out;
+
+    uint64_t limit = (uint64_t)seconds * 1000000000ull;
+    uint64_t start = cpu_rdtsc();
+    uint32_t seq = 0;
+
+    while (cpu_tsc_to_ns(cpu_rdtsc() - start) < limit) {
+        net_tx_batch_begin();
+        for (int i = 0; i < UDPBLAST_BURST; i++) {
+            sk_buff_t* skb = skb_alloc();
+            if (!skb) {
+                r->dropped++;
+                break;
+            }
+            uint8_t* payload = skb_put(skb, size);
+            memset(payload, 0, size);
+            memcpy(payload, &seq, sizeof(seq));
+            seq++;
+
+            err = socket_send_skb(fd, skb, 0, NULL);
+            if (err == -ENOBUFS) {
+                r->dropped++;
+            } else if (err < 0) {
+                net_tx_batch_end();
+                goto out;
+            } else {
+                r->packets++;
+                r->bytes += size;
+            }
+        }
+        net_tx_batch_end();
+
+        // Completions, and the ARP reply for the first burst
+        net_poll();
+    }
+    r->ns = cpu_tsc_to_ns(cpu_rdtsc() - start);
+    err = 0;
+
+out:
+    socket_close(fd);
+    return err;
+}
+
+static int sink(uint16_t port, uint32_t seconds, blast_result_t* r) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr = INADDR_ANY;
+
+    int fd = socket_create(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return fd;
+
+    uint32_t v = UDPBLAST_RCVBUF;
+    socket_setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &v, sizeof(v));
+    v = UDPBLAST_IDLE_MS;
+    socket_setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &v, sizeof(v));
+    int err = socket_bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    if (err) goto out;
+
+    // Wait for the stream to start, then time it from its first packet
+    uint64_t start = cpu_rdtsc(), first = 0, last = 0;
+    uint64_t limit = (uint64_t)seconds * 1000000000ull;
+    uint32_t expected = 0;
+
+    for (;;) {
+        sk_buff_t* skb;
+        int n = socket_recv_skb(fd, &skb, 0, NULL);
+        uint64_t now = cpu_rdtsc();
+        if (n == -EAGAIN) {
+            if (first) break;
+            if (cpu_tsc_to_ns(now - start) >= UDPBLAST_MAX_SECONDS * 1000000000ull) {
+                err = -ETIMEDOUT;
+                goto out;
+            }
+            continue;
+        }
+        if (n < 0) {
+            err = n;
+            goto out;
+        }
+
+        uint32_t seq = 0;
+        if (skb->len >= sizeof(seq)) memcpy(&seq, skb->data, sizeof(seq));
+        skb_free(skb);
+
+        if (!first) {
+            first = now;
+            expected = seq;
+        }
+        last = now;
+        if (seq >= expected) {
+            r->lost += seq - expected;
+            expected = seq + 1;
+        }
+        r->packets++;
+        r->bytes += n;
+        if (cpu_tsc_to_ns(now - first) >= limit) break;
+    }
+    r->ns = cpu_tsc_to_ns(last - first);
+    err = 0;
+
+out:
+    socket_close(fd);
+    return err;
+}
+
+static void print_value(const char* label, uint32_t value, const char* unit) {
+    vga_set_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK);
+    vga_puts(label);
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
+    vga_putdec(value, 0);
+    vga_puts(unit);
+}
+
+// Driver work per device over the run, next to the packets it moved
+static void print_devices(uint32_t us) {
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    for (size_t i = 0; i < netdev_count(); i++) {
+        netdev_t* dev = netdev_get(i);
+        uint32_t rx = (uint32_t)(dev->stats.rx_packets - before[i].rx_packets);
+        uint32_t tx = (uint32_t)(dev->stats.tx_packets - before[i].tx_packets);
+        if (!rx && !tx) continue;
+
+        uint32_t irqs = dev->stats.interrupts - before[i].interrupts;
+        vga_puts("  ");
+        vga_puts(dev->name);
+        vga_puts(": rx ");
+        vga_putdec(rx, 0);
+        vga_puts(", tx ");
+        vga_putdec(tx, 0);
+        vga_puts(", ");
+        vga_putdec(irqs, 0);
+        vga_puts(" interrupts (");
+        vga_putdec((uint32_t)div_u64((uint64_t)irqs * 1000000ull, us), 0);
+        vga_puts("/s), ");
+        vga_putdec(dev->stats.polls - before[i].polls, 0);
+        vga_puts(" polls, ");
+        vga_putdec(dev->stats.doorbells - before[i].doorbells, 0);
+        vga_puts(" doorbells\n");
+    }
+}
+
+static void udpblast_usage(void) {
+    vga_puts("Usage: udpblast <addr> [port] [seconds] [size]   Send a UDP stream\n");
+    vga_puts("       udpblast -r [port] [seconds]             Receive one and report\n");
+    vga_puts("       port 9000, seconds 1-60 (5), size 4 bytes up to the MTU less 28 (64)\n");
+}
+
+void udpblast_command(const char *args) {
+    char *arg = args ? strtok((char *)args, " ") : NULL;
+    bool receive = false;
+    uint32_t daddr = 0;
+    uint32_t port = UDPBLAST_PORT;
+    uint32_t seconds = UDPBLAST_DEFAULT_SECONDS;
+    uint32_t size = UDPBLAST_DEFAULT_SIZE;
+
+    if (!arg || (strcmp(arg, "-r") != 0 && !inet_aton(arg, &daddr))) {
+        udpblast_usage();
+        last_exit_status = 1;
+        return;
+    }
+    receive = !daddr;
+    if ((arg = strtok(NULL, " "))) port = parse_uint(arg, 65535);
+    if (arg && (arg = strtok(NULL, " "))) seconds = parse_uint(arg, UDPBLAST_MAX_SECONDS);
+    if (arg && !receive && (arg = strtok(NULL, " "))) size = parse_uint(arg, SKB_MAX_DATA);
+    if (port == 0 || port > 65535 || seconds == 0 || seconds > UDPBLAST_MAX_SECONDS ||
+        size < UDPBLAST_MIN_SIZE) {
+        udpblast_usage();
+        last_exit_status = 1;
+        return;
+    }
+
+    if (!receive) {
+        uint32_t saddr;
+        netdev_t* dev = ip_route(daddr, &saddr);
+        if (!dev) {
+            vga_puts("udpblast: ");
+            vga_puts(vfs_strerror(-ENETUNREACH));
+            vga_putchar('\n');
+            last_exit_status = 1;
+            return;
+        }
+        if (size + sizeof(struct iphdr) + 8 > dev->mtu) {
+            vga_puts("udpblast: size exceeds the MTU of ");
+            vga_puts(dev->name);
+            vga_putchar('\n');
+            last_exit_status = 1;
+            return;
+        }
+        vga_puts("Sending ");
+        vga_putdec(size, 0);
+        vga_puts("-byte datagrams for ");
+        vga_putdec(seconds, 0);
+        vga_puts(" s\n");
+    } else {
+        vga_puts("Waiting for a stream on port ");
+        vga_putdec(port, 0);
+        vga_puts("...\n");
+    }
+
+    for (size_t i = 0; i < netdev_count(); i++) before[i] = netdev_get(i)->stats;
+
+    blast_result_t r;
+    memset(&r, 0, sizeof(r));
+    int err = receive ? sink(port, seconds, &r) : blast(daddr, port, seconds, size, &r);
+    if (err) {
+        vga_puts("udpblast: ");
+        vga_puts(vfs_strerror(err));
+        vga_putchar('\n');
+        last_exit_status = 1;
+        return;
+    }
+
+    uint32_t us = (uint32_t)div_u64(r.ns, 1000);
+    if (!us) us = 1;
+    print_value("  packets     ", r.packets, receive ? "" : " sent");
+    if (receive) print_value(", lost ", r.lost, "");
+    else print_value(", dropped ", r.dropped, "");
+    vga_putchar('\n');
+    print_value("  packets/s   ", (uint32_t)div_u64((uint64_t)r.packets * 1000000ull, us), "\n");
+    print_value("  Mbit/s      ", (uint32_t)div_u64(r.bytes * 8, us), " of payload\n");
+    print_devices(us);
+
+    last_exit_status = 0;
+}
@@ -0,0 +1,536 @@
+/**
+ * ATA/IDE disk driver - Bunix OS
+ *
+ * Finds the IDE controller through PCI, identifies the attached disks with
+ * PIO and then moves all data with bus-master DMA: each request is described
+ * by a PRD (physical region descriptor) table and the channel interrupt
+ * (IRQ 14/15 in compatibility mode) signals completion. A channel runs one
+ * command at a time, so requests for both drives on it share one queue.
+ *
+ * CD/DVD drives speak ATAPI: the same DMA path, but each read is a SCSI
+ * READ(12) packet sent after the PACKET command. The block layer still
+ * counts 512-byte sectors, so requests to a CD must cover whole 2KB
+ * blocks; the queue merges sequential reads into READ(12) commands of up
+ * to ATAPI_MAX_SECTORS.
+ */
+
+#include "../../include/block/ata.h"
+#include "../../include/block/blkdev.h"
+#include "../../include/pci/pci.h"
+#include "../../include/kernel/ports/ports.h"
+#include "../../include/kernel/arch/x86/irq.h"
+#include "../../include/mm/vmm.h"
+#include "../../include/lib/string.h"
+#include "../../include/lib/errno.h"
+
+// Task file registers (offsets from the command block base)
+#define ATA_REG_DATA        0
+#define ATA_REG_ERROR       1
+#define ATA_REG_FEATURES    1
+#define ATA_REG_SECCOUNT    2
+#define ATA_REG_LBA0        3
+#define ATA_REG_LBA1        4
+#define ATA_REG_LBA2        5
+#define ATA_REG_DRIVE       6
+#define ATA_REG_STATUS      7
+#define ATA_REG_COMMAND     7
+
+// Control block
+#define ATA_REG_ALTSTATUS   0
+#define ATA_REG_DEVCTRL     0
+#define ATA_DEVCTRL_NIEN    0x02
+
+// Status bits
+#define ATA_SR_ERR          0x01
+#define ATA_SR_DRQ          0x08
+#define ATA_SR_DF           0x20
+#define ATA_SR_BSY          0x80
+
+// Commands
+#define ATA_CMD_READ_DMA        0xC8
+#define ATA_CMD_READ_DMA_EXT    0x25
+#define ATA_CMD_WRITE_DMA       0xCA
+#define ATA_CMD_WRITE_DMA_EXT   0x35
+#define ATA_CMD_FLUSH_CACHE     0xE7
+#define ATA_CMD_FLUSH_CACHE_EXT 0xEA
+#define ATA_CMD_IDENTIFY        0xEC
+#define ATA_CMD_PACKET          0xA0
+#define ATA_CMD_IDENTIFY_PACKET 0xA1
+
+// Signature an ATAPI device leaves in LBA1/LBA2 after aborting IDENTIFY
+#define ATAPI_SIG_LBA1      0x14
+#define ATAPI_SIG_LBA2      0xEB
+#define ATAPI_FEATURE_DMA   0x01
+
+// SCSI commands sent in ATAPI packets
+#define SCSI_TEST_UNIT_READY 0x00
+#define SCSI_READ_CAPACITY   0x25
+#define SCSI_READ_12         0xA8
+
+#define ATAPI_PACKET_SIZE   12
+#define ATAPI_BLOCK_SIZE    2048
+#define ATAPI_BLOCK_SECTORS (ATAPI_BLOCK_SIZE / BLK_SECTOR_SIZE)
+#define ATAPI_MAX_SECTORS   2048    // 1MB per READ(12)
+#define ATAPI_READY_RETRIES 4       // Unit attention after reset or media change
+
+// Bus master registers (offsets from BAR4, +8 for the secondary channel)
+#define BM_REG_COMMAND      0
+#define BM_REG_STATUS       2
+#define BM_REG_PRDT         4
+#define BM_CMD_START        0x01
+#define BM_CMD_READ         0x08    // Device to memory
+#define BM_SR_ERROR         0x02
+#define BM_SR_IRQ           0x04
+
+#define ATA_PRD_EOT         0x8000
+#define ATA_PRD_MAX         (PAGE_SIZE / sizeof(struct ata_prd))
+#define ATA_MAX_SECTORS     256     // 128KB per request keeps LBA28 and LBA48 alike
+#define ATA_MAX_SEGMENTS    64
+#define ATA_POLL_LIMIT      1000000
+
+struct ata_prd {
+    uint32_t addr;
+    uint16_t bytes;                 // 0 means 64KB
+    uint16_t flags;
+} __attribute__((packed));
+
+struct ata_channel;
+
+struct ata_drive {
+    struct ata_channel* channel;
+    uint8_t slave;
+    bool lba48;
+    bool atapi;
+    blkdev_t blk;
+};
+
+struct ata_channel {
+    uint16_t io_base;
+    uint16_t ctrl_base;
+    uint16_t bm_base;
+    uint8_t irq;
+    uint8_t selected;               // Drive select register value last written
+    struct ata_prd* prdt;
+    blk_request_t* active;
+    blk_request_t* queue_head;
+    blk_request_t* queue_tail;
+    uint32_t irq_count;
+};
+
+static struct ata_channel channels[2];
+static struct ata_drive drives[4];
+static int num_drives = 0;
+
+static void ata_delay_400ns(struct ata_channel* ch) {
+    for (int i = 0; i < 4; i++) inb(ch->ctrl_base + ATA_REG_ALTSTATUS);
+}
+
+static int ata_wait_not_busy(struct ata_channel* ch) {
+    for (int i = 0; i < ATA_POLL_LIMIT; i++) {
+        uint8_t status = inb(ch->io_base + ATA_REG_STATUS);
+        if (!(status & ATA_SR_BSY)) return status;
+    }
+    return -ETIMEDOUT;
+}
+
+static void ata_select(struct ata_channel* ch, uint8_t value) {
+    if (ch->selected == value) return;
+    outb(ch->io_base + ATA_REG_DRIVE, value);
+    ata_delay_400ns(ch);
+    ch->selected = value;
+}
+
+// ---------------------------------------------------------------------------
+// Probing
+// ---------------------------------------------------------------------------
+
+// Wait for the device to ask for (or offer) data; status or -errno
+static int ata_wait_drq(struct ata_channel* ch) {
+    for (int i = 0; i < ATA_POLL_LIMIT; i++) {
+        uint8_t status = inb(ch->io_base + ATA_REG_STATUS);
+        if (status & ATA_SR_BSY) continue;
+        if (status & (ATA_SR_ERR | ATA_SR_DF)) return -EIO;
+        if (status & ATA_SR_DRQ) return status;
+    }
+    return -ETIMEDOUT;
+}
+
+static int ata_identify(struct ata_channel* ch, uint8_t slave, uint16_t* id, bool* atapi) {
+    ata_select(ch, 0xA0 | (slave << 4));
+    outb(ch->io_base + ATA_REG_SECCOUNT, 0);
+    outb(ch->io_base + ATA_REG_LBA0, 0);
+    outb(ch->io_base + ATA_REG_LBA1, 0);
+    outb(ch->io_base + ATA_REG_LBA2, 0);
+    outb(ch->io_base + ATA_REG_COMMAND, ATA_CMD_IDENTIFY);
+
+    if (inb(ch->io_base + ATA_REG_STATUS) == 0) return -ENODEV;
+    if (ata_wait_not_busy(ch) < 0) return -ETIMEDOUT;
+
+    // ATAPI and SATA devices abort IDENTIFY and leave a signature here
+    uint8_t sig1 = inb(ch->io_base + ATA_REG_LBA1);
+    uint8_t sig2 = inb(ch->io_base + ATA_REG_LBA2);
+    *atapi = sig1 == ATAPI_SIG_LBA1 && sig2 == ATAPI_SIG_LBA2;
+    if (*atapi) {
+        outb(ch->io_base + ATA_REG_COMMAND, ATA_CMD_IDENTIFY_PACKET);
+        ata_delay_400ns(ch);
+    } else if (sig1 || sig2) {
+        return -ENODEV;
+    }
+
+    int status = ata_wait_drq(ch);
+    if (status < 0) return status;
+    for (int w = 0; w < 256; w++) id[w] = inw(ch->io_base + ATA_REG_DATA);
+    return 0;
+}
+
+// Send the PACKET command and then the packet itself. The byte count
+// limit only matters for PIO data phases.
+static int atapi_send_packet(struct ata_channel* ch, struct ata_drive* drive, const uint8_t* packet,
+                             uint8_t features, uint16_t byte_limit) {
+    ata_select(ch, 0xA0 | (drive->slave << 4));
+    if (ata_wait_not_busy(ch) < 0) return -ETIMEDOUT;
+
+    outb(ch->io_base + ATA_REG_FEATURES, features);
+    outb(ch->io_base + ATA_REG_LBA1, byte_limit & 0xFF);
+    outb(ch->io_base + ATA_REG_LBA2, byte_limit >> 8);
+    outb(ch->io_base + ATA_REG_COMMAND, ATA_CMD_PACKET);
+    ata_delay_400ns(ch);
+
+    int status = ata_wait_drq(ch);
+    if (status < 0) return status;
+    for (int i = 0; i < ATAPI_PACKET_SIZE; i += 2) {
+        outw(ch->io_base + ATA_REG_DATA, packet[i] | (packet[i + 1] << 8));
+    }
+    return 0;
+}
+
+// Run a packet command with PIO data and polling; only used while
+// probing, with device interrupts off
+static int atapi_command_pio(struct ata_channel* ch, struct ata_drive* drive, const uint8_t* packet,
+                             void* buf, uint16_t bytes) {
+    int err = atapi_send_packet(ch, drive, packet, 0, bytes);
+    if (err) return err;
+
+    uint8_t* p = buf;
+    uint32_t got = 0;
+    for (;;) {
+        ata_delay_400ns(ch);
+        int status = ata_wait_not_busy(ch);
+        if (status < 0) return status;
+        if (status & (ATA_SR_ERR | ATA_SR_DF)) return -EIO;
+        if (!(status & ATA_SR_DRQ)) return 0;
+
+        // The device says how much this data phase moves
+        uint32_t n = inb(ch->io_base + ATA_REG_LBA1) | (inb(ch->io_base + ATA_REG_LBA2) << 8);
+        for (uint32_t i = 0; i < n; i += 2) {
+            uint16_t w = inw(ch->io_base + ATA_REG_DATA);
+            if (got + 1 < bytes) {
+                p[got] = w & 0xFF;
+                p[got + 1] = w >> 8;
+            }
+            got += 2;
+        }
+    }
+}
+
+static inline uint32_t get_be32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void put_be32(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+// Medium size in 512-byte sectors, 0 without a readable disc
+static uint64_t atapi_capacity(struct ata_channel* ch, struct ata_drive* drive) {
+    uint8_t packet[ATAPI_PACKET_SIZE];
+    uint8_t reply[8];
+
+    // The first commands after reset report unit attention; let them
+    for (int i = 0; i < ATAPI_READY_RETRIES; i++) {
+        memset(packet, 0, sizeof(packet));
+        packet[0] = SCSI_TEST_UNIT_READY;
+        if (atapi_command_pio(ch, drive, packet, NULL, 0) == 0) break;
+    }
+
+    memset(packet, 0, sizeof(packet));
+    packet[0] = SCSI_READ_CAPACITY;
+    if (atapi_command_pio(ch, drive, packet, reply, sizeof(reply)) != 0) return 0;
+
+    uint32_t last = get_be32(reply);
+    uint32_t block = get_be32(reply + 4);
+    if (block != ATAPI_BLOCK_SIZE) return 0;
+    return ((uint64_t)last + 1) * ATAPI_BLOCK_SECTORS;
+}
+
+// ---------------------------------------------------------------------------
+// Request processing
+// ---------------------------------------------------------------------------
+
+// Describe the request with PRD entries; no entry may cross a 64KB boundary
+static int ata_build_prdt(struct ata_channel* ch, blk_request_t* req) {
+    const blk_segment_t* segs;
+    blk_segment_t single;
+    uint16_t nr_segs = blk_request_segments(req, &segs, &single);
+    uint32_t n = 0;
+
+    for (uint16_t s = 0; s < nr_segs; s++) {
+        uint32_t addr = (uint32_t)segs[s].addr;
+        uint32_t bytes = segs[s].len;
+
+        while (bytes > 0) {
+            if (n == ATA_PRD_MAX) return -EINVAL;
+            uint32_t boundary = (addr & ~0xFFFFu) + 0x10000;
+            uint32_t chunk = boundary - addr;
+            if (chunk > bytes) chunk = bytes;
+
+            ch->prdt[n].addr = addr;
+            ch->prdt[n].bytes = chunk & 0xFFFF;
+            ch->prdt[n].flags = 0;
+            n++;
+
+            addr += chunk;
+            bytes -= chunk;
+        }
+    }
+    ch->prdt[n - 1].flags = ATA_PRD_EOT;
+    return 0;
+}
+
+static void ata_setup_lba(struct ata_channel* ch, struct ata_drive* drive, uint64_t lba, uint32_t count) {
+    uint16_t io = ch->io_base;
+
+    if (drive->lba48) {
+        ata_select(ch, 0x40 | (drive->slave << 4));
+        // High-order bytes first, then the low-order ones
+        outb(io + ATA_REG_SECCOUNT, (count >> 8) & 0xFF);
+        outb(io + ATA_REG_LBA0, (lba >> 24) & 0xFF);
+        outb(io + ATA_REG_LBA1, (lba >> 32) & 0xFF);
+        outb(io + ATA_REG_LBA2, (lba >> 40) & 0xFF);
+    } else {
+        ata_select(ch, 0xE0 | (drive->slave << 4) | ((lba >> 24) & 0x0F));
+    }
+    outb(io + ATA_REG_SECCOUNT, count & 0xFF);   // 256 encodes as 0
+    outb(io + ATA_REG_LBA0, lba & 0xFF);
+    outb(io + ATA_REG_LBA1, (lba >> 8) & 0xFF);
+    outb(io + ATA_REG_LBA2, (lba >> 16) & 0xFF);
+}
+
+// Start the next queued request if the channel is idle. Interrupts off.
+static void ata_start(struct ata_channel* ch) {
+    while (!ch->active && ch->queue_head) {
+        blk_request_t* req = ch->queue_head;
+        ch->queue_head = req->next;
+        if (!ch->queue_head) ch->queue_tail = NULL;
+        req->next = NULL;
+
+        struct ata_drive* drive = req->dev->private;
+        bool is_write = (req->op == BLK_OP_WRITE);
+        uint8_t command;
+
+        if (ata_wait_not_busy(ch) < 0) {
+            blk_request_complete(req, -ETIMEDOUT);
+            continue;
+        }
+
+        // CD drives: nothing to flush, nothing writable, 2KB blocks only
+        if (drive->atapi) {
+            int err = 0;
+            if (req->op == BLK_OP_WRITE) err = -EROFS;
+            else if ((req->lba | req->count) & (ATAPI_BLOCK_SECTORS - 1)) err = -EINVAL;
+            if (err || req->op == BLK_OP_FLUSH) {
+                blk_request_complete(req, err);
+                continue;
+            }
+        }
+
+        ch->active = req;
+
+        if (req->op == BLK_OP_FLUSH) {
+            ata_select(ch, 0xA0 | (drive->slave << 4));
+            outb(ch->io_base + ATA_REG_COMMAND,
+                 drive->lba48 ? ATA_CMD_FLUSH_CACHE_EXT : ATA_CMD_FLUSH_CACHE);
+            req->dev->stats.doorbells++;
+            return;
+        }
+
+        if (ata_build_prdt(ch, req) != 0) {
+            ch->active = NULL;
+            blk_request_complete(req, -EINVAL);
+            continue;
+        }
+
+        // Stop the engine, point it at the table and clear stale status
+        outb(ch->bm_base + BM_REG_COMMAND, 0);
+        outl(ch->bm_base + BM_REG_PRDT, (uint32_t)ch->prdt);
+        outb(ch->bm_base + BM_REG_STATUS, inb(ch->bm_base + BM_REG_STATUS) | BM_SR_IRQ | BM_SR_ERROR);
+        outb(ch->bm_base + BM_REG_COMMAND, is_write ? 0 : BM_CMD_READ);
+
+        if (drive->atapi) {
+            uint8_t packet[ATAPI_PACKET_SIZE] = { SCSI_READ_12 };
+            put_be32(packet + 2, req->lba / ATAPI_BLOCK_SECTORS);
+            put_be32(packet + 6, req->count / ATAPI_BLOCK_SECTORS);
+            if (atapi_send_packet(ch, drive, packet, ATAPI_FEATURE_DMA, 0) != 0) {
+                ch->active = NULL;
+                blk_request_complete(req, -EIO);
+                continue;
+            }
+        } else {
+            ata_setup_lba(ch, drive, req->lba, req->count);
+            if (drive->lba48) command = is_write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT;
+            else command = is_write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA;
+            outb(ch->io_base + ATA_REG_COMMAND, command);
+        }
+
+        outb(ch->bm_base + BM_REG_COMMAND, (is_write ? 0 : BM_CMD_READ) | BM_CMD_START);
+        req->dev->stats.doorbells++;
+    }
+}
+
+static void ata_irq_handler(void* ctx) {
+    struct ata_channel* ch = ctx;
+    blk_request_t* req = ch->active;
+    uint8_t bm_status = inb(ch->bm_base + BM_REG_STATUS);
+
+    // Shared native-mode lines: only claim interrupts this channel raised
+    if (!(bm_status & BM_SR_IRQ)) return;
+
+    outb(ch->bm_base + BM_REG_COMMAND, 0);
+    uint8_t status = inb(ch->io_base + ATA_REG_STATUS);   // Acknowledges the device
+    outb(ch->bm_base + BM_REG_STATUS, bm_status | BM_SR_IRQ | BM_SR_ERROR);
+    ch->irq_count++;
+
+    if (!req) return;
+    ch->active = NULL;
+
+    int err = 0;
+    if ((status & (ATA_SR_ERR | ATA_SR_DF)) || (bm_status & BM_SR_ERROR)) err = -EIO;
+    blk_request_complete(req, err);
+
+    ata_start(ch);
+}
+
+static int ata_submit(blkdev_t* dev, blk_request_t* req) {
+    struct ata_drive* drive = dev->private;
+    struct ata_channel* ch = drive->channel;
+
+    req->next = NULL;
+    if (ch->queue_tail) ch->queue_tail->next = req;
+    else ch->queue_head = req;
+    ch->queue_tail = req;
+
+    ata_start(ch);
+    return 0;
+}
+
+static const blkdev_ops_t ata_ops = {
+    .submit = ata_submit,
+};
+
+// ---------------------------------------------------------------------------
+// Initialization
+// ---------------------------------------------------------------------------
+
+static void ata_probe_drive(struct ata_channel* ch, int channel_index, uint8_t slave) {
+    static uint16_t id[256];
+    bool atapi;
+
+    if (ata_identify(ch, slave, id, &atapi) != 0) return;
+    if (!(id[49] & (1 << 8))) return;   // No DMA support
+
+    struct ata_drive* drive = &drives[num_drives];
+    memset(drive, 0, sizeof(*drive));
+    drive->channel = ch;
+    drive->slave = slave;
+    drive->atapi = atapi;
+    drive->lba48 = !atapi && (id[83] & (1 << 10)) != 0;
+
+    uint64_t sectors;
+    if (atapi) {
+        sectors = atapi_capacity(ch, drive);
+    } else if (drive->lba48) {
+        sectors = (uint64_t)id[100] | ((uint64_t)id[101] << 16) |
+                  ((uint64_t)id[102] << 32) | ((uint64_t)id[103] << 48);
+    } else {
+        sectors = (uint32_t)id[60] | ((uint32_t)id[61] << 16);
+    }
+    if (sectors == 0) return;
+
+    blkdev_t* blk = &drive->blk;
+    strcpy(blk->name, "hda");
+    blk->name[2] = 'a' + channel_index * 2 + slave;
+    blk->sector_size = BLK_SECTOR_SIZE;
+    blk->sectors = sectors;
+    blk->max_sectors = atapi ? ATAPI_MAX_SECTORS : ATA_MAX_SECTORS;
+    blk->max_segments = ATA_MAX_SEGMENTS;
+    blk->queue_depth = 1;
+    blk->ops = &ata_ops;
+    blk->private = drive;
+
+    if (blkdev_register(blk) == 0) num_drives++;
+}
+
+static void ata_setup_channel(pci_device_t* pci, int index) {
+    struct ata_channel* ch = &channels[index];
+    bool native = pci->prog_if & (index == 0 ? 0x01 : 0x04);
+
+    memset(ch, 0, sizeof(*ch));
+    if (native) {
+        ch->io_base = pci_bar_address(pci, index * 2);
+        ch->ctrl_base = pci_bar_address(pci, index * 2 + 1) + 2;
+        ch->irq = pci->irq_line;
+    } else {
+        ch->io_base = index == 0 ? 0x1F0 : 0x170;
+        ch->ctrl_base = index == 0 ? 0x3F6 : 0x376;
+        ch->irq = index == 0 ? IRQ_ATA_PRIMARY : IRQ_ATA_SECONDARY;
+    }
+    ch->bm_base = pci_bar_address(pci, 4) + index * 8;
+    ch->selected = 0xFF;
+
+    // Floating bus: nothing attached to this channel
+    if (inb(ch->io_base + ATA_REG_STATUS) == 0xFF) return;
+
+    // Probe with device interrupts off
+    outb(ch->ctrl_base + ATA_REG_DEVCTRL, ATA_DEVCTRL_NIEN);
+
+    int before = num_drives;
+    ata_probe_drive(ch, index, 0);
+    ata_probe_drive(ch, index, 1);
+    if (num_drives == before) return;
+
+    ch->prdt = (struct ata_prd*)vmm_alloc_page();
+    memset(ch->prdt, 0, PAGE_SIZE);
+
+    // Clear anything IDENTIFY left pending, then let the drives interrupt
+    inb(ch->io_base + ATA_REG_STATUS);
+    outb(ch->bm_base + BM_REG_STATUS, BM_SR_IRQ | BM_SR_ERROR);
+    irq_register(ch->irq, ata_irq_handler, ch);
+    outb(ch->ctrl_base + ATA_REG_DEVCTRL, 0);
+}
+
+int ata_init(void) {
+    pci_device_t* pci = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, 0);
+    num_drives = 0;
+
+    // Bus mastering needs BAR4; without it we'd be stuck with PIO
+    if (!pci || !pci_bar_is_io(pci, 4) || !pci_bar_address(pci, 4)) return 0;
+    pci_enable(pci, PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+
+    ata_setup_channel(pci, 0);
+    ata_setup_channel(pci, 1);
+    return num_drives;
+}
+
+blkdev_t* ata_cdrom(void) {
+    for (int i = 0; i < num_drives; i++) {
+        if (drives[i].atapi) return &drives[i].blk;
+    }
+    return NULL;
+}
+
+uint32_t ata_get_irq_count(int channel) {
+    return (channel >= 0 && channel < 2) ? channels[channel].irq_count : 0;
+}
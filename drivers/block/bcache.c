@@ -0,0 +1,468 @@
+/**
+ * Block buffer cache - Bunix OS
+ *
+ * Buffers live on a hash table for lookup and on one circular CLOCK list
+ * for replacement. New buffers go in just behind the hand so they get a
+ * full sweep before they can be evicted; a hit sets the reference bit and
+ * buys another sweep. Prefetched buffers start unreferenced, so read-ahead
+ * that is never used is the first thing to go.
+ *
+ * Read-ahead is asynchronous: the prefetched blocks are read with
+ * scatter requests whose completion (in interrupt context) only flips
+ * buffer flags. Everything else runs in process context.
+ */
+
+#include "../../include/block/bcache.h"
+#include "../../include/kernel/arch/x86/cpu.h"
+#include "../../include/kernel/arch/x86/irq.h"
+#include "../../include/kernel/sched/idle.h"
+#include "../../include/mm/vmm.h"
+#include "../../include/mm/kmalloc.h"
+#include "../../include/lib/string.h"
+#include "../../include/lib/errno.h"
+#include "../../include/lib/math64.h"
+
+#define BCACHE_HASH_BITS      10
+#define BCACHE_HASH_SIZE      (1 << BCACHE_HASH_BITS)
+#define BCACHE_RA_REQUESTS    8           // Read-ahead requests in flight
+#define BCACHE_RA_MAX_SEGS    32          // Buffers per read-ahead request
+#define BCACHE_FLUSH_BATCH    64          // Write-backs per flusher run
+
+struct ra_request {
+    blk_request_t req;
+    blk_segment_t segs[BCACHE_RA_MAX_SEGS];
+    buffer_t* bufs[BCACHE_RA_MAX_SEGS];
+    uint32_t nbufs;
+    volatile bool busy;
+};
+
+// Per-device sequential access detector
+struct ra_state {
+    blkdev_t* dev;
+    uint32_t size;                  // Block size the state refers to
+    uint64_t last;                  // Last block read
+    uint64_t end;                   // First block not yet prefetched
+    uint32_t window;                // Blocks, 0 while access looks random
+    bool primed;
+};
+
+static buffer_t* hash_table[BCACHE_HASH_SIZE];
+static buffer_t* clock_hand = NULL;
+static bcache_stats_t stats;
+static struct ra_request ra_pool[BCACHE_RA_REQUESTS];
+static struct ra_state ra_states[BLKDEV_MAX];
+static uint64_t last_flush_tsc = 0;
+
+static uint32_t bcache_hash(blkdev_t* dev, uint64_t block) {
+    uint32_t h = (uint32_t)block ^ (uint32_t)(block >> 32) ^ ((uint32_t)dev >> 4);
+    return (h * 2654435761u) >> (32 - BCACHE_HASH_BITS);
+}
+
+static uint32_t elapsed_ms(uint64_t since) {
+    return (uint32_t)div_u64(cpu_tsc_to_ns(cpu_rdtsc() - since), 1000000);
+}
+
+static int bcache_check(blkdev_t* dev, uint64_t block, uint32_t size) {
+    if (!dev || size == 0 || size > PAGE_SIZE || size % BLK_SECTOR_SIZE) return -EINVAL;
+    uint32_t spb = size / BLK_SECTOR_SIZE;
+    if (block >= div_u64(dev->sectors, spb)) return -ENXIO;
+    return 0;
+}
+
+static buffer_t* bcache_lookup(blkdev_t* dev, uint64_t block, uint32_t size) {
+    for (buffer_t* buf = hash_table[bcache_hash(dev, block)]; buf; buf = buf->hash_next) {
+        if (buf->dev == dev && buf->block == block && buf->size == size) return buf;
+    }
+    return NULL;
+}
+
+static void bcache_wait_io(buffer_t* buf) {
+    uint32_t flags = irq_save();
+    while (buf->flags & BUF_IO) cpu_sleep();
+    irq_restore(flags);
+}
+
+static int bcache_writeback(buffer_t* buf) {
+    uint32_t spb = buf->size / BLK_SECTOR_SIZE;
+    int err = blkdev_write(buf->dev, buf->block * spb, spb, buf->data);
+    if (err) return err;
+
+    buf->flags &= ~BUF_DIRTY;
+    stats.dirty--;
+    stats.writebacks++;
+    return 0;
+}
+
+static void bcache_remove(buffer_t* buf) {
+    buffer_t** link = &hash_table[bcache_hash(buf->dev, buf->block)];
+    while (*link != buf) link = &(*link)->hash_next;
+    *link = buf->hash_next;
+
+    if (buf->clock_next == buf) {
+        clock_hand = NULL;
+    } else {
+        if (clock_hand == buf) clock_hand = buf->clock_next;
+        buf->clock_prev->clock_next = buf->clock_next;
+        buf->clock_next->clock_prev = buf->clock_prev;
+    }
+
+    if (buf->flags & BUF_READAHEAD) stats.ra_wasted++;
+    if (buf->size > PAGE_SIZE / 2) vmm_free_page((uint32_t*)buf->data);
+    else kfree(buf->data);
+    stats.buffers--;
+    stats.bytes -= buf->size;
+    kfree(buf);
+}
+
+// Sweep the hand until an unpinned, unreferenced buffer turns up
+static bool bcache_evict_one(void) {
+    buffer_t* buf = clock_hand;
+    uint32_t limit = 2 * stats.buffers + 1;
+
+    for (uint32_t scanned = 0; buf && scanned < limit; scanned++, buf = buf->clock_next) {
+        if (buf->refcount || (buf->flags & BUF_IO)) continue;
+        if (buf->flags & BUF_REFERENCED) {
+            buf->flags &= ~BUF_REFERENCED;
+            continue;
+        }
+        if ((buf->flags & BUF_DIRTY) && bcache_writeback(buf) != 0) continue;
+
+        clock_hand = buf;
+        bcache_remove(buf);
+        stats.evictions++;
+        return true;
+    }
+    clock_hand = buf;
+    return false;
+}
+
+static buffer_t* bcache_alloc(blkdev_t* dev, uint64_t block, uint32_t size) {
+    // Go over budget rather than fail when everything is pinned
+    while (stats.bytes + size > stats.budget && bcache_evict_one());
+
+    buffer_t* buf = kzalloc(sizeof(buffer_t));
+    if (!buf) return NULL;
+    buf->data = size > PAGE_SIZE / 2 ? (uint8_t*)vmm_alloc_page() : kmalloc(size);
+    if (!buf->data) {
+        kfree(buf);
+        return NULL;
+    }
+    buf->dev = dev;
+    buf->block = block;
+    buf->size = size;
+
+    uint32_t h = bcache_hash(dev, block);
+    buf->hash_next = hash_table[h];
+    hash_table[h] = buf;
+
+    if (!clock_hand) {
+        buf->clock_next = buf->clock_prev = buf;
+        clock_hand = buf;
+    } else {
+        buf->clock_next = clock_hand;
+        buf->clock_prev = clock_hand->clock_prev;
+        clock_hand->clock_prev->clock_next = buf;
+        clock_hand->clock_prev = buf;
+    }
+
+    stats.buffers++;
+    stats.bytes += size;
+    return buf;
+}
+
+// Interrupt context: publish the prefetched data and free the slot
+static void bcache_ra_complete(blk_request_t* req) {
+    struct ra_request* rr = req->private;
+
+    for (uint32_t i = 0; i < rr->nbufs; i++) {
+        buffer_t* buf = rr->bufs[i];
+        buf->flags = (buf->flags & ~BUF_IO) | (req->status ? BUF_ERROR : BUF_VALID);
+    }
+    rr->busy = false;
+}
+
+static void bcache_ra_submit(struct ra_request* rr) {
+    buffer_t* first = rr->bufs[0];
+    uint32_t spb = first->size / BLK_SECTOR_SIZE;
+
+    memset(&rr->req, 0, sizeof(rr->req));
+    rr->req.dev = first->dev;
+    rr->req.op = BLK_OP_READ;
+    rr->req.lba = first->block * spb;
+    rr->req.count = rr->nbufs * spb;
+    rr->req.segs = rr->segs;
+    rr->req.nr_segs = rr->nbufs;
+    rr->req.complete = bcache_ra_complete;
+    rr->req.private = rr;
+
+    stats.ra_blocks += rr->nbufs;
+    if (blkdev_submit(&rr->req) != 0) {
+        for (uint32_t i = 0; i < rr->nbufs; i++) {
+            rr->bufs[i]->flags = (rr->bufs[i]->flags & ~BUF_IO) | BUF_ERROR;
+        }
+        rr->busy = false;
+    }
+}
+
+static struct ra_request* bcache_ra_get(void) {
+    for (int i = 0; i < BCACHE_RA_REQUESTS; i++) {
+        if (!ra_pool[i].busy) {
+            ra_pool[i].busy = true;
+            ra_pool[i].nbufs = 0;
+            return &ra_pool[i];
+        }
+    }
+    return NULL;
+}
+
+// Read blocks [start, end) that aren't cached, in as few requests as the
+// device allows. Cached blocks split the run.
+static void bcache_prefetch(blkdev_t* dev, uint64_t start, uint64_t end, uint32_t size) {
+    uint32_t spb = size / BLK_SECTOR_SIZE;
+    uint32_t max_bufs = dev->max_segments < BCACHE_RA_MAX_SEGS ? dev->max_segments : BCACHE_RA_MAX_SEGS;
+    if (max_bufs > dev->max_sectors / spb) max_bufs = dev->max_sectors / spb;
+    if (max_bufs == 0) return;
+
+    struct ra_request* rr = NULL;
+    for (uint64_t block = start; block < end; block++) {
+        if (bcache_lookup(dev, block, size)) {
+            if (rr && rr->nbufs) bcache_ra_submit(rr);
+            rr = NULL;
+            continue;
+        }
+        if (!rr && !(rr = bcache_ra_get())) return;
+
+        buffer_t* buf = bcache_alloc(dev, block, size);
+        if (!buf) break;
+        buf->flags = BUF_IO | BUF_READAHEAD;
+        rr->bufs[rr->nbufs] = buf;
+        rr->segs[rr->nbufs].addr = buf->data;
+        rr->segs[rr->nbufs].len = size;
+        if (++rr->nbufs == max_bufs) {
+            bcache_ra_submit(rr);
+            rr = NULL;
+        }
+    }
+
+    if (rr && rr->nbufs) bcache_ra_submit(rr);
+    else if (rr) rr->busy = false;
+}
+
+static struct ra_state* bcache_ra_state(blkdev_t* dev, uint32_t size) {
+    struct ra_state* free_slot = NULL;
+    for (int i = 0; i < BLKDEV_MAX; i++) {
+        if (ra_states[i].dev == dev) {
+            if (ra_states[i].size != size) {
+                memset(&ra_states[i], 0, sizeof(ra_states[i]));
+                ra_states[i].dev = dev;
+                ra_states[i].size = size;
+            }
+            return &ra_states[i];
+        }
+        if (!ra_states[i].dev && !free_slot) free_slot = &ra_states[i];
+    }
+    if (free_slot) {
+        free_slot->dev = dev;
+        free_slot->size = size;
+    }
+    return free_slot;
+}
+
+// Called after every read. Each time a sequential reader catches up with
+// the prefetched range the window doubles, up to the maximum; any other
+// access quarters it until read-ahead switches off.
+static void bcache_readahead(blkdev_t* dev, uint64_t block, uint32_t size) {
+    struct ra_state* ra = bcache_ra_state(dev, size);
+    if (!ra) return;
+
+    uint32_t min_window = BCACHE_RA_MIN_BYTES / size;
+    uint32_t max_window = BCACHE_RA_MAX_BYTES / size;
+    if (max_window > stats.budget / 4 / size) max_window = stats.budget / 4 / size;
+
+    bool sequential = ra->primed && block == ra->last + 1;
+    if (!sequential && ra->primed && block != ra->last) {
+        ra->window /= 4;
+        if (ra->window < min_window) ra->window = 0;
+    }
+    ra->last = block;
+    ra->primed = true;
+    if (!sequential) return;
+
+    // Stay at least half a window ahead of the reader
+    if (ra->window && ra->end > block + 1 + ra->window / 2) return;
+    ra->window = ra->window ? ra->window * 2 : min_window;
+    if (ra->window > max_window) ra->window = max_window;
+
+    uint64_t start = ra->end > block + 1 ? ra->end : block + 1;
+    uint64_t end = block + 1 + ra->window;
+    uint64_t dev_blocks = div_u64(dev->sectors, size / BLK_SECTOR_SIZE);
+    if (end > dev_blocks) end = dev_blocks;
+    if (start >= end) return;
+
+    ra->end = end;
+    bcache_prefetch(dev, start, end, size);
+}
+
+int bcache_read(blkdev_t* dev, uint64_t block, uint32_t size, buffer_t** out) {
+    int err = bcache_check(dev, block, size);
+    if (err) return err;
+
+    stats.lookups++;
+    buffer_t* buf = bcache_lookup(dev, block, size);
+    if (buf) {
+        buf->refcount++;
+        bcache_wait_io(buf);
+    } else {
+        buf = bcache_alloc(dev, block, size);
+        if (!buf) return -ENOMEM;
+        buf->refcount = 1;
+    }
+
+    if (buf->flags & BUF_VALID) {
+        stats.hits++;
+        if (buf->flags & BUF_READAHEAD) stats.ra_used++;
+        buf->flags = (buf->flags & ~BUF_READAHEAD) | BUF_REFERENCED;
+    } else {
+        stats.misses++;
+        uint32_t spb = size / BLK_SECTOR_SIZE;
+        buf->flags &= ~BUF_READAHEAD;
+        err = blkdev_read(dev, block * spb, spb, buf->data);
+        if (err) {
+            buf->flags |= BUF_ERROR;
+            buf->refcount--;
+            return err;
+        }
+        buf->flags = (buf->flags & ~BUF_ERROR) | BUF_VALID;
+    }
+
+    bcache_readahead(dev, block, size);
+    *out = buf;
+    return 0;
+}
+
+int bcache_get_new(blkdev_t* dev, uint64_t block, uint32_t size, buffer_t** out) {
+    int err = bcache_check(dev, block, size);
+    if (err) return err;
+
+    buffer_t* buf = bcache_lookup(dev, block, size);
+    if (buf) {
+        buf->refcount++;
+        bcache_wait_io(buf);
+    } else {
+        buf = bcache_alloc(dev, block, size);
+        if (!buf) return -ENOMEM;
+        buf->refcount = 1;
+    }
+
+    if (!(buf->flags & BUF_VALID)) memset(buf->data, 0, size);
+    buf->flags = (buf->flags & ~(BUF_READAHEAD | BUF_ERROR)) | BUF_VALID | BUF_REFERENCED;
+    *out = buf;
+    return 0;
+}
+
+void bcache_release(buffer_t* buf) {
+    if (buf && buf->refcount) buf->refcount--;
+}
+
+void bcache_mark_dirty(buffer_t* buf) {
+    if (buf->flags & BUF_DIRTY) return;
+    buf->flags |= BUF_DIRTY;
+    buf->dirty_tsc = cpu_rdtsc();
+    stats.dirty++;
+}
+
+int bcache_sync_buffer(buffer_t* buf) {
+    if (!(buf->flags & BUF_DIRTY)) return 0;
+    return bcache_writeback(buf);
+}
+
+int bcache_sync(blkdev_t* dev) {
+    int result = 0;
+    buffer_t* buf = clock_hand;
+
+    for (uint32_t n = stats.buffers; n > 0 && stats.dirty; n--, buf = buf->clock_next) {
+        if (!(buf->flags & BUF_DIRTY) || (dev && buf->dev != dev)) continue;
+        int err = bcache_writeback(buf);
+        if (err && !result) result = err;
+    }
+
+    if (dev) {
+        int err = blkdev_flush(dev);
+        return result ? result : err;
+    }
+    for (size_t i = 0; i < blkdev_count(); i++) {
+        int err = blkdev_flush(blkdev_get(i));
+        if (err && !result) result = err;
+    }
+    return result;
+}
+
+int bcache_invalidate(blkdev_t* dev) {
+    int result = bcache_sync(dev);
+
+    buffer_t* buf = clock_hand;
+    for (uint32_t n = stats.buffers; n > 0 && buf; n--) {
+        buffer_t* next = buf->clock_next;
+        if (buf->dev == dev && !buf->refcount && !(buf->flags & (BUF_IO | BUF_DIRTY))) {
+            bcache_remove(buf);
+        }
+        buf = clock_hand ? next : NULL;
+    }
+
+    for (int i = 0; i < BLKDEV_MAX; i++) {
+        if (ra_states[i].dev == dev) memset(&ra_states[i], 0, sizeof(ra_states[i]));
+    }
+    return result;
+}
+
+void bcache_forget(blkdev_t* dev, uint64_t block, uint32_t size) {
+    buffer_t* buf = bcache_lookup(dev, block, size);
+    if (!buf) return;
+
+    if (buf->flags & BUF_DIRTY) {
+        buf->flags &= ~BUF_DIRTY;
+        stats.dirty--;
+    }
+    // Buffers still referenced or under read-ahead are left to eviction
+    if (!buf->refcount && !(buf->flags & BUF_IO)) bcache_remove(buf);
+}
+
+// Idle work standing in for a flusher thread: every interval, write back
+// buffers dirty for longer than the expiry, or all of them once more than
+// a quarter of the cache is dirty
+static void bcache_flusher(void) {
+    if (!stats.dirty || elapsed_ms(last_flush_tsc) < BCACHE_FLUSH_INTERVAL_MS) return;
+    last_flush_tsc = cpu_rdtsc();
+
+    bool pressure = stats.dirty > stats.buffers / 4;
+    uint32_t written = 0;
+    buffer_t* buf = clock_hand;
+    for (uint32_t n = stats.buffers; n > 0 && stats.dirty && written < BCACHE_FLUSH_BATCH;
+         n--, buf = buf->clock_next) {
+        if (!(buf->flags & BUF_DIRTY) || buf->refcount) continue;
+        if (!pressure && elapsed_ms(buf->dirty_tsc) < BCACHE_DIRTY_EXPIRE_MS) continue;
+        if (bcache_writeback(buf) == 0) written++;
+    }
+}
+
+void bcache_init(void) {
+    uint32_t pages = vmm_get_free_pages() / 16;
+    if (pages < BCACHE_MIN_PAGES) pages = BCACHE_MIN_PAGES;
+    if (pages > BCACHE_MAX_PAGES) pages = BCACHE_MAX_PAGES;
+
+    memset(hash_table, 0, sizeof(hash_table));
+    memset(&stats, 0, sizeof(stats));
+    stats.budget = pages * PAGE_SIZE;
+    last_flush_tsc = cpu_rdtsc();
+    idle_register(bcache_flusher);
+}
+
+void bcache_get_stats(bcache_stats_t* out) {
+    *out = stats;
+}
+
+void bcache_reset_stats(void) {
+    stats.lookups = stats.hits = stats.misses = 0;
+    stats.ra_blocks = stats.ra_used = stats.ra_wasted = 0;
+    stats.evictions = stats.writebacks = 0;
+}
@@ -0,0 +1,466 @@
+/**
+ * Block device registry and request plumbing - Bunix OS
+ *
+ * blkdev_submit() validates a request and hands it to the device's
+ * request queue (or the current plug). The queue feeds the driver from
+ * its elevator while fewer than queue_depth driver requests are out,
+ * folding back-to-back requests into one merged driver request on the
+ * way. Completions fan out to the original requests, record latency and
+ * refill the driver.
+ */
+
+#include "../../include/block/blkdev.h"
+#include "../../include/block/elevator.h"
+#include "../../include/kernel/arch/x86/cpu.h"
+#include "../../include/kernel/arch/x86/irq.h"
+#include "../../include/lib/string.h"
+#include "../../include/lib/errno.h"
+#include "../../include/lib/math64.h"
+
+#define BLK_MERGE_POOL      16
+#define BLK_MERGE_MAX_SEGS  64
+
+// A driver request built from several adjacent submitted requests
+struct blk_merge {
+    blk_request_t req;
+    blk_segment_t segs[BLK_MERGE_MAX_SEGS];
+    blk_request_t* parts;               // Linked through q_next
+    bool busy;
+};
+
+static blkdev_t* devices[BLKDEV_MAX];
+static size_t num_devices = 0;
+static struct blk_merge merge_pool[BLK_MERGE_POOL];
+static blk_plug_t* current_plug = NULL;
+
+void blkdev_init(void) {
+    elevator_register(&elevator_noop);
+    elevator_register(&elevator_deadline);
+}
+
+int blkdev_register(blkdev_t* dev) {
+    if (num_devices >= BLKDEV_MAX) return -ENOSPC;
+    if (blkdev_find(dev->name)) return -EEXIST;
+
+    if (!dev->sector_size) dev->sector_size = BLK_SECTOR_SIZE;
+    if (!dev->queue_depth) dev->queue_depth = 1;
+    if (!dev->max_segments) dev->max_segments = 1;
+    memset(&dev->stats, 0, sizeof(dev->stats));
+    memset(&dev->queue, 0, sizeof(dev->queue));
+
+    int err = blkdev_set_elevator(dev, BLK_DEFAULT_ELEVATOR);
+    if (err) err = blkdev_set_elevator(dev, "noop");
+    if (err) return err;
+
+    devices[num_devices++] = dev;
+    return 0;
+}
+
+size_t blkdev_count(void) {
+    return num_devices;
+}
+
+blkdev_t* blkdev_get(size_t index) {
+    return index < num_devices ? devices[index] : NULL;
+}
+
+blkdev_t* blkdev_find(const char* name) {
+    for (size_t i = 0; i < num_devices; i++) {
+        if (strcmp(devices[i]->name, name) == 0) return devices[i];
+    }
+    return NULL;
+}
+
+int blkdev_set_elevator(blkdev_t* dev, const char* name) {
+    elevator_type_t* type = elevator_find(name);
+    if (!type) return -ENOENT;
+
+    uint32_t flags = irq_save();
+    blk_queue_t* q = &dev->queue;
+    if (q->queued) {
+        irq_restore(flags);
+        return -EBUSY;
+    }
+
+    const elevator_type_t* old = q->elevator;
+    void* old_data = q->elevator_data;
+    q->elevator = type;
+    q->elevator_data = NULL;
+    int err = type->init ? type->init(dev) : 0;
+    if (err) {
+        q->elevator = old;
+        q->elevator_data = old_data;
+        irq_restore(flags);
+        return err;
+    }
+
+    if (old && old->exit) {
+        void* new_data = q->elevator_data;
+        q->elevator_data = old_data;
+        old->exit(dev);
+        q->elevator_data = new_data;
+    }
+    irq_restore(flags);
+    return 0;
+}
+
+const char* blkdev_elevator_name(const blkdev_t* dev) {
+    return dev->queue.elevator ? dev->queue.elevator->name : "none";
+}
+
+static uint32_t blk_latency_bucket(uint64_t start_tsc) {
+    uint32_t us = (uint32_t)div_u64(cpu_tsc_to_ns(cpu_rdtsc() - start_tsc), 1000);
+    uint32_t bucket = 0;
+    while (us && bucket < BLK_LAT_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// Finish one submitted request: statistics, latency, wake the submitter
+static void blk_request_end(blk_request_t* req, int status) {
+    blkdev_t* dev = req->dev;
+
+    dev->stats.in_flight--;
+    if (status) {
+        dev->stats.errors++;
+    } else if (req->op == BLK_OP_READ) {
+        dev->stats.reads++;
+        dev->stats.read_sectors += req->count;
+        dev->stats.read_latency[blk_latency_bucket(req->start_tsc)]++;
+    } else if (req->op == BLK_OP_WRITE) {
+        dev->stats.writes++;
+        dev->stats.write_sectors += req->count;
+        dev->stats.write_latency[blk_latency_bucket(req->start_tsc)]++;
+    } else {
+        dev->stats.flushes++;
+    }
+
+    req->status = status;
+    req->done = true;
+    if (req->complete) req->complete(req);
+}
+
+static struct blk_merge* blk_merge_get(void) {
+    for (int i = 0; i < BLK_MERGE_POOL; i++) {
+        if (!merge_pool[i].busy) {
+            merge_pool[i].busy = true;
+            return &merge_pool[i];
+        }
+    }
+    return NULL;
+}
+
+// Append a request's segments, joining physically contiguous neighbours.
+// On overflow the list is left as it was.
+static bool blk_merge_add_segments(struct blk_merge* m, const blk_request_t* req, uint16_t limit) {
+    const blk_segment_t* segs;
+    blk_segment_t single;
+    uint16_t n = blk_request_segments(req, &segs, &single);
+    uint16_t nr = m->req.nr_segs;
+    uint32_t last_len = nr ? m->segs[nr - 1].len : 0;
+
+    for (uint16_t i = 0; i < n; i++) {
+        blk_segment_t* last = nr ? &m->segs[nr - 1] : NULL;
+        if (last && (uint8_t*)last->addr + last->len == (uint8_t*)segs[i].addr) {
+            last->len += segs[i].len;
+            continue;
+        }
+        if (nr >= limit) {
+            if (m->req.nr_segs) m->segs[m->req.nr_segs - 1].len = last_len;
+            return false;
+        }
+        m->segs[nr++] = segs[i];
+    }
+    m->req.nr_segs = nr;
+    return true;
+}
+
+// Pull adjacent requests out of the elevator behind 'req'. Returns the
+// request to hand to the driver: 'req' itself or a merged request.
+static blk_request_t* blk_try_merge(blkdev_t* dev, blk_request_t* req) {
+    blk_queue_t* q = &dev->queue;
+    if (req->op == BLK_OP_FLUSH || !q->elevator->take_adjacent) return req;
+
+    blk_request_t* next = q->elevator->take_adjacent(dev, req);
+    if (!next) return req;
+
+    uint16_t limit = dev->max_segments < BLK_MERGE_MAX_SEGS ? dev->max_segments : BLK_MERGE_MAX_SEGS;
+    struct blk_merge* m = blk_merge_get();
+    if (m) {
+        memset(&m->req, 0, sizeof(m->req));
+        m->req.dev = dev;
+        m->req.op = req->op;
+        m->req.lba = req->lba;
+        m->req.segs = m->segs;
+        m->req.flags = BLK_REQ_MERGED;
+        m->req.private = m;
+        if (!blk_merge_add_segments(m, req, limit)) {
+            m->busy = false;
+            m = NULL;
+        }
+    }
+    if (!m) {
+        // Can't merge after all; keep the neighbour for the next round
+        q->elevator->requeue(dev, next);
+        return req;
+    }
+
+    m->req.count = req->count;
+    m->parts = req;
+    blk_request_t* tail = req;
+    req->q_next = NULL;
+
+    while (next) {
+        if (m->req.count + next->count > dev->max_sectors || !blk_merge_add_segments(m, next, limit)) {
+            q->elevator->requeue(dev, next);
+            break;
+        }
+        m->req.count += next->count;
+        tail->q_next = next;
+        next->q_next = NULL;
+        tail = next;
+        q->queued--;
+        dev->stats.merges++;
+        next = q->elevator->take_adjacent(dev, tail);
+    }
+
+    if (m->parts == tail) {
+        // Nothing joined in the end
+        m->busy = false;
+        return req;
+    }
+    return &m->req;
+}
+
+static blk_request_t* blk_queue_next(blkdev_t* dev) {
+    blk_queue_t* q = &dev->queue;
+    blk_request_t* req = q->dispatch_head;
+
+    if (req) {
+        q->dispatch_head = req->q_next;
+        if (!q->dispatch_head) q->dispatch_tail = NULL;
+    } else {
+        req = q->elevator->next(dev);
+    }
+    if (req) q->queued--;
+    return req;
+}
+
+// Feed the driver while it has room. Interrupts off.
+static void blk_queue_run(blkdev_t* dev) {
+    blk_queue_t* q = &dev->queue;
+
+    // Drivers may complete requests from inside submit; the outer call
+    // picks up whatever that frees
+    if (q->running) {
+        q->rerun = true;
+        return;
+    }
+    q->running = true;
+
+    do {
+        q->rerun = false;
+        while (q->in_driver < dev->queue_depth && q->queued) {
+            blk_request_t* req = blk_queue_next(dev);
+            if (!req) break;
+            req = blk_try_merge(dev, req);
+
+            q->in_driver++;
+            dev->stats.dispatched++;
+            int err = dev->ops->submit(dev, req);
+            if (err) blk_request_complete(req, err);
+        }
+    } while (q->rerun);
+
+    q->running = false;
+}
+
+static void blk_queue_insert(blkdev_t* dev, blk_request_t* req) {
+    blk_queue_t* q = &dev->queue;
+
+    req->q_next = req->q_prev = NULL;
+    req->fifo_next = req->fifo_prev = NULL;
+    q->queued++;
+
+    // A flush only covers writes that have already completed, so it
+    // needs no ordering against queued I/O and skips the scheduler
+    if (req->op == BLK_OP_FLUSH) {
+        if (q->dispatch_tail) q->dispatch_tail->q_next = req;
+        else q->dispatch_head = req;
+        q->dispatch_tail = req;
+    } else {
+        q->elevator->add(dev, req);
+    }
+}
+
+int blkdev_submit(blk_request_t* req) {
+    blkdev_t* dev = req->dev;
+
+    if (req->op != BLK_OP_FLUSH) {
+        if (req->count == 0 || req->count > dev->max_sectors) return -EINVAL;
+        if (req->lba + req->count > dev->sectors) return -ENXIO;
+        if (req->nr_segs) {
+            uint32_t bytes = 0;
+            if (req->nr_segs > dev->max_segments) return -EINVAL;
+            for (uint16_t i = 0; i < req->nr_segs; i++) {
+                if (((uint32_t)req->segs[i].addr & 1) || (req->segs[i].len % BLK_SECTOR_SIZE)) return -EINVAL;
+                bytes += req->segs[i].len;
+            }
+            if (bytes != req->count * BLK_SECTOR_SIZE) return -EINVAL;
+        } else if ((uint32_t)req->buffer & 1) {
+            return -EINVAL;
+        }
+    }
+
+    req->done = false;
+    req->status = 0;
+    req->flags = 0;
+    req->start_tsc = cpu_rdtsc();
+
+    uint32_t flags = irq_save();
+    dev->stats.in_flight++;
+
+    blk_plug_t* plug = current_plug;
+    if (plug && req->op != BLK_OP_FLUSH) {
+        req->q_next = NULL;
+        if (plug->tail) plug->tail->q_next = req;
+        else plug->head = req;
+        plug->tail = req;
+        if (++plug->count >= BLK_PLUG_MAX) {
+            current_plug = NULL;
+            blk_finish_plug(plug);
+            current_plug = plug;
+        }
+    } else {
+        blk_queue_insert(dev, req);
+        blk_queue_run(dev);
+    }
+
+    irq_restore(flags);
+    return 0;
+}
+
+// Called by drivers, normally from their interrupt handler
+void blk_request_complete(blk_request_t* req, int status) {
+    blkdev_t* dev = req->dev;
+
+    dev->queue.in_driver--;
+    if (req->flags & BLK_REQ_MERGED) {
+        struct blk_merge* m = req->private;
+        blk_request_t* part = m->parts;
+        m->busy = false;
+        while (part) {
+            blk_request_t* next = part->q_next;
+            blk_request_end(part, status);
+            part = next;
+        }
+    } else {
+        blk_request_end(req, status);
+    }
+
+    blk_queue_run(dev);
+}
+
+void blk_start_plug(blk_plug_t* plug) {
+    plug->head = plug->tail = NULL;
+    plug->count = 0;
+    if (!current_plug) current_plug = plug;
+}
+
+// Move everything held to the schedulers, then start the devices
+void blk_finish_plug(blk_plug_t* plug) {
+    if (current_plug == plug) current_plug = NULL;
+
+    uint32_t flags = irq_save();
+    blk_request_t* held = plug->head;
+    plug->head = plug->tail = NULL;
+    plug->count = 0;
+
+    for (blk_request_t* req = held; req; ) {
+        blk_request_t* next = req->q_next;
+        blk_queue_insert(req->dev, req);
+        req = next;
+    }
+    for (size_t i = 0; i < num_devices; i++) {
+        if (devices[i]->queue.queued) blk_queue_run(devices[i]);
+    }
+    irq_restore(flags);
+}
+
+void blkdev_wait(blk_request_t* req) {
+    // Check and halt with interrupts off; "sti; hlt" is atomic with
+    // respect to the wakeup so a completion can't slip in between
+    uint32_t flags = irq_save();
+    while (!req->done) cpu_sleep();
+    irq_restore(flags);
+}
+
+static int blkdev_sync_io(blkdev_t* dev, uint32_t op, uint64_t lba, uint32_t count, void* buffer) {
+    uint8_t* p = buffer;
+
+    while (count > 0) {
+        uint32_t chunk = count < dev->max_sectors ? count : dev->max_sectors;
+        blk_request_t req = {
+            .dev = dev,
+            .op = op,
+            .lba = lba,
+            .count = chunk,
+            .buffer = p,
+        };
+
+        int err = blkdev_submit(&req);
+        if (err) return err;
+        blkdev_wait(&req);
+        if (req.status) return req.status;
+
+        lba += chunk;
+        count -= chunk;
+        p += chunk * dev->sector_size;
+    }
+    return 0;
+}
+
+int blkdev_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    return blkdev_sync_io(dev, BLK_OP_READ, lba, count, buffer);
+}
+
+int blkdev_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    return blkdev_sync_io(dev, BLK_OP_WRITE, lba, count, (void*)buffer);
+}
+
+int blkdev_flush(blkdev_t* dev) {
+    blk_request_t req = {
+        .dev = dev,
+        .op = BLK_OP_FLUSH,
+    };
+
+    int err = blkdev_submit(&req);
+    if (err) return err;
+    blkdev_wait(&req);
+    return req.status;
+}
+
+void blkdev_reset_stats(blkdev_t* dev) {
+    uint32_t flags = irq_save();
+    uint32_t in_flight = dev->stats.in_flight;
+    memset(&dev->stats, 0, sizeof(dev->stats));
+    dev->stats.in_flight = in_flight;
+    irq_restore(flags);
+}
+
+// Upper bound of the bucket holding the given percentile, 0 if empty
+uint32_t blk_latency_percentile(const uint32_t* hist, uint32_t percent) {
+    uint32_t total = 0;
+    for (int i = 0; i < BLK_LAT_BUCKETS; i++) total += hist[i];
+    if (!total) return 0;
+
+    uint32_t target = (uint32_t)div_u64((uint64_t)total * percent + 99, 100);
+    uint32_t seen = 0;
+    for (int i = 0; i < BLK_LAT_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen >= target) return 1u << i;
+    }
+    return 1u << (BLK_LAT_BUCKETS - 1);
+}
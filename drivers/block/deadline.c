@@ -0,0 +1,181 @@
+/**
+ * Deadline I/O scheduler - Bunix OS
+ *
+ * Each direction keeps its requests twice: sorted by LBA (q_next/q_prev)
+ * and in arrival order (fifo_next/fifo_prev). Dispatch normally sweeps
+ * upwards through the sorted list in batches of DEADLINE_FIFO_BATCH; a
+ * new batch starts at the oldest request instead once that one has waited
+ * past its direction's expiry. Reads are preferred, but a pending write
+ * batch is passed over at most DEADLINE_WRITES_STARVED times.
+ */
+
+#include "../../include/block/elevator.h"
+#include "../../include/kernel/arch/x86/cpu.h"
+#include "../../include/mm/kmalloc.h"
+#include "../../include/lib/errno.h"
+
+#define DEADLINE_READ_EXPIRE_MS   500
+#define DEADLINE_WRITE_EXPIRE_MS  5000
+#define DEADLINE_FIFO_BATCH       16
+#define DEADLINE_WRITES_STARVED   2
+
+#define DD_READ   0
+#define DD_WRITE  1
+
+typedef struct {
+    blk_request_t* sort_head[2];
+    blk_request_t* sort_tail[2];
+    blk_request_t* fifo_head[2];
+    blk_request_t* fifo_tail[2];
+    blk_request_t* next_rq[2];      // Continue the sweep here
+    uint32_t count[2];
+    uint32_t batching;              // Requests dispatched in this batch
+    uint32_t starved;               // Read batches chosen over waiting writes
+} deadline_data_t;
+
+static inline int dd_dir(const blk_request_t* req) {
+    return req->op == BLK_OP_WRITE ? DD_WRITE : DD_READ;
+}
+
+static int deadline_init(blkdev_t* dev) {
+    dev->queue.elevator_data = kzalloc(sizeof(deadline_data_t));
+    return dev->queue.elevator_data ? 0 : -ENOMEM;
+}
+
+static void deadline_exit(blkdev_t* dev) {
+    kfree(dev->queue.elevator_data);
+    dev->queue.elevator_data = NULL;
+}
+
+// Insert into the LBA-sorted list; scanning from the tail suits the
+// common case of ascending submissions
+static void dd_sort_insert(deadline_data_t* dd, blk_request_t* req) {
+    int dir = dd_dir(req);
+    blk_request_t* pos = dd->sort_tail[dir];
+
+    while (pos && pos->lba > req->lba) pos = pos->q_prev;
+
+    req->q_prev = pos;
+    req->q_next = pos ? pos->q_next : dd->sort_head[dir];
+    if (req->q_next) req->q_next->q_prev = req;
+    else dd->sort_tail[dir] = req;
+    if (pos) pos->q_next = req;
+    else dd->sort_head[dir] = req;
+}
+
+// Insert into the FIFO by submission time; new requests land at the tail
+static void dd_fifo_insert(deadline_data_t* dd, blk_request_t* req) {
+    int dir = dd_dir(req);
+    blk_request_t* pos = dd->fifo_tail[dir];
+
+    while (pos && pos->start_tsc > req->start_tsc) pos = pos->fifo_prev;
+
+    req->fifo_prev = pos;
+    req->fifo_next = pos ? pos->fifo_next : dd->fifo_head[dir];
+    if (req->fifo_next) req->fifo_next->fifo_prev = req;
+    else dd->fifo_tail[dir] = req;
+    if (pos) pos->fifo_next = req;
+    else dd->fifo_head[dir] = req;
+}
+
+static void dd_remove(deadline_data_t* dd, blk_request_t* req) {
+    int dir = dd_dir(req);
+
+    if (dd->next_rq[dir] == req) dd->next_rq[dir] = req->q_next;
+
+    if (req->q_prev) req->q_prev->q_next = req->q_next;
+    else dd->sort_head[dir] = req->q_next;
+    if (req->q_next) req->q_next->q_prev = req->q_prev;
+    else dd->sort_tail[dir] = req->q_prev;
+
+    if (req->fifo_prev) req->fifo_prev->fifo_next = req->fifo_next;
+    else dd->fifo_head[dir] = req->fifo_next;
+    if (req->fifo_next) req->fifo_next->fifo_prev = req->fifo_prev;
+    else dd->fifo_tail[dir] = req->fifo_prev;
+
+    req->q_next = req->q_prev = NULL;
+    req->fifo_next = req->fifo_prev = NULL;
+    dd->count[dir]--;
+}
+
+static void deadline_add(blkdev_t* dev, blk_request_t* req) {
+    deadline_data_t* dd = dev->queue.elevator_data;
+
+    dd_sort_insert(dd, req);
+    dd_fifo_insert(dd, req);
+    dd->count[dd_dir(req)]++;
+}
+
+static bool dd_fifo_expired(deadline_data_t* dd, int dir) {
+    blk_request_t* oldest = dd->fifo_head[dir];
+    if (!oldest) return false;
+
+    uint64_t limit_ms = dir == DD_READ ? DEADLINE_READ_EXPIRE_MS : DEADLINE_WRITE_EXPIRE_MS;
+    return cpu_tsc_to_ns(cpu_rdtsc() - oldest->start_tsc) > limit_ms * 1000000ull;
+}
+
+static blk_request_t* dd_dispatch(deadline_data_t* dd, blk_request_t* req) {
+    int dir = dd_dir(req);
+
+    dd->next_rq[DD_READ] = dd->next_rq[DD_WRITE] = NULL;
+    dd->next_rq[dir] = req;
+    dd_remove(dd, req);
+    dd->batching++;
+    return req;
+}
+
+static blk_request_t* deadline_next(blkdev_t* dev) {
+    deadline_data_t* dd = dev->queue.elevator_data;
+
+    // Keep sweeping the current batch
+    blk_request_t* req = dd->next_rq[DD_WRITE] ? dd->next_rq[DD_WRITE] : dd->next_rq[DD_READ];
+    if (req && dd->batching < DEADLINE_FIFO_BATCH) return dd_dispatch(dd, req);
+
+    int dir;
+    if (dd->count[DD_READ]) {
+        if (dd->count[DD_WRITE] && dd->starved++ >= DEADLINE_WRITES_STARVED) {
+            dir = DD_WRITE;
+        } else {
+            dir = DD_READ;
+        }
+    } else if (dd->count[DD_WRITE]) {
+        dir = DD_WRITE;
+    } else {
+        return NULL;
+    }
+    if (dir == DD_WRITE) dd->starved = 0;
+
+    // New batch: the oldest request if it is overdue or the sweep ran off
+    // the end, otherwise carry on upwards
+    req = dd->next_rq[dir];
+    if (!req || dd_fifo_expired(dd, dir)) req = dd->fifo_head[dir];
+    dd->batching = 0;
+    return dd_dispatch(dd, req);
+}
+
+static blk_request_t* deadline_take_adjacent(blkdev_t* dev, const blk_request_t* req) {
+    deadline_data_t* dd = dev->queue.elevator_data;
+    int dir = dd_dir(req);
+    blk_request_t* next = dd->next_rq[dir];
+
+    if (!next || next->op != req->op || next->lba != req->lba + req->count) return NULL;
+    dd_remove(dd, next);
+    return next;
+}
+
+static void deadline_requeue(blkdev_t* dev, blk_request_t* req) {
+    deadline_data_t* dd = dev->queue.elevator_data;
+
+    deadline_add(dev, req);
+    dd->next_rq[dd_dir(req)] = req;
+}
+
+elevator_type_t elevator_deadline = {
+    .name = "deadline",
+    .init = deadline_init,
+    .exit = deadline_exit,
+    .add = deadline_add,
+    .next = deadline_next,
+    .take_adjacent = deadline_take_adjacent,
+    .requeue = deadline_requeue,
+};
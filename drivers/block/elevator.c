@@ -0,0 +1,103 @@
+/**
+ * I/O scheduler registry and the noop scheduler - Bunix OS
+ *
+ * noop keeps submission order. It still lets the request queue merge:
+ * when the request at the head of the FIFO continues the one just picked,
+ * it is handed over as an adjacent request.
+ */
+
+#include "../../include/block/elevator.h"
+#include "../../include/mm/kmalloc.h"
+#include "../../include/lib/string.h"
+#include "../../include/lib/errno.h"
+
+static elevator_type_t* elevator_types = NULL;
+
+int elevator_register(elevator_type_t* type) {
+    if (elevator_find(type->name)) return -EEXIST;
+
+    // Append so elevator_get() lists schedulers in registration order
+    elevator_type_t** link = &elevator_types;
+    while (*link) link = &(*link)->next_type;
+    type->next_type = NULL;
+    *link = type;
+    return 0;
+}
+
+elevator_type_t* elevator_find(const char* name) {
+    for (elevator_type_t* type = elevator_types; type; type = type->next_type) {
+        if (strcmp(type->name, name) == 0) return type;
+    }
+    return NULL;
+}
+
+elevator_type_t* elevator_get(int index) {
+    elevator_type_t* type = elevator_types;
+    while (type && index-- > 0) type = type->next_type;
+    return type;
+}
+
+// ---------------------------------------------------------------------------
+// noop
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    blk_request_t* head;
+    blk_request_t* tail;
+} noop_data_t;
+
+static int noop_init(blkdev_t* dev) {
+    dev->queue.elevator_data = kzalloc(sizeof(noop_data_t));
+    return dev->queue.elevator_data ? 0 : -ENOMEM;
+}
+
+static void noop_exit(blkdev_t* dev) {
+    kfree(dev->queue.elevator_data);
+    dev->queue.elevator_data = NULL;
+}
+
+static void noop_add(blkdev_t* dev, blk_request_t* req) {
+    noop_data_t* nd = dev->queue.elevator_data;
+
+    req->q_next = NULL;
+    if (nd->tail) nd->tail->q_next = req;
+    else nd->head = req;
+    nd->tail = req;
+}
+
+static blk_request_t* noop_next(blkdev_t* dev) {
+    noop_data_t* nd = dev->queue.elevator_data;
+    blk_request_t* req = nd->head;
+
+    if (req) {
+        nd->head = req->q_next;
+        if (!nd->head) nd->tail = NULL;
+    }
+    return req;
+}
+
+static blk_request_t* noop_take_adjacent(blkdev_t* dev, const blk_request_t* req) {
+    noop_data_t* nd = dev->queue.elevator_data;
+    blk_request_t* head = nd->head;
+
+    if (!head || head->op != req->op || head->lba != req->lba + req->count) return NULL;
+    return noop_next(dev);
+}
+
+static void noop_requeue(blkdev_t* dev, blk_request_t* req) {
+    noop_data_t* nd = dev->queue.elevator_data;
+
+    req->q_next = nd->head;
+    nd->head = req;
+    if (!nd->tail) nd->tail = req;
+}
+
+elevator_type_t elevator_noop = {
+    .name = "noop",
+    .init = noop_init,
+    .exit = noop_exit,
+    .add = noop_add,
+    .next = noop_next,
+    .take_adjacent = noop_take_adjacent,
+    .requeue = noop_requeue,
+};
@@ -0,0 +1,618 @@
+/**
+ * NVMe driver - Bunix OS
+ *
+ * One admin queue pair for setup, then one I/O submission/completion
+ * queue pair per online CPU so submitters never share a queue. Each I/O
+ * completion queue gets its own MSI-X vector when the controller offers
+ * them, else a single MSI or the legacy INTx line serves every queue.
+ *
+ * Doorbells are batched: requests resubmitted from a completion
+ * callback only advance the SQ tail, and the handler writes each SQ and
+ * CQ doorbell once after draining its queue.
+ */
+
+#include "../../include/block/nvme.h"
+#include "../../include/block/blkdev.h"
+#include "../../include/pci/pci.h"
+#include "../../include/kernel/arch/x86/apic.h"
+#include "../../include/kernel/arch/x86/irq.h"
+#include "../../include/kernel/arch/x86/cpu.h"
+#include "../../include/kernel/ports/mmio.h"
+#include "../../include/mm/vmm.h"
+#include "../../include/mm/kmalloc.h"
+#include "../../include/lib/string.h"
+#include "../../include/lib/errno.h"
+#include "../../include/lib/math64.h"
+
+// Controller registers
+#define NVME_REG_CAP        0x00
+#define NVME_REG_VS         0x08
+#define NVME_REG_INTMS      0x0C
+#define NVME_REG_INTMC      0x10
+#define NVME_REG_CC         0x14
+#define NVME_REG_CSTS       0x1C
+#define NVME_REG_AQA        0x24
+#define NVME_REG_ASQ        0x28
+#define NVME_REG_ACQ        0x30
+#define NVME_REG_DOORBELL   0x1000
+
+#define NVME_CC_ENABLE      (1 << 0)
+#define NVME_CC_IOSQES      (6 << 16)   // 64-byte submission entries
+#define NVME_CC_IOCQES      (4 << 20)   // 16-byte completion entries
+#define NVME_CSTS_RDY       (1 << 0)
+#define NVME_CSTS_CFS       (1 << 1)
+
+// Admin and I/O opcodes
+#define NVME_ADMIN_CREATE_SQ   0x01
+#define NVME_ADMIN_CREATE_CQ   0x05
+#define NVME_ADMIN_IDENTIFY    0x06
+#define NVME_ADMIN_SET_FEATURES 0x09
+#define NVME_CMD_FLUSH      0x00
+#define NVME_CMD_WRITE      0x01
+#define NVME_CMD_READ       0x02
+
+#define NVME_FEAT_NUM_QUEUES 0x07
+#define NVME_ID_CNS_NS      0x00
+#define NVME_ID_CNS_CTRL    0x01
+#define NVME_QUEUE_PHYS_CONTIG (1 << 0)
+#define NVME_CQ_IRQ_ENABLED (1 << 1)
+
+#define NVME_MAX_CONTROLLERS 2
+#define NVME_MAX_IO_QUEUES  8
+#define NVME_ADMIN_QUEUE_SIZE 32
+#define NVME_IO_QUEUE_SIZE  64          // One page of submission entries
+#define NVME_MAX_SECTORS    512         // 256KB: at most 65 PRP entries
+#define NVME_PRP_LIST_SIZE  512         // Bytes per slot, never crosses a page
+#define NVME_ADMIN_TIMEOUT_MS 2000
+
+struct nvme_command {
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t cid;
+    uint32_t nsid;
+    uint64_t reserved;
+    uint64_t metadata;
+    uint64_t prp1;
+    uint64_t prp2;
+    uint32_t cdw10;
+    uint32_t cdw11;
+    uint32_t cdw12;
+    uint32_t cdw13;
+    uint32_t cdw14;
+    uint32_t cdw15;
+} __attribute__((packed));
+
+struct nvme_completion {
+    uint32_t result;
+    uint32_t reserved;
+    uint16_t sq_head;
+    uint16_t sq_id;
+    uint16_t cid;
+    uint16_t status;                    // Bit 0 is the phase tag
+} __attribute__((packed));
+
+struct nvme_controller;
+
+struct nvme_slot {
+    blk_request_t* req;
+    uint64_t* prp_list;
+    struct nvme_slot* next_free;
+};
+
+struct nvme_queue {
+    struct nvme_controller* ctrl;
+    uint16_t qid;
+    uint16_t size;
+    volatile struct nvme_command* sq;
+    volatile struct nvme_completion* cq;
+    uintptr_t sq_doorbell;
+    uintptr_t cq_doorbell;
+    uint16_t sq_tail;
+    uint16_t sq_head;                   // As last reported by the controller
+    uint16_t sq_rung;                   // Tail value the doorbell last saw
+    uint16_t cq_head;
+    uint8_t cq_phase;
+    bool in_completion;                 // Defer SQ doorbells while set
+    int vector;                         // LAPIC vector for MSI-X, else -1
+    struct nvme_slot* slots;
+    struct nvme_slot* free_slots;
+    blk_request_t* wait_head;           // Waiting for a free slot
+    blk_request_t* wait_tail;
+};
+
+struct nvme_controller {
+    pci_device_t* pci;
+    uintptr_t regs;
+    uint32_t doorbell_stride;
+    uint32_t nsid;
+    bool volatile_cache;
+    struct nvme_queue admin;
+    struct nvme_queue io[NVME_MAX_IO_QUEUES];
+    uint32_t nr_io_queues;
+    int shared_vector;                  // Single MSI vector, -1 if unused
+    blkdev_t blk;
+};
+
+static int num_nvme = 0;
+
+static inline uint32_t nvme_read32(struct nvme_controller* ctrl, uint32_t reg) {
+    return mmio_read32(ctrl->regs + reg);
+}
+
+static inline uint64_t nvme_read64(struct nvme_controller* ctrl, uint32_t reg) {
+    return mmio_read32(ctrl->regs + reg) | ((uint64_t)mmio_read32(ctrl->regs + reg + 4) << 32);
+}
+
+static inline void nvme_write32(struct nvme_controller* ctrl, uint32_t reg, uint32_t value) {
+    mmio_write32(ctrl->regs + reg, value);
+}
+
+static inline void nvme_write64(struct nvme_controller* ctrl, uint32_t reg, uint64_t value) {
+    mmio_write32(ctrl->regs + reg, (uint32_t)value);
+    mmio_write32(ctrl->regs + reg + 4, (uint32_t)(value >> 32));
+}
+
+static uint32_t nvme_elapsed_ms(uint64_t start) {
+    return (uint32_t)div_u64(cpu_tsc_to_ns(cpu_rdtsc() - start), 1000000);
+}
+
+static int nvme_queue_alloc(struct nvme_controller* ctrl, struct nvme_queue* q,
+                            uint16_t qid, uint16_t size) {
+    q->ctrl = ctrl;
+    q->qid = qid;
+    q->size = size;
+    q->sq = (volatile struct nvme_command*)vmm_alloc_pages(1);
+    q->cq = (volatile struct nvme_completion*)vmm_alloc_pages(1);
+    if (!q->sq || !q->cq) return -ENOMEM;
+    memset((void*)q->sq, 0, PAGE_SIZE);
+    memset((void*)q->cq, 0, PAGE_SIZE);
+
+    q->sq_doorbell = ctrl->regs + NVME_REG_DOORBELL + (2 * qid) * ctrl->doorbell_stride;
+    q->cq_doorbell = ctrl->regs + NVME_REG_DOORBELL + (2 * qid + 1) * ctrl->doorbell_stride;
+    q->sq_tail = q->sq_head = q->sq_rung = 0;
+    q->cq_head = 0;
+    q->cq_phase = 1;
+    return 0;
+}
+
+// I/O queues carry one slot per command id; the SQ keeps one entry spare
+static int nvme_queue_alloc_slots(struct nvme_queue* q) {
+    uint16_t count = q->size - 1;
+    uint32_t per_page = PAGE_SIZE / NVME_PRP_LIST_SIZE;
+
+    q->slots = kzalloc(sizeof(struct nvme_slot) * count);
+    if (!q->slots) return -ENOMEM;
+
+    uint8_t* prp_page = NULL;
+    for (uint16_t i = 0; i < count; i++) {
+        if (i % per_page == 0) {
+            prp_page = (uint8_t*)vmm_alloc_pages(1);
+            if (!prp_page) return -ENOMEM;
+        }
+        q->slots[i].prp_list = (uint64_t*)(prp_page + (i % per_page) * NVME_PRP_LIST_SIZE);
+    }
+    for (uint16_t i = count; i > 0; i--) {
+        q->slots[i - 1].next_free = q->free_slots;
+        q->free_slots = &q->slots[i - 1];
+    }
+    return 0;
+}
+
+static void nvme_ring_sq(struct nvme_queue* q) {
+    if (q->sq_tail == q->sq_rung) return;
+    mmio_mb();                          // Entries visible before the doorbell
+    mmio_write32(q->sq_doorbell, q->sq_tail);
+    q->sq_rung = q->sq_tail;
+    if (q->qid) q->ctrl->blk.stats.doorbells++;
+}
+
+static void nvme_push(struct nvme_queue* q, const struct nvme_command* cmd) {
+    memcpy((void*)&q->sq[q->sq_tail], cmd, sizeof(*cmd));
+    if (++q->sq_tail == q->size) q->sq_tail = 0;
+    if (!q->in_completion) nvme_ring_sq(q);
+}
+
+// Admin commands are only issued at probe time, so they are polled
+static int nvme_admin_sync(struct nvme_controller* ctrl, struct nvme_command* cmd, uint32_t* result) {
+    struct nvme_queue* q = &ctrl->admin;
+
+    cmd->cid = q->sq_tail;
+    nvme_push(q, cmd);
+
+    uint64_t start = cpu_rdtsc();
+    for (;;) {
+        volatile struct nvme_completion* cqe = &q->cq[q->cq_head];
+        if ((cqe->status & 1) == q->cq_phase) {
+            uint16_t status = cqe->status >> 1;
+            if (result) *result = cqe->result;
+            if (++q->cq_head == q->size) {
+                q->cq_head = 0;
+                q->cq_phase ^= 1;
+            }
+            mmio_write32(q->cq_doorbell, q->cq_head);
+            return status ? -EIO : 0;
+        }
+        if (nvme_elapsed_ms(start) > NVME_ADMIN_TIMEOUT_MS) return -ETIMEDOUT;
+    }
+}
+
+// Fill prp1/prp2 for one contiguous, dword-aligned buffer
+static int nvme_setup_prps(struct nvme_slot* slot, struct nvme_command* cmd,
+                           const void* buffer, uint32_t len) {
+    uint32_t addr = (uint32_t)buffer;
+    if (addr & 3) return -EINVAL;
+
+    cmd->prp1 = addr;
+    uint32_t first = PAGE_SIZE - (addr & (PAGE_SIZE - 1));
+    if (len <= first) return 0;
+
+    uint32_t next = addr + first;
+    len -= first;
+    if (len <= PAGE_SIZE) {
+        cmd->prp2 = next;
+        return 0;
+    }
+
+    uint32_t n = 0;
+    while (len > 0) {
+        slot->prp_list[n++] = next;
+        next += PAGE_SIZE;
+        len = len > PAGE_SIZE ? len - PAGE_SIZE : 0;
+    }
+    cmd->prp2 = (uint32_t)slot->prp_list;
+    return 0;
+}
+
+// Try to put a request on the queue. -ENOSPC means "retry later".
+static int nvme_issue(struct nvme_queue* q, blk_request_t* req) {
+    struct nvme_controller* ctrl = q->ctrl;
+    struct nvme_command cmd;
+
+    if (!q->free_slots) return -ENOSPC;
+    struct nvme_slot* slot = q->free_slots;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.cid = (uint16_t)(slot - q->slots);
+    cmd.nsid = ctrl->nsid;
+
+    if (req->op == BLK_OP_FLUSH) {
+        cmd.opcode = NVME_CMD_FLUSH;
+    } else {
+        const blk_segment_t* segs;
+        blk_segment_t single;
+        if (blk_request_segments(req, &segs, &single) != 1) return -EINVAL;
+
+        int err = nvme_setup_prps(slot, &cmd, segs[0].addr, segs[0].len);
+        if (err) return err;
+
+        cmd.opcode = req->op == BLK_OP_READ ? NVME_CMD_READ : NVME_CMD_WRITE;
+        cmd.cdw10 = (uint32_t)req->lba;
+        cmd.cdw11 = (uint32_t)(req->lba >> 32);
+        cmd.cdw12 = req->count - 1;
+    }
+
+    q->free_slots = slot->next_free;
+    slot->req = req;
+    nvme_push(q, &cmd);
+    return 0;
+}
+
+static void nvme_queue_wait(struct nvme_queue* q, blk_request_t* req) {
+    req->next = NULL;
+    if (q->wait_tail) q->wait_tail->next = req;
+    else q->wait_head = req;
+    q->wait_tail = req;
+}
+
+static void nvme_issue_waiting(struct nvme_queue* q) {
+    while (q->wait_head) {
+        blk_request_t* req = q->wait_head;
+        int err = nvme_issue(q, req);
+        if (err == -ENOSPC) break;
+
+        q->wait_head = req->next;
+        if (!q->wait_head) q->wait_tail = NULL;
+        if (err) blk_request_complete(req, err);
+    }
+}
+
+// Drain one completion queue. Interrupts off.
+static void nvme_process_cq(struct nvme_queue* q) {
+    bool found = false;
+
+    if (!q->slots) return;              // Vector live before the queue exists
+    q->in_completion = true;
+    for (;;) {
+        volatile struct nvme_completion* cqe = &q->cq[q->cq_head];
+        if ((cqe->status & 1) != q->cq_phase) break;
+
+        uint16_t cid = cqe->cid;
+        uint16_t status = cqe->status >> 1;
+        q->sq_head = cqe->sq_head;
+        if (++q->cq_head == q->size) {
+            q->cq_head = 0;
+            q->cq_phase ^= 1;
+        }
+        found = true;
+
+        if (cid >= q->size - 1 || !q->slots[cid].req) continue;
+        struct nvme_slot* slot = &q->slots[cid];
+        blk_request_t* req = slot->req;
+        slot->req = NULL;
+        slot->next_free = q->free_slots;
+        q->free_slots = slot;
+        blk_request_complete(req, status ? -EIO : 0);
+    }
+
+    nvme_issue_waiting(q);
+    q->in_completion = false;
+
+    // One doorbell each for everything consumed and everything resubmitted
+    if (found) {
+        mmio_write32(q->cq_doorbell, q->cq_head);
+        q->ctrl->blk.stats.doorbells++;
+    }
+    nvme_ring_sq(q);
+}
+
+static void nvme_queue_irq(void* ctx) {
+    struct nvme_queue* q = ctx;
+    nvme_process_cq(q);
+}
+
+// Single MSI vector or INTx: every I/O queue shares the interrupt
+static void nvme_ctrl_irq(void* ctx) {
+    struct nvme_controller* ctrl = ctx;
+    for (uint32_t i = 0; i < ctrl->nr_io_queues; i++) nvme_process_cq(&ctrl->io[i]);
+}
+
+// Submitters use the queue pair of the CPU they run on
+static struct nvme_queue* nvme_cpu_queue(struct nvme_controller* ctrl) {
+    return &ctrl->io[lapic_id() % ctrl->nr_io_queues];
+}
+
+static int nvme_submit(blkdev_t* dev, blk_request_t* req) {
+    struct nvme_controller* ctrl = dev->private;
+    struct nvme_queue* q = nvme_cpu_queue(ctrl);
+
+    if (req->op == BLK_OP_FLUSH && !ctrl->volatile_cache) {
+        blk_request_complete(req, 0);   // No write cache, nothing to do
+        return 0;
+    }
+
+    // Keep ordering with anything already waiting for a slot
+    if (q->wait_head) {
+        nvme_queue_wait(q, req);
+        return 0;
+    }
+
+    int err = nvme_issue(q, req);
+    if (err == -ENOSPC) {
+        nvme_queue_wait(q, req);
+        return 0;
+    }
+    return err;
+}
+
+static const blkdev_ops_t nvme_ops = {
+    .submit = nvme_submit,
+};
+
+static int nvme_wait_ready(struct nvme_controller* ctrl, bool ready, uint32_t timeout_ms) {
+    uint64_t start = cpu_rdtsc();
+    for (;;) {
+        uint32_t csts = nvme_read32(ctrl, NVME_REG_CSTS);
+        if (csts == 0xFFFFFFFF || (csts & NVME_CSTS_CFS)) return -EIO;
+        if (!!(csts & NVME_CSTS_RDY) == ready) return 0;
+        if (nvme_elapsed_ms(start) > timeout_ms) return -ETIMEDOUT;
+    }
+}
+
+static int nvme_enable(struct nvme_controller* ctrl) {
+    uint64_t cap = nvme_read64(ctrl, NVME_REG_CAP);
+    uint32_t timeout_ms = ((cap >> 24) & 0xFF) * 500 + 500;
+    uint32_t max_entries = (cap & 0xFFFF) + 1;
+
+    ctrl->doorbell_stride = 4u << ((cap >> 32) & 0xF);
+    if ((cap >> 48) & 0xF) return -ENOSYS;   // Needs pages larger than 4KB
+
+    nvme_write32(ctrl, NVME_REG_CC, 0);
+    int err = nvme_wait_ready(ctrl, false, timeout_ms);
+    if (err) return err;
+
+    uint16_t admin_size = max_entries < NVME_ADMIN_QUEUE_SIZE ? max_entries : NVME_ADMIN_QUEUE_SIZE;
+    err = nvme_queue_alloc(ctrl, &ctrl->admin, 0, admin_size);
+    if (err) return err;
+
+    nvme_write32(ctrl, NVME_REG_AQA, ((admin_size - 1) << 16) | (admin_size - 1));
+    nvme_write64(ctrl, NVME_REG_ASQ, (uint32_t)ctrl->admin.sq);
+    nvme_write64(ctrl, NVME_REG_ACQ, (uint32_t)ctrl->admin.cq);
+    nvme_write32(ctrl, NVME_REG_CC, NVME_CC_ENABLE | NVME_CC_IOSQES | NVME_CC_IOCQES);
+    return nvme_wait_ready(ctrl, true, timeout_ms);
+}
+
+static int nvme_identify(struct nvme_controller* ctrl, uint32_t* max_sectors) {
+    struct nvme_command cmd;
+    uint8_t* data = (uint8_t*)vmm_alloc_pages(1);
+    if (!data) return -ENOMEM;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.opcode = NVME_ADMIN_IDENTIFY;
+    cmd.prp1 = (uint32_t)data;
+    cmd.cdw10 = NVME_ID_CNS_CTRL;
+    int err = nvme_admin_sync(ctrl, &cmd, NULL);
+    if (err) goto out;
+
+    // MDTS is a power of two in minimum-page units, 0 for no limit
+    uint8_t mdts = data[77];
+    *max_sectors = NVME_MAX_SECTORS;
+    if (mdts && mdts < 12 && ((PAGE_SIZE << mdts) / BLK_SECTOR_SIZE) < *max_sectors) {
+        *max_sectors = (PAGE_SIZE << mdts) / BLK_SECTOR_SIZE;
+    }
+    ctrl->volatile_cache = data[525] & 1;
+    uint32_t namespaces = *(uint32_t*)&data[516];
+    if (namespaces == 0) {
+        err = -ENODEV;
+        goto out;
+    }
+
+    ctrl->nsid = 1;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.opcode = NVME_ADMIN_IDENTIFY;
+    cmd.nsid = ctrl->nsid;
+    cmd.prp1 = (uint32_t)data;
+    cmd.cdw10 = NVME_ID_CNS_NS;
+    err = nvme_admin_sync(ctrl, &cmd, NULL);
+    if (err) goto out;
+
+    uint64_t nsze = *(uint64_t*)&data[0];
+    uint8_t format = data[26] & 0xF;
+    uint8_t lbads = data[128 + format * 4 + 2];
+    if (nsze == 0) {
+        err = -ENODEV;
+    } else if (lbads != 9) {
+        err = -ENOSYS;                  // The block layer works in 512-byte sectors
+    } else {
+        ctrl->blk.sectors = nsze;
+    }
+
+out:
+    vmm_free_pages((uint32_t*)data, 1);
+    return err;
+}
+
+static int nvme_create_io_queue(struct nvme_controller* ctrl, struct nvme_queue* q,
+                                uint16_t qid, uint16_t size, uint16_t irq_vector) {
+    struct nvme_command cmd;
+
+    int err = nvme_queue_alloc(ctrl, q, qid, size);
+    if (!err) err = nvme_queue_alloc_slots(q);
+    if (err) return err;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.opcode = NVME_ADMIN_CREATE_CQ;
+    cmd.prp1 = (uint32_t)q->cq;
+    cmd.cdw10 = ((uint32_t)(size - 1) << 16) | qid;
+    cmd.cdw11 = ((uint32_t)irq_vector << 16) | NVME_CQ_IRQ_ENABLED | NVME_QUEUE_PHYS_CONTIG;
+    err = nvme_admin_sync(ctrl, &cmd, NULL);
+    if (err) return err;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.opcode = NVME_ADMIN_CREATE_SQ;
+    cmd.prp1 = (uint32_t)q->sq;
+    cmd.cdw10 = ((uint32_t)(size - 1) << 16) | qid;
+    cmd.cdw11 = ((uint32_t)qid << 16) | NVME_QUEUE_PHYS_CONTIG;
+    return nvme_admin_sync(ctrl, &cmd, NULL);
+}
+
+// MSI-X with a vector per queue, else one MSI vector, else INTx
+static int nvme_setup_interrupts(struct nvme_controller* ctrl) {
+    pci_device_t* pci = ctrl->pci;
+    uint8_t vectors[NVME_MAX_IO_QUEUES];
+
+    ctrl->shared_vector = -1;
+    if (lapic_available() && pci_msix_table_size(pci) >= ctrl->nr_io_queues) {
+        uint32_t i;
+        for (i = 0; i < ctrl->nr_io_queues; i++) {
+            int vector = lapic_alloc_vector(nvme_queue_irq, &ctrl->io[i]);
+            if (vector < 0) break;
+            ctrl->io[i].vector = vector;
+            vectors[i] = (uint8_t)vector;
+        }
+        if (i == ctrl->nr_io_queues && pci_enable_msix(pci, vectors, i) == 0) return 0;
+        while (i-- > 0) {
+            lapic_free_vector((uint8_t)ctrl->io[i].vector);
+            ctrl->io[i].vector = -1;
+        }
+    }
+
+    if (lapic_available() && pci_find_capability(pci, PCI_CAP_ID_MSI)) {
+        int vector = lapic_alloc_vector(nvme_ctrl_irq, ctrl);
+        if (vector >= 0) {
+            if (pci_enable_msi(pci, (uint8_t)vector) == 0) {
+                ctrl->shared_vector = vector;
+                return 0;
+            }
+            lapic_free_vector((uint8_t)vector);
+        }
+    }
+
+    if (!pci->irq_pin || pci->irq_line >= IRQ_LINES) return -ENODEV;
+    return irq_register(pci->irq_line, nvme_ctrl_irq, ctrl);
+}
+
+static int nvme_probe(pci_device_t* pci) {
+    if (num_nvme >= NVME_MAX_CONTROLLERS) return -ENOSPC;
+    if (pci_bar_is_io(pci, 0)) return -ENODEV;
+
+    struct nvme_controller* ctrl = kzalloc(sizeof(struct nvme_controller));
+    if (!ctrl) return -ENOMEM;
+    ctrl->pci = pci;
+    ctrl->regs = pci_bar_address(pci, 0);
+    for (int i = 0; i < NVME_MAX_IO_QUEUES; i++) ctrl->io[i].vector = -1;
+    pci_enable(pci, PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
+
+    int err = nvme_enable(ctrl);
+    uint32_t max_sectors = NVME_MAX_SECTORS;
+    if (!err) err = nvme_identify(ctrl, &max_sectors);
+    if (err) goto fail;
+
+    // One pair per online CPU. Only the boot CPU runs today; the queue is
+    // picked by APIC ID so application processors slot in once started.
+    uint32_t wanted = 1;
+    struct nvme_command cmd;
+    uint32_t granted = 0;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.opcode = NVME_ADMIN_SET_FEATURES;
+    cmd.cdw10 = NVME_FEAT_NUM_QUEUES;
+    cmd.cdw11 = ((wanted - 1) << 16) | (wanted - 1);
+    err = nvme_admin_sync(ctrl, &cmd, &granted);
+    if (err) goto fail;
+    uint32_t sqs = (granted & 0xFFFF) + 1, cqs = (granted >> 16) + 1;
+    ctrl->nr_io_queues = wanted;
+    if (sqs < ctrl->nr_io_queues) ctrl->nr_io_queues = sqs;
+    if (cqs < ctrl->nr_io_queues) ctrl->nr_io_queues = cqs;
+
+    err = nvme_setup_interrupts(ctrl);
+    if (err) goto fail;
+
+    uint32_t max_entries = (nvme_read64(ctrl, NVME_REG_CAP) & 0xFFFF) + 1;
+    uint16_t size = max_entries < NVME_IO_QUEUE_SIZE ? max_entries : NVME_IO_QUEUE_SIZE;
+    for (uint32_t i = 0; i < ctrl->nr_io_queues; i++) {
+        // MSI-X entry i serves queue i; shared MSI and INTx use entry 0
+        uint16_t iv = ctrl->io[i].vector >= 0 ? i : 0;
+        err = nvme_create_io_queue(ctrl, &ctrl->io[i], i + 1, size, iv);
+        if (err) goto fail;
+    }
+
+    blkdev_t* blk = &ctrl->blk;
+    strcpy(blk->name, "nvme0n1");
+    blk->name[4] = '0' + num_nvme;
+    blk->sector_size = BLK_SECTOR_SIZE;
+    blk->max_sectors = max_sectors;
+    blk->max_segments = 1;              // PRPs cannot describe unaligned gaps
+    blk->queue_depth = (size - 1) * ctrl->nr_io_queues;
+    blk->ops = &nvme_ops;
+    blk->private = ctrl;
+
+    err = blkdev_register(blk);
+    if (err) goto fail;
+
+    num_nvme++;
+    return 0;
+
+fail:
+    // Queue memory stays with the disabled controller; probing only fails at boot
+    nvme_write32(ctrl, NVME_REG_CC, 0);
+    return err;
+}
+
+int nvme_init(void) {
+    pci_device_t* pci;
+
+    for (size_t i = 0; (pci = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_NVME, i)) != NULL; i++) {
+        if (pci->prog_if != 0x02) continue;     // NVM Express I/O controller
+        nvme_probe(pci);
+    }
+    return num_nvme;
+}
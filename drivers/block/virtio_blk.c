@@ -0,0 +1,292 @@
+/**
+ * virtio block driver - Bunix OS
+ *
+ * Every block request becomes one virtqueue entry: a header, the data
+ * segments and a status byte. With indirect descriptors that whole list
+ * sits in a side table, so a queue of N descriptors keeps N requests in
+ * flight. Requests that find the ring full wait in a driver queue and are
+ * issued from the completion interrupt.
+ */
+
+#include "../../include/block/virtio_blk.h"
+#include "../../include/block/blkdev.h"
+#include "../../include/virtio/virtio.h"
+#include "../../include/kernel/arch/x86/irq.h"
+#include "../../include/mm/kmalloc.h"
+#include "../../include/lib/string.h"
+#include "../../include/lib/errno.h"
+
+// Feature bits
+#define VIRTIO_BLK_F_SIZE_MAX   1
+#define VIRTIO_BLK_F_SEG_MAX    2
+#define VIRTIO_BLK_F_RO         5
+#define VIRTIO_BLK_F_BLK_SIZE   6
+#define VIRTIO_BLK_F_FLUSH      9
+
+// Device configuration layout
+#define VIRTIO_BLK_CFG_CAPACITY 0
+#define VIRTIO_BLK_CFG_SIZE_MAX 8
+#define VIRTIO_BLK_CFG_SEG_MAX  12
+
+// Request types and status
+#define VIRTIO_BLK_T_IN         0
+#define VIRTIO_BLK_T_OUT        1
+#define VIRTIO_BLK_T_FLUSH      4
+#define VIRTIO_BLK_S_OK         0
+#define VIRTIO_BLK_S_UNSUPP     2
+
+#define VBLK_MAX_DEVICES        4
+#define VBLK_MAX_SECTORS        2048    // 1MB per request
+#define VBLK_MAX_SEGMENTS       (VIRTQ_INDIRECT_MAX - 2)
+#define VBLK_QUEUE_SIZE         256
+
+struct virtio_blk_req_hdr {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed));
+
+struct vblk_slot {
+    struct virtio_blk_req_hdr hdr;
+    uint8_t status;
+    blk_request_t* req;
+    struct vblk_slot* next_free;
+};
+
+struct virtio_blk {
+    virtio_device_t vdev;
+    virtqueue_t vq;
+    blkdev_t blk;
+    bool read_only;
+    uint32_t size_max;                  // Largest single data buffer, 0 if unlimited
+    struct vblk_slot* slots;
+    struct vblk_slot* free_slots;
+    blk_request_t* wait_head;           // Waiting for ring space
+    blk_request_t* wait_tail;
+};
+
+static int num_vblk = 0;
+
+// Try to place a request on the ring. -ENOSPC means "retry later".
+static int vblk_issue(struct virtio_blk* vb, blk_request_t* req) {
+    virtq_buf_t bufs[VIRTQ_INDIRECT_MAX];
+    uint16_t n = 0;
+    bool is_read = (req->op == BLK_OP_READ);
+
+    if (!vb->free_slots) return -ENOSPC;
+    struct vblk_slot* slot = vb->free_slots;
+
+    slot->hdr.type = req->op == BLK_OP_READ ? VIRTIO_BLK_T_IN :
+                     req->op == BLK_OP_WRITE ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_FLUSH;
+    slot->hdr.reserved = 0;
+    slot->hdr.sector = req->op == BLK_OP_FLUSH ? 0 : req->lba;
+    slot->status = 0xFF;
+    slot->req = req;
+
+    bufs[n].addr = (uint32_t)&slot->hdr;
+    bufs[n++].len = sizeof(slot->hdr);
+
+    if (req->op != BLK_OP_FLUSH) {
+        const blk_segment_t* segs;
+        blk_segment_t single;
+        uint16_t nr_segs = blk_request_segments(req, &segs, &single);
+
+        for (uint16_t s = 0; s < nr_segs; s++) {
+            uint32_t addr = (uint32_t)segs[s].addr;
+            uint32_t left = segs[s].len;
+            while (left > 0) {
+                uint32_t chunk = (vb->size_max && left > vb->size_max) ? vb->size_max : left;
+                if (n >= VIRTQ_INDIRECT_MAX - 1) return -EINVAL;
+                bufs[n].addr = addr;
+                bufs[n++].len = chunk;
+                addr += chunk;
+                left -= chunk;
+            }
+        }
+    }
+
+    bufs[n].addr = (uint32_t)&slot->status;
+    bufs[n++].len = 1;
+
+    // Header (and write data) is device-readable, the rest device-writable
+    uint16_t out = is_read || req->op == BLK_OP_FLUSH ? 1 : n - 1;
+    int err = virtqueue_add(&vb->vq, bufs, out, n - out, slot);
+    if (err) return err;
+
+    vb->free_slots = slot->next_free;
+    return 0;
+}
+
+// Notify the device unless EVENT_IDX says it is still processing
+static void vblk_kick(struct virtio_blk* vb) {
+    if (virtqueue_kick_prepare(&vb->vq)) {
+        virtqueue_notify(&vb->vq);
+        vb->blk.stats.doorbells++;
+    }
+}
+
+static void vblk_queue_wait(struct virtio_blk* vb, blk_request_t* req) {
+    req->next = NULL;
+    if (vb->wait_tail) vb->wait_tail->next = req;
+    else vb->wait_head = req;
+    vb->wait_tail = req;
+}
+
+static void vblk_issue_waiting(struct virtio_blk* vb) {
+    while (vb->wait_head) {
+        blk_request_t* req = vb->wait_head;
+        int err = vblk_issue(vb, req);
+        if (err == -ENOSPC) break;
+
+        vb->wait_head = req->next;
+        if (!vb->wait_head) vb->wait_tail = NULL;
+        if (err) blk_request_complete(req, err);
+    }
+}
+
+static void vblk_irq_handler(void* ctx) {
+    struct virtio_blk* vb = ctx;
+
+    // Bit 0: used ring updated. Zero means another device on a shared line.
+    if (!(virtio_read_isr(&vb->vdev) & 1)) return;
+
+    do {
+        virtqueue_disable_cb(&vb->vq);
+
+        struct vblk_slot* slot;
+        while ((slot = virtqueue_get_buf(&vb->vq, NULL)) != NULL) {
+            blk_request_t* req = slot->req;
+            int status = slot->status == VIRTIO_BLK_S_OK ? 0 :
+                         slot->status == VIRTIO_BLK_S_UNSUPP ? -ENOSYS : -EIO;
+
+            slot->req = NULL;
+            slot->next_free = vb->free_slots;
+            vb->free_slots = slot;
+            blk_request_complete(req, status);
+        }
+    } while (virtqueue_enable_cb(&vb->vq));
+
+    vblk_issue_waiting(vb);
+    vblk_kick(vb);
+}
+
+static int vblk_submit(blkdev_t* dev, blk_request_t* req) {
+    struct virtio_blk* vb = dev->private;
+
+    if (req->op == BLK_OP_WRITE && vb->read_only) return -EROFS;
+    if (req->op == BLK_OP_FLUSH && !virtio_has_feature(&vb->vdev, VIRTIO_BLK_F_FLUSH)) {
+        blk_request_complete(req, 0);   // Write-through device, nothing to do
+        return 0;
+    }
+
+    // Keep ordering with anything already waiting for ring space
+    if (vb->wait_head) {
+        vblk_queue_wait(vb, req);
+        return 0;
+    }
+
+    int err = vblk_issue(vb, req);
+    if (err == -ENOSPC) {
+        vblk_queue_wait(vb, req);
+        return 0;
+    }
+    if (err) return err;
+
+    vblk_kick(vb);
+    return 0;
+}
+
+static const blkdev_ops_t vblk_ops = {
+    .submit = vblk_submit,
+};
+
+static int vblk_probe(pci_device_t* pci) {
+    if (num_vblk >= VBLK_MAX_DEVICES) return -ENOSPC;
+
+    struct virtio_blk* vb = kzalloc(sizeof(struct virtio_blk));
+    if (!vb) return -ENOMEM;
+
+    virtio_device_t* vdev = &vb->vdev;
+    int err = virtio_pci_init(vdev, pci);
+    if (err) goto fail_free;
+
+    virtio_negotiate(vdev, VIRTIO_FEATURE(VIRTIO_BLK_F_SIZE_MAX) |
+                           VIRTIO_FEATURE(VIRTIO_BLK_F_SEG_MAX) |
+                           VIRTIO_FEATURE(VIRTIO_BLK_F_RO) |
+                           VIRTIO_FEATURE(VIRTIO_BLK_F_FLUSH) |
+                           VIRTIO_FEATURE(VIRTIO_F_RING_INDIRECT_DESC) |
+                           VIRTIO_FEATURE(VIRTIO_F_RING_EVENT_IDX));
+    err = virtio_features_ok(vdev);
+    if (err) goto fail_device;
+
+    err = virtqueue_setup(vdev, &vb->vq, 0, VBLK_QUEUE_SIZE);
+    if (err) goto fail_device;
+
+    uint16_t slots = vb->vq.size;
+    vb->slots = kzalloc(sizeof(struct vblk_slot) * slots);
+    if (!vb->slots) {
+        err = -ENOMEM;
+        goto fail_device;
+    }
+    for (uint16_t i = 0; i < slots; i++) {
+        vb->slots[i].next_free = vb->free_slots;
+        vb->free_slots = &vb->slots[i];
+    }
+
+    uint32_t max_segments = VBLK_MAX_SEGMENTS;
+    if (virtio_has_feature(vdev, VIRTIO_BLK_F_SEG_MAX)) {
+        uint32_t seg_max = virtio_config_read32(vdev, VIRTIO_BLK_CFG_SEG_MAX);
+        if (seg_max && seg_max < max_segments) max_segments = seg_max;
+    }
+    if (!vb->vq.indirect && max_segments > vb->vq.size - 2u) max_segments = vb->vq.size - 2u;
+    if (virtio_has_feature(vdev, VIRTIO_BLK_F_SIZE_MAX)) {
+        vb->size_max = virtio_config_read32(vdev, VIRTIO_BLK_CFG_SIZE_MAX) & ~(BLK_SECTOR_SIZE - 1);
+    }
+    vb->read_only = virtio_has_feature(vdev, VIRTIO_BLK_F_RO);
+
+    blkdev_t* blk = &vb->blk;
+    strcpy(blk->name, "vda");
+    blk->name[2] = 'a' + num_vblk;
+    blk->sector_size = BLK_SECTOR_SIZE;
+    blk->sectors = virtio_config_read64(vdev, VIRTIO_BLK_CFG_CAPACITY);
+    blk->max_sectors = VBLK_MAX_SECTORS;
+    blk->max_segments = max_segments;
+    // Without indirect tables each request holds at least three descriptors
+    blk->queue_depth = vb->vq.indirect ? vb->vq.size : vb->vq.size / 3;
+    blk->ops = &vblk_ops;
+    blk->private = vb;
+
+    err = irq_register(vdev->irq, vblk_irq_handler, vb);
+    if (err) goto fail_device;
+
+    virtqueue_enable_cb(&vb->vq);
+    virtio_driver_ok(vdev);
+
+    err = blkdev_register(blk);
+    if (err) {
+        irq_unregister(vdev->irq, vblk_irq_handler, vb);
+        goto fail_device;
+    }
+
+    num_vblk++;
+    return 0;
+
+fail_device:
+    virtio_fail(vdev);
+fail_free:
+    kfree(vb->slots);
+    kfree(vb);
+    return err;
+}
+
+int virtio_blk_init(void) {
+    pci_device_t* pci;
+
+    for (size_t i = 0; (pci = pci_get_device(i)) != NULL; i++) {
+        if (pci->vendor_id != VIRTIO_PCI_VENDOR) continue;
+        if (pci->device_id != VIRTIO_PCI_LEGACY_BLK &&
+            pci->device_id != VIRTIO_PCI_MODERN_BASE + VIRTIO_ID_BLOCK) continue;
+        vblk_probe(pci);
+    }
+    return num_vblk;
+}
@@ -1,5 +1,8 @@
 #include "../../include/kernel/ports/ports.h"
 #include "../../include/keyboard/kb.h"
+#include "../../include/kernel/sched/idle.h"
+#include "../../include/kernel/arch/x86/irq.h"
+#include "../../include/kernel/perf/trace.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
@@ -29,6 +32,14 @@ static kb_state_t kb_state = {
     false, false, false, false
 };
 
+#define KB_IRQ 1
+
+// Data stays in the controller for kb_getchar; the interrupt is only
+// there to end an idle_sleep
+static void kb_irq(void* ctx) {
+    (void)ctx;
+}
+
 int kb_init(void) {
     kb_state.shift_pressed = false;
     kb_state.ctrl_pressed = false;
@@ -38,7 +49,7 @@ int kb_init(void) {
     kb_state.boot_complete = false;
     kb_state.left_shift_pressed = false;
     kb_state.right_shift_pressed = false;
-    return 0;
+    return irq_register(KB_IRQ, kb_irq, NULL);
 }
 
 void kb_enable_input(bool enable) {
@@ -109,10 +120,19 @@ char kb_getchar(void) {
     
     uint8_t scancode;
     while (1) {
-        // Wait for key press
-        while ((inb(KB_STATUS_PORT) & 0x01) == 0);
+        // Wait for key press, doing background work meanwhile
+        while ((inb(KB_STATUS_PORT) & 0x01) == 0) {
+            idle_poll();
+
+            // Checked again with interrupts off: a key arriving now still
+            // ends the halt, since "sti; hlt" is atomic
+            uint32_t flags = irq_save();
+            if ((inb(KB_STATUS_PORT) & 0x01) == 0) idle_sleep();
+            irq_restore(flags);
+        }
         
         scancode = inb(KB_DATA_PORT);
+        TRACE(TRACE_KB_SCANCODE, scancode, 0, 0);
 
         // Handle key release
         if (scancode & 0x80) {
@@ -125,7 +145,10 @@ char kb_getchar(void) {
         
         // Convert to ASCII
         char c = scancode_to_ascii(scancode);
-        if (c != 0) return c;
+        if (c != 0) {
+            TRACE(TRACE_KB_KEY, c, 0, 0);
+            return c;
+        }
     }
 }
 
@@ -0,0 +1,536 @@
+/**
+ * Intel 8254x (e1000) network driver - Bunix OS
+ *
+ * Both descriptor rings are one page each from the page allocator, which
+ * hands out physically contiguous runs, and every buffer is an skb from
+ * the packet pool: the NIC receives straight into pool buffers and
+ * transmits straight out of them.
+ *
+ * Receive is polled like virtio-net: the interrupt masks the receive
+ * causes and schedules the poller, which unmasks them once the ring is
+ * empty. Any frame that arrives while they are masked still latches in
+ * ICR, so unmasking raises it at once and nothing is missed. Consumed
+ * slots are refilled a batch at a time, one tail write per batch. The
+ * Interrupt Throttling Register bounds the interrupt rate while the
+ * device is between polling and idle.
+ *
+ * Transmit interrupts stay masked. Descriptors are reclaimed when the
+ * ring is next used, and the tail register is written from ops->flush.
+ * Checksum offload takes a context descriptor, sent only when the
+ * offsets differ from the last packet's.
+ */
+
+#include "../../include/net/e1000.h"
+#include "../../include/net/netdev.h"
+#include "../../include/net/ethernet.h"
+#include "../../include/pci/pci.h"
+#include "../../include/kernel/arch/x86/irq.h"
+#include "../../include/kernel/arch/x86/cpu.h"
+#include "../../include/kernel/ports/mmio.h"
+#include "../../include/mm/vmm.h"
+#include "../../include/mm/kmalloc.h"
+#include "../../include/lib/string.h"
+#include "../../include/lib/errno.h"
+
+#define INTEL_VENDOR_ID          0x8086
+
+// Registers
+#define E1000_CTRL               0x0000
+#define E1000_STATUS             0x0008
+#define E1000_EERD               0x0014
+#define E1000_ICR                0x00C0
+#define E1000_ITR                0x00C4
+#define E1000_IMS                0x00D0
+#define E1000_IMC                0x00D8
+#define E1000_RCTL               0x0100
+#define E1000_TCTL               0x0400
+#define E1000_TIPG               0x0410
+#define E1000_RDBAL              0x2800
+#define E1000_RDBAH              0x2804
+#define E1000_RDLEN              0x2808
+#define E1000_RDH                0x2810
+#define E1000_RDT                0x2818
+#define E1000_RDTR               0x2820
+#define E1000_RADV               0x282C
+#define E1000_TDBAL              0x3800
+#define E1000_TDBAH              0x3804
+#define E1000_TDLEN              0x3808
+#define E1000_TDH                0x3810
+#define E1000_TDT                0x3818
+#define E1000_RXCSUM             0x5000
+#define E1000_MTA                0x5200
+#define E1000_RAL                0x5400
+#define E1000_RAH                0x5404
+
+#define E1000_CTRL_ASDE          (1u << 5)
+#define E1000_CTRL_SLU           (1u << 6)
+#define E1000_CTRL_RST           (1u << 26)
+
+#define E1000_EERD_START         (1u << 0)
+#define E1000_EERD_DONE          (1u << 4)
+
+#define E1000_RAH_AV             (1u << 31)
+
+// Interrupt causes
+#define E1000_ICR_LSC            (1u << 2)
+#define E1000_ICR_RXSEQ          (1u << 3)
+#define E1000_ICR_RXDMT0         (1u << 4)
+#define E1000_ICR_RXO            (1u << 6)
+#define E1000_ICR_RXT0           (1u << 7)
+#define E1000_IMS_RX             (E1000_ICR_RXDMT0 | E1000_ICR_RXO | E1000_ICR_RXT0)
+
+#define E1000_RCTL_EN            (1u << 1)
+#define E1000_RCTL_BAM           (1u << 15)
+#define E1000_RCTL_BSIZE_2048    (0u << 16)
+#define E1000_RCTL_SECRC         (1u << 26)
+
+#define E1000_TCTL_EN            (1u << 1)
+#define E1000_TCTL_PSP           (1u << 3)   // Pad short frames
+#define E1000_TCTL_CT            (0x10u << 4)
+#define E1000_TCTL_COLD          (0x40u << 12)
+#define E1000_TIPG_COPPER        (10u | (8u << 10) | (6u << 20))
+
+#define E1000_RXCSUM_TUOFL       (1u << 9)
+
+// Receive descriptor status and errors
+#define E1000_RXD_STAT_DD        0x01
+#define E1000_RXD_STAT_EOP       0x02
+#define E1000_RXD_STAT_IXSM      0x04   // Checksum not reported
+#define E1000_RXD_STAT_TCPCS     0x20   // TCP/UDP checksum checked
+#define E1000_RXD_ERR_TCPE       0x20
+#define E1000_RXD_ERR_FRAME      0x97   // CE, SE, SEQ, CXE, RXE
+
+// Transmit descriptor command and status
+#define E1000_TXD_CMD_EOP        0x01000000u
+#define E1000_TXD_CMD_IFCS       0x02000000u
+#define E1000_TXD_CMD_RS         0x08000000u
+#define E1000_TXD_CMD_DEXT       0x20000000u
+#define E1000_TXD_DTYP_D         0x00100000u
+#define E1000_TXD_POPTS_TXSM     0x02
+#define E1000_TXD_STAT_DD        0x01
+
+#define E1000_MAX_DEVICES        4
+#define E1000_RING_SIZE          256    // 16-byte descriptors: one page per ring
+#define E1000_RX_REFILL_BATCH    16     // Slots refilled per tail write
+#define E1000_TX_WAIT_MS         10
+#define E1000_DEFAULT_IRQ_RATE   8000   // Interrupts per second at most
+#define E1000_ITR_UNIT_NS        256
+
+struct e1000_rx_desc {
+    uint64_t addr;
+    uint16_t length;
+    uint16_t csum;
+    uint8_t status;
+    uint8_t errors;
+    uint16_t special;
+} __attribute__((packed));
+
+// Legacy and extended data descriptors share this layout. A legacy one
+// leaves its checksum offset (bits 16-23 of cmd_len) and start zero.
+struct e1000_tx_desc {
+    uint64_t addr;
+    uint32_t cmd_len;
+    uint8_t status;
+    uint8_t popts;
+    uint16_t special;
+} __attribute__((packed));
+
+struct e1000_context_desc {
+    uint8_t ipcss;
+    uint8_t ipcso;
+    uint16_t ipcse;
+    uint8_t tucss;
+    uint8_t tucso;
+    uint16_t tucse;
+    uint32_t cmd_len;
+    uint8_t status;
+    uint8_t hdr_len;
+    uint16_t mss;
+} __attribute__((packed));
+
+struct e1000 {
+    pci_device_t* pci;
+    uintptr_t regs;
+    netdev_t dev;
+
+    volatile struct e1000_rx_desc* rx_ring;
+    sk_buff_t** rx_skb;
+    uint16_t rx_next;                   // Next slot the NIC completes
+    uint16_t rx_tail;                   // Next slot to refill; RDT
+
+    volatile struct e1000_tx_desc* tx_ring;
+    sk_buff_t** tx_skb;                 // NULL on context descriptors
+    uint16_t tx_clean;                  // Oldest slot not yet reclaimed
+    uint16_t tx_tail;                   // Next slot to fill
+    uint16_t tx_tail_written;           // TDT as the NIC last saw it
+    int16_t ctx_css;                    // Offload context loaded, -1 if none
+    int16_t ctx_cso;
+};
+
+static int num_e1000 = 0;
+
+static const uint16_t e1000_device_ids[] = {
+    0x100E,                             // 82540EM, QEMU's default NIC
+    0x100F,                             // 82545EM copper
+    0x1004,                             // 82543GC copper
+    0,
+};
+
+static inline uint32_t e1000_read(struct e1000* nic, uint32_t reg) {
+    return mmio_read32(nic->regs + reg);
+}
+
+static inline void e1000_write(struct e1000* nic, uint32_t reg, uint32_t val) {
+    mmio_write32(nic->regs + reg, val);
+}
+
+static inline uint16_t ring_next(uint16_t i) {
+    return (i + 1) & (E1000_RING_SIZE - 1);
+}
+
+// Slots between 'from' and 'to' going round the ring
+static inline uint16_t ring_distance(uint16_t from, uint16_t to) {
+    return (to - from) & (E1000_RING_SIZE - 1);
+}
+
+// Refill consumed receive slots, a batch at a time unless the NIC is
+// close to running out
+static void e1000_rx_refill(struct e1000* nic) {
+    uint16_t posted = ring_distance(nic->rx_next, nic->rx_tail);
+    uint16_t empty = E1000_RING_SIZE - 1 - posted;
+    if (empty < E1000_RX_REFILL_BATCH && posted >= E1000_RX_REFILL_BATCH) return;
+
+    uint16_t added = 0;
+    while (empty--) {
+        sk_buff_t* skb = skb_alloc();
+        if (!skb) break;
+        volatile struct e1000_rx_desc* desc = &nic->rx_ring[nic->rx_tail];
+        desc->addr = (uint32_t)skb->data;
+        desc->status = 0;
+        nic->rx_skb[nic->rx_tail] = skb;
+        nic->rx_tail = ring_next(nic->rx_tail);
+        added++;
+    }
+    if (added) {
+        mmio_barrier();
+        e1000_write(nic, E1000_RDT, nic->rx_tail);
+    }
+}
+
+static void e1000_tx_reclaim(struct e1000* nic) {
+    while (nic->tx_clean != nic->tx_tail) {
+        uint16_t i = nic->tx_clean;
+        // A context descriptor completes with the data descriptor after it
+        uint16_t data = nic->tx_skb[i] ? i : ring_next(i);
+        if (!(nic->tx_ring[data].status & E1000_TXD_STAT_DD)) break;
+
+        skb_free(nic->tx_skb[data]);
+        nic->tx_skb[data] = NULL;
+        nic->tx_clean = ring_next(data);
+    }
+}
+
+static int e1000_poll(netdev_t* dev, int budget) {
+    struct e1000* nic = dev->private;
+    int done = 0;
+
+    dev->stats.polls++;
+    e1000_tx_reclaim(nic);
+
+    while (done < budget && nic->rx_next != nic->rx_tail) {
+        volatile struct e1000_rx_desc* desc = &nic->rx_ring[nic->rx_next];
+        uint8_t status = desc->status;
+        if (!(status & E1000_RXD_STAT_DD)) break;
+        mmio_barrier();
+
+        uint8_t errors = desc->errors;
+        uint16_t len = desc->length;
+        sk_buff_t* skb = nic->rx_skb[nic->rx_next];
+        nic->rx_skb[nic->rx_next] = NULL;
+        nic->rx_next = ring_next(nic->rx_next);
+        done++;
+
+        // 2KB buffers hold any frame without long-packet mode
+        if (!(status & E1000_RXD_STAT_EOP) || (errors & E1000_RXD_ERR_FRAME) ||
+            len > skb_tailroom(skb)) {
+            dev->stats.rx_errors++;
+            skb_free(skb);
+            continue;
+        }
+
+        skb_put(skb, len);
+        if (!(status & E1000_RXD_STAT_IXSM) && (status & E1000_RXD_STAT_TCPCS) &&
+            !(errors & E1000_RXD_ERR_TCPE)) {
+            skb->ip_summed = CHECKSUM_UNNECESSARY;
+        }
+        if (!eth_type_trans(skb, dev)) {
+            dev->stats.rx_dropped++;
+            skb_free(skb);
+            continue;
+        }
+        netif_receive_skb(skb);
+    }
+    e1000_rx_refill(nic);
+
+    // Ran dry: unmask. Frames that came in meanwhile raise it straight away.
+    if (done < budget) e1000_write(nic, E1000_IMS, E1000_IMS_RX);
+    return done;
+}
+
+static int e1000_xmit(netdev_t* dev, sk_buff_t* skb) {
+    struct e1000* nic = dev->private;
+    int16_t css = -1, cso = -1;
+
+    if (skb->ip_summed == CHECKSUM_PARTIAL) {
+        css = skb->csum_start - (skb->data - skb->head);
+        cso = css + skb->csum_offset;
+    }
+    uint16_t needed = (css >= 0 && (css != nic->ctx_css || cso != nic->ctx_cso)) ? 2 : 1;
+
+    uint16_t room = E1000_RING_SIZE - 1 - ring_distance(nic->tx_clean, nic->tx_tail);
+    if (room < needed) {
+        e1000_tx_reclaim(nic);
+        room = E1000_RING_SIZE - 1 - ring_distance(nic->tx_clean, nic->tx_tail);
+    }
+    if (room < needed) {
+        // Full: hand over everything queued and give the NIC a moment
+        dev->ops->flush(dev);
+        uint64_t start = cpu_rdtsc();
+        while (room < needed && cpu_tsc_to_ns(cpu_rdtsc() - start) < E1000_TX_WAIT_MS * 1000000ull) {
+            cpu_pause();
+            e1000_tx_reclaim(nic);
+            room = E1000_RING_SIZE - 1 - ring_distance(nic->tx_clean, nic->tx_tail);
+        }
+        if (room < needed) {
+            skb_free(skb);
+            return -ENOBUFS;
+        }
+    }
+
+    if (needed == 2) {
+        volatile struct e1000_context_desc* ctx =
+            (volatile struct e1000_context_desc*)&nic->tx_ring[nic->tx_tail];
+        ctx->ipcss = ctx->ipcso = 0;
+        ctx->ipcse = 0;
+        ctx->tucss = css;
+        ctx->tucso = cso;
+        ctx->tucse = 0;                 // To the end of the frame
+        ctx->cmd_len = E1000_TXD_CMD_DEXT;
+        ctx->status = 0;
+        ctx->hdr_len = 0;
+        ctx->mss = 0;
+        nic->tx_skb[nic->tx_tail] = NULL;
+        nic->tx_tail = ring_next(nic->tx_tail);
+        nic->ctx_css = css;
+        nic->ctx_cso = cso;
+    }
+
+    volatile struct e1000_tx_desc* desc = &nic->tx_ring[nic->tx_tail];
+    desc->addr = (uint32_t)skb->data;
+    desc->cmd_len = skb->len | E1000_TXD_CMD_EOP | E1000_TXD_CMD_IFCS | E1000_TXD_CMD_RS;
+    desc->popts = 0;
+    if (css >= 0) {
+        desc->cmd_len |= E1000_TXD_CMD_DEXT | E1000_TXD_DTYP_D;
+        desc->popts = E1000_TXD_POPTS_TXSM;
+    }
+    desc->status = 0;
+    desc->special = 0;
+    nic->tx_skb[nic->tx_tail] = skb;
+    nic->tx_tail = ring_next(nic->tx_tail);
+    return 0;
+}
+
+static void e1000_flush(netdev_t* dev) {
+    struct e1000* nic = dev->private;
+    if (nic->tx_tail == nic->tx_tail_written) return;
+
+    mmio_barrier();
+    e1000_write(nic, E1000_TDT, nic->tx_tail);
+    nic->tx_tail_written = nic->tx_tail;
+    dev->stats.doorbells++;
+}
+
+// ITR counts in 256ns units; 0 turns throttling off
+static int e1000_set_coalesce(netdev_t* dev, uint32_t rate) {
+    struct e1000* nic = dev->private;
+    uint32_t itr = rate ? 1000000000u / E1000_ITR_UNIT_NS / rate : 0;
+    if (itr > 0xFFFF) itr = 0xFFFF;
+
+    e1000_write(nic, E1000_ITR, itr);
+    dev->coalesce_rate = rate;
+    return 0;
+}
+
+static void e1000_irq_handler(void* ctx) {
+    struct e1000* nic = ctx;
+
+    // Reading clears it. Zero means another device on a shared line.
+    uint32_t icr = e1000_read(nic, E1000_ICR);
+    if (!icr) return;
+
+    nic->dev.stats.interrupts++;
+    if (icr & E1000_IMS_RX) {
+        e1000_write(nic, E1000_IMC, E1000_IMS_RX);
+        napi_schedule(&nic->dev);
+    }
+}
+
+static const netdev_ops_t e1000_ops = {
+    .xmit = e1000_xmit,
+    .flush = e1000_flush,
+    .poll = e1000_poll,
+    .set_coalesce = e1000_set_coalesce,
+};
+
+static bool e1000_is_supported(uint16_t device_id) {
+    for (int i = 0; e1000_device_ids[i]; i++) {
+        if (e1000_device_ids[i] == device_id) return true;
+    }
+    return false;
+}
+
+static bool e1000_eeprom_read(struct e1000* nic, uint8_t word, uint16_t* out) {
+    e1000_write(nic, E1000_EERD, E1000_EERD_START | ((uint32_t)word << 8));
+    for (int spin = 0; spin < 100000; spin++) {
+        uint32_t v = e1000_read(nic, E1000_EERD);
+        if (v & E1000_EERD_DONE) {
+            *out = v >> 16;
+            return true;
+        }
+        cpu_pause();
+    }
+    return false;
+}
+
+// The receive address registers come up loaded from the EEPROM; read
+// the EEPROM directly only if they didn't
+static int e1000_read_mac(struct e1000* nic, uint8_t* mac) {
+    uint32_t ral = e1000_read(nic, E1000_RAL);
+    uint32_t rah = e1000_read(nic, E1000_RAH);
+
+    if (!(rah & E1000_RAH_AV)) {
+        uint16_t w[3];
+        for (int i = 0; i < 3; i++) {
+            if (!e1000_eeprom_read(nic, i, &w[i])) return -EIO;
+        }
+        ral = w[0] | ((uint32_t)w[1] << 16);
+        rah = w[2];
+    }
+    for (int i = 0; i < 4; i++) mac[i] = ral >> (i * 8);
+    mac[4] = rah;
+    mac[5] = rah >> 8;
+
+    e1000_write(nic, E1000_RAL, ral);
+    e1000_write(nic, E1000_RAH, (rah & 0xFFFF) | E1000_RAH_AV);
+    return 0;
+}
+
+static void e1000_reset(struct e1000* nic) {
+    e1000_write(nic, E1000_IMC, 0xFFFFFFFF);
+    e1000_write(nic, E1000_CTRL, e1000_read(nic, E1000_CTRL) | E1000_CTRL_RST);
+    for (int spin = 0; spin < 100000 && (e1000_read(nic, E1000_CTRL) & E1000_CTRL_RST); spin++) {
+        cpu_pause();
+    }
+    e1000_write(nic, E1000_IMC, 0xFFFFFFFF);
+    e1000_read(nic, E1000_ICR);
+}
+
+static void e1000_setup_rx(struct e1000* nic) {
+    for (int i = 0; i < 128; i++) e1000_write(nic, E1000_MTA + i * 4, 0);
+
+    e1000_write(nic, E1000_RDBAL, (uint32_t)nic->rx_ring);
+    e1000_write(nic, E1000_RDBAH, 0);
+    e1000_write(nic, E1000_RDLEN, E1000_RING_SIZE * sizeof(struct e1000_rx_desc));
+    e1000_write(nic, E1000_RDH, 0);
+    e1000_write(nic, E1000_RDT, 0);
+    // No receive delay timers: the ITR does the moderating
+    e1000_write(nic, E1000_RDTR, 0);
+    e1000_write(nic, E1000_RADV, 0);
+    e1000_write(nic, E1000_RXCSUM, E1000_RXCSUM_TUOFL);
+    e1000_rx_refill(nic);
+    e1000_write(nic, E1000_RCTL, E1000_RCTL_EN | E1000_RCTL_BAM | E1000_RCTL_BSIZE_2048 |
+                                 E1000_RCTL_SECRC);
+}
+
+static void e1000_setup_tx(struct e1000* nic) {
+    e1000_write(nic, E1000_TDBAL, (uint32_t)nic->tx_ring);
+    e1000_write(nic, E1000_TDBAH, 0);
+    e1000_write(nic, E1000_TDLEN, E1000_RING_SIZE * sizeof(struct e1000_tx_desc));
+    e1000_write(nic, E1000_TDH, 0);
+    e1000_write(nic, E1000_TDT, 0);
+    e1000_write(nic, E1000_TIPG, E1000_TIPG_COPPER);
+    e1000_write(nic, E1000_TCTL, E1000_TCTL_EN | E1000_TCTL_PSP | E1000_TCTL_CT | E1000_TCTL_COLD);
+}
+
+static int e1000_probe(pci_device_t* pci) {
+    if (num_e1000 >= E1000_MAX_DEVICES) return -ENOSPC;
+    if (pci_bar_is_io(pci, 0) || !pci_bar_address(pci, 0)) return -ENODEV;
+    if (!pci->irq_pin || pci->irq_line >= IRQ_LINES) return -ENODEV;
+
+    struct e1000* nic = kzalloc(sizeof(struct e1000));
+    if (!nic) return -ENOMEM;
+    nic->pci = pci;
+    nic->regs = pci_bar_address(pci, 0);
+    nic->ctx_css = nic->ctx_cso = -1;
+
+    int err = -ENOMEM;
+    nic->rx_ring = (volatile struct e1000_rx_desc*)vmm_alloc_pages(1);
+    nic->tx_ring = (volatile struct e1000_tx_desc*)vmm_alloc_pages(1);
+    nic->rx_skb = kzalloc(sizeof(sk_buff_t*) * E1000_RING_SIZE);
+    nic->tx_skb = kzalloc(sizeof(sk_buff_t*) * E1000_RING_SIZE);
+    if (!nic->rx_ring || !nic->tx_ring || !nic->rx_skb || !nic->tx_skb) goto fail_free;
+    memset((void*)nic->rx_ring, 0, PAGE_SIZE);
+    memset((void*)nic->tx_ring, 0, PAGE_SIZE);
+
+    pci_enable(pci, PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
+    e1000_reset(nic);
+
+    netdev_t* dev = &nic->dev;
+    err = e1000_read_mac(nic, dev->mac);
+    if (err) goto fail_free;
+
+    e1000_write(nic, E1000_CTRL, e1000_read(nic, E1000_CTRL) | E1000_CTRL_SLU | E1000_CTRL_ASDE);
+    e1000_setup_rx(nic);
+    e1000_setup_tx(nic);
+
+    ether_setup(dev);
+    dev->features = NETIF_F_HW_CSUM | NETIF_F_RXCSUM;
+    dev->ops = &e1000_ops;
+    dev->private = nic;
+    e1000_set_coalesce(dev, E1000_DEFAULT_IRQ_RATE);
+
+    err = irq_register(pci->irq_line, e1000_irq_handler, nic);
+    if (err) goto fail_reset;
+
+    err = netdev_register(dev);
+    if (err) {
+        irq_unregister(pci->irq_line, e1000_irq_handler, nic);
+        goto fail_reset;
+    }
+    e1000_write(nic, E1000_IMS, E1000_IMS_RX | E1000_ICR_LSC | E1000_ICR_RXSEQ);
+
+    num_e1000++;
+    return 0;
+
+fail_reset:
+    // The receive buffers stay with the stopped NIC; probing only fails at boot
+    e1000_reset(nic);
+    return err;
+fail_free:
+    if (nic->rx_ring) vmm_free_pages((uint32_t*)nic->rx_ring, 1);
+    if (nic->tx_ring) vmm_free_pages((uint32_t*)nic->tx_ring, 1);
+    kfree(nic->rx_skb);
+    kfree(nic->tx_skb);
+    kfree(nic);
+    return err;
+}
+
+int e1000_init(void) {
+    pci_device_t* pci;
+
+    for (size_t i = 0; (pci = pci_get_device(i)) != NULL; i++) {
+        if (pci->vendor_id != INTEL_VENDOR_ID || !e1000_is_supported(pci->device_id)) continue;
+        e1000_probe(pci);
+    }
+    return num_e1000;
+}
@@ -0,0 +1,319 @@
+/**
+ * virtio network driver - Bunix OS
+ *
+ * Receive uses mergeable buffers: the ring is kept full of plain 2KB skb
+ * buffers, one descriptor each, and the device writes its header and the
+ * frame straight into them. A frame may span several buffers, but at an
+ * Ethernet MTU one always suffices, so a longer one is drained and
+ * counted as an error rather than reassembled.
+ *
+ * The interrupt only turns itself off and schedules the poller; frames
+ * are taken off the ring from net_poll() until it runs dry, and only then
+ * is the interrupt turned back on. Under load the device is polled and
+ * stays quiet. Transmit interrupts are never enabled: completed skbs are
+ * reclaimed when the ring is next used, and the doorbell is rung from
+ * ops->flush so a batch of packets costs one notification.
+ */
+
+#include "../../include/net/virtio_net.h"
+#include "../../include/net/netdev.h"
+#include "../../include/net/ethernet.h"
+#include "../../include/virtio/virtio.h"
+#include "../../include/kernel/arch/x86/irq.h"
+#include "../../include/kernel/arch/x86/cpu.h"
+#include "../../include/mm/kmalloc.h"
+#include "../../include/lib/string.h"
+#include "../../include/lib/errno.h"
+
+// Feature bits
+#define VIRTIO_NET_F_CSUM        0      // Device checksums what we leave partial
+#define VIRTIO_NET_F_GUEST_CSUM  1      // Device may hand us partial or verified checksums
+#define VIRTIO_NET_F_MAC         5
+#define VIRTIO_NET_F_MRG_RXBUF   15
+#define VIRTIO_F_ANY_LAYOUT      27
+
+// Device configuration layout
+#define VIRTIO_NET_CFG_MAC       0
+
+// virtio_net_hdr.flags
+#define VIRTIO_NET_HDR_F_NEEDS_CSUM 1
+#define VIRTIO_NET_HDR_F_DATA_VALID 2
+
+#define VNET_MAX_DEVICES         4
+#define VNET_QUEUE_SIZE          256
+#define VNET_RX_QUEUE            0
+#define VNET_TX_QUEUE            1
+#define VNET_TX_WAIT_MS          10     // For the device to free ring space
+
+struct virtio_net_hdr {
+    uint8_t flags;
+    uint8_t gso_type;
+    uint16_t hdr_len;
+    uint16_t gso_size;
+    uint16_t csum_start;
+    uint16_t csum_offset;
+    uint16_t num_buffers;               // Only with MRG_RXBUF or VERSION_1
+} __attribute__((packed));
+
+struct virtio_net {
+    virtio_device_t vdev;
+    virtqueue_t rxq;
+    virtqueue_t txq;
+    netdev_t dev;
+    uint16_t hdr_len;                   // 12 with num_buffers, 10 without
+    bool mergeable;
+    bool any_layout;                    // Header may share a descriptor with the frame
+};
+
+static int num_vnet = 0;
+
+// Place header and frame on the ring. Without ANY_LAYOUT the header must
+// have a descriptor of its own, even though it sits right before the frame.
+static int vnet_add(struct virtio_net* vn, virtqueue_t* vq, uint8_t* buf, uint32_t len,
+                    bool device_writes, sk_buff_t* skb) {
+    virtq_buf_t bufs[2];
+    uint16_t n = 0;
+
+    if (!vn->any_layout) {
+        bufs[n].addr = (uint32_t)buf;
+        bufs[n++].len = vn->hdr_len;
+        buf += vn->hdr_len;
+        len -= vn->hdr_len;
+    }
+    bufs[n].addr = (uint32_t)buf;
+    bufs[n++].len = len;
+
+    return device_writes ? virtqueue_add(vq, bufs, 0, n, skb) : virtqueue_add(vq, bufs, n, 0, skb);
+}
+
+static void vnet_kick(struct virtio_net* vn, virtqueue_t* vq) {
+    if (virtqueue_kick_prepare(vq)) {
+        virtqueue_notify(vq);
+        vn->dev.stats.doorbells++;
+    }
+}
+
+// Fill every free receive slot, then tell the device once
+static void vnet_refill(struct virtio_net* vn) {
+    uint16_t added = 0;
+    uint16_t per_buf = vn->any_layout ? 1 : 2;
+
+    while (vn->rxq.num_free >= per_buf) {
+        sk_buff_t* skb = skb_alloc();
+        if (!skb) break;
+        if (vnet_add(vn, &vn->rxq, skb->data, skb_tailroom(skb), true, skb)) {
+            skb_free(skb);
+            break;
+        }
+        added++;
+    }
+    if (added) vnet_kick(vn, &vn->rxq);
+}
+
+static void vnet_tx_reclaim(struct virtio_net* vn) {
+    sk_buff_t* skb;
+    while ((skb = virtqueue_get_buf(&vn->txq, NULL)) != NULL) skb_free(skb);
+}
+
+// Turn a used receive buffer into a frame for the stack, or NULL if it
+// had to be dropped
+static sk_buff_t* vnet_receive(struct virtio_net* vn, sk_buff_t* skb, uint32_t len) {
+    netdev_t* dev = &vn->dev;
+    struct virtio_net_hdr* hdr = (struct virtio_net_hdr*)skb->data;
+    uint16_t buffers = vn->mergeable ? hdr->num_buffers : 1;
+    bool bad = len < vn->hdr_len + ETH_HLEN || len > skb_tailroom(skb) || buffers > 1;
+
+    // The rest of an oversized frame is already on the used ring
+    while (buffers-- > 1) {
+        sk_buff_t* rest = virtqueue_get_buf(&vn->rxq, NULL);
+        if (!rest) break;
+        skb_free(rest);
+    }
+    if (bad) {
+        dev->stats.rx_errors++;
+        skb_free(skb);
+        return NULL;
+    }
+
+    // A partial checksum comes from a sender on this host: the data never
+    // crossed a wire, like loopback
+    if (hdr->flags & (VIRTIO_NET_HDR_F_NEEDS_CSUM | VIRTIO_NET_HDR_F_DATA_VALID)) {
+        skb->ip_summed = CHECKSUM_UNNECESSARY;
+    }
+    skb_put(skb, len);
+    skb_pull(skb, vn->hdr_len);
+
+    if (!eth_type_trans(skb, dev)) {
+        dev->stats.rx_dropped++;
+        skb_free(skb);
+        return NULL;
+    }
+    return skb;
+}
+
+static int vnet_poll(netdev_t* dev, int budget) {
+    struct virtio_net* vn = dev->private;
+    int done = 0;
+
+    dev->stats.polls++;
+    vnet_tx_reclaim(vn);
+
+    while (done < budget) {
+        uint32_t len;
+        sk_buff_t* skb = virtqueue_get_buf(&vn->rxq, &len);
+        if (!skb) break;
+        done++;
+        skb = vnet_receive(vn, skb, len);
+        if (skb) netif_receive_skb(skb);
+    }
+    vnet_refill(vn);
+
+    // Ran dry: back to interrupts, unless a frame slipped in meanwhile
+    if (done < budget && virtqueue_enable_cb(&vn->rxq)) {
+        virtqueue_disable_cb(&vn->rxq);
+        napi_schedule(dev);
+    }
+    return done;
+}
+
+static int vnet_xmit(netdev_t* dev, sk_buff_t* skb) {
+    struct virtio_net* vn = dev->private;
+    uint16_t per_buf = vn->any_layout ? 1 : 2;
+
+    if (skb_headroom(skb) < vn->hdr_len) {
+        skb_free(skb);
+        return -EINVAL;
+    }
+
+    struct virtio_net_hdr* hdr = (struct virtio_net_hdr*)skb_push(skb, vn->hdr_len);
+    memset(hdr, 0, vn->hdr_len);
+    if (skb->ip_summed == CHECKSUM_PARTIAL) {
+        // Offsets count from the start of the frame, after this header
+        hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+        hdr->csum_start = skb->csum_start - (skb->data - skb->head) - vn->hdr_len;
+        hdr->csum_offset = skb->csum_offset;
+    }
+
+    if (vn->txq.num_free < per_buf) vnet_tx_reclaim(vn);
+    if (vn->txq.num_free < per_buf) {
+        // Full: make sure the device knows about everything queued and
+        // give it a moment to catch up
+        vnet_kick(vn, &vn->txq);
+        uint64_t start = cpu_rdtsc();
+        while (vn->txq.num_free < per_buf &&
+               cpu_tsc_to_ns(cpu_rdtsc() - start) < VNET_TX_WAIT_MS * 1000000ull) {
+            cpu_pause();
+            vnet_tx_reclaim(vn);
+        }
+    }
+
+    int err = vnet_add(vn, &vn->txq, skb->data, skb->len, false, skb);
+    if (err) {
+        skb_free(skb);
+        return -ENOBUFS;
+    }
+    return 0;
+}
+
+static void vnet_flush(netdev_t* dev) {
+    struct virtio_net* vn = dev->private;
+    vnet_kick(vn, &vn->txq);
+}
+
+static void vnet_irq_handler(void* ctx) {
+    struct virtio_net* vn = ctx;
+
+    // Bit 0: used ring updated. Zero means another device on a shared line.
+    if (!(virtio_read_isr(&vn->vdev) & 1)) return;
+
+    vn->dev.stats.interrupts++;
+    virtqueue_disable_cb(&vn->rxq);
+    napi_schedule(&vn->dev);
+}
+
+static const netdev_ops_t vnet_ops = {
+    .xmit = vnet_xmit,
+    .flush = vnet_flush,
+    .poll = vnet_poll,
+};
+
+static int vnet_probe(pci_device_t* pci) {
+    if (num_vnet >= VNET_MAX_DEVICES) return -ENOSPC;
+
+    struct virtio_net* vn = kzalloc(sizeof(struct virtio_net));
+    if (!vn) return -ENOMEM;
+
+    virtio_device_t* vdev = &vn->vdev;
+    int err = virtio_pci_init(vdev, pci);
+    if (err) goto fail_free;
+
+    virtio_negotiate(vdev, VIRTIO_FEATURE(VIRTIO_NET_F_CSUM) |
+                           VIRTIO_FEATURE(VIRTIO_NET_F_GUEST_CSUM) |
+                           VIRTIO_FEATURE(VIRTIO_NET_F_MAC) |
+                           VIRTIO_FEATURE(VIRTIO_NET_F_MRG_RXBUF) |
+                           VIRTIO_FEATURE(VIRTIO_F_ANY_LAYOUT) |
+                           VIRTIO_FEATURE(VIRTIO_F_RING_EVENT_IDX));
+    err = virtio_features_ok(vdev);
+    if (err) goto fail_device;
+
+    bool version_1 = virtio_has_feature(vdev, VIRTIO_F_VERSION_1);
+    vn->mergeable = virtio_has_feature(vdev, VIRTIO_NET_F_MRG_RXBUF);
+    vn->any_layout = version_1 || virtio_has_feature(vdev, VIRTIO_F_ANY_LAYOUT);
+    vn->hdr_len = (vn->mergeable || version_1) ? sizeof(struct virtio_net_hdr)
+                                               : sizeof(struct virtio_net_hdr) - 2;
+
+    err = virtqueue_setup(vdev, &vn->rxq, VNET_RX_QUEUE, VNET_QUEUE_SIZE);
+    if (!err) err = virtqueue_setup(vdev, &vn->txq, VNET_TX_QUEUE, VNET_QUEUE_SIZE);
+    if (err) goto fail_device;
+
+    netdev_t* dev = &vn->dev;
+    ether_setup(dev);
+    if (virtio_has_feature(vdev, VIRTIO_NET_F_MAC)) {
+        for (int i = 0; i < ETH_ALEN; i++) dev->mac[i] = virtio_config_read8(vdev, VIRTIO_NET_CFG_MAC + i);
+    } else {
+        // Locally administered, QEMU's prefix
+        uint32_t r = (uint32_t)cpu_rdtsc();
+        const uint8_t mac[ETH_ALEN] = { 0x52, 0x54, 0x00, r >> 16, r >> 8, r };
+        memcpy(dev->mac, mac, ETH_ALEN);
+    }
+    if (virtio_has_feature(vdev, VIRTIO_NET_F_CSUM)) dev->features |= NETIF_F_HW_CSUM;
+    if (virtio_has_feature(vdev, VIRTIO_NET_F_GUEST_CSUM)) dev->features |= NETIF_F_RXCSUM;
+    dev->ops = &vnet_ops;
+    dev->private = vn;
+
+    err = irq_register(vdev->irq, vnet_irq_handler, vn);
+    if (err) goto fail_device;
+
+    virtqueue_disable_cb(&vn->txq);
+    virtqueue_enable_cb(&vn->rxq);
+    virtio_driver_ok(vdev);
+
+    err = netdev_register(dev);
+    if (err) {
+        irq_unregister(vdev->irq, vnet_irq_handler, vn);
+        goto fail_device;
+    }
+
+    // The device may not be notified before DRIVER_OK
+    vnet_refill(vn);
+    num_vnet++;
+    return 0;
+
+fail_device:
+    virtio_fail(vdev);
+fail_free:
+    kfree(vn);
+    return err;
+}
+
+int virtio_net_init(void) {
+    pci_device_t* pci;
+
+    for (size_t i = 0; (pci = pci_get_device(i)) != NULL; i++) {
+        if (pci->vendor_id != VIRTIO_PCI_VENDOR) continue;
+        if (pci->device_id != VIRTIO_PCI_LEGACY_NET &&
+            pci->device_id != VIRTIO_PCI_MODERN_BASE + VIRTIO_ID_NET) continue;
+        vnet_probe(pci);
+    }
+    return num_vnet;
+}
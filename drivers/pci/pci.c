@@ -0,0 +1,255 @@
+/**
+ * PCI bus enumeration - Bunix OS
+ *
+ * Uses configuration mechanism #1 (ports 0xCF8/0xCFC). Every function found
+ * at boot is recorded once so drivers can look devices up by ID or class
+ * without touching configuration space again.
+ */
+
+#include "../../include/pci/pci.h"
+#include "../../include/kernel/ports/ports.h"
+#include "../../include/kernel/ports/mmio.h"
+#include "../../include/kernel/arch/x86/apic.h"
+#include "../../include/lib/errno.h"
+
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA    0xCFC
+
+// MSI capability layout
+#define PCI_MSI_FLAGS        2
+#define PCI_MSI_ADDRESS_LO   4
+#define PCI_MSI_DATA_32      8
+#define PCI_MSI_DATA_64      12
+#define PCI_MSI_FLAGS_ENABLE 0x0001
+#define PCI_MSI_FLAGS_QMASK  0x000E
+#define PCI_MSI_FLAGS_QSIZE  0x0070
+#define PCI_MSI_FLAGS_64BIT  0x0080
+
+// MSI-X capability and table layout
+#define PCI_MSIX_FLAGS        2
+#define PCI_MSIX_TABLE        4
+#define PCI_MSIX_FLAGS_QSIZE  0x07FF
+#define PCI_MSIX_FLAGS_MASKALL 0x4000
+#define PCI_MSIX_FLAGS_ENABLE 0x8000
+#define PCI_MSIX_TABLE_BIR    0x7
+#define PCI_MSIX_ENTRY_SIZE   16
+#define PCI_MSIX_ENTRY_ADDR_LO 0
+#define PCI_MSIX_ENTRY_ADDR_HI 4
+#define PCI_MSIX_ENTRY_DATA    8
+#define PCI_MSIX_ENTRY_CTRL    12
+#define PCI_MSIX_ENTRY_MASKED  1
+
+static pci_device_t devices[PCI_MAX_DEVICES];
+static size_t num_devices = 0;
+
+static uint32_t pci_address(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    return (1u << 31) | ((uint32_t)bus << 16) | ((uint32_t)slot << 11) |
+           ((uint32_t)func << 8) | (offset & 0xFC);
+}
+
+static uint32_t pci_read_raw(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    outl(PCI_CONFIG_ADDRESS, pci_address(bus, slot, func, offset));
+    return inl(PCI_CONFIG_DATA);
+}
+
+uint32_t pci_config_read32(const pci_device_t* dev, uint8_t offset) {
+    return pci_read_raw(dev->bus, dev->slot, dev->func, offset);
+}
+
+uint16_t pci_config_read16(const pci_device_t* dev, uint8_t offset) {
+    return pci_config_read32(dev, offset) >> ((offset & 2) * 8);
+}
+
+uint8_t pci_config_read8(const pci_device_t* dev, uint8_t offset) {
+    return pci_config_read32(dev, offset) >> ((offset & 3) * 8);
+}
+
+void pci_config_write32(const pci_device_t* dev, uint8_t offset, uint32_t value) {
+    outl(PCI_CONFIG_ADDRESS, pci_address(dev->bus, dev->slot, dev->func, offset));
+    outl(PCI_CONFIG_DATA, value);
+}
+
+void pci_config_write16(const pci_device_t* dev, uint8_t offset, uint16_t value) {
+    uint32_t shift = (offset & 2) * 8;
+    uint32_t dword = pci_config_read32(dev, offset);
+    dword = (dword & ~(0xFFFFu << shift)) | ((uint32_t)value << shift);
+    pci_config_write32(dev, offset, dword);
+}
+
+void pci_config_write8(const pci_device_t* dev, uint8_t offset, uint8_t value) {
+    uint32_t shift = (offset & 3) * 8;
+    uint32_t dword = pci_config_read32(dev, offset);
+    dword = (dword & ~(0xFFu << shift)) | ((uint32_t)value << shift);
+    pci_config_write32(dev, offset, dword);
+}
+
+static void pci_record(uint8_t bus, uint8_t slot, uint8_t func) {
+    if (num_devices >= PCI_MAX_DEVICES) return;
+
+    pci_device_t* dev = &devices[num_devices++];
+    dev->bus = bus;
+    dev->slot = slot;
+    dev->func = func;
+
+    uint32_t id = pci_config_read32(dev, PCI_VENDOR_ID);
+    uint32_t class_rev = pci_config_read32(dev, PCI_REVISION_ID);
+    uint32_t irq = pci_config_read32(dev, PCI_INTERRUPT_LINE);
+
+    dev->vendor_id = id & 0xFFFF;
+    dev->device_id = id >> 16;
+    dev->revision = class_rev & 0xFF;
+    dev->prog_if = (class_rev >> 8) & 0xFF;
+    dev->subclass = (class_rev >> 16) & 0xFF;
+    dev->class_code = class_rev >> 24;
+    dev->subsystem_id = pci_config_read16(dev, PCI_SUBSYSTEM_ID);
+    dev->irq_line = irq & 0xFF;
+    dev->irq_pin = (irq >> 8) & 0xFF;
+
+    for (int i = 0; i < 6; i++) {
+        dev->bar[i] = pci_config_read32(dev, PCI_BAR0 + i * 4);
+    }
+}
+
+void pci_init(void) {
+    num_devices = 0;
+
+    for (uint32_t bus = 0; bus < 256; bus++) {
+        for (uint8_t slot = 0; slot < 32; slot++) {
+            if ((pci_read_raw(bus, slot, 0, PCI_VENDOR_ID) & 0xFFFF) == 0xFFFF) continue;
+
+            uint8_t header = pci_read_raw(bus, slot, 0, PCI_HEADER_TYPE & 0xFC) >> 16;
+            uint8_t funcs = (header & 0x80) ? 8 : 1;
+
+            for (uint8_t func = 0; func < funcs; func++) {
+                if ((pci_read_raw(bus, slot, func, PCI_VENDOR_ID) & 0xFFFF) == 0xFFFF) continue;
+                pci_record(bus, slot, func);
+            }
+        }
+    }
+}
+
+size_t pci_device_count(void) {
+    return num_devices;
+}
+
+pci_device_t* pci_get_device(size_t index) {
+    return index < num_devices ? &devices[index] : NULL;
+}
+
+pci_device_t* pci_find_device(uint16_t vendor, uint16_t device, size_t index) {
+    for (size_t i = 0; i < num_devices; i++) {
+        if (devices[i].vendor_id == vendor && devices[i].device_id == device) {
+            if (index-- == 0) return &devices[i];
+        }
+    }
+    return NULL;
+}
+
+pci_device_t* pci_find_class(uint8_t class_code, uint8_t subclass, size_t index) {
+    for (size_t i = 0; i < num_devices; i++) {
+        if (devices[i].class_code == class_code && devices[i].subclass == subclass) {
+            if (index-- == 0) return &devices[i];
+        }
+    }
+    return NULL;
+}
+
+bool pci_bar_is_io(const pci_device_t* dev, int bar) {
+    return dev->bar[bar] & 1;
+}
+
+uint32_t pci_bar_address(const pci_device_t* dev, int bar) {
+    if (pci_bar_is_io(dev, bar)) return dev->bar[bar] & ~0x3u;
+    return dev->bar[bar] & ~0xFu;
+}
+
+uint32_t pci_bar_size(const pci_device_t* dev, int bar) {
+    uint8_t offset = PCI_BAR0 + bar * 4;
+    uint32_t original = pci_config_read32(dev, offset);
+
+    // Standard sizing probe: write all ones, read back the writable mask
+    pci_config_write32(dev, offset, 0xFFFFFFFF);
+    uint32_t mask = pci_config_read32(dev, offset);
+    pci_config_write32(dev, offset, original);
+
+    mask &= pci_bar_is_io(dev, bar) ? ~0x3u : ~0xFu;
+    if (pci_bar_is_io(dev, bar)) mask |= 0xFFFF0000;
+    return mask ? (~mask + 1) : 0;
+}
+
+void pci_enable(pci_device_t* dev, uint16_t command_bits) {
+    uint16_t command = pci_config_read16(dev, PCI_COMMAND);
+    pci_config_write16(dev, PCI_COMMAND, command | command_bits);
+}
+
+uint8_t pci_find_capability(const pci_device_t* dev, uint8_t cap_id) {
+    if (!(pci_config_read16(dev, PCI_STATUS) & PCI_STATUS_CAP_LIST)) return 0;
+
+    uint8_t offset = pci_config_read8(dev, PCI_CAPABILITY_LIST) & 0xFC;
+    for (int guard = 0; offset && guard < 48; guard++) {
+        if (pci_config_read8(dev, offset) == cap_id) return offset;
+        offset = pci_config_read8(dev, offset + 1) & 0xFC;
+    }
+    return 0;
+}
+
+int pci_enable_msi(pci_device_t* dev, uint8_t vector) {
+    uint8_t cap = pci_find_capability(dev, PCI_CAP_ID_MSI);
+    if (!cap || !lapic_available()) return -ENODEV;
+
+    uint16_t flags = pci_config_read16(dev, cap + PCI_MSI_FLAGS);
+    pci_config_write32(dev, cap + PCI_MSI_ADDRESS_LO, lapic_msi_address());
+    if (flags & PCI_MSI_FLAGS_64BIT) {
+        pci_config_write32(dev, cap + PCI_MSI_ADDRESS_LO + 4, 0);
+        pci_config_write16(dev, cap + PCI_MSI_DATA_64, lapic_msi_data(vector));
+    } else {
+        pci_config_write16(dev, cap + PCI_MSI_DATA_32, lapic_msi_data(vector));
+    }
+
+    // One message only; multi-message MSI needs aligned vector blocks
+    flags &= ~PCI_MSI_FLAGS_QSIZE;
+    pci_config_write16(dev, cap + PCI_MSI_FLAGS, flags | PCI_MSI_FLAGS_ENABLE);
+    pci_enable(dev, PCI_COMMAND_INTX_DISABLE);
+    return 0;
+}
+
+uint16_t pci_msix_table_size(const pci_device_t* dev) {
+    uint8_t cap = pci_find_capability(dev, PCI_CAP_ID_MSIX);
+    if (!cap) return 0;
+    return (pci_config_read16(dev, cap + PCI_MSIX_FLAGS) & PCI_MSIX_FLAGS_QSIZE) + 1;
+}
+
+int pci_enable_msix(pci_device_t* dev, const uint8_t* vectors, uint16_t count) {
+    uint8_t cap = pci_find_capability(dev, PCI_CAP_ID_MSIX);
+    if (!cap || !lapic_available()) return -ENODEV;
+    if (count == 0 || count > pci_msix_table_size(dev)) return -EINVAL;
+
+    uint32_t table = pci_config_read32(dev, cap + PCI_MSIX_TABLE);
+    int bir = table & PCI_MSIX_TABLE_BIR;
+    if (bir > 5 || pci_bar_is_io(dev, bir)) return -EINVAL;
+    uintptr_t base = pci_bar_address(dev, bir) + (table & ~PCI_MSIX_TABLE_BIR);
+
+    // Program entries with the function masked, then open it up
+    uint16_t flags = pci_config_read16(dev, cap + PCI_MSIX_FLAGS);
+    pci_config_write16(dev, cap + PCI_MSIX_FLAGS,
+                       flags | PCI_MSIX_FLAGS_ENABLE | PCI_MSIX_FLAGS_MASKALL);
+    pci_enable(dev, PCI_COMMAND_MEMORY);
+
+    uint16_t size = pci_msix_table_size(dev);
+    for (uint16_t i = 0; i < size; i++) {
+        uintptr_t entry = base + i * PCI_MSIX_ENTRY_SIZE;
+        if (i >= count) {
+            mmio_write32(entry + PCI_MSIX_ENTRY_CTRL, PCI_MSIX_ENTRY_MASKED);
+            continue;
+        }
+        mmio_write32(entry + PCI_MSIX_ENTRY_ADDR_LO, lapic_msi_address());
+        mmio_write32(entry + PCI_MSIX_ENTRY_ADDR_HI, 0);
+        mmio_write32(entry + PCI_MSIX_ENTRY_DATA, lapic_msi_data(vectors[i]));
+        mmio_write32(entry + PCI_MSIX_ENTRY_CTRL, 0);
+    }
+
+    pci_config_write16(dev, cap + PCI_MSIX_FLAGS,
+                       (flags | PCI_MSIX_FLAGS_ENABLE) & ~PCI_MSIX_FLAGS_MASKALL);
+    pci_enable(dev, PCI_COMMAND_INTX_DISABLE);
+    return 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * Serial port - Bunix OS
+ *
+ * COM1 at 115200 8N1, FIFOs on, no interrupts: every byte waits for the
+ * transmit holding register to drain. At 115200 baud that is ~87 us a
+ * byte, which is fine for the bulk dumps this exists for and far too
+ * slow for anything on a hot path.
+ */
+
+#include "../../include/serial/serial.h"
+#include "../../include/kernel/ports/ports.h"
+#include "../../include/lib/errno.h"
+
+#define UART_DATA          0      // DLAB=0: transmit/receive
+#define UART_IER           1      // DLAB=0: interrupt enable
+#define UART_DLL           0      // DLAB=1: divisor, low byte
+#define UART_DLM           1      // DLAB=1: divisor, high byte
+#define UART_FCR           2
+#define UART_LCR           3
+#define UART_MCR           4
+#define UART_LSR           5
+
+#define UART_LCR_8N1       0x03
+#define UART_LCR_DLAB      0x80
+#define UART_FCR_ENABLE    0xC7   // Enable, clear both, 14-byte threshold
+#define UART_MCR_DTR_RTS   0x03
+#define UART_MCR_OUT2      0x08
+#define UART_MCR_LOOP      0x10
+#define UART_LSR_THRE      0x20
+
+#define UART_CLOCK         115200
+#define UART_PROBE_BYTE    0xAE
+
+static uint16_t base = SERIAL_COM1_PORT;
+static bool present;
+
+int serial_init(void) {
+    uint16_t divisor = UART_CLOCK / SERIAL_BAUD;
+
+    outb(base + UART_IER, 0);
+    outb(base + UART_LCR, UART_LCR_DLAB);
+    outb(base + UART_DLL, divisor & 0xFF);
+    outb(base + UART_DLM, divisor >> 8);
+    outb(base + UART_LCR, UART_LCR_8N1);
+    outb(base + UART_FCR, UART_FCR_ENABLE);
+
+    // A byte sent in loopback mode comes straight back if a UART is there
+    outb(base + UART_MCR, UART_MCR_LOOP | UART_MCR_OUT2 | UART_MCR_DTR_RTS);
+    outb(base + UART_DATA, UART_PROBE_BYTE);
+    if (inb(base + UART_DATA) != UART_PROBE_BYTE) return -ENODEV;
+
+    outb(base + UART_MCR, UART_MCR_OUT2 | UART_MCR_DTR_RTS);
+    present = true;
+    return 0;
+}
+
+bool serial_available(void) {
+    return present;
+}
+
+void serial_putchar(char c) {
+    if (!present) return;
+    while (!(inb(base + UART_LSR) & UART_LSR_THRE))
+        ;
+    outb(base + UART_DATA, (uint8_t)c);
+}
+
+void serial_write(const void* buf, size_t len) {
+    const char* p = buf;
+    while (len--) serial_putchar(*p++);
+}
+
+void serial_puts(const char* str) {
+    while (*str) serial_putchar(*str++);
+}
+
+void serial_puthex(uint32_t value) {
+    static const char hex_chars[] = "0123456789abcdef";
+    serial_puts("0x");
+    for (int i = 28; i >= 0; i -= 4) serial_putchar(hex_chars[(value >> i) & 0xF]);
+}
+
+void serial_putdec(uint32_t value) {
+    char buffer[10];
+    int i = 0;
+    do {
+        buffer[i++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    while (i > 0) serial_putchar(buffer[--i]);
+}
@@ -0,0 +1,80 @@
+/**
+ * Command helpers - Bunix OS
+ *
+ * Small pieces the commands in bin/ would otherwise each carry a copy of.
+ */
+
+#include "../../include/shell/cmdutil.h"
+#include "../../include/video/vga.h"
+#include "../../include/kernel/arch/x86/cpu.h"
+#include "../../include/lib/string.h"
+#include "../../include/lib/math64.h"
+
+extern Command commands[];
+
+const Command* find_command(const char* name) {
+    for (const Command* cmd = commands; cmd->name != NULL; cmd++) {
+        if (strcmp(cmd->name, name) == 0) return cmd;
+    }
+    return NULL;
+}
+
+uint32_t parse_uint(const char* s, uint32_t max) {
+    uint32_t v = 0;
+    if (!*s) return 0;
+    for (; *s; s++) {
+        if (*s < '0' || *s > '9') return 0;
+        uint32_t d = *s - '0';
+        if (d > max || v > (max - d) / 10) return 0;
+        v = v * 10 + d;
+    }
+    return v;
+}
+
+uint32_t xorshift32(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+void print_padded(uint32_t value, int width) {
+    uint32_t digits = 1;
+    for (uint32_t v = value; v >= 10; v /= 10) digits++;
+    while (width-- > (int)digits) vga_putchar(' ');
+    vga_putdec(value, 0);
+}
+
+uint32_t count_digits(uint64_t v) {
+    uint32_t digits = 1;
+    while (v >= 10) {
+        v = div_u64(v, 10);
+        digits++;
+    }
+    return digits;
+}
+
+void print_u64(uint64_t v, int width) {
+    uint32_t digits = count_digits(v);
+    while (width-- > (int)digits) vga_putchar(' ');
+
+    uint32_t low;
+    uint64_t high = div_u64_rem(v, 1000000000, &low);
+    if (high) {
+        vga_putdec((uint32_t)high, 0);
+        vga_putdec(low, 9);
+    } else {
+        vga_putdec(low, 0);
+    }
+}
+
+void print_name(const char* name, int width) {
+    vga_puts(name);
+    for (int n = strlen(name); n < width; n++) vga_putchar(' ');
+}
+
+uint32_t elapsed_us(uint64_t start) {
+    uint32_t us = (uint32_t)div_u64(cpu_tsc_to_ns(cpu_rdtsc() - start), 1000);
+    return us ? us : 1;
+}
@@ -2,6 +2,7 @@
 #include "../../include/video/vga.h"
 #include "../../include/keyboard/kb.h"
 #include "../../include/lib/string.h"
+#include "../../include/fs/vfs.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
@@ -65,14 +66,126 @@ Command commands[] = {
     {"fetch",      fetch_command,     "Displaying OS information"},
     {"sleep",      sleep_command,     "Pause execution for a duration"},
     {"hexdump",    hexdump_command,   "Display binary data in hex"},
-    {"expr",       expr_command,      "Calculate entered input"},
+    {"expr",       expr_command,      "Calculate entered input", CMD_NO_REDIRECT},
     {"grep",       grep_command,      "Search for patterns in input lines"},
     {"factor",     factor_command,    "Factor numbers"},
     {"rand",       rand_command,      "Generate a random number"},
     {"tty",        tty_command,       "Show terminal device name"},
+    {"ls",         ls_command,        "List directory contents"},
+    {"cat",        cat_command,       "Concatenate files and print them"},
+    {"stat",       stat_command,      "Display file status"},
+    {"mount",      mount_command,     "Mount a filesystem or list mounts"},
+    {"lookupbench", lookupbench_command, "Benchmark path lookup with and without the dcache"},
+    {"diskbench",  diskbench_command, "Measure disk throughput and queue-depth scaling"},
+    {"cachestat",  cachestat_command, "Show block cache hit and read-ahead statistics"},
+    {"iostat",     iostat_command,    "Show block request statistics and I/O schedulers"},
+    {"fsbench",    fsbench_command,   "Measure sequential file write and read throughput"},
+    {"metabench",  metabench_command, "Time creating, looking up and removing many files"},
+    {"netbench",   netbench_command,  "Echo round trips over loopback: rate and latency"},
+    {"ifconfig",   ifconfig_command,  "Show network devices or set an address"},
+    {"udpblast",   udpblast_command,  "Send or sink a UDP stream: packets/s and Mbit/s"},
+    {"ifstat",     ifstat_command,    "Sample packet and interrupt rates per network device"},
+    {"clocksource", clocksource_command, "List clock sources and their read cost, or pick one"},
+    {"timerlat",   timerlat_command,  "Arm one-shot timers and show how late they fire"},
+    {"timebench",  timebench_command, "Cost of clock_gettime: time page against the syscall"},
+    {"perfstat",   perfstat_command,  "Run a command and report cycles, IPC and miss rates"},
+    {"profile",    profile_command,   "Sampling profiler: start, stop, report, folded"},
+    {"ksym",       ksym_command,      "Resolve kernel addresses to functions, time lookups"},
+    {"trace",      trace_command,     "Stream tracepoint records to COM1: start, stop, list"},
+#ifdef CONFIG_CALLGRAPH
+    {"callgraph",  callgraph_command, "Per-function call counts and inclusive/exclusive time"},
+#endif
     {NULL, NULL, NULL} // End marker
 };
 
+// Output redirection: "cmd > file" truncates, "cmd >> file" appends.
+// Command output is batched so the filesystem sees a few large writes
+// instead of one write per character.
+#define REDIRECT_BUFFER_SIZE 512
+
+typedef struct {
+    int fd;
+    int error;
+    size_t len;
+    char buffer[REDIRECT_BUFFER_SIZE];
+} redirect_t;
+
+static redirect_t redirect;
+
+static void redirect_flush(redirect_t *r) {
+    if (r->len > 0 && r->error == 0) {
+        int written = vfs_write(r->fd, r->buffer, r->len);
+        if (written < 0) r->error = written;
+    }
+    r->len = 0;
+}
+
+static void redirect_putchar(char c, void *ctx) {
+    redirect_t *r = ctx;
+    r->buffer[r->len++] = c;
+    if (r->len == REDIRECT_BUFFER_SIZE) redirect_flush(r);
+}
+
+// Split "args > path" in place. The operator must be a word of its own
+// and be followed by exactly one word, the target. Returns 0 when there
+// is no redirection, 1 when *path was set, -1 on a malformed line.
+static int parse_redirect(char *args, char **path, bool *append) {
+    char *op = NULL;
+    for (char *word = args; word && *word && !op; ) {
+        while (*word == ' ') word++;
+        char *end = word;
+        while (*end && *end != ' ') end++;
+        size_t len = end - word;
+        if ((len == 1 || len == 2) && strncmp(word, ">>", len) == 0) op = word;
+        word = end;
+    }
+    if (!op) return 0;
+
+    *append = (op[1] == '>');
+    char *target = op + (*append ? 2 : 1);
+    while (*target == ' ') target++;
+    char *end = target;
+    while (*end && *end != ' ') end++;
+    char *rest = end;
+    while (*rest == ' ') rest++;
+    if (*target == '\0' || *rest != '\0') return -1;
+    *end = '\0';
+    *op = '\0';
+
+    // Drop the spaces before the operator so args don't end in blanks
+    while (op > args && op[-1] == ' ') *--op = '\0';
+
+    *path = target;
+    return 1;
+}
+
+static int redirect_begin(const char *path, bool append) {
+    uint32_t flags = O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC);
+    int fd = vfs_open(path, flags);
+    if (fd < 0) return fd;
+
+    redirect.fd = fd;
+    redirect.error = 0;
+    redirect.len = 0;
+    vga_set_output_hook(redirect_putchar, &redirect);
+    return 0;
+}
+
+static int redirect_end(void) {
+    redirect_flush(&redirect);
+    vga_set_output_hook(NULL, NULL);
+    vfs_close(redirect.fd);
+    return redirect.error;
+}
+
+static void print_shell_error(const char *what, const char *detail) {
+    vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+    vga_puts(what);
+    vga_puts(detail);
+    vga_putchar('\n');
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+}
+
 // Command history
 static char history[MAX_HISTORY_SIZE][256];
 static int history_index = 0;
@@ -86,7 +199,6 @@ void add_to_history(const char *input) {
 // Initialize the shell
 int shell_init(void) {
     print_shell_prompt();
-    uptime_init();  // Initialize uptime
     return 0;
 }
 
@@ -122,9 +234,38 @@ void shell_run(void) {
                 char *command_name = strtok(input, " ");
                 char *args = strtok(NULL, "\0");  // Get remaining string
                 
+                if (!command_name) {
+                    index = 0;
+                    print_shell_prompt();
+                    continue;
+                }
+                
                 bool command_found = false;
 		for (const Command *cmd = commands; cmd->name != NULL; cmd++) {
 	    if (strcmp(command_name, cmd->name) == 0) {
+	        command_found = true;
+
+	        // Peel off any output redirection before the command sees its args
+	        char *redirect_path = NULL;
+	        bool redirect_append = false;
+	        int redirected = 0;
+	        if (!(cmd->flags & CMD_NO_REDIRECT)) {
+	            redirected = parse_redirect(args, &redirect_path, &redirect_append);
+	        }
+	        if (redirected < 0) {
+	            print_shell_error("syntax error near '>'", "");
+	            last_exit_status = 2;
+	            break;
+	        }
+	        if (args && *args == '\0') args = NULL;
+	        if (redirected) {
+	            int err = redirect_begin(redirect_path, redirect_append);
+	            if (err < 0) {
+	                print_shell_error(redirect_path, ": cannot redirect output");
+	                last_exit_status = 1;
+	                break;
+	            }
+	        }
 	        // Handle true/false specially
 	        if (strcmp(command_name, "true") == 0) {
             last_exit_status = 0;
@@ -133,7 +274,10 @@ void shell_run(void) {
             last_exit_status = 1;
         }
         cmd->func(args);
-        command_found = true;
+        if (redirected && redirect_end() < 0) {
+            print_shell_error(redirect_path, ": write error");
+            last_exit_status = 1;
+        }
         break;
     }
 }
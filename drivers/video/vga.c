@@ -1,5 +1,6 @@
 #include "../../include/video/vga.h"
 #include "../../include/kernel/ports/ports.h"
+#include "../../include/kernel/perf/trace.h"
 #include <string.h>
 
 // VGA memory address
@@ -24,11 +25,16 @@ static size_t vga_column;
 static uint8_t vga_color;
 static uint16_t* vga_buffer;
 
+// Output redirection (shell '>' and friends)
+static vga_output_hook_t output_hook = NULL;
+static void* output_hook_ctx = NULL;
+
 // Double buffer (optional)
 static uint16_t vga_double_buffer[VGA_HEIGHT * VGA_WIDTH];
 
 // Scroll the screen up by one line
 static void vga_scroll(void) {
+    TRACE(TRACE_VGA_SCROLL, 0, 0, 0);
     for (size_t y = 0; y < VGA_HEIGHT - 1; y++) {
         for (size_t x = 0; x < VGA_WIDTH; x++) {
             vga_buffer[y * VGA_WIDTH + x] = vga_buffer[(y + 1) * VGA_WIDTH + x];
@@ -67,8 +73,19 @@ void vga_clear(void) {
     vga_update_cursor(vga_column, vga_row);
 }
 
+// Route vga_putchar output somewhere else, or back to the screen with NULL
+void vga_set_output_hook(vga_output_hook_t hook, void* ctx) {
+    output_hook = hook;
+    output_hook_ctx = ctx;
+}
+
 // Print a character
 void vga_putchar(char c) {
+    if (output_hook) {
+        output_hook(c, output_hook_ctx);
+        return;
+    }
+
     if (c == '\n') {
         vga_column = 0;
         if (++vga_row == VGA_HEIGHT) {
@@ -131,9 +148,12 @@ void vga_putdec(uint32_t value, uint8_t digits) {
 // Print a string
 void vga_puts(const char* str) {
     if (!str) return; // Null pointer check
+    const char* start = str;
+    TRACE(TRACE_VGA_PUTS_BEGIN, 0, 0, 0);
     while (*str) {
         vga_putchar(*str++);
     }
+    TRACE(TRACE_VGA_PUTS_END, str - start, 0, 0);
 }
 
 // Enable the cursor
@@ -0,0 +1,242 @@
+/**
+ * virtio PCI transport - Bunix OS
+ *
+ * Legacy devices expose a fixed register block in I/O BAR0. Modern devices
+ * describe their register windows with vendor capabilities pointing into
+ * memory BARs. Transitional devices (QEMU's default) offer both; the modern
+ * interface is preferred whenever its BARs are reachable below 4GB.
+ */
+
+#include "../../include/virtio/virtio.h"
+#include "../../include/kernel/ports/ports.h"
+#include "../../include/kernel/ports/mmio.h"
+#include "../../include/lib/errno.h"
+
+// Legacy register block
+#define VIRTIO_LEGACY_DEVICE_FEATURES  0x00
+#define VIRTIO_LEGACY_GUEST_FEATURES   0x04
+#define VIRTIO_LEGACY_QUEUE_PFN        0x08
+#define VIRTIO_LEGACY_QUEUE_SIZE       0x0C
+#define VIRTIO_LEGACY_QUEUE_SELECT     0x0E
+#define VIRTIO_LEGACY_QUEUE_NOTIFY     0x10
+#define VIRTIO_LEGACY_STATUS           0x12
+#define VIRTIO_LEGACY_ISR              0x13
+#define VIRTIO_LEGACY_CONFIG           0x14   // Without MSI-X
+
+// Modern common configuration structure
+#define VIRTIO_COMMON_DFSELECT         0x00
+#define VIRTIO_COMMON_DF               0x04
+#define VIRTIO_COMMON_GFSELECT         0x08
+#define VIRTIO_COMMON_GF               0x0C
+#define VIRTIO_COMMON_STATUS           0x14
+#define VIRTIO_COMMON_Q_SELECT         0x16
+#define VIRTIO_COMMON_Q_SIZE           0x18
+#define VIRTIO_COMMON_Q_MSIX           0x1A
+#define VIRTIO_COMMON_Q_ENABLE         0x1C
+#define VIRTIO_COMMON_Q_NOFF           0x1E
+#define VIRTIO_COMMON_Q_DESC           0x20
+#define VIRTIO_COMMON_Q_AVAIL          0x28
+#define VIRTIO_COMMON_Q_USED           0x30
+
+#define VIRTIO_MSI_NO_VECTOR           0xFFFF
+
+// Vendor capability types
+#define VIRTIO_PCI_CAP_COMMON_CFG      1
+#define VIRTIO_PCI_CAP_NOTIFY_CFG      2
+#define VIRTIO_PCI_CAP_ISR_CFG         3
+#define VIRTIO_PCI_CAP_DEVICE_CFG      4
+
+static void virtio_set_status(virtio_device_t* vdev, uint8_t status) {
+    if (vdev->modern) mmio_write8(vdev->common_cfg + VIRTIO_COMMON_STATUS, status);
+    else outb(vdev->io_base + VIRTIO_LEGACY_STATUS, status);
+}
+
+static uint8_t virtio_get_status(virtio_device_t* vdev) {
+    if (vdev->modern) return mmio_read8(vdev->common_cfg + VIRTIO_COMMON_STATUS);
+    return inb(vdev->io_base + VIRTIO_LEGACY_STATUS);
+}
+
+// Physical address of a capability window, 0 if it lives in an I/O BAR
+// or a 64-bit BAR placed above 4GB
+static uintptr_t virtio_cap_address(pci_device_t* pci, uint8_t cap) {
+    uint8_t bar = pci_config_read8(pci, cap + 4);
+    uint32_t offset = pci_config_read32(pci, cap + 8);
+
+    if (bar > 5 || pci_bar_is_io(pci, bar)) return 0;
+    if ((pci->bar[bar] & 0x6) == 0x4 && (bar == 5 || pci->bar[bar + 1] != 0)) return 0;
+    if (!pci_bar_address(pci, bar)) return 0;
+    return pci_bar_address(pci, bar) + offset;
+}
+
+static bool virtio_probe_modern(virtio_device_t* vdev, pci_device_t* pci) {
+    if (!(pci_config_read16(pci, PCI_STATUS) & PCI_STATUS_CAP_LIST)) return false;
+
+    uint8_t cap = pci_config_read8(pci, PCI_CAPABILITY_LIST) & 0xFC;
+    for (int guard = 0; cap && guard < 48; guard++) {
+        if (pci_config_read8(pci, cap) == PCI_CAP_ID_VENDOR) {
+            uintptr_t addr = virtio_cap_address(pci, cap);
+            switch (pci_config_read8(pci, cap + 3)) {
+                case VIRTIO_PCI_CAP_COMMON_CFG:
+                    if (!vdev->common_cfg) vdev->common_cfg = addr;
+                    break;
+                case VIRTIO_PCI_CAP_NOTIFY_CFG:
+                    if (!vdev->notify_base) {
+                        vdev->notify_base = addr;
+                        vdev->notify_multiplier = pci_config_read32(pci, cap + 16);
+                    }
+                    break;
+                case VIRTIO_PCI_CAP_ISR_CFG:
+                    if (!vdev->isr) vdev->isr = addr;
+                    break;
+                case VIRTIO_PCI_CAP_DEVICE_CFG:
+                    if (!vdev->device_cfg) vdev->device_cfg = addr;
+                    break;
+            }
+        }
+        cap = pci_config_read8(pci, cap + 1) & 0xFC;
+    }
+
+    return vdev->common_cfg && vdev->notify_base && vdev->isr;
+}
+
+int virtio_pci_init(virtio_device_t* vdev, pci_device_t* pci) {
+    vdev->pci = pci;
+    vdev->features = 0;
+    vdev->irq = pci->irq_line;
+    vdev->common_cfg = vdev->notify_base = vdev->isr = vdev->device_cfg = 0;
+
+    vdev->modern = virtio_probe_modern(vdev, pci);
+    if (!vdev->modern) {
+        if (!pci_bar_is_io(pci, 0) || !pci_bar_address(pci, 0)) return -ENODEV;
+        vdev->io_base = pci_bar_address(pci, 0);
+    }
+
+    pci_enable(pci, PCI_COMMAND_IO | PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
+
+    virtio_reset(vdev);
+    virtio_set_status(vdev, VIRTIO_STATUS_ACKNOWLEDGE);
+    virtio_set_status(vdev, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+    return 0;
+}
+
+void virtio_reset(virtio_device_t* vdev) {
+    virtio_set_status(vdev, 0);
+    // Modern devices finish the reset once status reads back as zero
+    if (vdev->modern) {
+        for (int i = 0; i < 1000000 && virtio_get_status(vdev) != 0; i++) { }
+    }
+}
+
+uint64_t virtio_negotiate(virtio_device_t* vdev, uint64_t wanted) {
+    uint64_t offered;
+
+    if (vdev->modern) {
+        mmio_write32(vdev->common_cfg + VIRTIO_COMMON_DFSELECT, 0);
+        offered = mmio_read32(vdev->common_cfg + VIRTIO_COMMON_DF);
+        mmio_write32(vdev->common_cfg + VIRTIO_COMMON_DFSELECT, 1);
+        offered |= (uint64_t)mmio_read32(vdev->common_cfg + VIRTIO_COMMON_DF) << 32;
+        wanted |= VIRTIO_FEATURE(VIRTIO_F_VERSION_1);
+    } else {
+        offered = inl(vdev->io_base + VIRTIO_LEGACY_DEVICE_FEATURES);
+    }
+
+    vdev->features = offered & wanted;
+
+    if (vdev->modern) {
+        mmio_write32(vdev->common_cfg + VIRTIO_COMMON_GFSELECT, 0);
+        mmio_write32(vdev->common_cfg + VIRTIO_COMMON_GF, (uint32_t)vdev->features);
+        mmio_write32(vdev->common_cfg + VIRTIO_COMMON_GFSELECT, 1);
+        mmio_write32(vdev->common_cfg + VIRTIO_COMMON_GF, (uint32_t)(vdev->features >> 32));
+    } else {
+        outl(vdev->io_base + VIRTIO_LEGACY_GUEST_FEATURES, (uint32_t)vdev->features);
+    }
+    return vdev->features;
+}
+
+int virtio_features_ok(virtio_device_t* vdev) {
+    if (!vdev->modern) return 0;
+
+    uint8_t status = virtio_get_status(vdev);
+    virtio_set_status(vdev, status | VIRTIO_STATUS_FEATURES_OK);
+    if (!(virtio_get_status(vdev) & VIRTIO_STATUS_FEATURES_OK)) return -ENODEV;
+    return 0;
+}
+
+void virtio_driver_ok(virtio_device_t* vdev) {
+    virtio_set_status(vdev, virtio_get_status(vdev) | VIRTIO_STATUS_DRIVER_OK);
+}
+
+void virtio_fail(virtio_device_t* vdev) {
+    virtio_set_status(vdev, virtio_get_status(vdev) | VIRTIO_STATUS_FAILED);
+}
+
+bool virtio_has_feature(const virtio_device_t* vdev, uint32_t bit) {
+    return (vdev->features & VIRTIO_FEATURE(bit)) != 0;
+}
+
+// Reading the ISR status also deasserts the INTx line
+uint8_t virtio_read_isr(virtio_device_t* vdev) {
+    if (vdev->modern) return mmio_read8(vdev->isr);
+    return inb(vdev->io_base + VIRTIO_LEGACY_ISR);
+}
+
+uint8_t virtio_config_read8(virtio_device_t* vdev, uint32_t offset) {
+    if (vdev->modern) return mmio_read8(vdev->device_cfg + offset);
+    return inb(vdev->io_base + VIRTIO_LEGACY_CONFIG + offset);
+}
+
+uint16_t virtio_config_read16(virtio_device_t* vdev, uint32_t offset) {
+    if (vdev->modern) return mmio_read16(vdev->device_cfg + offset);
+    return inw(vdev->io_base + VIRTIO_LEGACY_CONFIG + offset);
+}
+
+uint32_t virtio_config_read32(virtio_device_t* vdev, uint32_t offset) {
+    if (vdev->modern) return mmio_read32(vdev->device_cfg + offset);
+    return inl(vdev->io_base + VIRTIO_LEGACY_CONFIG + offset);
+}
+
+uint64_t virtio_config_read64(virtio_device_t* vdev, uint32_t offset) {
+    return virtio_config_read32(vdev, offset) |
+           ((uint64_t)virtio_config_read32(vdev, offset + 4) << 32);
+}
+
+// ---------------------------------------------------------------------------
+// Queue registers, used by virtqueue.c
+// ---------------------------------------------------------------------------
+
+uint16_t virtio_queue_size(virtio_device_t* vdev, uint16_t index) {
+    if (vdev->modern) {
+        mmio_write16(vdev->common_cfg + VIRTIO_COMMON_Q_SELECT, index);
+        return mmio_read16(vdev->common_cfg + VIRTIO_COMMON_Q_SIZE);
+    }
+    outw(vdev->io_base + VIRTIO_LEGACY_QUEUE_SELECT, index);
+    return inw(vdev->io_base + VIRTIO_LEGACY_QUEUE_SIZE);
+}
+
+void virtio_queue_activate(virtio_device_t* vdev, virtqueue_t* vq) {
+    if (vdev->modern) {
+        uintptr_t common = vdev->common_cfg;
+        mmio_write16(common + VIRTIO_COMMON_Q_SELECT, vq->index);
+        mmio_write16(common + VIRTIO_COMMON_Q_SIZE, vq->size);
+        mmio_write16(common + VIRTIO_COMMON_Q_MSIX, VIRTIO_MSI_NO_VECTOR);
+        mmio_write64(common + VIRTIO_COMMON_Q_DESC, (uint32_t)vq->desc);
+        mmio_write64(common + VIRTIO_COMMON_Q_AVAIL, (uint32_t)vq->avail);
+        mmio_write64(common + VIRTIO_COMMON_Q_USED, (uint32_t)vq->used);
+        vq->notify_off = mmio_read16(common + VIRTIO_COMMON_Q_NOFF);
+        mmio_write16(common + VIRTIO_COMMON_Q_ENABLE, 1);
+    } else {
+        outw(vdev->io_base + VIRTIO_LEGACY_QUEUE_SELECT, vq->index);
+        outl(vdev->io_base + VIRTIO_LEGACY_QUEUE_PFN, (uint32_t)vq->desc >> 12);
+    }
+}
+
+void virtqueue_notify(virtqueue_t* vq) {
+    virtio_device_t* vdev = vq->vdev;
+
+    vq->stats.kicks++;
+    if (vdev->modern) {
+        mmio_write16(vdev->notify_base + vq->notify_off * vdev->notify_multiplier, vq->index);
+    } else {
+        outw(vdev->io_base + VIRTIO_LEGACY_QUEUE_NOTIFY, vq->index);
+    }
+}
@@ -0,0 +1,203 @@
+/**
+ * Split virtqueues - Bunix OS
+ *
+ * Free descriptors form a chain through desc[].next. A request with more
+ * than one buffer is placed in a per-slot indirect table when the device
+ * supports it, so it occupies a single ring descriptor no matter how long
+ * its scatter-gather list is. With EVENT_IDX the device tells us which
+ * avail index it wants to hear about and we tell it which used index to
+ * interrupt on, so neither side signals while the other is still busy.
+ */
+
+#include "../../include/virtio/virtio.h"
+#include "../../include/kernel/ports/mmio.h"
+#include "../../include/mm/vmm.h"
+#include "../../include/mm/kmalloc.h"
+#include "../../include/lib/string.h"
+#include "../../include/lib/errno.h"
+
+#define VIRTQ_ALIGN 4096   // Legacy layout: used ring starts on a page
+
+static inline volatile uint16_t* vq_used_event(virtqueue_t* vq) {
+    return (volatile uint16_t*)((uint8_t*)vq->avail + 4 + sizeof(uint16_t) * vq->size);
+}
+
+static inline volatile uint16_t* vq_avail_event(virtqueue_t* vq) {
+    return (volatile uint16_t*)((uint8_t*)vq->used + 4 + sizeof(struct virtq_used_elem) * vq->size);
+}
+
+static inline uint16_t vq_used_idx(virtqueue_t* vq) {
+    return *(volatile uint16_t*)((uint8_t*)vq->used + 2);
+}
+
+// True if the other side asked to be told once 'event' is passed
+static inline bool vring_need_event(uint16_t event, uint16_t new_idx, uint16_t old_idx) {
+    return (uint16_t)(new_idx - event - 1) < (uint16_t)(new_idx - old_idx);
+}
+
+int virtqueue_setup(virtio_device_t* vdev, virtqueue_t* vq, uint16_t index, uint16_t max_size) {
+    uint16_t size = virtio_queue_size(vdev, index);
+    if (size == 0) return -ENOENT;
+
+    // Legacy devices dictate the size; modern ones accept anything smaller
+    if (vdev->modern && max_size && size > max_size) size = max_size;
+    if (size > VIRTQ_MAX_SIZE) return -EINVAL;
+
+    uint32_t desc_bytes = sizeof(struct virtq_desc) * size;
+    uint32_t avail_bytes = sizeof(uint16_t) * (3 + size);
+    uint32_t used_offset = (desc_bytes + avail_bytes + VIRTQ_ALIGN - 1) & ~(VIRTQ_ALIGN - 1);
+    uint32_t used_bytes = sizeof(uint16_t) * 3 + sizeof(struct virtq_used_elem) * size;
+    uint32_t pages = (used_offset + used_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    memset(vq, 0, sizeof(*vq));
+    uint8_t* ring = (uint8_t*)vmm_alloc_pages(pages);
+    if (!ring) return -ENOMEM;
+    memset(ring, 0, pages * PAGE_SIZE);
+
+    vq->vdev = vdev;
+    vq->index = index;
+    vq->size = size;
+    vq->ring_pages = pages;
+    vq->desc = (struct virtq_desc*)ring;
+    vq->avail = (struct virtq_avail*)(ring + desc_bytes);
+    vq->used = (struct virtq_used*)(ring + used_offset);
+    vq->event_idx = virtio_has_feature(vdev, VIRTIO_F_RING_EVENT_IDX);
+    vq->indirect = virtio_has_feature(vdev, VIRTIO_F_RING_INDIRECT_DESC);
+
+    vq->cookies = kzalloc(sizeof(void*) * size);
+    if (!vq->cookies) {
+        vmm_free_pages((uint32_t*)ring, pages);
+        return -ENOMEM;
+    }
+
+    if (vq->indirect) {
+        uint32_t bytes = sizeof(struct virtq_desc) * VIRTQ_INDIRECT_MAX * size;
+        vq->indirect_tables = (struct virtq_desc*)vmm_alloc_pages((bytes + PAGE_SIZE - 1) / PAGE_SIZE);
+        if (!vq->indirect_tables) vq->indirect = false;
+    }
+
+    for (uint16_t i = 0; i < size; i++) vq->desc[i].next = i + 1;
+    vq->free_head = 0;
+    vq->num_free = size;
+
+    virtio_queue_activate(vdev, vq);
+    return 0;
+}
+
+// Queue out device-readable buffers followed by in device-writable ones.
+// Returns -ENOSPC when the ring is full; the caller retries after completions.
+int virtqueue_add(virtqueue_t* vq, const virtq_buf_t* bufs, uint16_t out, uint16_t in, void* cookie) {
+    uint16_t total = out + in;
+    if (total == 0) return -EINVAL;
+
+    bool use_indirect = vq->indirect && total > 1 && total <= VIRTQ_INDIRECT_MAX;
+    uint16_t needed = use_indirect ? 1 : total;
+    if (vq->num_free < needed) return -ENOSPC;
+
+    uint16_t head = vq->free_head;
+
+    if (use_indirect) {
+        struct virtq_desc* table = &vq->indirect_tables[head * VIRTQ_INDIRECT_MAX];
+        for (uint16_t i = 0; i < total; i++) {
+            table[i].addr = bufs[i].addr;
+            table[i].len = bufs[i].len;
+            table[i].flags = (i >= out ? VIRTQ_DESC_F_WRITE : 0) |
+                             (i + 1 < total ? VIRTQ_DESC_F_NEXT : 0);
+            table[i].next = i + 1;
+        }
+        vq->free_head = vq->desc[head].next;
+        vq->desc[head].addr = (uint32_t)table;
+        vq->desc[head].len = total * sizeof(struct virtq_desc);
+        vq->desc[head].flags = VIRTQ_DESC_F_INDIRECT;
+    } else {
+        // The free chain already links the descriptors we take
+        uint16_t idx = head;
+        for (uint16_t i = 0; i < total; i++) {
+            struct virtq_desc* d = &vq->desc[idx];
+            d->addr = bufs[i].addr;
+            d->len = bufs[i].len;
+            d->flags = (i >= out ? VIRTQ_DESC_F_WRITE : 0) |
+                       (i + 1 < total ? VIRTQ_DESC_F_NEXT : 0);
+            idx = d->next;
+        }
+        vq->free_head = idx;
+    }
+
+    vq->num_free -= needed;
+    vq->cookies[head] = cookie;
+
+    uint16_t avail_idx = vq->avail->idx;
+    vq->avail->ring[avail_idx % vq->size] = head;
+    mmio_barrier();                     // Ring entry before the index
+    *(volatile uint16_t*)&vq->avail->idx = avail_idx + 1;
+    return 0;
+}
+
+// Decide whether the device needs a doorbell for what was added since the
+// last kick. Split from virtqueue_notify so callers can batch.
+bool virtqueue_kick_prepare(virtqueue_t* vq) {
+    mmio_mb();                          // Publish avail->idx before reading the event
+
+    uint16_t new_idx = vq->avail->idx;
+    uint16_t old_idx = vq->kicked_avail_idx;
+    vq->kicked_avail_idx = new_idx;
+    if (new_idx == old_idx) return false;
+
+    bool needed;
+    if (vq->event_idx) {
+        needed = vring_need_event(*vq_avail_event(vq), new_idx, old_idx);
+    } else {
+        needed = !(*(volatile uint16_t*)&vq->used->flags & VIRTQ_USED_F_NO_NOTIFY);
+    }
+
+    if (!needed) vq->stats.kicks_suppressed++;
+    return needed;
+}
+
+void virtqueue_kick(virtqueue_t* vq) {
+    if (virtqueue_kick_prepare(vq)) virtqueue_notify(vq);
+}
+
+void* virtqueue_get_buf(virtqueue_t* vq, uint32_t* len) {
+    if (vq->last_used_idx == vq_used_idx(vq)) return NULL;
+    mmio_barrier();                     // Index before the entry it covers
+
+    struct virtq_used_elem* elem = &vq->used->ring[vq->last_used_idx % vq->size];
+    uint16_t head = elem->id;
+    if (len) *len = elem->len;
+
+    // Return the chain to the free list
+    uint16_t tail = head;
+    uint16_t count = 1;
+    while (vq->desc[tail].flags & VIRTQ_DESC_F_NEXT) {
+        tail = vq->desc[tail].next;
+        count++;
+    }
+    vq->desc[tail].next = vq->free_head;
+    vq->free_head = head;
+    vq->num_free += count;
+
+    void* cookie = vq->cookies[head];
+    vq->cookies[head] = NULL;
+    vq->last_used_idx++;
+    vq->stats.completions++;
+    return cookie;
+}
+
+// Ask for an interrupt on the next completion. Returns true if completions
+// arrived meanwhile, in which case the caller should drain again.
+bool virtqueue_enable_cb(virtqueue_t* vq) {
+    if (vq->event_idx) {
+        *vq_used_event(vq) = vq->last_used_idx;
+    } else {
+        vq->avail->flags &= ~VIRTQ_AVAIL_F_NO_INTERRUPT;
+    }
+    mmio_mb();
+    return vq->last_used_idx != vq_used_idx(vq);
+}
+
+void virtqueue_disable_cb(virtqueue_t* vq) {
+    // With EVENT_IDX the flag is ignored; leaving used_event behind
+    // last_used_idx has the same effect
+    vq->avail->flags |= VIRTQ_AVAIL_F_NO_INTERRUPT;
+}
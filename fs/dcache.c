@@ -0,0 +1,171 @@
+/**
+ * Dentry cache - Bunix OS
+ *
+ * Hashed (parent, name) -> inode cache with negative entries, so repeated
+ * lookups of the same path never reach the filesystem's directory code.
+ */
+
+#include "../include/fs/dcache.h"
+#include "../include/lib/string.h"
+
+static dentry_t dentry_pool[DCACHE_ENTRIES];
+static dentry_t* dentry_hash[DCACHE_BUCKETS];
+static uint32_t clock_hand = 0;
+static bool dcache_enabled = true;
+static dcache_stats_t stats;
+
+void dcache_init(void) {
+    memset(dentry_pool, 0, sizeof(dentry_pool));
+    memset(dentry_hash, 0, sizeof(dentry_hash));
+    memset(&stats, 0, sizeof(stats));
+    clock_hand = 0;
+    dcache_enabled = true;
+}
+
+// FNV-1a over the name, mixed with the parent pointer
+uint32_t dcache_hash(const vfs_inode_t* parent, const char* name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash ^ (((uint32_t)parent >> 4) * 0x9E3779B1u);
+}
+
+static inline uint32_t bucket_of(uint32_t hash) {
+    return (hash ^ (hash >> 16)) & (DCACHE_BUCKETS - 1);
+}
+
+static dentry_t* dentry_find(const vfs_inode_t* parent, const char* name, size_t len, uint32_t hash) {
+    for (dentry_t* d = dentry_hash[bucket_of(hash)]; d; d = d->hash_next) {
+        if (d->hash == hash && d->parent == parent && d->len == len &&
+            memcmp(d->name, name, len) == 0) {
+            return d;
+        }
+    }
+    return NULL;
+}
+
+dentry_t* dcache_lookup(const vfs_inode_t* parent, const char* name, size_t len, uint32_t hash) {
+    dentry_t* d = dentry_find(parent, name, len, hash);
+    if (!d) {
+        stats.misses++;
+        return NULL;
+    }
+    d->referenced = 1;
+    if (d->inode) stats.hits++;
+    else stats.negative_hits++;
+    return d;
+}
+
+static void dentry_unhash(dentry_t* d) {
+    dentry_t** link = &dentry_hash[bucket_of(d->hash)];
+    while (*link && *link != d) link = &(*link)->hash_next;
+    if (*link) *link = d->hash_next;
+}
+
+static void dentry_release(dentry_t* d) {
+    vfs_inode_t* inode = d->inode;
+
+    dentry_unhash(d);
+    d->in_use = 0;
+    d->inode = NULL;
+    d->parent = NULL;
+    stats.entries--;
+
+    // Dropping the last reference may purge this inode's children in turn
+    if (inode) vfs_inode_put(inode);
+}
+
+// CLOCK sweep: skip recently used entries, clearing their bit as we pass
+static dentry_t* dentry_alloc(void) {
+    for (uint32_t scanned = 0; scanned < 2 * DCACHE_ENTRIES; scanned++) {
+        dentry_t* d = &dentry_pool[clock_hand];
+        clock_hand = (clock_hand + 1) % DCACHE_ENTRIES;
+
+        if (!d->in_use) return d;
+        if (d->referenced) {
+            d->referenced = 0;
+            continue;
+        }
+        stats.evictions++;
+        dentry_release(d);
+        return d;
+    }
+    return NULL;
+}
+
+void dcache_insert(vfs_inode_t* parent, const char* name, size_t len, uint32_t hash, vfs_inode_t* inode) {
+    if (len > VFS_NAME_MAX) return;
+
+    // Replace an existing entry (e.g. negative -> positive after create).
+    // The old entry goes even when caching is off, so it can't resurface.
+    dentry_t* old = dentry_find(parent, name, len, hash);
+    if (old) dentry_release(old);
+    if (!dcache_enabled) return;
+
+    dentry_t* d = dentry_alloc();
+    if (!d) return;
+
+    d->parent = parent;
+    d->inode = inode ? vfs_inode_get(inode) : NULL;
+    d->hash = hash;
+    d->len = len;
+    d->in_use = 1;
+    d->referenced = 1;
+    memcpy(d->name, name, len);
+    d->name[len] = '\0';
+
+    uint32_t b = bucket_of(hash);
+    d->hash_next = dentry_hash[b];
+    dentry_hash[b] = d;
+    stats.inserts++;
+    stats.entries++;
+}
+
+void dcache_invalidate(const vfs_inode_t* parent, const char* name, size_t len) {
+    dentry_t* d = dentry_find(parent, name, len, dcache_hash(parent, name, len));
+    if (d) dentry_release(d);
+}
+
+void dcache_purge_parent(const vfs_inode_t* parent) {
+    for (uint32_t i = 0; i < DCACHE_ENTRIES; i++) {
+        dentry_t* d = &dentry_pool[i];
+        if (d->in_use && d->parent == parent) dentry_release(d);
+    }
+}
+
+void dcache_purge_sb(const vfs_superblock_t* sb) {
+    for (uint32_t i = 0; i < DCACHE_ENTRIES; i++) {
+        dentry_t* d = &dentry_pool[i];
+        if (!d->in_use) continue;
+        if (d->parent->sb == sb || (d->inode && d->inode->sb == sb)) {
+            dentry_release(d);
+        }
+    }
+}
+
+// Disabling empties the cache: nothing cached now is kept up to date
+// while it is off
+void dcache_set_enabled(bool enabled) {
+    if (!enabled) {
+        for (uint32_t i = 0; i < DCACHE_ENTRIES; i++) {
+            if (dentry_pool[i].in_use) dentry_release(&dentry_pool[i]);
+        }
+    }
+    dcache_enabled = enabled;
+}
+
+bool dcache_is_enabled(void) {
+    return dcache_enabled;
+}
+
+void dcache_get_stats(dcache_stats_t* out) {
+    *out = stats;
+}
+
+void dcache_reset_stats(void) {
+    uint32_t entries = stats.entries;
+    memset(&stats, 0, sizeof(stats));
+    stats.entries = entries;
+}
@@ -0,0 +1,1730 @@
+/**
+ * ext2 - Bunix OS
+ *
+ * Read/write ext2 (revisions 0 and 1) as made by mke2fs. The superblock
+ * and group descriptor blocks stay referenced in the block cache while
+ * mounted; bitmaps, inode tables, directories and indirect blocks go
+ * through the cache in filesystem-sized blocks. File data bypasses it and
+ * moves in runs of contiguous blocks, as on FAT32.
+ *
+ * Every inode in memory keeps a copy of its on-disk inode, and changes
+ * are written through to the cached inode table block. Each one also
+ * remembers the last run of contiguous blocks the block map produced, so
+ * a sequential pass reads each indirect block once rather than once per
+ * block. Allocation aims right after the file's previous block, then
+ * anywhere in the inode's group; new directories go to the group with the
+ * most free space, so the files created in them stay together.
+ *
+ * Directories of EXT2_INDEX_MIN_BLOCKS blocks or more get an in-memory
+ * hash of their names, built on the first lookup and kept up to date by
+ * create and unlink. On-disk htree indexes are read as the plain
+ * directories they also are, and the index flag is cleared when such a
+ * directory is changed.
+ */
+
+#include "../include/fs/vfs.h"
+#include "../include/fs/ext2.h"
+#include "../include/block/blkdev.h"
+#include "../include/block/bcache.h"
+#include "../include/kernel/time/clocksource.h"
+#include "../include/mm/vmm.h"
+#include "../include/mm/kmalloc.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+
+#define EXT2_SUPER_OFFSET        1024
+#define EXT2_SUPER_MAGIC         0xEF53
+#define EXT2_ROOT_INO            2
+#define EXT2_GOOD_OLD_REV        0
+#define EXT2_GOOD_OLD_FIRST_INO  11
+#define EXT2_GOOD_OLD_INODE_SIZE 128
+#define EXT2_MAX_BLOCK_LOG       2            // 4KB blocks, one page
+#define EXT2_NAME_LEN            255
+
+#define EXT2_NDIR_BLOCKS         12
+#define EXT2_IND_BLOCK           12
+#define EXT2_DIND_BLOCK          13
+#define EXT2_TIND_BLOCK          14
+#define EXT2_N_BLOCKS            15
+
+#define EXT2_VALID_FS            0x0001
+#define EXT2_INDEX_FL            0x00001000   // Directory has an htree index
+
+#define EXT2_FEATURE_INCOMPAT_FILETYPE      0x0002
+#define EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER 0x0001
+#define EXT2_FEATURE_RO_COMPAT_LARGE_FILE   0x0002
+#define EXT2_FEATURE_RO_COMPAT_BTREE_DIR    0x0004
+
+#define EXT2_INCOMPAT_SUPPORTED  EXT2_FEATURE_INCOMPAT_FILETYPE
+#define EXT2_RO_COMPAT_SUPPORTED (EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER | \
+                                  EXT2_FEATURE_RO_COMPAT_LARGE_FILE | \
+                                  EXT2_FEATURE_RO_COMPAT_BTREE_DIR)
+
+#define EXT2_S_IFMT              0xF000
+#define EXT2_S_IFDIR             0x4000
+#define EXT2_S_IFREG             0x8000
+#define EXT2_S_IFLNK             0xA000
+
+#define EXT2_FT_REG_FILE         1
+#define EXT2_FT_DIR              2
+
+#define EXT2_DIR_REC_LEN(len)    (((len) + 8 + 3) & ~3u)
+
+#define EXT2_IO_BATCH            8            // Data requests in flight together
+#define EXT2_BOUNCE_SECTORS      (PAGE_SIZE / BLK_SECTOR_SIZE)
+#define EXT2_INDEX_MIN_BLOCKS    2
+#define EXT2_INDEX_MIN_BUCKETS   64
+
+struct ext2_super {
+    uint32_t s_inodes_count;
+    uint32_t s_blocks_count;
+    uint32_t s_r_blocks_count;
+    uint32_t s_free_blocks_count;
+    uint32_t s_free_inodes_count;
+    uint32_t s_first_data_block;
+    uint32_t s_log_block_size;
+    uint32_t s_log_frag_size;
+    uint32_t s_blocks_per_group;
+    uint32_t s_frags_per_group;
+    uint32_t s_inodes_per_group;
+    uint32_t s_mtime;
+    uint32_t s_wtime;
+    uint16_t s_mnt_count;
+    uint16_t s_max_mnt_count;
+    uint16_t s_magic;
+    uint16_t s_state;
+    uint16_t s_errors;
+    uint16_t s_minor_rev_level;
+    uint32_t s_lastcheck;
+    uint32_t s_checkinterval;
+    uint32_t s_creator_os;
+    uint32_t s_rev_level;
+    uint16_t s_def_resuid;
+    uint16_t s_def_resgid;
+    // Revision 1 only
+    uint32_t s_first_ino;
+    uint16_t s_inode_size;
+    uint16_t s_block_group_nr;
+    uint32_t s_feature_compat;
+    uint32_t s_feature_incompat;
+    uint32_t s_feature_ro_compat;
+    uint8_t s_uuid[16];
+    char s_volume_name[16];
+    char s_last_mounted[64];
+    uint32_t s_algo_usage_bitmap;
+} __attribute__((packed));
+
+struct ext2_group_desc {
+    uint32_t bg_block_bitmap;
+    uint32_t bg_inode_bitmap;
+    uint32_t bg_inode_table;
+    uint16_t bg_free_blocks_count;
+    uint16_t bg_free_inodes_count;
+    uint16_t bg_used_dirs_count;
+    uint16_t bg_pad;
+    uint8_t bg_reserved[12];
+} __attribute__((packed));
+
+struct ext2_inode {
+    uint16_t i_mode;
+    uint16_t i_uid;
+    uint32_t i_size;
+    uint32_t i_atime;
+    uint32_t i_ctime;
+    uint32_t i_mtime;
+    uint32_t i_dtime;
+    uint16_t i_gid;
+    uint16_t i_links_count;
+    uint32_t i_blocks;              // 512-byte units, indirect blocks included
+    uint32_t i_flags;
+    uint32_t i_osd1;
+    uint32_t i_block[EXT2_N_BLOCKS];
+    uint32_t i_generation;
+    uint32_t i_file_acl;
+    uint32_t i_size_high;           // i_dir_acl in revision 0
+    uint32_t i_faddr;
+    uint8_t i_osd2[12];
+};                                  // Naturally aligned, 128 bytes
+
+struct ext2_dirent {
+    uint32_t inode;                 // 0 for an unused entry
+    uint16_t rec_len;               // Distance to the next entry
+    uint8_t name_len;
+    uint8_t file_type;
+    char name[];
+} __attribute__((packed));
+
+struct ext2_info {
+    blkdev_t* dev;
+    uint32_t block_size;
+    uint32_t sectors_per_block;
+    uint32_t addr_per_block;        // Block numbers in an indirect block
+    uint32_t addr_shift;            // log2(addr_per_block)
+    uint32_t first_data_block;
+    uint32_t blocks_count;
+    uint32_t blocks_per_group;
+    uint32_t inodes_per_group;
+    uint32_t inode_size;
+    uint32_t first_ino;
+    uint32_t groups;
+    uint32_t desc_per_block;
+    bool filetype;                  // Directory entries carry the file type
+    bool writable;
+    uint16_t mount_state;           // s_state to put back on unmount
+    buffer_t* sb_buf;
+    struct ext2_super* es;          // Points into sb_buf
+    buffer_t** gd_bufs;             // Group descriptor blocks
+    uint32_t gd_blocks;
+    uint8_t* bounce;                // Partial sectors and zero fill
+};
+
+// Name hash of a large directory, chained per bucket
+struct ext2_index_entry {
+    uint32_t hash;
+    uint32_t block;                 // Directory block and offset of the entry
+    uint32_t offset;
+    struct ext2_index_entry* next;
+};
+
+struct ext2_dir_index {
+    struct ext2_index_entry** buckets;
+    uint32_t nbuckets;
+    uint32_t nentries;
+};
+
+struct ext2_node {
+    struct ext2_inode raw;          // Copy of the on-disk inode
+    bool huge;                      // Larger than vfs_off_t; read-only
+    // Last run the block map produced: map_count blocks from map_lblk
+    // on are contiguous on disk from map_pblk
+    uint32_t map_lblk;
+    uint32_t map_pblk;
+    uint32_t map_count;
+    uint32_t goal;                  // Next block to try when allocating
+    // Directories
+    struct ext2_dir_index* index;
+    uint32_t free_block;            // First block that may have room
+    uint32_t version;               // Bumped when entries go away
+};
+
+// readdir position cached per open directory
+struct ext2_cursor {
+    uint32_t version;
+    uint32_t index;                 // Visible entry returned last
+    uint32_t block;                 // Position just past it
+    uint32_t offset;
+};
+
+// Walks a directory's entries holding at most one cached block
+struct ext2_dir_iter {
+    vfs_inode_t* dir;
+    uint32_t block;
+    uint32_t offset;
+    uint32_t de_block;              // Where the entry returned last sits
+    uint32_t de_offset;
+    buffer_t* buf;
+};
+
+// A directory entry found by name
+struct ext2_slot {
+    uint32_t block;
+    uint32_t offset;
+    uint32_t ino;
+};
+
+static ext2_stats_t stats;
+
+static const vfs_inode_ops_t ext2_inode_ops;
+static const vfs_file_ops_t ext2_file_ops;
+static const vfs_super_ops_t ext2_super_ops;
+
+// Seconds since 1970, from the cached wall clock
+static uint32_t ext2_now(void) {
+    return ktime_get_real_seconds();
+}
+
+static uint32_t ext2_name_hash(const char* name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static inline bool ext2_writable(const struct ext2_info* info) {
+    return info->writable;
+}
+
+static inline uint32_t ext2_ino_group(const struct ext2_info* info, uint32_t ino) {
+    return (ino - 1) / info->inodes_per_group;
+}
+
+static inline uint32_t ext2_group_first_block(const struct ext2_info* info, uint32_t group) {
+    return info->first_data_block + group * info->blocks_per_group;
+}
+
+// The last group is usually shorter than the others
+static uint32_t ext2_group_blocks(const struct ext2_info* info, uint32_t group) {
+    uint32_t first = ext2_group_first_block(info, group);
+    uint32_t left = info->blocks_count - first;
+    return left < info->blocks_per_group ? left : info->blocks_per_group;
+}
+
+static inline struct ext2_group_desc* ext2_gd(struct ext2_info* info, uint32_t group) {
+    buffer_t* buf = info->gd_bufs[group / info->desc_per_block];
+    return (struct ext2_group_desc*)buf->data + group % info->desc_per_block;
+}
+
+static void ext2_gd_dirty(struct ext2_info* info, uint32_t group) {
+    bcache_mark_dirty(info->gd_bufs[group / info->desc_per_block]);
+    bcache_mark_dirty(info->sb_buf);
+}
+
+static inline bool ext2_is_dir(const struct ext2_inode* raw) {
+    return (raw->i_mode & EXT2_S_IFMT) == EXT2_S_IFDIR;
+}
+
+// Short symlinks keep their target in i_block instead of a data block
+static inline bool ext2_inline_symlink(const struct ext2_inode* raw) {
+    return (raw->i_mode & EXT2_S_IFMT) == EXT2_S_IFLNK && raw->i_blocks == 0;
+}
+
+// ---------------------------------------------------------------------------
+// Bitmaps
+// ---------------------------------------------------------------------------
+
+// First clear bit in [start, end), or end
+static uint32_t ext2_find_zero(const uint8_t* map, uint32_t start, uint32_t end) {
+    uint32_t i = start;
+    while (i < end) {
+        if ((i & 31) == 0 && end - i >= 32 && ((const uint32_t*)map)[i / 32] == 0xFFFFFFFF) {
+            i += 32;
+            continue;
+        }
+        if (!(map[i / 8] & (1 << (i % 8)))) return i;
+        i++;
+    }
+    return end;
+}
+
+/*
+ * Allocate one block as close after 'goal' as possible: the goal itself,
+ * the rest of its group, then the following groups, and finally the start
+ * of the goal's group.
+ */
+static int ext2_new_block(struct ext2_info* info, uint32_t goal, uint32_t* out) {
+    struct ext2_super* es = info->es;
+    if (es->s_free_blocks_count == 0) return -ENOSPC;
+    if (goal < info->first_data_block || goal >= info->blocks_count) goal = info->first_data_block;
+
+    uint32_t group = (goal - info->first_data_block) / info->blocks_per_group;
+    uint32_t bit = (goal - info->first_data_block) % info->blocks_per_group;
+
+    for (uint32_t n = 0; n <= info->groups; n++, group++, bit = 0) {
+        if (group >= info->groups) group = 0;
+        struct ext2_group_desc* gd = ext2_gd(info, group);
+        if (gd->bg_free_blocks_count == 0) continue;
+
+        buffer_t* buf;
+        int err = bcache_read(info->dev, gd->bg_block_bitmap, info->block_size, &buf);
+        if (err) return err;
+
+        uint32_t end = ext2_group_blocks(info, group);
+        uint32_t found = ext2_find_zero(buf->data, bit, end);
+        if (found == end) {
+            bcache_release(buf);
+            continue;
+        }
+
+        buf->data[found / 8] |= 1 << (found % 8);
+        bcache_mark_dirty(buf);
+        bcache_release(buf);
+        gd->bg_free_blocks_count--;
+        es->s_free_blocks_count--;
+        ext2_gd_dirty(info, group);
+
+        *out = ext2_group_first_block(info, group) + found;
+        stats.blocks_allocated++;
+        if (*out == goal) stats.blocks_at_goal++;
+        return 0;
+    }
+    return -ENOSPC;
+}
+
+static int ext2_free_block(struct ext2_info* info, uint32_t block) {
+    if (block < info->first_data_block || block >= info->blocks_count) return -EIO;
+
+    uint32_t group = (block - info->first_data_block) / info->blocks_per_group;
+    uint32_t bit = (block - info->first_data_block) % info->blocks_per_group;
+    struct ext2_group_desc* gd = ext2_gd(info, group);
+
+    // Freed metadata must not be written back over the block's next owner
+    bcache_forget(info->dev, block, info->block_size);
+
+    buffer_t* buf;
+    int err = bcache_read(info->dev, gd->bg_block_bitmap, info->block_size, &buf);
+    if (err) return err;
+    if (buf->data[bit / 8] & (1 << (bit % 8))) {
+        buf->data[bit / 8] &= ~(1 << (bit % 8));
+        bcache_mark_dirty(buf);
+        gd->bg_free_blocks_count++;
+        info->es->s_free_blocks_count++;
+        ext2_gd_dirty(info, group);
+    }
+    bcache_release(buf);
+    return 0;
+}
+
+/*
+ * Allocate an inode. Files go in their directory's group; directories go
+ * to the group with the most free blocks among those with at least the
+ * average number of free inodes, so the tree spreads over the disk.
+ */
+static int ext2_new_inode(struct ext2_info* info, uint32_t parent_group, bool dir, uint32_t* out) {
+    struct ext2_super* es = info->es;
+    if (es->s_free_inodes_count == 0) return -ENOSPC;
+
+    uint32_t start = parent_group;
+    if (dir) {
+        uint32_t average = es->s_free_inodes_count / info->groups;
+        uint32_t best_free = 0;
+        for (uint32_t g = 0; g < info->groups; g++) {
+            struct ext2_group_desc* gd = ext2_gd(info, g);
+            if (gd->bg_free_inodes_count && gd->bg_free_inodes_count >= average &&
+                gd->bg_free_blocks_count > best_free) {
+                best_free = gd->bg_free_blocks_count;
+                start = g;
+            }
+        }
+    }
+
+    for (uint32_t n = 0; n < info->groups; n++) {
+        uint32_t group = (start + n) % info->groups;
+        struct ext2_group_desc* gd = ext2_gd(info, group);
+        if (gd->bg_free_inodes_count == 0) continue;
+
+        buffer_t* buf;
+        int err = bcache_read(info->dev, gd->bg_inode_bitmap, info->block_size, &buf);
+        if (err) return err;
+
+        // Inodes below s_first_ino are reserved
+        uint32_t first = group == 0 ? info->first_ino - 1 : 0;
+        uint32_t found = ext2_find_zero(buf->data, first, info->inodes_per_group);
+        if (found == info->inodes_per_group) {
+            bcache_release(buf);
+            continue;
+        }
+
+        buf->data[found / 8] |= 1 << (found % 8);
+        bcache_mark_dirty(buf);
+        bcache_release(buf);
+        gd->bg_free_inodes_count--;
+        if (dir) gd->bg_used_dirs_count++;
+        es->s_free_inodes_count--;
+        ext2_gd_dirty(info, group);
+
+        *out = group * info->inodes_per_group + found + 1;
+        return 0;
+    }
+    return -ENOSPC;
+}
+
+static int ext2_free_inode(struct ext2_info* info, uint32_t ino, bool dir) {
+    uint32_t group = ext2_ino_group(info, ino);
+    uint32_t bit = (ino - 1) % info->inodes_per_group;
+    struct ext2_group_desc* gd = ext2_gd(info, group);
+
+    buffer_t* buf;
+    int err = bcache_read(info->dev, gd->bg_inode_bitmap, info->block_size, &buf);
+    if (err) return err;
+    if (buf->data[bit / 8] & (1 << (bit % 8))) {
+        buf->data[bit / 8] &= ~(1 << (bit % 8));
+        bcache_mark_dirty(buf);
+        gd->bg_free_inodes_count++;
+        if (dir && gd->bg_used_dirs_count) gd->bg_used_dirs_count--;
+        info->es->s_free_inodes_count++;
+        ext2_gd_dirty(info, group);
+    }
+    bcache_release(buf);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Inode table
+// ---------------------------------------------------------------------------
+
+static int ext2_inode_location(struct ext2_info* info, uint32_t ino, uint32_t* block, uint32_t* offset) {
+    if (ino == 0 || ino > info->es->s_inodes_count) return -EIO;
+
+    uint32_t index = (ino - 1) % info->inodes_per_group;
+    uint32_t byte = index * info->inode_size;
+    *block = ext2_gd(info, ext2_ino_group(info, ino))->bg_inode_table + byte / info->block_size;
+    *offset = byte % info->block_size;
+    return 0;
+}
+
+static int ext2_read_inode(struct ext2_info* info, uint32_t ino, struct ext2_inode* raw) {
+    uint32_t block, offset;
+    int err = ext2_inode_location(info, ino, &block, &offset);
+    if (err) return err;
+
+    buffer_t* buf;
+    err = bcache_read(info->dev, block, info->block_size, &buf);
+    if (err) return err;
+    memcpy(raw, buf->data + offset, sizeof(*raw));
+    bcache_release(buf);
+    stats.inode_reads++;
+    return 0;
+}
+
+// Copy the inode into the cached inode table; 'clear' wipes the rest of
+// a large on-disk inode first (fresh inodes)
+static int ext2_store_inode(vfs_inode_t* inode, bool clear) {
+    struct ext2_node* node = inode->private;
+    struct ext2_info* info = inode->sb->fs_info;
+    struct ext2_inode* raw = &node->raw;
+
+    if (!node->huge) raw->i_size = inode->size;
+    raw->i_links_count = inode->nlink;
+    inode->blocks = raw->i_blocks;
+
+    uint32_t block, offset;
+    int err = ext2_inode_location(info, inode->ino, &block, &offset);
+    if (err) return err;
+
+    buffer_t* buf;
+    err = bcache_read(info->dev, block, info->block_size, &buf);
+    if (err) return err;
+    if (clear) memset(buf->data + offset, 0, info->inode_size);
+    memcpy(buf->data + offset, raw, sizeof(*raw));
+    bcache_mark_dirty(buf);
+    bcache_release(buf);
+    stats.inode_writes++;
+    return 0;
+}
+
+static inline int ext2_write_inode(vfs_inode_t* inode) {
+    return ext2_store_inode(inode, false);
+}
+
+static void ext2_touch(vfs_inode_t* inode) {
+    struct ext2_node* node = inode->private;
+    node->raw.i_mtime = node->raw.i_ctime = ext2_now();
+    inode->mtime = node->raw.i_mtime;
+}
+
+static void ext2_fill_inode(vfs_inode_t* inode, struct ext2_node* node) {
+    struct ext2_inode* raw = &node->raw;
+
+    inode->type = ext2_is_dir(raw) ? VFS_TYPE_DIR : VFS_TYPE_FILE;
+    inode->mode = raw->i_mode & 07777;
+    inode->nlink = raw->i_links_count;
+    inode->size = raw->i_size;
+    if (!ext2_is_dir(raw) && raw->i_size_high) {
+        node->huge = true;
+        inode->size = 0xFFFFFFFF;
+    }
+    inode->blocks = raw->i_blocks;
+    inode->mtime = raw->i_mtime;
+    inode->i_op = &ext2_inode_ops;
+    inode->f_op = &ext2_file_ops;
+    inode->private = node;
+}
+
+static int ext2_iget(vfs_superblock_t* sb, uint32_t ino, vfs_inode_t** out) {
+    vfs_inode_t* inode = vfs_inode_find(sb, ino);
+    if (inode) {
+        *out = inode;
+        return 0;
+    }
+
+    struct ext2_node* node = kzalloc(sizeof(struct ext2_node));
+    if (!node) return -ENOMEM;
+
+    int err = ext2_read_inode(sb->fs_info, ino, &node->raw);
+    if (!err && node->raw.i_links_count == 0) err = -EIO;   // Entry names a free inode
+    if (!err) {
+        inode = vfs_inode_alloc(sb, ino);
+        if (!inode) err = -ENOMEM;
+    }
+    if (err) {
+        kfree(node);
+        return err;
+    }
+
+    ext2_fill_inode(inode, node);
+    *out = inode;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Block map
+// ---------------------------------------------------------------------------
+
+// Indexes leading to logical block lblk: offsets[0] into i_block, then
+// one per indirect level. Returns the number of indirect levels.
+static int ext2_block_path(const struct ext2_info* info, uint32_t lblk, uint32_t offsets[4]) {
+    uint32_t apb = info->addr_per_block;
+    uint32_t shift = info->addr_shift;
+
+    if (lblk < EXT2_NDIR_BLOCKS) {
+        offsets[0] = lblk;
+        return 0;
+    }
+    lblk -= EXT2_NDIR_BLOCKS;
+    if (lblk < apb) {
+        offsets[0] = EXT2_IND_BLOCK;
+        offsets[1] = lblk;
+        return 1;
+    }
+    lblk -= apb;
+    if (lblk < apb * apb) {
+        offsets[0] = EXT2_DIND_BLOCK;
+        offsets[1] = lblk >> shift;
+        offsets[2] = lblk & (apb - 1);
+        return 2;
+    }
+    lblk -= apb * apb;
+    offsets[0] = EXT2_TIND_BLOCK;
+    offsets[1] = lblk >> (2 * shift);
+    offsets[2] = (lblk >> shift) & (apb - 1);
+    offsets[3] = lblk & (apb - 1);
+    return 3;
+}
+
+/*
+ * Disk block holding logical block lblk (0 in a hole) and in *run how
+ * many blocks from lblk on continue contiguously on disk, or stay a hole.
+ * A run never extends past the indirect block it was found in.
+ */
+static int ext2_bmap(vfs_inode_t* inode, uint32_t lblk, uint32_t* pblk, uint32_t* run) {
+    struct ext2_node* node = inode->private;
+    struct ext2_info* info = inode->sb->fs_info;
+
+    if (node->map_count && lblk - node->map_lblk < node->map_count) {
+        *pblk = node->map_pblk + (lblk - node->map_lblk);
+        *run = node->map_count - (lblk - node->map_lblk);
+        stats.map_hits++;
+        return 0;
+    }
+    stats.map_misses++;
+
+    uint32_t offsets[4];
+    int depth = ext2_block_path(info, lblk, offsets);
+    const uint32_t* table = node->raw.i_block;
+    uint32_t end = EXT2_NDIR_BLOCKS;
+    buffer_t* buf = NULL;
+
+    for (int level = 0; level < depth; level++) {
+        uint32_t block = table[offsets[level]];
+        if (buf) bcache_release(buf);
+        buf = NULL;
+
+        if (block == 0) {
+            // The hole covers the rest of the missing block's subtree
+            uint32_t span = 1;
+            uint32_t within = 0;
+            for (int l = level + 1; l <= depth; l++) {
+                span *= info->addr_per_block;
+                within = within * info->addr_per_block + offsets[l];
+            }
+            *pblk = 0;
+            *run = span - within;
+            return 0;
+        }
+        if (block >= info->blocks_count) return -EIO;
+
+        int err = bcache_read(info->dev, block, info->block_size, &buf);
+        if (err) return err;
+        table = (const uint32_t*)buf->data;
+        end = info->addr_per_block;
+    }
+
+    uint32_t i = offsets[depth];
+    uint32_t first = table[i];
+    uint32_t n = 1;
+    if (first) {
+        while (i + n < end && table[i + n] == first + n) n++;
+    } else {
+        while (i + n < end && table[i + n] == 0) n++;
+    }
+    if (buf) bcache_release(buf);
+    if (first >= info->blocks_count) return -EIO;
+
+    *pblk = first;
+    *run = n;
+    if (first) {
+        node->map_lblk = lblk;
+        node->map_pblk = first;
+        node->map_count = n;
+    }
+    return 0;
+}
+
+// Where the inode's next block should go
+static uint32_t ext2_goal(vfs_inode_t* inode, uint32_t lblk) {
+    struct ext2_node* node = inode->private;
+    struct ext2_info* info = inode->sb->fs_info;
+
+    if (!node->goal && lblk > 0) {
+        uint32_t prev, run;
+        if (ext2_bmap(inode, lblk - 1, &prev, &run) == 0 && prev) node->goal = prev + 1;
+    }
+    if (!node->goal) node->goal = ext2_group_first_block(info, ext2_ino_group(info, inode->ino));
+    return node->goal;
+}
+
+/*
+ * Give logical block lblk a disk block if it has none, allocating any
+ * missing indirect blocks on the way. *fresh tells the caller whether the
+ * block is new and still holds whatever was on the disk.
+ */
+static int ext2_alloc_lblk(vfs_inode_t* inode, uint32_t lblk, uint32_t* pblk, bool* fresh) {
+    struct ext2_node* node = inode->private;
+    struct ext2_info* info = inode->sb->fs_info;
+    uint32_t run;
+
+    *fresh = false;
+    int err = ext2_bmap(inode, lblk, pblk, &run);
+    if (err || *pblk) return err;
+
+    uint32_t offsets[4];
+    int depth = ext2_block_path(info, lblk, offsets);
+    uint32_t* slot = &node->raw.i_block[offsets[0]];
+    buffer_t* buf = NULL;
+
+    for (int level = 0; level < depth && !err; level++) {
+        uint32_t block = *slot;
+        if (!block) {
+            err = ext2_new_block(info, ext2_goal(inode, lblk), &block);
+            if (err) break;
+
+            buffer_t* ind;
+            err = bcache_get_new(info->dev, block, info->block_size, &ind);
+            if (err) {
+                ext2_free_block(info, block);
+                break;
+            }
+            memset(ind->data, 0, info->block_size);
+            bcache_mark_dirty(ind);
+            bcache_release(ind);
+
+            *slot = block;
+            if (buf) bcache_mark_dirty(buf);
+            node->raw.i_blocks += info->sectors_per_block;
+            node->goal = block + 1;
+        }
+
+        if (buf) bcache_release(buf);
+        buf = NULL;
+        err = bcache_read(info->dev, block, info->block_size, &buf);
+        if (!err) slot = (uint32_t*)buf->data + offsets[level + 1];
+    }
+
+    if (!err) err = ext2_new_block(info, ext2_goal(inode, lblk), pblk);
+    if (!err) {
+        *slot = *pblk;
+        if (buf) bcache_mark_dirty(buf);
+        node->raw.i_blocks += info->sectors_per_block;
+        node->goal = *pblk + 1;
+        *fresh = true;
+
+        // Appending right after the cached run just lengthens it
+        if (node->map_count && node->map_lblk + node->map_count == lblk &&
+            node->map_pblk + node->map_count == *pblk) {
+            node->map_count++;
+        } else {
+            node->map_lblk = lblk;
+            node->map_pblk = *pblk;
+            node->map_count = 1;
+        }
+    }
+    if (buf) bcache_release(buf);
+    return err;
+}
+
+/*
+ * Free the part of the subtree in *slot mapping logical blocks 'from' and
+ * up. The subtree maps 'span' blocks starting at 'first'; level 0 is a
+ * data block. *slot is cleared once nothing below it is left.
+ */
+static int ext2_free_tree(vfs_inode_t* inode, uint32_t* slot, int level, uint32_t first, uint32_t span,
+                          uint32_t from) {
+    struct ext2_node* node = inode->private;
+    struct ext2_info* info = inode->sb->fs_info;
+    uint32_t block = *slot;
+
+    if (!block || first + span <= from) return 0;
+    if (block >= info->blocks_count) return -EIO;
+
+    if (level > 0) {
+        buffer_t* buf;
+        int err = bcache_read(info->dev, block, info->block_size, &buf);
+        if (err) return err;
+
+        uint32_t* table = (uint32_t*)buf->data;
+        uint32_t child_span = span >> info->addr_shift;
+        for (uint32_t i = 0; i < info->addr_per_block && !err; i++) {
+            uint32_t child_first = first + i * child_span;
+            if (!table[i] || child_first + child_span <= from) continue;
+            err = ext2_free_tree(inode, &table[i], level - 1, child_first, child_span, from);
+            bcache_mark_dirty(buf);
+        }
+        bcache_release(buf);
+        if (err) return err;
+
+        // Still maps blocks before 'from'
+        if (first < from) return 0;
+    }
+
+    ext2_free_block(info, block);
+    node->raw.i_blocks -= info->sectors_per_block;
+    *slot = 0;
+    return 0;
+}
+
+// Free every block mapping logical block 'from' or later
+static int ext2_free_blocks_from(vfs_inode_t* inode, uint32_t from) {
+    struct ext2_node* node = inode->private;
+    struct ext2_info* info = inode->sb->fs_info;
+    uint32_t* blocks = node->raw.i_block;
+    int err = 0;
+
+    node->map_count = 0;
+    node->goal = 0;
+    for (uint32_t i = 0; i < EXT2_NDIR_BLOCKS && !err; i++) {
+        err = ext2_free_tree(inode, &blocks[i], 0, i, 1, from);
+    }
+
+    uint32_t first = EXT2_NDIR_BLOCKS;
+    uint32_t span = info->addr_per_block;
+    for (int level = 1; level <= 3 && !err; level++) {
+        err = ext2_free_tree(inode, &blocks[EXT2_IND_BLOCK + level - 1], level, first, span, from);
+        first += span;
+        if (level < 3) span <<= info->addr_shift;
+    }
+    return err;
+}
+
+// ---------------------------------------------------------------------------
+// Data transfer
+// ---------------------------------------------------------------------------
+
+// Move sectors between memory and the device, as requests of up to
+// max_sectors handed to the request queue together
+static int ext2_io(struct ext2_info* info, uint32_t op, uint64_t lba, uint32_t count, uint8_t* buf) {
+    blkdev_t* dev = info->dev;
+    blk_request_t reqs[EXT2_IO_BATCH];
+
+    while (count > 0) {
+        blk_plug_t plug;
+        int n = 0;
+        int err = 0;
+
+        blk_start_plug(&plug);
+        while (n < EXT2_IO_BATCH && count > 0) {
+            uint32_t chunk = count < dev->max_sectors ? count : dev->max_sectors;
+            memset(&reqs[n], 0, sizeof(reqs[n]));
+            reqs[n].dev = dev;
+            reqs[n].op = op;
+            reqs[n].lba = lba;
+            reqs[n].count = chunk;
+            reqs[n].buffer = buf;
+
+            err = blkdev_submit(&reqs[n]);
+            if (err) break;
+            n++;
+            lba += chunk;
+            count -= chunk;
+            buf += chunk * BLK_SECTOR_SIZE;
+            stats.data_requests++;
+        }
+        blk_finish_plug(&plug);
+
+        for (int i = 0; i < n; i++) {
+            blkdev_wait(&reqs[i]);
+            if (reqs[i].status && !err) err = reqs[i].status;
+        }
+        if (err) return err;
+    }
+    return 0;
+}
+
+/*
+ * Copy file data between buf and the disk. Whole sectors move straight to
+ * or from buf as far as the run of contiguous blocks reaches; partial
+ * sectors and odd buffers go through the bounce page. Holes read as
+ * zeros; writes need their blocks allocated first. buf == NULL writes
+ * zeros.
+ */
+static int ext2_transfer(vfs_inode_t* inode, uint32_t op, uint8_t* buf, size_t count, vfs_off_t offset) {
+    struct ext2_info* info = inode->sb->fs_info;
+    uint32_t bs = info->block_size;
+    uint8_t* bounce = info->bounce;
+    size_t done = 0;
+
+    while (done < count) {
+        uint32_t pos = offset + done;
+        uint32_t in_block = pos % bs;
+        size_t left = count - done;
+        uint32_t pblk, run;
+        int err = ext2_bmap(inode, pos / bs, &pblk, &run);
+        if (err) return err;
+
+        if (!pblk) {
+            if (op != BLK_OP_READ) return -EIO;
+            size_t chunk = bs - in_block;
+            if (run > 1) chunk += (left / bs < run - 1 ? left / bs : run - 1) * bs;
+            if (chunk > left) chunk = left;
+            memset(buf + done, 0, chunk);
+            done += chunk;
+            continue;
+        }
+
+        uint64_t lba = (uint64_t)pblk * info->sectors_per_block + in_block / BLK_SECTOR_SIZE;
+        uint32_t sectors = run * info->sectors_per_block - in_block / BLK_SECTOR_SIZE;
+        uint32_t in_sector = pos % BLK_SECTOR_SIZE;
+
+        if (in_sector == 0 && left >= BLK_SECTOR_SIZE && buf && ((uint32_t)(buf + done) & 1) == 0) {
+            uint32_t n = left / BLK_SECTOR_SIZE < sectors ? left / BLK_SECTOR_SIZE : sectors;
+            err = ext2_io(info, op, lba, n, buf + done);
+            if (err) return err;
+            done += n * BLK_SECTOR_SIZE;
+            continue;
+        }
+
+        uint32_t n = sectors < EXT2_BOUNCE_SECTORS ? sectors : EXT2_BOUNCE_SECTORS;
+        size_t chunk = n * BLK_SECTOR_SIZE - in_sector;
+        if (chunk > left) chunk = left;
+        n = (in_sector + chunk + BLK_SECTOR_SIZE - 1) / BLK_SECTOR_SIZE;
+
+        if (op == BLK_OP_READ) {
+            err = ext2_io(info, BLK_OP_READ, lba, n, bounce);
+            if (err) return err;
+            memcpy(buf + done, bounce + in_sector, chunk);
+        } else {
+            // Keep the rest of partially written sectors
+            if (in_sector) err = ext2_io(info, BLK_OP_READ, lba, 1, bounce);
+            if (!err && (in_sector + chunk) % BLK_SECTOR_SIZE && !(n == 1 && in_sector)) {
+                err = ext2_io(info, BLK_OP_READ, lba + n - 1, 1, bounce + (n - 1) * BLK_SECTOR_SIZE);
+            }
+            if (err) return err;
+
+            if (buf) memcpy(bounce + in_sector, buf + done, chunk);
+            else memset(bounce + in_sector, 0, chunk);
+            err = ext2_io(info, BLK_OP_WRITE, lba, n, bounce);
+            if (err) return err;
+        }
+        done += chunk;
+    }
+    return done;
+}
+
+// ---------------------------------------------------------------------------
+// Directories
+// ---------------------------------------------------------------------------
+
+static inline bool ext2_dirent_ok(const struct ext2_info* info, const struct ext2_dirent* de, uint32_t offset) {
+    return de->rec_len >= 8 && (de->rec_len & 3) == 0 && offset + de->rec_len <= info->block_size &&
+           de->name_len + 8u <= de->rec_len;
+}
+
+static inline bool ext2_is_dot(const struct ext2_dirent* de) {
+    return de->name[0] == '.' && (de->name_len == 1 || (de->name_len == 2 && de->name[1] == '.'));
+}
+
+// Directory block 'index' through the cache; directories have no holes
+static int ext2_dir_block(vfs_inode_t* dir, uint32_t index, buffer_t** out) {
+    struct ext2_info* info = dir->sb->fs_info;
+    uint32_t pblk, run;
+
+    int err = ext2_bmap(dir, index, &pblk, &run);
+    if (err) return err;
+    if (!pblk) return -EIO;
+    return bcache_read(info->dev, pblk, info->block_size, out);
+}
+
+// Next in-use entry; 1 when *out was set (valid until the next call),
+// 0 at the end of the directory
+static int ext2_dir_next(struct ext2_dir_iter* it, struct ext2_dirent** out) {
+    struct ext2_info* info = it->dir->sb->fs_info;
+    uint32_t nblocks = it->dir->size / info->block_size;
+
+    while (it->block < nblocks) {
+        if (!it->buf) {
+            int err = ext2_dir_block(it->dir, it->block, &it->buf);
+            if (err) return err;
+        }
+        while (it->offset < info->block_size) {
+            struct ext2_dirent* de = (struct ext2_dirent*)(it->buf->data + it->offset);
+            if (!ext2_dirent_ok(info, de, it->offset)) return -EIO;
+
+            it->de_block = it->block;
+            it->de_offset = it->offset;
+            it->offset += de->rec_len;
+            if (de->inode) {
+                *out = de;
+                return 1;
+            }
+        }
+        bcache_release(it->buf);
+        it->buf = NULL;
+        it->block++;
+        it->offset = 0;
+    }
+    return 0;
+}
+
+static void ext2_dir_done(struct ext2_dir_iter* it) {
+    if (it->buf) bcache_release(it->buf);
+    it->buf = NULL;
+}
+
+static void ext2_index_free(struct ext2_node* node) {
+    struct ext2_dir_index* index = node->index;
+    if (!index) return;
+
+    for (uint32_t b = 0; b < index->nbuckets; b++) {
+        struct ext2_index_entry* e = index->buckets[b];
+        while (e) {
+            struct ext2_index_entry* next = e->next;
+            kfree(e);
+            e = next;
+        }
+    }
+    kfree(index->buckets);
+    kfree(index);
+    node->index = NULL;
+}
+
+static int ext2_index_insert(struct ext2_dir_index* index, uint32_t hash, uint32_t block, uint32_t offset) {
+    // Keep the load factor at or below one entry per bucket
+    if (index->nentries + 1 > index->nbuckets) {
+        uint32_t nbuckets = index->nbuckets ? index->nbuckets * 2 : EXT2_INDEX_MIN_BUCKETS;
+        struct ext2_index_entry** buckets = kzalloc(nbuckets * sizeof(*buckets));
+        if (!buckets) return -ENOMEM;
+
+        for (uint32_t b = 0; b < index->nbuckets; b++) {
+            struct ext2_index_entry* e = index->buckets[b];
+            while (e) {
+                struct ext2_index_entry* next = e->next;
+                e->next = buckets[e->hash & (nbuckets - 1)];
+                buckets[e->hash & (nbuckets - 1)] = e;
+                e = next;
+            }
+        }
+        kfree(index->buckets);
+        index->buckets = buckets;
+        index->nbuckets = nbuckets;
+    }
+
+    struct ext2_index_entry* e = kmalloc(sizeof(struct ext2_index_entry));
+    if (!e) return -ENOMEM;
+    e->hash = hash;
+    e->block = block;
+    e->offset = offset;
+    e->next = index->buckets[hash & (index->nbuckets - 1)];
+    index->buckets[hash & (index->nbuckets - 1)] = e;
+    index->nentries++;
+    return 0;
+}
+
+static void ext2_index_remove(struct ext2_dir_index* index, uint32_t hash, uint32_t block, uint32_t offset) {
+    struct ext2_index_entry** link = &index->buckets[hash & (index->nbuckets - 1)];
+    for (; *link; link = &(*link)->next) {
+        struct ext2_index_entry* e = *link;
+        if (e->block == block && e->offset == offset) {
+            *link = e->next;
+            kfree(e);
+            index->nentries--;
+            return;
+        }
+    }
+}
+
+// Hash every name of a large directory; without memory we just scan
+static void ext2_index_build(vfs_inode_t* dir) {
+    struct ext2_node* node = dir->private;
+    struct ext2_dir_index* index = kzalloc(sizeof(struct ext2_dir_index));
+    if (!index) return;
+    node->index = index;
+
+    struct ext2_dir_iter it = { .dir = dir };
+    struct ext2_dirent* de;
+    int ret;
+    while ((ret = ext2_dir_next(&it, &de)) > 0) {
+        uint32_t hash = ext2_name_hash(de->name, de->name_len);
+        if (ext2_index_insert(index, hash, it.de_block, it.de_offset) != 0) {
+            ret = -ENOMEM;
+            break;
+        }
+    }
+    ext2_dir_done(&it);
+
+    if (ret < 0) ext2_index_free(node);
+    else stats.index_builds++;
+}
+
+static int ext2_find(vfs_inode_t* dir, const char* name, size_t len, struct ext2_slot* out) {
+    struct ext2_node* node = dir->private;
+    struct ext2_info* info = dir->sb->fs_info;
+
+    if (!node->index && dir->size / info->block_size >= EXT2_INDEX_MIN_BLOCKS) ext2_index_build(dir);
+
+    if (node->index) {
+        stats.index_lookups++;
+        uint32_t hash = ext2_name_hash(name, len);
+        struct ext2_dir_index* index = node->index;
+        for (struct ext2_index_entry* e = index->buckets[hash & (index->nbuckets - 1)]; e; e = e->next) {
+            if (e->hash != hash) continue;
+
+            buffer_t* buf;
+            int err = ext2_dir_block(dir, e->block, &buf);
+            if (err) return err;
+            struct ext2_dirent* de = (struct ext2_dirent*)(buf->data + e->offset);
+            bool match = de->inode && de->name_len == len && memcmp(de->name, name, len) == 0;
+            if (match) {
+                out->block = e->block;
+                out->offset = e->offset;
+                out->ino = de->inode;
+            }
+            bcache_release(buf);
+            if (match) return 0;
+        }
+        return -ENOENT;
+    }
+
+    stats.linear_lookups++;
+    struct ext2_dir_iter it = { .dir = dir };
+    struct ext2_dirent* de;
+    int ret;
+    while ((ret = ext2_dir_next(&it, &de)) > 0) {
+        if (de->name_len == len && memcmp(de->name, name, len) == 0) {
+            out->block = it.de_block;
+            out->offset = it.de_offset;
+            out->ino = de->inode;
+            break;
+        }
+    }
+    ext2_dir_done(&it);
+    if (ret < 0) return ret;
+    return ret ? 0 : -ENOENT;
+}
+
+// Bookkeeping after an entry appeared or went away
+static int ext2_dir_changed(vfs_inode_t* dir) {
+    struct ext2_node* node = dir->private;
+
+    // An htree index on disk no longer matches the entries
+    node->raw.i_flags &= ~EXT2_INDEX_FL;
+    ext2_touch(dir);
+    return ext2_write_inode(dir);
+}
+
+/*
+ * Add an entry, in the first gap big enough from the free-space hint on
+ * or else in a new block at the end. Entries never move once written, so
+ * the name hash can keep pointing at them.
+ */
+static int ext2_add_entry(vfs_inode_t* dir, const char* name, size_t len, uint32_t ino, uint8_t type) {
+    struct ext2_node* node = dir->private;
+    struct ext2_info* info = dir->sb->fs_info;
+    uint32_t bs = info->block_size;
+    uint32_t need = EXT2_DIR_REC_LEN(len);
+    uint32_t nblocks = dir->size / bs;
+    struct ext2_dirent* de = NULL;
+    buffer_t* buf = NULL;
+    uint32_t block;
+    uint32_t offset = 0;
+    int err;
+
+    for (block = node->free_block; block < nblocks && !de; block++) {
+        err = ext2_dir_block(dir, block, &buf);
+        if (err) return err;
+
+        for (offset = 0; offset < bs; offset += ((struct ext2_dirent*)(buf->data + offset))->rec_len) {
+            struct ext2_dirent* cur = (struct ext2_dirent*)(buf->data + offset);
+            if (!ext2_dirent_ok(info, cur, offset)) {
+                bcache_release(buf);
+                return -EIO;
+            }
+
+            uint32_t used = cur->inode ? EXT2_DIR_REC_LEN(cur->name_len) : 0;
+            if (cur->rec_len - used < need) continue;
+
+            // Split the slack off the end of the entry, or reuse an empty one
+            de = cur;
+            if (used) {
+                de = (struct ext2_dirent*)(buf->data + offset + used);
+                de->rec_len = cur->rec_len - used;
+                cur->rec_len = used;
+                offset += used;
+            }
+            break;
+        }
+        if (!de) bcache_release(buf);
+    }
+
+    if (de) {
+        block--;
+    } else {
+        uint32_t pblk;
+        bool fresh;
+        err = ext2_alloc_lblk(dir, nblocks, &pblk, &fresh);
+        if (!err) err = bcache_get_new(info->dev, pblk, bs, &buf);
+        if (err) {
+            ext2_write_inode(dir);
+            return err;
+        }
+        memset(buf->data, 0, bs);
+        de = (struct ext2_dirent*)buf->data;
+        de->rec_len = bs;
+        block = nblocks;
+        offset = 0;
+        dir->size += bs;
+    }
+
+    de->inode = ino;
+    de->name_len = len;
+    de->file_type = info->filetype ? type : 0;
+    memcpy(de->name, name, len);
+    bcache_mark_dirty(buf);
+    bcache_release(buf);
+    node->free_block = block;
+
+    if (node->index && ext2_index_insert(node->index, ext2_name_hash(name, len), block, offset) != 0) {
+        ext2_index_free(node);
+    }
+    return ext2_dir_changed(dir);
+}
+
+static int ext2_remove_entry(vfs_inode_t* dir, const struct ext2_slot* slot) {
+    struct ext2_node* node = dir->private;
+    struct ext2_info* info = dir->sb->fs_info;
+
+    buffer_t* buf;
+    int err = ext2_dir_block(dir, slot->block, &buf);
+    if (err) return err;
+
+    // Merge into the previous entry, or mark the block's first one unused
+    struct ext2_dirent* prev = NULL;
+    uint32_t offset = 0;
+    while (offset < slot->offset) {
+        prev = (struct ext2_dirent*)(buf->data + offset);
+        if (!ext2_dirent_ok(info, prev, offset)) break;
+        offset += prev->rec_len;
+    }
+    struct ext2_dirent* de = (struct ext2_dirent*)(buf->data + slot->offset);
+    if (offset != slot->offset || !ext2_dirent_ok(info, de, offset)) {
+        bcache_release(buf);
+        return -EIO;
+    }
+
+    if (node->index) ext2_index_remove(node->index, ext2_name_hash(de->name, de->name_len), slot->block, slot->offset);
+    if (prev) prev->rec_len += de->rec_len;
+    else de->inode = 0;
+    bcache_mark_dirty(buf);
+    bcache_release(buf);
+
+    node->version++;
+    if (slot->block < node->free_block) node->free_block = slot->block;
+    return ext2_dir_changed(dir);
+}
+
+static int ext2_dir_empty(vfs_inode_t* dir) {
+    struct ext2_dir_iter it = { .dir = dir };
+    struct ext2_dirent* de;
+    int ret;
+
+    while ((ret = ext2_dir_next(&it, &de)) > 0 && ext2_is_dot(de));
+    ext2_dir_done(&it);
+    if (ret < 0) return ret;
+    return ret ? -ENOTEMPTY : 0;
+}
+
+// First block of a new directory: "." and ".."
+static int ext2_init_dir(vfs_inode_t* inode, uint32_t parent) {
+    struct ext2_info* info = inode->sb->fs_info;
+    uint32_t pblk;
+    bool fresh;
+
+    int err = ext2_alloc_lblk(inode, 0, &pblk, &fresh);
+    if (err) return err;
+
+    buffer_t* buf;
+    err = bcache_get_new(info->dev, pblk, info->block_size, &buf);
+    if (err) return err;
+    memset(buf->data, 0, info->block_size);
+
+    struct ext2_dirent* dot = (struct ext2_dirent*)buf->data;
+    dot->inode = inode->ino;
+    dot->rec_len = EXT2_DIR_REC_LEN(1);
+    dot->name_len = 1;
+    dot->file_type = info->filetype ? EXT2_FT_DIR : 0;
+    dot->name[0] = '.';
+
+    struct ext2_dirent* dotdot = (struct ext2_dirent*)(buf->data + dot->rec_len);
+    dotdot->inode = parent;
+    dotdot->rec_len = info->block_size - dot->rec_len;
+    dotdot->name_len = 2;
+    dotdot->file_type = dot->file_type;
+    dotdot->name[0] = dotdot->name[1] = '.';
+
+    bcache_mark_dirty(buf);
+    bcache_release(buf);
+    inode->size = info->block_size;
+    return 0;
+}
+
+static int ext2_lookup(vfs_inode_t* dir, const char* name, size_t len, vfs_inode_t** out) {
+    struct ext2_slot slot;
+    int err = ext2_find(dir, name, len, &slot);
+    if (err) return err;
+    return ext2_iget(dir->sb, slot.ino, out);
+}
+
+static int ext2_create(vfs_inode_t* dir, const char* name, size_t len, uint32_t type, vfs_inode_t** out) {
+    struct ext2_info* info = dir->sb->fs_info;
+    struct ext2_slot slot;
+    bool is_dir = type == VFS_TYPE_DIR;
+
+    if (len == 0 || len > EXT2_NAME_LEN) return -EINVAL;
+    if (type != VFS_TYPE_FILE && !is_dir) return -EINVAL;
+    int err = ext2_find(dir, name, len, &slot);
+    if (err != -ENOENT) return err ? err : -EEXIST;
+
+    uint32_t ino;
+    err = ext2_new_inode(info, ext2_ino_group(info, dir->ino), is_dir, &ino);
+    if (err) return err;
+
+    struct ext2_node* node = kzalloc(sizeof(struct ext2_node));
+    vfs_inode_t* inode = node ? vfs_inode_alloc(dir->sb, ino) : NULL;
+    if (!inode) {
+        kfree(node);
+        ext2_free_inode(info, ino, is_dir);
+        return -ENOMEM;
+    }
+
+    struct ext2_inode* raw = &node->raw;
+    raw->i_mode = is_dir ? (EXT2_S_IFDIR | 0755) : (EXT2_S_IFREG | 0644);
+    raw->i_links_count = is_dir ? 2 : 1;
+    raw->i_atime = raw->i_ctime = raw->i_mtime = ext2_now();
+    ext2_fill_inode(inode, node);
+
+    err = is_dir ? ext2_init_dir(inode, dir->ino) : 0;
+    if (!err) err = ext2_store_inode(inode, true);
+    if (!err) err = ext2_add_entry(dir, name, len, ino, is_dir ? EXT2_FT_DIR : EXT2_FT_REG_FILE);
+    if (err) {
+        // Eviction gives the blocks and the inode back
+        inode->nlink = 0;
+        vfs_inode_put(inode);
+        return err;
+    }
+
+    if (is_dir) {
+        dir->nlink++;                       // The new ".."
+        ext2_write_inode(dir);
+    }
+    *out = inode;
+    return 0;
+}
+
+static int ext2_unlink(vfs_inode_t* dir, const char* name, size_t len) {
+    struct ext2_slot slot;
+
+    if ((len == 1 && name[0] == '.') || (len == 2 && name[0] == '.' && name[1] == '.')) return -EINVAL;
+    int err = ext2_find(dir, name, len, &slot);
+    if (err) return err;
+
+    vfs_inode_t* inode;
+    err = ext2_iget(dir->sb, slot.ino, &inode);
+    if (err) return err;
+
+    if (inode->type == VFS_TYPE_DIR) err = ext2_dir_empty(inode);
+    if (!err) err = ext2_remove_entry(dir, &slot);
+    if (err) {
+        vfs_inode_put(inode);
+        return err;
+    }
+
+    if (inode->type == VFS_TYPE_DIR) {
+        inode->nlink = 0;
+        if (dir->nlink > 2) dir->nlink--;
+        ext2_write_inode(dir);
+    } else if (inode->nlink) {
+        inode->nlink--;
+    }
+    struct ext2_node* node = inode->private;
+    node->raw.i_ctime = ext2_now();
+    err = ext2_write_inode(inode);
+
+    // The blocks and the inode go when the last reference does
+    vfs_inode_put(inode);
+    return err;
+}
+
+// ---------------------------------------------------------------------------
+// File data
+// ---------------------------------------------------------------------------
+
+static int ext2_truncate(vfs_inode_t* inode, vfs_off_t size) {
+    struct ext2_node* node = inode->private;
+    struct ext2_info* info = inode->sb->fs_info;
+    uint32_t bs = info->block_size;
+
+    if (inode->type == VFS_TYPE_DIR) return -EISDIR;
+    if (node->huge || ext2_inline_symlink(&node->raw)) return -EPERM;
+
+    if (size < inode->size) {
+        int err = ext2_free_blocks_from(inode, size / bs + (size % bs ? 1 : 0));
+
+        // Zero the rest of the new last block so growing again reads zeros
+        uint32_t pblk, run;
+        if (!err && size % bs) err = ext2_bmap(inode, size / bs, &pblk, &run);
+        if (!err && size % bs && pblk) {
+            int n = ext2_transfer(inode, BLK_OP_WRITE, NULL, bs - size % bs, size);
+            if (n < 0) err = n;
+        }
+        if (err) {
+            ext2_write_inode(inode);
+            return err;
+        }
+    }
+
+    // Growing just leaves a hole
+    inode->size = size;
+    ext2_touch(inode);
+    return ext2_write_inode(inode);
+}
+
+static int ext2_readpages(vfs_inode_t* inode, void* buf, size_t count, vfs_off_t offset) {
+    struct ext2_node* node = inode->private;
+
+    if (offset >= inode->size) return 0;
+    if (count > inode->size - offset) count = inode->size - offset;
+
+    if (ext2_inline_symlink(&node->raw)) {
+        if (offset + count > sizeof(node->raw.i_block)) return -EIO;
+        memcpy(buf, (uint8_t*)node->raw.i_block + offset, count);
+        return count;
+    }
+    return ext2_transfer(inode, BLK_OP_READ, buf, count, offset);
+}
+
+static int ext2_write(vfs_file_t* file, const void* buf, size_t count, vfs_off_t offset) {
+    vfs_inode_t* inode = file->inode;
+    struct ext2_node* node = inode->private;
+    struct ext2_info* info = inode->sb->fs_info;
+    uint32_t bs = info->block_size;
+
+    if (node->huge || (uint64_t)offset + count > 0xFFFFFFFFu) return -EFBIG;
+    if (ext2_inline_symlink(&node->raw)) return -EPERM;
+    if (count == 0) return 0;
+
+    // Give every block the write touches a disk block; new ones that are
+    // only partly written get zeros first
+    uint32_t first = offset / bs;
+    uint32_t last = (offset + count - 1) / bs;
+    uint32_t lblk;
+    int err = 0;
+    for (lblk = first; lblk <= last; lblk++) {
+        uint32_t pblk;
+        bool fresh;
+        err = ext2_alloc_lblk(inode, lblk, &pblk, &fresh);
+        if (err) break;
+
+        uint32_t start = lblk == first ? offset % bs : 0;
+        uint32_t end = lblk == last ? (offset + count - 1) % bs + 1 : bs;
+        if (fresh && (start != 0 || end != bs)) {
+            memset(info->bounce, 0, bs);
+            err = ext2_io(info, BLK_OP_WRITE, (uint64_t)pblk * info->sectors_per_block,
+                          info->sectors_per_block, info->bounce);
+            if (err) break;
+        }
+    }
+    if (err) {
+        if (err != -ENOSPC || lblk == first) {
+            ext2_write_inode(inode);
+            return err;
+        }
+        count = lblk * bs - offset;
+    }
+
+    int n = ext2_transfer(inode, BLK_OP_WRITE, (uint8_t*)buf, count, offset);
+    if (n > 0 && offset + n > inode->size) inode->size = offset + n;
+    ext2_touch(inode);
+    err = ext2_write_inode(inode);
+    if (n <= 0) return n;
+    return err ? err : n;
+}
+
+static int ext2_open(vfs_inode_t* inode, vfs_file_t* file) {
+    if (inode->type != VFS_TYPE_DIR) return 0;
+
+    struct ext2_cursor* cursor = kzalloc(sizeof(struct ext2_cursor));
+    if (!cursor) return -ENOMEM;
+    file->private = cursor;
+    return 0;
+}
+
+static void ext2_release(vfs_inode_t* inode, vfs_file_t* file) {
+    (void)inode;
+    kfree(file->private);
+    file->private = NULL;
+}
+
+static uint32_t ext2_dirent_type(struct ext2_info* info, const struct ext2_dirent* de) {
+    if (info->filetype && de->file_type) return de->file_type == EXT2_FT_DIR ? VFS_TYPE_DIR : VFS_TYPE_FILE;
+
+    struct ext2_inode raw;
+    if (ext2_read_inode(info, de->inode, &raw) != 0) return VFS_TYPE_FILE;
+    return ext2_is_dir(&raw) ? VFS_TYPE_DIR : VFS_TYPE_FILE;
+}
+
+// "." and "..", and names too long for the VFS, are not listed
+static inline bool ext2_dirent_visible(const struct ext2_dirent* de) {
+    return !ext2_is_dot(de) && de->name_len <= VFS_NAME_MAX;
+}
+
+static int ext2_readdir(vfs_file_t* file, uint32_t index, vfs_dirent_t* out) {
+    struct ext2_node* node = file->inode->private;
+    struct ext2_info* info = file->inode->sb->fs_info;
+    struct ext2_cursor* cursor = file->private;
+    struct ext2_dir_iter it = { .dir = file->inode };
+    struct ext2_dirent* de;
+    uint32_t skip = index;
+    int ret;
+
+    // Sequential listing continues after the cached entry
+    if (cursor && cursor->version == node->version && cursor->index + 1 == index && index > 0) {
+        it.block = cursor->block;
+        it.offset = cursor->offset;
+        skip = 0;
+    }
+    while ((ret = ext2_dir_next(&it, &de)) > 0) {
+        if (!ext2_dirent_visible(de)) continue;
+        if (skip == 0) break;
+        skip--;
+    }
+    if (ret <= 0) {
+        ext2_dir_done(&it);
+        return ret;
+    }
+
+    if (cursor) {
+        cursor->version = node->version;
+        cursor->index = index;
+        cursor->block = it.block;
+        cursor->offset = it.offset;
+    }
+
+    out->ino = de->inode;
+    out->type = ext2_dirent_type(info, de);
+    memcpy(out->name, de->name, de->name_len);
+    out->name[de->name_len] = '\0';
+    ext2_dir_done(&it);
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Superblock
+// ---------------------------------------------------------------------------
+
+static void ext2_evict_inode(vfs_inode_t* inode) {
+    struct ext2_node* node = inode->private;
+    if (!node) return;
+
+    struct ext2_info* info = inode->sb->fs_info;
+    if (inode->nlink == 0 && info && ext2_writable(info)) {
+        bool dir = ext2_is_dir(&node->raw);
+        if (!ext2_inline_symlink(&node->raw)) ext2_free_blocks_from(inode, 0);
+        node->raw.i_dtime = ext2_now();
+        node->huge = false;
+        inode->size = 0;
+        ext2_write_inode(inode);
+        ext2_free_inode(info, inode->ino, dir);
+    }
+    ext2_index_free(node);
+    kfree(node);
+    inode->private = NULL;
+}
+
+static int ext2_sync(vfs_superblock_t* sb) {
+    struct ext2_info* info = sb->fs_info;
+    if (!ext2_writable(info)) return 0;
+
+    info->es->s_wtime = ext2_now();
+    bcache_mark_dirty(info->sb_buf);
+    return bcache_sync(info->dev);
+}
+
+static void ext2_put_super(vfs_superblock_t* sb) {
+    struct ext2_info* info = sb->fs_info;
+
+    if (ext2_writable(info)) {
+        info->es->s_state = info->mount_state;
+        ext2_sync(sb);
+    }
+    for (uint32_t i = 0; i < info->gd_blocks; i++) bcache_release(info->gd_bufs[i]);
+    bcache_release(info->sb_buf);
+    bcache_invalidate(info->dev);
+    vmm_free_page((uint32_t*)info->bounce);
+    kfree(info->gd_bufs);
+    kfree(info);
+    sb->fs_info = NULL;
+}
+
+// Check the superblock copy read at mount and fill in the geometry
+static int ext2_read_super(struct ext2_info* info, const struct ext2_super* es, uint32_t* flags) {
+    if (es->s_magic != EXT2_SUPER_MAGIC || es->s_log_block_size > EXT2_MAX_BLOCK_LOG) return -EINVAL;
+
+    info->block_size = 1024 << es->s_log_block_size;
+    info->sectors_per_block = info->block_size / BLK_SECTOR_SIZE;
+    info->addr_per_block = info->block_size / 4;
+    info->addr_shift = 8 + es->s_log_block_size;
+    info->first_data_block = es->s_first_data_block;
+    info->blocks_count = es->s_blocks_count;
+    info->blocks_per_group = es->s_blocks_per_group;
+    info->inodes_per_group = es->s_inodes_per_group;
+    info->desc_per_block = info->block_size / sizeof(struct ext2_group_desc);
+
+    if (es->s_rev_level == EXT2_GOOD_OLD_REV) {
+        info->inode_size = EXT2_GOOD_OLD_INODE_SIZE;
+        info->first_ino = EXT2_GOOD_OLD_FIRST_INO;
+    } else {
+        info->inode_size = es->s_inode_size;
+        info->first_ino = es->s_first_ino;
+        if (es->s_feature_incompat & ~EXT2_INCOMPAT_SUPPORTED) return -EINVAL;
+        if (es->s_feature_ro_compat & ~EXT2_RO_COMPAT_SUPPORTED) *flags |= VFS_MNT_RDONLY;
+        info->filetype = es->s_feature_incompat & EXT2_FEATURE_INCOMPAT_FILETYPE;
+    }
+
+    uint32_t bits = info->block_size * 8;
+    if (info->blocks_per_group == 0 || info->blocks_per_group > bits ||
+        info->inodes_per_group == 0 || info->inodes_per_group > bits ||
+        info->inode_size < EXT2_GOOD_OLD_INODE_SIZE || info->inode_size > info->block_size ||
+        (info->inode_size & (info->inode_size - 1)) || info->first_ino <= EXT2_ROOT_INO ||
+        info->first_data_block >= info->blocks_count) {
+        return -EINVAL;
+    }
+    if ((uint64_t)info->blocks_count * info->sectors_per_block > info->dev->sectors) return -EINVAL;
+
+    uint32_t data_blocks = info->blocks_count - info->first_data_block;
+    info->groups = data_blocks / info->blocks_per_group + (data_blocks % info->blocks_per_group ? 1 : 0);
+    info->gd_blocks = (info->groups + info->desc_per_block - 1) / info->desc_per_block;
+    if ((uint64_t)info->groups * info->inodes_per_group < es->s_inodes_count) return -EINVAL;
+    return 0;
+}
+
+static int ext2_mount(const char* source, uint32_t flags, vfs_superblock_t* sb) {
+    blkdev_t* dev = source ? blkdev_find(source) : NULL;
+    if (!dev) return -ENODEV;
+    if (dev->sector_size != BLK_SECTOR_SIZE) return -EINVAL;
+
+    struct ext2_info* info = kzalloc(sizeof(struct ext2_info));
+    struct ext2_super* copy = kmalloc(sizeof(struct ext2_super) > 1024 ? sizeof(struct ext2_super) : 1024);
+    if (!info || !copy) {
+        kfree(info);
+        kfree(copy);
+        return -ENOMEM;
+    }
+    info->dev = dev;
+
+    // The block size is only known once the superblock has been read
+    int err = blkdev_read(dev, EXT2_SUPER_OFFSET / BLK_SECTOR_SIZE, 1024 / BLK_SECTOR_SIZE, copy);
+    if (!err) err = ext2_read_super(info, copy, &sb->flags);
+    kfree(copy);
+    info->writable = !(sb->flags & VFS_MNT_RDONLY);
+    (void)flags;
+
+    // Superblock and group descriptors stay referenced while mounted
+    if (!err) {
+        uint32_t block = EXT2_SUPER_OFFSET / info->block_size;
+        err = bcache_read(dev, block, info->block_size, &info->sb_buf);
+        if (!err) info->es = (struct ext2_super*)(info->sb_buf->data + EXT2_SUPER_OFFSET % info->block_size);
+    }
+    if (!err) {
+        info->gd_bufs = kzalloc(info->gd_blocks * sizeof(buffer_t*));
+        if (!info->gd_bufs) err = -ENOMEM;
+    }
+    for (uint32_t i = 0; !err && i < info->gd_blocks; i++) {
+        err = bcache_read(dev, info->first_data_block + 1 + i, info->block_size, &info->gd_bufs[i]);
+    }
+    if (!err) {
+        info->bounce = (uint8_t*)vmm_alloc_page();
+        if (!info->bounce) err = -ENOMEM;
+    }
+
+    if (!err) {
+        sb->fs_info = info;
+        err = ext2_iget(sb, EXT2_ROOT_INO, &sb->root);
+        if (!err && sb->root->type != VFS_TYPE_DIR) {
+            vfs_inode_put(sb->root);
+            sb->root = NULL;
+            err = -EINVAL;
+        }
+    }
+
+    if (err) {
+        if (info->bounce) vmm_free_page((uint32_t*)info->bounce);
+        for (uint32_t i = 0; info->gd_bufs && i < info->gd_blocks; i++) bcache_release(info->gd_bufs[i]);
+        kfree(info->gd_bufs);
+        bcache_release(info->sb_buf);
+        bcache_invalidate(dev);
+        kfree(info);
+        sb->fs_info = NULL;
+        return err;
+    }
+
+    // Marked not clean until unmounted, as Linux does
+    if (info->writable) {
+        info->mount_state = info->es->s_state;
+        info->es->s_state &= ~EXT2_VALID_FS;
+        info->es->s_mtime = ext2_now();
+        info->es->s_mnt_count++;
+        bcache_mark_dirty(info->sb_buf);
+    }
+
+    sb->s_op = &ext2_super_ops;
+    sb->block_size = info->block_size;
+    return 0;
+}
+
+static const vfs_inode_ops_t ext2_inode_ops = {
+    .lookup = ext2_lookup,
+    .create = ext2_create,
+    .unlink = ext2_unlink,
+    .truncate = ext2_truncate,
+};
+
+static const vfs_file_ops_t ext2_file_ops = {
+    .open = ext2_open,
+    .release = ext2_release,
+    .write = ext2_write,
+    .readdir = ext2_readdir,
+    .readpages = ext2_readpages,
+};
+
+static const vfs_super_ops_t ext2_super_ops = {
+    .evict_inode = ext2_evict_inode,
+    .put_super = ext2_put_super,
+    .sync = ext2_sync,
+};
+
+static vfs_fs_type_t ext2_type = {
+    .name = "ext2",
+    .mount = ext2_mount,
+};
+
+void ext2_init(void) {
+    vfs_register_filesystem(&ext2_type);
+}
+
+void ext2_get_stats(ext2_stats_t* out) {
+    *out = stats;
+}
+
+void ext2_reset_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,1473 @@
+/**
+ * FAT32 - Bunix OS
+ *
+ * Read/write FAT32 on a whole-disk block device or its first FAT32
+ * partition, as produced by mtools. FAT and directory sectors go through
+ * the block cache in 512-byte blocks; the FAT sector touched last stays
+ * referenced so walking a chain rarely even hashes. File data bypasses
+ * the cache: on open a file's cluster chain is turned into a list of
+ * contiguous extents, and reads and writes move whole extents at a time
+ * with a few large device requests kept in flight together.
+ *
+ * Directory clusters are only ever read through the cache after being
+ * initialised through it, and are written back before being freed, so the
+ * cached and direct paths never see stale copies of each other's data.
+ *
+ * FAT has no inode numbers; an inode is numbered after the position of
+ * its short directory entry (sector * 16 + slot), the root is 1.
+ */
+
+#include "../include/fs/vfs.h"
+#include "../include/fs/dcache.h"
+#include "../include/fs/fat32.h"
+#include "../include/block/blkdev.h"
+#include "../include/block/bcache.h"
+#include "../include/kernel/rtc/rtc.h"
+#include "../include/mm/vmm.h"
+#include "../include/mm/kmalloc.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+
+#define FAT_SECTOR_SIZE      512
+#define FAT_DIRENT_SIZE      32
+#define FAT_DIRENTS_PER_SEC  (FAT_SECTOR_SIZE / FAT_DIRENT_SIZE)
+#define FAT_MAX_DIRENTS      65536
+#define FAT_ROOT_INO         1
+
+#define FAT_ENTRY_MASK       0x0FFFFFFF
+#define FAT_ENTRY_BAD        0x0FFFFFF7
+#define FAT_ENTRY_EOC        0x0FFFFFF8   // This and above end a chain
+#define FAT_ENTRY_EOC_MARK   0x0FFFFFFF
+#define FAT_FREE_UNKNOWN     0xFFFFFFFF
+
+#define FAT_IO_BATCH         8            // Data requests in flight together
+#define FAT_BOUNCE_SECTORS   (PAGE_SIZE / FAT_SECTOR_SIZE)
+
+#define FAT_ATTR_READ_ONLY   0x01
+#define FAT_ATTR_HIDDEN      0x02
+#define FAT_ATTR_SYSTEM      0x04
+#define FAT_ATTR_VOLUME_ID   0x08
+#define FAT_ATTR_DIRECTORY   0x10
+#define FAT_ATTR_ARCHIVE     0x20
+#define FAT_ATTR_LFN         0x0F
+
+#define FAT_NTRES_LOWER_BASE 0x08
+#define FAT_NTRES_LOWER_EXT  0x10
+
+#define FAT_LFN_LAST         0x40
+#define FAT_LFN_CHARS        13
+#define FAT_LFN_MAX_ENTRIES  20           // 255 characters
+
+#define FAT_DELETED          0xE5
+
+struct fat_dirent {
+    uint8_t name[11];
+    uint8_t attr;
+    uint8_t ntres;
+    uint8_t crt_time_tenth;
+    uint16_t crt_time;
+    uint16_t crt_date;
+    uint16_t acc_date;
+    uint16_t cluster_hi;
+    uint16_t wrt_time;
+    uint16_t wrt_date;
+    uint16_t cluster_lo;
+    uint32_t size;
+} __attribute__((packed));
+
+struct fat_lfn {
+    uint8_t ord;
+    uint16_t name1[5];
+    uint8_t attr;
+    uint8_t type;
+    uint8_t checksum;
+    uint16_t name2[6];
+    uint16_t cluster_lo;
+    uint16_t name3[2];
+} __attribute__((packed));
+
+struct fat_info {
+    blkdev_t* dev;
+    uint32_t sectors_per_cluster;
+    uint32_t cluster_bytes;
+    uint32_t fat_start;             // Absolute sector of the first FAT
+    uint32_t fat_sectors;           // Per copy
+    uint32_t num_fats;
+    int32_t active_fat;             // Only copy in use, -1 when mirrored
+    uint32_t data_start;            // Absolute sector of cluster 2
+    uint32_t clusters;              // Valid cluster numbers: 2 .. clusters + 1
+    uint32_t root_cluster;
+    uint32_t fsinfo_sector;         // Absolute, 0 without FSInfo
+    uint32_t free_count;
+    uint32_t next_free;
+    bool fsinfo_dirty;
+    buffer_t* fat_buf;              // FAT sector touched last
+    uint8_t* bounce;                // Partial sectors and zero fill
+};
+
+// Clusters file_cluster .. file_cluster + count - 1 are contiguous on disk
+struct fat_extent {
+    uint32_t file_cluster;
+    uint32_t disk_cluster;
+    uint32_t count;
+};
+
+struct fat_node {
+    uint32_t first_cluster;         // 0 for an empty file
+    uint32_t dirent_sector;         // Short entry location, 0 for the root
+    uint16_t dirent_offset;
+    bool mapped;                    // Extents cover the whole chain
+    struct fat_extent* extents;
+    uint32_t nextents;
+    uint32_t max_extents;
+    uint32_t nclusters;
+    uint32_t version;               // Directories: bumped when entries go away
+};
+
+// readdir position cached per open directory
+struct fat_cursor {
+    uint32_t version;
+    uint32_t index;                 // Visible entry returned last
+    uint32_t next_slot;             // Slot just past it
+};
+
+// Walks a directory's slots holding at most one cached sector
+struct fat_dir_iter {
+    vfs_inode_t* dir;
+    uint32_t slot;
+    buffer_t* buf;
+};
+
+// A directory entry with its long name put back together
+struct fat_entry {
+    char name[VFS_NAME_MAX + 1];
+    uint32_t first_slot;            // First LFN slot, or the short entry
+    uint32_t slot;                  // Short entry
+    uint32_t sector;                // Absolute sector of the short entry
+    uint16_t offset;
+    struct fat_dirent de;
+};
+
+static fat32_stats_t stats;
+
+static const vfs_inode_ops_t fat_inode_ops;
+static const vfs_file_ops_t fat_file_ops;
+static const vfs_super_ops_t fat_super_ops;
+
+static inline uint16_t le16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void put_le32(uint8_t* p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static inline char fat_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static inline char fat_upper(char c) {
+    return (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+}
+
+static bool fat_name_equal(const char* a, const char* b, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (fat_lower(a[i]) != fat_lower(b[i])) return false;
+    }
+    return a[len] == '\0';
+}
+
+static inline uint32_t fat_cluster_lba(const struct fat_info* info, uint32_t cluster) {
+    return info->data_start + (cluster - 2) * info->sectors_per_cluster;
+}
+
+static inline bool fat_cluster_valid(const struct fat_info* info, uint32_t cluster) {
+    return cluster >= 2 && cluster < info->clusters + 2;
+}
+
+static inline uint32_t fat_dirent_cluster(const struct fat_dirent* de) {
+    return ((uint32_t)de->cluster_hi << 16) | de->cluster_lo;
+}
+
+static uint32_t fat_clusters_for(const struct fat_info* info, uint32_t bytes) {
+    return bytes / info->cluster_bytes + (bytes % info->cluster_bytes ? 1 : 0);
+}
+
+static void fat_timestamp(uint16_t* date, uint16_t* time) {
+    struct rtc_date now;
+    rtc_read_full(&now);
+
+    uint32_t year = now.year < 1980 ? 0 : now.year - 1980;
+    uint32_t hour = now.hour & 0x7F;
+    if (!now.is_24hour) hour = (hour % 12) + (now.is_pm ? 12 : 0);
+    *date = (year << 9) | (now.month << 5) | now.day;
+    *time = (hour << 11) | (now.minute << 5) | (now.second / 2);
+}
+
+// ---------------------------------------------------------------------------
+// File allocation table
+// ---------------------------------------------------------------------------
+
+// Cached sector of the table, kept referenced until another is needed
+static uint8_t* fat_table_sector(struct fat_info* info, uint32_t sector) {
+    if (info->fat_buf && info->fat_buf->block == sector) return info->fat_buf->data;
+
+    buffer_t* buf;
+    if (bcache_read(info->dev, sector, FAT_SECTOR_SIZE, &buf) != 0) return NULL;
+    if (info->fat_buf) bcache_release(info->fat_buf);
+    info->fat_buf = buf;
+    return buf->data;
+}
+
+static int fat_get(struct fat_info* info, uint32_t cluster, uint32_t* value) {
+    uint32_t copy = info->active_fat < 0 ? 0 : info->active_fat;
+    uint32_t sector = info->fat_start + copy * info->fat_sectors + cluster / (FAT_SECTOR_SIZE / 4);
+
+    uint8_t* data = fat_table_sector(info, sector);
+    if (!data) return -EIO;
+    *value = le32(data + (cluster % (FAT_SECTOR_SIZE / 4)) * 4) & FAT_ENTRY_MASK;
+    return 0;
+}
+
+// Update every copy of the table (just the active one when not mirrored)
+static int fat_set(struct fat_info* info, uint32_t cluster, uint32_t value) {
+    uint32_t offset = (cluster % (FAT_SECTOR_SIZE / 4)) * 4;
+
+    for (uint32_t copy = 0; copy < info->num_fats; copy++) {
+        if (info->active_fat >= 0 && copy != (uint32_t)info->active_fat) continue;
+
+        uint32_t sector = info->fat_start + copy * info->fat_sectors + cluster / (FAT_SECTOR_SIZE / 4);
+        uint8_t* data = fat_table_sector(info, sector);
+        if (!data) return -EIO;
+
+        // The top four bits are reserved and must be preserved
+        uint32_t old = le32(data + offset);
+        put_le32(data + offset, (old & ~FAT_ENTRY_MASK) | (value & FAT_ENTRY_MASK));
+        bcache_mark_dirty(info->fat_buf);
+    }
+    return 0;
+}
+
+static int fat_alloc_cluster(struct fat_info* info, uint32_t hint, uint32_t* out) {
+    if (info->free_count == 0) return -ENOSPC;
+
+    uint32_t cluster = fat_cluster_valid(info, hint) ? hint : info->next_free;
+    for (uint32_t n = 0; n < info->clusters; n++, cluster++) {
+        if (!fat_cluster_valid(info, cluster)) cluster = 2;
+
+        uint32_t value;
+        int err = fat_get(info, cluster, &value);
+        if (err) return err;
+        if (value != 0) continue;
+
+        err = fat_set(info, cluster, FAT_ENTRY_EOC_MARK);
+        if (err) return err;
+        if (info->free_count != FAT_FREE_UNKNOWN) info->free_count--;
+        info->next_free = cluster + 1;
+        info->fsinfo_dirty = true;
+        *out = cluster;
+        return 0;
+    }
+    info->free_count = 0;
+    return -ENOSPC;
+}
+
+static int fat_free_chain(struct fat_info* info, uint32_t cluster) {
+    uint32_t freed = 0;
+
+    while (fat_cluster_valid(info, cluster) && freed < info->clusters) {
+        uint32_t next;
+        int err = fat_get(info, cluster, &next);
+        if (!err) err = fat_set(info, cluster, 0);
+        if (err) return err;
+
+        if (info->free_count != FAT_FREE_UNKNOWN) info->free_count++;
+        if (cluster < info->next_free) info->next_free = cluster;
+        info->fsinfo_dirty = true;
+        freed++;
+        cluster = next;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Extent lists
+// ---------------------------------------------------------------------------
+
+static int fat_extent_append(struct fat_node* node, uint32_t disk_cluster) {
+    struct fat_extent* last = node->nextents ? &node->extents[node->nextents - 1] : NULL;
+
+    if (last && last->disk_cluster + last->count == disk_cluster) {
+        last->count++;
+    } else {
+        if (node->nextents == node->max_extents) {
+            uint32_t max = node->max_extents ? node->max_extents * 2 : 4;
+            struct fat_extent* extents = krealloc(node->extents, max * sizeof(*extents));
+            if (!extents) return -ENOMEM;
+            node->extents = extents;
+            node->max_extents = max;
+        }
+        last = &node->extents[node->nextents++];
+        last->file_cluster = node->nclusters;
+        last->disk_cluster = disk_cluster;
+        last->count = 1;
+    }
+    node->nclusters++;
+    return 0;
+}
+
+// Walk the cluster chain once and keep it as extents
+static int fat_map(vfs_inode_t* inode) {
+    struct fat_node* node = inode->private;
+    struct fat_info* info = inode->sb->fs_info;
+    if (node->mapped) return 0;
+
+    node->nextents = 0;
+    node->nclusters = 0;
+    uint32_t cluster = node->first_cluster;
+    while (cluster && cluster < FAT_ENTRY_EOC) {
+        if (!fat_cluster_valid(info, cluster) || node->nclusters >= info->clusters) return -EIO;
+
+        int err = fat_extent_append(node, cluster);
+        if (!err) err = fat_get(info, cluster, &cluster);
+        if (err) return err;
+    }
+
+    node->mapped = true;
+    stats.chains_mapped++;
+    stats.extents += node->nextents;
+    stats.clusters += node->nclusters;
+    return 0;
+}
+
+// Disk cluster backing a file cluster and how many follow it contiguously
+static int fat_bmap(struct fat_node* node, uint32_t file_cluster, uint32_t* disk, uint32_t* run) {
+    uint32_t lo = 0;
+    uint32_t hi = node->nextents;
+
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        struct fat_extent* e = &node->extents[mid];
+        if (file_cluster < e->file_cluster) {
+            hi = mid;
+        } else if (file_cluster >= e->file_cluster + e->count) {
+            lo = mid + 1;
+        } else {
+            *disk = e->disk_cluster + (file_cluster - e->file_cluster);
+            *run = e->count - (file_cluster - e->file_cluster);
+            return 0;
+        }
+    }
+    return -EIO;
+}
+
+static int fat_update_dirent(vfs_inode_t* inode);
+
+// Grow the chain to at least 'clusters', preferring the cluster right
+// after the current end so the file stays in one extent
+static int fat_extend(vfs_inode_t* inode, uint32_t clusters) {
+    struct fat_node* node = inode->private;
+    struct fat_info* info = inode->sb->fs_info;
+
+    int err = fat_map(inode);
+    if (err) return err;
+
+    bool new_first = false;
+    while (node->nclusters < clusters) {
+        uint32_t last = 0;
+        if (node->nextents) {
+            struct fat_extent* e = &node->extents[node->nextents - 1];
+            last = e->disk_cluster + e->count - 1;
+        }
+
+        uint32_t cluster;
+        err = fat_alloc_cluster(info, last ? last + 1 : info->next_free, &cluster);
+        if (err) break;
+
+        err = fat_extent_append(node, cluster);
+        if (err) {
+            fat_set(info, cluster, 0);
+            break;
+        }
+        if (last) {
+            err = fat_set(info, last, cluster);
+            if (err) break;
+        } else {
+            node->first_cluster = cluster;
+            new_first = true;
+        }
+    }
+
+    if (new_first) {
+        int derr = fat_update_dirent(inode);
+        if (!err) err = derr;
+    }
+    return err;
+}
+
+// Keep the first 'clusters' clusters and free the rest
+static int fat_shrink(vfs_inode_t* inode, uint32_t clusters) {
+    struct fat_node* node = inode->private;
+    struct fat_info* info = inode->sb->fs_info;
+
+    int err = fat_map(inode);
+    if (err) return err;
+    if (clusters >= node->nclusters) return 0;
+
+    uint32_t first_freed;
+    if (clusters == 0) {
+        first_freed = node->first_cluster;
+        node->first_cluster = 0;
+    } else {
+        uint32_t last, run;
+        err = fat_bmap(node, clusters - 1, &last, &run);
+        if (!err) err = fat_get(info, last, &first_freed);
+        if (!err) err = fat_set(info, last, FAT_ENTRY_EOC_MARK);
+        if (err) return err;
+    }
+
+    while (node->nextents && node->extents[node->nextents - 1].file_cluster >= clusters) node->nextents--;
+    if (node->nextents) {
+        struct fat_extent* e = &node->extents[node->nextents - 1];
+        e->count = clusters - e->file_cluster;
+    }
+    node->nclusters = clusters;
+    return fat_free_chain(info, first_freed);
+}
+
+// ---------------------------------------------------------------------------
+// Data transfer
+// ---------------------------------------------------------------------------
+
+// Move sectors between memory and the device, as requests of up to
+// max_sectors handed to the request queue together
+static int fat_io(struct fat_info* info, uint32_t op, uint32_t lba, uint32_t count, uint8_t* buf) {
+    blkdev_t* dev = info->dev;
+    blk_request_t reqs[FAT_IO_BATCH];
+
+    while (count > 0) {
+        blk_plug_t plug;
+        int n = 0;
+        int err = 0;
+
+        blk_start_plug(&plug);
+        while (n < FAT_IO_BATCH && count > 0) {
+            uint32_t chunk = count < dev->max_sectors ? count : dev->max_sectors;
+            memset(&reqs[n], 0, sizeof(reqs[n]));
+            reqs[n].dev = dev;
+            reqs[n].op = op;
+            reqs[n].lba = lba;
+            reqs[n].count = chunk;
+            reqs[n].buffer = buf;
+
+            err = blkdev_submit(&reqs[n]);
+            if (err) break;
+            n++;
+            lba += chunk;
+            count -= chunk;
+            buf += chunk * FAT_SECTOR_SIZE;
+            stats.data_requests++;
+            stats.data_sectors += chunk;
+        }
+        blk_finish_plug(&plug);
+
+        for (int i = 0; i < n; i++) {
+            blkdev_wait(&reqs[i]);
+            if (reqs[i].status && !err) err = reqs[i].status;
+        }
+        if (err) return err;
+    }
+    return 0;
+}
+
+/*
+ * Copy file data between buf and the disk; the clusters must exist.
+ * Whole sectors move straight to or from buf, as far as the extent
+ * reaches. Partial sectors and odd buffers go through the bounce page.
+ * buf == NULL writes zeros.
+ */
+static int fat_transfer(vfs_inode_t* inode, uint32_t op, uint8_t* buf, size_t count, vfs_off_t offset) {
+    struct fat_node* node = inode->private;
+    struct fat_info* info = inode->sb->fs_info;
+    uint8_t* bounce = info->bounce;
+    size_t done = 0;
+
+    while (done < count) {
+        uint32_t pos = offset + done;
+        uint32_t disk, run;
+        int err = fat_bmap(node, pos / info->cluster_bytes, &disk, &run);
+        if (err) return err;
+
+        uint32_t in_cluster = pos % info->cluster_bytes;
+        uint32_t lba = fat_cluster_lba(info, disk) + in_cluster / FAT_SECTOR_SIZE;
+        uint32_t sectors = run * info->sectors_per_cluster - in_cluster / FAT_SECTOR_SIZE;
+        uint32_t in_sector = pos % FAT_SECTOR_SIZE;
+        size_t left = count - done;
+
+        if (in_sector == 0 && left >= FAT_SECTOR_SIZE && buf && ((uint32_t)(buf + done) & 1) == 0) {
+            uint32_t n = left / FAT_SECTOR_SIZE < sectors ? left / FAT_SECTOR_SIZE : sectors;
+            err = fat_io(info, op, lba, n, buf + done);
+            if (err) return err;
+            done += n * FAT_SECTOR_SIZE;
+            continue;
+        }
+
+        uint32_t n = sectors < FAT_BOUNCE_SECTORS ? sectors : FAT_BOUNCE_SECTORS;
+        size_t chunk = n * FAT_SECTOR_SIZE - in_sector;
+        if (chunk > left) chunk = left;
+        n = (in_sector + chunk + FAT_SECTOR_SIZE - 1) / FAT_SECTOR_SIZE;
+
+        if (op == BLK_OP_READ) {
+            err = fat_io(info, BLK_OP_READ, lba, n, bounce);
+            if (err) return err;
+            memcpy(buf + done, bounce + in_sector, chunk);
+        } else {
+            // Keep the rest of partially written sectors
+            if (in_sector) err = fat_io(info, BLK_OP_READ, lba, 1, bounce);
+            if (!err && (in_sector + chunk) % FAT_SECTOR_SIZE && !(n == 1 && in_sector)) {
+                err = fat_io(info, BLK_OP_READ, lba + n - 1, 1, bounce + (n - 1) * FAT_SECTOR_SIZE);
+            }
+            if (err) return err;
+
+            if (buf) memcpy(bounce + in_sector, buf + done, chunk);
+            else memset(bounce + in_sector, 0, chunk);
+            err = fat_io(info, BLK_OP_WRITE, lba, n, bounce);
+            if (err) return err;
+        }
+        done += chunk;
+    }
+    return done;
+}
+
+// ---------------------------------------------------------------------------
+// Directories
+// ---------------------------------------------------------------------------
+
+// Slot 'slot' of the directory; 0 past the end of its chain
+static int fat_dir_slot(struct fat_dir_iter* it, uint32_t slot, uint8_t** entry, uint32_t* sector_out) {
+    struct fat_node* node = it->dir->private;
+    struct fat_info* info = it->dir->sb->fs_info;
+
+    if (slot >= FAT_MAX_DIRENTS) return 0;
+    int err = fat_map(it->dir);
+    if (err) return err;
+
+    uint32_t byte = slot * FAT_DIRENT_SIZE;
+    uint32_t file_cluster = byte / info->cluster_bytes;
+    if (file_cluster >= node->nclusters) return 0;
+
+    uint32_t disk, run;
+    err = fat_bmap(node, file_cluster, &disk, &run);
+    if (err) return err;
+    uint32_t sector = fat_cluster_lba(info, disk) + (byte % info->cluster_bytes) / FAT_SECTOR_SIZE;
+
+    if (!it->buf || it->buf->block != sector) {
+        if (it->buf) bcache_release(it->buf);
+        it->buf = NULL;
+        err = bcache_read(info->dev, sector, FAT_SECTOR_SIZE, &it->buf);
+        if (err) return err;
+    }
+    *entry = it->buf->data + byte % FAT_SECTOR_SIZE;
+    if (sector_out) *sector_out = sector;
+    return 1;
+}
+
+static void fat_dir_done(struct fat_dir_iter* it) {
+    if (it->buf) bcache_release(it->buf);
+    it->buf = NULL;
+}
+
+static uint8_t fat_lfn_checksum(const uint8_t* short_name) {
+    uint8_t sum = 0;
+    for (int i = 0; i < 11; i++) sum = ((sum & 1) << 7) + (sum >> 1) + short_name[i];
+    return sum;
+}
+
+static void fat_short_to_name(const struct fat_dirent* de, char* out) {
+    int n = 0;
+    for (int i = 0; i < 8 && de->name[i] != ' '; i++) {
+        char c = (i == 0 && de->name[0] == 0x05) ? (char)FAT_DELETED : de->name[i];
+        out[n++] = (de->ntres & FAT_NTRES_LOWER_BASE) ? fat_lower(c) : c;
+    }
+    if (de->name[8] != ' ') {
+        out[n++] = '.';
+        for (int i = 8; i < 11 && de->name[i] != ' '; i++) {
+            out[n++] = (de->ntres & FAT_NTRES_LOWER_EXT) ? fat_lower(de->name[i]) : de->name[i];
+        }
+    }
+    out[n] = '\0';
+}
+
+static bool fat_is_dot_entry(const struct fat_dirent* de) {
+    return de->name[0] == '.' && (de->name[1] == ' ' || (de->name[1] == '.' && de->name[2] == ' '));
+}
+
+/*
+ * Next visible entry at or after it->slot, skipping deleted slots, the
+ * volume label and "." / "..". Long names that don't fit VFS_NAME_MAX or
+ * aren't plain ASCII fall back to the short name. Returns 1 when *out
+ * was filled, 0 at the end of the directory.
+ */
+static int fat_dir_next(struct fat_dir_iter* it, struct fat_entry* out) {
+    uint16_t lfn[FAT_LFN_MAX_ENTRIES * FAT_LFN_CHARS];
+    uint32_t lfn_expect = 0;        // Ordinal of the next LFN slot, 0 if none pending
+    uint32_t lfn_count = 0;
+    bool lfn_complete = false;
+    uint32_t lfn_start = 0;
+    uint8_t lfn_sum = 0;
+
+    for (;; it->slot++) {
+        uint8_t* raw;
+        uint32_t sector;
+        int ret = fat_dir_slot(it, it->slot, &raw, &sector);
+        if (ret <= 0) return ret;
+
+        if (raw[0] == 0x00) return 0;
+        if (raw[0] == FAT_DELETED) {
+            lfn_expect = 0;
+            lfn_complete = false;
+            continue;
+        }
+
+        if ((raw[11] & 0x3F) == FAT_ATTR_LFN) {
+            struct fat_lfn* l = (struct fat_lfn*)raw;
+            uint32_t ord = l->ord & 0x1F;
+            lfn_complete = false;
+            if (l->ord & FAT_LFN_LAST) {
+                if (ord == 0 || ord > FAT_LFN_MAX_ENTRIES) {
+                    lfn_expect = 0;
+                    continue;
+                }
+                lfn_count = ord;
+                lfn_start = it->slot;
+                lfn_sum = l->checksum;
+                lfn_expect = ord;
+            } else if (!lfn_expect || ord != lfn_expect || l->checksum != lfn_sum) {
+                lfn_expect = 0;
+                continue;
+            }
+
+            uint16_t* dst = &lfn[(ord - 1) * FAT_LFN_CHARS];
+            for (int i = 0; i < 5; i++) *dst++ = l->name1[i];
+            for (int i = 0; i < 6; i++) *dst++ = l->name2[i];
+            for (int i = 0; i < 2; i++) *dst++ = l->name3[i];
+            lfn_complete = --lfn_expect == 0;
+            continue;
+        }
+
+        struct fat_dirent* de = (struct fat_dirent*)raw;
+        bool have_lfn = lfn_complete && lfn_sum == fat_lfn_checksum(de->name);
+        lfn_expect = 0;
+        lfn_complete = false;
+        if ((de->attr & FAT_ATTR_VOLUME_ID) || fat_is_dot_entry(de)) continue;
+
+        if (have_lfn) {
+            uint32_t n = 0;
+            for (; n < lfn_count * FAT_LFN_CHARS && lfn[n] != 0; n++) {
+                if (n >= VFS_NAME_MAX || lfn[n] > 0x7E || lfn[n] < 0x20) {
+                    have_lfn = false;
+                    break;
+                }
+                out->name[n] = (char)lfn[n];
+            }
+            out->name[n] = '\0';
+            if (n == 0) have_lfn = false;
+        }
+        if (!have_lfn) fat_short_to_name(de, out->name);
+
+        out->first_slot = have_lfn ? lfn_start : it->slot;
+        out->slot = it->slot;
+        out->sector = sector;
+        out->offset = raw - it->buf->data;
+        memcpy(&out->de, de, sizeof(out->de));
+        it->slot++;
+        return 1;
+    }
+}
+
+static int fat_find(vfs_inode_t* dir, const char* name, size_t len, struct fat_entry* out) {
+    struct fat_dir_iter it = { .dir = dir };
+    int ret;
+
+    while ((ret = fat_dir_next(&it, out)) > 0) {
+        char short_name[13];
+        fat_short_to_name(&out->de, short_name);
+        if (fat_name_equal(out->name, name, len) || fat_name_equal(short_name, name, len)) break;
+    }
+    fat_dir_done(&it);
+    if (ret < 0) return ret;
+    return ret ? 0 : -ENOENT;
+}
+
+static vfs_inode_t* fat_iget(vfs_superblock_t* sb, const struct fat_entry* e) {
+    uint32_t ino = e->sector * FAT_DIRENTS_PER_SEC + e->offset / FAT_DIRENT_SIZE;
+    vfs_inode_t* inode = vfs_inode_find(sb, ino);
+    if (inode && inode->nlink) return inode;
+
+    // A deleted file still open elsewhere keeps the number of its old
+    // slot; the new inode is hashed in front of it
+    vfs_inode_put(inode);
+
+    struct fat_info* info = sb->fs_info;
+    struct fat_node* node = kzalloc(sizeof(struct fat_node));
+    if (!node) return NULL;
+    inode = vfs_inode_alloc(sb, ino);
+    if (!inode) {
+        kfree(node);
+        return NULL;
+    }
+
+    node->first_cluster = fat_dirent_cluster(&e->de);
+    node->dirent_sector = e->sector;
+    node->dirent_offset = e->offset;
+
+    bool dir = e->de.attr & FAT_ATTR_DIRECTORY;
+    inode->type = dir ? VFS_TYPE_DIR : VFS_TYPE_FILE;
+    inode->mode = dir ? 0755 : ((e->de.attr & FAT_ATTR_READ_ONLY) ? 0444 : 0644);
+    inode->nlink = dir ? 2 : 1;
+    inode->size = dir ? 0 : e->de.size;
+    inode->blocks = fat_clusters_for(info, inode->size) * info->sectors_per_cluster;
+    inode->i_op = &fat_inode_ops;
+    inode->f_op = &fat_file_ops;
+    inode->private = node;
+    return inode;
+}
+
+// Write size, first cluster and modification time back to the entry
+static int fat_update_dirent(vfs_inode_t* inode) {
+    struct fat_node* node = inode->private;
+    struct fat_info* info = inode->sb->fs_info;
+
+    inode->blocks = node->nclusters * info->sectors_per_cluster;
+    if (!node->dirent_sector || inode->nlink == 0) return 0;
+
+    buffer_t* buf;
+    int err = bcache_read(info->dev, node->dirent_sector, FAT_SECTOR_SIZE, &buf);
+    if (err) return err;
+
+    struct fat_dirent* de = (struct fat_dirent*)(buf->data + node->dirent_offset);
+    uint16_t date, time;
+    fat_timestamp(&date, &time);
+    de->cluster_hi = node->first_cluster >> 16;
+    de->cluster_lo = node->first_cluster & 0xFFFF;
+    de->wrt_date = date;
+    de->wrt_time = time;
+    if (inode->type == VFS_TYPE_FILE) {
+        de->size = inode->size;
+        de->attr |= FAT_ATTR_ARCHIVE;
+    }
+    bcache_mark_dirty(buf);
+    bcache_release(buf);
+    return 0;
+}
+
+static bool fat_short_char(char c) {
+    if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) return true;
+    return c && strchr("$%'-_@~`!(){}^#&", c) != NULL;
+}
+
+static bool fat_valid_name(const char* name, size_t len) {
+    if (len == 0 || len > VFS_NAME_MAX) return false;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = name[i];
+        if (c < 0x20 || c > 0x7E || strchr("\\/:*?\"<>|", c)) return false;
+    }
+    // Trailing dots and spaces are dropped by other implementations
+    return name[len - 1] != '.' && name[len - 1] != ' ';
+}
+
+// Case of the letters in name[0..len): 1 upper, 2 lower, 3 mixed, 0 none
+static int fat_case(const char* name, size_t len) {
+    int seen = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (name[i] >= 'A' && name[i] <= 'Z') seen |= 1;
+        if (name[i] >= 'a' && name[i] <= 'z') seen |= 2;
+    }
+    return seen;
+}
+
+// Does the name fit 8.3 as is, possibly through the lowercase flags?
+static bool fat_exact_short(const char* name, size_t len, uint8_t* short_name, uint8_t* ntres) {
+    const char* dot = NULL;
+    for (size_t i = 0; i < len; i++) {
+        if (name[i] == '.') {
+            if (dot) return false;
+            dot = &name[i];
+        } else if (!fat_short_char(name[i])) {
+            return false;
+        }
+    }
+
+    size_t base_len = dot ? (size_t)(dot - name) : len;
+    size_t ext_len = dot ? len - base_len - 1 : 0;
+    if (base_len == 0 || base_len > 8 || ext_len > 3 || (dot && ext_len == 0)) return false;
+
+    int base_case = fat_case(name, base_len);
+    int ext_case = dot ? fat_case(dot + 1, ext_len) : 0;
+    if (base_case == 3 || ext_case == 3) return false;
+
+    memset(short_name, ' ', 11);
+    for (size_t i = 0; i < base_len; i++) short_name[i] = fat_upper(name[i]);
+    for (size_t i = 0; i < ext_len; i++) short_name[8 + i] = fat_upper(dot[1 + i]);
+    if (short_name[0] == FAT_DELETED) short_name[0] = 0x05;
+
+    *ntres = 0;
+    if (base_case == 2) *ntres |= FAT_NTRES_LOWER_BASE;
+    if (ext_case == 2) *ntres |= FAT_NTRES_LOWER_EXT;
+    return true;
+}
+
+// Short alias for a long name, "BASENA~n.EXT"
+static void fat_alias(const char* name, size_t len, uint32_t n, uint8_t* short_name) {
+    const char* dot = NULL;
+    for (size_t i = 1; i < len; i++) {
+        if (name[i] == '.') dot = &name[i];
+    }
+    size_t base_end = dot ? (size_t)(dot - name) : len;
+
+    memset(short_name, ' ', 11);
+    int base_len = 0;
+    for (size_t i = 0; i < base_end && base_len < 8; i++) {
+        if (name[i] == ' ' || name[i] == '.') continue;
+        short_name[base_len++] = fat_short_char(name[i]) ? fat_upper(name[i]) : '_';
+    }
+    if (dot) {
+        int ext_len = 0;
+        for (const char* p = dot + 1; p < name + len && ext_len < 3; p++) {
+            if (*p == ' ' || *p == '.') continue;
+            short_name[8 + ext_len++] = fat_short_char(*p) ? fat_upper(*p) : '_';
+        }
+    }
+
+    char tail[12];
+    int digits = 0;
+    for (uint32_t v = n; v; v /= 10) digits++;
+    int at = base_len < 7 - digits ? base_len : 7 - digits;
+    if (at < 1) at = 1;
+    tail[0] = '~';
+    for (int i = digits; i > 0; i--, n /= 10) tail[i] = '0' + n % 10;
+    memcpy(short_name + at, tail, digits + 1);
+    if (short_name[0] == ' ') short_name[0] = '_';
+}
+
+static int fat_short_exists(vfs_inode_t* dir, const uint8_t* short_name) {
+    struct fat_dir_iter it = { .dir = dir };
+    struct fat_entry e;
+    int ret;
+
+    while ((ret = fat_dir_next(&it, &e)) > 0) {
+        if (memcmp(e.de.name, short_name, 11) == 0) break;
+    }
+    fat_dir_done(&it);
+    return ret;
+}
+
+// Zero a freshly allocated cluster through the cache
+static int fat_zero_cluster(struct fat_info* info, uint32_t cluster) {
+    uint32_t lba = fat_cluster_lba(info, cluster);
+
+    for (uint32_t i = 0; i < info->sectors_per_cluster; i++) {
+        buffer_t* buf;
+        int err = bcache_get_new(info->dev, lba + i, FAT_SECTOR_SIZE, &buf);
+        if (err) return err;
+        memset(buf->data, 0, FAT_SECTOR_SIZE);
+        bcache_mark_dirty(buf);
+        bcache_release(buf);
+    }
+    return 0;
+}
+
+// First of 'count' consecutive free slots, growing the directory if needed
+static int fat_find_free_slots(vfs_inode_t* dir, uint32_t count, uint32_t* first) {
+    struct fat_node* node = dir->private;
+    struct fat_info* info = dir->sb->fs_info;
+    struct fat_dir_iter it = { .dir = dir };
+    uint32_t run = 0;
+    uint32_t slot;
+    int ret;
+
+    for (slot = 0;; slot++) {
+        uint8_t* raw;
+        ret = fat_dir_slot(&it, slot, &raw, NULL);
+        if (ret <= 0) break;
+        if (raw[0] == 0x00 || raw[0] == FAT_DELETED) {
+            if (++run == count) break;
+        } else {
+            run = 0;
+        }
+    }
+    fat_dir_done(&it);
+    if (ret < 0) return ret;
+    if (ret > 0) {
+        *first = slot + 1 - count;
+        return 0;
+    }
+
+    // Out of slots: add zeroed clusters until the run fits
+    uint32_t per_cluster = info->cluster_bytes / FAT_DIRENT_SIZE;
+    uint32_t needed = fat_clusters_for(info, (count - run) * FAT_DIRENT_SIZE);
+    if (slot + needed * per_cluster > FAT_MAX_DIRENTS) return -ENOSPC;
+
+    uint32_t before = node->nclusters;
+    int err = fat_extend(dir, before + needed);
+    for (uint32_t c = before; c < node->nclusters; c++) {
+        uint32_t disk, r;
+        if (!err) err = fat_bmap(node, c, &disk, &r);
+        if (!err) err = fat_zero_cluster(info, disk);
+    }
+    if (err) return err;
+    *first = slot - run;
+    return 0;
+}
+
+static int fat_write_slot(struct fat_dir_iter* it, uint32_t slot, const void* entry) {
+    uint8_t* raw;
+    int ret = fat_dir_slot(it, slot, &raw, NULL);
+    if (ret <= 0) return ret ? ret : -EIO;
+    memcpy(raw, entry, FAT_DIRENT_SIZE);
+    bcache_mark_dirty(it->buf);
+    return 0;
+}
+
+static void fat_fill_lfn(struct fat_lfn* l, const char* name, size_t len, uint32_t ord, bool last, uint8_t sum) {
+    uint16_t chars[FAT_LFN_CHARS];
+    for (uint32_t i = 0; i < FAT_LFN_CHARS; i++) {
+        size_t at = (ord - 1) * FAT_LFN_CHARS + i;
+        if (at < len) chars[i] = (uint8_t)name[at];
+        else if (at == len) chars[i] = 0x0000;
+        else chars[i] = 0xFFFF;
+    }
+
+    memset(l, 0, sizeof(*l));
+    l->ord = ord | (last ? FAT_LFN_LAST : 0);
+    l->attr = FAT_ATTR_LFN;
+    l->checksum = sum;
+    for (int i = 0; i < 5; i++) l->name1[i] = chars[i];
+    for (int i = 0; i < 6; i++) l->name2[i] = chars[5 + i];
+    for (int i = 0; i < 2; i++) l->name3[i] = chars[11 + i];
+}
+
+// Write the long name slots and the short entry, returning its location
+static int fat_add_entry(vfs_inode_t* dir, const char* name, size_t len, struct fat_dirent* de,
+                         struct fat_entry* out) {
+    uint8_t ntres = 0;
+    bool need_lfn = !fat_exact_short(name, len, de->name, &ntres);
+
+    if (need_lfn) {
+        uint32_t n = 1;
+        int ret;
+        do {
+            fat_alias(name, len, n++, de->name);
+            ret = fat_short_exists(dir, de->name);
+            if (ret < 0) return ret;
+        } while (ret && n < 1000000);
+        if (ret) return -EEXIST;
+    } else {
+        de->ntres = ntres;
+    }
+
+    uint32_t nlfn = need_lfn ? (len + FAT_LFN_CHARS - 1) / FAT_LFN_CHARS : 0;
+    uint32_t first;
+    int err = fat_find_free_slots(dir, nlfn + 1, &first);
+    if (err) return err;
+
+    struct fat_dir_iter it = { .dir = dir };
+    uint8_t sum = fat_lfn_checksum(de->name);
+    for (uint32_t i = 0; i < nlfn && !err; i++) {
+        struct fat_lfn l;
+        uint32_t ord = nlfn - i;
+        fat_fill_lfn(&l, name, len, ord, i == 0, sum);
+        err = fat_write_slot(&it, first + i, &l);
+    }
+    if (!err) err = fat_write_slot(&it, first + nlfn, de);
+    if (!err) {
+        uint8_t* raw;
+        fat_dir_slot(&it, first + nlfn, &raw, &out->sector);
+        out->offset = raw - it.buf->data;
+        out->first_slot = first;
+        out->slot = first + nlfn;
+        memcpy(&out->de, de, sizeof(out->de));
+    }
+    fat_dir_done(&it);
+    return err;
+}
+
+static int fat_lookup(vfs_inode_t* dir, const char* name, size_t len, vfs_inode_t** out) {
+    struct fat_entry e;
+    int err = fat_find(dir, name, len, &e);
+    if (err) return err;
+
+    *out = fat_iget(dir->sb, &e);
+    return *out ? 0 : -ENOMEM;
+}
+
+static int fat_create(vfs_inode_t* dir, const char* name, size_t len, uint32_t type, vfs_inode_t** out) {
+    struct fat_node* dnode = dir->private;
+    struct fat_info* info = dir->sb->fs_info;
+    struct fat_entry e;
+
+    if (!fat_valid_name(name, len)) return -EINVAL;
+    int err = fat_find(dir, name, len, &e);
+    if (err != -ENOENT) return err ? err : -EEXIST;
+
+    // Names are case-insensitive: drop cached misses under other spellings
+    dcache_purge_parent(dir);
+
+    struct fat_dirent de;
+    uint16_t date, time;
+    fat_timestamp(&date, &time);
+    memset(&de, 0, sizeof(de));
+    de.crt_date = de.acc_date = de.wrt_date = date;
+    de.crt_time = de.wrt_time = time;
+    de.attr = FAT_ATTR_ARCHIVE;
+
+    uint32_t cluster = 0;
+    if (type == VFS_TYPE_DIR) {
+        err = fat_alloc_cluster(info, info->next_free, &cluster);
+        if (!err) err = fat_zero_cluster(info, cluster);
+        if (!err) {
+            // "." and ".." (the root is cluster 0 in "..")
+            struct fat_dirent dots[2];
+            memset(dots, 0, sizeof(dots));
+            memset(dots[0].name, ' ', 11);
+            memset(dots[1].name, ' ', 11);
+            dots[0].name[0] = dots[1].name[0] = dots[1].name[1] = '.';
+            uint32_t parent = dnode->first_cluster == info->root_cluster ? 0 : dnode->first_cluster;
+            dots[0].cluster_hi = cluster >> 16;
+            dots[0].cluster_lo = cluster & 0xFFFF;
+            dots[1].cluster_hi = parent >> 16;
+            dots[1].cluster_lo = parent & 0xFFFF;
+            for (int i = 0; i < 2; i++) {
+                dots[i].attr = FAT_ATTR_DIRECTORY;
+                dots[i].wrt_date = dots[i].crt_date = date;
+                dots[i].wrt_time = dots[i].crt_time = time;
+            }
+
+            buffer_t* buf;
+            err = bcache_read(info->dev, fat_cluster_lba(info, cluster), FAT_SECTOR_SIZE, &buf);
+            if (!err) {
+                memcpy(buf->data, dots, sizeof(dots));
+                bcache_mark_dirty(buf);
+                bcache_release(buf);
+            }
+        }
+        if (err) {
+            if (cluster) fat_free_chain(info, cluster);
+            return err;
+        }
+        de.attr = FAT_ATTR_DIRECTORY;
+        de.cluster_hi = cluster >> 16;
+        de.cluster_lo = cluster & 0xFFFF;
+    }
+
+    err = fat_add_entry(dir, name, len, &de, &e);
+    if (err) {
+        if (cluster) fat_free_chain(info, cluster);
+        return err;
+    }
+
+    *out = fat_iget(dir->sb, &e);
+    return *out ? 0 : -ENOMEM;
+}
+
+// Write back a directory's cached sectors before its clusters are reused
+static int fat_flush_dir(vfs_inode_t* dir) {
+    struct fat_node* node = dir->private;
+    struct fat_info* info = dir->sb->fs_info;
+
+    int err = fat_map(dir);
+    for (uint32_t i = 0; !err && i < node->nextents; i++) {
+        uint32_t lba = fat_cluster_lba(info, node->extents[i].disk_cluster);
+        uint32_t sectors = node->extents[i].count * info->sectors_per_cluster;
+        for (uint32_t s = 0; !err && s < sectors; s++) {
+            buffer_t* buf;
+            err = bcache_read(info->dev, lba + s, FAT_SECTOR_SIZE, &buf);
+            if (err) break;
+            if (buf->flags & BUF_DIRTY) err = bcache_sync_buffer(buf);
+            bcache_release(buf);
+        }
+    }
+    return err;
+}
+
+static int fat_unlink(vfs_inode_t* dir, const char* name, size_t len) {
+    struct fat_node* dnode = dir->private;
+    struct fat_entry e;
+
+    int err = fat_find(dir, name, len, &e);
+    if (err) return err;
+
+    vfs_inode_t* inode = fat_iget(dir->sb, &e);
+    if (!inode) return -ENOMEM;
+
+    if (inode->type == VFS_TYPE_DIR) {
+        struct fat_dir_iter it = { .dir = inode };
+        struct fat_entry child;
+        err = fat_dir_next(&it, &child);
+        fat_dir_done(&it);
+        if (err == 0) err = fat_flush_dir(inode);
+        else if (err > 0) err = -ENOTEMPTY;
+        if (err) {
+            vfs_inode_put(inode);
+            return err;
+        }
+    }
+
+    struct fat_dir_iter it = { .dir = dir };
+    for (uint32_t slot = e.first_slot; slot <= e.slot && !err; slot++) {
+        uint8_t* raw;
+        int ret = fat_dir_slot(&it, slot, &raw, NULL);
+        if (ret <= 0) {
+            err = ret ? ret : -EIO;
+            break;
+        }
+        raw[0] = FAT_DELETED;
+        bcache_mark_dirty(it.buf);
+    }
+    fat_dir_done(&it);
+    if (err) {
+        vfs_inode_put(inode);
+        return err;
+    }
+
+    dnode->version++;
+    dcache_purge_parent(dir);
+
+    // The clusters go when the last reference does (see fat_evict_inode)
+    inode->nlink = 0;
+    vfs_inode_put(inode);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// File data
+// ---------------------------------------------------------------------------
+
+static int fat_truncate(vfs_inode_t* inode, vfs_off_t size) {
+    struct fat_info* info = inode->sb->fs_info;
+    int err;
+
+    if (size > inode->size) {
+        // Grow with zeros; FAT has no holes
+        err = fat_extend(inode, fat_clusters_for(info, size));
+        if (err) return err;
+        int n = fat_transfer(inode, BLK_OP_WRITE, NULL, size - inode->size, inode->size);
+        if (n < 0) return n;
+    } else {
+        err = fat_shrink(inode, fat_clusters_for(info, size));
+        if (err) return err;
+    }
+
+    inode->size = size;
+    return fat_update_dirent(inode);
+}
+
+static int fat_readpages(vfs_inode_t* inode, void* buf, size_t count, vfs_off_t offset) {
+
+    if (offset >= inode->size) return 0;
+    if (count > inode->size - offset) count = inode->size - offset;
+
+    int err = fat_map(inode);
+    if (err) return err;
+    return fat_transfer(inode, BLK_OP_READ, buf, count, offset);
+}
+
+static int fat_write(vfs_file_t* file, const void* buf, size_t count, vfs_off_t offset) {
+    vfs_inode_t* inode = file->inode;
+    struct fat_node* node = inode->private;
+    struct fat_info* info = inode->sb->fs_info;
+
+    if ((uint64_t)offset + count > 0xFFFFFFFFu) return -EFBIG;
+    if (count == 0) return 0;
+
+    // Writing past the end first fills the gap with zeros
+    if (offset > inode->size) {
+        int err = fat_truncate(inode, offset);
+        if (err) return err;
+    }
+
+    int err = fat_extend(inode, fat_clusters_for(info, offset + count));
+    if (err && err != -ENOSPC) return err;
+    if (err) {
+        uint32_t room = node->nclusters * info->cluster_bytes;
+        if (room <= offset) return -ENOSPC;
+        if (count > room - offset) count = room - offset;
+    }
+
+    int n = fat_transfer(inode, BLK_OP_WRITE, (uint8_t*)buf, count, offset);
+    if (n <= 0) return n;
+    if (offset + n > inode->size) inode->size = offset + n;
+
+    err = fat_update_dirent(inode);
+    return err ? err : n;
+}
+
+static int fat_open(vfs_inode_t* inode, vfs_file_t* file) {
+    if (inode->type != VFS_TYPE_DIR) return fat_map(inode);
+
+    struct fat_cursor* cursor = kzalloc(sizeof(struct fat_cursor));
+    if (!cursor) return -ENOMEM;
+    file->private = cursor;
+    return 0;
+}
+
+static void fat_release(vfs_inode_t* inode, vfs_file_t* file) {
+    (void)inode;
+    kfree(file->private);
+    file->private = NULL;
+}
+
+static int fat_readdir(vfs_file_t* file, uint32_t index, vfs_dirent_t* out) {
+    struct fat_node* node = file->inode->private;
+    struct fat_cursor* cursor = file->private;
+    struct fat_dir_iter it = { .dir = file->inode };
+    struct fat_entry e;
+    uint32_t skip = index;
+    int ret;
+
+    // Sequential listing continues after the cached entry
+    if (cursor && cursor->version == node->version && cursor->index + 1 == index && index > 0) {
+        it.slot = cursor->next_slot;
+        skip = 0;
+    }
+    while ((ret = fat_dir_next(&it, &e)) > 0 && skip > 0) skip--;
+    fat_dir_done(&it);
+    if (ret <= 0) return ret;
+
+    if (cursor) {
+        cursor->version = node->version;
+        cursor->index = index;
+        cursor->next_slot = it.slot;
+    }
+
+    out->ino = e.sector * FAT_DIRENTS_PER_SEC + e.offset / FAT_DIRENT_SIZE;
+    out->type = (e.de.attr & FAT_ATTR_DIRECTORY) ? VFS_TYPE_DIR : VFS_TYPE_FILE;
+    strcpy(out->name, e.name);
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Superblock
+// ---------------------------------------------------------------------------
+
+static void fat_evict_inode(vfs_inode_t* inode) {
+    struct fat_node* node = inode->private;
+    if (!node) return;
+
+    if (inode->nlink == 0 && node->first_cluster) {
+        fat_free_chain(inode->sb->fs_info, node->first_cluster);
+    }
+    kfree(node->extents);
+    kfree(node);
+    inode->private = NULL;
+}
+
+static int fat_write_fsinfo(struct fat_info* info) {
+    if (!info->fsinfo_dirty || !info->fsinfo_sector) return 0;
+
+    buffer_t* buf;
+    int err = bcache_read(info->dev, info->fsinfo_sector, FAT_SECTOR_SIZE, &buf);
+    if (err) return err;
+    put_le32(buf->data + 488, info->free_count);
+    put_le32(buf->data + 492, info->next_free);
+    bcache_mark_dirty(buf);
+    bcache_release(buf);
+    info->fsinfo_dirty = false;
+    return 0;
+}
+
+static int fat_sync(vfs_superblock_t* sb) {
+    struct fat_info* info = sb->fs_info;
+    int err = fat_write_fsinfo(info);
+    int serr = bcache_sync(info->dev);
+    return err ? err : serr;
+}
+
+static void fat_put_super(vfs_superblock_t* sb) {
+    struct fat_info* info = sb->fs_info;
+
+    fat_sync(sb);
+    if (info->fat_buf) bcache_release(info->fat_buf);
+    info->fat_buf = NULL;
+    bcache_invalidate(info->dev);
+    vmm_free_page((uint32_t*)info->bounce);
+    kfree(info);
+    sb->fs_info = NULL;
+}
+
+// Volume start: sector 0 itself, or the first FAT32 partition in an MBR
+static int fat_find_volume(blkdev_t* dev, uint32_t* start) {
+    buffer_t* buf;
+    int err = bcache_read(dev, 0, FAT_SECTOR_SIZE, &buf);
+    if (err) return err;
+
+    uint8_t* s = buf->data;
+    err = -EINVAL;
+    if (s[510] == 0x55 && s[511] == 0xAA) {
+        if (s[0] == 0xEB || s[0] == 0xE9) {
+            *start = 0;
+            err = 0;
+        } else {
+            for (int i = 0; i < 4; i++) {
+                uint8_t* part = s + 446 + i * 16;
+                if (part[4] == 0x0B || part[4] == 0x0C) {
+                    *start = le32(part + 8);
+                    err = 0;
+                    break;
+                }
+            }
+        }
+    }
+    bcache_release(buf);
+    return err;
+}
+
+static int fat_read_bpb(struct fat_info* info, uint32_t start) {
+    buffer_t* buf;
+    int err = bcache_read(info->dev, start, FAT_SECTOR_SIZE, &buf);
+    if (err) return err;
+    const uint8_t* b = buf->data;
+
+    uint32_t bytes_per_sector = le16(b + 11);
+    uint32_t spc = b[13];
+    uint32_t reserved = le16(b + 14);
+    uint32_t num_fats = b[16];
+    uint32_t root_entries = le16(b + 17);
+    uint32_t total = le16(b + 19) ? le16(b + 19) : le32(b + 32);
+    uint32_t fat16_size = le16(b + 22);
+    uint32_t fat_size = le32(b + 36);
+    uint32_t ext_flags = le16(b + 40);
+    uint32_t root_cluster = le32(b + 44);
+    uint32_t fsinfo = le16(b + 48);
+    bcache_release(buf);
+
+    // FAT32 only: no fixed root directory, 32-bit FAT size
+    if (bytes_per_sector != FAT_SECTOR_SIZE || spc == 0 || (spc & (spc - 1)) || reserved == 0 ||
+        num_fats == 0 || root_entries != 0 || fat16_size != 0 || fat_size == 0) {
+        return -EINVAL;
+    }
+
+    uint32_t meta = reserved + num_fats * fat_size;
+    if (total <= meta || start + total > info->dev->sectors) return -EINVAL;
+
+    info->sectors_per_cluster = spc;
+    info->cluster_bytes = spc * FAT_SECTOR_SIZE;
+    info->fat_start = start + reserved;
+    info->fat_sectors = fat_size;
+    info->num_fats = num_fats;
+    info->active_fat = (ext_flags & 0x80) ? (int32_t)(ext_flags & 0x0F) : -1;
+    info->data_start = start + meta;
+    info->clusters = (total - meta) / spc;
+    if (info->clusters > fat_size * (FAT_SECTOR_SIZE / 4) - 2) info->clusters = fat_size * (FAT_SECTOR_SIZE / 4) - 2;
+    info->root_cluster = root_cluster;
+    if (info->active_fat >= (int32_t)num_fats || !fat_cluster_valid(info, root_cluster)) return -EINVAL;
+
+    info->free_count = FAT_FREE_UNKNOWN;
+    info->next_free = 2;
+    if (fsinfo && fsinfo != 0xFFFF && fsinfo < reserved) {
+        err = bcache_read(info->dev, start + fsinfo, FAT_SECTOR_SIZE, &buf);
+        if (err) return err;
+        b = buf->data;
+        if (le32(b) == 0x41615252 && le32(b + 484) == 0x61417272) {
+            info->fsinfo_sector = start + fsinfo;
+            uint32_t free_count = le32(b + 488);
+            uint32_t next_free = le32(b + 492);
+            if (free_count <= info->clusters) info->free_count = free_count;
+            if (fat_cluster_valid(info, next_free)) info->next_free = next_free;
+        }
+        bcache_release(buf);
+    }
+    return 0;
+}
+
+static int fat_mount(const char* source, uint32_t flags, vfs_superblock_t* sb) {
+    (void)flags;
+
+    blkdev_t* dev = source ? blkdev_find(source) : NULL;
+    if (!dev) return -ENODEV;
+    if (dev->sector_size != FAT_SECTOR_SIZE) return -EINVAL;
+
+    struct fat_info* info = kzalloc(sizeof(struct fat_info));
+    if (!info) return -ENOMEM;
+    info->dev = dev;
+
+    uint32_t start;
+    int err = fat_find_volume(dev, &start);
+    if (!err) err = fat_read_bpb(info, start);
+    if (!err) {
+        info->bounce = (uint8_t*)vmm_alloc_page();
+        if (!info->bounce) err = -ENOMEM;
+    }
+
+    struct fat_node* node = NULL;
+    if (!err) {
+        node = kzalloc(sizeof(struct fat_node));
+        sb->fs_info = info;
+        sb->root = node ? vfs_inode_alloc(sb, FAT_ROOT_INO) : NULL;
+        if (!sb->root) err = -ENOMEM;
+    }
+    if (err) {
+        kfree(node);
+        if (info->bounce) vmm_free_page((uint32_t*)info->bounce);
+        kfree(info);
+        sb->fs_info = NULL;
+        return err;
+    }
+
+    node->first_cluster = info->root_cluster;
+    sb->root->type = VFS_TYPE_DIR;
+    sb->root->mode = 0755;
+    sb->root->nlink = 2;
+    sb->root->i_op = &fat_inode_ops;
+    sb->root->f_op = &fat_file_ops;
+    sb->root->private = node;
+    sb->s_op = &fat_super_ops;
+    sb->block_size = info->cluster_bytes;
+    return 0;
+}
+
+static const vfs_inode_ops_t fat_inode_ops = {
+    .lookup = fat_lookup,
+    .create = fat_create,
+    .unlink = fat_unlink,
+    .truncate = fat_truncate,
+};
+
+static const vfs_file_ops_t fat_file_ops = {
+    .open = fat_open,
+    .release = fat_release,
+    .write = fat_write,
+    .readdir = fat_readdir,
+    .readpages = fat_readpages,
+};
+
+static const vfs_super_ops_t fat_super_ops = {
+    .evict_inode = fat_evict_inode,
+    .put_super = fat_put_super,
+    .sync = fat_sync,
+};
+
+static vfs_fs_type_t fat32_type = {
+    .name = "fat32",
+    .mount = fat_mount,
+};
+
+void fat32_init(void) {
+    memset(&stats, 0, sizeof(stats));
+    vfs_register_filesystem(&fat32_type);
+}
+
+void fat32_get_stats(fat32_stats_t* out) {
+    *out = stats;
+}
+
+void fat32_reset_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
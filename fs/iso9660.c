@@ -0,0 +1,851 @@
+/**
+ * ISO9660 - Bunix OS
+ *
+ * Read-only ISO9660 with the Rock Ridge extensions, as written by
+ * grub-mkrescue/xorriso, on a CD drive or a disk image. Without Rock Ridge
+ * names are shown the way Linux does by default: version suffix dropped
+ * and lower-cased.
+ *
+ * The first lookup or listing in a directory reads all of its records
+ * once, Rock Ridge entries and continuation areas included, into an entry
+ * cache with a name hash: every child's name, attributes and extents.
+ * Later lookups, listings and opens of anything in that directory are
+ * answered from memory. The cache lives as long as the directory inode,
+ * which the dentry cache keeps around while its children are in use.
+ *
+ * File data bypasses the block cache: whole 2KB blocks are read straight
+ * into the caller's buffer with large requests, several in flight under a
+ * plug so the request queue merges them into the biggest reads the device
+ * takes. Directory and continuation blocks go through the block cache.
+ *
+ * Inodes are numbered after the position of their directory record
+ * (block * 2048 + offset), as on Linux.
+ */
+
+#include "../include/fs/vfs.h"
+#include "../include/fs/iso9660.h"
+#include "../include/block/blkdev.h"
+#include "../include/block/bcache.h"
+#include "../include/mm/vmm.h"
+#include "../include/mm/kmalloc.h"
+#include "../include/lib/string.h"
+#include "../include/lib/calendar.h"
+#include "../include/lib/errno.h"
+
+#define ISO_BLOCK_SIZE        2048
+#define ISO_BLOCK_SECTORS     (ISO_BLOCK_SIZE / BLK_SECTOR_SIZE)
+#define ISO_FIRST_VD          16           // Volume descriptors start here
+#define ISO_MAX_VDS           32
+#define ISO_VD_PRIMARY        1
+#define ISO_VD_TERMINATOR     255
+#define ISO_PVD_ROOT          156          // Root directory record in the PVD
+#define ISO_NAME_MAX          255
+#define ISO_MIN_BUCKETS       16
+
+// Directory record flags
+#define ISO_FLAG_HIDDEN       0x01
+#define ISO_FLAG_DIR          0x02
+#define ISO_FLAG_ASSOCIATED   0x04
+#define ISO_FLAG_MULTI_EXTENT 0x80         // More extents follow in the next record
+
+// Rock Ridge
+#define RR_NM_CONTINUE        0x01
+#define RR_NM_CURRENT         0x02
+#define RR_NM_PARENT          0x04
+#define RR_SL_CONTINUE        0x01
+#define RR_SL_CURRENT         0x02
+#define RR_SL_PARENT          0x04
+#define RR_SL_ROOT            0x08
+#define RR_TF_CREATE          0x01
+#define RR_TF_MODIFY          0x02
+#define RR_TF_LONG_FORM       0x80
+#define RR_MAX_CE             16           // Continuation areas followed per record
+
+#define POSIX_S_IFMT          0170000
+#define POSIX_S_IFDIR         0040000
+#define POSIX_S_IFLNK         0120000
+
+#define ISO_IO_BATCH          8            // Data requests in flight together
+
+struct iso_dirrec {
+    uint8_t length;
+    uint8_t ext_attr_length;
+    uint32_t extent_le;
+    uint32_t extent_be;
+    uint32_t size_le;
+    uint32_t size_be;
+    uint8_t date[7];
+    uint8_t flags;
+    uint8_t file_unit_size;
+    uint8_t interleave_gap;
+    uint16_t volume_seq_le;
+    uint16_t volume_seq_be;
+    uint8_t name_len;
+    char name[];
+} __attribute__((packed));
+
+#define ISO_DIRREC_SIZE       33           // Fixed part, before the name
+
+struct iso_extent {
+    uint32_t block;
+    uint32_t bytes;
+};
+
+// A cached directory entry; names, link targets and extents live in the
+// directory's pools and are addressed by index so the pools can grow
+struct iso_entry {
+    uint32_t hash;
+    uint32_t ino;
+    uint32_t type;
+    uint32_t mode;
+    uint32_t nlink;
+    vfs_off_t size;
+    uint32_t mtime;
+    uint32_t name;                 // Offset into the name pool
+    uint32_t name_len;
+    uint32_t link;                 // Symlink target in the name pool
+    uint32_t link_len;
+    uint32_t first_extent;         // Index into the extent pool
+    uint32_t nextents;
+    uint32_t next;                 // Hash chain, entry index + 1
+};
+
+struct iso_dir {
+    struct iso_entry* entries;
+    uint32_t nentries;
+    uint32_t capacity;
+    char* names;
+    uint32_t names_len;
+    uint32_t names_cap;
+    struct iso_extent* extents;
+    uint32_t nextents;
+    uint32_t extents_cap;
+    uint32_t* buckets;             // Entry index + 1, 0 ends a chain
+    uint32_t nbuckets;
+};
+
+struct iso_node {
+    struct iso_extent* extents;
+    uint32_t nextents;
+    char* link;                    // Symlink target, read as the file's data
+    struct iso_dir* dir;           // Entry cache, built on first use
+};
+
+struct iso_info {
+    blkdev_t* dev;
+    uint32_t volume_blocks;
+    bool rock_ridge;
+    uint32_t rr_skip;              // Bytes to skip before SUSP entries
+    uint8_t* bounce;               // Partial blocks
+};
+
+// What Rock Ridge says about one directory record
+struct iso_rr {
+    char name[ISO_NAME_MAX + 1];
+    uint32_t name_len;
+    bool has_name;
+    char link[VFS_PATH_MAX];
+    uint32_t link_len;
+    bool is_link;
+    bool has_mode;
+    uint32_t mode;
+    uint32_t nlink;
+    bool has_mtime;
+    uint32_t mtime;
+    bool relocated;                // RE: shown elsewhere through a CL entry
+    uint32_t child_link;           // CL: the directory's real location
+};
+
+static iso9660_stats_t stats;
+
+static const vfs_inode_ops_t iso_inode_ops;
+static const vfs_file_ops_t iso_file_ops;
+static const vfs_super_ops_t iso_super_ops;
+
+static inline uint32_t get_le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t iso_name_hash(const char* name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Seconds since 1970 from the 7-byte form: years since 1900, month, day,
+// hour, minute, second and the offset from GMT in 15-minute units
+static uint32_t iso_time(const uint8_t* date) {
+    uint32_t year = 1900 + date[0];
+    uint32_t month = date[1];
+    if (year < 1970 || month < 1 || month > 12) return 0;
+
+    int32_t days = days_from_civil(year, month, date[2] ? date[2] : 1);
+    int32_t t = days * 86400 + date[3] * 3600 + date[4] * 60 + date[5];
+    return t - (int8_t)date[6] * 15 * 60;
+}
+
+// ---------------------------------------------------------------------------
+// Rock Ridge
+// ---------------------------------------------------------------------------
+
+static void rr_append_link(struct iso_rr* rr, const char* s, uint32_t len) {
+    if (rr->link_len + len >= sizeof(rr->link)) len = sizeof(rr->link) - 1 - rr->link_len;
+    memcpy(rr->link + rr->link_len, s, len);
+    rr->link_len += len;
+}
+
+// One SL entry: path components, each with flags and a length
+static void rr_parse_sl(struct iso_rr* rr, const uint8_t* e, uint32_t len, bool* continued) {
+    uint32_t pos = 5;
+    while (pos + 2 <= len) {
+        uint8_t flags = e[pos];
+        uint8_t clen = e[pos + 1];
+        if (pos + 2 + clen > len) break;
+
+        // A component continued from the previous one gets no separator
+        if (rr->link_len && !*continued && !(rr->link_len == 1 && rr->link[0] == '/')) {
+            rr_append_link(rr, "/", 1);
+        }
+        if (flags & RR_SL_ROOT) rr_append_link(rr, "/", 1);
+        else if (flags & RR_SL_PARENT) rr_append_link(rr, "..", 2);
+        else if (flags & RR_SL_CURRENT) rr_append_link(rr, ".", 1);
+        else rr_append_link(rr, (const char*)e + pos + 2, clen);
+
+        *continued = flags & RR_SL_CONTINUE;
+        pos += 2 + clen;
+    }
+}
+
+/*
+ * Collect the SUSP entries in a record's system use area, following
+ * continuation areas. Unknown entries are skipped; a malformed one ends
+ * the walk with whatever was found so far.
+ */
+static void rr_parse(struct iso_info* info, const uint8_t* area, uint32_t len, struct iso_rr* rr) {
+    buffer_t* ce_buf = NULL;
+    bool nm_continued = false;
+    bool sl_continued = false;
+
+    for (int hops = 0; hops <= RR_MAX_CE; hops++) {
+        uint32_t ce_block = 0, ce_offset = 0, ce_len = 0;
+        uint32_t pos = 0;
+
+        while (pos + 4 <= len) {
+            const uint8_t* e = area + pos;
+            uint32_t elen = e[2];
+            if (elen < 4 || pos + elen > len) break;
+
+            if (e[0] == 'N' && e[1] == 'M' && elen >= 5) {
+                uint8_t flags = e[4];
+                if (!(flags & (RR_NM_CURRENT | RR_NM_PARENT))) {
+                    uint32_t n = elen - 5;
+                    if (!nm_continued) rr->name_len = 0;
+                    if (rr->name_len + n > ISO_NAME_MAX) n = ISO_NAME_MAX - rr->name_len;
+                    memcpy(rr->name + rr->name_len, e + 5, n);
+                    rr->name_len += n;
+                    rr->has_name = true;
+                }
+                nm_continued = flags & RR_NM_CONTINUE;
+            } else if (e[0] == 'P' && e[1] == 'X' && elen >= 36) {
+                rr->mode = get_le32(e + 4);
+                rr->nlink = get_le32(e + 12);
+                rr->has_mode = true;
+                rr->is_link = (rr->mode & POSIX_S_IFMT) == POSIX_S_IFLNK;
+            } else if (e[0] == 'T' && e[1] == 'F' && elen >= 5) {
+                uint8_t flags = e[4];
+                uint32_t at = 5 + ((flags & RR_TF_CREATE) ? 7 : 0);
+                if ((flags & RR_TF_MODIFY) && !(flags & RR_TF_LONG_FORM) && at + 7 <= elen) {
+                    rr->mtime = iso_time(e + at);
+                    rr->has_mtime = true;
+                }
+            } else if (e[0] == 'S' && e[1] == 'L' && elen >= 5) {
+                rr_parse_sl(rr, e, elen, &sl_continued);
+            } else if (e[0] == 'C' && e[1] == 'E' && elen >= 28) {
+                ce_block = get_le32(e + 4);
+                ce_offset = get_le32(e + 12);
+                ce_len = get_le32(e + 20);
+            } else if (e[0] == 'R' && e[1] == 'E') {
+                rr->relocated = true;
+            } else if (e[0] == 'C' && e[1] == 'L' && elen >= 12) {
+                rr->child_link = get_le32(e + 4);
+            } else if (e[0] == 'S' && e[1] == 'T') {
+                break;
+            }
+            pos += elen;
+        }
+
+        if (ce_buf) bcache_release(ce_buf);
+        ce_buf = NULL;
+        if (!ce_len || ce_block >= info->volume_blocks || ce_offset >= ISO_BLOCK_SIZE) break;
+        if (bcache_read(info->dev, ce_block, ISO_BLOCK_SIZE, &ce_buf) != 0) break;
+        area = ce_buf->data + ce_offset;
+        len = ce_len < ISO_BLOCK_SIZE - ce_offset ? ce_len : ISO_BLOCK_SIZE - ce_offset;
+    }
+    if (ce_buf) bcache_release(ce_buf);
+}
+
+// The system use area follows the name, padded to an even offset
+static void iso_record_rr(struct iso_info* info, const struct iso_dirrec* rec, struct iso_rr* rr) {
+    memset(rr, 0, sizeof(*rr));
+    if (!info->rock_ridge) return;
+
+    uint32_t su = ISO_DIRREC_SIZE + rec->name_len + !(rec->name_len & 1) + info->rr_skip;
+    if (su < rec->length) rr_parse(info, (const uint8_t*)rec + su, rec->length - su, rr);
+}
+
+// ---------------------------------------------------------------------------
+// Directory entry cache
+// ---------------------------------------------------------------------------
+
+static bool iso_grow(void** array, uint32_t* cap, uint32_t need, size_t elem) {
+    if (need <= *cap) return true;
+    uint32_t n = *cap ? *cap : 16;
+    while (n < need) n *= 2;
+    void* p = krealloc(*array, n * elem);
+    if (!p) return false;
+    *array = p;
+    *cap = n;
+    return true;
+}
+
+static int iso_pool_add(struct iso_dir* dir, const char* s, uint32_t len, uint32_t* out) {
+    if (!iso_grow((void**)&dir->names, &dir->names_cap, dir->names_len + len, 1)) return -ENOMEM;
+    memcpy(dir->names + dir->names_len, s, len);
+    *out = dir->names_len;
+    dir->names_len += len;
+    return 0;
+}
+
+static void iso_dir_free(struct iso_dir* dir) {
+    if (!dir) return;
+    kfree(dir->entries);
+    kfree(dir->names);
+    kfree(dir->extents);
+    kfree(dir->buckets);
+    kfree(dir);
+}
+
+// Plain ISO9660 name: "README.TXT;1" shows as "readme.txt"
+static uint32_t iso_plain_name(const struct iso_dirrec* rec, char* out) {
+    uint32_t len = rec->name_len;
+    for (uint32_t i = 0; i < len; i++) {
+        if (rec->name[i] == ';') {
+            len = i;
+            break;
+        }
+    }
+    if (len > 1 && rec->name[len - 1] == '.') len--;
+
+    for (uint32_t i = 0; i < len; i++) {
+        char c = rec->name[i];
+        out[i] = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+    }
+    return len;
+}
+
+// Data length of the directory starting at 'block', from its "." record
+static int iso_dir_size(struct iso_info* info, uint32_t block, uint32_t* size) {
+    buffer_t* buf;
+    int err = bcache_read(info->dev, block, ISO_BLOCK_SIZE, &buf);
+    if (err) return err;
+
+    const struct iso_dirrec* rec = (const struct iso_dirrec*)buf->data;
+    *size = rec->length >= ISO_DIRREC_SIZE ? rec->size_le : 0;
+    bcache_release(buf);
+    return *size ? 0 : -EIO;
+}
+
+/*
+ * Add the file described by one record, or by this record and the ones
+ * after it when it has several extents. 'prev' is the entry a multi-extent
+ * record continues, if any.
+ */
+static int iso_add_record(struct iso_info* info, struct iso_dir* dir, const struct iso_dirrec* rec,
+                          uint32_t block, uint32_t offset, struct iso_entry** prev) {
+    // Continuation of a file that spans several extents
+    if (*prev) {
+        struct iso_entry* e = *prev;
+        if (!iso_grow((void**)&dir->extents, &dir->extents_cap, dir->nextents + 1, sizeof(struct iso_extent))) {
+            return -ENOMEM;
+        }
+        dir->extents[dir->nextents++] = (struct iso_extent){ rec->extent_le, rec->size_le };
+        e->nextents++;
+        e->size = (uint64_t)e->size + rec->size_le > 0xFFFFFFFFu ? 0xFFFFFFFFu : e->size + rec->size_le;
+        *prev = (rec->flags & ISO_FLAG_MULTI_EXTENT) ? e : NULL;
+        return 0;
+    }
+
+    // "." and "..", associated files and interleaved files are not shown
+    if (rec->name_len == 1 && (rec->name[0] == 0 || rec->name[0] == 1)) return 0;
+    if (rec->flags & ISO_FLAG_ASSOCIATED) return 0;
+    if (rec->file_unit_size || rec->interleave_gap) return 0;
+
+    struct iso_rr rr;
+    iso_record_rr(info, rec, &rr);
+    if (rr.relocated) return 0;
+
+    char plain[ISO_NAME_MAX + 1];
+    const char* name = rr.name;
+    uint32_t name_len = rr.name_len;
+    if (!rr.has_name) {
+        name_len = iso_plain_name(rec, plain);
+        name = plain;
+    }
+    if (name_len == 0 || name_len > VFS_NAME_MAX) return 0;
+
+    uint32_t extent = rec->extent_le;
+    uint32_t size = rec->size_le;
+    bool is_dir = rec->flags & ISO_FLAG_DIR;
+    if (rr.child_link) {
+        // A deep directory moved elsewhere by the mastering tool
+        extent = rr.child_link;
+        is_dir = true;
+        int err = iso_dir_size(info, extent, &size);
+        if (err) return err;
+    }
+
+    if (!iso_grow((void**)&dir->entries, &dir->capacity, dir->nentries + 1, sizeof(struct iso_entry)) ||
+        !iso_grow((void**)&dir->extents, &dir->extents_cap, dir->nextents + 1, sizeof(struct iso_extent))) {
+        return -ENOMEM;
+    }
+
+    struct iso_entry* e = &dir->entries[dir->nentries];
+    memset(e, 0, sizeof(*e));
+    e->hash = iso_name_hash(name, name_len);
+    e->ino = block * ISO_BLOCK_SIZE + offset;
+    e->type = is_dir ? VFS_TYPE_DIR : VFS_TYPE_FILE;
+    e->mode = rr.has_mode ? (rr.mode & 07777) : (is_dir ? 0555 : 0444);
+    e->nlink = rr.has_mode && rr.nlink ? rr.nlink : (is_dir ? 2 : 1);
+    e->size = size;
+    e->mtime = rr.has_mtime ? rr.mtime : iso_time(rec->date);
+    e->name_len = name_len;
+    e->first_extent = dir->nextents;
+    e->nextents = 1;
+    dir->extents[dir->nextents++] = (struct iso_extent){ extent, size };
+
+    int err = iso_pool_add(dir, name, name_len, &e->name);
+    if (!err && rr.is_link) {
+        e->size = rr.link_len;
+        e->link_len = rr.link_len;
+        err = iso_pool_add(dir, rr.link, rr.link_len, &e->link);
+    }
+    if (err) return err;
+
+    dir->nentries++;
+    *prev = (rec->flags & ISO_FLAG_MULTI_EXTENT) && !is_dir ? e : NULL;
+    return 0;
+}
+
+static int iso_dir_hash(struct iso_dir* dir) {
+    uint32_t nbuckets = ISO_MIN_BUCKETS;
+    while (nbuckets < dir->nentries) nbuckets *= 2;
+
+    dir->buckets = kzalloc(nbuckets * sizeof(uint32_t));
+    if (!dir->buckets) return -ENOMEM;
+    dir->nbuckets = nbuckets;
+
+    for (uint32_t i = 0; i < dir->nentries; i++) {
+        struct iso_entry* e = &dir->entries[i];
+        uint32_t b = e->hash & (nbuckets - 1);
+        e->next = dir->buckets[b];
+        dir->buckets[b] = i + 1;
+    }
+    return 0;
+}
+
+// Read every record of a directory into its entry cache
+static int iso_dir_load(vfs_inode_t* inode) {
+    struct iso_node* node = inode->private;
+    struct iso_info* info = inode->sb->fs_info;
+    if (node->dir) return 0;
+
+    struct iso_dir* dir = kzalloc(sizeof(struct iso_dir));
+    if (!dir) return -ENOMEM;
+
+    struct iso_entry* prev = NULL;
+    int err = 0;
+    for (uint32_t x = 0; x < node->nextents && !err; x++) {
+        const struct iso_extent* ext = &node->extents[x];
+        uint32_t blocks = (ext->bytes + ISO_BLOCK_SIZE - 1) / ISO_BLOCK_SIZE;
+
+        for (uint32_t b = 0; b < blocks && !err; b++) {
+            if (ext->block + b >= info->volume_blocks) {
+                err = -EIO;
+                break;
+            }
+            buffer_t* buf;
+            err = bcache_read(info->dev, ext->block + b, ISO_BLOCK_SIZE, &buf);
+            if (err) break;
+
+            // Records never cross a block; a zero length pads to the next
+            uint32_t offset = 0;
+            while (offset + ISO_DIRREC_SIZE <= ISO_BLOCK_SIZE && !err) {
+                const struct iso_dirrec* rec = (const struct iso_dirrec*)(buf->data + offset);
+                if (rec->length == 0) break;
+                if (rec->length < ISO_DIRREC_SIZE + rec->name_len || offset + rec->length > ISO_BLOCK_SIZE) {
+                    err = -EIO;
+                    break;
+                }
+                err = iso_add_record(info, dir, rec, ext->block + b, offset, &prev);
+                offset += rec->length;
+            }
+            bcache_release(buf);
+        }
+    }
+
+    if (!err) err = iso_dir_hash(dir);
+    if (err) {
+        iso_dir_free(dir);
+        return err;
+    }
+
+    node->dir = dir;
+    stats.dirs_parsed++;
+    stats.entries_cached += dir->nentries;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Inodes
+// ---------------------------------------------------------------------------
+
+static int iso_iget(vfs_superblock_t* sb, struct iso_dir* parent, const struct iso_entry* e, vfs_inode_t** out) {
+    vfs_inode_t* inode = vfs_inode_find(sb, e->ino);
+    if (inode) {
+        *out = inode;
+        return 0;
+    }
+
+    struct iso_node* node = kzalloc(sizeof(struct iso_node));
+    struct iso_extent* extents = node ? kmalloc(e->nextents * sizeof(struct iso_extent)) : NULL;
+    char* link = NULL;
+    if (extents && e->link_len) {
+        link = kmalloc(e->link_len);
+        if (!link) {
+            kfree(extents);
+            extents = NULL;
+        }
+    }
+    inode = extents ? vfs_inode_alloc(sb, e->ino) : NULL;
+    if (!inode) {
+        kfree(link);
+        kfree(extents);
+        kfree(node);
+        return -ENOMEM;
+    }
+
+    memcpy(extents, parent->extents + e->first_extent, e->nextents * sizeof(struct iso_extent));
+    if (link) memcpy(link, parent->names + e->link, e->link_len);
+    node->extents = extents;
+    node->nextents = e->nextents;
+    node->link = link;
+
+    inode->type = e->type;
+    inode->mode = e->mode;
+    inode->nlink = e->nlink;
+    inode->size = e->size;
+    inode->blocks = 0;
+    for (uint32_t i = 0; i < e->nextents; i++) {
+        inode->blocks += (extents[i].bytes + ISO_BLOCK_SIZE - 1) / ISO_BLOCK_SIZE * ISO_BLOCK_SECTORS;
+    }
+    inode->mtime = e->mtime;
+    inode->i_op = &iso_inode_ops;
+    inode->f_op = &iso_file_ops;
+    inode->private = node;
+    *out = inode;
+    return 0;
+}
+
+static int iso_lookup(vfs_inode_t* dir, const char* name, size_t len, vfs_inode_t** out) {
+    struct iso_node* node = dir->private;
+    int err = iso_dir_load(dir);
+    if (err) return err;
+
+    struct iso_dir* d = node->dir;
+    uint32_t hash = iso_name_hash(name, len);
+    stats.lookups++;
+    for (uint32_t i = d->buckets[hash & (d->nbuckets - 1)]; i; i = d->entries[i - 1].next) {
+        const struct iso_entry* e = &d->entries[i - 1];
+        if (e->hash == hash && e->name_len == len && memcmp(d->names + e->name, name, len) == 0) {
+            return iso_iget(dir->sb, d, e, out);
+        }
+    }
+    return -ENOENT;
+}
+
+static void iso_evict_inode(vfs_inode_t* inode) {
+    struct iso_node* node = inode->private;
+    if (!node) return;
+
+    iso_dir_free(node->dir);
+    kfree(node->extents);
+    kfree(node->link);
+    kfree(node);
+    inode->private = NULL;
+}
+
+// ---------------------------------------------------------------------------
+// File data
+// ---------------------------------------------------------------------------
+
+// Read whole sectors with requests of up to max_sectors, several handed to
+// the request queue together
+static int iso_io(struct iso_info* info, uint64_t lba, uint32_t count, uint8_t* buf) {
+    blkdev_t* dev = info->dev;
+    blk_request_t reqs[ISO_IO_BATCH];
+    uint32_t max = dev->max_sectors & ~(ISO_BLOCK_SECTORS - 1);
+
+    while (count > 0) {
+        blk_plug_t plug;
+        int n = 0;
+        int err = 0;
+
+        blk_start_plug(&plug);
+        while (n < ISO_IO_BATCH && count > 0) {
+            uint32_t chunk = count < max ? count : max;
+            memset(&reqs[n], 0, sizeof(reqs[n]));
+            reqs[n].dev = dev;
+            reqs[n].op = BLK_OP_READ;
+            reqs[n].lba = lba;
+            reqs[n].count = chunk;
+            reqs[n].buffer = buf;
+
+            err = blkdev_submit(&reqs[n]);
+            if (err) break;
+            n++;
+            lba += chunk;
+            count -= chunk;
+            buf += chunk * BLK_SECTOR_SIZE;
+            stats.data_requests++;
+            stats.data_sectors += chunk;
+        }
+        blk_finish_plug(&plug);
+
+        for (int i = 0; i < n; i++) {
+            blkdev_wait(&reqs[i]);
+            if (reqs[i].status && !err) err = reqs[i].status;
+        }
+        if (err) return err;
+    }
+    return 0;
+}
+
+static int iso_readpages(vfs_inode_t* inode, void* buf, size_t count, vfs_off_t offset) {
+    struct iso_node* node = inode->private;
+    struct iso_info* info = inode->sb->fs_info;
+    uint8_t* out = buf;
+
+    if (offset >= inode->size) return 0;
+    if (count > inode->size - offset) count = inode->size - offset;
+
+    if (node->link) {
+        memcpy(out, node->link + offset, count);
+        return count;
+    }
+
+    // Find the extent holding 'offset'
+    uint32_t x = 0;
+    vfs_off_t start = 0;
+    while (x < node->nextents && offset - start >= node->extents[x].bytes) {
+        start += node->extents[x].bytes;
+        x++;
+    }
+
+    size_t done = 0;
+    while (done < count && x < node->nextents) {
+        const struct iso_extent* ext = &node->extents[x];
+        uint32_t in_extent = offset + done - start;
+        size_t left = count - done;
+        if (left > ext->bytes - in_extent) left = ext->bytes - in_extent;
+
+        uint32_t block = ext->block + in_extent / ISO_BLOCK_SIZE;
+        uint32_t in_block = in_extent % ISO_BLOCK_SIZE;
+        uint32_t last = ext->block + (ext->bytes + ISO_BLOCK_SIZE - 1) / ISO_BLOCK_SIZE;
+        if (last > info->volume_blocks) return -EIO;
+
+        int err;
+        size_t chunk;
+        if (in_block == 0 && left >= ISO_BLOCK_SIZE && ((uint32_t)(out + done) & 1) == 0) {
+            // Whole blocks straight into the caller's buffer
+            uint32_t blocks = left / ISO_BLOCK_SIZE;
+            chunk = blocks * ISO_BLOCK_SIZE;
+            err = iso_io(info, (uint64_t)block * ISO_BLOCK_SECTORS, blocks * ISO_BLOCK_SECTORS, out + done);
+        } else {
+            // Partial blocks through the bounce page
+            uint32_t blocks = (in_block + left + ISO_BLOCK_SIZE - 1) / ISO_BLOCK_SIZE;
+            if (blocks > PAGE_SIZE / ISO_BLOCK_SIZE) blocks = PAGE_SIZE / ISO_BLOCK_SIZE;
+            if (blocks > last - block) blocks = last - block;
+            chunk = blocks * ISO_BLOCK_SIZE - in_block;
+            if (chunk > left) chunk = left;
+            err = iso_io(info, (uint64_t)block * ISO_BLOCK_SECTORS, blocks * ISO_BLOCK_SECTORS, info->bounce);
+            if (!err) memcpy(out + done, info->bounce + in_block, chunk);
+        }
+        if (err) return err;
+
+        done += chunk;
+        if (offset + done - start >= ext->bytes) {
+            start += ext->bytes;
+            x++;
+        }
+    }
+    return done;
+}
+
+static int iso_readdir(vfs_file_t* file, uint32_t index, vfs_dirent_t* out) {
+    struct iso_node* node = file->inode->private;
+    int err = iso_dir_load(file->inode);
+    if (err) return err;
+
+    struct iso_dir* dir = node->dir;
+    if (index >= dir->nentries) return 0;
+
+    const struct iso_entry* e = &dir->entries[index];
+    out->ino = e->ino;
+    out->type = e->type;
+    memcpy(out->name, dir->names + e->name, e->name_len);
+    out->name[e->name_len] = '\0';
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Superblock
+// ---------------------------------------------------------------------------
+
+static void iso_put_super(vfs_superblock_t* sb) {
+    struct iso_info* info = sb->fs_info;
+
+    bcache_invalidate(info->dev);
+    vmm_free_page((uint32_t*)info->bounce);
+    kfree(info);
+    sb->fs_info = NULL;
+}
+
+// Find the primary volume descriptor and copy out the root record
+static int iso_read_pvd(struct iso_info* info, uint8_t* root) {
+    for (uint32_t i = 0; i < ISO_MAX_VDS; i++) {
+        buffer_t* buf;
+        int err = bcache_read(info->dev, ISO_FIRST_VD + i, ISO_BLOCK_SIZE, &buf);
+        if (err) return err;
+
+        const uint8_t* vd = buf->data;
+        uint8_t type = vd[0];
+        bool valid = memcmp(vd + 1, "CD001", 5) == 0;
+        if (valid && type == ISO_VD_PRIMARY) {
+            uint16_t block_size = vd[128] | (vd[129] << 8);
+            info->volume_blocks = get_le32(vd + 80);
+            memcpy(root, vd + ISO_PVD_ROOT, ISO_DIRREC_SIZE + 1);
+            bcache_release(buf);
+            return block_size == ISO_BLOCK_SIZE ? 0 : -EINVAL;
+        }
+        bcache_release(buf);
+        if (!valid || type == ISO_VD_TERMINATOR) break;
+    }
+    return -EINVAL;
+}
+
+// Rock Ridge announces itself with an SP entry in the root's "." record
+static void iso_detect_rr(struct iso_info* info, uint32_t root_block, struct iso_rr* root_rr) {
+    buffer_t* buf;
+    if (bcache_read(info->dev, root_block, ISO_BLOCK_SIZE, &buf) != 0) return;
+
+    const struct iso_dirrec* rec = (const struct iso_dirrec*)buf->data;
+    uint32_t su = ISO_DIRREC_SIZE + rec->name_len + !(rec->name_len & 1);
+    const uint8_t* sp = buf->data + su;
+    if (rec->length >= su + 7 && sp[0] == 'S' && sp[1] == 'P' && sp[4] == 0xBE && sp[5] == 0xEF) {
+        info->rock_ridge = true;
+        info->rr_skip = sp[6];
+        iso_record_rr(info, rec, root_rr);
+    }
+    bcache_release(buf);
+}
+
+static int iso_mount(const char* source, uint32_t flags, vfs_superblock_t* sb) {
+    blkdev_t* dev = source ? blkdev_find(source) : NULL;
+    if (!dev) return -ENODEV;
+    if (dev->sector_size != BLK_SECTOR_SIZE) return -EINVAL;
+    (void)flags;
+
+    struct iso_info* info = kzalloc(sizeof(struct iso_info));
+    if (!info) return -ENOMEM;
+    info->dev = dev;
+
+    uint8_t root_rec[ISO_DIRREC_SIZE + 1];
+    int err = iso_read_pvd(info, root_rec);
+    if (!err && (uint64_t)info->volume_blocks * ISO_BLOCK_SECTORS > dev->sectors) err = -EINVAL;
+
+    const struct iso_dirrec* rec = (const struct iso_dirrec*)root_rec;
+    if (!err && (rec->extent_le >= info->volume_blocks || rec->size_le == 0)) err = -EINVAL;
+    if (!err) {
+        info->bounce = (uint8_t*)vmm_alloc_page();
+        if (!info->bounce) err = -ENOMEM;
+    }
+    if (err) {
+        bcache_invalidate(dev);
+        kfree(info);
+        return err;
+    }
+
+    sb->fs_info = info;
+    sb->flags |= VFS_MNT_RDONLY;
+    sb->s_op = &iso_super_ops;
+    sb->block_size = ISO_BLOCK_SIZE;
+
+    // The root has no parent directory to be cached in
+    struct iso_rr rr;
+    memset(&rr, 0, sizeof(rr));
+    iso_detect_rr(info, rec->extent_le, &rr);
+
+    struct iso_dir root_dir = { 0 };
+    struct iso_extent ext = { rec->extent_le, rec->size_le };
+    struct iso_entry e = {
+        .ino = ISO_FIRST_VD * ISO_BLOCK_SIZE + ISO_PVD_ROOT,
+        .type = VFS_TYPE_DIR,
+        .mode = rr.has_mode ? (rr.mode & 07777) : 0555,
+        .nlink = rr.has_mode && rr.nlink ? rr.nlink : 2,
+        .size = rec->size_le,
+        .mtime = rr.has_mtime ? rr.mtime : iso_time(rec->date),
+        .nextents = 1,
+    };
+    root_dir.extents = &ext;
+
+    err = iso_iget(sb, &root_dir, &e, &sb->root);
+    if (err) {
+        iso_put_super(sb);
+        return err;
+    }
+    return 0;
+}
+
+static const vfs_inode_ops_t iso_inode_ops = {
+    .lookup = iso_lookup,
+};
+
+static const vfs_file_ops_t iso_file_ops = {
+    .readdir = iso_readdir,
+    .readpages = iso_readpages,
+};
+
+static const vfs_super_ops_t iso_super_ops = {
+    .evict_inode = iso_evict_inode,
+    .put_super = iso_put_super,
+};
+
+static vfs_fs_type_t iso_type = {
+    .name = "iso9660",
+    .mount = iso_mount,
+};
+
+void iso9660_init(void) {
+    vfs_register_filesystem(&iso_type);
+}
+
+void iso9660_get_stats(iso9660_stats_t* out) {
+    *out = stats;
+}
+
+void iso9660_reset_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
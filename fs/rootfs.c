@@ -0,0 +1,259 @@
+/**
+ * Root filesystem - Bunix OS
+ *
+ * A minimal in-memory filesystem that backs "/" so there is always a
+ * namespace to mount other filesystems on. Directories are plain linked
+ * lists and file data is a single heap buffer; anything performance
+ * sensitive belongs on tmpfs instead.
+ */
+
+#include "../include/fs/vfs.h"
+#include "../include/mm/kmalloc.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+
+struct rootfs_entry {
+    char name[VFS_NAME_MAX + 1];
+    vfs_inode_t* inode;
+    struct rootfs_entry* next;
+};
+
+struct rootfs_node {
+    struct rootfs_entry* entries;   // Directories: children in creation order
+    uint32_t entry_count;
+    uint8_t* data;                  // Files: contents
+    size_t capacity;
+};
+
+struct rootfs_info {
+    uint32_t next_ino;
+};
+
+static const vfs_inode_ops_t rootfs_inode_ops;
+static const vfs_file_ops_t rootfs_file_ops;
+static const vfs_super_ops_t rootfs_super_ops;
+
+static vfs_inode_t* rootfs_new_inode(vfs_superblock_t* sb, uint32_t type) {
+    struct rootfs_info* info = sb->fs_info;
+    struct rootfs_node* node = kzalloc(sizeof(struct rootfs_node));
+    if (!node) return NULL;
+
+    vfs_inode_t* inode = vfs_inode_alloc(sb, info->next_ino++);
+    if (!inode) {
+        kfree(node);
+        return NULL;
+    }
+
+    inode->type = type;
+    inode->mode = (type == VFS_TYPE_DIR) ? 0755 : 0644;
+    inode->nlink = (type == VFS_TYPE_DIR) ? 2 : 1;
+    inode->i_op = &rootfs_inode_ops;
+    inode->f_op = &rootfs_file_ops;
+    inode->private = node;
+    return inode;
+}
+
+static struct rootfs_entry* rootfs_find(vfs_inode_t* dir, const char* name, size_t len) {
+    struct rootfs_node* node = dir->private;
+    for (struct rootfs_entry* e = node->entries; e; e = e->next) {
+        if (strncmp(e->name, name, len) == 0 && e->name[len] == '\0') return e;
+    }
+    return NULL;
+}
+
+static int rootfs_lookup(vfs_inode_t* dir, const char* name, size_t len, vfs_inode_t** out) {
+    struct rootfs_entry* e = rootfs_find(dir, name, len);
+    if (!e) return -ENOENT;
+    *out = vfs_inode_get(e->inode);
+    return 0;
+}
+
+static int rootfs_create(vfs_inode_t* dir, const char* name, size_t len, uint32_t type, vfs_inode_t** out) {
+    if (rootfs_find(dir, name, len)) return -EEXIST;
+
+    struct rootfs_entry* e = kzalloc(sizeof(struct rootfs_entry));
+    if (!e) return -ENOMEM;
+
+    // The directory entry owns the initial reference
+    vfs_inode_t* inode = rootfs_new_inode(dir->sb, type);
+    if (!inode) {
+        kfree(e);
+        return -ENOMEM;
+    }
+
+    memcpy(e->name, name, len);
+    e->name[len] = '\0';
+    e->inode = inode;
+
+    // Append so readdir lists entries in creation order
+    struct rootfs_node* node = dir->private;
+    struct rootfs_entry** tail = &node->entries;
+    while (*tail) tail = &(*tail)->next;
+    *tail = e;
+    node->entry_count++;
+    dir->size = node->entry_count;
+    if (type == VFS_TYPE_DIR) dir->nlink++;
+
+    *out = vfs_inode_get(inode);
+    return 0;
+}
+
+static int rootfs_unlink(vfs_inode_t* dir, const char* name, size_t len) {
+    struct rootfs_node* node = dir->private;
+    struct rootfs_entry** link = &node->entries;
+
+    while (*link) {
+        struct rootfs_entry* e = *link;
+        if (strncmp(e->name, name, len) == 0 && e->name[len] == '\0') {
+            vfs_inode_t* inode = e->inode;
+            if (inode->type == VFS_TYPE_DIR) {
+                struct rootfs_node* child = inode->private;
+                if (child->entries) return -ENOTEMPTY;
+                dir->nlink--;
+            }
+
+            *link = e->next;
+            node->entry_count--;
+            dir->size = node->entry_count;
+            kfree(e);
+
+            inode->nlink = 0;
+            vfs_inode_put(inode);  // Freed once open files and the dcache let go
+            return 0;
+        }
+        link = &e->next;
+    }
+    return -ENOENT;
+}
+
+static int rootfs_resize(vfs_inode_t* inode, vfs_off_t size) {
+    struct rootfs_node* node = inode->private;
+
+    if (size > node->capacity) {
+        size_t capacity = node->capacity ? node->capacity : 64;
+        while (capacity < size) capacity *= 2;
+
+        uint8_t* data = krealloc(node->data, capacity);
+        if (!data) return -ENOMEM;
+        node->data = data;
+        node->capacity = capacity;
+    }
+
+    if (size > inode->size) memset(node->data + inode->size, 0, size - inode->size);
+    inode->size = size;
+    inode->blocks = (node->capacity + 511) / 512;
+    return 0;
+}
+
+static int rootfs_truncate(vfs_inode_t* inode, vfs_off_t size) {
+    return rootfs_resize(inode, size);
+}
+
+static int rootfs_read(vfs_file_t* file, void* buf, size_t count, vfs_off_t offset) {
+    vfs_inode_t* inode = file->inode;
+    struct rootfs_node* node = inode->private;
+
+    if (offset >= inode->size) return 0;
+    if (count > inode->size - offset) count = inode->size - offset;
+    memcpy(buf, node->data + offset, count);
+    return count;
+}
+
+static int rootfs_write(vfs_file_t* file, const void* buf, size_t count, vfs_off_t offset) {
+    vfs_inode_t* inode = file->inode;
+    struct rootfs_node* node = inode->private;
+
+    if (offset + count > inode->size) {
+        int err = rootfs_resize(inode, offset + count);
+        if (err) return err;
+    }
+    memcpy(node->data + offset, buf, count);
+    return count;
+}
+
+static int rootfs_readdir(vfs_file_t* file, uint32_t index, vfs_dirent_t* out) {
+    struct rootfs_node* node = file->inode->private;
+    struct rootfs_entry* e = node->entries;
+
+    while (e && index--) e = e->next;
+    if (!e) return 0;
+
+    out->ino = e->inode->ino;
+    out->type = e->inode->type;
+    strcpy(out->name, e->name);
+    return 1;
+}
+
+static void rootfs_evict_inode(vfs_inode_t* inode) {
+    struct rootfs_node* node = inode->private;
+    if (!node) return;
+    kfree(node->data);
+    kfree(node);
+    inode->private = NULL;
+}
+
+// Drop the directory-entry references of a whole subtree
+static void rootfs_release_tree(vfs_inode_t* dir) {
+    struct rootfs_node* node = dir->private;
+    struct rootfs_entry* e = node->entries;
+    node->entries = NULL;
+
+    while (e) {
+        struct rootfs_entry* next = e->next;
+        if (e->inode->type == VFS_TYPE_DIR) rootfs_release_tree(e->inode);
+        vfs_inode_put(e->inode);
+        kfree(e);
+        e = next;
+    }
+}
+
+static void rootfs_put_super(vfs_superblock_t* sb) {
+    rootfs_release_tree(sb->root);
+    kfree(sb->fs_info);
+    sb->fs_info = NULL;
+}
+
+static int rootfs_mount(const char* source, uint32_t flags, vfs_superblock_t* sb) {
+    (void)source;
+    (void)flags;
+
+    struct rootfs_info* info = kzalloc(sizeof(struct rootfs_info));
+    if (!info) return -ENOMEM;
+    info->next_ino = 1;
+
+    sb->fs_info = info;
+    sb->s_op = &rootfs_super_ops;
+    sb->root = rootfs_new_inode(sb, VFS_TYPE_DIR);
+    if (!sb->root) {
+        kfree(info);
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+static const vfs_inode_ops_t rootfs_inode_ops = {
+    .lookup = rootfs_lookup,
+    .create = rootfs_create,
+    .unlink = rootfs_unlink,
+    .truncate = rootfs_truncate,
+};
+
+static const vfs_file_ops_t rootfs_file_ops = {
+    .read = rootfs_read,
+    .write = rootfs_write,
+    .readdir = rootfs_readdir,
+};
+
+static const vfs_super_ops_t rootfs_super_ops = {
+    .evict_inode = rootfs_evict_inode,
+    .put_super = rootfs_put_super,
+};
+
+static vfs_fs_type_t rootfs_type = {
+    .name = "rootfs",
+    .mount = rootfs_mount,
+};
+
+void rootfs_init(void) {
+    vfs_register_filesystem(&rootfs_type);
+}
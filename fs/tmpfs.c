@@ -0,0 +1,644 @@
+/**
+ * tmpfs - Bunix OS
+ *
+ * RAM filesystem for scratch data. File contents live in whole pages taken
+ * straight from the page allocator and indexed by a per-file radix tree,
+ * so random access is O(log n) in the file size and holes cost nothing.
+ * Directories are hash tables, with an ordered list kept for readdir.
+ *
+ * tmpfs pages are the kernel's anonymous memory: nothing backs them, so
+ * under memory pressure reclaim compresses them into zram instead of
+ * dropping them. Radix tree entries are tagged in their low bits, which
+ * page-aligned pages and kmalloc'd zram entries both leave clear: a
+ * swapped-out page is a zram entry, and a resident page carries a
+ * referenced bit that the reclaim hand clears and the next access sets.
+ */
+
+#include "../include/fs/vfs.h"
+#include "../include/fs/tmpfs.h"
+#include "../include/mm/vmm.h"
+#include "../include/mm/kmalloc.h"
+#include "../include/mm/zram.h"
+#include "../include/mm/reclaim.h"
+#include "../include/kernel/panic/panic.h"
+#include "../include/lib/radix_tree.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+
+#define TMPFS_MIN_BUCKETS 16
+
+#define TMPFS_SWAPPED     1u            // Entry is a zram_entry_t*
+#define TMPFS_REFERENCED  2u            // Page used since the hand passed
+
+struct tmpfs_dirent {
+    char name[VFS_NAME_MAX + 1];
+    uint32_t len;
+    uint32_t hash;
+    vfs_inode_t* inode;
+    struct tmpfs_dirent* hash_next;
+    struct tmpfs_dirent* next;        // Creation order, for readdir
+    struct tmpfs_dirent* prev;
+};
+
+struct tmpfs_node {
+    // Directories
+    struct tmpfs_dirent** buckets;
+    uint32_t nbuckets;
+    uint32_t nentries;
+    struct tmpfs_dirent* head;
+    struct tmpfs_dirent* tail;
+    uint32_t version;                 // Bumped on unlink, invalidates cursors
+
+    // Regular files
+    struct radix_tree_root pages;
+    uint32_t npages;                  // Resident and swapped
+    struct tmpfs_node* lru_prev;      // All files, for the reclaim hand
+    struct tmpfs_node* lru_next;
+};
+
+// readdir position cached per open directory
+struct tmpfs_cursor {
+    uint32_t version;
+    uint32_t index;
+    struct tmpfs_dirent* entry;
+};
+
+struct tmpfs_info {
+    uint32_t next_ino;
+    uint32_t max_pages;
+    uint32_t used_pages;
+};
+
+static tmpfs_usage_t usage;
+
+// Reclaim hand: a file and the next page index to look at in it
+static struct tmpfs_node* hand_node = NULL;
+static uint32_t hand_index = 0;
+static bool busy = false;             // Page trees mid-update; don't reclaim
+
+static const vfs_inode_ops_t tmpfs_inode_ops;
+static const vfs_file_ops_t tmpfs_file_ops;
+static const vfs_super_ops_t tmpfs_super_ops;
+
+static uint32_t tmpfs_hash(const char* name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// ---------------------------------------------------------------------------
+// Page index
+// ---------------------------------------------------------------------------
+
+static void tmpfs_account_nodes(struct tmpfs_node* node, uint32_t before) {
+    usage.index_nodes += node->pages.nodes - before;
+}
+
+static inline uint8_t* entry_page(void* entry) {
+    return (uint8_t*)((uint32_t)entry & ~(PAGE_SIZE - 1));
+}
+
+static inline bool entry_swapped(void* entry) {
+    return (uint32_t)entry & TMPFS_SWAPPED;
+}
+
+// NULL if there is no memory to decompress into; the page then stays in zram
+static uint8_t* tmpfs_swap_in(struct tmpfs_node* node, uint32_t index, void* entry) {
+    busy = true;
+    uint8_t* page = (uint8_t*)vmm_alloc_pages(1);
+    if (!page) {
+        busy = false;
+        return NULL;
+    }
+    zram_entry_t* z = (zram_entry_t*)((uint32_t)entry & ~TMPFS_SWAPPED);
+    if (zram_load(z, page) != 0) panic("tmpfs: swapped-out page is corrupt");
+
+    radix_tree_replace(&node->pages, index, (void*)((uint32_t)page | TMPFS_REFERENCED));
+    usage.data_pages++;
+    usage.swapped_pages--;
+    usage.swapins++;
+    busy = false;
+    return page;
+}
+
+// Page 'index' of a file in *out, allocating it if 'create'; *out is NULL
+// for a hole when not creating. -ENOSPC when the filesystem is full,
+// -ENOMEM when memory is.
+static int tmpfs_get_page(vfs_inode_t* inode, uint32_t index, bool create, uint8_t** out) {
+    struct tmpfs_node* node = inode->private;
+    void* entry = radix_tree_lookup(&node->pages, index);
+    *out = NULL;
+    if (entry) {
+        if (entry_swapped(entry)) {
+            *out = tmpfs_swap_in(node, index, entry);
+            return *out ? 0 : -ENOMEM;
+        }
+        if (!((uint32_t)entry & TMPFS_REFERENCED)) {
+            radix_tree_replace(&node->pages, index, (void*)((uint32_t)entry | TMPFS_REFERENCED));
+        }
+        *out = entry_page(entry);
+        return 0;
+    }
+    if (!create) return 0;
+
+    struct tmpfs_info* info = inode->sb->fs_info;
+    if (info->used_pages >= info->max_pages) return -ENOSPC;
+
+    busy = true;
+    uint8_t* page = (uint8_t*)vmm_alloc_pages(1);
+    if (!page) {
+        busy = false;
+        return -ENOMEM;
+    }
+    memset(page, 0, PAGE_SIZE);
+
+    uint32_t before = node->pages.nodes;
+    if (radix_tree_insert(&node->pages, index, (void*)((uint32_t)page | TMPFS_REFERENCED)) != 0) {
+        tmpfs_account_nodes(node, before);
+        vmm_free_page((uint32_t*)page);
+        busy = false;
+        return -ENOMEM;
+    }
+    tmpfs_account_nodes(node, before);
+    busy = false;
+
+    node->npages++;
+    info->used_pages++;
+    usage.data_pages++;
+    inode->blocks = node->npages * (PAGE_SIZE / 512);
+    *out = page;
+    return 0;
+}
+
+// Free every page at or beyond first_index
+static void tmpfs_free_pages_from(vfs_inode_t* inode, uint32_t first_index) {
+    struct tmpfs_node* node = inode->private;
+    struct tmpfs_info* info = inode->sb->fs_info;
+    uint32_t index;
+    void* entry;
+
+    busy = true;
+    while ((entry = radix_tree_next(&node->pages, first_index, &index)) != NULL) {
+        uint32_t before = node->pages.nodes;
+        radix_tree_delete(&node->pages, index);
+        tmpfs_account_nodes(node, before);
+        if (entry_swapped(entry)) {
+            zram_free((zram_entry_t*)((uint32_t)entry & ~TMPFS_SWAPPED));
+            usage.swapped_pages--;
+        } else {
+            vmm_free_page((uint32_t*)entry_page(entry));
+            usage.data_pages--;
+        }
+        node->npages--;
+        info->used_pages--;
+    }
+    busy = false;
+    inode->blocks = node->npages * (PAGE_SIZE / 512);
+}
+
+// ---------------------------------------------------------------------------
+// Reclaim
+// ---------------------------------------------------------------------------
+
+static void lru_add(struct tmpfs_node* node) {
+    if (!hand_node) {
+        node->lru_prev = node->lru_next = node;
+        hand_node = node;
+        hand_index = 0;
+        return;
+    }
+    node->lru_next = hand_node;
+    node->lru_prev = hand_node->lru_prev;
+    hand_node->lru_prev->lru_next = node;
+    hand_node->lru_prev = node;
+}
+
+static void lru_remove(struct tmpfs_node* node) {
+    if (node->lru_next == node) {
+        hand_node = NULL;
+    } else {
+        node->lru_prev->lru_next = node->lru_next;
+        node->lru_next->lru_prev = node->lru_prev;
+        if (hand_node == node) {
+            hand_node = node->lru_next;
+            hand_index = 0;
+        }
+    }
+    node->lru_prev = node->lru_next = NULL;
+}
+
+/*
+ * CLOCK over every file's pages in turn: a referenced page loses its bit,
+ * an unreferenced one is compressed into zram and its page freed. A page
+ * zram refuses gets its bit back so the hand passes it over next time.
+ */
+static uint32_t tmpfs_shrink(uint32_t target) {
+    uint32_t budget = 2 * (usage.data_pages + usage.swapped_pages + usage.files) + 1;
+    uint32_t freed = 0;
+
+    if (busy) return 0;
+
+    while (hand_node && freed < target && budget--) {
+        struct tmpfs_node* node = hand_node;
+        uint32_t index;
+        void* entry = radix_tree_next(&node->pages, hand_index, &index);
+        if (!entry) {
+            hand_node = node->lru_next;
+            hand_index = 0;
+            continue;
+        }
+        hand_index = index + 1;
+        if (entry_swapped(entry)) continue;
+
+        uint8_t* page = entry_page(entry);
+        if ((uint32_t)entry & TMPFS_REFERENCED) {
+            radix_tree_replace(&node->pages, index, page);
+            continue;
+        }
+
+        zram_entry_t* z;
+        int err = zram_store(page, &z);
+        if (err == -E2BIG) {
+            radix_tree_replace(&node->pages, index, (void*)((uint32_t)page | TMPFS_REFERENCED));
+            continue;
+        }
+        if (err) break;
+
+        radix_tree_replace(&node->pages, index, (void*)((uint32_t)z | TMPFS_SWAPPED));
+        vmm_free_page((uint32_t*)page);
+        usage.data_pages--;
+        usage.swapped_pages++;
+        usage.swapouts++;
+        freed++;
+    }
+    return freed;
+}
+
+static reclaim_source_t tmpfs_source = {
+    .name = "tmpfs",
+    .shrink = tmpfs_shrink,
+};
+
+// ---------------------------------------------------------------------------
+// Directories
+// ---------------------------------------------------------------------------
+
+static struct tmpfs_dirent* tmpfs_find(vfs_inode_t* dir, const char* name, size_t len) {
+    struct tmpfs_node* node = dir->private;
+    if (!node->nbuckets) return NULL;
+
+    uint32_t hash = tmpfs_hash(name, len);
+    for (struct tmpfs_dirent* d = node->buckets[hash & (node->nbuckets - 1)]; d; d = d->hash_next) {
+        if (d->hash == hash && d->len == len && memcmp(d->name, name, len) == 0) return d;
+    }
+    return NULL;
+}
+
+static int tmpfs_rehash(struct tmpfs_node* node, uint32_t nbuckets) {
+    struct tmpfs_dirent** buckets = kzalloc(nbuckets * sizeof(*buckets));
+    if (!buckets) return -ENOMEM;
+
+    for (struct tmpfs_dirent* d = node->head; d; d = d->next) {
+        uint32_t b = d->hash & (nbuckets - 1);
+        d->hash_next = buckets[b];
+        buckets[b] = d;
+    }
+
+    kfree(node->buckets);
+    node->buckets = buckets;
+    node->nbuckets = nbuckets;
+    return 0;
+}
+
+static vfs_inode_t* tmpfs_new_inode(vfs_superblock_t* sb, uint32_t type) {
+    struct tmpfs_info* info = sb->fs_info;
+    struct tmpfs_node* node = kzalloc(sizeof(struct tmpfs_node));
+    if (!node) return NULL;
+
+    vfs_inode_t* inode = vfs_inode_alloc(sb, info->next_ino++);
+    if (!inode) {
+        kfree(node);
+        return NULL;
+    }
+
+    radix_tree_init(&node->pages);
+    inode->type = type;
+    inode->mode = (type == VFS_TYPE_DIR) ? 01777 : 0644;
+    inode->nlink = (type == VFS_TYPE_DIR) ? 2 : 1;
+    inode->i_op = &tmpfs_inode_ops;
+    inode->f_op = &tmpfs_file_ops;
+    inode->private = node;
+
+    if (type == VFS_TYPE_DIR) {
+        usage.directories++;
+    } else {
+        usage.files++;
+        lru_add(node);
+    }
+    return inode;
+}
+
+static int tmpfs_lookup(vfs_inode_t* dir, const char* name, size_t len, vfs_inode_t** out) {
+    struct tmpfs_dirent* d = tmpfs_find(dir, name, len);
+    if (!d) return -ENOENT;
+    *out = vfs_inode_get(d->inode);
+    return 0;
+}
+
+static int tmpfs_create(vfs_inode_t* dir, const char* name, size_t len, uint32_t type, vfs_inode_t** out) {
+    struct tmpfs_node* node = dir->private;
+
+    if (tmpfs_find(dir, name, len)) return -EEXIST;
+
+    // Keep the load factor at or below one entry per bucket
+    if (node->nentries + 1 > node->nbuckets) {
+        uint32_t nbuckets = node->nbuckets ? node->nbuckets * 2 : TMPFS_MIN_BUCKETS;
+        int err = tmpfs_rehash(node, nbuckets);
+        if (err) return err;
+    }
+
+    struct tmpfs_dirent* d = kzalloc(sizeof(struct tmpfs_dirent));
+    if (!d) return -ENOMEM;
+
+    vfs_inode_t* inode = tmpfs_new_inode(dir->sb, type);
+    if (!inode) {
+        kfree(d);
+        return -ENOMEM;
+    }
+
+    memcpy(d->name, name, len);
+    d->name[len] = '\0';
+    d->len = len;
+    d->hash = tmpfs_hash(name, len);
+    d->inode = inode;   // The entry owns the initial reference
+
+    uint32_t b = d->hash & (node->nbuckets - 1);
+    d->hash_next = node->buckets[b];
+    node->buckets[b] = d;
+
+    d->prev = node->tail;
+    if (node->tail) node->tail->next = d;
+    else node->head = d;
+    node->tail = d;
+
+    node->nentries++;
+    dir->size = node->nentries;
+    if (type == VFS_TYPE_DIR) dir->nlink++;
+
+    *out = vfs_inode_get(inode);
+    return 0;
+}
+
+static void tmpfs_remove_dirent(struct tmpfs_node* node, struct tmpfs_dirent* d) {
+    struct tmpfs_dirent** link = &node->buckets[d->hash & (node->nbuckets - 1)];
+    while (*link != d) link = &(*link)->hash_next;
+    *link = d->hash_next;
+
+    if (d->prev) d->prev->next = d->next;
+    else node->head = d->next;
+    if (d->next) d->next->prev = d->prev;
+    else node->tail = d->prev;
+
+    node->nentries--;
+    node->version++;
+}
+
+static int tmpfs_unlink(vfs_inode_t* dir, const char* name, size_t len) {
+    struct tmpfs_node* node = dir->private;
+    struct tmpfs_dirent* d = tmpfs_find(dir, name, len);
+    if (!d) return -ENOENT;
+
+    vfs_inode_t* inode = d->inode;
+    if (inode->type == VFS_TYPE_DIR) {
+        struct tmpfs_node* child = inode->private;
+        if (child->nentries) return -ENOTEMPTY;
+        dir->nlink--;
+    }
+
+    tmpfs_remove_dirent(node, d);
+    dir->size = node->nentries;
+    kfree(d);
+
+    inode->nlink = 0;
+    vfs_inode_put(inode);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// File data
+// ---------------------------------------------------------------------------
+
+static int tmpfs_truncate(vfs_inode_t* inode, vfs_off_t size) {
+    if (size < inode->size) {
+        // Pages wholly past the new end go back to the allocator now
+        tmpfs_free_pages_from(inode, (size + PAGE_SIZE - 1) / PAGE_SIZE);
+
+        // Zero the tail of a partial last page so a later extend reads zeros
+        uint32_t tail = size % PAGE_SIZE;
+        if (tail) {
+            uint8_t* page;
+            int err = tmpfs_get_page(inode, size / PAGE_SIZE, false, &page);
+            if (err) return err;
+            if (page) memset(page + tail, 0, PAGE_SIZE - tail);
+        }
+    }
+    inode->size = size;
+    return 0;
+}
+
+static int tmpfs_read(vfs_file_t* file, void* buf, size_t count, vfs_off_t offset) {
+    vfs_inode_t* inode = file->inode;
+    uint8_t* out = buf;
+
+    if (offset >= inode->size) return 0;
+    if (count > inode->size - offset) count = inode->size - offset;
+
+    size_t done = 0;
+    while (done < count) {
+        uint32_t pos = offset + done;
+        uint32_t in_page = pos % PAGE_SIZE;
+        size_t chunk = PAGE_SIZE - in_page;
+        if (chunk > count - done) chunk = count - done;
+
+        uint8_t* page;
+        int err = tmpfs_get_page(inode, pos / PAGE_SIZE, false, &page);
+        if (err) return done ? (int)done : err;
+        if (page) memcpy(out + done, page + in_page, chunk);
+        else memset(out + done, 0, chunk);  // Hole
+        done += chunk;
+    }
+    return done;
+}
+
+static int tmpfs_write(vfs_file_t* file, const void* buf, size_t count, vfs_off_t offset) {
+    vfs_inode_t* inode = file->inode;
+    const uint8_t* in = buf;
+
+    if ((uint64_t)offset + count > 0xFFFFFFFFu) return -EFBIG;
+
+    size_t done = 0;
+    int err = 0;
+    while (done < count) {
+        uint32_t pos = offset + done;
+        uint32_t in_page = pos % PAGE_SIZE;
+        size_t chunk = PAGE_SIZE - in_page;
+        if (chunk > count - done) chunk = count - done;
+
+        uint8_t* page;
+        err = tmpfs_get_page(inode, pos / PAGE_SIZE, true, &page);
+        if (err) break;
+        memcpy(page + in_page, in + done, chunk);
+        done += chunk;
+    }
+
+    if (offset + done > inode->size) inode->size = offset + done;
+    if (done == 0 && err) return err;
+    return done;
+}
+
+static int tmpfs_open(vfs_inode_t* inode, vfs_file_t* file) {
+    if (inode->type != VFS_TYPE_DIR) return 0;
+
+    struct tmpfs_cursor* cursor = kzalloc(sizeof(struct tmpfs_cursor));
+    if (!cursor) return -ENOMEM;
+    file->private = cursor;
+    return 0;
+}
+
+static void tmpfs_release(vfs_inode_t* inode, vfs_file_t* file) {
+    (void)inode;
+    kfree(file->private);
+    file->private = NULL;
+}
+
+static int tmpfs_readdir(vfs_file_t* file, uint32_t index, vfs_dirent_t* out) {
+    struct tmpfs_node* node = file->inode->private;
+    struct tmpfs_cursor* cursor = file->private;
+    struct tmpfs_dirent* d;
+
+    // Sequential listing continues from the cached entry
+    if (cursor && cursor->entry && cursor->version == node->version &&
+        cursor->index + 1 == index) {
+        d = cursor->entry->next;
+    } else {
+        d = node->head;
+        for (uint32_t i = 0; d && i < index; i++) d = d->next;
+    }
+    if (!d) return 0;
+
+    if (cursor) {
+        cursor->version = node->version;
+        cursor->index = index;
+        cursor->entry = d;
+    }
+
+    out->ino = d->inode->ino;
+    out->type = d->inode->type;
+    strcpy(out->name, d->name);
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Superblock
+// ---------------------------------------------------------------------------
+
+static void tmpfs_evict_inode(vfs_inode_t* inode) {
+    struct tmpfs_node* node = inode->private;
+    if (!node) return;
+
+    if (inode->type == VFS_TYPE_DIR) {
+        kfree(node->buckets);
+        usage.directories--;
+    } else {
+        tmpfs_free_pages_from(inode, 0);
+        lru_remove(node);
+        usage.files--;
+    }
+    kfree(node);
+    inode->private = NULL;
+}
+
+// Drop the directory-entry references of a whole subtree
+static void tmpfs_release_tree(vfs_inode_t* dir) {
+    struct tmpfs_node* node = dir->private;
+    struct tmpfs_dirent* d = node->head;
+
+    node->head = node->tail = NULL;
+    node->nentries = 0;
+    memset(node->buckets, 0, node->nbuckets * sizeof(*node->buckets));
+
+    while (d) {
+        struct tmpfs_dirent* next = d->next;
+        if (d->inode->type == VFS_TYPE_DIR) tmpfs_release_tree(d->inode);
+        vfs_inode_put(d->inode);
+        kfree(d);
+        d = next;
+    }
+}
+
+static void tmpfs_put_super(vfs_superblock_t* sb) {
+    tmpfs_release_tree(sb->root);
+    kfree(sb->fs_info);
+    sb->fs_info = NULL;
+}
+
+static int tmpfs_mount(const char* source, uint32_t flags, vfs_superblock_t* sb) {
+    (void)source;
+    (void)flags;
+
+    struct tmpfs_info* info = kzalloc(sizeof(struct tmpfs_info));
+    if (!info) return -ENOMEM;
+
+    // Cap at half the memory free at mount time so a runaway writer
+    // gets -ENOSPC instead of driving the page allocator into a panic
+    info->next_ino = 1;
+    info->max_pages = vmm_get_free_pages() / 2;
+
+    sb->fs_info = info;
+    sb->s_op = &tmpfs_super_ops;
+    sb->block_size = PAGE_SIZE;
+    sb->root = tmpfs_new_inode(sb, VFS_TYPE_DIR);
+    if (!sb->root) {
+        kfree(info);
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+static const vfs_inode_ops_t tmpfs_inode_ops = {
+    .lookup = tmpfs_lookup,
+    .create = tmpfs_create,
+    .unlink = tmpfs_unlink,
+    .truncate = tmpfs_truncate,
+};
+
+static const vfs_file_ops_t tmpfs_file_ops = {
+    .open = tmpfs_open,
+    .release = tmpfs_release,
+    .read = tmpfs_read,
+    .write = tmpfs_write,
+    .readdir = tmpfs_readdir,
+};
+
+static const vfs_super_ops_t tmpfs_super_ops = {
+    .evict_inode = tmpfs_evict_inode,
+    .put_super = tmpfs_put_super,
+};
+
+static vfs_fs_type_t tmpfs_type = {
+    .name = "tmpfs",
+    .mount = tmpfs_mount,
+};
+
+void tmpfs_init(void) {
+    memset(&usage, 0, sizeof(usage));
+    reclaim_register(&tmpfs_source);
+    vfs_register_filesystem(&tmpfs_type);
+}
+
+void tmpfs_get_usage(tmpfs_usage_t* out) {
+    *out = usage;
+}
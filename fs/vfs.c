@@ -0,0 +1,679 @@
+/**
+ * Virtual File System - Bunix OS
+ *
+ * Filesystem registry, mount table, inode cache, path resolution and the
+ * system-wide open file table.
+ */
+
+#include "../include/fs/vfs.h"
+#include "../include/fs/dcache.h"
+#include "../include/fs/tmpfs.h"
+#include "../include/fs/fat32.h"
+#include "../include/fs/ext2.h"
+#include "../include/fs/iso9660.h"
+#include "../include/mm/kmalloc.h"
+#include "../include/mm/filemap.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+#include "../include/kernel/panic/panic.h"
+#include "../include/kernel/panic/debug.h"
+#include "../include/version/version.h"
+
+#define ICACHE_BUCKETS 256
+
+static vfs_fs_type_t* fs_types = NULL;
+static vfs_superblock_t* mounts[VFS_MAX_MOUNTS];
+static vfs_superblock_t* root_sb = NULL;
+static vfs_file_t file_table[VFS_MAX_FILES];
+static vfs_inode_t* inode_hash[ICACHE_BUCKETS];
+static uint32_t next_dev = 1;
+
+// ---------------------------------------------------------------------------
+// Inode cache
+// ---------------------------------------------------------------------------
+
+static inline uint32_t icache_bucket(const vfs_superblock_t* sb, uint32_t ino) {
+    return (((uint32_t)sb >> 4) ^ (ino * 2654435761u)) % ICACHE_BUCKETS;
+}
+
+static void icache_unhash(vfs_inode_t* inode) {
+    vfs_inode_t** link = &inode_hash[icache_bucket(inode->sb, inode->ino)];
+    while (*link && *link != inode) link = &(*link)->hash_next;
+    if (*link) *link = inode->hash_next;
+    inode->hash_next = NULL;
+}
+
+// Drop whatever the filesystem left behind after put_super
+static void icache_purge_sb(const vfs_superblock_t* sb) {
+    for (int b = 0; b < ICACHE_BUCKETS; b++) {
+        vfs_inode_t** link = &inode_hash[b];
+        while (*link) {
+            vfs_inode_t* inode = *link;
+            if (inode->sb == sb) {
+                *link = inode->hash_next;
+                filemap_evict(inode);
+                kfree(inode);
+            } else {
+                link = &inode->hash_next;
+            }
+        }
+    }
+}
+
+vfs_inode_t* vfs_inode_alloc(vfs_superblock_t* sb, uint32_t ino) {
+    vfs_inode_t* inode = kzalloc(sizeof(vfs_inode_t));
+    if (!inode) return NULL;
+
+    inode->sb = sb;
+    inode->ino = ino;
+    inode->refcount = 1;
+    inode->nlink = 1;
+
+    uint32_t b = icache_bucket(sb, ino);
+    inode->hash_next = inode_hash[b];
+    inode_hash[b] = inode;
+    return inode;
+}
+
+vfs_inode_t* vfs_inode_find(vfs_superblock_t* sb, uint32_t ino) {
+    for (vfs_inode_t* inode = inode_hash[icache_bucket(sb, ino)]; inode; inode = inode->hash_next) {
+        if (inode->sb == sb && inode->ino == ino) {
+            return vfs_inode_get(inode);
+        }
+    }
+    return NULL;
+}
+
+vfs_inode_t* vfs_inode_get(vfs_inode_t* inode) {
+    if (inode) inode->refcount++;
+    return inode;
+}
+
+void vfs_inode_put(vfs_inode_t* inode) {
+    if (!inode) return;
+    if (inode->refcount == 0) panic("vfs: inode reference underflow");
+    if (--inode->refcount > 0) return;
+
+    icache_unhash(inode);
+    dcache_purge_parent(inode);
+    filemap_evict(inode);
+    if (inode->sb->s_op && inode->sb->s_op->evict_inode) {
+        inode->sb->s_op->evict_inode(inode);
+    }
+    kfree(inode);
+}
+
+// ---------------------------------------------------------------------------
+// Path resolution
+// ---------------------------------------------------------------------------
+
+// Look up one component, consulting the dentry cache first
+static int lookup_component(vfs_inode_t* dir, const char* name, size_t len, vfs_inode_t** out) {
+    vfs_inode_t* inode = NULL;
+    int err;
+
+    if (dir->type != VFS_TYPE_DIR || !dir->i_op || !dir->i_op->lookup) {
+        return -ENOTDIR;
+    }
+
+    if (dcache_is_enabled()) {
+        uint32_t hash = dcache_hash(dir, name, len);
+        dentry_t* d = dcache_lookup(dir, name, len, hash);
+        if (d) {
+            if (!d->inode) return -ENOENT;
+            inode = vfs_inode_get(d->inode);
+        } else {
+            err = dir->i_op->lookup(dir, name, len, &inode);
+            if (err == -ENOENT) dcache_insert(dir, name, len, hash, NULL);
+            if (err) return err;
+            dcache_insert(dir, name, len, hash, inode);
+        }
+    } else {
+        err = dir->i_op->lookup(dir, name, len, &inode);
+        if (err) return err;
+    }
+
+    // Step onto whatever is mounted here
+    while (inode->mounted) {
+        vfs_inode_t* root = vfs_inode_get(inode->mounted->root);
+        vfs_inode_put(inode);
+        inode = root;
+    }
+
+    *out = inode;
+    return 0;
+}
+
+/*
+ * Walk an absolute path. ".." is handled lexically with a stack of the
+ * directories visited so far, which also makes it cross mount points.
+ * With last != NULL the final component is not looked up; its name is
+ * returned instead and *out is the directory that should contain it.
+ */
+static int path_walk(const char* path, vfs_inode_t** out, const char** last, size_t* last_len) {
+    vfs_inode_t* stack[VFS_MAX_DEPTH];
+    int depth = 0;
+    int err = 0;
+
+    if (!path) return -EINVAL;
+    if (!root_sb) return -ENOENT;
+    if (strlen(path) >= VFS_PATH_MAX) return -ENAMETOOLONG;
+    if (last) *last = NULL;
+
+    stack[0] = vfs_inode_get(root_sb->root);
+    const char* p = path;
+
+    for (;;) {
+        while (*p == '/') p++;
+        if (!*p) break;
+
+        const char* name = p;
+        while (*p && *p != '/') p++;
+        size_t len = p - name;
+
+        if (len > VFS_NAME_MAX) {
+            err = -ENAMETOOLONG;
+            break;
+        }
+
+        if (last) {
+            const char* rest = p;
+            while (*rest == '/') rest++;
+            if (!*rest) {
+                *last = name;
+                *last_len = len;
+                break;
+            }
+        }
+
+        if (len == 1 && name[0] == '.') continue;
+        if (len == 2 && name[0] == '.' && name[1] == '.') {
+            if (depth > 0) vfs_inode_put(stack[depth--]);
+            continue;
+        }
+
+        if (depth + 1 >= VFS_MAX_DEPTH) {
+            err = -ENAMETOOLONG;
+            break;
+        }
+
+        vfs_inode_t* next;
+        err = lookup_component(stack[depth], name, len, &next);
+        if (err) break;
+        stack[++depth] = next;
+    }
+
+    if (!err && last) {
+        if (!*last) err = -EEXIST;  // Path names the root directory
+        else if ((*last_len == 1 && (*last)[0] == '.') ||
+                 (*last_len == 2 && (*last)[0] == '.' && (*last)[1] == '.')) {
+            err = -EINVAL;
+        } else if (stack[depth]->type != VFS_TYPE_DIR) {
+            err = -ENOTDIR;
+        }
+    }
+
+    if (err) {
+        while (depth >= 0) vfs_inode_put(stack[depth--]);
+        return err;
+    }
+
+    *out = stack[depth];
+    while (--depth >= 0) vfs_inode_put(stack[depth]);
+    return 0;
+}
+
+int vfs_resolve(const char* path, vfs_inode_t** out) {
+    return path_walk(path, out, NULL, NULL);
+}
+
+static int create_at(const char* path, uint32_t type, vfs_inode_t** out) {
+    vfs_inode_t* dir;
+    const char* name;
+    size_t len;
+
+    int err = path_walk(path, &dir, &name, &len);
+    if (err) return err;
+
+    if (dir->sb->flags & VFS_MNT_RDONLY) {
+        err = -EROFS;
+    } else if (!dir->i_op->create) {
+        err = -EPERM;
+    } else {
+        err = dir->i_op->create(dir, name, len, type, out);
+        if (!err) dcache_insert(dir, name, len, dcache_hash(dir, name, len), *out);
+    }
+
+    vfs_inode_put(dir);
+    return err;
+}
+
+// ---------------------------------------------------------------------------
+// Filesystem registry and mounts
+// ---------------------------------------------------------------------------
+
+int vfs_register_filesystem(vfs_fs_type_t* fs) {
+    if (vfs_find_filesystem(fs->name)) return -EEXIST;
+    fs->next = fs_types;
+    fs_types = fs;
+    return 0;
+}
+
+vfs_fs_type_t* vfs_find_filesystem(const char* name) {
+    for (vfs_fs_type_t* fs = fs_types; fs; fs = fs->next) {
+        if (strcmp(fs->name, name) == 0) return fs;
+    }
+    return NULL;
+}
+
+int vfs_mount(const char* fstype, const char* source, const char* target, uint32_t flags) {
+    vfs_fs_type_t* fs = vfs_find_filesystem(fstype);
+    if (!fs) return -ENODEV;
+
+    int slot = -1;
+    for (int i = 0; i < VFS_MAX_MOUNTS; i++) {
+        if (!mounts[i]) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) return -EBUSY;
+
+    vfs_inode_t* covered = NULL;
+    if (root_sb) {
+        int err = vfs_resolve(target, &covered);
+        if (err) return err;
+        if (covered->type != VFS_TYPE_DIR) {
+            vfs_inode_put(covered);
+            return -ENOTDIR;
+        }
+    } else if (strcmp(target, "/") != 0) {
+        return -ENOENT;
+    }
+
+    vfs_superblock_t* sb = kzalloc(sizeof(vfs_superblock_t));
+    if (!sb) {
+        vfs_inode_put(covered);
+        return -ENOMEM;
+    }
+
+    sb->type = fs;
+    sb->flags = flags;
+    sb->dev = next_dev++;
+    sb->block_size = 512;
+    strncpy(sb->source, source ? source : "none", sizeof(sb->source) - 1);
+    strncpy(sb->target, target, sizeof(sb->target) - 1);
+
+    int err = fs->mount(source, flags, sb);
+    if (err) {
+        kfree(sb);
+        vfs_inode_put(covered);
+        return err;
+    }
+
+    sb->covered = covered;  // Keeps its reference while mounted
+    if (covered) covered->mounted = sb;
+    else root_sb = sb;
+    mounts[slot] = sb;
+    return 0;
+}
+
+int vfs_umount(const char* target) {
+    vfs_inode_t* inode;
+    int err = vfs_resolve(target, &inode);
+    if (err) return err;
+
+    int slot = -1;
+    for (int i = 0; i < VFS_MAX_MOUNTS; i++) {
+        if (mounts[i] && mounts[i]->root == inode) {
+            slot = i;
+            break;
+        }
+    }
+    vfs_inode_put(inode);
+
+    if (slot < 0) return -EINVAL;
+    vfs_superblock_t* sb = mounts[slot];
+    if (sb == root_sb) return -EBUSY;
+
+    for (int fd = 0; fd < VFS_MAX_FILES; fd++) {
+        if (file_table[fd].inode && file_table[fd].inode->sb == sb) return -EBUSY;
+    }
+    for (int i = 0; i < VFS_MAX_MOUNTS; i++) {
+        if (mounts[i] && mounts[i]->covered && mounts[i]->covered->sb == sb) return -EBUSY;
+    }
+
+    dcache_purge_sb(sb);
+    if (sb->s_op && sb->s_op->sync) sb->s_op->sync(sb);
+
+    sb->covered->mounted = NULL;
+    vfs_inode_put(sb->covered);
+    if (sb->s_op && sb->s_op->put_super) sb->s_op->put_super(sb);
+    vfs_inode_put(sb->root);
+    icache_purge_sb(sb);
+
+    mounts[slot] = NULL;
+    kfree(sb);
+    return 0;
+}
+
+vfs_superblock_t* vfs_get_mount(int index) {
+    if (index < 0 || index >= VFS_MAX_MOUNTS) return NULL;
+    return mounts[index];
+}
+
+// ---------------------------------------------------------------------------
+// File descriptors
+// ---------------------------------------------------------------------------
+
+vfs_file_t* vfs_get_file(int fd) {
+    if (fd < VFS_FIRST_FD || fd >= VFS_MAX_FILES) return NULL;
+    if (!file_table[fd].inode) return NULL;
+    return &file_table[fd];
+}
+
+static bool file_readable(const vfs_file_t* file) {
+    return (file->flags & O_ACCMODE) != O_WRONLY;
+}
+
+static bool file_writable(const vfs_file_t* file) {
+    return (file->flags & O_ACCMODE) != O_RDONLY;
+}
+
+// Cached pages past the new end must go with the data they held
+static int truncate_inode(vfs_inode_t* inode, vfs_off_t size) {
+    int err = inode->i_op->truncate(inode, size);
+    if (!err) filemap_truncate(inode, size);
+    return err;
+}
+
+int vfs_open(const char* path, uint32_t flags) {
+    vfs_inode_t* inode;
+    int err = vfs_resolve(path, &inode);
+    if (err == -ENOENT && (flags & O_CREAT)) {
+        err = create_at(path, VFS_TYPE_FILE, &inode);
+    }
+    if (err) return err;
+
+    bool write = (flags & O_ACCMODE) != O_RDONLY;
+    if ((flags & O_DIRECTORY) && inode->type != VFS_TYPE_DIR) err = -ENOTDIR;
+    else if (inode->type == VFS_TYPE_DIR && write) err = -EISDIR;
+    else if (write && (inode->sb->flags & VFS_MNT_RDONLY)) err = -EROFS;
+    if (err) {
+        vfs_inode_put(inode);
+        return err;
+    }
+
+    int fd = -1;
+    for (int i = VFS_FIRST_FD; i < VFS_MAX_FILES; i++) {
+        if (!file_table[i].inode) {
+            fd = i;
+            break;
+        }
+    }
+    if (fd < 0) {
+        vfs_inode_put(inode);
+        return -ENFILE;
+    }
+
+    vfs_file_t* file = &file_table[fd];
+    file->inode = inode;
+    file->f_op = inode->f_op;
+    file->pos = 0;
+    file->flags = flags;
+    file->refcount = 1;
+    file->private = NULL;
+
+    if (file->f_op && file->f_op->open) {
+        err = file->f_op->open(inode, file);
+        if (err) {
+            file->inode = NULL;
+            vfs_inode_put(inode);
+            return err;
+        }
+    }
+
+    if ((flags & O_TRUNC) && write && inode->type == VFS_TYPE_FILE && inode->i_op->truncate) {
+        truncate_inode(inode, 0);
+    }
+
+    return fd;
+}
+
+int vfs_close(int fd) {
+    vfs_file_t* file = vfs_get_file(fd);
+    if (!file) return -EBADF;
+    if (--file->refcount > 0) return 0;
+
+    if (file->f_op && file->f_op->release) file->f_op->release(file->inode, file);
+    vfs_inode_put(file->inode);
+    memset(file, 0, sizeof(*file));
+    return 0;
+}
+
+int vfs_read(int fd, void* buf, size_t count) {
+    vfs_file_t* file = vfs_get_file(fd);
+    if (!file || !file_readable(file)) return -EBADF;
+    if (file->inode->type == VFS_TYPE_DIR) return -EISDIR;
+    if (!file->f_op || (!file->f_op->read && !file->f_op->readpages)) return -EINVAL;
+
+    int n;
+    if (file->f_op->readpages && file->inode->type == VFS_TYPE_FILE) {
+        n = filemap_read(file->inode, buf, count, file->pos);
+    } else if (file->f_op->read) {
+        n = file->f_op->read(file, buf, count, file->pos);
+    } else {
+        n = file->f_op->readpages(file->inode, buf, count, file->pos);
+    }
+    if (n > 0) file->pos += n;
+    return n;
+}
+
+int vfs_write(int fd, const void* buf, size_t count) {
+    vfs_file_t* file = vfs_get_file(fd);
+    if (!file || !file_writable(file)) return -EBADF;
+    if (!file->f_op || !file->f_op->write) return -EINVAL;
+
+    if (file->flags & O_APPEND) file->pos = file->inode->size;
+    int n = file->f_op->write(file, buf, count, file->pos);
+    if (n > 0) {
+        filemap_write(file->inode, buf, n, file->pos);
+        file->pos += n;
+    }
+    return n;
+}
+
+int vfs_lseek(int fd, int32_t offset, int whence) {
+    vfs_file_t* file = vfs_get_file(fd);
+    if (!file) return -EBADF;
+
+    int32_t base;
+    switch (whence) {
+        case SEEK_SET: base = 0; break;
+        case SEEK_CUR: base = file->pos; break;
+        case SEEK_END: base = file->inode->size; break;
+        default: return -EINVAL;
+    }
+    if (base + offset < 0) return -EINVAL;
+
+    file->pos = base + offset;
+    return file->pos;
+}
+
+int vfs_readdir(int fd, vfs_dirent_t* out) {
+    vfs_file_t* file = vfs_get_file(fd);
+    if (!file) return -EBADF;
+    if (file->inode->type != VFS_TYPE_DIR) return -ENOTDIR;
+    if (!file->f_op || !file->f_op->readdir) return -EINVAL;
+
+    int ret = file->f_op->readdir(file, file->pos, out);
+    if (ret > 0) file->pos++;
+    return ret;
+}
+
+void vfs_fill_stat(vfs_inode_t* inode, vfs_stat_t* st) {
+    st->dev = inode->sb->dev;
+    st->ino = inode->ino;
+    st->type = inode->type;
+    st->mode = inode->mode;
+    st->nlink = inode->nlink;
+    st->size = inode->size;
+    st->blocks = inode->blocks;
+    st->blksize = inode->sb->block_size;
+    st->mtime = inode->mtime;
+}
+
+int vfs_fstat(int fd, vfs_stat_t* st) {
+    vfs_file_t* file = vfs_get_file(fd);
+    if (!file) return -EBADF;
+    vfs_fill_stat(file->inode, st);
+    return 0;
+}
+
+int vfs_ftruncate(int fd, vfs_off_t size) {
+    vfs_file_t* file = vfs_get_file(fd);
+    if (!file || !file_writable(file)) return -EBADF;
+    if (file->inode->type == VFS_TYPE_DIR) return -EISDIR;
+    if (!file->inode->i_op->truncate) return -EPERM;
+    return truncate_inode(file->inode, size);
+}
+
+// ---------------------------------------------------------------------------
+// Path-based operations
+// ---------------------------------------------------------------------------
+
+int vfs_stat(const char* path, vfs_stat_t* st) {
+    vfs_inode_t* inode;
+    int err = vfs_resolve(path, &inode);
+    if (err) return err;
+    vfs_fill_stat(inode, st);
+    vfs_inode_put(inode);
+    return 0;
+}
+
+int vfs_mkdir(const char* path) {
+    vfs_inode_t* inode;
+    int err = create_at(path, VFS_TYPE_DIR, &inode);
+    if (err) return err;
+    vfs_inode_put(inode);
+    return 0;
+}
+
+int vfs_unlink(const char* path) {
+    vfs_inode_t* dir;
+    const char* name;
+    size_t len;
+
+    int err = path_walk(path, &dir, &name, &len);
+    if (err) return err;
+
+    vfs_inode_t* victim;
+    err = lookup_component(dir, name, len, &victim);
+    if (!err) {
+        if (victim->sb != dir->sb) err = -EBUSY;  // Mount point
+        vfs_inode_put(victim);
+    }
+
+    if (!err) {
+        if (dir->sb->flags & VFS_MNT_RDONLY) err = -EROFS;
+        else if (!dir->i_op->unlink) err = -EPERM;
+        else err = dir->i_op->unlink(dir, name, len);
+    }
+
+    // Remember the name is gone; this also drops the cached reference
+    if (!err) dcache_insert(dir, name, len, dcache_hash(dir, name, len), NULL);
+
+    vfs_inode_put(dir);
+    return err;
+}
+
+int vfs_truncate(const char* path, vfs_off_t size) {
+    vfs_inode_t* inode;
+    int err = vfs_resolve(path, &inode);
+    if (err) return err;
+
+    if (inode->type == VFS_TYPE_DIR) err = -EISDIR;
+    else if (inode->sb->flags & VFS_MNT_RDONLY) err = -EROFS;
+    else if (!inode->i_op->truncate) err = -EPERM;
+    else err = truncate_inode(inode, size);
+
+    vfs_inode_put(inode);
+    return err;
+}
+
+const char* vfs_strerror(int err) {
+    switch (-err) {
+        case 0:            return "Success";
+        case EPERM:        return "Operation not permitted";
+        case ENOENT:       return "No such file or directory";
+        case EIO:          return "I/O error";
+        case EBADF:        return "Bad file descriptor";
+        case ENOMEM:       return "Out of memory";
+        case EBUSY:        return "Device or resource busy";
+        case EEXIST:       return "File exists";
+        case ENODEV:       return "No such device";
+        case ENOTDIR:      return "Not a directory";
+        case EISDIR:       return "Is a directory";
+        case EINVAL:       return "Invalid argument";
+        case ENFILE:       return "Too many open files";
+        case EFBIG:        return "File too large";
+        case ENOSPC:       return "No space left on device";
+        case EROFS:        return "Read-only file system";
+        case ENAMETOOLONG: return "File name too long";
+        case ENOTEMPTY:    return "Directory not empty";
+        case EPIPE:        return "Broken pipe";
+        case EMSGSIZE:     return "Message too long";
+        case EADDRINUSE:   return "Address already in use";
+        case ENETUNREACH:  return "Network is unreachable";
+        case ECONNRESET:   return "Connection reset by peer";
+        case ENOBUFS:      return "No buffer space available";
+        case ENOTCONN:     return "Socket is not connected";
+        case ETIMEDOUT:    return "Operation timed out";
+        case ECONNREFUSED: return "Connection refused";
+        default:           return "Unknown error";
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Initialization
+// ---------------------------------------------------------------------------
+
+static void write_text_file(const char* path, const char* text) {
+    int fd = vfs_open(path, O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd < 0) return;
+    vfs_write(fd, text, strlen(text));
+    vfs_close(fd);
+}
+
+void vfs_init(void) {
+    memset(mounts, 0, sizeof(mounts));
+    memset(file_table, 0, sizeof(file_table));
+    memset(inode_hash, 0, sizeof(inode_hash));
+    root_sb = NULL;
+
+    dcache_init();
+    rootfs_init();
+    tmpfs_init();
+    fat32_init();
+    ext2_init();
+    iso9660_init();
+
+    if (vfs_mount("rootfs", "rootfs", "/", 0) != 0) {
+        panic("vfs: unable to mount root filesystem");
+    }
+
+    // Standard hierarchy
+    vfs_mkdir("/dev");
+    vfs_mkdir("/etc");
+    vfs_mkdir("/mnt");
+    vfs_mkdir("/cdrom");
+    vfs_mkdir("/tmp");
+
+    if (vfs_mount("tmpfs", "tmpfs", "/tmp", 0) != 0) {
+        DEBUG_WARN("vfs: unable to mount tmpfs on /tmp");
+    }
+
+    write_text_file("/etc/hostname", BUNIX_NAME "\n");
+    write_text_file("/etc/version", BUNIX_NAME " " BUNIX_VERSION " (" BUNIX_ARCH ")\n");
+    write_text_file("/etc/motd", "Welcome to " BUNIX_NAME "!\n");
+}
@@ -0,0 +1,18 @@
+#ifndef ATA_H
+#define ATA_H
+
+#include <stdint.h>
+
+#include "blkdev.h"
+
+// Probe the PCI IDE controller and register its disks and CD drives as
+// hda..hdd. Returns the number of drives found.
+int ata_init(void);
+
+// First CD drive with a disc in it, NULL if there is none
+blkdev_t* ata_cdrom(void);
+
+// Interrupts taken per channel, for diskbench
+uint32_t ata_get_irq_count(int channel);
+
+#endif // ATA_H
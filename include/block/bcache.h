@@ -0,0 +1,89 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "blkdev.h"
+
+/**
+ * Block buffer cache
+ *
+ * Filesystems read and write device blocks through referenced buffers
+ * keyed by (device, block number, block size). A device should be used
+ * with one block size at a time; buffers of different sizes never alias.
+ * Replacement is CLOCK: a hit sets the buffer's reference bit and the
+ * hand clears bits until it finds an unreferenced, unpinned buffer.
+ *
+ * Dirty buffers are written back on eviction, on bcache_sync(), and by
+ * the flusher once they have been dirty for BCACHE_DIRTY_EXPIRE_MS.
+ * Sequential reads grow a per-device read-ahead window; random reads
+ * shrink it again.
+ */
+
+#define BCACHE_MIN_PAGES         64          // Cache budget bounds
+#define BCACHE_MAX_PAGES         1024
+#define BCACHE_RA_MIN_BYTES      (16 * 1024)
+#define BCACHE_RA_MAX_BYTES      (128 * 1024)
+#define BCACHE_DIRTY_EXPIRE_MS   5000
+#define BCACHE_FLUSH_INTERVAL_MS 1000
+
+// Buffer flags
+#define BUF_VALID       0x01        // Data matches (or supersedes) the disk
+#define BUF_DIRTY       0x02
+#define BUF_IO          0x04        // Read in flight
+#define BUF_ERROR       0x08        // Last read failed
+#define BUF_REFERENCED  0x10        // CLOCK reference bit
+#define BUF_READAHEAD   0x20        // Prefetched, not used yet
+
+typedef struct buffer buffer_t;
+
+struct buffer {
+    blkdev_t* dev;
+    uint64_t block;
+    uint32_t size;                  // Bytes, a multiple of 512 up to a page
+    uint8_t* data;
+    volatile uint32_t flags;
+    uint32_t refcount;
+    uint64_t dirty_tsc;             // When it last went from clean to dirty
+    buffer_t* hash_next;
+    buffer_t* clock_prev;
+    buffer_t* clock_next;
+};
+
+typedef struct {
+    uint32_t lookups;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t ra_blocks;             // Blocks prefetched
+    uint32_t ra_used;               // Prefetched blocks that were later read
+    uint32_t ra_wasted;             // Prefetched blocks evicted unread
+    uint32_t evictions;
+    uint32_t writebacks;
+    uint32_t buffers;
+    uint32_t dirty;
+    uint32_t bytes;
+    uint32_t budget;                // Bytes the cache tries to stay under
+} bcache_stats_t;
+
+void bcache_init(void);
+
+// Referenced buffer holding the block's contents
+int bcache_read(blkdev_t* dev, uint64_t block, uint32_t size, buffer_t** out);
+// Referenced buffer the caller will overwrite completely; no disk read
+int bcache_get_new(blkdev_t* dev, uint64_t block, uint32_t size, buffer_t** out);
+void bcache_release(buffer_t* buf);
+void bcache_mark_dirty(buffer_t* buf);
+
+// Write back dirty buffers and flush the device cache (NULL: every device)
+int bcache_sync(blkdev_t* dev);
+int bcache_sync_buffer(buffer_t* buf);
+// Write back, then drop every unreferenced buffer of the device
+int bcache_invalidate(blkdev_t* dev);
+// Drop a block its filesystem just freed, discarding unwritten changes
+void bcache_forget(blkdev_t* dev, uint64_t block, uint32_t size);
+
+void bcache_get_stats(bcache_stats_t* stats);
+void bcache_reset_stats(void);
+
+#endif // BCACHE_H
@@ -0,0 +1,162 @@
+#ifndef BLKDEV_H
+#define BLKDEV_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Block devices
+ *
+ * Drivers register a blkdev_t and accept asynchronous requests through
+ * ops->submit. Completion is reported from interrupt context with
+ * blk_request_complete(); callers either pass a completion callback or
+ * sleep in blkdev_wait(). Buffers are physical addresses (the kernel runs
+ * identity mapped) and must be at least 2-byte aligned. A request either
+ * names one contiguous buffer or carries a scatter list of segments.
+ *
+ * Submitted requests pass through a per-device request queue: an I/O
+ * scheduler (elevator) orders them, adjacent ones are merged into one
+ * driver request, and at most queue_depth driver requests are
+ * outstanding. Between blk_start_plug() and blk_finish_plug() requests
+ * are held back so a burst reaches the scheduler, and can merge, as one.
+ */
+
+#define BLKDEV_MAX        8
+#define BLKDEV_NAME_MAX   16
+#define BLK_SECTOR_SIZE   512
+
+#define BLK_OP_READ       0
+#define BLK_OP_WRITE      1
+#define BLK_OP_FLUSH      2
+
+#define BLK_REQ_MERGED    0x0001    // Driver request standing for several
+#define BLK_PLUG_MAX      32        // Held requests before a plug drains
+#define BLK_LAT_BUCKETS   24        // Bucket i: latency below 2^i us
+#define BLK_DEFAULT_ELEVATOR "deadline"
+
+typedef struct blkdev blkdev_t;
+typedef struct blk_request blk_request_t;
+
+typedef void (*blk_complete_t)(blk_request_t* req);
+
+typedef struct {
+    void* addr;
+    uint32_t len;               // Bytes, a multiple of 512
+} blk_segment_t;
+
+struct blk_request {
+    blkdev_t* dev;
+    uint32_t op;
+    uint64_t lba;               // First sector
+    uint32_t count;             // Sectors
+    void* buffer;               // Used when nr_segs is 0
+    const blk_segment_t* segs;  // Otherwise these cover count sectors
+    uint16_t nr_segs;
+    volatile int status;        // 0 or -errno, valid once done
+    volatile bool done;
+    blk_complete_t complete;    // Runs in interrupt context, may be NULL
+    void* private;              // Owned by the submitter
+    blk_request_t* next;        // Owned by the driver while queued
+    uint64_t start_tsc;
+    uint32_t flags;
+    // Owned by the request queue and its scheduler until dispatch
+    blk_request_t* q_next;
+    blk_request_t* q_prev;
+    blk_request_t* fifo_next;
+    blk_request_t* fifo_prev;
+};
+
+typedef struct {
+    int (*submit)(blkdev_t* dev, blk_request_t* req);
+} blkdev_ops_t;
+
+typedef struct {
+    uint32_t reads;
+    uint32_t writes;
+    uint64_t read_sectors;
+    uint64_t write_sectors;
+    uint32_t flushes;
+    uint32_t errors;
+    uint32_t in_flight;
+    uint32_t doorbells;         // Times the driver notified the hardware
+    uint32_t merges;            // Requests folded into another one
+    uint32_t dispatched;        // Requests handed to the driver
+    uint32_t read_latency[BLK_LAT_BUCKETS];
+    uint32_t write_latency[BLK_LAT_BUCKETS];
+} blkdev_stats_t;
+
+typedef struct elevator_type elevator_type_t;
+
+typedef struct {
+    const elevator_type_t* elevator;
+    void* elevator_data;
+    blk_request_t* dispatch_head;   // Bypass the scheduler (flushes)
+    blk_request_t* dispatch_tail;
+    uint32_t queued;                // In the scheduler or dispatch list
+    uint32_t in_driver;             // Dispatched, not yet completed
+    bool running;
+    bool rerun;
+} blk_queue_t;
+
+typedef struct {
+    blk_request_t* head;
+    blk_request_t* tail;
+    uint32_t count;
+} blk_plug_t;
+
+struct blkdev {
+    char name[BLKDEV_NAME_MAX];
+    uint32_t sector_size;
+    uint64_t sectors;
+    uint32_t max_sectors;       // Largest single request the driver accepts
+    uint16_t max_segments;      // Longest scatter list the driver accepts
+    uint32_t queue_depth;       // Requests the hardware keeps in flight
+    const blkdev_ops_t* ops;
+    void* private;
+    blkdev_stats_t stats;
+    blk_queue_t queue;
+};
+
+// View any request as a scatter list; 'single' backs the one-buffer case
+static inline uint16_t blk_request_segments(const blk_request_t* req, const blk_segment_t** segs,
+                                            blk_segment_t* single) {
+    if (req->nr_segs) {
+        *segs = req->segs;
+        return req->nr_segs;
+    }
+    single->addr = req->buffer;
+    single->len = req->count * BLK_SECTOR_SIZE;
+    *segs = single;
+    return 1;
+}
+
+void blkdev_init(void);
+int blkdev_register(blkdev_t* dev);
+size_t blkdev_count(void);
+blkdev_t* blkdev_get(size_t index);
+blkdev_t* blkdev_find(const char* name);
+
+// Asynchronous interface
+int blkdev_submit(blk_request_t* req);
+void blkdev_wait(blk_request_t* req);
+void blk_request_complete(blk_request_t* req, int status);
+
+// Hold back submissions until the plug is finished (plugs don't nest)
+void blk_start_plug(blk_plug_t* plug);
+void blk_finish_plug(blk_plug_t* plug);
+
+// I/O scheduler selection; fails with -EBUSY while requests are queued
+int blkdev_set_elevator(blkdev_t* dev, const char* name);
+const char* blkdev_elevator_name(const blkdev_t* dev);
+
+// Statistics; in_flight survives a reset
+void blkdev_reset_stats(blkdev_t* dev);
+uint32_t blk_latency_percentile(const uint32_t* hist, uint32_t percent);   // us
+
+// Synchronous helpers, split into max_sectors pieces as needed
+int blkdev_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer);
+int blkdev_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer);
+int blkdev_flush(blkdev_t* dev);
+
+#endif // BLKDEV_H
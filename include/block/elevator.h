@@ -0,0 +1,41 @@
+#ifndef ELEVATOR_H
+#define ELEVATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "blkdev.h"
+
+/**
+ * I/O schedulers
+ *
+ * The request queue hands every read and write to the device's elevator
+ * and asks it for the next request whenever the driver has room. After
+ * picking a request the queue calls take_adjacent() repeatedly to build a
+ * merged driver request out of back-to-back neighbours. All callbacks run
+ * with interrupts disabled and use the q_* and fifo_* request links.
+ */
+
+struct elevator_type {
+    const char* name;
+    int (*init)(blkdev_t* dev);
+    void (*exit)(blkdev_t* dev);
+    void (*add)(blkdev_t* dev, blk_request_t* req);
+    // Remove and return the request to dispatch next, NULL if none
+    blk_request_t* (*next)(blkdev_t* dev);
+    // Remove and return a queued request of the same direction starting
+    // right where 'req' ends, NULL if the scheduler has none handy
+    blk_request_t* (*take_adjacent)(blkdev_t* dev, const blk_request_t* req);
+    // Put back a request from take_adjacent() that could not be merged,
+    // keeping its original place in line
+    void (*requeue)(blkdev_t* dev, blk_request_t* req);
+    elevator_type_t* next_type;
+};
+
+int elevator_register(elevator_type_t* type);
+elevator_type_t* elevator_find(const char* name);
+elevator_type_t* elevator_get(int index);
+
+extern elevator_type_t elevator_noop;
+extern elevator_type_t elevator_deadline;
+
+#endif // ELEVATOR_H
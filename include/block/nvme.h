@@ -0,0 +1,10 @@
+#ifndef NVME_H
+#define NVME_H
+
+#include <stdint.h>
+
+// Probe NVMe controllers and register namespace 1 of each as nvme0n1, ...
+// Returns the number of namespaces registered.
+int nvme_init(void);
+
+#endif // NVME_H
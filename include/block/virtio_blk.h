@@ -0,0 +1,10 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include <stdint.h>
+
+// Probe virtio block devices and register them as vda, vdb, ...
+// Returns the number of devices found.
+int virtio_blk_init(void);
+
+#endif // VIRTIO_BLK_H
@@ -0,0 +1,52 @@
+// include/fs/dcache.h
+#ifndef DCACHE_H
+#define DCACHE_H
+
+#include "vfs.h"
+
+/**
+ * Dentry cache
+ *
+ * Maps (parent inode, name) to the child inode, or to nothing for a
+ * negative entry recording that the name does not exist. Entries live in
+ * a fixed pool, are hashed into buckets for lookup and are recycled with
+ * a CLOCK sweep. Positive entries hold a reference on their inode.
+ */
+
+#define DCACHE_ENTRIES  2048
+#define DCACHE_BUCKETS  1024   // Power of two
+
+typedef struct dentry {
+    struct dentry* hash_next;
+    vfs_inode_t* parent;
+    vfs_inode_t* inode;      // NULL for a negative entry
+    uint32_t hash;
+    uint8_t len;
+    uint8_t in_use;
+    uint8_t referenced;      // CLOCK bit
+    char name[VFS_NAME_MAX + 1];
+} dentry_t;
+
+typedef struct {
+    uint32_t hits;
+    uint32_t negative_hits;
+    uint32_t misses;
+    uint32_t inserts;
+    uint32_t evictions;
+    uint32_t entries;
+} dcache_stats_t;
+
+void dcache_init(void);
+uint32_t dcache_hash(const vfs_inode_t* parent, const char* name, size_t len);
+dentry_t* dcache_lookup(const vfs_inode_t* parent, const char* name, size_t len, uint32_t hash);
+void dcache_insert(vfs_inode_t* parent, const char* name, size_t len, uint32_t hash, vfs_inode_t* inode);
+void dcache_invalidate(const vfs_inode_t* parent, const char* name, size_t len);
+void dcache_purge_parent(const vfs_inode_t* parent);
+void dcache_purge_sb(const vfs_superblock_t* sb);
+
+void dcache_set_enabled(bool enabled);
+bool dcache_is_enabled(void);
+void dcache_get_stats(dcache_stats_t* stats);
+void dcache_reset_stats(void);
+
+#endif // DCACHE_H
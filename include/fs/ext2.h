@@ -0,0 +1,25 @@
+// include/fs/ext2.h
+#ifndef EXT2_H
+#define EXT2_H
+
+#include <stdint.h>
+
+// Counters across all mounted ext2 filesystems
+typedef struct {
+    uint32_t inode_reads;        // Inodes read from the inode table
+    uint32_t inode_writes;
+    uint32_t map_hits;           // Block lookups answered by the cached run
+    uint32_t map_misses;         // Block lookups that walked the block tree
+    uint32_t index_builds;       // Directory name hashes built
+    uint32_t index_lookups;      // Lookups answered through one
+    uint32_t linear_lookups;     // Lookups that scanned the whole directory
+    uint32_t blocks_allocated;
+    uint32_t blocks_at_goal;     // Allocated exactly where the allocator aimed
+    uint32_t data_requests;      // Device requests for file data
+} ext2_stats_t;
+
+void ext2_init(void);
+void ext2_get_stats(ext2_stats_t* stats);
+void ext2_reset_stats(void);
+
+#endif // EXT2_H
@@ -0,0 +1,20 @@
+// include/fs/fat32.h
+#ifndef FAT32_H
+#define FAT32_H
+
+#include <stdint.h>
+
+// Counters across all mounted FAT32 volumes
+typedef struct {
+    uint32_t chains_mapped;      // Cluster chains turned into extent lists
+    uint32_t extents;            // Extents those chains collapsed into
+    uint32_t clusters;           // Clusters covered by them
+    uint32_t data_requests;      // Device requests for file data
+    uint32_t data_sectors;
+} fat32_stats_t;
+
+void fat32_init(void);
+void fat32_get_stats(fat32_stats_t* stats);
+void fat32_reset_stats(void);
+
+#endif // FAT32_H
@@ -0,0 +1,20 @@
+// include/fs/iso9660.h
+#ifndef ISO9660_H
+#define ISO9660_H
+
+#include <stdint.h>
+
+// Counters across all mounted ISO9660 volumes
+typedef struct {
+    uint32_t dirs_parsed;        // Directories read into the entry cache
+    uint32_t entries_cached;     // Entries those directories held
+    uint32_t lookups;            // Names looked up in the cache
+    uint32_t data_requests;      // Device requests for file data
+    uint32_t data_sectors;
+} iso9660_stats_t;
+
+void iso9660_init(void);
+void iso9660_get_stats(iso9660_stats_t* stats);
+void iso9660_reset_stats(void);
+
+#endif // ISO9660_H
@@ -0,0 +1,21 @@
+// include/fs/tmpfs.h
+#ifndef TMPFS_H
+#define TMPFS_H
+
+#include <stdint.h>
+
+// Usage across all mounted tmpfs instances
+typedef struct {
+    uint32_t data_pages;     // File pages taken from the page allocator
+    uint32_t swapped_pages;  // File pages compressed into zram
+    uint32_t swapouts;       // Pages reclaim has moved into zram
+    uint32_t swapins;        // ... and accesses have brought back
+    uint32_t index_nodes;    // Radix tree nodes indexing those pages
+    uint32_t files;
+    uint32_t directories;
+} tmpfs_usage_t;
+
+void tmpfs_init(void);
+void tmpfs_get_usage(tmpfs_usage_t* usage);
+
+#endif // TMPFS_H
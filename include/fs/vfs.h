@@ -0,0 +1,195 @@
+// include/fs/vfs.h
+#ifndef VFS_H
+#define VFS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "../lib/radix_tree.h"
+
+/**
+ * Virtual File System
+ *
+ * Every filesystem registers a vfs_fs_type_t and fills in a superblock on
+ * mount. Inodes carry two operation tables: vfs_inode_ops_t for namespace
+ * operations on directories and vfs_file_ops_t for data access through an
+ * open file. Path lookup goes through the dentry cache (fs/dcache.c) before
+ * asking the filesystem.
+ */
+
+#define VFS_NAME_MAX    63
+#define VFS_PATH_MAX    256
+#define VFS_MAX_FILES   32   // System-wide open file table
+#define VFS_FIRST_FD    3    // 0-2 are the console
+#define VFS_MAX_MOUNTS  16
+#define VFS_MAX_DEPTH   32   // Path components tracked while walking
+
+// Inode types
+#define VFS_TYPE_FILE   1
+#define VFS_TYPE_DIR    2
+#define VFS_TYPE_DEV    3
+
+// Open flags
+#define O_RDONLY        0x0000
+#define O_WRONLY        0x0001
+#define O_RDWR          0x0002
+#define O_ACCMODE       0x0003
+#define O_CREAT         0x0040
+#define O_TRUNC         0x0200
+#define O_APPEND        0x0400
+#define O_DIRECTORY     0x10000
+
+// lseek whence
+#define SEEK_SET        0
+#define SEEK_CUR        1
+#define SEEK_END        2
+
+// Mount flags
+#define VFS_MNT_RDONLY  0x01
+
+typedef uint32_t vfs_off_t;
+
+typedef struct vfs_inode vfs_inode_t;
+typedef struct vfs_superblock vfs_superblock_t;
+typedef struct vfs_file vfs_file_t;
+typedef struct vfs_fs_type vfs_fs_type_t;
+
+typedef struct {
+    uint32_t ino;
+    uint32_t type;
+    char name[VFS_NAME_MAX + 1];
+} vfs_dirent_t;
+
+typedef struct {
+    uint32_t dev;
+    uint32_t ino;
+    uint32_t type;
+    uint32_t mode;
+    uint32_t nlink;
+    vfs_off_t size;
+    uint32_t blocks;     // 512-byte units
+    uint32_t blksize;
+    uint32_t mtime;
+} vfs_stat_t;
+
+// Namespace operations, called on directory inodes.
+// lookup/create return a referenced inode in *out.
+typedef struct {
+    int (*lookup)(vfs_inode_t* dir, const char* name, size_t len, vfs_inode_t** out);
+    int (*create)(vfs_inode_t* dir, const char* name, size_t len, uint32_t type, vfs_inode_t** out);
+    int (*unlink)(vfs_inode_t* dir, const char* name, size_t len);
+    int (*truncate)(vfs_inode_t* inode, vfs_off_t size);
+} vfs_inode_ops_t;
+
+// Data operations on an open file. read/write return bytes moved or -errno;
+// readdir returns 1 when *out was filled, 0 at end of directory. A
+// filesystem that provides readpages instead of read has its file data
+// cached in the page cache: readpages fills buf straight from the backing
+// store and is only called by the cache.
+typedef struct {
+    int (*open)(vfs_inode_t* inode, vfs_file_t* file);
+    void (*release)(vfs_inode_t* inode, vfs_file_t* file);
+    int (*read)(vfs_file_t* file, void* buf, size_t count, vfs_off_t offset);
+    int (*write)(vfs_file_t* file, const void* buf, size_t count, vfs_off_t offset);
+    int (*readdir)(vfs_file_t* file, uint32_t index, vfs_dirent_t* out);
+    int (*readpages)(vfs_inode_t* inode, void* buf, size_t count, vfs_off_t offset);
+} vfs_file_ops_t;
+
+typedef struct {
+    void (*evict_inode)(vfs_inode_t* inode);  // Last reference dropped
+    void (*put_super)(vfs_superblock_t* sb);  // Unmount
+    int (*sync)(vfs_superblock_t* sb);
+} vfs_super_ops_t;
+
+struct vfs_inode {
+    uint32_t ino;
+    uint32_t type;
+    uint32_t mode;
+    uint32_t nlink;
+    vfs_off_t size;
+    uint32_t blocks;
+    uint32_t mtime;
+    uint32_t refcount;
+    vfs_superblock_t* sb;
+    const vfs_inode_ops_t* i_op;
+    const vfs_file_ops_t* f_op;
+    vfs_superblock_t* mounted;   // Filesystem mounted on this directory
+    vfs_inode_t* hash_next;      // Inode cache chain
+    struct radix_tree_root pages;  // Page cache, by page number
+    uint32_t nrpages;
+    void* private;
+};
+
+struct vfs_superblock {
+    vfs_fs_type_t* type;
+    const vfs_super_ops_t* s_op;
+    vfs_inode_t* root;
+    vfs_inode_t* covered;        // Mountpoint in the parent fs, NULL for /
+    uint32_t dev;
+    uint32_t block_size;
+    uint32_t flags;
+    char source[32];
+    char target[VFS_PATH_MAX];
+    void* fs_info;
+};
+
+struct vfs_fs_type {
+    const char* name;
+    // Fill in sb->root, sb->s_op and sb->fs_info
+    int (*mount)(const char* source, uint32_t flags, vfs_superblock_t* sb);
+    vfs_fs_type_t* next;
+};
+
+struct vfs_file {
+    vfs_inode_t* inode;
+    const vfs_file_ops_t* f_op;
+    vfs_off_t pos;
+    uint32_t flags;
+    uint32_t refcount;
+    void* private;
+};
+
+// Initialization and filesystem registry
+void vfs_init(void);
+int vfs_register_filesystem(vfs_fs_type_t* fs);
+vfs_fs_type_t* vfs_find_filesystem(const char* name);
+
+// Mounts
+int vfs_mount(const char* fstype, const char* source, const char* target, uint32_t flags);
+int vfs_umount(const char* target);
+vfs_superblock_t* vfs_get_mount(int index);
+
+// Inode cache
+vfs_inode_t* vfs_inode_alloc(vfs_superblock_t* sb, uint32_t ino);
+vfs_inode_t* vfs_inode_find(vfs_superblock_t* sb, uint32_t ino);
+vfs_inode_t* vfs_inode_get(vfs_inode_t* inode);
+void vfs_inode_put(vfs_inode_t* inode);
+
+// Path resolution (returns a referenced inode)
+int vfs_resolve(const char* path, vfs_inode_t** out);
+
+// File descriptor interface
+int vfs_open(const char* path, uint32_t flags);
+int vfs_close(int fd);
+int vfs_read(int fd, void* buf, size_t count);
+int vfs_write(int fd, const void* buf, size_t count);
+int vfs_lseek(int fd, int32_t offset, int whence);
+int vfs_readdir(int fd, vfs_dirent_t* out);
+int vfs_fstat(int fd, vfs_stat_t* st);
+int vfs_ftruncate(int fd, vfs_off_t size);
+vfs_file_t* vfs_get_file(int fd);
+
+// Path-based operations
+int vfs_stat(const char* path, vfs_stat_t* st);
+int vfs_mkdir(const char* path);
+int vfs_unlink(const char* path);
+int vfs_truncate(const char* path, vfs_off_t size);
+
+// Helpers
+const char* vfs_strerror(int err);
+void vfs_fill_stat(vfs_inode_t* inode, vfs_stat_t* st);
+
+// Filesystems
+void rootfs_init(void);
+
+#endif // VFS_H
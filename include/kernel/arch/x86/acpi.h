@@ -0,0 +1,24 @@
+#ifndef _ACPI_H
+#define _ACPI_H
+
+#include <stdint.h>
+
+// ACPI static tables. Only lookup: the RSDP is found in the EBDA or the
+// BIOS area, and tables are returned where the firmware left them.
+typedef struct {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_header_t;
+
+// First table with this signature ("FACP", "HPET", ...) whose checksum is
+// good, or NULL
+const acpi_header_t* acpi_find_table(const char* signature);
+
+#endif // _ACPI_H
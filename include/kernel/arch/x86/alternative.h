@@ -0,0 +1,50 @@
+#ifndef _ALTERNATIVE_H
+#define _ALTERNATIVE_H
+
+#include <stdint.h>
+#include "cpufeature.h"
+
+/**
+ * Alternatives: instruction sequences chosen once, at boot, by CPU feature.
+ *
+ * ALTERNATIVE(old, new, feature) assembles 'old' in place, padded with
+ * NOPs to the length of 'new', and records the site in .altinstructions
+ * with 'new' kept aside in .altinstr_replacement. apply_alternatives()
+ * copies 'new' over every site whose feature the CPU has. Until then, and
+ * on CPUs without it, 'old' runs, so it must work everywhere.
+ *
+ * The replacement is copied byte for byte: it must not contain relative
+ * jumps or calls, and it must not be longer than 255 bytes.
+ */
+
+struct alt_instr {
+    int32_t instr_offset;         // Site, relative to this field
+    int32_t repl_offset;          // Replacement, relative to this field
+    uint16_t feature;             // X86_FEATURE_*
+    uint8_t instrlen;             // Site length, padding included
+    uint8_t replacementlen;
+} __attribute__((packed));
+
+#define __ALT_STR(x) #x
+#define ALT_STR(x) __ALT_STR(x)
+
+#define ALTERNATIVE(oldinstr, newinstr, feature)                              \
+    "661:\n\t" oldinstr "\n662:\n"                                            \
+    ".skip -(((6651f-6641f)-(662b-661b)) > 0) * "                             \
+        "((6651f-6641f)-(662b-661b)),0x90\n"                                  \
+    "663:\n"                                                                  \
+    ".pushsection .altinstructions,\"a\"\n"                                   \
+    " .long 661b - .\n"                                                       \
+    " .long 6641f - .\n"                                                      \
+    " .word " ALT_STR(feature) "\n"                                           \
+    " .byte 663b - 661b\n"                                                    \
+    " .byte 6651f - 6641f\n"                                                  \
+    ".popsection\n"                                                           \
+    ".pushsection .altinstr_replacement,\"ax\"\n"                             \
+    "6641:\n\t" newinstr "\n6651:\n"                                          \
+    ".popsection\n"
+
+// Patch every site for the features this CPU has; returns how many
+int apply_alternatives(void);
+
+#endif // _ALTERNATIVE_H
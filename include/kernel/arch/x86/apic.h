@@ -0,0 +1,42 @@
+#ifndef _APIC_H
+#define _APIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "irq.h"
+
+// Local APIC. The 8259 keeps delivering legacy IRQs through LINT0 (virtual
+// wire mode); the LAPIC is enabled so message-signalled interrupts, which
+// bypass the PIC entirely, can reach the CPU.
+#define LAPIC_DEFAULT_BASE     0xFEE00000
+#define LAPIC_SPURIOUS_VECTOR  0xFF
+#define LAPIC_FIRST_VECTOR     0x30    // Above the remapped PIC lines
+
+bool lapic_init(void);
+bool lapic_available(void);
+uint32_t lapic_id(void);
+void lapic_eoi(void);
+
+// Vectors for MSI/MSI-X: handler runs, then the LAPIC gets its EOI.
+// Returns the vector or -errno.
+int lapic_alloc_vector(irq_handler_t handler, void* ctx);
+void lapic_free_vector(uint8_t vector);
+uint32_t lapic_vector_count(uint8_t vector);
+
+// Local timer, one interrupt per arming: either a countdown of
+// lapic_timer_frequency() ticks per second or an absolute TSC deadline.
+// Arming with 0 disarms.
+uint32_t lapic_timer_frequency(void);
+void lapic_timer_init(uint8_t vector, bool tsc_deadline);
+void lapic_timer_arm(uint32_t count);
+void lapic_timer_arm_deadline(uint64_t tsc);
+
+// Counter overflow interrupt from the PMU; 0 masks it. The CPU masks
+// the entry each time it delivers one, so the handler sets it again.
+void lapic_perf_init(uint8_t vector);
+
+// MSI address/data pair that delivers 'vector' to this CPU
+uint32_t lapic_msi_address(void);
+uint32_t lapic_msi_data(uint8_t vector);
+
+#endif // _APIC_H
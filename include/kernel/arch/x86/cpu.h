@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "cpufeature.h"
+#include "alternative.h"
 
 // CPU Vendor IDs
 #define CPU_VENDOR_INTEL     "GenuineIntel"
@@ -16,172 +18,6 @@
 #define CPU_DEBUG_DUMP_FEATURES 0x02
 #define CPU_DEBUG_DUMP_ALL      0xFF
 
-// CPU Feature Flags (CPUID-based)
-typedef struct {
-    // Standard Feature Flags (EDX from CPUID 1)
-    uint32_t fpu:1;
-    uint32_t vme:1;
-    uint32_t de:1;
-    uint32_t pse:1;
-    uint32_t tsc:1;
-    uint32_t msr:1;
-    uint32_t pae:1;
-    uint32_t mce:1;
-    uint32_t cx8:1;
-    uint32_t apic:1;
-    uint32_t sep:1;
-    uint32_t mtrr:1;
-    uint32_t pge:1;
-    uint32_t mca:1;
-    uint32_t cmov:1;
-    uint32_t pat:1;
-    uint32_t pse36:1;
-    uint32_t psn:1;
-    uint32_t clfsh:1;
-    uint32_t ds:1;
-    uint32_t acpi:1;
-    uint32_t mmx:1;
-    uint32_t fxsr:1;
-    uint32_t sse:1;
-    uint32_t sse2:1;
-    uint32_t ss:1;
-    uint32_t htt:1;
-    uint32_t tm:1;
-    uint32_t ia64:1;
-    uint32_t pbe:1;
-
-    // Extended Feature Flags (ECX from CPUID 1)
-    uint32_t sse3:1;
-    uint32_t pclmul:1;
-    uint32_t dtes64:1;
-    uint32_t monitor:1;
-    uint32_t ds_cpl:1;
-    uint32_t vmx:1;
-    uint32_t smx:1;
-    uint32_t est:1;
-    uint32_t tm2:1;
-    uint32_t ssse3:1;
-    uint32_t cid:1;
-    uint32_t sdbg:1;
-    uint32_t fma:1;
-    uint32_t cx16:1;
-    uint32_t xtpr:1;
-    uint32_t pdcm:1;
-    uint32_t pcid:1;
-    uint32_t dca:1;
-    uint32_t sse4_1:1;
-    uint32_t sse4_2:1;
-    uint32_t x2apic:1;
-    uint32_t movbe:1;
-    uint32_t popcnt:1;
-    uint32_t tsc_deadline:1;
-    uint32_t aes:1;
-    uint32_t xsave:1;
-    uint32_t osxsave:1;
-    uint32_t avx:1;
-    uint32_t f16c:1;
-    uint32_t rdrand:1;
-    uint32_t hypervisor:1;
-
-    // Extended Features (CPUID 7)
-    uint32_t fsgsbase:1;
-    uint32_t ia32_tsc_adjust:1;
-    uint32_t sgx:1;
-    uint32_t bmi1:1;
-    uint32_t hle:1;
-    uint32_t avx2:1;
-    uint32_t fdp_excptn_only:1;
-    uint32_t smep:1;
-    uint32_t bmi2:1;
-    uint32_t erms:1;
-    uint32_t invpcid:1;
-    uint32_t rtm:1;
-    uint32_t pqm:1;
-    uint32_t dep_fpu_csds:1;
-    uint32_t mpx:1;
-    uint32_t pqe:1;
-    uint32_t avx512f:1;
-    uint32_t avx512dq:1;
-    uint32_t rdseed:1;
-    uint32_t adx:1;
-    uint32_t smap:1;
-    uint32_t avx512ifma:1;
-    uint32_t pcommit:1;
-    uint32_t clflushopt:1;
-    uint32_t clwb:1;
-    uint32_t intel_pt:1;
-    uint32_t avx512pf:1;
-    uint32_t avx512er:1;
-    uint32_t avx512cd:1;
-    uint32_t sha:1;
-    uint32_t avx512bw:1;
-    uint32_t avx512vl:1;
-    uint32_t prefetchwt1:1;
-    uint32_t avx512vbmi:1;
-    uint32_t umip:1;
-    uint32_t pku:1;
-    uint32_t ospke:1;
-    uint32_t waitpkg:1;
-    uint32_t avx512_vbmi2:1;
-    uint32_t cet_ss:1;
-    uint32_t gfni:1;
-    uint32_t vaes:1;
-    uint32_t vpclmulqdq:1;
-    uint32_t avx512_vnni:1;
-    uint32_t avx512_bitalg:1;
-    uint32_t tme:1;
-    uint32_t avx512_vpopcntdq:1;
-    uint32_t la57:1;
-    uint32_t mawau:5;
-    uint32_t rdpid:1;
-    uint32_t kl:1;
-    uint32_t bus_lock_detect:1;
-    uint32_t cldemote:1;
-    uint32_t movdiri:1;
-    uint32_t movdir64b:1;
-    uint32_t enqcmd:1;
-    uint32_t sgx_lc:1;
-    uint32_t pks:1;
-
-    // AMD-specific features
-    uint32_t syscall:1;
-    uint32_t mp:1;
-    uint32_t nx:1;
-    uint32_t mmxext:1;
-    uint32_t fxsr_opt:1;
-    uint32_t pdpe1gb:1;
-    uint32_t rdtscp:1;
-    uint32_t lm:1;
-    uint32_t _3dnowext:1;
-    uint32_t _3dnow:1;
-    uint32_t lahf_lm:1;
-    uint32_t cmp_legacy:1;
-    uint32_t svm:1;
-    uint32_t extapic:1;
-    uint32_t cr8_legacy:1;
-    uint32_t abm:1;
-    uint32_t sse4a:1;
-    uint32_t misalignsse:1;
-    uint32_t _3dnowprefetch:1;
-    uint32_t osvw:1;
-    uint32_t ibs:1;
-    uint32_t xop:1;
-    uint32_t skinit:1;
-    uint32_t wdt:1;
-    uint32_t lwp:1;
-    uint32_t fma4:1;
-    uint32_t tce:1;
-    uint32_t nodeid_msr:1;
-    uint32_t tbm:1;
-    uint32_t topoext:1;
-    uint32_t perfctr_core:1;
-    uint32_t perfctr_nb:1;
-    uint32_t dbx:1;
-    uint32_t perfctr_llc:1;
-    uint32_t mwaitx:1;
-    uint32_t hw_pstate:1;
-} cpu_features_t;
-
 // CPU Cache Types
 typedef enum {
     CACHE_TYPE_NULL = 0,
@@ -225,7 +61,7 @@ typedef struct {
 // CPU State Information
 typedef struct {
     cpu_identity_t identity;
-    cpu_features_t features;
+    uint32_t capability[NCAPINTS]; // CPUID feature words, see cpufeature.h
     cpu_topology_t topology;
     uint32_t apic_id;
     uint32_t tsc_frequency; // in kHz
@@ -236,6 +72,16 @@ typedef struct {
     cache_descriptor_t caches[16]; // Support up to 16 cache descriptors
 } cpu_info_t;
 
+// The boot CPU, filled in by cpu_early_init and cpu_late_init
+extern cpu_info_t boot_cpu_info;
+
+static inline bool cpu_info_has(const cpu_info_t* info, unsigned int feature) {
+    return info->capability[feature / 32] & (1u << (feature % 32));
+}
+
+// Feature test on the boot CPU: one AND against a constant mask
+#define cpu_has(feature) cpu_info_has(&boot_cpu_info, (feature))
+
 // CPU Exception Frame (x86_64)
 typedef struct {
     uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
@@ -251,9 +97,8 @@ void cpu_early_init(void);
 void cpu_late_init(void);
 
 // Identification
-void cpu_identify(cpu_info_t* info);
+const cpu_info_t* cpu_identify(void);
 const char* cpu_vendor_name(const cpu_info_t* info);
-bool cpu_has_feature(const cpu_info_t* info, const char* feature_name);
 
 // Topology
 void cpu_detect_topology(cpu_info_t* info);
@@ -280,7 +125,16 @@ void cpu_prefetch(const void* addr);
 // Timing
 uint64_t cpu_rdtsc(void);
 uint64_t cpu_rdtscp(uint32_t* aux);
-void cpu_calibrate_tsc(void);
+
+// rdtsc that waits for earlier instructions: rdtscp where the CPU has it
+static inline uint64_t cpu_rdtsc_ordered(void) {
+    uint32_t low, high;
+    asm volatile(ALTERNATIVE("rdtsc", "rdtscp", X86_FEATURE_RDTSCP)
+                 : "=a"(low), "=d"(high) : : "ecx");
+    return ((uint64_t)high << 32) | low;
+}
+uint64_t cpu_tsc_to_ns(uint64_t cycles);
+void cpu_set_tsc_frequency(uint32_t khz);
 
 // Synchronization
 void cpu_pause(void);
@@ -0,0 +1,186 @@
+#ifndef _CPUFEATURE_H
+#define _CPUFEATURE_H
+
+// CPU feature bits, as word * 32 + bit. Each word is one CPUID register
+// stored as read, so detection is a handful of stores and a test is one
+// AND against a constant mask.
+#define NCAPINTS 7
+
+#define CPUID_1_EDX          0
+#define CPUID_1_ECX          1
+#define CPUID_7_0_EBX        2
+#define CPUID_7_0_ECX        3
+#define CPUID_8000_0001_EDX  4
+#define CPUID_8000_0001_ECX  5
+#define CPUID_8000_0007_EDX  6
+
+// Standard features (CPUID 1, EDX)
+#define X86_FEATURE_FPU             ( 0*32+ 0)
+#define X86_FEATURE_VME             ( 0*32+ 1)
+#define X86_FEATURE_DE              ( 0*32+ 2)
+#define X86_FEATURE_PSE             ( 0*32+ 3)
+#define X86_FEATURE_TSC             ( 0*32+ 4)
+#define X86_FEATURE_MSR             ( 0*32+ 5)
+#define X86_FEATURE_PAE             ( 0*32+ 6)
+#define X86_FEATURE_MCE             ( 0*32+ 7)
+#define X86_FEATURE_CX8             ( 0*32+ 8)
+#define X86_FEATURE_APIC            ( 0*32+ 9)
+#define X86_FEATURE_SEP             ( 0*32+11)
+#define X86_FEATURE_MTRR            ( 0*32+12)
+#define X86_FEATURE_PGE             ( 0*32+13)
+#define X86_FEATURE_MCA             ( 0*32+14)
+#define X86_FEATURE_CMOV            ( 0*32+15)
+#define X86_FEATURE_PAT             ( 0*32+16)
+#define X86_FEATURE_PSE36           ( 0*32+17)
+#define X86_FEATURE_PSN             ( 0*32+18)
+#define X86_FEATURE_CLFLUSH         ( 0*32+19)
+#define X86_FEATURE_DS              ( 0*32+21)
+#define X86_FEATURE_ACPI            ( 0*32+22)
+#define X86_FEATURE_MMX             ( 0*32+23)
+#define X86_FEATURE_FXSR            ( 0*32+24)
+#define X86_FEATURE_SSE             ( 0*32+25)
+#define X86_FEATURE_SSE2            ( 0*32+26)
+#define X86_FEATURE_SS              ( 0*32+27)
+#define X86_FEATURE_HTT             ( 0*32+28)
+#define X86_FEATURE_TM              ( 0*32+29)
+#define X86_FEATURE_IA64            ( 0*32+30)
+#define X86_FEATURE_PBE             ( 0*32+31)
+
+// Extended features (CPUID 1, ECX)
+#define X86_FEATURE_SSE3            ( 1*32+ 0)
+#define X86_FEATURE_PCLMUL          ( 1*32+ 1)
+#define X86_FEATURE_DTES64          ( 1*32+ 2)
+#define X86_FEATURE_MONITOR         ( 1*32+ 3)
+#define X86_FEATURE_DS_CPL          ( 1*32+ 4)
+#define X86_FEATURE_VMX             ( 1*32+ 5)
+#define X86_FEATURE_SMX             ( 1*32+ 6)
+#define X86_FEATURE_EST             ( 1*32+ 7)
+#define X86_FEATURE_TM2             ( 1*32+ 8)
+#define X86_FEATURE_SSSE3           ( 1*32+ 9)
+#define X86_FEATURE_CID             ( 1*32+10)
+#define X86_FEATURE_SDBG            ( 1*32+11)
+#define X86_FEATURE_FMA             ( 1*32+12)
+#define X86_FEATURE_CX16            ( 1*32+13)
+#define X86_FEATURE_XTPR            ( 1*32+14)
+#define X86_FEATURE_PDCM            ( 1*32+15)
+#define X86_FEATURE_PCID            ( 1*32+17)
+#define X86_FEATURE_DCA             ( 1*32+18)
+#define X86_FEATURE_SSE4_1          ( 1*32+19)
+#define X86_FEATURE_SSE4_2          ( 1*32+20)
+#define X86_FEATURE_X2APIC          ( 1*32+21)
+#define X86_FEATURE_MOVBE           ( 1*32+22)
+#define X86_FEATURE_POPCNT          ( 1*32+23)
+#define X86_FEATURE_TSC_DEADLINE    ( 1*32+24)
+#define X86_FEATURE_AES             ( 1*32+25)
+#define X86_FEATURE_XSAVE           ( 1*32+26)
+#define X86_FEATURE_OSXSAVE         ( 1*32+27)
+#define X86_FEATURE_AVX             ( 1*32+28)
+#define X86_FEATURE_F16C            ( 1*32+29)
+#define X86_FEATURE_RDRAND          ( 1*32+30)
+#define X86_FEATURE_HYPERVISOR      ( 1*32+31)
+
+// Structured extended features (CPUID 7, EBX)
+#define X86_FEATURE_FSGSBASE        ( 2*32+ 0)
+#define X86_FEATURE_TSC_ADJUST      ( 2*32+ 1)
+#define X86_FEATURE_SGX             ( 2*32+ 2)
+#define X86_FEATURE_BMI1            ( 2*32+ 3)
+#define X86_FEATURE_HLE             ( 2*32+ 4)
+#define X86_FEATURE_AVX2            ( 2*32+ 5)
+#define X86_FEATURE_FDP_EXCPTN_ONLY ( 2*32+ 6)
+#define X86_FEATURE_SMEP            ( 2*32+ 7)
+#define X86_FEATURE_BMI2            ( 2*32+ 8)
+#define X86_FEATURE_ERMS            ( 2*32+ 9)
+#define X86_FEATURE_INVPCID         ( 2*32+10)
+#define X86_FEATURE_RTM             ( 2*32+11)
+#define X86_FEATURE_PQM             ( 2*32+12)
+#define X86_FEATURE_ZERO_FCS_FDS    ( 2*32+13)
+#define X86_FEATURE_MPX             ( 2*32+14)
+#define X86_FEATURE_PQE             ( 2*32+15)
+#define X86_FEATURE_AVX512F         ( 2*32+16)
+#define X86_FEATURE_AVX512DQ        ( 2*32+17)
+#define X86_FEATURE_RDSEED          ( 2*32+18)
+#define X86_FEATURE_ADX             ( 2*32+19)
+#define X86_FEATURE_SMAP            ( 2*32+20)
+#define X86_FEATURE_AVX512IFMA      ( 2*32+21)
+#define X86_FEATURE_PCOMMIT         ( 2*32+22)
+#define X86_FEATURE_CLFLUSHOPT      ( 2*32+23)
+#define X86_FEATURE_CLWB            ( 2*32+24)
+#define X86_FEATURE_INTEL_PT        ( 2*32+25)
+#define X86_FEATURE_AVX512PF        ( 2*32+26)
+#define X86_FEATURE_AVX512ER        ( 2*32+27)
+#define X86_FEATURE_AVX512CD        ( 2*32+28)
+#define X86_FEATURE_SHA             ( 2*32+29)
+#define X86_FEATURE_AVX512BW        ( 2*32+30)
+#define X86_FEATURE_AVX512VL        ( 2*32+31)
+
+// Structured extended features (CPUID 7, ECX)
+#define X86_FEATURE_PREFETCHWT1     ( 3*32+ 0)
+#define X86_FEATURE_AVX512VBMI      ( 3*32+ 1)
+#define X86_FEATURE_UMIP            ( 3*32+ 2)
+#define X86_FEATURE_PKU             ( 3*32+ 3)
+#define X86_FEATURE_OSPKE           ( 3*32+ 4)
+#define X86_FEATURE_WAITPKG         ( 3*32+ 5)
+#define X86_FEATURE_AVX512_VBMI2    ( 3*32+ 6)
+#define X86_FEATURE_CET_SS          ( 3*32+ 7)
+#define X86_FEATURE_GFNI            ( 3*32+ 8)
+#define X86_FEATURE_VAES            ( 3*32+ 9)
+#define X86_FEATURE_VPCLMULQDQ      ( 3*32+10)
+#define X86_FEATURE_AVX512_VNNI     ( 3*32+11)
+#define X86_FEATURE_AVX512_BITALG   ( 3*32+12)
+#define X86_FEATURE_TME             ( 3*32+13)
+#define X86_FEATURE_AVX512_VPOPCNTDQ ( 3*32+14)
+#define X86_FEATURE_LA57            ( 3*32+16)
+#define X86_FEATURE_RDPID           ( 3*32+22)
+#define X86_FEATURE_KL              ( 3*32+23)
+#define X86_FEATURE_BUS_LOCK_DETECT ( 3*32+24)
+#define X86_FEATURE_CLDEMOTE        ( 3*32+25)
+#define X86_FEATURE_MOVDIRI         ( 3*32+27)
+#define X86_FEATURE_MOVDIR64B       ( 3*32+28)
+#define X86_FEATURE_ENQCMD          ( 3*32+29)
+#define X86_FEATURE_SGX_LC          ( 3*32+30)
+#define X86_FEATURE_PKS             ( 3*32+31)
+
+// AMD-defined features (CPUID 0x80000001, EDX)
+#define X86_FEATURE_SYSCALL         ( 4*32+11)
+#define X86_FEATURE_MP              ( 4*32+19)
+#define X86_FEATURE_NX              ( 4*32+20)
+#define X86_FEATURE_MMXEXT          ( 4*32+22)
+#define X86_FEATURE_FXSR_OPT        ( 4*32+25)
+#define X86_FEATURE_PDPE1GB         ( 4*32+26)
+#define X86_FEATURE_RDTSCP          ( 4*32+27)
+#define X86_FEATURE_LM              ( 4*32+29)
+#define X86_FEATURE_3DNOWEXT        ( 4*32+30)
+#define X86_FEATURE_3DNOW           ( 4*32+31)
+
+// AMD-defined features (CPUID 0x80000001, ECX)
+#define X86_FEATURE_LAHF_LM         ( 5*32+ 0)
+#define X86_FEATURE_CMP_LEGACY      ( 5*32+ 1)
+#define X86_FEATURE_SVM             ( 5*32+ 2)
+#define X86_FEATURE_EXTAPIC         ( 5*32+ 3)
+#define X86_FEATURE_CR8_LEGACY      ( 5*32+ 4)
+#define X86_FEATURE_ABM             ( 5*32+ 5)
+#define X86_FEATURE_SSE4A           ( 5*32+ 6)
+#define X86_FEATURE_MISALIGNSSE     ( 5*32+ 7)
+#define X86_FEATURE_3DNOWPREFETCH   ( 5*32+ 8)
+#define X86_FEATURE_OSVW            ( 5*32+ 9)
+#define X86_FEATURE_IBS             ( 5*32+10)
+#define X86_FEATURE_XOP             ( 5*32+11)
+#define X86_FEATURE_SKINIT          ( 5*32+12)
+#define X86_FEATURE_WDT             ( 5*32+13)
+#define X86_FEATURE_LWP             ( 5*32+15)
+#define X86_FEATURE_FMA4            ( 5*32+16)
+#define X86_FEATURE_TCE             ( 5*32+17)
+#define X86_FEATURE_NODEID_MSR      ( 5*32+19)
+#define X86_FEATURE_TBM             ( 5*32+21)
+#define X86_FEATURE_TOPOEXT         ( 5*32+22)
+#define X86_FEATURE_PERFCTR_CORE    ( 5*32+23)
+#define X86_FEATURE_PERFCTR_NB      ( 5*32+24)
+#define X86_FEATURE_BPEXT           ( 5*32+26)
+#define X86_FEATURE_PERFCTR_LLC     ( 5*32+28)
+#define X86_FEATURE_MWAITX          ( 5*32+29)
+
+// Power management (CPUID 0x80000007, EDX)
+#define X86_FEATURE_HW_PSTATE       ( 6*32+ 7)
+#define X86_FEATURE_INVARIANT_TSC   ( 6*32+ 8)
+
+#endif // _CPUFEATURE_H
@@ -0,0 +1,12 @@
+#ifndef _GDT_H
+#define _GDT_H
+
+#include <stdint.h>
+
+// Flat 4GB segments; the multiboot loader's GDT is not guaranteed to survive
+#define GDT_KERNEL_CODE 0x08
+#define GDT_KERNEL_DATA 0x10
+
+void gdt_init(void);
+
+#endif // _GDT_H
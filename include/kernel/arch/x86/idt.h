@@ -0,0 +1,32 @@
+#ifndef _IDT_H
+#define _IDT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define IDT_ENTRIES        256
+#define IDT_EXCEPTIONS     32     // Vectors 0-31 are reserved by the CPU
+
+// Register state saved by the common interrupt entry stub, lowest address first
+typedef struct {
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;  // pusha
+    uint32_t vector;
+    uint32_t err_code;                                 // 0 if the CPU pushed none
+    uint32_t eip, cs, eflags;                          // Pushed by the CPU
+} interrupt_frame_t;
+
+typedef void (*interrupt_handler_t)(interrupt_frame_t* frame);
+
+void idt_init(void);
+void idt_set_handler(uint8_t vector, interrupt_handler_t handler);
+interrupt_handler_t idt_get_handler(uint8_t vector);
+
+// Frame of the interrupt being handled (the innermost, if they nest), or
+// NULL outside interrupt context. Handlers that only get a context
+// pointer use it to see what was interrupted.
+interrupt_frame_t* idt_current_frame(void);
+
+// Find an unused vector at or above 'first' for device interrupts, 0 if none
+uint8_t idt_alloc_vector(uint8_t first);
+
+#endif // _IDT_H
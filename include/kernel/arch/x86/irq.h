@@ -0,0 +1,41 @@
+#ifndef _IRQ_H
+#define _IRQ_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Legacy 8259 PIC lines, remapped above the CPU exception vectors
+#define IRQ_BASE_VECTOR  0x20
+#define IRQ_LINES        16
+#define IRQ_MAX_SHARED   4      // Handlers per line (PCI INTx lines are shared)
+
+#define IRQ_TIMER        0
+#define IRQ_KEYBOARD     1
+#define IRQ_CASCADE      2
+#define IRQ_RTC          8
+#define IRQ_ATA_PRIMARY  14
+#define IRQ_ATA_SECONDARY 15
+
+typedef void (*irq_handler_t)(void* ctx);
+
+void irq_init(void);
+int irq_register(uint8_t irq, irq_handler_t handler, void* ctx);
+void irq_unregister(uint8_t irq, irq_handler_t handler, void* ctx);
+void irq_mask(uint8_t irq);
+void irq_unmask(uint8_t irq);
+uint32_t irq_get_count(uint8_t irq);
+uint32_t irq_get_spurious_count(void);
+
+// Interrupt-safe critical sections: returns the previous EFLAGS
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile ("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    if (flags & (1 << 9)) __asm__ volatile ("sti" : : : "memory");
+}
+
+#endif // _IRQ_H
@@ -0,0 +1,77 @@
+#ifndef _PMU_H
+#define _PMU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Architectural performance monitoring (CPUID leaf 0xA). The events
+// below are the ones the architecture defines; CPUID says which of them
+// a given CPU actually counts.
+typedef enum {
+    PMU_EVENT_CYCLES,
+    PMU_EVENT_INSTRUCTIONS,
+    PMU_EVENT_REF_CYCLES,
+    PMU_EVENT_LLC_REFERENCES,
+    PMU_EVENT_LLC_MISSES,
+    PMU_EVENT_BRANCHES,
+    PMU_EVENT_BRANCH_MISSES,
+    PMU_EVENT_MAX
+} pmu_event_t;
+
+#define PMU_EVENT_BIT(e)  (1u << (e))
+#define PMU_EVENTS_ALL    ((1u << PMU_EVENT_MAX) - 1)
+
+#define PMU_MAX_GP        8
+#define PMU_MAX_FIXED     3
+
+typedef struct {
+    uint8_t version;              // 0: no architectural PMU
+    uint8_t gp_counters;
+    uint8_t gp_width;             // Bits
+    uint8_t fixed_counters;       // Version 2 and up
+    uint8_t fixed_width;
+    uint32_t events;              // PMU_EVENT_BIT()s this CPU can count
+} pmu_info_t;
+
+// A set of events counted together. Counts accumulate over every
+// enable/disable pair, so a scheduler can disable a thread's set when
+// it switches out and enable it again when it switches back: that is
+// all it takes to count per thread. One set owns the counters at a time.
+typedef struct {
+    uint32_t events;              // Requested
+    uint32_t counting;            // Requested, and given a counter
+    int8_t counter[PMU_EVENT_MAX];  // GP index, PMU_FIXED(n), or -1
+    uint64_t count[PMU_EVENT_MAX];
+    bool enabled;
+} pmu_counters_t;
+
+#define PMU_FIXED(n)      (32 + (n))
+
+// Probe CPUID leaf 0xA; -ENODEV when there is no usable PMU
+int pmu_init(void);
+const pmu_info_t* pmu_get_info(void);
+const char* pmu_event_name(pmu_event_t event);
+
+// Give each requested event a counter, fixed ones first. Events the CPU
+// cannot count, or that find no free counter, are left out of
+// 'counting'. -ENODEV without a PMU.
+int pmu_counters_init(pmu_counters_t* pc, uint32_t events);
+
+// Start counting on this CPU; -EBUSY if another set holds the counters
+int pmu_counters_enable(pmu_counters_t* pc);
+void pmu_counters_disable(pmu_counters_t* pc);
+
+// Accumulated count, including what a running set has counted so far
+uint64_t pmu_counters_read(const pmu_counters_t* pc, pmu_event_t event);
+
+// Sampling: call 'handler' from the overflow interrupt once every
+// 'period' (< 2^31) occurrences of 'event'. idt_current_frame() in the
+// handler is what the event interrupted. Sampling and counting share the
+// counters: each is -EBUSY while the other runs.
+typedef void (*pmu_overflow_handler_t)(void* ctx);
+
+int pmu_sample_start(pmu_event_t event, uint32_t period,
+                     pmu_overflow_handler_t handler, void* ctx);
+void pmu_sample_stop(void);
+
+#endif // _PMU_H
@@ -0,0 +1,20 @@
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include <stdint.h>
+#include "../../time/clocksource.h"
+
+// x86 time hardware. Each probe registers a clock source when the
+// hardware is there and returns 0, or -ENODEV.
+#define PIT_FREQ_HZ      1193182
+#define ACPI_PM_FREQ_HZ  3579545
+
+int pit_clocksource_init(void);
+int acpi_pm_clocksource_init(void);
+int hpet_clocksource_init(void);
+
+// Times the TSC against 'ref' to find its real frequency, hands that to
+// cpu_set_tsc_frequency and registers the TSC
+int tsc_clocksource_init(clocksource_t* ref);
+
+#endif // _TIMER_H
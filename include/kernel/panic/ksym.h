@@ -0,0 +1,46 @@
+// include/kernel/panic/ksym.h
+#ifndef KSYM_H
+#define KSYM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Kernel symbol table
+ *
+ * Every function in kernel text, sorted by address. The table is built
+ * from the linked kernel itself: the first link pass uses an empty one,
+ * scripts/ksymgen.sh turns "nm -n" of that kernel into the real table,
+ * and a second pass links it in. Symbols are indexed 0..ksym_total()-1
+ * in address order.
+ *
+ * Names are stored prefix-compressed in blocks of KSYM_MARKER_STRIDE;
+ * a lookup is a binary search over the addresses plus the decoding of
+ * at most one block.
+ */
+
+#define KSYM_NAME_LEN      64
+#define KSYM_MARKER_STRIDE 16     // Must match scripts/ksymgen.sh
+
+typedef struct {
+    char name[KSYM_NAME_LEN];
+    uintptr_t addr;               // Start of the function
+    uint32_t size;                // Up to the next symbol
+    uint32_t offset;              // Looked-up address minus 'addr'
+} ksym_t;
+
+uint32_t ksym_total(void);
+
+// True for addresses inside kernel text, table or no table
+bool ksym_is_text(uintptr_t addr);
+
+// Index of the function containing 'addr', -1 outside the table
+int ksym_index(uintptr_t addr);
+
+// Fill 'out' for a symbol (offset 0); -ENOENT for a bad index
+int ksym_get(uint32_t index, ksym_t* out);
+
+// Function containing 'addr', with the offset into it
+bool ksym_lookup(uintptr_t addr, ksym_t* out);
+
+#endif // KSYM_H
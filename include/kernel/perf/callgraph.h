@@ -0,0 +1,51 @@
+// include/kernel/perf/callgraph.h
+#ifndef CALLGRAPH_H
+#define CALLGRAPH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Call-graph recording
+ *
+ * Only in the call-graph build ("make CALLGRAPH=1"), where every function
+ * is compiled with -finstrument-functions and so calls
+ * __cyg_profile_func_enter/exit on the way in and out. While recording,
+ * the hooks append one TSC-stamped event per call and per return to a
+ * buffer reserved in .bss. When it fills, recording stops; the events
+ * so far stay valid.
+ *
+ * sys/perf/callgraph.c is built without instrumentation, so nothing the
+ * hooks run can call back into them.
+ */
+
+#define CALLGRAPH_EVENTS (1u << 19)   // 8 MB of events
+
+#define CALLGRAPH_ENTER  0
+#define CALLGRAPH_EXIT   1
+
+typedef struct {
+    uint64_t tsc;
+    uint32_t fn;                  // Function entered or left
+    uint32_t kind;                // CALLGRAPH_ENTER or CALLGRAPH_EXIT
+} callgraph_event_t;
+
+typedef struct {
+    bool recording;
+    bool full;                    // Stopped because the buffer filled
+    uint32_t events;
+} callgraph_stats_t;
+
+// Empty the buffer and start recording; -EBUSY if already recording
+int callgraph_start(void);
+
+// -ENOSPC if recording already ended because the buffer filled, -EINVAL
+// if it was not started
+int callgraph_stop(void);
+
+void callgraph_get_stats(callgraph_stats_t* out);
+
+// Recorded events in order; NULL while recording
+const callgraph_event_t* callgraph_events(uint32_t* count);
+
+#endif // CALLGRAPH_H
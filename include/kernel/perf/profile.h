@@ -0,0 +1,66 @@
+// include/kernel/perf/profile.h
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../arch/x86/pmu.h"
+
+/**
+ * Sampling profiler
+ *
+ * Each sample is the EIP an interrupt found plus the chain of return
+ * addresses behind it, walked through saved EBPs the way the panic
+ * backtrace does (the kernel is built without optimisation, so every
+ * function keeps a frame pointer). Samples come from a periodic hrtimer
+ * or from PMU counter overflow and go into a per-CPU ring that keeps the
+ * newest PROFILE_RING_SAMPLES. The ring is only read while stopped.
+ *
+ * A sample taken before the interrupted function has set up its frame
+ * misses that function's caller: its EBP still belongs to the caller.
+ */
+
+#define PROFILE_MAX_DEPTH     15
+#define PROFILE_RING_SAMPLES  8192
+#define PROFILE_DEFAULT_HZ    1000
+#define PROFILE_MAX_HZ        20000
+#define PROFILE_DEFAULT_PERIOD 1000000  // Events between PMU samples
+#define PROFILE_STACK_SPAN    0x10000   // Most a chain may climb, bytes
+
+typedef enum {
+    PROFILE_SOURCE_TIMER,
+    PROFILE_SOURCE_PMU,
+} profile_source_t;
+
+typedef struct {
+    uint32_t eip;
+    uint32_t depth;               // Entries used in 'callers'
+    uint32_t callers[PROFILE_MAX_DEPTH];  // Return addresses, innermost first
+} profile_sample_t;
+
+typedef struct {
+    bool running;
+    profile_source_t source;
+    pmu_event_t event;            // PMU source only
+    uint32_t period;              // Nanoseconds, or events for the PMU
+    uint32_t taken;               // Samples since start
+    uint32_t held;                // Of those, still in the ring
+    uint64_t elapsed_ns;          // Time spent running
+} profile_stats_t;
+
+// Start sampling 'hz' times a second; -ENODEV without timer hardware
+int profile_start_timer(uint32_t hz);
+
+// Start sampling every 'period' occurrences of 'event'
+int profile_start_pmu(pmu_event_t event, uint32_t period);
+
+// -EINVAL if not running
+int profile_stop(void);
+
+void profile_get_stats(profile_stats_t* out);
+
+// Call 'fn' for every sample in the ring, oldest first; -EBUSY while
+// running. Returns the number of samples otherwise.
+int profile_for_each(void (*fn)(const profile_sample_t* sample, void* ctx), void* ctx);
+
+#endif // PROFILE_H
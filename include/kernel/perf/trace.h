@@ -0,0 +1,117 @@
+// include/kernel/perf/trace.h
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Static tracepoints
+ *
+ * TRACE(event, a0, a1, a2) compiles to a test of one bit in trace_groups
+ * and a branch that is never taken while the event's group is off. When
+ * it is on, trace_record() stamps the TSC and claims a slot in this
+ * CPU's ring with an atomic increment, so a record may be written from
+ * any context, interrupt handlers that nest into another record
+ * included, without a lock.
+ *
+ * While a session runs the ring is drained to COM1 from idle work as a
+ * binary stream: a header describing every event, then one
+ * trace_record_t per record, then a TRACE_EVENT_END record.
+ * scripts/trace2json.py turns a serial log into Chrome trace JSON.
+ */
+
+#define TRACE_MAX_ARGS     3
+#define TRACE_RING_SLOTS   8192   // Per CPU, a power of two
+#define TRACE_MAGIC        "BXTRACE1"
+
+// An event id is its group in the high byte and a number in the low one
+#define TRACE_EVENT_ID(group, n)  (((group) << 8) | (n))
+#define TRACE_GROUP_OF(event)     ((event) >> 8)
+#define TRACE_GROUP_BIT(group)    (1u << (group))
+
+#define TRACE_GROUP_MM       0
+#define TRACE_GROUP_KB       1
+#define TRACE_GROUP_VGA      2
+#define TRACE_GROUP_SYSCALL  3
+#define TRACE_GROUPS         4
+#define TRACE_GROUPS_ALL     ((1u << TRACE_GROUPS) - 1)
+
+enum {
+    TRACE_MM_PAGE_ALLOC     = TRACE_EVENT_ID(TRACE_GROUP_MM, 0),
+    TRACE_MM_PAGE_FREE      = TRACE_EVENT_ID(TRACE_GROUP_MM, 1),
+    TRACE_KB_SCANCODE       = TRACE_EVENT_ID(TRACE_GROUP_KB, 0),
+    TRACE_KB_KEY            = TRACE_EVENT_ID(TRACE_GROUP_KB, 1),
+    TRACE_VGA_PUTS_BEGIN    = TRACE_EVENT_ID(TRACE_GROUP_VGA, 0),
+    TRACE_VGA_PUTS_END      = TRACE_EVENT_ID(TRACE_GROUP_VGA, 1),
+    TRACE_VGA_SCROLL        = TRACE_EVENT_ID(TRACE_GROUP_VGA, 2),
+    TRACE_SYS_ENTER         = TRACE_EVENT_ID(TRACE_GROUP_SYSCALL, 0),
+    TRACE_SYS_EXIT          = TRACE_EVENT_ID(TRACE_GROUP_SYSCALL, 1),
+
+    // Written by the stream itself, never by TRACE()
+    TRACE_EVENT_LOST        = 0xFFFE,   // a0: records overwritten unread
+    TRACE_EVENT_END         = 0xFFFF,   // a0: records lost in the session
+};
+
+// On the wire, little-endian
+typedef struct {
+    uint64_t tsc;
+    uint16_t event;
+    uint8_t cpu;
+    uint8_t reserved;
+    uint32_t args[TRACE_MAX_ARGS];
+} __attribute__((packed)) trace_record_t;
+
+// Stream header: the magic, then this, then 'events' descriptors
+typedef struct {
+    uint32_t tsc_khz;             // 0 if the TSC rate is unknown
+    uint16_t record_size;
+    uint16_t events;
+} __attribute__((packed)) trace_header_t;
+
+typedef struct {
+    uint16_t event;
+    char phase;                   // Chrome trace phase: 'B', 'E' or 'i'
+    uint8_t nargs;
+    char group[8];
+    char name[20];
+    char args[32];                // Argument names, comma-separated
+} __attribute__((packed)) trace_event_desc_t;
+
+typedef struct {
+    uint32_t groups;              // Enabled
+    uint32_t written;             // Records streamed this session
+    uint32_t lost;                // Overwritten before they could be
+    uint32_t pending;             // In the ring now
+} trace_stats_t;
+
+extern uint32_t trace_groups;
+
+#define TRACE(event, a0, a1, a2)                                              \
+    do {                                                                      \
+        if (__builtin_expect(trace_groups &                                   \
+                             TRACE_GROUP_BIT(TRACE_GROUP_OF(event)), 0))      \
+            trace_record((event), (uint32_t)(a0), (uint32_t)(a1),             \
+                         (uint32_t)(a2));                                     \
+    } while (0)
+
+void trace_record(uint16_t event, uint32_t a0, uint32_t a1, uint32_t a2);
+
+// Write the stream header and turn 'groups' on. -ENODEV without a serial
+// port, -EBUSY if a session is already running.
+int trace_start(uint32_t groups);
+
+// Turn everything off, drain what is left and end the stream
+int trace_stop(void);
+
+// Stream up to 'max' records; the idle loop calls this
+uint32_t trace_drain(uint32_t max);
+
+void trace_get_stats(trace_stats_t* out);
+
+const char* trace_group_name(uint32_t group);
+
+// Descriptor table, for listing events
+const trace_event_desc_t* trace_event_descs(uint32_t* count);
+
+#endif // TRACE_H
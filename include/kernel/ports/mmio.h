@@ -0,0 +1,61 @@
+#ifndef MMIO_H
+#define MMIO_H
+
+#include <stdint.h>
+
+/**
+ * @file mmio.h
+ * @brief Memory-mapped device register access
+ *
+ * The kernel runs with paging disabled, so a BAR's physical address can be
+ * dereferenced directly. The volatile accesses keep the compiler from
+ * merging or reordering register reads and writes.
+ */
+
+static inline uint8_t mmio_read8(uintptr_t addr) {
+    return *(volatile uint8_t*)addr;
+}
+
+static inline uint16_t mmio_read16(uintptr_t addr) {
+    return *(volatile uint16_t*)addr;
+}
+
+static inline uint32_t mmio_read32(uintptr_t addr) {
+    return *(volatile uint32_t*)addr;
+}
+
+static inline void mmio_write8(uintptr_t addr, uint8_t val) {
+    *(volatile uint8_t*)addr = val;
+}
+
+static inline void mmio_write16(uintptr_t addr, uint16_t val) {
+    *(volatile uint16_t*)addr = val;
+}
+
+static inline void mmio_write32(uintptr_t addr, uint32_t val) {
+    *(volatile uint32_t*)addr = val;
+}
+
+/**
+ * @brief Write a 64-bit register as two 32-bit halves, low half first
+ */
+static inline void mmio_write64(uintptr_t addr, uint64_t val) {
+    mmio_write32(addr, (uint32_t)val);
+    mmio_write32(addr + 4, (uint32_t)(val >> 32));
+}
+
+/**
+ * @brief Full memory barrier (orders stores before later loads)
+ */
+static inline void mmio_mb(void) {
+    __asm__ volatile ("mfence" : : : "memory");
+}
+
+/**
+ * @brief Compiler barrier; sufficient for store/store and load/load on x86
+ */
+static inline void mmio_barrier(void) {
+    __asm__ volatile ("" : : : "memory");
+}
+
+#endif /* MMIO_H */
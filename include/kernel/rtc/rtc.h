@@ -19,12 +19,19 @@
 #define RTC_STATUS_B     0x0B
 #define RTC_STATUS_C     0x0C
 #define RTC_STATUS_D     0x0D
+#define RTC_CENTURY      0x32
 
 // Status Register B Flags
 #define RTC_24HOUR_MODE  0x02
 #define RTC_BCD_MODE     0x04
+#define RTC_UPDATE_IRQ   0x10       // Update-ended interrupt enable
 #define RTC_UPDATE_IN_PROGRESS 0x80
 
+// Status Register C Flags (reading C acknowledges the interrupt)
+#define RTC_UPDATE_ENDED 0x10
+
+#define RTC_IRQ          8
+
 // Date Structure
 struct rtc_date {
     uint8_t second;
@@ -32,7 +39,7 @@ struct rtc_date {
     uint8_t hour;
     uint8_t day;
     uint8_t month;
-    uint16_t year;  // Last two digits (00-99)
+    uint16_t year;  // Four digits
     bool is_pm;
     bool is_24hour;
 };
@@ -44,10 +51,19 @@ uint8_t rtc_read_register(uint8_t reg);
 void rtc_write_register(uint8_t reg, uint8_t value);
 bool rtc_is_updating();
 
-// Date/Time Functions
-void rtc_read_date(struct rtc_date *date);
-void rtc_read_time(struct rtc_date *date);
+// Wall clock. rtc_init seeds it from CMOS and enables the once-a-second
+// update-ended interrupt (IRQ8), which keeps it in step with the
+// monotonic clock. rtc_read_full then decodes the cached time instead of
+// touching the chip; before rtc_init it still reads CMOS. Dates come
+// back in 24-hour form.
+int rtc_init(void);
+uint32_t rtc_update_count(void);
 void rtc_read_full(struct rtc_date *date);
+void rtc_read_cmos(struct rtc_date *date);
+
+// Seconds since 1970, both ways
+uint32_t rtc_date_to_epoch(const struct rtc_date *date);
+void rtc_date_from_epoch(uint32_t seconds, struct rtc_date *date);
 
 // Conversion Functions
 uint8_t bcd_to_bin(uint8_t bcd);
@@ -58,16 +74,4 @@ bool is_leap_year(uint8_t year);
 uint8_t days_in_month(uint8_t month, uint8_t year);
 uint8_t day_of_week(uint8_t day, uint8_t month, uint16_t year);
 
-// DST Calculations
-bool is_dst_eu(uint8_t month, uint8_t day, uint8_t year);
-bool is_dst_us(uint8_t month, uint8_t day, uint8_t year);
-
-// Utility Functions
-uint8_t rtc_calculate_last_sunday(uint8_t month, uint8_t year);
-uint8_t rtc_calculate_nth_weekday(uint8_t month, uint8_t year, 
-                                 uint8_t n, uint8_t weekday);
-
-// Timezone Functions
-void rtc_adjust_timezone(struct rtc_date *date, int8_t offset);
-
 #endif // _RTC_H
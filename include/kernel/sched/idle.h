@@ -0,0 +1,32 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <stdint.h>
+
+/**
+ * Idle work
+ *
+ * There are no kernel threads yet, so background jobs (cache write-back
+ * and the like) register a callback that runs whenever the CPU would
+ * otherwise spin waiting for input. Callbacks must be short and rate-limit
+ * themselves; they run with interrupts in whatever state the caller has.
+ */
+
+#define IDLE_MAX_WORK 8
+
+typedef void (*idle_work_t)(void);
+
+int idle_register(idle_work_t work);
+
+// Run the idle work. Without timer hardware this also runs expired
+// hrtimers, so they fire only as often as the caller polls.
+void idle_poll(void);
+
+// Halt until an interrupt. With no timer hardware this returns at once
+// and the caller keeps spinning. Otherwise the only timer armed is the
+// next pending one, plus a housekeeping wakeup every
+// IDLE_HOUSEKEEPING_NS while there is idle work to poll.
+#define IDLE_HOUSEKEEPING_NS 100000000ull
+void idle_sleep(void);
+
+#endif // IDLE_H
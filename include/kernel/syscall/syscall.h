@@ -2,13 +2,60 @@
 #define SYSCALL_H
 
 #include <stddef.h> // for size_t
+#include <stdint.h>
 
-// Syscall numbers
-#define SYS_WRITE 4
+// Syscall numbers (Linux i386)
 #define SYS_EXIT 1
+#define SYS_READ 3
+#define SYS_WRITE 4
+#define SYS_CLOSE 6
+#define SYS_SOCKETCALL 102
+#define SYS_CLOCK_GETTIME 265
+
+#define SYSCALL_VECTOR 0x80
+
+// socketcall() operations: EBX selects one, ECX points at its arguments
+#define SYS_SOCKET      1
+#define SYS_BIND        2
+#define SYS_CONNECT     3
+#define SYS_LISTEN      4
+#define SYS_ACCEPT      5
+#define SYS_GETSOCKNAME 6
+#define SYS_SEND        9
+#define SYS_RECV        10
+#define SYS_SENDTO      11
+#define SYS_RECVFROM    12
+#define SYS_SHUTDOWN    13
+#define SYS_SETSOCKOPT  14
+#define SYS_GETSOCKOPT  15
+
+// Kernel side: install the int 0x80 handler
+void syscall_init(void);
 
 // Function prototype for sys_write
 int sys_write(int fd, const void *buf, size_t count);
+int sys_read(int fd, void *buf, size_t count);
+int sys_close(int fd);
 void sys_exit(int status);
 
+// The slow path of clock_gettime(), see include/lib/time.h
+struct timespec;
+int sys_clock_gettime(int clock, struct timespec *ts);
+
+// Sockets, through socketcall(); addresses are struct sockaddr_in
+struct sockaddr;
+int sys_socket(int family, int type, int protocol);
+int sys_bind(int fd, const struct sockaddr *addr, uint32_t addrlen);
+int sys_connect(int fd, const struct sockaddr *addr, uint32_t addrlen);
+int sys_listen(int fd, int backlog);
+int sys_accept(int fd, struct sockaddr *addr, uint32_t *addrlen);
+int sys_send(int fd, const void *buf, size_t len, int flags);
+int sys_recv(int fd, void *buf, size_t len, int flags);
+int sys_sendto(int fd, const void *buf, size_t len, int flags,
+               const struct sockaddr *addr, uint32_t addrlen);
+int sys_recvfrom(int fd, void *buf, size_t len, int flags,
+                 struct sockaddr *addr, uint32_t *addrlen);
+int sys_shutdown(int fd, int how);
+int sys_setsockopt(int fd, int level, int name, const void *val, uint32_t len);
+
 #endif // SYSCALL_H
@@ -0,0 +1,85 @@
+// include/kernel/time/clocksource.h
+#ifndef CLOCKSOURCE_H
+#define CLOCKSOURCE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "../../lib/math64.h"
+
+/**
+ * Clock sources
+ *
+ * Every free-running counter the machine offers (TSC, HPET, ACPI PM
+ * timer, PIT) registers itself with a rating and a frequency. At boot
+ * each one's read cost is measured, and timekeeping runs off the cheapest
+ * source rated at least CLOCKSOURCE_RATING_GOOD that has not been marked
+ * unstable. A source flagged MUST_VERIFY is compared against a slower but
+ * trustworthy one from idle time and dropped if the two drift apart.
+ *
+ * Ratings, as elsewhere: 100-199 usable, 200-299 good, 300-399 desired.
+ */
+
+#define CLOCKSOURCE_MAX          8
+#define CLOCKSOURCE_RATING_GOOD  200
+
+#define CLOCK_SOURCE_MUST_VERIFY 0x01   // Checked by the watchdog
+#define CLOCK_SOURCE_UNSTABLE    0x02   // Failed the check, never selected
+#define CLOCK_SOURCE_WATCHDOG    0x04   // Trusted enough to check others
+#define CLOCK_SOURCE_VDSO        0x08   // Readable from user mode (rdtsc)
+
+typedef struct clocksource {
+    const char* name;
+    uint64_t (*read)(void);
+    uint64_t mask;                // Counter width: reads wrap at mask + 1
+    uint64_t freq_hz;
+    int rating;
+    uint32_t flags;
+
+    // ns = (cycles * mult) >> shift, filled in by clocksource_register
+    uint32_t mult;
+    uint32_t shift;
+
+    uint32_t read_ns;             // Measured cost of one read
+} clocksource_t;
+
+// Fill in mult/shift and add to the list; -ENOSPC when full
+int clocksource_register(clocksource_t* cs);
+
+// Probe the hardware, calibrate the TSC, measure and select
+void clocksource_init(void);
+
+size_t clocksource_count(void);
+clocksource_t* clocksource_get(size_t index);
+clocksource_t* clocksource_find(const char* name);
+clocksource_t* clocksource_current(void);
+
+// Force a source (even an unstable one); -ENODEV if unknown
+int clocksource_select(const char* name);
+
+// Watchdog results for the source under verification
+typedef struct {
+    clocksource_t* checked;       // NULL when nothing needs checking
+    clocksource_t* reference;
+    uint32_t checks;
+    int64_t last_skew_ns;         // checked minus reference, last interval
+    int64_t max_skew_ns;          // Largest magnitude seen
+} clocksource_watchdog_t;
+
+void clocksource_watchdog_stats(clocksource_watchdog_t* out);
+
+// Monotonic nanoseconds since clocksource_init, from the current source
+uint64_t ktime_get_ns(void);
+
+// Wall clock: the monotonic clock plus an offset, which the RTC driver
+// sets by saying what the real time was at monotonic time 'mono_ns'
+void timekeeping_set_wall(uint64_t real_ns, uint64_t mono_ns);
+uint64_t ktime_get_real_ns(void);
+uint64_t ktime_mono_to_real(uint64_t mono_ns);
+uint32_t ktime_get_real_seconds(void);   // Since 1970
+
+static inline uint64_t clocksource_cyc2ns(const clocksource_t* cs, uint64_t cycles) {
+    return mul_u64_u32_shr(cycles, cs->mult, cs->shift);
+}
+
+#endif // CLOCKSOURCE_H
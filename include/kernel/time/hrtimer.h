@@ -0,0 +1,75 @@
+// include/kernel/time/hrtimer.h
+#ifndef HRTIMER_H
+#define HRTIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * High-resolution timers
+ *
+ * There is no periodic tick. Pending timers sit in a min-heap ordered by
+ * expiry, and the local APIC timer is armed for the earliest one only:
+ * as a TSC deadline when the CPU has that mode, else as a one-shot
+ * countdown. Nothing pending means nothing armed.
+ *
+ * Times are ktime_get_ns() values. Callbacks run from the timer
+ * interrupt with interrupts off; returning HRTIMER_RESTART requeues the
+ * timer at whatever 'expires' the callback left in it.
+ */
+
+#define HRTIMER_HEAP_MAX 64
+
+typedef enum {
+    HRTIMER_NORESTART,
+    HRTIMER_RESTART,
+} hrtimer_restart_t;
+
+typedef enum {
+    HRTIMER_MODE_ABS,             // 'expires' is a ktime_get_ns() value
+    HRTIMER_MODE_REL,             // ... or nanoseconds from now
+} hrtimer_mode_t;
+
+typedef struct hrtimer {
+    uint64_t expires;
+    hrtimer_restart_t (*function)(struct hrtimer* timer);
+    void* ctx;
+    int index;                    // Heap slot, -1 while not queued
+} hrtimer_t;
+
+typedef struct {
+    const char* mode;             // "tsc-deadline", "lapic" or NULL
+    uint32_t lapic_hz;            // Countdown rate in lapic mode
+    uint32_t interrupts;
+    uint32_t expired;             // Callbacks run
+    uint32_t programmed;          // Hardware armings
+    uint32_t pending;
+} hrtimer_stats_t;
+
+// Pick the timer hardware; false when there is none, and timers then
+// only run when idle_poll() calls hrtimer_run_expired()
+bool hrtimers_init(void);
+bool hrtimer_can_wake(void);
+
+void hrtimer_init(hrtimer_t* timer, hrtimer_restart_t (*function)(hrtimer_t*), void* ctx);
+
+// Queue or requeue; -ENOSPC when the heap is full
+int hrtimer_start(hrtimer_t* timer, uint64_t expires, hrtimer_mode_t mode);
+
+// True if the timer was pending
+bool hrtimer_cancel(hrtimer_t* timer);
+
+static inline bool hrtimer_active(const hrtimer_t* timer) {
+    return timer->index >= 0;
+}
+
+// Move a periodic timer's expiry past 'now' in steps of 'interval';
+// returns the number of steps
+uint32_t hrtimer_forward(hrtimer_t* timer, uint64_t now, uint64_t interval);
+
+// Run whatever has expired and rearm the hardware
+void hrtimer_run_expired(void);
+
+void hrtimer_get_stats(hrtimer_stats_t* out);
+
+#endif // HRTIMER_H
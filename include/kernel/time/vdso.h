@@ -0,0 +1,41 @@
+// include/kernel/time/vdso.h
+#ifndef VDSO_H
+#define VDSO_H
+
+#include <stdint.h>
+#include "clocksource.h"
+
+/**
+ * Time page
+ *
+ * One page of timekeeping state that a process can map read-only and
+ * turn into the time itself, with rdtsc and a multiply, instead of
+ * trapping into the kernel. The kernel republishes it whenever the base
+ * moves: at a fold, a change of source, or a wall clock correction.
+ *
+ * 'seq' is a seqlock. It is odd while the kernel is writing; a reader
+ * takes a copy between two reads of the same even value. When the
+ * current source cannot be read from user mode, 'mode' says so and the
+ * reader falls back to the clock_gettime system call.
+ */
+
+#define VDSO_CLOCK_NONE  0        // Ask the kernel
+#define VDSO_CLOCK_TSC   1        // ns = mono_ns + cyc2ns(rdtsc - cycle_last)
+
+typedef struct {
+    volatile uint32_t seq;
+    uint32_t mode;
+    uint64_t cycle_last;          // TSC when the clock read mono_ns
+    uint64_t mono_ns;
+    uint64_t wall_offset_ns;      // Realtime minus monotonic
+    uint32_t mult;
+    uint32_t shift;
+} vdso_time_t;
+
+// The page itself, page-aligned and alone on its page
+extern const vdso_time_t vdso_time_page;
+
+// Publish a new base. Interrupts must be off.
+void vdso_update(const clocksource_t* cs, uint64_t cycle_last, uint64_t mono_ns, uint64_t wall_offset_ns);
+
+#endif // VDSO_H
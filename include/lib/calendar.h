@@ -0,0 +1,44 @@
+// include/lib/calendar.h
+#ifndef CALENDAR_H
+#define CALENDAR_H
+
+#include <stdint.h>
+
+/*
+ * Gregorian calendar arithmetic in closed form.
+ *
+ * Days are counted from 1970-01-01. Years are shifted to start in March
+ * so the leap day falls at the end, and grouped into 400-year eras of
+ * exactly 146097 days. Each conversion is then a few 32-bit multiplies
+ * and divisions by constants, with no loop over years or months.
+ */
+
+#define SECS_PER_DAY 86400
+
+static inline int32_t days_from_civil(int32_t year, uint32_t month, uint32_t day) {
+    year -= month <= 2;
+    int32_t era = (year >= 0 ? year : year - 399) / 400;
+    uint32_t yoe = (uint32_t)(year - era * 400);                            // [0, 399]
+    uint32_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;                   // [0, 146096]
+    return era * 146097 + (int32_t)doe - 719468;
+}
+
+static inline void civil_from_days(int32_t days, int32_t* year, uint32_t* month, uint32_t* day) {
+    days += 719468;
+    int32_t era = (days >= 0 ? days : days - 146096) / 146097;
+    uint32_t doe = (uint32_t)(days - era * 146097);
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;                                      // March = 0
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = (int32_t)yoe + era * 400 + (*month <= 2);
+}
+
+// 0 = Sunday; 1970-01-01 was a Thursday
+static inline uint32_t weekday_from_days(int32_t days) {
+    return days >= -4 ? (uint32_t)(days + 4) % 7 : (uint32_t)((days + 5) % 7 + 6);
+}
+
+#endif // CALENDAR_H
@@ -0,0 +1,46 @@
+// include/lib/errno.h
+#ifndef ERRNO_H
+#define ERRNO_H
+
+// Kernel error codes. Functions return 0 (or a count) on success and the
+// negated code on failure, e.g. "return -ENOENT;".
+#define EPERM         1   // Operation not permitted
+#define ENOENT        2   // No such file or directory
+#define EIO           5   // I/O error
+#define ENXIO         6   // No such device or address
+#define E2BIG         7   // Argument list too long
+#define EBADF         9   // Bad file descriptor
+#define EAGAIN       11   // Try again
+#define ENOMEM       12   // Out of memory
+#define EBUSY        16   // Device or resource busy
+#define EEXIST       17   // File exists
+#define ENODEV       19   // No such device
+#define ENOTDIR      20   // Not a directory
+#define EISDIR       21   // Is a directory
+#define EINVAL       22   // Invalid argument
+#define ENFILE       23   // File table overflow
+#define EMFILE       24   // Too many open files
+#define EFBIG        27   // File too large
+#define ENOSPC       28   // No space left on device
+#define ESPIPE       29   // Illegal seek
+#define EROFS        30   // Read-only file system
+#define EPIPE        32   // Broken pipe
+#define ENAMETOOLONG 36   // File name too long
+#define ENOSYS       38   // Function not implemented
+#define ENOTEMPTY    39   // Directory not empty
+#define ENOTSOCK     88   // Socket operation on non-socket
+#define EDESTADDRREQ 89   // Destination address required
+#define EMSGSIZE     90   // Message too long
+#define EPROTONOSUPPORT 93 // Protocol not supported
+#define EOPNOTSUPP   95   // Operation not supported
+#define EAFNOSUPPORT 97   // Address family not supported
+#define EADDRINUSE   98   // Address already in use
+#define ENETUNREACH 101   // Network is unreachable
+#define ECONNRESET  104   // Connection reset by peer
+#define ENOBUFS     105   // No buffer space available
+#define EISCONN     106   // Socket is already connected
+#define ENOTCONN    107   // Socket is not connected
+#define ETIMEDOUT   110   // Operation timed out
+#define ECONNREFUSED 111 // Connection refused
+
+#endif // ERRNO_H
@@ -0,0 +1,25 @@
+// include/lib/lz4.h
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * LZ4 block format.
+ *
+ * Greedy single-pass compressor with a small position hash, tuned for
+ * page-sized inputs (at most LZ4_MAX_INPUT bytes, so every offset fits the
+ * format's 16 bits). The decompressor checks every length against both
+ * buffers and fails cleanly on corrupt input.
+ */
+
+#define LZ4_MAX_INPUT 65535
+
+// Compressed size, or 0 if the result would not fit in dst_cap
+size_t lz4_compress(const uint8_t* src, size_t len, uint8_t* dst, size_t dst_cap);
+
+// Decompressed size, or -EINVAL on malformed input or overflow of dst_cap
+int lz4_decompress(const uint8_t* src, size_t len, uint8_t* dst, size_t dst_cap);
+
+#endif // LZ4_H
@@ -0,0 +1,64 @@
+// include/lib/math64.h
+#ifndef MATH64_H
+#define MATH64_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * 64-bit division helpers.
+ *
+ * The kernel is linked without libgcc, so a plain "/" or "%" on a uint64_t
+ * would leave an undefined reference to __udivdi3/__umoddi3. These helpers
+ * divide a 64-bit dividend by a 32-bit divisor with two 32-bit divl steps.
+ */
+
+// Divide n by base, store the remainder in *rem (may be NULL)
+static inline uint64_t div_u64_rem(uint64_t n, uint32_t base, uint32_t *rem) {
+    uint32_t high = (uint32_t)(n >> 32);
+    uint32_t low = (uint32_t)n;
+    uint32_t q_high = 0;
+    uint32_t r;
+
+    if (high >= base) {
+        q_high = high / base;
+        high %= base;
+    }
+
+    uint32_t q_low;
+    __asm__ ("divl %4"
+             : "=a"(q_low), "=d"(r)
+             : "a"(low), "d"(high), "rm"(base));
+
+    if (rem) *rem = r;
+    return ((uint64_t)q_high << 32) | q_low;
+}
+
+// Divide n by base
+static inline uint64_t div_u64(uint64_t n, uint32_t base) {
+    return div_u64_rem(n, base, NULL);
+}
+
+// Divide n by a full 64-bit divisor. Only for setup paths: it costs two
+// divisions once the divisor no longer fits in 32 bits.
+static inline uint64_t div64_u64(uint64_t n, uint64_t d) {
+    uint32_t high = (uint32_t)(d >> 32);
+    if (!high) return div_u64(n, (uint32_t)d);
+
+    // Scale both down until the divisor fits, then fix the estimate up
+    int shift = 32 - __builtin_clz(high);
+    uint64_t q = div_u64(n >> shift, (uint32_t)(d >> shift));
+    if (q) q--;
+    if (n - q * d >= d) q++;
+    return q;
+}
+
+// (a * mul) >> shift with a 96-bit intermediate, for 0 < shift < 32: the
+// cycles-to-nanoseconds step of a clock source
+static inline uint64_t mul_u64_u32_shr(uint64_t a, uint32_t mul, unsigned int shift) {
+    uint64_t low = (uint64_t)(uint32_t)a * mul;
+    uint64_t high = (uint64_t)(uint32_t)(a >> 32) * mul;
+    return (low >> shift) + (high << (32 - shift));
+}
+
+#endif // MATH64_H
@@ -0,0 +1,44 @@
+// include/lib/radix_tree.h
+#ifndef RADIX_TREE_H
+#define RADIX_TREE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Radix tree mapping 32-bit indices to pointers.
+ *
+ * Each level resolves RADIX_TREE_MAP_SHIFT bits of the index, so a lookup
+ * touches at most ceil(32 / 6) = 6 nodes and the tree only grows as tall
+ * as the largest index stored requires. Intermediate nodes are created on
+ * insert and freed as soon as they become empty.
+ */
+
+#define RADIX_TREE_MAP_SHIFT 6
+#define RADIX_TREE_MAP_SIZE  (1u << RADIX_TREE_MAP_SHIFT)
+#define RADIX_TREE_MAP_MASK  (RADIX_TREE_MAP_SIZE - 1)
+
+struct radix_tree_node {
+    uint32_t count;                          // Non-NULL slots
+    void* slots[RADIX_TREE_MAP_SIZE];
+};
+
+struct radix_tree_root {
+    uint32_t height;                         // 0 when empty
+    struct radix_tree_node* rnode;
+    uint32_t nodes;                          // Nodes currently allocated
+};
+
+void radix_tree_init(struct radix_tree_root* root);
+int radix_tree_insert(struct radix_tree_root* root, uint32_t index, void* item);
+void* radix_tree_lookup(const struct radix_tree_root* root, uint32_t index);
+void* radix_tree_delete(struct radix_tree_root* root, uint32_t index);
+
+// Swap the item at an index already present for another; returns the old
+// item, or NULL (and changes nothing) if the index is empty. Never allocates.
+void* radix_tree_replace(struct radix_tree_root* root, uint32_t index, void* item);
+
+// Find the first item with index >= start; its index goes to *index
+void* radix_tree_next(const struct radix_tree_root* root, uint32_t start, uint32_t* index);
+
+#endif // RADIX_TREE_H
@@ -0,0 +1,19 @@
+// include/lib/sort.h
+#ifndef SORT_H
+#define SORT_H
+
+#include <stdint.h>
+
+/**
+ * Sorting of 32-bit samples
+ *
+ * Heapsort: in place, no allocation and O(n log n) whatever the input,
+ * which suits latency samples that arrive mostly sorted or all alike.
+ */
+
+void sort_u32(uint32_t* a, uint32_t n);
+
+// Sample at percentile p/1000 of an ascending array of n > 0 samples
+uint32_t sort_percentile_u32(const uint32_t* sorted, uint32_t n, uint32_t p);
+
+#endif // SORT_H
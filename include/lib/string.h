@@ -13,8 +13,12 @@ char *strcat(char *dest, const char *src);
 char *strncat(char *dest, const char *src, size_t n);
 void *memset(void *s, int c, size_t n);
 void *memcpy(void *dest, const void *src, size_t n);
+void *memmove(void *dest, const void *src, size_t n);
+int memcmp(const void *s1, const void *s2, size_t n);
 char *strtok(char *str, const char *delim);
 char *strchr(const char *str, int c);
+char *strrchr(const char *s, int c);
+char *strstr(const char *haystack, const char *needle);
 char* itoa(int value, char* str, int base);
 
 #endif // STRING_H
@@ -0,0 +1,22 @@
+// include/lib/time.h
+#ifndef TIME_H
+#define TIME_H
+
+#include <stdint.h>
+
+#define CLOCK_REALTIME   0
+#define CLOCK_MONOTONIC  1
+
+struct timespec {
+    int32_t tv_sec;
+    int32_t tv_nsec;
+};
+
+// Read from the time page when the clock runs off the TSC, else through
+// the system call. 0 or -EINVAL.
+int clock_gettime(int clock, struct timespec *ts);
+
+// The same, in nanoseconds; 0 for an unknown clock
+uint64_t clock_gettime_ns(int clock);
+
+#endif // TIME_H
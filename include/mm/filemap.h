@@ -0,0 +1,45 @@
+// include/mm/filemap.h
+#ifndef FILEMAP_H
+#define FILEMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../fs/vfs.h"
+
+/**
+ * Page cache
+ *
+ * File data of filesystems that provide f_op->readpages is cached in
+ * whole pages, indexed per inode by page number. read() copies out of
+ * these pages; writes go to the filesystem first and then update any
+ * cached copy, so the cache never holds dirty data of its own. Readers
+ * that only need to look at the data can borrow a cached page instead of
+ * copying it.
+ */
+
+#define FILEMAP_READAHEAD_PAGES 32      // Largest run filled at once (128KB)
+
+typedef struct {
+    uint32_t pages;             // Pages holding file data now
+    uint32_t limit;             // Most pages the cache may hold
+    uint32_t lookups;           // Pages asked for by read() and borrowers
+    uint32_t hits;              // ... that were already cached
+    uint32_t readahead;         // Pages filled before anyone asked for them
+    uint32_t evictions;         // Pages reclaimed to make room
+} filemap_stats_t;
+
+void filemap_init(void);
+
+int filemap_read(vfs_inode_t* inode, void* buf, size_t count, vfs_off_t offset);
+void filemap_write(vfs_inode_t* inode, const void* buf, size_t count, vfs_off_t offset);
+void filemap_truncate(vfs_inode_t* inode, vfs_off_t size);
+void filemap_evict(vfs_inode_t* inode);
+
+// Borrow page 'index' of a file, read-only, until filemap_put_page()
+int filemap_get_page(vfs_inode_t* inode, uint32_t index, const uint8_t** data);
+void filemap_put_page(vfs_inode_t* inode, uint32_t index);
+
+void filemap_get_stats(filemap_stats_t* stats);
+void filemap_reset_stats(void);
+
+#endif // FILEMAP_H
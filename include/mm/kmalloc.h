@@ -0,0 +1,19 @@
+// kmalloc.h
+#ifndef KMALLOC_H
+#define KMALLOC_H
+#include <stdint.h>
+#include <stddef.h>
+
+// Kernel heap. Small requests come from per-size-class pages, larger
+// ones from physically contiguous page runs handed out by the VMM.
+void kmalloc_init(void);
+void* kmalloc(size_t size);
+void* kzalloc(size_t size);
+void* krealloc(void* ptr, size_t size);
+void kfree(void* ptr);
+
+// Statistics
+size_t kmalloc_get_used_bytes(void);
+size_t kmalloc_get_heap_pages(void);
+
+#endif // KMALLOC_H
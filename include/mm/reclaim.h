@@ -0,0 +1,59 @@
+// include/mm/reclaim.h
+#ifndef RECLAIM_H
+#define RECLAIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Page reclaim
+ *
+ * Subsystems holding pages they can give back register a source whose
+ * shrink() runs its own CLOCK hand and returns how many pages it freed.
+ * Sources are asked in registration order, so clean page-cache pages go
+ * before tmpfs pages that have to be compressed into zram.
+ *
+ * When free memory drops below the low watermark the page allocator wakes
+ * the reclaimer, which runs as idle work until free memory is back above
+ * the high watermark. An allocation that finds no free page at all
+ * reclaims synchronously before giving up. The last RECLAIM_RESERVE free
+ * pages are kept for reclaim itself, since compressing a page into zram
+ * may need a fresh heap page before anything has been freed.
+ *
+ * shrink() may be called from inside the page allocator; a source that is
+ * in the middle of changing its own structures returns 0.
+ */
+
+#define RECLAIM_BATCH 32                // Pages per idle pass
+#define RECLAIM_RESERVE 32              // Free pages only reclaim may take
+
+typedef struct reclaim_source {
+    const char* name;
+    uint32_t (*shrink)(uint32_t target);
+    uint32_t reclaimed;                 // Pages this source has given back
+    struct reclaim_source* next;
+} reclaim_source_t;
+
+typedef struct {
+    uint32_t low;                // Watermarks, in free pages
+    uint32_t high;
+    uint32_t wakeups;            // Times the low watermark woke the reclaimer
+    uint32_t direct;             // Allocations that had to reclaim themselves
+    uint32_t reclaimed;          // Pages freed, all sources
+    uint64_t busy_ns;            // Time spent reclaiming
+} reclaim_stats_t;
+
+void reclaim_init(void);
+void reclaim_register(reclaim_source_t* source);
+const reclaim_source_t* reclaim_sources(void);
+
+void reclaim_wake(void);
+bool reclaim_in_progress(void);
+
+// Free up to 'target' pages now; returns how many were freed
+uint32_t reclaim_pages(uint32_t target);
+
+void reclaim_get_stats(reclaim_stats_t* stats);
+
+#endif // RECLAIM_H
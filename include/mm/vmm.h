@@ -25,11 +25,15 @@ typedef struct {
 
 // Virtual memory manager functions
 void vmm_init(uint32_t* page_bitmap_start, uint64_t total_memory_bytes);
-uint32_t* vmm_alloc_page(void);
+uint32_t* vmm_alloc_page(void);            // Panics when memory is exhausted
 void vmm_free_page(uint32_t* page);
+uint32_t* vmm_alloc_pages(size_t count);   // Physically contiguous run, NULL if none
+void vmm_free_pages(uint32_t* pages, size_t count);
 size_t vmm_get_total_pages(void);
 size_t vmm_get_used_pages(void);
 size_t vmm_get_free_pages(void);
+void vmm_set_low_watermark(size_t pages);  // Wake reclaim below this many free pages
+void vmm_set_reserve(size_t pages);        // Free pages only reclaim may allocate
 
 // Virtual memory mapping functions
 void vmm_map_page(uint32_t virtual_addr, uint32_t physical_addr, uint32_t flags);
@@ -0,0 +1,41 @@
+// include/mm/zram.h
+#ifndef ZRAM_H
+#define ZRAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Compressed RAM store
+ *
+ * Holds pages evicted by reclaim, LZ4-compressed in kmalloc memory. A
+ * page that is one 32-bit word repeated (most often all zeros) is kept as
+ * just that word. Pages whose entry, header included, would not fit in
+ * ZRAM_MAX_STORED bytes are refused and stay uncompressed: kmalloc rounds
+ * a larger entry up to the 2048-byte class, two to a page, which saves
+ * too little to be worth the compression.
+ */
+
+#define ZRAM_MAX_STORED 1024            // kmalloc's 1024-byte class, four to a page
+
+typedef struct zram_entry zram_entry_t;
+
+typedef struct {
+    uint32_t pages;              // Pages held now
+    uint32_t same_filled;        // ... of which stored as a single word
+    uint32_t compressed_bytes;   // Compressed data held for the rest
+    uint32_t stores;             // Pages taken in
+    uint32_t loads;              // Pages given back
+    uint32_t rejects;            // Pages refused as incompressible
+} zram_stats_t;
+
+// Copy a page in; -E2BIG if it does not compress, -ENOMEM if no memory
+int zram_store(const void* page, zram_entry_t** out);
+
+// Copy a stored page back out and free the entry
+int zram_load(zram_entry_t* entry, void* page);
+void zram_free(zram_entry_t* entry);
+
+void zram_get_stats(zram_stats_t* stats);
+
+#endif // ZRAM_H
@@ -0,0 +1,35 @@
+// include/net/arp.h
+#ifndef ARP_H
+#define ARP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "skbuff.h"
+#include "netdev.h"
+
+/**
+ * ARP
+ *
+ * A small neighbour cache for Ethernet devices. Packets for a next hop
+ * whose address is not known yet wait on its entry while a request is
+ * out; the reply sends them.
+ */
+
+#define ARP_CACHE_SIZE     32
+#define ARP_QUEUE_MAX      8            // Packets held per unresolved entry
+#define ARP_RETRY_MS       1000
+
+typedef struct {
+    uint32_t requests;
+    uint32_t replies;
+    uint32_t received;
+    uint32_t queue_drops;
+} arp_stats_t;
+
+// Address the packet to 'next_hop' and transmit it; takes the skb
+int arp_output(sk_buff_t* skb, netdev_t* dev, uint32_t next_hop);
+void arp_rcv(sk_buff_t* skb);
+
+void arp_get_stats(arp_stats_t* stats);
+
+#endif // ARP_H
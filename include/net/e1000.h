@@ -0,0 +1,10 @@
+#ifndef E1000_H
+#define E1000_H
+
+#include <stdint.h>
+
+// Probe Intel 8254x NICs and register them as ethN.
+// Returns the number of devices found.
+int e1000_init(void);
+
+#endif // E1000_H
@@ -0,0 +1,41 @@
+// include/net/ethernet.h
+#ifndef ETHERNET_H
+#define ETHERNET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "skbuff.h"
+#include "netdev.h"
+
+/**
+ * Ethernet framing
+ *
+ * Drivers for Ethernet NICs call ether_setup() before registering and
+ * eth_type_trans() on every received frame. The header is pushed on
+ * transmit by ARP once the next hop's address is known.
+ */
+
+#define ETH_ALEN      6
+#define ETH_HLEN      14
+#define ETH_DATA_LEN  1500
+#define ETH_ZLEN      60                // Shortest frame, without the FCS
+
+struct ethhdr {
+    uint8_t h_dest[ETH_ALEN];
+    uint8_t h_source[ETH_ALEN];
+    uint16_t h_proto;
+} __attribute__((packed));
+
+extern const uint8_t eth_broadcast_addr[ETH_ALEN];
+
+// Name the device ethN and fill in the Ethernet defaults
+void ether_setup(netdev_t* dev);
+
+// Push a header addressed to 'daddr' from the device
+void eth_header(sk_buff_t* skb, netdev_t* dev, const uint8_t* daddr, uint16_t proto);
+
+// Pull the header and set skb->dev and skb->protocol. False if the frame
+// is addressed to some other station.
+bool eth_type_trans(sk_buff_t* skb, netdev_t* dev);
+
+#endif // ETHERNET_H
@@ -0,0 +1,76 @@
+// include/net/inet.h
+#ifndef INET_H
+#define INET_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Internet byte order and checksums
+ *
+ * Addresses and ports are kept in network byte order everywhere below
+ * the socket API, as they appear on the wire. The Internet checksum is
+ * accumulated 16 bits at a time into a 32-bit sum and folded at the end,
+ * so partial sums (pseudo-header, header, payload) can simply be added.
+ */
+
+#define INADDR_ANY       0x00000000u
+#define INADDR_LOOPBACK  0x7F000001u     // Host byte order, like Linux
+#define INADDR_BROADCAST 0xFFFFFFFFu
+
+#define IPPROTO_IP   0
+#define IPPROTO_ICMP 1
+#define IPPROTO_TCP  6
+#define IPPROTO_UDP  17
+
+#define ETH_P_IP     0x0800
+#define ETH_P_ARP    0x0806
+
+static inline uint16_t htons(uint16_t x) {
+    return (uint16_t)((x << 8) | (x >> 8));
+}
+
+static inline uint32_t htonl(uint32_t x) {
+    return __builtin_bswap32(x);
+}
+
+#define ntohs htons
+#define ntohl htonl
+
+// Sum 'len' bytes into 'sum'; an odd last byte is padded with zero
+static inline uint32_t csum_partial(const void* buf, size_t len, uint32_t sum) {
+    const uint16_t* p = buf;
+    while (len > 1) {
+        sum += *p++;
+        if (sum & 0x80000000u) sum = (sum & 0xFFFF) + (sum >> 16);
+        len -= 2;
+    }
+    if (len) sum += *(const uint8_t*)p;
+    return sum;
+}
+
+static inline uint16_t csum_fold(uint32_t sum) {
+    while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+// Sum of the TCP/UDP pseudo-header; addresses in network byte order
+static inline uint32_t csum_tcpudp_nofold(uint32_t saddr, uint32_t daddr, uint16_t len,
+                                          uint8_t proto, uint32_t sum) {
+    sum += (saddr & 0xFFFF) + (saddr >> 16);
+    sum += (daddr & 0xFFFF) + (daddr >> 16);
+    sum += htons(proto);
+    sum += htons(len);
+    return sum;
+}
+
+static inline uint16_t ip_fast_csum(const void* iph, size_t len) {
+    return csum_fold(csum_partial(iph, len, 0));
+}
+
+// Dotted quad to network order and back; inet_aton returns 0 if malformed
+#define INET_ADDRSTRLEN 16
+int inet_aton(const char* cp, uint32_t* addr);
+char* inet_ntoa_r(uint32_t addr, char* buf);
+
+#endif // INET_H
@@ -0,0 +1,65 @@
+// include/net/ip.h
+#ifndef IP_H
+#define IP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "skbuff.h"
+#include "netdev.h"
+#include "inet.h"
+
+/**
+ * IPv4
+ *
+ * No fragmentation or reassembly: transports size their packets to the
+ * route's MTU and fragments are dropped on receive. Routing knows the
+ * loopback network, addresses owned by a device (delivered through
+ * loopback) and the directly attached subnet of each device.
+ */
+
+#define IP_DF       0x4000
+#define IP_MF       0x2000
+#define IP_OFFSET   0x1FFF
+#define IP_TTL      64
+
+struct iphdr {
+    uint8_t ihl_version;                // Version in the high nibble
+    uint8_t tos;
+    uint16_t tot_len;
+    uint16_t id;
+    uint16_t frag_off;
+    uint8_t ttl;
+    uint8_t protocol;
+    uint16_t check;
+    uint32_t saddr;
+    uint32_t daddr;
+} __attribute__((packed));
+
+typedef struct {
+    uint32_t in_receives;
+    uint32_t in_hdr_errors;
+    uint32_t in_discards;               // Not for us, fragments, unknown protocol
+    uint32_t in_delivers;
+    uint32_t out_requests;
+    uint32_t out_no_routes;
+} ip_stats_t;
+
+static inline struct iphdr* ip_hdr(const sk_buff_t* skb) {
+    return (struct iphdr*)skb->network_header;
+}
+
+// Device for 'daddr' and the source address to use; NULL if unreachable
+netdev_t* ip_route(uint32_t daddr, uint32_t* saddr);
+bool ip_is_local(uint32_t addr);
+
+// Checksum a transport header at skb->data, or leave it to the device
+void ip_transport_csum(sk_buff_t* skb, netdev_t* dev, uint32_t saddr, uint32_t daddr,
+                       uint8_t proto, uint16_t csum_offset);
+
+// Push the IP header and transmit; takes the skb
+int ip_send(sk_buff_t* skb, netdev_t* dev, uint32_t saddr, uint32_t daddr, uint8_t proto);
+void ip_rcv(sk_buff_t* skb);
+
+void ip_get_stats(ip_stats_t* stats);
+
+#endif // IP_H
@@ -0,0 +1,109 @@
+// include/net/netdev.h
+#ifndef NETDEV_H
+#define NETDEV_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "skbuff.h"
+
+/**
+ * Network devices
+ *
+ * Drivers register a netdev_t and transmit through ops->xmit, which takes
+ * the skb whether it succeeds or not. Received packets come back in one
+ * of two ways: netif_rx() queues an skb on the backlog and is safe from
+ * interrupt context, while a driver that polls (NAPI style) calls
+ * napi_schedule() from its interrupt handler and later hands packets
+ * straight up with netif_receive_skb() from ops->poll.
+ *
+ * There are no softirqs; net_poll() drains the backlog and runs the
+ * scheduled pollers. It runs as idle work and from every socket wait, so
+ * protocol processing happens in the context of whoever is waiting.
+ *
+ * Drivers with a doorbell provide ops->flush. dev_queue_xmit() rings it
+ * after every packet, except between net_tx_batch_begin() and
+ * net_tx_batch_end(): there packets only go on the ring and the end of
+ * the batch flushes each device once.
+ */
+
+#define NETDEV_MAX        8
+#define NETDEV_NAME_MAX   16
+#define NETDEV_BACKLOG    1024          // Packets held by netif_rx()
+#define NAPI_WEIGHT       64            // Packets per poll before moving on
+
+// flags
+#define IFF_UP            0x0001
+#define IFF_LOOPBACK      0x0002
+
+// features
+#define NETIF_F_HW_CSUM   0x0001        // Fills in CHECKSUM_PARTIAL on transmit
+#define NETIF_F_RXCSUM    0x0002        // Verifies checksums on receive
+
+typedef struct {
+    int (*xmit)(netdev_t* dev, sk_buff_t* skb);
+    void (*flush)(netdev_t* dev);       // Optional: notify the device of queued packets
+    // Returns packets processed; below budget means the queue is empty
+    // and the driver has turned its receive interrupt back on
+    int (*poll)(netdev_t* dev, int budget);
+    // Optional: hold interrupts to 'rate' per second, 0 for no limit
+    int (*set_coalesce)(netdev_t* dev, uint32_t rate);
+} netdev_ops_t;
+
+typedef struct {
+    uint64_t rx_packets;
+    uint64_t tx_packets;
+    uint64_t rx_bytes;
+    uint64_t tx_bytes;
+    uint32_t rx_dropped;
+    uint32_t tx_dropped;
+    uint32_t rx_errors;
+    uint32_t tx_errors;
+    // Driver events, for comparing against the packet counts
+    uint32_t interrupts;
+    uint32_t polls;
+    uint32_t doorbells;
+} netdev_stats_t;
+
+struct netdev {
+    char name[NETDEV_NAME_MAX];
+    uint32_t flags;
+    uint32_t features;
+    uint32_t mtu;
+    uint16_t hard_header_len;           // Link header pushed by the device
+    uint8_t mac[6];
+    uint32_t ipv4_addr;                 // Network byte order
+    uint32_t ipv4_mask;
+    uint32_t coalesce_rate;             // Interrupts per second at most, 0 if unlimited
+    const netdev_ops_t* ops;
+    void* private;
+    netdev_stats_t stats;
+    // Owned by net_poll() while scheduled
+    netdev_t* poll_next;
+    bool poll_scheduled;
+    bool tx_pending;                    // Queued inside a batch, not yet flushed
+};
+
+void net_init(void);
+
+int netdev_register(netdev_t* dev);
+size_t netdev_count(void);
+netdev_t* netdev_get(size_t index);
+netdev_t* netdev_find(const char* name);
+
+// Transmit; takes the skb. skb->dev and skb->protocol must be set.
+int dev_queue_xmit(sk_buff_t* skb);
+void net_tx_batch_begin(void);
+void net_tx_batch_end(void);
+
+// Receive paths; both take the skb
+void netif_rx(sk_buff_t* skb);             // Any context
+void netif_receive_skb(sk_buff_t* skb);    // Process context (ops->poll)
+void napi_schedule(netdev_t* dev);
+
+// Process pending receive work; returns packets handled
+int net_poll(void);
+
+void loopback_init(void);
+
+#endif // NETDEV_H
@@ -0,0 +1,142 @@
+// include/net/skbuff.h
+#ifndef SKBUFF_H
+#define SKBUFF_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Packet buffers
+ *
+ * Every packet lives in one fixed-size buffer taken from a pool, with
+ * SKB_HEADROOM bytes kept free in front of the data so each layer on the
+ * way out prepends its header with skb_push() instead of copying the
+ * payload. On the way in, layers skb_pull() their header off the front.
+ * An skb has one owner at a time; handing it to a function that "takes"
+ * it passes that ownership on, including the duty to skb_free() it.
+ *
+ * Buffers are carved from whole pages and never go back to the page
+ * allocator; freed skbs return to a LIFO free list, so the next packet
+ * reuses the buffer that is most likely still in the cache.
+ */
+
+#define SKB_BUF_SIZE   2048             // Whole buffer, headroom included
+#define SKB_HEADROOM   128              // Device + link + IP + TCP headers fit
+#define SKB_MAX_DATA   (SKB_BUF_SIZE - SKB_HEADROOM)
+#define SKB_POOL_INIT  256
+#define SKB_POOL_MAX   4096
+#define SKB_CB_SIZE    24
+
+// ip_summed: what is known about the transport checksum
+#define CHECKSUM_NONE         0         // Not computed, not verified
+#define CHECKSUM_UNNECESSARY  1         // Verified by hardware, or never left memory
+#define CHECKSUM_PARTIAL      2         // Device fills it in: csum_start/csum_offset
+
+typedef struct netdev netdev_t;
+typedef struct sk_buff sk_buff_t;
+
+struct sk_buff {
+    sk_buff_t* next;                    // Queue link, owned by the holder
+    uint8_t* head;                      // Start of the buffer
+    uint8_t* data;                      // Start of valid data
+    uint32_t len;                       // Valid bytes from data
+    netdev_t* dev;
+    uint16_t protocol;                  // ETH_P_* of the network header
+    uint8_t ip_summed;
+    uint16_t csum_start;                // CHECKSUM_PARTIAL: from head
+    uint16_t csum_offset;               // ... to the field, from csum_start
+    uint8_t* network_header;
+    uint8_t* transport_header;
+    uint64_t tstamp;                    // TSC at receive, 0 if unset
+    uint8_t cb[SKB_CB_SIZE];            // Scratch for the layer holding it
+};
+
+typedef struct {
+    sk_buff_t* head;
+    sk_buff_t* tail;
+    uint32_t len;                       // Packets queued
+} sk_buff_head_t;
+
+typedef struct {
+    uint32_t total;                     // Buffers carved so far
+    uint32_t free;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;                  // Pool at SKB_POOL_MAX and empty
+} skb_stats_t;
+
+void skb_init(void);
+sk_buff_t* skb_alloc(void);            // Data empty, SKB_HEADROOM reserved
+void skb_free(sk_buff_t* skb);
+void skb_get_stats(skb_stats_t* stats);
+
+static inline uint8_t* skb_end(const sk_buff_t* skb) {
+    return skb->head + SKB_BUF_SIZE;
+}
+
+static inline uint32_t skb_headroom(const sk_buff_t* skb) {
+    return skb->data - skb->head;
+}
+
+static inline uint32_t skb_tailroom(const sk_buff_t* skb) {
+    return skb_end(skb) - (skb->data + skb->len);
+}
+
+// Extend the data at the end; returns where the new bytes go
+static inline uint8_t* skb_put(sk_buff_t* skb, uint32_t len) {
+    uint8_t* tail = skb->data + skb->len;
+    skb->len += len;
+    return tail;
+}
+
+// Extend the data at the front, into the headroom
+static inline uint8_t* skb_push(sk_buff_t* skb, uint32_t len) {
+    skb->data -= len;
+    skb->len += len;
+    return skb->data;
+}
+
+// Drop bytes from the front; returns the new data start
+static inline uint8_t* skb_pull(sk_buff_t* skb, uint32_t len) {
+    skb->data += len;
+    skb->len -= len;
+    return skb->data;
+}
+
+static inline void skb_trim(sk_buff_t* skb, uint32_t len) {
+    if (len < skb->len) skb->len = len;
+}
+
+// Start over empty, with 'headroom' bytes before the data
+static inline void skb_reset(sk_buff_t* skb, uint32_t headroom) {
+    skb->data = skb->head + headroom;
+    skb->len = 0;
+}
+
+static inline void skb_queue_init(sk_buff_head_t* q) {
+    q->head = q->tail = NULL;
+    q->len = 0;
+}
+
+static inline void skb_queue_tail(sk_buff_head_t* q, sk_buff_t* skb) {
+    skb->next = NULL;
+    if (q->tail) q->tail->next = skb;
+    else q->head = skb;
+    q->tail = skb;
+    q->len++;
+}
+
+static inline sk_buff_t* skb_dequeue(sk_buff_head_t* q) {
+    sk_buff_t* skb = q->head;
+    if (!skb) return NULL;
+    q->head = skb->next;
+    if (!q->head) q->tail = NULL;
+    q->len--;
+    skb->next = NULL;
+    return skb;
+}
+
+void skb_queue_purge(sk_buff_head_t* q);
+
+#endif // SKBUFF_H
@@ -0,0 +1,106 @@
+// include/net/sock.h
+#ifndef SOCK_H
+#define SOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "skbuff.h"
+#include "socket.h"
+
+/**
+ * Socket internals
+ *
+ * A struct sock is the protocol's view of a socket; the descriptor layer
+ * in socket.c only maps numbers to socks and waits. Each protocol fills a
+ * struct proto. Addresses and ports are in network byte order.
+ */
+
+#define SOCK_RCVBUF_DEFAULT  (64 * 1024)
+#define SOCK_SNDBUF_DEFAULT  (64 * 1024)
+
+#define SK_SHUT_RD   0x01
+#define SK_SHUT_WR   0x02
+
+struct sock;
+
+struct proto {
+    const char* name;
+    int (*bind)(struct sock* sk, uint32_t addr, uint16_t port);   // port 0: pick one
+    int (*connect)(struct sock* sk, uint32_t daddr, uint16_t dport);
+    int (*listen)(struct sock* sk, int backlog);
+    struct sock* (*accept)(struct sock* sk);                      // NULL if none queued
+    int (*sendmsg)(struct sock* sk, const void* buf, size_t len, int flags,
+                   uint32_t daddr, uint16_t dport);
+    int (*send_skb)(struct sock* sk, sk_buff_t* skb, int flags, uint32_t daddr, uint16_t dport);
+    void (*recvd)(struct sock* sk);                               // Data was consumed
+    void (*shutdown)(struct sock* sk, int how);
+    void (*close)(struct sock* sk);                               // Frees when done
+};
+
+// Per-packet state kept in skb->cb by the transports
+struct inet_skb_cb {
+    uint32_t saddr;
+    uint16_t sport;
+};
+
+#define INET_SKB_CB(skb) ((struct inet_skb_cb*)(skb)->cb)
+
+struct sock {
+    int type;                           // SOCK_STREAM or SOCK_DGRAM
+    const struct proto* prot;
+    uint32_t saddr;                     // Bound address, INADDR_ANY if unbound
+    uint16_t sport;                     // 0 until bound
+    uint32_t daddr;                     // Peer, 0 if unconnected
+    uint16_t dport;
+    int err;                            // Pending error, -errno
+    uint8_t shutdown;                   // SK_SHUT_*
+    bool reuseaddr;
+    uint32_t rcvtimeo_ms;               // 0 waits forever
+    uint32_t sndtimeo_ms;
+    uint32_t rcvbuf;
+    uint32_t sndbuf;
+    uint32_t rcv_queued;                // Payload bytes on receive_queue
+    sk_buff_head_t receive_queue;
+    struct sock* next;                  // Protocol's socket table
+
+    // TCP
+    uint8_t state;
+    uint16_t mss;
+    uint32_t snd_una;
+    uint32_t snd_nxt;
+    uint32_t snd_wnd;
+    uint32_t rcv_nxt;
+    uint32_t rcv_wup;                   // rcv_nxt when the window was last sent
+    uint32_t rcv_wnd;                   // ... and the window sent then
+    struct sock* parent;                // Listener this connection arrived on
+    struct sock* accept_head;           // Established, not yet accepted
+    struct sock* accept_tail;
+    struct sock* accept_next;
+    uint16_t accept_len;
+    uint16_t backlog;
+    bool orphan;                        // Descriptor closed, protocol still busy
+};
+
+extern const struct proto udp_prot;
+extern const struct proto tcp_prot;
+
+struct sock* sock_alloc(int type, const struct proto* prot);
+void sock_free(struct sock* sk);
+
+// Room left in the receive buffer
+static inline uint32_t sock_rspace(const struct sock* sk) {
+    return sk->rcv_queued < sk->rcvbuf ? sk->rcvbuf - sk->rcv_queued : 0;
+}
+
+// Poll the stack until ready(sk) holds: -EAGAIN if 'nonblock' or the
+// timeout passes first
+int sock_wait(struct sock* sk, bool (*ready)(struct sock* sk), uint32_t timeout_ms, bool nonblock);
+
+// Pick a free port in the ephemeral range; 'in_use' checks a candidate
+uint16_t inet_ephemeral_port(bool (*in_use)(uint16_t port));
+
+void udp_rcv(sk_buff_t* skb);
+void tcp_rcv(sk_buff_t* skb);
+
+#endif // SOCK_H
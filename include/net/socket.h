@@ -0,0 +1,87 @@
+// include/net/socket.h
+#ifndef SOCKET_H
+#define SOCKET_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "skbuff.h"
+
+/**
+ * BSD sockets
+ *
+ * Sockets share the descriptor space with files: numbers from
+ * SOCK_FD_BASE up name sockets, and read/write/close on them go here.
+ * The constants and structures match Linux i386, as does the socketcall
+ * system call that reaches these functions from user code.
+ *
+ * Blocking calls poll the network stack until they can complete. A
+ * receive timeout (SO_RCVTIMEO) bounds the wait; without one they wait
+ * forever, as on Linux.
+ *
+ * Kernel code can skip the copies entirely: socket_send_skb() hands a
+ * filled skb to the protocol and socket_recv_skb() takes the queued skb
+ * off the socket, so a payload is written once and read in place.
+ */
+
+#define SOCK_FD_BASE   64
+#define SOCK_MAX       32
+
+#define AF_UNSPEC      0
+#define AF_INET        2
+
+#define SOCK_STREAM    1
+#define SOCK_DGRAM     2
+
+#define SOL_SOCKET     1
+#define SO_REUSEADDR   2
+#define SO_ERROR       4
+#define SO_SNDBUF      7
+#define SO_RCVBUF      8
+#define SO_RCVTIMEO    20               // Value: uint32_t milliseconds, 0 = forever
+#define SO_SNDTIMEO    21
+
+#define MSG_PEEK       0x02
+#define MSG_DONTWAIT   0x40
+
+#define SHUT_RD        0
+#define SHUT_WR        1
+#define SHUT_RDWR      2
+
+typedef uint32_t socklen_t;
+
+struct sockaddr {
+    uint16_t sa_family;
+    char sa_data[14];
+};
+
+struct sockaddr_in {
+    uint16_t sin_family;
+    uint16_t sin_port;                  // Network byte order
+    uint32_t sin_addr;                  // Network byte order
+    uint8_t sin_zero[8];
+};
+
+bool socket_is_fd(int fd);
+
+int socket_create(int family, int type, int protocol);
+int socket_bind(int fd, const struct sockaddr* addr, socklen_t addrlen);
+int socket_connect(int fd, const struct sockaddr* addr, socklen_t addrlen);
+int socket_listen(int fd, int backlog);
+int socket_accept(int fd, struct sockaddr* addr, socklen_t* addrlen);
+int socket_getsockname(int fd, struct sockaddr* addr, socklen_t* addrlen);
+int socket_sendto(int fd, const void* buf, size_t len, int flags,
+                  const struct sockaddr* addr, socklen_t addrlen);
+int socket_recvfrom(int fd, void* buf, size_t len, int flags,
+                    struct sockaddr* addr, socklen_t* addrlen);
+int socket_setsockopt(int fd, int level, int name, const void* val, socklen_t len);
+int socket_getsockopt(int fd, int level, int name, void* val, socklen_t* len);
+int socket_shutdown(int fd, int how);
+int socket_close(int fd);
+
+// Zero-copy: payload at skb->data, headroom from skb_alloc(). Sending
+// takes the skb, even on error; a stream send must fit one segment.
+int socket_send_skb(int fd, sk_buff_t* skb, int flags, const struct sockaddr_in* addr);
+int socket_recv_skb(int fd, sk_buff_t** skb, int flags, struct sockaddr_in* addr);
+
+#endif // SOCKET_H
@@ -0,0 +1,10 @@
+#ifndef VIRTIO_NET_H
+#define VIRTIO_NET_H
+
+#include <stdint.h>
+
+// Probe virtio network devices and register them as eth0, eth1, ...
+// Returns the number of devices found.
+int virtio_net_init(void);
+
+#endif // VIRTIO_NET_H
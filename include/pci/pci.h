@@ -0,0 +1,92 @@
+#ifndef PCI_H
+#define PCI_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define PCI_MAX_DEVICES      64
+
+// Configuration space offsets
+#define PCI_VENDOR_ID        0x00
+#define PCI_DEVICE_ID        0x02
+#define PCI_COMMAND          0x04
+#define PCI_STATUS           0x06
+#define PCI_REVISION_ID      0x08
+#define PCI_PROG_IF          0x09
+#define PCI_SUBCLASS         0x0A
+#define PCI_CLASS            0x0B
+#define PCI_HEADER_TYPE      0x0E
+#define PCI_BAR0             0x10
+#define PCI_SUBSYSTEM_ID     0x2E
+#define PCI_CAPABILITY_LIST  0x34
+#define PCI_INTERRUPT_LINE   0x3C
+#define PCI_INTERRUPT_PIN    0x3D
+
+// Command register bits
+#define PCI_COMMAND_IO           0x0001
+#define PCI_COMMAND_MEMORY       0x0002
+#define PCI_COMMAND_MASTER       0x0004
+#define PCI_COMMAND_INTX_DISABLE 0x0400
+
+#define PCI_STATUS_CAP_LIST  0x0010
+
+// Capability IDs
+#define PCI_CAP_ID_MSI       0x05
+#define PCI_CAP_ID_VENDOR    0x09
+#define PCI_CAP_ID_MSIX      0x11
+
+// Class codes
+#define PCI_CLASS_STORAGE    0x01
+#define PCI_SUBCLASS_IDE     0x01
+#define PCI_SUBCLASS_NVME    0x08
+#define PCI_CLASS_NETWORK    0x02
+#define PCI_CLASS_BRIDGE     0x06
+
+typedef struct {
+    uint8_t bus;
+    uint8_t slot;
+    uint8_t func;
+    uint16_t vendor_id;
+    uint16_t device_id;
+    uint16_t subsystem_id;
+    uint8_t class_code;
+    uint8_t subclass;
+    uint8_t prog_if;
+    uint8_t revision;
+    uint8_t irq_line;
+    uint8_t irq_pin;
+    uint32_t bar[6];          // Raw BAR values as read at boot
+} pci_device_t;
+
+void pci_init(void);
+size_t pci_device_count(void);
+pci_device_t* pci_get_device(size_t index);
+pci_device_t* pci_find_device(uint16_t vendor, uint16_t device, size_t index);
+pci_device_t* pci_find_class(uint8_t class_code, uint8_t subclass, size_t index);
+
+// Configuration space access
+uint32_t pci_config_read32(const pci_device_t* dev, uint8_t offset);
+uint16_t pci_config_read16(const pci_device_t* dev, uint8_t offset);
+uint8_t pci_config_read8(const pci_device_t* dev, uint8_t offset);
+void pci_config_write32(const pci_device_t* dev, uint8_t offset, uint32_t value);
+void pci_config_write16(const pci_device_t* dev, uint8_t offset, uint16_t value);
+void pci_config_write8(const pci_device_t* dev, uint8_t offset, uint8_t value);
+
+// BAR helpers: decoded base address, I/O vs memory, size in bytes
+uint32_t pci_bar_address(const pci_device_t* dev, int bar);
+bool pci_bar_is_io(const pci_device_t* dev, int bar);
+uint32_t pci_bar_size(const pci_device_t* dev, int bar);
+
+void pci_enable(pci_device_t* dev, uint16_t command_bits);
+
+// Walk the capability list; returns the config offset or 0
+uint8_t pci_find_capability(const pci_device_t* dev, uint8_t cap_id);
+
+// Message-signalled interrupts aimed at LAPIC vectors. Enabling either
+// form turns off the legacy INTx pin. Return 0 or -errno.
+int pci_enable_msi(pci_device_t* dev, uint8_t vector);
+uint16_t pci_msix_table_size(const pci_device_t* dev);     // 0 without MSI-X
+int pci_enable_msix(pci_device_t* dev, const uint8_t* vectors, uint16_t count);
+
+#endif // PCI_H
@@ -0,0 +1,25 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// COM1, a 16550-compatible UART, driven by polling. It is the way bulk
+// data (profiles, traces) leaves the machine: under QEMU, "-serial
+// file:serial.log" catches everything written here on the host.
+#define SERIAL_COM1_PORT 0x3F8
+#define SERIAL_BAUD      115200
+
+// -ENODEV when no UART answers at COM1; output is then dropped
+int serial_init(void);
+bool serial_available(void);
+
+// Bytes go out as they are, with no newline translation
+void serial_putchar(char c);
+void serial_write(const void* buf, size_t len);
+void serial_puts(const char* str);
+void serial_puthex(uint32_t value);
+void serial_putdec(uint32_t value);
+
+#endif // SERIAL_H
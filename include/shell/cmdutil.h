@@ -0,0 +1,35 @@
+// include/shell/cmdutil.h
+#ifndef CMDUTIL_H
+#define CMDUTIL_H
+
+#include <stdint.h>
+#include "shell.h"
+
+// Parsing, formatting and timing helpers shared by the shell commands
+// in bin/
+
+// Entry in the shell's command table, NULL if there is none
+const Command* find_command(const char* name);
+
+// Decimal up to 'max'; 0 when malformed or out of range
+uint32_t parse_uint(const char* s, uint32_t max);
+
+// Next value of a xorshift32 generator; the state must not be 0
+uint32_t xorshift32(uint32_t* state);
+
+// Right-align a number in 'width' columns
+void print_padded(uint32_t value, int width);
+
+// Decimal digits in v
+uint32_t count_digits(uint64_t v);
+
+// Right-align a 64-bit number in 'width' columns
+void print_u64(uint64_t v, int width);
+
+// Left-align a name in 'width' columns
+void print_name(const char* name, int width);
+
+// Microseconds since a cpu_rdtsc() reading, never 0 so it can divide
+uint32_t elapsed_us(uint64_t start);
+
+#endif // CMDUTIL_H
@@ -13,8 +13,11 @@ typedef struct {
     const char *name;
     void (*func)(const char *);
     const char *description;
+    uint32_t flags;
 } Command;
 
+#define CMD_NO_REDIRECT (1u << 0)   // '>' in the arguments is an operand
+
 extern int last_exit_status;
 
 char kb_getchar(void);  // Reads one character from input
@@ -45,12 +48,35 @@ void grep_command(const char *args);
 void factor_command(const char *args);
 void rand_command(const char *args);
 void tty_command(const char *args);
+void ls_command(const char *args);
+void cat_command(const char *args);
+void stat_command(const char *args);
+void mount_command(const char *args);
+void lookupbench_command(const char *args);
+void diskbench_command(const char *args);
+void cachestat_command(const char *args);
+void iostat_command(const char *args);
+void fsbench_command(const char *args);
+void metabench_command(const char *args);
+void netbench_command(const char *args);
+void ifconfig_command(const char *args);
+void udpblast_command(const char *args);
+void ifstat_command(const char *args);
+void clocksource_command(const char *args);
+void timerlat_command(const char *args);
+void timebench_command(const char *args);
+void perfstat_command(const char *args);
+void profile_command(const char *args);
+void ksym_command(const char *args);
+void trace_command(const char *args);
+#ifdef CONFIG_CALLGRAPH
+void callgraph_command(const char *args);   // "make CALLGRAPH=1" only
+#endif
 int get_last_exit_status(void);
 
 // Shell functions
 int shell_init(void);
 void shell_run(void);
-void uptime_init(void);
 void print_shell_prompt(void);
 
 #endif // SHELL_H
@@ -45,6 +45,9 @@ static inline uint16_t vga_entry(unsigned char uc, uint8_t color) {
 // Tab width
 #define TAB_WIDTH 4
 
+// Receives every character written through vga_putchar while installed
+typedef void (*vga_output_hook_t)(char c, void* ctx);
+
 // Function declarations
 int vga_initialize(void);             // Initialize VGA
 void vga_clear(void);                 // Clear the screen
@@ -64,5 +67,6 @@ uint8_t vga_get_color(void);          // Get current color
 void vga_puthex(uint32_t num);
 void vga_putchar_at(char c, int x, int y);
 void vga_puts_at(const char *str, int x, int y);
+void vga_set_output_hook(vga_output_hook_t hook, void* ctx);
 
 #endif // VGA_H
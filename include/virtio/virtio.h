@@ -0,0 +1,151 @@
+#ifndef VIRTIO_H
+#define VIRTIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "../pci/pci.h"
+
+/**
+ * virtio over PCI
+ *
+ * Supports both the legacy (0.9.5, I/O BAR) and modern (1.0, capability
+ * described memory BARs) transports behind one virtio_device_t, and split
+ * virtqueues with optional indirect descriptors and EVENT_IDX notification
+ * suppression.
+ */
+
+#define VIRTIO_PCI_VENDOR          0x1AF4
+#define VIRTIO_PCI_LEGACY_BLK      0x1001
+#define VIRTIO_PCI_LEGACY_NET      0x1000
+#define VIRTIO_PCI_MODERN_BASE     0x1040   // + virtio device type
+
+#define VIRTIO_ID_NET              1
+#define VIRTIO_ID_BLOCK            2
+
+// Device status
+#define VIRTIO_STATUS_ACKNOWLEDGE  0x01
+#define VIRTIO_STATUS_DRIVER       0x02
+#define VIRTIO_STATUS_DRIVER_OK    0x04
+#define VIRTIO_STATUS_FEATURES_OK  0x08
+#define VIRTIO_STATUS_FAILED       0x80
+
+// Transport feature bits
+#define VIRTIO_F_RING_INDIRECT_DESC 28
+#define VIRTIO_F_RING_EVENT_IDX    29
+#define VIRTIO_F_VERSION_1         32
+
+#define VIRTIO_FEATURE(bit)        (1ull << (bit))
+
+// Descriptor flags
+#define VIRTQ_DESC_F_NEXT          1
+#define VIRTQ_DESC_F_WRITE         2     // Device writes (receive buffer)
+#define VIRTQ_DESC_F_INDIRECT      4
+
+#define VIRTQ_AVAIL_F_NO_INTERRUPT 1
+#define VIRTQ_USED_F_NO_NOTIFY     1
+
+#define VIRTQ_MAX_SIZE             1024
+#define VIRTQ_INDIRECT_MAX         64    // Entries per indirect table
+
+struct virtq_desc {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed));
+
+struct virtq_avail {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];                  // Followed by used_event
+} __attribute__((packed));
+
+struct virtq_used_elem {
+    uint32_t id;
+    uint32_t len;
+} __attribute__((packed));
+
+struct virtq_used {
+    uint16_t flags;
+    uint16_t idx;
+    struct virtq_used_elem ring[];    // Followed by avail_event
+} __attribute__((packed));
+
+typedef struct virtio_device virtio_device_t;
+
+typedef struct {
+    uint64_t kicks;                   // Doorbell writes actually issued
+    uint64_t kicks_suppressed;        // Skipped because the device was busy
+    uint64_t completions;
+} virtqueue_stats_t;
+
+typedef struct virtqueue {
+    virtio_device_t* vdev;
+    uint16_t index;
+    uint16_t size;
+    struct virtq_desc* desc;
+    struct virtq_avail* avail;
+    struct virtq_used* used;
+    uint16_t free_head;
+    uint16_t num_free;
+    uint16_t last_used_idx;
+    uint16_t kicked_avail_idx;        // avail->idx at the last notification
+    uint16_t notify_off;
+    bool event_idx;
+    bool indirect;
+    void** cookies;                   // Per head descriptor
+    struct virtq_desc* indirect_tables;  // size * VIRTQ_INDIRECT_MAX entries
+    uint32_t ring_pages;
+    virtqueue_stats_t stats;
+} virtqueue_t;
+
+// One buffer in a scatter-gather list handed to virtqueue_add
+typedef struct {
+    uint32_t addr;
+    uint32_t len;
+} virtq_buf_t;
+
+struct virtio_device {
+    pci_device_t* pci;
+    bool modern;
+    uint16_t io_base;                 // Legacy I/O BAR
+    uintptr_t common_cfg;             // Modern capability windows
+    uintptr_t notify_base;
+    uint32_t notify_multiplier;
+    uintptr_t isr;
+    uintptr_t device_cfg;
+    uint64_t features;                // Negotiated
+    uint8_t irq;
+};
+
+// Transport
+int virtio_pci_init(virtio_device_t* vdev, pci_device_t* pci);
+void virtio_reset(virtio_device_t* vdev);
+uint64_t virtio_negotiate(virtio_device_t* vdev, uint64_t wanted);
+int virtio_features_ok(virtio_device_t* vdev);
+void virtio_driver_ok(virtio_device_t* vdev);
+void virtio_fail(virtio_device_t* vdev);
+uint8_t virtio_read_isr(virtio_device_t* vdev);
+bool virtio_has_feature(const virtio_device_t* vdev, uint32_t bit);
+
+uint8_t virtio_config_read8(virtio_device_t* vdev, uint32_t offset);
+uint16_t virtio_config_read16(virtio_device_t* vdev, uint32_t offset);
+uint32_t virtio_config_read32(virtio_device_t* vdev, uint32_t offset);
+uint64_t virtio_config_read64(virtio_device_t* vdev, uint32_t offset);
+
+// Queue registers, shared between the transport and the ring code
+uint16_t virtio_queue_size(virtio_device_t* vdev, uint16_t index);
+void virtio_queue_activate(virtio_device_t* vdev, virtqueue_t* vq);
+
+// Virtqueues
+int virtqueue_setup(virtio_device_t* vdev, virtqueue_t* vq, uint16_t index, uint16_t max_size);
+int virtqueue_add(virtqueue_t* vq, const virtq_buf_t* bufs, uint16_t out, uint16_t in, void* cookie);
+bool virtqueue_kick_prepare(virtqueue_t* vq);
+void virtqueue_notify(virtqueue_t* vq);
+void virtqueue_kick(virtqueue_t* vq);
+void* virtqueue_get_buf(virtqueue_t* vq, uint32_t* len);
+bool virtqueue_enable_cb(virtqueue_t* vq);
+void virtqueue_disable_cb(virtqueue_t* vq);
+
+#endif // VIRTIO_H
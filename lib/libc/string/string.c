@@ -1,5 +1,6 @@
 // lib/string.c
 #include "../../../include/lib/string.h"
+#include "../../../include/kernel/arch/x86/alternative.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -61,18 +62,40 @@ char *strncat(char *restrict dest, const char *restrict src, size_t n) {
     return ret;
 }
 
+// memset and memcpy move four bytes at a time, then the tail. Where the
+// CPU has fast string operations (ERMS), a single rep movsb/stosb is
+// quicker still, and boot-time patching swaps it in.
+
 // Set n bytes of memory to a specific value
 void *memset(void *s, int c, size_t n) {
-    unsigned char *p = s;
-    while (n--) *p++ = (unsigned char)c;
+    void *d = s;
+    uint32_t v = (uint8_t)c * 0x01010101u;
+    __asm__ volatile(ALTERNATIVE("movl %%ecx, %%edx\n\t"
+                                 "shrl $2, %%ecx\n\t"
+                                 "rep stosl\n\t"
+                                 "movl %%edx, %%ecx\n\t"
+                                 "andl $3, %%ecx\n\t"
+                                 "rep stosb",
+                                 "rep stosb", X86_FEATURE_ERMS)
+                     : "+D"(d), "+c"(n)
+                     : "a"(v)
+                     : "edx", "memory");
     return s;
 }
 
 // Copy n bytes from one memory location to another
 void *memcpy(void *restrict dest, const void *restrict src, size_t n) {
-    unsigned char *d = dest;
-    const unsigned char *s = src;
-    while (n--) *d++ = *s++;
+    void *d = dest;
+    __asm__ volatile(ALTERNATIVE("movl %%ecx, %%edx\n\t"
+                                 "shrl $2, %%ecx\n\t"
+                                 "rep movsl\n\t"
+                                 "movl %%edx, %%ecx\n\t"
+                                 "andl $3, %%ecx\n\t"
+                                 "rep movsb",
+                                 "rep movsb", X86_FEATURE_ERMS)
+                     : "+D"(d), "+S"(src), "+c"(n)
+                     :
+                     : "edx", "memory");
     return dest;
 }
 
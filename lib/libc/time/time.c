@@ -0,0 +1,57 @@
+// lib/libc/time/time.c
+#include "../../../include/lib/time.h"
+#include "../../../include/lib/math64.h"
+#include "../../../include/lib/errno.h"
+#include "../../../include/kernel/time/vdso.h"
+#include "../../../include/kernel/syscall/syscall.h"
+
+// Only the time page and rdtsc here: no kernel calls on the fast path
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Monotonic and wall-clock offset from the page; false if the clock is
+// not one user code can read
+static bool vdso_read(uint64_t* mono, uint64_t* offset) {
+    const vdso_time_t* t = &vdso_time_page;
+    uint32_t seq;
+    uint64_t ns, off;
+
+    do {
+        while ((seq = t->seq) & 1)
+            ;
+        __asm__ volatile("" ::: "memory");
+        if (t->mode != VDSO_CLOCK_TSC) return false;
+        ns = t->mono_ns + mul_u64_u32_shr(rdtsc() - t->cycle_last, t->mult, t->shift);
+        off = t->wall_offset_ns;
+        __asm__ volatile("" ::: "memory");
+    } while (t->seq != seq);
+
+    *mono = ns;
+    *offset = off;
+    return true;
+}
+
+uint64_t clock_gettime_ns(int clock) {
+    uint64_t mono, offset;
+    if (clock != CLOCK_MONOTONIC && clock != CLOCK_REALTIME) return 0;
+    if (vdso_read(&mono, &offset)) return clock == CLOCK_REALTIME ? mono + offset : mono;
+
+    struct timespec ts;
+    if (sys_clock_gettime(clock, &ts) < 0) return 0;
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int clock_gettime(int clock, struct timespec *ts) {
+    uint64_t mono, offset;
+    if (clock != CLOCK_MONOTONIC && clock != CLOCK_REALTIME) return -EINVAL;
+    if (!vdso_read(&mono, &offset)) return sys_clock_gettime(clock, ts);
+
+    uint32_t rem;
+    ts->tv_sec = (int32_t)div_u64_rem(clock == CLOCK_REALTIME ? mono + offset : mono, 1000000000, &rem);
+    ts->tv_nsec = (int32_t)rem;
+    return 0;
+}
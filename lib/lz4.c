@@ -0,0 +1,164 @@
+/**
+ * LZ4 - Bunix OS
+ *
+ * A sequence is a token (literal length << 4 | match length - 4), extra
+ * literal-length bytes, the literals, a little-endian 16-bit offset and
+ * extra match-length bytes; a length nibble of 15 continues in bytes of
+ * 255 until a smaller one. The last sequence is literals only, and the
+ * format requires the final 5 bytes to be literals and the last match to
+ * start at least 12 bytes before the end.
+ */
+
+#include "../include/lib/lz4.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+
+#define LZ4_MIN_MATCH     4
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MF_LIMIT      12
+#define LZ4_HASH_LOG      11
+#define LZ4_SKIP_TRIGGER  6           // Step grows every 64 misses
+
+static uint16_t hash_table[1u << LZ4_HASH_LOG];
+
+static inline uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t lz4_hash(const uint8_t* p) {
+    return (read32(p) * 2654435761u) >> (32 - LZ4_HASH_LOG);
+}
+
+// Bytes a length of 'len' past a 15 nibble takes
+static inline size_t length_bytes(size_t len) {
+    return len >= 15 ? (len - 15) / 255 + 1 : 0;
+}
+
+static uint8_t* put_length(uint8_t* op, size_t len) {
+    for (len -= 15; len >= 255; len -= 255) *op++ = 255;
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+// Append literals [anchor, anchor + lits) and, if mlen, one match
+static uint8_t* put_sequence(uint8_t* op, uint8_t* oend, const uint8_t* anchor, size_t lits,
+                             uint32_t offset, size_t mlen) {
+    size_t mcode = mlen ? mlen - LZ4_MIN_MATCH : 0;
+    size_t need = 1 + length_bytes(lits) + lits + (mlen ? 2 + length_bytes(mcode) : 0);
+    if (need > (size_t)(oend - op)) return NULL;
+
+    uint8_t* token = op++;
+    *token = (uint8_t)((lits < 15 ? lits : 15) << 4);
+    if (lits >= 15) op = put_length(op, lits);
+    memcpy(op, anchor, lits);
+    op += lits;
+
+    if (mlen) {
+        *op++ = (uint8_t)offset;
+        *op++ = (uint8_t)(offset >> 8);
+        *token |= (uint8_t)(mcode < 15 ? mcode : 15);
+        if (mcode >= 15) op = put_length(op, mcode);
+    }
+    return op;
+}
+
+size_t lz4_compress(const uint8_t* src, size_t len, uint8_t* dst, size_t dst_cap) {
+    const uint8_t* ip = src;
+    const uint8_t* anchor = src;
+    const uint8_t* end = src + len;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + dst_cap;
+
+    if (len > LZ4_MAX_INPUT) return 0;
+
+    if (len >= LZ4_MF_LIMIT + 1) {
+        const uint8_t* mflimit = end - LZ4_MF_LIMIT;
+        const uint8_t* matchlimit = end - LZ4_LAST_LITERALS;
+        uint32_t misses = 1u << LZ4_SKIP_TRIGGER;
+
+        memset(hash_table, 0, sizeof(hash_table));
+        hash_table[lz4_hash(ip)] = 0;
+        ip++;
+
+        while (ip < mflimit) {
+            uint32_t h = lz4_hash(ip);
+            const uint8_t* ref = src + hash_table[h];
+            hash_table[h] = (uint16_t)(ip - src);
+
+            if (ref >= ip || read32(ref) != read32(ip)) {
+                ip += misses++ >> LZ4_SKIP_TRIGGER;
+                continue;
+            }
+            misses = 1u << LZ4_SKIP_TRIGGER;
+
+            // Grow the match backwards over pending literals, then forwards
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            size_t mlen = LZ4_MIN_MATCH;
+            while (ip + mlen < matchlimit && ip[mlen] == ref[mlen]) mlen++;
+
+            op = put_sequence(op, oend, anchor, ip - anchor, (uint32_t)(ip - ref), mlen);
+            if (!op) return 0;
+
+            ip += mlen;
+            anchor = ip;
+            if (ip < mflimit) hash_table[lz4_hash(ip - 2)] = (uint16_t)(ip - 2 - src);
+        }
+    }
+
+    op = put_sequence(op, oend, anchor, end - anchor, 0, 0);
+    return op ? (size_t)(op - dst) : 0;
+}
+
+int lz4_decompress(const uint8_t* src, size_t len, uint8_t* dst, size_t dst_cap) {
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + len;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + dst_cap;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        size_t lits = token >> 4;
+        if (lits == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -EINVAL;
+                b = *ip++;
+                lits += b;
+            } while (b == 255);
+        }
+        if (lits > (size_t)(iend - ip) || lits > (size_t)(oend - op)) return -EINVAL;
+        memcpy(op, ip, lits);
+        ip += lits;
+        op += lits;
+
+        if (ip == iend) break;         // Last sequence has no match
+
+        if (iend - ip < 2) return -EINVAL;
+        uint32_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) return -EINVAL;
+
+        size_t mlen = token & 15;
+        if (mlen == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -EINVAL;
+                b = *ip++;
+                mlen += b;
+            } while (b == 255);
+        }
+        mlen += LZ4_MIN_MATCH;
+        if (mlen > (size_t)(oend - op)) return -EINVAL;
+
+        // Byte at a time: the match may overlap what it is producing
+        const uint8_t* ref = op - offset;
+        while (mlen--) *op++ = *ref++;
+    }
+    return op - dst;
+}
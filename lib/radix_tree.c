@@ -0,0 +1,203 @@
+/**
+ * Radix tree - Bunix OS
+ *
+ * Sparse index -> pointer map used for per-file page lookup.
+ */
+
+#include "../include/lib/radix_tree.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+#include "../include/mm/kmalloc.h"
+
+#define RADIX_TREE_MAX_HEIGHT ((32 + RADIX_TREE_MAP_SHIFT - 1) / RADIX_TREE_MAP_SHIFT)
+
+// Largest index a tree of the given height can hold
+static uint32_t height_to_maxindex(uint32_t height) {
+    uint32_t bits = height * RADIX_TREE_MAP_SHIFT;
+    if (bits >= 32) return 0xFFFFFFFFu;
+    return (1u << bits) - 1;
+}
+
+static struct radix_tree_node* node_alloc(struct radix_tree_root* root) {
+    struct radix_tree_node* node = kzalloc(sizeof(struct radix_tree_node));
+    if (node) root->nodes++;
+    return node;
+}
+
+static void node_free(struct radix_tree_root* root, struct radix_tree_node* node) {
+    kfree(node);
+    root->nodes--;
+}
+
+void radix_tree_init(struct radix_tree_root* root) {
+    root->height = 0;
+    root->rnode = NULL;
+    root->nodes = 0;
+}
+
+// Add levels on top until index fits
+static int radix_tree_extend(struct radix_tree_root* root, uint32_t index) {
+    uint32_t height = root->height ? root->height : 1;
+    while (index > height_to_maxindex(height)) height++;
+
+    if (!root->rnode) {
+        root->height = height;
+        return 0;
+    }
+
+    while (root->height < height) {
+        struct radix_tree_node* node = node_alloc(root);
+        if (!node) return -ENOMEM;
+        node->slots[0] = root->rnode;
+        node->count = 1;
+        root->rnode = node;
+        root->height++;
+    }
+    return 0;
+}
+
+int radix_tree_insert(struct radix_tree_root* root, uint32_t index, void* item) {
+    if (!item) return -EINVAL;
+
+    int err = radix_tree_extend(root, index);
+    if (err) return err;
+
+    if (!root->rnode) {
+        root->rnode = node_alloc(root);
+        if (!root->rnode) return -ENOMEM;
+    }
+
+    struct radix_tree_node* node = root->rnode;
+    uint32_t shift = (root->height - 1) * RADIX_TREE_MAP_SHIFT;
+
+    while (shift > 0) {
+        uint32_t offset = (index >> shift) & RADIX_TREE_MAP_MASK;
+        if (!node->slots[offset]) {
+            struct radix_tree_node* child = node_alloc(root);
+            if (!child) return -ENOMEM;
+            node->slots[offset] = child;
+            node->count++;
+        }
+        node = node->slots[offset];
+        shift -= RADIX_TREE_MAP_SHIFT;
+    }
+
+    uint32_t offset = index & RADIX_TREE_MAP_MASK;
+    if (node->slots[offset]) return -EEXIST;
+    node->slots[offset] = item;
+    node->count++;
+    return 0;
+}
+
+void* radix_tree_lookup(const struct radix_tree_root* root, uint32_t index) {
+    if (!root->rnode || index > height_to_maxindex(root->height)) return NULL;
+
+    struct radix_tree_node* node = root->rnode;
+    uint32_t shift = (root->height - 1) * RADIX_TREE_MAP_SHIFT;
+
+    while (shift > 0) {
+        node = node->slots[(index >> shift) & RADIX_TREE_MAP_MASK];
+        if (!node) return NULL;
+        shift -= RADIX_TREE_MAP_SHIFT;
+    }
+    return node->slots[index & RADIX_TREE_MAP_MASK];
+}
+
+void* radix_tree_replace(struct radix_tree_root* root, uint32_t index, void* item) {
+    if (!item || !root->rnode || index > height_to_maxindex(root->height)) return NULL;
+
+    struct radix_tree_node* node = root->rnode;
+    uint32_t shift = (root->height - 1) * RADIX_TREE_MAP_SHIFT;
+
+    while (shift > 0) {
+        node = node->slots[(index >> shift) & RADIX_TREE_MAP_MASK];
+        if (!node) return NULL;
+        shift -= RADIX_TREE_MAP_SHIFT;
+    }
+
+    void** slot = &node->slots[index & RADIX_TREE_MAP_MASK];
+    void* old = *slot;
+    if (old) *slot = item;
+    return old;
+}
+
+// Drop root levels that only hold a single child in slot 0
+static void radix_tree_shrink(struct radix_tree_root* root) {
+    while (root->height > 1) {
+        struct radix_tree_node* node = root->rnode;
+        if (node->count != 1 || !node->slots[0]) break;
+        root->rnode = node->slots[0];
+        root->height--;
+        node_free(root, node);
+    }
+}
+
+void* radix_tree_delete(struct radix_tree_root* root, uint32_t index) {
+    struct radix_tree_node* path[RADIX_TREE_MAX_HEIGHT];
+    uint32_t offsets[RADIX_TREE_MAX_HEIGHT];
+
+    if (!root->rnode || index > height_to_maxindex(root->height)) return NULL;
+
+    struct radix_tree_node* node = root->rnode;
+    uint32_t shift = (root->height - 1) * RADIX_TREE_MAP_SHIFT;
+    int level = 0;
+
+    for (;;) {
+        uint32_t offset = (index >> shift) & RADIX_TREE_MAP_MASK;
+        path[level] = node;
+        offsets[level] = offset;
+        if (shift == 0) break;
+        node = node->slots[offset];
+        if (!node) return NULL;
+        shift -= RADIX_TREE_MAP_SHIFT;
+        level++;
+    }
+
+    void* item = node->slots[offsets[level]];
+    if (!item) return NULL;
+
+    // Clear the slot and free every node that became empty on the way up
+    for (; level >= 0; level--) {
+        node = path[level];
+        node->slots[offsets[level]] = NULL;
+        if (--node->count > 0) break;
+        if (level == 0) {
+            node_free(root, node);
+            root->rnode = NULL;
+            root->height = 0;
+            return item;
+        }
+        node_free(root, node);
+    }
+
+    radix_tree_shrink(root);
+    return item;
+}
+
+static void* next_in_node(const struct radix_tree_node* node, uint32_t shift,
+                          uint32_t base, uint32_t start, uint32_t* index) {
+    uint32_t first = 0;
+    if (start > base) first = ((start - base) >> shift) & RADIX_TREE_MAP_MASK;
+
+    for (uint32_t i = first; i < RADIX_TREE_MAP_SIZE; i++) {
+        void* slot = node->slots[i];
+        if (!slot) continue;
+
+        uint32_t slot_base = base + (i << shift);
+        if (shift == 0) {
+            *index = slot_base;
+            return slot;
+        }
+
+        // Only the first child visited can start part-way through
+        void* item = next_in_node(slot, shift - RADIX_TREE_MAP_SHIFT, slot_base,
+                                  start > slot_base ? start : slot_base, index);
+        if (item) return item;
+    }
+    return NULL;
+}
+
+void* radix_tree_next(const struct radix_tree_root* root, uint32_t start, uint32_t* index) {
+    if (!root->rnode || start > height_to_maxindex(root->height)) return NULL;
+    return next_in_node(root->rnode, (root->height - 1) * RADIX_TREE_MAP_SHIFT, 0, start, index);
+}
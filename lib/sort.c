@@ -0,0 +1,36 @@
+/**
+ * Sorting - Bunix OS
+ *
+ * Heapsort of 32-bit samples for the latency benchmarks.
+ */
+
+#include "../include/lib/sort.h"
+#include "../include/lib/math64.h"
+
+static void sift_down(uint32_t* a, uint32_t root, uint32_t n) {
+    for (;;) {
+        uint32_t child = root * 2 + 1;
+        if (child >= n) return;
+        if (child + 1 < n && a[child + 1] > a[child]) child++;
+        if (a[root] >= a[child]) return;
+        uint32_t t = a[root];
+        a[root] = a[child];
+        a[child] = t;
+        root = child;
+    }
+}
+
+void sort_u32(uint32_t* a, uint32_t n) {
+    for (uint32_t i = n / 2; i-- > 0; ) sift_down(a, i, n);
+    for (uint32_t end = n; end-- > 1; ) {
+        uint32_t t = a[0];
+        a[0] = a[end];
+        a[end] = t;
+        sift_down(a, 0, end);
+    }
+}
+
+uint32_t sort_percentile_u32(const uint32_t* sorted, uint32_t n, uint32_t p) {
+    uint32_t i = (uint32_t)div_u64((uint64_t)n * p, 1000);
+    return sorted[i < n ? i : n - 1];
+}
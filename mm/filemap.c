@@ -0,0 +1,352 @@
+/**
+ * Page cache - Bunix OS
+ *
+ * Cached file pages hang off their inode in a radix tree keyed by page
+ * number, and every cached page also sits on one global ring that a CLOCK
+ * hand sweeps when the cache is full or free memory runs low. A page
+ * somebody has borrowed is never reclaimed.
+ *
+ * Misses are filled in runs: the missing pages from the one asked for up
+ * to the end of the read, plus read-ahead, go to the filesystem as one
+ * read into physically contiguous pages, so a sequential reader costs the
+ * filesystem one large transfer per FILEMAP_READAHEAD_PAGES rather than
+ * one per page. When memory is too tight to cache, reads go straight to
+ * the filesystem.
+ */
+
+#include "../include/mm/filemap.h"
+#include "../include/mm/vmm.h"
+#include "../include/mm/kmalloc.h"
+#include "../include/mm/reclaim.h"
+#include "../include/lib/radix_tree.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+
+#define FILEMAP_LIMIT_DIVISOR  4        // At most a quarter of memory
+#define FILEMAP_RESERVE_PAGES  1024     // Free pages left for everyone else
+
+struct filemap_page {
+    vfs_inode_t* inode;
+    uint32_t index;
+    uint8_t* data;
+    uint32_t refcount;                  // Borrowers
+    bool referenced;                    // Used since the hand last passed
+    bool orphan;                        // Inode evicted while borrowed
+    struct filemap_page* prev;          // CLOCK ring
+    struct filemap_page* next;
+};
+
+static struct filemap_page* clock_hand = NULL;
+static filemap_stats_t stats;
+static bool filling = false;            // Inserting; the radix trees are mid-update
+static uint32_t orphans = 0;            // Borrowed pages whose inode is gone
+
+static uint32_t filemap_shrink(uint32_t target);
+
+static reclaim_source_t filemap_source = {
+    .name = "page cache",
+    .shrink = filemap_shrink,
+};
+
+void filemap_init(void) {
+    clock_hand = NULL;
+    orphans = 0;
+    memset(&stats, 0, sizeof(stats));
+    stats.limit = vmm_get_total_pages() / FILEMAP_LIMIT_DIVISOR;
+    reclaim_register(&filemap_source);
+}
+
+static void ring_add(struct filemap_page* page) {
+    if (!clock_hand) {
+        page->prev = page->next = page;
+        clock_hand = page;
+        return;
+    }
+    // Just behind the hand, so it is the last the hand gets to
+    page->next = clock_hand;
+    page->prev = clock_hand->prev;
+    clock_hand->prev->next = page;
+    clock_hand->prev = page;
+}
+
+static void ring_remove(struct filemap_page* page) {
+    if (page->next == page) {
+        clock_hand = NULL;
+    } else {
+        page->prev->next = page->next;
+        page->next->prev = page->prev;
+        if (clock_hand == page) clock_hand = page->next;
+    }
+    page->prev = page->next = NULL;
+}
+
+// Take a page out of its inode's tree; it stays on the ring
+static void page_detach(struct filemap_page* page) {
+    radix_tree_delete(&page->inode->pages, page->index);
+    page->inode->nrpages--;
+}
+
+static void page_free(struct filemap_page* page) {
+    if (page->orphan) orphans--;
+    else page_detach(page);
+    ring_remove(page);
+    vmm_free_page((uint32_t*)page->data);
+    kfree(page);
+    stats.pages--;
+}
+
+// Free up to 'target' pages the hand finds neither borrowed nor recently used
+static uint32_t filemap_clock(uint32_t target) {
+    uint32_t budget = 2 * stats.pages;
+    uint32_t freed = 0;
+
+    while (clock_hand && freed < target && budget--) {
+        struct filemap_page* page = clock_hand;
+        clock_hand = page->next;
+        if (page->refcount) continue;
+        if (page->referenced) {
+            page->referenced = false;
+            continue;
+        }
+        page_free(page);
+        stats.evictions++;
+        freed++;
+    }
+    return freed;
+}
+
+static uint32_t filemap_shrink(uint32_t target) {
+    return filling ? 0 : filemap_clock(target);
+}
+
+static inline bool filemap_fits(uint32_t count) {
+    return stats.pages + count <= stats.limit && vmm_get_free_pages() >= count + FILEMAP_RESERVE_PAGES;
+}
+
+// Reclaim until 'count' more pages fit; false if borrowed pages are in the way
+static bool filemap_make_room(uint32_t count) {
+    while (!filemap_fits(count)) {
+        if (!filemap_clock(1)) return false;
+    }
+    return true;
+}
+
+static inline uint32_t file_pages(const vfs_inode_t* inode) {
+    return (uint32_t)(((uint64_t)inode->size + PAGE_SIZE - 1) / PAGE_SIZE);
+}
+
+/*
+ * Read pages index .. index + count - 1 in one go and cache them. Fewer
+ * may be cached if contiguous memory is short; at least page 'index' is
+ * on success.
+ */
+static int filemap_fill(vfs_inode_t* inode, uint32_t index, uint32_t count) {
+    if (!filemap_make_room(count)) {
+        count = 1;
+        if (!filemap_make_room(1)) return -ENOMEM;
+    }
+
+    uint8_t* data = (uint8_t*)vmm_alloc_pages(count);
+    if (!data && count > 1) {
+        count = 1;
+        data = (uint8_t*)vmm_alloc_pages(1);
+    }
+    if (!data) return -ENOMEM;
+
+    size_t bytes = count * PAGE_SIZE;
+    int n = inode->f_op->readpages(inode, data, bytes, index * PAGE_SIZE);
+    if (n < 0) {
+        vmm_free_pages((uint32_t*)data, count);
+        return n;
+    }
+    memset(data + n, 0, bytes - n);
+
+    filling = true;
+    for (uint32_t i = 0; i < count; i++) {
+        struct filemap_page* page = kzalloc(sizeof(struct filemap_page));
+        if (!page || radix_tree_insert(&inode->pages, index + i, page) != 0) {
+            kfree(page);
+            vmm_free_pages((uint32_t*)(data + i * PAGE_SIZE), count - i);
+            filling = false;
+            return i ? 0 : -ENOMEM;
+        }
+        page->inode = inode;
+        page->index = index + i;
+        page->data = data + i * PAGE_SIZE;
+        ring_add(page);
+        inode->nrpages++;
+        stats.pages++;
+    }
+    filling = false;
+    return 0;
+}
+
+// Cached page 'index', filling it and what follows if needed. 'want' is
+// how many pages from here on the caller is about to read.
+static int filemap_find(vfs_inode_t* inode, uint32_t index, uint32_t want, struct filemap_page** out) {
+    stats.lookups++;
+    struct filemap_page* page = radix_tree_lookup(&inode->pages, index);
+    if (page) {
+        stats.hits++;
+        page->referenced = true;
+        *out = page;
+        return 0;
+    }
+
+    // The missing run: what the caller wants plus read-ahead, up to the
+    // next cached page or the end of the file
+    uint32_t last = file_pages(inode);
+    uint32_t count = want + FILEMAP_READAHEAD_PAGES / 2;
+    if (count > FILEMAP_READAHEAD_PAGES) count = FILEMAP_READAHEAD_PAGES;
+    if (count > last - index) count = last - index;
+    if (count == 0) count = 1;
+
+    uint32_t next;
+    if (radix_tree_next(&inode->pages, index, &next) && next - index < count) count = next - index;
+    if (count > want) stats.readahead += count - want;
+
+    int err = filemap_fill(inode, index, count);
+    if (err) return err;
+
+    page = radix_tree_lookup(&inode->pages, index);
+    if (!page) return -ENOMEM;
+    page->referenced = true;
+    *out = page;
+    return 0;
+}
+
+int filemap_read(vfs_inode_t* inode, void* buf, size_t count, vfs_off_t offset) {
+    uint8_t* out = buf;
+    size_t done = 0;
+
+    if (offset >= inode->size) return 0;
+    if (count > inode->size - offset) count = inode->size - offset;
+
+    while (done < count) {
+        vfs_off_t pos = offset + done;
+        uint32_t index = pos / PAGE_SIZE;
+        uint32_t in_page = pos % PAGE_SIZE;
+        size_t chunk = PAGE_SIZE - in_page;
+        if (chunk > count - done) chunk = count - done;
+
+        uint32_t want = (in_page + (count - done) + PAGE_SIZE - 1) / PAGE_SIZE;
+        struct filemap_page* page;
+        int err = filemap_find(inode, index, want, &page);
+        if (err == -ENOMEM) {
+            // No room to cache: read the rest straight from the filesystem
+            int n = inode->f_op->readpages(inode, out + done, count - done, pos);
+            if (n < 0) return done ? (int)done : n;
+            return done + n;
+        }
+        if (err) return done ? (int)done : err;
+
+        memcpy(out + done, page->data + in_page, chunk);
+        done += chunk;
+    }
+    return done;
+}
+
+void filemap_write(vfs_inode_t* inode, const void* buf, size_t count, vfs_off_t offset) {
+    const uint8_t* in = buf;
+    size_t done = 0;
+
+    if (!inode->nrpages) return;
+    while (done < count) {
+        vfs_off_t pos = offset + done;
+        uint32_t in_page = pos % PAGE_SIZE;
+        size_t chunk = PAGE_SIZE - in_page;
+        if (chunk > count - done) chunk = count - done;
+
+        struct filemap_page* page = radix_tree_lookup(&inode->pages, pos / PAGE_SIZE);
+        if (page) memcpy(page->data + in_page, in + done, chunk);
+        done += chunk;
+    }
+}
+
+void filemap_truncate(vfs_inode_t* inode, vfs_off_t size) {
+    if (!inode->nrpages) return;
+
+    // Past the new end the file reads as zeros, whether it shrank or grew
+    struct filemap_page* page = radix_tree_lookup(&inode->pages, size / PAGE_SIZE);
+    if (page && size % PAGE_SIZE) {
+        memset(page->data + size % PAGE_SIZE, 0, PAGE_SIZE - size % PAGE_SIZE);
+    }
+
+    uint32_t first = (uint32_t)(((uint64_t)size + PAGE_SIZE - 1) / PAGE_SIZE);
+    uint32_t index;
+    while ((page = radix_tree_next(&inode->pages, first, &index)) != NULL) {
+        if (page->refcount) {
+            // Borrowed: leave it, zeroed, to its borrower
+            memset(page->data, 0, PAGE_SIZE);
+            if (index == 0xFFFFFFFF) break;
+            first = index + 1;
+            continue;
+        }
+        page_free(page);
+    }
+}
+
+// A borrowed page outlives its inode as an orphan: it leaves the tree but
+// keeps its memory until the borrower puts it, and the CLOCK hand frees
+// it after that
+void filemap_evict(vfs_inode_t* inode) {
+    struct filemap_page* page;
+    uint32_t index;
+
+    while (inode->nrpages && (page = radix_tree_next(&inode->pages, 0, &index)) != NULL) {
+        if (page->refcount) {
+            page_detach(page);
+            page->orphan = true;
+            page->referenced = false;
+            orphans++;
+            continue;
+        }
+        page_free(page);
+    }
+}
+
+int filemap_get_page(vfs_inode_t* inode, uint32_t index, const uint8_t** data) {
+    if (inode->type != VFS_TYPE_FILE || !inode->f_op || !inode->f_op->readpages) return -EINVAL;
+    if (index >= file_pages(inode)) return -EINVAL;
+
+    struct filemap_page* page;
+    int err = filemap_find(inode, index, 1, &page);
+    if (err) return err;
+
+    page->refcount++;
+    *data = page->data;
+    return 0;
+}
+
+// Orphans are matched by the inode pointer they were borrowed through,
+// which may be freed by now and is never dereferenced
+static struct filemap_page* find_orphan(const vfs_inode_t* inode, uint32_t index) {
+    struct filemap_page* page = clock_hand;
+    if (!orphans || !page) return NULL;
+    do {
+        if (page->orphan && page->inode == inode && page->index == index && page->refcount) {
+            return page;
+        }
+        page = page->next;
+    } while (page != clock_hand);
+    return NULL;
+}
+
+void filemap_put_page(vfs_inode_t* inode, uint32_t index) {
+    struct filemap_page* page = find_orphan(inode, index);
+    if (!page) page = radix_tree_lookup(&inode->pages, index);
+    if (page && page->refcount) page->refcount--;
+}
+
+void filemap_get_stats(filemap_stats_t* out) {
+    *out = stats;
+}
+
+void filemap_reset_stats(void) {
+    uint32_t pages = stats.pages;
+    uint32_t limit = stats.limit;
+
+    memset(&stats, 0, sizeof(stats));
+    stats.pages = pages;
+    stats.limit = limit;
+}
@@ -0,0 +1,225 @@
+#include "../include/mm/kmalloc.h"
+#include "../include/mm/vmm.h"
+#include "../include/lib/string.h"
+#include "../include/kernel/panic/panic.h"
+
+/*
+ * Every heap page is described by a kheap_page descriptor kept out of
+ * line in an array indexed by page frame number, so the page itself is
+ * all payload. Pages serving a size class carve the page into equal,
+ * naturally aligned slots threaded on a free list; large allocations
+ * take a contiguous run described by its first page's descriptor.
+ * kfree() finds the descriptor from the pointer's page frame, so no
+ * per-object header is needed.
+ */
+
+#define KHEAP_MIN_SHIFT   4           // 16 bytes
+#define KHEAP_MAX_SHIFT   11          // 2048 bytes
+#define KHEAP_NUM_CLASSES (KHEAP_MAX_SHIFT - KHEAP_MIN_SHIFT + 1)
+
+struct kheap_slot {
+    struct kheap_slot* next;
+};
+
+struct kheap_page {
+    uint8_t type;             // KHEAP_NONE, KHEAP_SMALL or KHEAP_LARGE
+    uint8_t size_class;       // Index into classes[], small pages only
+    uint16_t in_use;          // Allocated slots on this page
+    uint32_t run_pages;       // Large runs only
+    struct kheap_page* next;  // Next page of the same class with free slots
+    struct kheap_slot* free;  // Free slots on this page
+};
+
+#define KHEAP_NONE  0         // Not a heap page
+#define KHEAP_SMALL 1
+#define KHEAP_LARGE 2
+
+struct kheap_class {
+    size_t slot_size;
+    struct kheap_page* partial;  // Pages with at least one free slot
+};
+
+static struct kheap_class classes[KHEAP_NUM_CLASSES];
+static size_t heap_used_bytes = 0;
+static size_t heap_pages = 0;
+static struct kheap_page* page_descs = NULL;  // One per physical page
+
+static inline struct kheap_page* page_desc(void* addr) {
+    return &page_descs[(uint32_t)addr / PAGE_SIZE];
+}
+
+static inline uint8_t* desc_page(struct kheap_page* desc) {
+    return (uint8_t*)((uint32_t)(desc - page_descs) * PAGE_SIZE);
+}
+
+void kmalloc_init(void) {
+    size_t desc_bytes = vmm_get_total_pages() * sizeof(struct kheap_page);
+    page_descs = (struct kheap_page*)vmm_alloc_pages((desc_bytes + PAGE_SIZE - 1) / PAGE_SIZE);
+    if (!page_descs) panic("kmalloc: no memory for page descriptors");
+    memset(page_descs, 0, desc_bytes);
+
+    for (int i = 0; i < KHEAP_NUM_CLASSES; i++) {
+        classes[i].slot_size = (size_t)1 << (KHEAP_MIN_SHIFT + i);
+        classes[i].partial = NULL;
+    }
+    heap_used_bytes = 0;
+    heap_pages = 0;
+}
+
+static int size_to_class(size_t size) {
+    for (int i = 0; i < KHEAP_NUM_CLASSES; i++) {
+        if (size <= classes[i].slot_size) return i;
+    }
+    return -1;
+}
+
+static struct kheap_page* kheap_grow(int class_idx) {
+    uint8_t* base = (uint8_t*)vmm_alloc_page();
+    if (!base) return NULL;
+
+    struct kheap_page* page = page_desc(base);
+    size_t slot_size = classes[class_idx].slot_size;
+
+    page->type = KHEAP_SMALL;
+    page->size_class = class_idx;
+    page->in_use = 0;
+    page->run_pages = 1;
+    page->free = NULL;
+
+    // Thread the slots in address order
+    struct kheap_slot** tail = &page->free;
+    for (size_t off = 0; off + slot_size <= PAGE_SIZE; off += slot_size) {
+        struct kheap_slot* slot = (struct kheap_slot*)(base + off);
+        *tail = slot;
+        tail = &slot->next;
+    }
+    *tail = NULL;
+
+    page->next = classes[class_idx].partial;
+    classes[class_idx].partial = page;
+    heap_pages++;
+    return page;
+}
+
+void* kmalloc(size_t size) {
+    if (size == 0) return NULL;
+
+    int class_idx = size_to_class(size);
+    if (class_idx < 0) {
+        size_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+        uint8_t* base = (uint8_t*)vmm_alloc_pages(pages);
+        if (!base) return NULL;
+
+        struct kheap_page* run = page_desc(base);
+        run->type = KHEAP_LARGE;
+        run->in_use = 1;
+        run->run_pages = pages;
+        run->next = NULL;
+        run->free = NULL;
+        heap_pages += pages;
+        heap_used_bytes += pages * PAGE_SIZE;
+        return base;
+    }
+
+    struct kheap_class* cls = &classes[class_idx];
+    struct kheap_page* page = cls->partial;
+    if (!page) {
+        page = kheap_grow(class_idx);
+        if (!page) return NULL;
+    }
+
+    struct kheap_slot* slot = page->free;
+    page->free = slot->next;
+    page->in_use++;
+    if (!page->free) {
+        cls->partial = page->next;  // Page is full, drop it from the list
+        page->next = NULL;
+    }
+
+    heap_used_bytes += cls->slot_size;
+    return slot;
+}
+
+void* kzalloc(size_t size) {
+    void* ptr = kmalloc(size);
+    if (ptr) memset(ptr, 0, size);
+    return ptr;
+}
+
+static struct kheap_page* ptr_to_page(void* ptr) {
+    if ((uint32_t)ptr / PAGE_SIZE >= vmm_get_total_pages() || page_desc(ptr)->type == KHEAP_NONE) {
+        panic("kfree: pointer not owned by the kernel heap");
+    }
+    return page_desc(ptr);
+}
+
+static size_t usable_size(struct kheap_page* page) {
+    if (page->type == KHEAP_LARGE) {
+        return page->run_pages * PAGE_SIZE;
+    }
+    return classes[page->size_class].slot_size;
+}
+
+void kfree(void* ptr) {
+    if (!ptr) return;
+
+    struct kheap_page* page = ptr_to_page(ptr);
+
+    if (page->type == KHEAP_LARGE) {
+        size_t pages = page->run_pages;
+        page->type = KHEAP_NONE;
+        heap_pages -= pages;
+        heap_used_bytes -= pages * PAGE_SIZE;
+        vmm_free_pages((uint32_t*)ptr, pages);
+        return;
+    }
+
+    struct kheap_class* cls = &classes[page->size_class];
+    struct kheap_slot* slot = (struct kheap_slot*)ptr;
+    bool was_full = (page->free == NULL);
+
+    slot->next = page->free;
+    page->free = slot;
+    page->in_use--;
+    heap_used_bytes -= cls->slot_size;
+
+    if (was_full) {
+        page->next = cls->partial;
+        cls->partial = page;
+    }
+
+    // Return completely empty pages, but keep one around per class
+    if (page->in_use == 0 && !(cls->partial == page && page->next == NULL)) {
+        struct kheap_page** link = &cls->partial;
+        while (*link && *link != page) link = &(*link)->next;
+        if (*link) *link = page->next;
+        page->type = KHEAP_NONE;
+        heap_pages--;
+        vmm_free_page((uint32_t*)desc_page(page));
+    }
+}
+
+void* krealloc(void* ptr, size_t size) {
+    if (!ptr) return kmalloc(size);
+    if (size == 0) {
+        kfree(ptr);
+        return NULL;
+    }
+
+    size_t old_size = usable_size(ptr_to_page(ptr));
+    if (size <= old_size) return ptr;
+
+    void* new_ptr = kmalloc(size);
+    if (!new_ptr) return NULL;
+    memcpy(new_ptr, ptr, old_size);
+    kfree(ptr);
+    return new_ptr;
+}
+
+size_t kmalloc_get_used_bytes(void) {
+    return heap_used_bytes;
+}
+
+size_t kmalloc_get_heap_pages(void) {
+    return heap_pages;
+}
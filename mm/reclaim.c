@@ -0,0 +1,100 @@
+/**
+ * Page reclaim - Bunix OS
+ *
+ * There are no kernel threads, so the background reclaimer is idle work:
+ * once woken it frees RECLAIM_BATCH pages per idle pass until the high
+ * watermark is reached. The gap between the watermarks keeps it from
+ * waking on every other allocation.
+ */
+
+#include "../include/mm/reclaim.h"
+#include "../include/mm/vmm.h"
+#include "../include/kernel/sched/idle.h"
+#include "../include/kernel/arch/x86/cpu.h"
+#include "../include/lib/string.h"
+
+#define RECLAIM_MIN_LOW 128             // Pages
+
+static reclaim_source_t* sources = NULL;
+static reclaim_stats_t stats;
+static bool woken = false;
+static bool reclaiming = false;         // Reclaim allocating must not recurse
+
+void reclaim_register(reclaim_source_t* source) {
+    // Keep registration order: earlier sources are asked first
+    reclaim_source_t** link = &sources;
+    while (*link) link = &(*link)->next;
+    source->next = NULL;
+    *link = source;
+}
+
+const reclaim_source_t* reclaim_sources(void) {
+    return sources;
+}
+
+static uint32_t reclaim_run(uint32_t target) {
+    uint32_t freed = 0;
+
+    if (reclaiming) return 0;
+    reclaiming = true;
+
+    uint64_t start = cpu_rdtsc();
+    for (reclaim_source_t* src = sources; src && freed < target; src = src->next) {
+        uint32_t n = src->shrink(target - freed);
+        src->reclaimed += n;
+        freed += n;
+    }
+    stats.busy_ns += cpu_tsc_to_ns(cpu_rdtsc() - start);
+    stats.reclaimed += freed;
+
+    reclaiming = false;
+    return freed;
+}
+
+uint32_t reclaim_pages(uint32_t target) {
+    stats.direct++;
+    return reclaim_run(target);
+}
+
+bool reclaim_in_progress(void) {
+    return reclaiming;
+}
+
+void reclaim_wake(void) {
+    if (woken) return;
+    woken = true;
+    stats.wakeups++;
+}
+
+static void reclaim_idle(void) {
+    if (!woken) return;
+
+    size_t free = vmm_get_free_pages();
+    if (free >= stats.high) {
+        woken = false;
+        return;
+    }
+
+    uint32_t want = stats.high - free;
+    if (want > RECLAIM_BATCH) want = RECLAIM_BATCH;
+
+    // Nothing left to give back: sleep until the next wakeup
+    if (reclaim_run(want) == 0) woken = false;
+}
+
+void reclaim_init(void) {
+    size_t total = vmm_get_total_pages();
+
+    memset(&stats, 0, sizeof(stats));
+    stats.low = total / 64;
+    if (stats.low < RECLAIM_MIN_LOW) stats.low = RECLAIM_MIN_LOW;
+    stats.high = stats.low * 2;
+
+    vmm_set_low_watermark(stats.low);
+    vmm_set_reserve(RECLAIM_RESERVE);
+    idle_register(reclaim_idle);
+}
+
+void reclaim_get_stats(reclaim_stats_t* out) {
+    *out = stats;
+}
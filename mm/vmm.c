@@ -1,10 +1,18 @@
 #include "../include/mm/vmm.h"
+#include "../include/mm/reclaim.h"
 #include "../include/video/vga.h"
 #include "../include/kernel/panic/panic.h"
+#include "../include/kernel/perf/trace.h"
 
 static uint8_t* page_bitmap = NULL;
 static size_t total_pages = 0;
 static size_t page_bitmap_size = 0;
+static size_t used_pages = 0;
+static size_t next_free_hint = 0;   // Where the next single-page search starts
+static size_t low_watermark = 0;    // 0 until reclaim is set up
+static size_t reserve_pages = 0;    // Held back for reclaim's own allocations
+
+#define VMM_START_PAGE 256          // Skip the first 1MB
 
 void vmm_init(uint32_t* page_bitmap_start, uint64_t total_memory_bytes) {
     // Calculate total pages
@@ -21,32 +29,69 @@ void vmm_init(uint32_t* page_bitmap_start, uint64_t total_memory_bytes) {
         page_bitmap[i] = 0;
     }
     
-    // Mark first 1MB as used (256 pages)
-    for (size_t i = 0; i < 256; i++) {
+    // Mark first 1MB, the kernel image and the bitmap itself as used
+    uint32_t reserved_end = (uint32_t)page_bitmap + page_bitmap_size;
+    size_t reserved_pages = (reserved_end + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (reserved_pages < 256) reserved_pages = 256;
+    for (size_t i = 0; i < reserved_pages && i < total_pages; i++) {
         size_t byte_idx = i / 8;
         size_t bit_idx = i % 8;
         page_bitmap[byte_idx] |= (1 << bit_idx);
     }
+    used_pages = reserved_pages < total_pages ? reserved_pages : total_pages;
+    next_free_hint = VMM_START_PAGE;
 }
 
-uint32_t* vmm_alloc_page(void) {
-    // Start from page 256 (skip first 1MB)
-    const size_t START_PAGE = 256;
-    
-    for (size_t i = START_PAGE; i < total_pages; i++) {
+static uint32_t* alloc_one(void) {
+    // Next-fit: resume where the last allocation left off and wrap once,
+    // so tight alloc/free loops don't rescan the whole low bitmap
+    for (size_t n = VMM_START_PAGE; n < total_pages; n++) {
+        size_t i = next_free_hint;
+        if (++next_free_hint >= total_pages) next_free_hint = VMM_START_PAGE;
+
         size_t byte_idx = i / 8;
         size_t bit_idx = i % 8;
         
         if (!(page_bitmap[byte_idx] & (1 << bit_idx))) {
             page_bitmap[byte_idx] |= (1 << bit_idx);
+            used_pages++;
             return (uint32_t*)(i * PAGE_SIZE);
         }
     }
-    
-    panic("Out of memory: No free pages available");
     return NULL;
 }
 
+// Taking 'count' pages would dip into the reserve, which only reclaim
+// itself may use: freeing pages may first need memory to put them in
+static inline bool hits_reserve(size_t count) {
+    return total_pages - used_pages < reserve_pages + count && !reclaim_in_progress();
+}
+
+static inline void check_watermark(void) {
+    if (total_pages - used_pages < low_watermark) reclaim_wake();
+}
+
+// One page, or NULL once reclaim can't free any
+static uint32_t* try_alloc_page(void) {
+    uint32_t* page = hits_reserve(1) ? NULL : alloc_one();
+
+    // Out of pages: reclaim some ourselves before giving up
+    if (!page && low_watermark && reclaim_pages(RECLAIM_BATCH) && !hits_reserve(1)) {
+        page = alloc_one();
+    }
+    if (!page) return NULL;
+
+    check_watermark();
+    TRACE(TRACE_MM_PAGE_ALLOC, page, used_pages, 0);
+    return page;
+}
+
+uint32_t* vmm_alloc_page(void) {
+    uint32_t* page = try_alloc_page();
+    if (!page) panic("Out of memory: No free pages available");
+    return page;
+}
+
 void vmm_free_page(uint32_t* page) {
     size_t page_idx = (size_t)page / PAGE_SIZE;
     
@@ -57,7 +102,53 @@ void vmm_free_page(uint32_t* page) {
     
     size_t byte_idx = page_idx / 8;
     size_t bit_idx = page_idx % 8;
+    if (page_bitmap[byte_idx] & (1 << bit_idx)) used_pages--;
     page_bitmap[byte_idx] &= ~(1 << bit_idx);
+    TRACE(TRACE_MM_PAGE_FREE, page, used_pages, 0);
+}
+
+static uint32_t* alloc_run(size_t count) {
+    size_t run = 0;
+
+    // First-fit search for a physically contiguous run
+    for (size_t i = VMM_START_PAGE; i < total_pages; i++) {
+        if (page_bitmap[i / 8] & (1 << (i % 8))) {
+            run = 0;
+            continue;
+        }
+        if (++run == count) {
+            size_t first = i + 1 - count;
+            for (size_t j = first; j <= i; j++) {
+                page_bitmap[j / 8] |= (1 << (j % 8));
+            }
+            used_pages += count;
+            return (uint32_t*)(first * PAGE_SIZE);
+        }
+    }
+
+    return NULL;
+}
+
+uint32_t* vmm_alloc_pages(size_t count) {
+    if (count == 0) return NULL;
+    if (count == 1) return try_alloc_page();
+
+    // When memory is short, reclaiming may open up a run; try once. A run
+    // missing only to fragmentation is left to the caller.
+    uint32_t* pages = hits_reserve(count) ? NULL : alloc_run(count);
+    if (!pages && total_pages - used_pages < low_watermark + count && reclaim_pages(count) &&
+        !hits_reserve(count)) {
+        pages = alloc_run(count);
+    }
+    if (pages) check_watermark();
+    return pages;
+}
+
+void vmm_free_pages(uint32_t* pages, size_t count) {
+    uint8_t* p = (uint8_t*)pages;
+    for (size_t i = 0; i < count; i++) {
+        vmm_free_page((uint32_t*)(p + i * PAGE_SIZE));
+    }
 }
 
 size_t vmm_get_total_pages(void) {
@@ -65,15 +156,17 @@ size_t vmm_get_total_pages(void) {
 }
 
 size_t vmm_get_used_pages(void) {
-    size_t used = 0;
-    for (size_t i = 0; i < total_pages; i++) {
-        size_t byte_idx = i / 8;
-        size_t bit_idx = i % 8;
-        if (page_bitmap[byte_idx] & (1 << bit_idx)) used++;
-    }
-    return used;
+    return used_pages;
 }
 
 size_t vmm_get_free_pages(void) {
     return total_pages - vmm_get_used_pages();
 }
+
+void vmm_set_low_watermark(size_t pages) {
+    low_watermark = pages;
+}
+
+void vmm_set_reserve(size_t pages) {
+    reserve_pages = pages;
+}
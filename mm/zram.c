@@ -0,0 +1,91 @@
+/**
+ * Compressed RAM store - Bunix OS
+ *
+ * Each stored page is a single kmalloc block: a small header followed by
+ * the LZ4 data, or the header alone for same-filled pages. Compression
+ * goes through a static page-sized buffer, so a page that turns out not
+ * to be worth keeping costs no allocation.
+ */
+
+#include "../include/mm/zram.h"
+#include "../include/mm/vmm.h"
+#include "../include/mm/kmalloc.h"
+#include "../include/lib/lz4.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+
+#define ZRAM_SAME_FILLED 0xFFFF         // Length marking a same-filled entry
+
+struct zram_entry {
+    uint16_t len;                       // Compressed bytes, or ZRAM_SAME_FILLED
+    uint16_t reserved;
+    uint32_t fill;                      // The repeated word
+    uint8_t data[];
+};
+
+static uint8_t buffer[ZRAM_MAX_STORED - sizeof(struct zram_entry)];
+static zram_stats_t stats;
+
+static bool page_same_filled(const uint32_t* page, uint32_t* fill) {
+    uint32_t word = page[0];
+    for (size_t i = 1; i < PAGE_SIZE / sizeof(uint32_t); i++) {
+        if (page[i] != word) return false;
+    }
+    *fill = word;
+    return true;
+}
+
+int zram_store(const void* page, zram_entry_t** out) {
+    zram_entry_t* entry;
+    uint32_t fill;
+
+    if (page_same_filled(page, &fill)) {
+        entry = kmalloc(sizeof(zram_entry_t));
+        if (!entry) return -ENOMEM;
+        entry->len = ZRAM_SAME_FILLED;
+        entry->fill = fill;
+        stats.same_filled++;
+    } else {
+        size_t len = lz4_compress(page, PAGE_SIZE, buffer, sizeof(buffer));
+        if (!len) {
+            stats.rejects++;
+            return -E2BIG;
+        }
+
+        entry = kmalloc(sizeof(zram_entry_t) + len);
+        if (!entry) return -ENOMEM;
+        entry->len = len;
+        entry->fill = 0;
+        memcpy(entry->data, buffer, len);
+        stats.compressed_bytes += len;
+    }
+
+    stats.pages++;
+    stats.stores++;
+    *out = entry;
+    return 0;
+}
+
+void zram_free(zram_entry_t* entry) {
+    if (entry->len == ZRAM_SAME_FILLED) stats.same_filled--;
+    else stats.compressed_bytes -= entry->len;
+    stats.pages--;
+    kfree(entry);
+}
+
+int zram_load(zram_entry_t* entry, void* page) {
+    if (entry->len == ZRAM_SAME_FILLED) {
+        uint32_t* words = page;
+        for (size_t i = 0; i < PAGE_SIZE / sizeof(uint32_t); i++) words[i] = entry->fill;
+    } else if (lz4_decompress(entry->data, entry->len, page, PAGE_SIZE) != PAGE_SIZE) {
+        return -EIO;
+    }
+
+    stats.loads++;
+    zram_free(entry);
+    return 0;
+}
+
+void zram_get_stats(zram_stats_t* out) {
+    *out = stats;
+}
@@ -0,0 +1,173 @@
+/**
+ * ARP - Bunix OS
+ *
+ * Entries never expire: the links this runs on are virtual and their
+ * addresses don't move. A full cache evicts its least recently used
+ * entry. Everything here runs in process context, from senders and from
+ * net_poll(), so the cache needs no locking.
+ */
+
+#include "../include/net/arp.h"
+#include "../include/net/ethernet.h"
+#include "../include/net/inet.h"
+#include "../include/kernel/arch/x86/cpu.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+
+#define ARPHRD_ETHER   1
+#define ARPOP_REQUEST  1
+#define ARPOP_REPLY    2
+
+struct arp_pkt {
+    uint16_t htype;
+    uint16_t ptype;
+    uint8_t hlen;
+    uint8_t plen;
+    uint16_t oper;
+    uint8_t sha[ETH_ALEN];
+    uint32_t spa;
+    uint8_t tha[ETH_ALEN];
+    uint32_t tpa;
+} __attribute__((packed));
+
+enum { ARP_FREE, ARP_INCOMPLETE, ARP_REACHABLE };
+
+struct arp_entry {
+    netdev_t* dev;
+    uint32_t ip;
+    uint8_t mac[ETH_ALEN];
+    uint8_t state;
+    uint64_t requested;                 // TSC of the last request, 0 if none
+    uint64_t used;
+    sk_buff_head_t queue;               // Waiting for the reply
+};
+
+static struct arp_entry cache[ARP_CACHE_SIZE];
+static arp_stats_t stats;
+
+static const uint8_t zero_addr[ETH_ALEN];
+
+static struct arp_entry* arp_lookup(netdev_t* dev, uint32_t ip) {
+    for (int i = 0; i < ARP_CACHE_SIZE; i++) {
+        if (cache[i].state != ARP_FREE && cache[i].dev == dev && cache[i].ip == ip) return &cache[i];
+    }
+    return NULL;
+}
+
+static struct arp_entry* arp_alloc(netdev_t* dev, uint32_t ip) {
+    struct arp_entry* e = &cache[0];
+    for (int i = 0; i < ARP_CACHE_SIZE; i++) {
+        if (cache[i].state == ARP_FREE) {
+            e = &cache[i];
+            break;
+        }
+        if (cache[i].used < e->used) e = &cache[i];
+    }
+
+    if (e->state != ARP_FREE) skb_queue_purge(&e->queue);
+    e->dev = dev;
+    e->ip = ip;
+    e->state = ARP_INCOMPLETE;
+    e->requested = 0;
+    e->used = cpu_rdtsc();
+    skb_queue_init(&e->queue);
+    return e;
+}
+
+static void arp_send(netdev_t* dev, uint16_t oper, const uint8_t* dest,
+                     const uint8_t* tha, uint32_t tpa) {
+    sk_buff_t* skb = skb_alloc();
+    if (!skb) return;
+
+    struct arp_pkt* arp = (struct arp_pkt*)skb_put(skb, sizeof(struct arp_pkt));
+    arp->htype = htons(ARPHRD_ETHER);
+    arp->ptype = htons(ETH_P_IP);
+    arp->hlen = ETH_ALEN;
+    arp->plen = 4;
+    arp->oper = htons(oper);
+    memcpy(arp->sha, dev->mac, ETH_ALEN);
+    arp->spa = dev->ipv4_addr;
+    memcpy(arp->tha, tha, ETH_ALEN);
+    arp->tpa = tpa;
+
+    eth_header(skb, dev, dest, ETH_P_ARP);
+    skb->dev = dev;
+    skb->protocol = ETH_P_ARP;
+    if (oper == ARPOP_REQUEST) stats.requests++;
+    else stats.replies++;
+    dev_queue_xmit(skb);
+}
+
+// The address is known: remember it and send whatever was waiting, with
+// one doorbell for the lot
+static void arp_resolved(struct arp_entry* e, const uint8_t* mac) {
+    memcpy(e->mac, mac, ETH_ALEN);
+    e->state = ARP_REACHABLE;
+    e->used = cpu_rdtsc();
+
+    net_tx_batch_begin();
+    sk_buff_t* skb;
+    while ((skb = skb_dequeue(&e->queue))) {
+        eth_header(skb, e->dev, e->mac, skb->protocol);
+        dev_queue_xmit(skb);
+    }
+    net_tx_batch_end();
+}
+
+int arp_output(sk_buff_t* skb, netdev_t* dev, uint32_t next_hop) {
+    if (next_hop == INADDR_BROADCAST || next_hop == (dev->ipv4_addr | ~dev->ipv4_mask)) {
+        eth_header(skb, dev, eth_broadcast_addr, skb->protocol);
+        return dev_queue_xmit(skb);
+    }
+
+    struct arp_entry* e = arp_lookup(dev, next_hop);
+    if (e && e->state == ARP_REACHABLE) {
+        e->used = cpu_rdtsc();
+        eth_header(skb, dev, e->mac, skb->protocol);
+        return dev_queue_xmit(skb);
+    }
+    if (!e) e = arp_alloc(dev, next_hop);
+
+    if (e->queue.len >= ARP_QUEUE_MAX) {
+        skb_free(skb_dequeue(&e->queue));
+        stats.queue_drops++;
+    }
+    skb_queue_tail(&e->queue, skb);
+
+    uint64_t now = cpu_rdtsc();
+    if (!e->requested || cpu_tsc_to_ns(now - e->requested) >= ARP_RETRY_MS * 1000000ull) {
+        e->requested = now;
+        arp_send(dev, ARPOP_REQUEST, eth_broadcast_addr, zero_addr, next_hop);
+    }
+    return 0;
+}
+
+void arp_rcv(sk_buff_t* skb) {
+    netdev_t* dev = skb->dev;
+    stats.received++;
+
+    if (skb->len < sizeof(struct arp_pkt)) goto out;
+    struct arp_pkt* arp = (struct arp_pkt*)skb->data;
+    if (arp->htype != htons(ARPHRD_ETHER) || arp->ptype != htons(ETH_P_IP) ||
+        arp->hlen != ETH_ALEN || arp->plen != 4) goto out;
+
+    uint32_t spa = arp->spa;
+    bool for_us = dev->ipv4_addr && arp->tpa == dev->ipv4_addr;
+
+    // Refresh what we know of the sender; learn it if it is asking us,
+    // since we are about to talk to it
+    struct arp_entry* e = arp_lookup(dev, spa);
+    if (!e && for_us && spa) e = arp_alloc(dev, spa);
+    if (e) arp_resolved(e, arp->sha);
+
+    if (for_us && arp->oper == htons(ARPOP_REQUEST)) {
+        arp_send(dev, ARPOP_REPLY, arp->sha, arp->sha, spa);
+    }
+
+out:
+    skb_free(skb);
+}
+
+void arp_get_stats(arp_stats_t* out) {
+    *out = stats;
+}
@@ -0,0 +1,199 @@
+/**
+ * Network device registry and packet dispatch - Bunix OS
+ *
+ * netif_rx() only queues; everything above the driver runs from
+ * net_poll(), never from an interrupt handler. A flag keeps net_poll()
+ * from re-entering itself when a protocol handler waits (and so polls)
+ * on the way.
+ */
+
+#include "../include/net/netdev.h"
+#include "../include/net/ip.h"
+#include "../include/net/arp.h"
+#include "../include/net/inet.h"
+#include "../include/kernel/arch/x86/irq.h"
+#include "../include/kernel/sched/idle.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+
+static netdev_t* devices[NETDEV_MAX];
+static size_t num_devices = 0;
+
+static sk_buff_head_t backlog;
+static netdev_t* poll_head = NULL;      // Scheduled pollers, FIFO
+static netdev_t* poll_tail = NULL;
+static bool polling = false;
+static int tx_batch_depth = 0;
+
+static void net_idle(void) {
+    net_poll();
+}
+
+void net_init(void) {
+    skb_queue_init(&backlog);
+    skb_init();
+    loopback_init();
+    idle_register(net_idle);
+}
+
+int netdev_register(netdev_t* dev) {
+    if (num_devices >= NETDEV_MAX) return -ENOSPC;
+    if (netdev_find(dev->name)) return -EEXIST;
+
+    memset(&dev->stats, 0, sizeof(dev->stats));
+    dev->poll_next = NULL;
+    dev->poll_scheduled = false;
+    dev->tx_pending = false;
+    devices[num_devices++] = dev;
+    return 0;
+}
+
+size_t netdev_count(void) {
+    return num_devices;
+}
+
+netdev_t* netdev_get(size_t index) {
+    return index < num_devices ? devices[index] : NULL;
+}
+
+netdev_t* netdev_find(const char* name) {
+    for (size_t i = 0; i < num_devices; i++) {
+        if (strcmp(devices[i]->name, name) == 0) return devices[i];
+    }
+    return NULL;
+}
+
+int dev_queue_xmit(sk_buff_t* skb) {
+    netdev_t* dev = skb->dev;
+
+    if (!(dev->flags & IFF_UP)) {
+        dev->stats.tx_dropped++;
+        skb_free(skb);
+        return -ENETUNREACH;
+    }
+
+    uint32_t len = skb->len;
+    int err = dev->ops->xmit(dev, skb);
+    if (err) {
+        dev->stats.tx_dropped++;
+        return err;
+    }
+    dev->stats.tx_packets++;
+    dev->stats.tx_bytes += len;
+
+    if (dev->ops->flush) {
+        if (tx_batch_depth) dev->tx_pending = true;
+        else dev->ops->flush(dev);
+    }
+    return 0;
+}
+
+void net_tx_batch_begin(void) {
+    tx_batch_depth++;
+}
+
+void net_tx_batch_end(void) {
+    if (--tx_batch_depth > 0) return;
+
+    for (size_t i = 0; i < num_devices; i++) {
+        netdev_t* dev = devices[i];
+        if (dev->tx_pending) {
+            dev->tx_pending = false;
+            dev->ops->flush(dev);
+        }
+    }
+}
+
+void netif_receive_skb(sk_buff_t* skb) {
+    netdev_t* dev = skb->dev;
+
+    dev->stats.rx_packets++;
+    dev->stats.rx_bytes += skb->len;
+
+    switch (skb->protocol) {
+    case ETH_P_IP:
+        ip_rcv(skb);
+        break;
+    case ETH_P_ARP:
+        arp_rcv(skb);
+        break;
+    default:
+        dev->stats.rx_dropped++;
+        skb_free(skb);
+        break;
+    }
+}
+
+void netif_rx(sk_buff_t* skb) {
+    uint32_t flags = irq_save();
+    if (backlog.len >= NETDEV_BACKLOG) {
+        skb->dev->stats.rx_dropped++;
+        irq_restore(flags);
+        skb_free(skb);
+        return;
+    }
+    skb_queue_tail(&backlog, skb);
+    irq_restore(flags);
+}
+
+void napi_schedule(netdev_t* dev) {
+    uint32_t flags = irq_save();
+    if (!dev->poll_scheduled) {
+        dev->poll_scheduled = true;
+        dev->poll_next = NULL;
+        if (poll_tail) poll_tail->poll_next = dev;
+        else poll_head = dev;
+        poll_tail = dev;
+    }
+    irq_restore(flags);
+}
+
+static netdev_t* napi_next(void) {
+    uint32_t flags = irq_save();
+    netdev_t* dev = poll_head;
+    if (dev) {
+        poll_head = dev->poll_next;
+        if (!poll_head) poll_tail = NULL;
+        dev->poll_scheduled = false;
+    }
+    irq_restore(flags);
+    return dev;
+}
+
+int net_poll(void) {
+    int done = 0;
+
+    if (polling) return 0;
+    polling = true;
+
+    // Packets queued from interrupt context, a batch at a time so the
+    // queue lock isn't taken per packet
+    for (;;) {
+        uint32_t flags = irq_save();
+        sk_buff_head_t batch = backlog;
+        skb_queue_init(&backlog);
+        irq_restore(flags);
+        if (!batch.len) break;
+
+        sk_buff_t* skb;
+        while ((skb = skb_dequeue(&batch))) {
+            netif_receive_skb(skb);
+            done++;
+        }
+    }
+
+    // Each device scheduled now gets one turn. One that used its whole
+    // budget still has work and goes to the back of the list; otherwise
+    // the driver has re-enabled its interrupt.
+    netdev_t* last = poll_tail;
+    netdev_t* dev;
+    while (last && (dev = napi_next())) {
+        int n = dev->ops->poll(dev, NAPI_WEIGHT);
+        done += n;
+        if (n >= NAPI_WEIGHT) napi_schedule(dev);
+        if (dev == last) break;
+    }
+
+    polling = false;
+    return done;
+}
@@ -0,0 +1,47 @@
+/**
+ * Ethernet - Bunix OS
+ */
+
+#include "../include/net/ethernet.h"
+#include "../include/net/inet.h"
+#include "../include/lib/string.h"
+
+const uint8_t eth_broadcast_addr[ETH_ALEN] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+static int num_eth = 0;
+
+void ether_setup(netdev_t* dev) {
+    strcpy(dev->name, "eth0");
+    dev->name[3] = '0' + num_eth;
+    dev->flags = IFF_UP;
+    dev->mtu = ETH_DATA_LEN;
+    dev->hard_header_len = ETH_HLEN;
+
+    // QEMU's user-mode network places its guest at 10.0.2.15. Other NICs
+    // stay unaddressed until ifconfig gives them one.
+    if (num_eth == 0) {
+        dev->ipv4_addr = htonl(0x0A00020Fu);
+        dev->ipv4_mask = htonl(0xFFFFFF00u);
+    }
+    num_eth++;
+}
+
+void eth_header(sk_buff_t* skb, netdev_t* dev, const uint8_t* daddr, uint16_t proto) {
+    struct ethhdr* eth = (struct ethhdr*)skb_push(skb, ETH_HLEN);
+    memcpy(eth->h_dest, daddr, ETH_ALEN);
+    memcpy(eth->h_source, dev->mac, ETH_ALEN);
+    eth->h_proto = htons(proto);
+}
+
+bool eth_type_trans(sk_buff_t* skb, netdev_t* dev) {
+    if (skb->len < ETH_HLEN) return false;
+
+    struct ethhdr* eth = (struct ethhdr*)skb->data;
+    skb->dev = dev;
+    skb->protocol = ntohs(eth->h_proto);
+    skb_pull(skb, ETH_HLEN);
+
+    // Group bit: broadcast is the only group we listen to
+    if (eth->h_dest[0] & 1) return memcmp(eth->h_dest, eth_broadcast_addr, ETH_ALEN) == 0;
+    return memcmp(eth->h_dest, dev->mac, ETH_ALEN) == 0;
+}
@@ -0,0 +1,190 @@
+/**
+ * IPv4 - Bunix OS
+ */
+
+#include "../include/net/ip.h"
+#include "../include/net/sock.h"
+#include "../include/net/arp.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+
+static ip_stats_t stats;
+static uint16_t next_id = 1;
+
+bool ip_is_local(uint32_t addr) {
+    if ((ntohl(addr) >> 24) == 127) return true;
+    for (size_t i = 0; i < netdev_count(); i++) {
+        netdev_t* dev = netdev_get(i);
+        if (dev->ipv4_addr && dev->ipv4_addr == addr) return true;
+    }
+    return false;
+}
+
+static netdev_t* loopback_dev(void) {
+    for (size_t i = 0; i < netdev_count(); i++) {
+        netdev_t* dev = netdev_get(i);
+        if (dev->flags & IFF_LOOPBACK) return dev;
+    }
+    return NULL;
+}
+
+netdev_t* ip_route(uint32_t daddr, uint32_t* saddr) {
+    // Our own addresses, whichever device owns them, go round through lo
+    if (ip_is_local(daddr)) {
+        *saddr = daddr;
+        return loopback_dev();
+    }
+
+    for (size_t i = 0; i < netdev_count(); i++) {
+        netdev_t* dev = netdev_get(i);
+        if (!(dev->flags & IFF_UP) || (dev->flags & IFF_LOOPBACK) || !dev->ipv4_addr) continue;
+        if ((daddr & dev->ipv4_mask) == (dev->ipv4_addr & dev->ipv4_mask) ||
+            daddr == INADDR_BROADCAST) {
+            *saddr = dev->ipv4_addr;
+            return dev;
+        }
+    }
+    return NULL;
+}
+
+void ip_transport_csum(sk_buff_t* skb, netdev_t* dev, uint32_t saddr, uint32_t daddr,
+                       uint8_t proto, uint16_t csum_offset) {
+    uint16_t* check = (uint16_t*)(skb->data + csum_offset);
+    uint32_t sum = csum_tcpudp_nofold(saddr, daddr, skb->len, proto, 0);
+
+    if (dev->features & NETIF_F_HW_CSUM) {
+        // The device sums from csum_start and adds in what is left here
+        *check = ~csum_fold(sum);
+        skb->ip_summed = CHECKSUM_PARTIAL;
+        skb->csum_start = skb->data - skb->head;
+        skb->csum_offset = csum_offset;
+        return;
+    }
+
+    *check = 0;
+    uint16_t csum = csum_fold(csum_partial(skb->data, skb->len, sum));
+    // UDP reserves 0 for "no checksum"
+    if (csum == 0 && proto == IPPROTO_UDP) csum = 0xFFFF;
+    *check = csum;
+    skb->ip_summed = CHECKSUM_NONE;
+}
+
+int ip_send(sk_buff_t* skb, netdev_t* dev, uint32_t saddr, uint32_t daddr, uint8_t proto) {
+    stats.out_requests++;
+
+    if (skb->len + sizeof(struct iphdr) > dev->mtu) {
+        skb_free(skb);
+        return -EMSGSIZE;
+    }
+
+    skb->transport_header = skb->data;
+    struct iphdr* iph = (struct iphdr*)skb_push(skb, sizeof(struct iphdr));
+    skb->network_header = (uint8_t*)iph;
+
+    iph->ihl_version = 0x45;
+    iph->tos = 0;
+    iph->tot_len = htons(skb->len);
+    iph->id = htons(next_id++);
+    iph->frag_off = htons(IP_DF);
+    iph->ttl = IP_TTL;
+    iph->protocol = proto;
+    iph->check = 0;
+    iph->saddr = saddr;
+    iph->daddr = daddr;
+    iph->check = ip_fast_csum(iph, sizeof(struct iphdr));
+
+    skb->dev = dev;
+    skb->protocol = ETH_P_IP;
+
+    // Devices with a link header need the next hop's address first. The
+    // next hop is the destination: every route is directly attached.
+    if (dev->hard_header_len) return arp_output(skb, dev, daddr);
+    return dev_queue_xmit(skb);
+}
+
+// Directed broadcast for the subnet of the device a packet came in on
+static bool ip_is_subnet_broadcast(const netdev_t* dev, uint32_t addr) {
+    return dev->ipv4_addr && addr == (dev->ipv4_addr | ~dev->ipv4_mask);
+}
+
+void ip_rcv(sk_buff_t* skb) {
+    stats.in_receives++;
+
+    if (skb->len < sizeof(struct iphdr)) goto hdr_error;
+    struct iphdr* iph = (struct iphdr*)skb->data;
+    uint32_t ihl = (iph->ihl_version & 0x0F) * 4;
+    uint32_t tot_len = ntohs(iph->tot_len);
+
+    if ((iph->ihl_version >> 4) != 4 || ihl < sizeof(struct iphdr) ||
+        tot_len < ihl || tot_len > skb->len) goto hdr_error;
+    if (ip_fast_csum(iph, ihl) != 0) goto hdr_error;
+
+    if (ntohs(iph->frag_off) & (IP_MF | IP_OFFSET)) goto discard;
+    if (!ip_is_local(iph->daddr) && iph->daddr != INADDR_BROADCAST &&
+        !ip_is_subnet_broadcast(skb->dev, iph->daddr)) goto discard;
+
+    // Link layers pad short frames
+    skb_trim(skb, tot_len);
+    skb->network_header = skb->data;
+    skb_pull(skb, ihl);
+    skb->transport_header = skb->data;
+
+    switch (iph->protocol) {
+    case IPPROTO_UDP:
+        stats.in_delivers++;
+        udp_rcv(skb);
+        return;
+    case IPPROTO_TCP:
+        stats.in_delivers++;
+        tcp_rcv(skb);
+        return;
+    }
+
+discard:
+    stats.in_discards++;
+    skb_free(skb);
+    return;
+
+hdr_error:
+    stats.in_hdr_errors++;
+    skb_free(skb);
+}
+
+int inet_aton(const char* cp, uint32_t* addr) {
+    uint32_t result = 0;
+
+    for (int part = 0; part < 4; part++) {
+        uint32_t v = 0;
+        int digits = 0;
+        while (*cp >= '0' && *cp <= '9' && digits < 3) {
+            v = v * 10 + (*cp++ - '0');
+            digits++;
+        }
+        if (!digits || v > 255) return 0;
+        result = (result << 8) | v;
+        if (part < 3 && *cp++ != '.') return 0;
+    }
+    if (*cp) return 0;
+
+    *addr = htonl(result);
+    return 1;
+}
+
+char* inet_ntoa_r(uint32_t addr, char* buf) {
+    uint32_t host = ntohl(addr);
+    char* p = buf;
+
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        uint32_t v = (host >> shift) & 0xFF;
+        if (v >= 100) *p++ = '0' + v / 100;
+        if (v >= 10) *p++ = '0' + (v / 10) % 10;
+        *p++ = '0' + v % 10;
+        if (shift) *p++ = '.';
+    }
+    *p = '\0';
+    return buf;
+}
+
+void ip_get_stats(ip_stats_t* out) {
+    *out = stats;
+}
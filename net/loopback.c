@@ -0,0 +1,37 @@
+/**
+ * Loopback device - Bunix OS
+ *
+ * Transmit hands the very same skb back to the receive path. Nothing is
+ * copied and no checksum needs computing: the data never left memory.
+ */
+
+#include "../include/net/netdev.h"
+#include "../include/net/inet.h"
+#include "../include/lib/string.h"
+
+static int loopback_xmit(netdev_t* dev, sk_buff_t* skb) {
+    if (skb->ip_summed == CHECKSUM_PARTIAL) skb->ip_summed = CHECKSUM_UNNECESSARY;
+    skb->dev = dev;
+    netif_rx(skb);
+    return 0;
+}
+
+static const netdev_ops_t loopback_ops = {
+    .xmit = loopback_xmit,
+    .poll = NULL,
+};
+
+static netdev_t loopback_dev = {
+    .name = "lo",
+    .flags = IFF_UP | IFF_LOOPBACK,
+    .features = NETIF_F_HW_CSUM | NETIF_F_RXCSUM,
+    .mtu = SKB_MAX_DATA,
+    .hard_header_len = 0,
+    .ops = &loopback_ops,
+};
+
+void loopback_init(void) {
+    loopback_dev.ipv4_addr = htonl(INADDR_LOOPBACK);
+    loopback_dev.ipv4_mask = htonl(0xFF000000u);
+    netdev_register(&loopback_dev);
+}
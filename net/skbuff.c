@@ -0,0 +1,87 @@
+/**
+ * Packet buffer pool - Bunix OS
+ *
+ * Buffers come two to a page, with their descriptors allocated alongside
+ * from the heap. The pool starts at SKB_POOL_INIT buffers and grows a page
+ * at a time when the free list runs dry, up to SKB_POOL_MAX. The kernel
+ * runs on one CPU, so the per-CPU free list is a single list guarded by
+ * disabling interrupts (drivers allocate and free from their handlers).
+ */
+
+#include "../include/net/skbuff.h"
+#include "../include/mm/vmm.h"
+#include "../include/mm/kmalloc.h"
+#include "../include/kernel/arch/x86/irq.h"
+#include "../include/lib/string.h"
+
+#define SKB_PER_PAGE (PAGE_SIZE / SKB_BUF_SIZE)
+
+static sk_buff_t* free_list = NULL;
+static skb_stats_t stats;
+
+static bool skb_grow(void) {
+    if (stats.total + SKB_PER_PAGE > SKB_POOL_MAX) return false;
+
+    uint8_t* page = (uint8_t*)vmm_alloc_pages(1);
+    if (!page) return false;
+    sk_buff_t* skbs = kmalloc(SKB_PER_PAGE * sizeof(sk_buff_t));
+    if (!skbs) {
+        vmm_free_pages((uint32_t*)page, 1);
+        return false;
+    }
+
+    for (int i = 0; i < SKB_PER_PAGE; i++) {
+        skbs[i].head = page + i * SKB_BUF_SIZE;
+        skbs[i].next = free_list;
+        free_list = &skbs[i];
+    }
+    stats.total += SKB_PER_PAGE;
+    stats.free += SKB_PER_PAGE;
+    return true;
+}
+
+void skb_init(void) {
+    memset(&stats, 0, sizeof(stats));
+    while (stats.total < SKB_POOL_INIT && skb_grow());
+}
+
+sk_buff_t* skb_alloc(void) {
+    uint32_t flags = irq_save();
+    if (!free_list && !skb_grow()) {
+        stats.failures++;
+        irq_restore(flags);
+        return NULL;
+    }
+    sk_buff_t* skb = free_list;
+    free_list = skb->next;
+    stats.free--;
+    stats.allocs++;
+    irq_restore(flags);
+
+    uint8_t* head = skb->head;
+    memset(skb, 0, sizeof(*skb));
+    skb->head = head;
+    skb->data = head + SKB_HEADROOM;
+    return skb;
+}
+
+void skb_free(sk_buff_t* skb) {
+    if (!skb) return;
+    uint32_t flags = irq_save();
+    skb->next = free_list;
+    free_list = skb;
+    stats.free++;
+    stats.frees++;
+    irq_restore(flags);
+}
+
+void skb_queue_purge(sk_buff_head_t* q) {
+    sk_buff_t* skb;
+    while ((skb = skb_dequeue(q))) skb_free(skb);
+}
+
+void skb_get_stats(skb_stats_t* out) {
+    uint32_t flags = irq_save();
+    *out = stats;
+    irq_restore(flags);
+}
@@ -0,0 +1,377 @@
+/**
+ * Socket layer - Bunix OS
+ *
+ * Maps socket descriptors to socks, checks addresses, and does the
+ * waiting for the protocols. There is no scheduler to sleep in, so a
+ * blocked call keeps the stack moving itself: it polls the devices and
+ * runs idle work until its socket is ready. Nothing here halts the CPU;
+ * there is no timer interrupt to wake it for a timeout.
+ */
+
+#include "../include/net/socket.h"
+#include "../include/net/sock.h"
+#include "../include/net/netdev.h"
+#include "../include/net/ip.h"
+#include "../include/net/inet.h"
+#include "../include/mm/kmalloc.h"
+#include "../include/kernel/arch/x86/cpu.h"
+#include "../include/kernel/sched/idle.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+
+#define EPHEMERAL_FIRST 49152
+#define EPHEMERAL_LAST  65535
+
+static struct sock* sockets[SOCK_MAX];
+static uint16_t next_ephemeral = EPHEMERAL_FIRST;
+
+struct sock* sock_alloc(int type, const struct proto* prot) {
+    struct sock* sk = kzalloc(sizeof(struct sock));
+    if (!sk) return NULL;
+
+    sk->type = type;
+    sk->prot = prot;
+    sk->rcvbuf = SOCK_RCVBUF_DEFAULT;
+    sk->sndbuf = SOCK_SNDBUF_DEFAULT;
+    skb_queue_init(&sk->receive_queue);
+    return sk;
+}
+
+void sock_free(struct sock* sk) {
+    skb_queue_purge(&sk->receive_queue);
+    kfree(sk);
+}
+
+int sock_wait(struct sock* sk, bool (*ready)(struct sock* sk), uint32_t timeout_ms, bool nonblock) {
+    if (ready(sk)) return 0;
+    if (nonblock) {
+        net_poll();
+        return ready(sk) ? 0 : -EAGAIN;
+    }
+
+    uint64_t start = cpu_rdtsc();
+    uint64_t timeout_ns = (uint64_t)timeout_ms * 1000000;
+    for (;;) {
+        if (!net_poll()) {
+            idle_poll();
+            cpu_pause();
+        }
+        if (ready(sk)) return 0;
+        if (timeout_ms && cpu_tsc_to_ns(cpu_rdtsc() - start) >= timeout_ns) return -EAGAIN;
+    }
+}
+
+uint16_t inet_ephemeral_port(bool (*in_use)(uint16_t port)) {
+    for (uint32_t tries = 0; tries <= EPHEMERAL_LAST - EPHEMERAL_FIRST; tries++) {
+        uint16_t port = next_ephemeral;
+        next_ephemeral = (port == EPHEMERAL_LAST) ? EPHEMERAL_FIRST : port + 1;
+        if (!in_use(htons(port))) return htons(port);
+    }
+    return 0;
+}
+
+static struct sock* sock_lookup(int fd) {
+    if (fd < SOCK_FD_BASE || fd >= SOCK_FD_BASE + SOCK_MAX) return NULL;
+    return sockets[fd - SOCK_FD_BASE];
+}
+
+bool socket_is_fd(int fd) {
+    return sock_lookup(fd) != NULL;
+}
+
+// Validate a sockaddr_in coming from the caller
+static int sock_addr_in(const struct sockaddr* addr, socklen_t addrlen, const struct sockaddr_in** sin) {
+    if (!addr || addrlen < sizeof(struct sockaddr_in)) return -EINVAL;
+    if (addr->sa_family != AF_INET) return -EAFNOSUPPORT;
+    *sin = (const struct sockaddr_in*)addr;
+    return 0;
+}
+
+static void sock_fill_addr(struct sockaddr* addr, socklen_t* addrlen, uint32_t ip, uint16_t port) {
+    if (!addr || !addrlen) return;
+
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = port;
+    sin.sin_addr = ip;
+
+    socklen_t len = *addrlen < sizeof(sin) ? *addrlen : sizeof(sin);
+    memcpy(addr, &sin, len);
+    *addrlen = sizeof(sin);
+}
+
+static int sock_install(struct sock* sk) {
+    for (int i = 0; i < SOCK_MAX; i++) {
+        if (!sockets[i]) {
+            sockets[i] = sk;
+            return SOCK_FD_BASE + i;
+        }
+    }
+    return -EMFILE;
+}
+
+int socket_create(int family, int type, int protocol) {
+    if (family != AF_INET) return -EAFNOSUPPORT;
+
+    const struct proto* prot;
+    if (type == SOCK_STREAM && (protocol == 0 || protocol == IPPROTO_TCP)) {
+        prot = &tcp_prot;
+    } else if (type == SOCK_DGRAM && (protocol == 0 || protocol == IPPROTO_UDP)) {
+        prot = &udp_prot;
+    } else {
+        return -EPROTONOSUPPORT;
+    }
+
+    struct sock* sk = sock_alloc(type, prot);
+    if (!sk) return -ENOMEM;
+    int fd = sock_install(sk);
+    if (fd < 0) sock_free(sk);
+    return fd;
+}
+
+int socket_bind(int fd, const struct sockaddr* addr, socklen_t addrlen) {
+    struct sock* sk = sock_lookup(fd);
+    if (!sk) return -ENOTSOCK;
+
+    const struct sockaddr_in* sin;
+    int err = sock_addr_in(addr, addrlen, &sin);
+    if (err) return err;
+    if (sin->sin_addr != INADDR_ANY && !ip_is_local(sin->sin_addr)) return -EINVAL;
+    return sk->prot->bind(sk, sin->sin_addr, sin->sin_port);
+}
+
+int socket_connect(int fd, const struct sockaddr* addr, socklen_t addrlen) {
+    struct sock* sk = sock_lookup(fd);
+    if (!sk) return -ENOTSOCK;
+
+    const struct sockaddr_in* sin;
+    int err = sock_addr_in(addr, addrlen, &sin);
+    if (err) return err;
+    if (sin->sin_addr == INADDR_ANY || !sin->sin_port) return -EINVAL;
+    return sk->prot->connect(sk, sin->sin_addr, sin->sin_port);
+}
+
+int socket_listen(int fd, int backlog) {
+    struct sock* sk = sock_lookup(fd);
+    if (!sk) return -ENOTSOCK;
+    if (!sk->prot->listen) return -EOPNOTSUPP;
+    return sk->prot->listen(sk, backlog);
+}
+
+static bool sock_accept_ready(struct sock* sk) {
+    return sk->accept_head != NULL;
+}
+
+int socket_accept(int fd, struct sockaddr* addr, socklen_t* addrlen) {
+    struct sock* sk = sock_lookup(fd);
+    if (!sk) return -ENOTSOCK;
+    if (!sk->prot->accept) return -EOPNOTSUPP;
+    if (!sk->backlog) return -EINVAL;
+
+    int err = sock_wait(sk, sock_accept_ready, sk->rcvtimeo_ms, false);
+    if (err) return err;
+
+    struct sock* child = sk->prot->accept(sk);
+    int child_fd = sock_install(child);
+    if (child_fd < 0) {
+        child->prot->close(child);
+        return child_fd;
+    }
+    sock_fill_addr(addr, addrlen, child->daddr, child->dport);
+    return child_fd;
+}
+
+int socket_getsockname(int fd, struct sockaddr* addr, socklen_t* addrlen) {
+    struct sock* sk = sock_lookup(fd);
+    if (!sk) return -ENOTSOCK;
+    sock_fill_addr(addr, addrlen, sk->saddr, sk->sport);
+    return 0;
+}
+
+int socket_sendto(int fd, const void* buf, size_t len, int flags,
+                  const struct sockaddr* addr, socklen_t addrlen) {
+    struct sock* sk = sock_lookup(fd);
+    if (!sk) return -ENOTSOCK;
+    if (sk->shutdown & SK_SHUT_WR) return -EPIPE;
+
+    uint32_t daddr = 0;
+    uint16_t dport = 0;
+    if (addr && sk->type == SOCK_DGRAM) {
+        const struct sockaddr_in* sin;
+        int err = sock_addr_in(addr, addrlen, &sin);
+        if (err) return err;
+        daddr = sin->sin_addr;
+        dport = sin->sin_port;
+    }
+    return sk->prot->sendmsg(sk, buf, len, flags, daddr, dport);
+}
+
+int socket_send_skb(int fd, sk_buff_t* skb, int flags, const struct sockaddr_in* addr) {
+    struct sock* sk = sock_lookup(fd);
+    if (!sk) {
+        skb_free(skb);
+        return -ENOTSOCK;
+    }
+    if (sk->shutdown & SK_SHUT_WR) {
+        skb_free(skb);
+        return -EPIPE;
+    }
+
+    uint32_t daddr = 0;
+    uint16_t dport = 0;
+    if (addr && sk->type == SOCK_DGRAM) {
+        daddr = addr->sin_addr;
+        dport = addr->sin_port;
+    }
+    return sk->prot->send_skb(sk, skb, flags, daddr, dport);
+}
+
+static bool sock_readable(struct sock* sk) {
+    return sk->receive_queue.len || sk->err || (sk->shutdown & SK_SHUT_RD);
+}
+
+// Wait for data; 0 when there is some, 1 at end of stream, or -errno
+static int sock_wait_data(struct sock* sk, int flags) {
+    int err = sock_wait(sk, sock_readable, sk->rcvtimeo_ms, flags & MSG_DONTWAIT);
+    if (err) return err;
+    if (sk->receive_queue.len) return 0;
+    if (sk->err) {
+        err = sk->err;
+        sk->err = 0;
+        return err;
+    }
+    return 1;
+}
+
+int socket_recvfrom(int fd, void* buf, size_t len, int flags,
+                    struct sockaddr* addr, socklen_t* addrlen) {
+    struct sock* sk = sock_lookup(fd);
+    if (!sk) return -ENOTSOCK;
+
+    int err = sock_wait_data(sk, flags);
+    if (err < 0) return err;
+    if (err > 0) return 0;
+
+    sk_buff_t* skb = sk->receive_queue.head;
+    sock_fill_addr(addr, addrlen, INET_SKB_CB(skb)->saddr, INET_SKB_CB(skb)->sport);
+
+    // A datagram is read whole, the excess discarded; a stream is read
+    // across as many segments as fit
+    size_t copied = 0;
+    while (skb && copied < len) {
+        uint32_t n = skb->len < len - copied ? skb->len : len - copied;
+        memcpy((uint8_t*)buf + copied, skb->data, n);
+        copied += n;
+        if (flags & MSG_PEEK) break;    // Only the first skb is peeked
+        if (sk->type == SOCK_DGRAM || n == skb->len) {
+            skb_dequeue(&sk->receive_queue);
+            sk->rcv_queued -= skb->len;
+            skb_free(skb);
+            if (sk->type == SOCK_DGRAM) break;
+        } else {
+            skb_pull(skb, n);
+            sk->rcv_queued -= n;
+        }
+        skb = sk->receive_queue.head;
+    }
+
+    if (!(flags & MSG_PEEK) && sk->prot->recvd) sk->prot->recvd(sk);
+    return copied;
+}
+
+int socket_recv_skb(int fd, sk_buff_t** out, int flags, struct sockaddr_in* addr) {
+    struct sock* sk = sock_lookup(fd);
+    if (!sk) return -ENOTSOCK;
+
+    *out = NULL;
+    int err = sock_wait_data(sk, flags);
+    if (err < 0) return err;
+    if (err > 0) return 0;
+
+    sk_buff_t* skb = skb_dequeue(&sk->receive_queue);
+    sk->rcv_queued -= skb->len;
+    if (addr) {
+        memset(addr, 0, sizeof(*addr));
+        addr->sin_family = AF_INET;
+        addr->sin_addr = INET_SKB_CB(skb)->saddr;
+        addr->sin_port = INET_SKB_CB(skb)->sport;
+    }
+    if (sk->prot->recvd) sk->prot->recvd(sk);
+
+    *out = skb;
+    return skb->len;
+}
+
+int socket_setsockopt(int fd, int level, int name, const void* val, socklen_t len) {
+    struct sock* sk = sock_lookup(fd);
+    if (!sk) return -ENOTSOCK;
+    if (level != SOL_SOCKET) return -EOPNOTSUPP;
+    if (!val || len < sizeof(uint32_t)) return -EINVAL;
+
+    uint32_t v = *(const uint32_t*)val;
+    switch (name) {
+    case SO_REUSEADDR:
+        sk->reuseaddr = v != 0;
+        return 0;
+    case SO_RCVBUF:
+        if (v < SKB_BUF_SIZE) v = SKB_BUF_SIZE;
+        sk->rcvbuf = v;
+        return 0;
+    case SO_SNDBUF:
+        sk->sndbuf = v;
+        return 0;
+    case SO_RCVTIMEO:
+        sk->rcvtimeo_ms = v;
+        return 0;
+    case SO_SNDTIMEO:
+        sk->sndtimeo_ms = v;
+        return 0;
+    }
+    return -EOPNOTSUPP;
+}
+
+int socket_getsockopt(int fd, int level, int name, void* val, socklen_t* len) {
+    struct sock* sk = sock_lookup(fd);
+    if (!sk) return -ENOTSOCK;
+    if (level != SOL_SOCKET) return -EOPNOTSUPP;
+    if (!val || !len || *len < sizeof(uint32_t)) return -EINVAL;
+
+    uint32_t v;
+    switch (name) {
+    case SO_REUSEADDR: v = sk->reuseaddr; break;
+    case SO_ERROR:     v = -sk->err; sk->err = 0; break;
+    case SO_RCVBUF:    v = sk->rcvbuf; break;
+    case SO_SNDBUF:    v = sk->sndbuf; break;
+    case SO_RCVTIMEO:  v = sk->rcvtimeo_ms; break;
+    case SO_SNDTIMEO:  v = sk->sndtimeo_ms; break;
+    default:
+        return -EOPNOTSUPP;
+    }
+    *(uint32_t*)val = v;
+    *len = sizeof(uint32_t);
+    return 0;
+}
+
+int socket_shutdown(int fd, int how) {
+    struct sock* sk = sock_lookup(fd);
+    if (!sk) return -ENOTSOCK;
+    if (how < SHUT_RD || how > SHUT_RDWR) return -EINVAL;
+
+    if (sk->prot->shutdown) {
+        sk->prot->shutdown(sk, how);
+    } else {
+        if (how != SHUT_WR) sk->shutdown |= SK_SHUT_RD;
+        if (how != SHUT_RD) sk->shutdown |= SK_SHUT_WR;
+    }
+    return 0;
+}
+
+int socket_close(int fd) {
+    struct sock* sk = sock_lookup(fd);
+    if (!sk) return -EBADF;
+
+    sockets[fd - SOCK_FD_BASE] = NULL;
+    sk->prot->close(sk);
+    return 0;
+}
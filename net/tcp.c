@@ -0,0 +1,682 @@
+/**
+ * TCP - Bunix OS
+ *
+ * Enough TCP to carry a stream between two ends that do not lose
+ * packets: the three-way handshake, in-order data with flow control,
+ * and both ways of closing. Every segment is acknowledged at once.
+ * There is no retransmission, so nothing is kept once it is sent, and
+ * out-of-order segments are dropped with a duplicate ACK. TIME_WAIT is
+ * skipped: a connection is gone as soon as both FINs are acknowledged.
+ *
+ * Segments go out in the skb that carries their payload. In-order
+ * segments are queued on the socket as they arrived, headers pulled off,
+ * and the reader copies (or takes) them from there.
+ */
+
+#include "../include/net/sock.h"
+#include "../include/net/ip.h"
+#include "../include/net/inet.h"
+#include "../include/kernel/arch/x86/cpu.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+
+#define TCP_FIN 0x01
+#define TCP_SYN 0x02
+#define TCP_RST 0x04
+#define TCP_PSH 0x08
+#define TCP_ACK 0x10
+
+#define TCPOPT_EOL       0
+#define TCPOPT_NOP       1
+#define TCPOPT_MSS       2
+#define TCPOLEN_MSS      4
+
+#define TCP_MSS_DEFAULT  536            // RFC 879, when the peer sends none
+#define TCP_MAX_WINDOW   0xFFFF         // No window scaling
+#define TCP_MAX_BACKLOG  128
+#define TCP_CONNECT_TIMEOUT_MS 5000
+
+enum {
+    TCP_CLOSED,
+    TCP_LISTEN,
+    TCP_SYN_SENT,
+    TCP_SYN_RECV,
+    TCP_ESTABLISHED,
+    TCP_FIN_WAIT1,
+    TCP_FIN_WAIT2,
+    TCP_CLOSING,
+    TCP_CLOSE_WAIT,
+    TCP_LAST_ACK,
+};
+
+struct tcphdr {
+    uint16_t source;
+    uint16_t dest;
+    uint32_t seq;
+    uint32_t ack_seq;
+    uint8_t doff;                       // Header words in the high nibble
+    uint8_t flags;
+    uint16_t window;
+    uint16_t check;
+    uint16_t urg_ptr;
+} __attribute__((packed));
+
+// Sequence space comparisons, modulo 2^32
+#define before(a, b) ((int32_t)((a) - (b)) < 0)
+#define after(a, b)  before(b, a)
+
+static struct sock* tcp_table = NULL;
+
+static void tcp_hash(struct sock* sk) {
+    sk->next = tcp_table;
+    tcp_table = sk;
+}
+
+static void tcp_unhash(struct sock* sk) {
+    for (struct sock** link = &tcp_table; *link; link = &(*link)->next) {
+        if (*link == sk) {
+            *link = sk->next;
+            sk->next = NULL;
+            return;
+        }
+    }
+}
+
+static struct sock* tcp_lookup(uint32_t saddr, uint16_t sport, uint32_t daddr, uint16_t dport) {
+    struct sock* listener = NULL;
+
+    for (struct sock* sk = tcp_table; sk; sk = sk->next) {
+        if (sk->sport != dport) continue;
+        if (sk->saddr != INADDR_ANY && sk->saddr != daddr) continue;
+        if (sk->state == TCP_LISTEN) {
+            listener = sk;
+        } else if (sk->daddr == saddr && sk->dport == sport) {
+            return sk;
+        }
+    }
+    return listener;
+}
+
+static bool tcp_port_in_use(uint16_t port) {
+    for (struct sock* sk = tcp_table; sk; sk = sk->next) {
+        if (sk->sport == port) return true;
+    }
+    return false;
+}
+
+static uint32_t tcp_isn(void) {
+    return (uint32_t)cpu_rdtsc();
+}
+
+// The window to offer: what the receive buffer can still take
+static uint16_t tcp_select_window(struct sock* sk) {
+    uint32_t win = sock_rspace(sk);
+    if (win > TCP_MAX_WINDOW) win = TCP_MAX_WINDOW;
+    sk->rcv_wup = sk->rcv_nxt;
+    sk->rcv_wnd = win;
+    return win;
+}
+
+// Push a header onto the segment in 'skb' and send it; takes the skb
+static int tcp_transmit(struct sock* sk, sk_buff_t* skb, uint8_t flags, uint32_t seq) {
+    uint32_t saddr;
+    netdev_t* dev = ip_route(sk->daddr, &saddr);
+    if (!dev) {
+        skb_free(skb);
+        return -ENETUNREACH;
+    }
+    if (sk->saddr) saddr = sk->saddr;
+
+    uint32_t hlen = sizeof(struct tcphdr);
+    if (flags & TCP_SYN) {
+        uint8_t* opt = skb_push(skb, TCPOLEN_MSS);
+        uint16_t mss = htons(sk->mss);
+        opt[0] = TCPOPT_MSS;
+        opt[1] = TCPOLEN_MSS;
+        memcpy(opt + 2, &mss, sizeof(mss));
+        hlen += TCPOLEN_MSS;
+    }
+
+    struct tcphdr* th = (struct tcphdr*)skb_push(skb, sizeof(struct tcphdr));
+    th->source = sk->sport;
+    th->dest = sk->dport;
+    th->seq = htonl(seq);
+    th->ack_seq = (flags & TCP_ACK) ? htonl(sk->rcv_nxt) : 0;
+    th->doff = (hlen / 4) << 4;
+    th->flags = flags;
+    th->window = htons(tcp_select_window(sk));
+    th->urg_ptr = 0;
+    ip_transport_csum(skb, dev, saddr, sk->daddr, IPPROTO_TCP, offsetof(struct tcphdr, check));
+
+    return ip_send(skb, dev, saddr, sk->daddr, IPPROTO_TCP);
+}
+
+// A segment with no payload: SYN, FIN, or a bare ACK
+static int tcp_send_ctl(struct sock* sk, uint8_t flags) {
+    sk_buff_t* skb = skb_alloc();
+    if (!skb) return -ENOBUFS;
+
+    int err = tcp_transmit(sk, skb, flags, sk->snd_nxt);
+    if (flags & (TCP_SYN | TCP_FIN)) sk->snd_nxt++;
+    return err;
+}
+
+static void tcp_send_ack(struct sock* sk) {
+    tcp_send_ctl(sk, TCP_ACK);
+}
+
+// Answer a segment that belongs to no connection (RFC 793, "Reset Generation")
+static void tcp_send_reset(const struct iphdr* iph, const struct tcphdr* th, uint32_t seg_len) {
+    struct sock tmp;
+
+    memset(&tmp, 0, sizeof(tmp));
+    tmp.saddr = iph->daddr;
+    tmp.sport = th->dest;
+    tmp.daddr = iph->saddr;
+    tmp.dport = th->source;
+
+    sk_buff_t* skb = skb_alloc();
+    if (!skb) return;
+    if (th->flags & TCP_ACK) {
+        tcp_transmit(&tmp, skb, TCP_RST, ntohl(th->ack_seq));
+    } else {
+        tmp.rcv_nxt = ntohl(th->seq) + seg_len;
+        tcp_transmit(&tmp, skb, TCP_RST | TCP_ACK, 0);
+    }
+}
+
+static uint16_t tcp_route_mss(uint32_t daddr) {
+    uint32_t saddr;
+    netdev_t* dev = ip_route(daddr, &saddr);
+    if (!dev) return TCP_MSS_DEFAULT;
+    return dev->mtu - sizeof(struct iphdr) - sizeof(struct tcphdr);
+}
+
+static uint16_t tcp_parse_mss(const struct tcphdr* th) {
+    const uint8_t* opt = (const uint8_t*)(th + 1);
+    const uint8_t* end = (const uint8_t*)th + (th->doff >> 4) * 4;
+
+    while (opt < end) {
+        if (*opt == TCPOPT_EOL) break;
+        if (*opt == TCPOPT_NOP) {
+            opt++;
+            continue;
+        }
+        if (opt + 1 >= end || opt[1] < 2 || opt + opt[1] > end) break;
+        if (opt[0] == TCPOPT_MSS && opt[1] == TCPOLEN_MSS) {
+            return (opt[2] << 8) | opt[3];
+        }
+        opt += opt[1];
+    }
+    return TCP_MSS_DEFAULT;
+}
+
+// The connection is over. A socket still open is kept to report it.
+static void tcp_done(struct sock* sk) {
+    sk->state = TCP_CLOSED;
+    sk->shutdown = SK_SHUT_RD | SK_SHUT_WR;
+    tcp_unhash(sk);
+    if (sk->orphan) sock_free(sk);
+}
+
+static void tcp_reset(struct sock* sk, int err) {
+    if (!sk->err) sk->err = err;
+    tcp_done(sk);
+}
+
+// A port still held by closing connections can be bound again if both
+// sides asked for SO_REUSEADDR; a listener never shares
+static bool tcp_bind_conflict(const struct sock* sk, uint16_t port) {
+    for (struct sock* s = tcp_table; s; s = s->next) {
+        if (s->sport != port) continue;
+        if (s->state == TCP_LISTEN || !s->reuseaddr || !sk->reuseaddr) return true;
+    }
+    return false;
+}
+
+static int tcp_bind(struct sock* sk, uint32_t addr, uint16_t port) {
+    if (sk->sport) return -EINVAL;
+    if (!port) {
+        port = inet_ephemeral_port(tcp_port_in_use);
+        if (!port) return -EADDRINUSE;
+    } else if (tcp_bind_conflict(sk, port)) {
+        return -EADDRINUSE;
+    }
+
+    sk->saddr = addr;
+    sk->sport = port;
+    tcp_hash(sk);
+    return 0;
+}
+
+static bool tcp_connect_done(struct sock* sk) {
+    return sk->state != TCP_SYN_SENT;
+}
+
+static int tcp_connect(struct sock* sk, uint32_t daddr, uint16_t dport) {
+    // A socket connects once; after a failed attempt open a new one
+    if (sk->state != TCP_CLOSED || sk->daddr) return -EISCONN;
+
+    uint32_t saddr;
+    if (!ip_route(daddr, &saddr)) return -ENETUNREACH;
+    if (!sk->sport) {
+        int err = tcp_bind(sk, INADDR_ANY, 0);
+        if (err) return err;
+    }
+    // Pin the source so incoming segments match this connection
+    if (!sk->saddr) sk->saddr = saddr;
+    sk->daddr = daddr;
+    sk->dport = dport;
+    sk->mss = tcp_route_mss(daddr);
+    sk->snd_una = sk->snd_nxt = tcp_isn();
+    sk->snd_wnd = 0;
+    sk->rcv_nxt = 0;
+    sk->state = TCP_SYN_SENT;
+
+    int err = tcp_send_ctl(sk, TCP_SYN);
+    if (err) {
+        tcp_done(sk);
+        return err;
+    }
+
+    sock_wait(sk, tcp_connect_done, TCP_CONNECT_TIMEOUT_MS, false);
+    if (sk->state == TCP_SYN_SENT) {
+        tcp_done(sk);
+        return -ETIMEDOUT;
+    }
+    if (sk->state != TCP_ESTABLISHED) {
+        err = sk->err ? sk->err : -ECONNREFUSED;
+        sk->err = 0;
+        return err;
+    }
+    return 0;
+}
+
+static int tcp_listen(struct sock* sk, int backlog) {
+    if (sk->state != TCP_CLOSED && sk->state != TCP_LISTEN) return -EINVAL;
+    if (!sk->sport) {
+        int err = tcp_bind(sk, INADDR_ANY, 0);
+        if (err) return err;
+    }
+    if (backlog < 1) backlog = 1;
+    if (backlog > TCP_MAX_BACKLOG) backlog = TCP_MAX_BACKLOG;
+    sk->backlog = backlog;
+    sk->state = TCP_LISTEN;
+    return 0;
+}
+
+static struct sock* tcp_accept(struct sock* sk) {
+    struct sock* child = sk->accept_head;
+    if (!child) return NULL;
+
+    sk->accept_head = child->accept_next;
+    if (!sk->accept_head) sk->accept_tail = NULL;
+    sk->accept_len--;
+    child->accept_next = NULL;
+    child->parent = NULL;
+    return child;
+}
+
+static bool tcp_can_send(struct sock* sk) {
+    if (sk->err || (sk->shutdown & SK_SHUT_WR)) return true;
+    if (sk->state != TCP_ESTABLISHED && sk->state != TCP_CLOSE_WAIT) return true;
+    return sk->snd_nxt - sk->snd_una < sk->snd_wnd;
+}
+
+// How much of the peer's window is left, or an error if sending is over
+static int tcp_send_space(struct sock* sk, int flags) {
+    int err = sock_wait(sk, tcp_can_send, sk->sndtimeo_ms, flags & MSG_DONTWAIT);
+    if (err) return err;
+
+    if (sk->err) {
+        err = sk->err;
+        sk->err = 0;
+        return err;
+    }
+    if (sk->shutdown & SK_SHUT_WR) return -EPIPE;
+    if (sk->state != TCP_ESTABLISHED && sk->state != TCP_CLOSE_WAIT) return -ENOTCONN;
+    return sk->snd_wnd - (sk->snd_nxt - sk->snd_una);
+}
+
+static int tcp_sendmsg(struct sock* sk, const void* buf, size_t len, int flags,
+                       uint32_t daddr, uint16_t dport) {
+    (void)daddr;
+    (void)dport;
+    size_t sent = 0;
+
+    while (sent < len) {
+        int space = tcp_send_space(sk, flags);
+        if (space < 0) return sent ? (int)sent : space;
+
+        uint32_t chunk = len - sent;
+        if (chunk > sk->mss) chunk = sk->mss;
+        if (chunk > (uint32_t)space) chunk = space;
+
+        sk_buff_t* skb = skb_alloc();
+        if (!skb) return sent ? (int)sent : -ENOBUFS;
+        memcpy(skb_put(skb, chunk), (const uint8_t*)buf + sent, chunk);
+
+        uint32_t seq = sk->snd_nxt;
+        sk->snd_nxt += chunk;
+        int err = tcp_transmit(sk, skb, TCP_ACK | TCP_PSH, seq);
+        if (err) return sent ? (int)sent : err;
+        sent += chunk;
+    }
+    return sent;
+}
+
+static int tcp_send_skb(struct sock* sk, sk_buff_t* skb, int flags, uint32_t daddr, uint16_t dport) {
+    (void)daddr;
+    (void)dport;
+    uint32_t len = skb->len;
+
+    if (len > sk->mss) {
+        skb_free(skb);
+        return -EMSGSIZE;
+    }
+    // Wait until the whole segment fits the window
+    for (;;) {
+        int space = tcp_send_space(sk, flags);
+        if (space < 0) {
+            skb_free(skb);
+            return space;
+        }
+        if ((uint32_t)space >= len) break;
+        if (flags & MSG_DONTWAIT) {
+            skb_free(skb);
+            return -EAGAIN;
+        }
+        net_poll();
+    }
+
+    uint32_t seq = sk->snd_nxt;
+    sk->snd_nxt += len;
+    int err = tcp_transmit(sk, skb, TCP_ACK | TCP_PSH, seq);
+    return err ? err : (int)len;
+}
+
+// The reader freed buffer space: tell the peer once it is worth a segment
+static void tcp_recvd(struct sock* sk) {
+    if (sk->state != TCP_ESTABLISHED && sk->state != TCP_FIN_WAIT1 && sk->state != TCP_FIN_WAIT2) {
+        return;
+    }
+    uint32_t offered = sk->rcv_wup + sk->rcv_wnd - sk->rcv_nxt;
+    uint32_t space = sock_rspace(sk);
+    if (space > TCP_MAX_WINDOW) space = TCP_MAX_WINDOW;
+    if (space >= offered + 2 * sk->mss || (offered < sk->mss && space >= sk->mss)) {
+        tcp_send_ack(sk);
+    }
+}
+
+static void tcp_shutdown(struct sock* sk, int how) {
+    if (how == SHUT_RD || how == SHUT_RDWR) {
+        sk->shutdown |= SK_SHUT_RD;
+        skb_queue_purge(&sk->receive_queue);
+        sk->rcv_queued = 0;
+    }
+    if (how == SHUT_WR || how == SHUT_RDWR) {
+        if (sk->shutdown & SK_SHUT_WR) return;
+        sk->shutdown |= SK_SHUT_WR;
+        if (sk->state == TCP_ESTABLISHED) {
+            sk->state = TCP_FIN_WAIT1;
+            tcp_send_ctl(sk, TCP_FIN | TCP_ACK);
+        } else if (sk->state == TCP_CLOSE_WAIT) {
+            sk->state = TCP_LAST_ACK;
+            tcp_send_ctl(sk, TCP_FIN | TCP_ACK);
+        }
+    }
+}
+
+static void tcp_abort(struct sock* sk) {
+    if (sk->state != TCP_CLOSED && sk->state != TCP_LISTEN && sk->state != TCP_SYN_SENT) {
+        sk_buff_t* skb = skb_alloc();
+        if (skb) tcp_transmit(sk, skb, TCP_RST | TCP_ACK, sk->snd_nxt);
+    }
+    sk->orphan = true;
+    tcp_done(sk);
+}
+
+static void tcp_close(struct sock* sk) {
+    if (sk->state == TCP_LISTEN) {
+        struct sock* child;
+        while ((child = tcp_accept(sk))) tcp_abort(child);
+        // Handshakes still under way would come back to a freed listener
+        for (struct sock* s = tcp_table; s; ) {
+            struct sock* next = s->next;
+            if (s->parent == sk) tcp_abort(s);
+            s = next;
+        }
+        sk->orphan = true;
+        tcp_done(sk);
+        return;
+    }
+
+    // Unread data is thrown away, and the peer told so
+    if (sk->receive_queue.len && sk->state != TCP_CLOSED) {
+        tcp_abort(sk);
+        return;
+    }
+
+    sk->orphan = true;
+    tcp_shutdown(sk, SHUT_RDWR);
+    if (sk->state == TCP_CLOSED || sk->state == TCP_SYN_SENT) tcp_done(sk);
+}
+
+// A SYN for a listener: start the handshake on a new socket
+static void tcp_conn_request(struct sock* sk, const struct iphdr* iph, const struct tcphdr* th) {
+    uint32_t pending = 0;
+    for (struct sock* s = tcp_table; s; s = s->next) {
+        if (s->parent == sk && s->state == TCP_SYN_RECV) pending++;
+    }
+    if (pending + sk->accept_len >= sk->backlog) return;
+
+    struct sock* child = sock_alloc(SOCK_STREAM, &tcp_prot);
+    if (!child) return;
+
+    child->saddr = iph->daddr;
+    child->sport = th->dest;
+    child->daddr = iph->saddr;
+    child->dport = th->source;
+    child->reuseaddr = sk->reuseaddr;
+    child->rcvbuf = sk->rcvbuf;
+    child->sndbuf = sk->sndbuf;
+    child->mss = tcp_route_mss(child->daddr);
+    uint16_t peer_mss = tcp_parse_mss(th);
+    if (peer_mss < child->mss) child->mss = peer_mss;
+    child->rcv_nxt = ntohl(th->seq) + 1;
+    child->snd_una = child->snd_nxt = tcp_isn();
+    child->snd_wnd = ntohs(th->window);
+    child->parent = sk;
+    child->orphan = true;               // Nobody holds it until accept()
+    child->state = TCP_SYN_RECV;
+    tcp_hash(child);
+
+    tcp_send_ctl(child, TCP_SYN | TCP_ACK);
+}
+
+static void tcp_rcv_syn_sent(struct sock* sk, sk_buff_t* skb, const struct tcphdr* th) {
+    uint32_t ack = ntohl(th->ack_seq);
+
+    if ((th->flags & TCP_ACK) && ack != sk->snd_nxt) {
+        if (!(th->flags & TCP_RST)) tcp_send_reset(ip_hdr(skb), th, 0);
+        return;
+    }
+    if (th->flags & TCP_RST) {
+        if (th->flags & TCP_ACK) tcp_reset(sk, -ECONNREFUSED);
+        return;
+    }
+    if (!(th->flags & TCP_SYN) || !(th->flags & TCP_ACK)) return;
+
+    sk->rcv_nxt = ntohl(th->seq) + 1;
+    sk->snd_una = ack;
+    sk->snd_wnd = ntohs(th->window);
+    uint16_t peer_mss = tcp_parse_mss(th);
+    if (peer_mss < sk->mss) sk->mss = peer_mss;
+    sk->state = TCP_ESTABLISHED;
+    tcp_send_ack(sk);
+}
+
+// Our FIN is acknowledged once everything we sent is
+static bool tcp_fin_acked(const struct sock* sk) {
+    return sk->snd_una == sk->snd_nxt;
+}
+
+// Returns whether the skb was queued on the socket
+static bool tcp_rcv_state(struct sock* sk, sk_buff_t* skb, const struct tcphdr* th, uint32_t seg_len) {
+    uint32_t seq = ntohl(th->seq);
+
+    if (seq != sk->rcv_nxt) {
+        // Old or out of order: say where we are
+        if (!(th->flags & TCP_RST)) tcp_send_ack(sk);
+        return false;
+    }
+    if (th->flags & TCP_RST) {
+        if (sk->state == TCP_SYN_RECV) {
+            tcp_done(sk);
+        } else {
+            tcp_reset(sk, (sk->state == TCP_CLOSE_WAIT) ? -EPIPE : -ECONNRESET);
+        }
+        return false;
+    }
+    if ((th->flags & TCP_SYN) || !(th->flags & TCP_ACK)) return false;
+
+    uint32_t ack = ntohl(th->ack_seq);
+    if (after(ack, sk->snd_nxt)) {
+        tcp_send_ack(sk);
+        return false;
+    }
+    if (!before(ack, sk->snd_una)) {
+        sk->snd_una = ack;
+        sk->snd_wnd = ntohs(th->window);
+    }
+
+    switch (sk->state) {
+    case TCP_SYN_RECV: {
+        if (ack != sk->snd_nxt) return false;
+        struct sock* parent = sk->parent;
+        sk->state = TCP_ESTABLISHED;
+        sk->orphan = false;
+        sk->accept_next = NULL;
+        if (parent->accept_tail) parent->accept_tail->accept_next = sk;
+        else parent->accept_head = sk;
+        parent->accept_tail = sk;
+        parent->accept_len++;
+        break;
+    }
+    case TCP_FIN_WAIT1:
+        if (tcp_fin_acked(sk)) sk->state = TCP_FIN_WAIT2;
+        break;
+    case TCP_CLOSING:
+    case TCP_LAST_ACK:
+        if (tcp_fin_acked(sk)) {
+            tcp_done(sk);
+            return false;
+        }
+        break;
+    }
+
+    bool queued = false;
+    bool ack_now = false;
+    uint32_t payload = seg_len - ((th->flags & TCP_FIN) ? 1 : 0);
+
+    if (payload) {
+        bool open = sk->state == TCP_ESTABLISHED || sk->state == TCP_FIN_WAIT1 ||
+                    sk->state == TCP_FIN_WAIT2;
+        // Beyond the window offered means the peer is misbehaving; drop it
+        if (!open || payload > sk->rcv_wup + sk->rcv_wnd - sk->rcv_nxt) {
+            tcp_send_ack(sk);
+            return false;
+        }
+        sk->rcv_nxt += payload;
+        ack_now = true;
+        if (sk->shutdown & SK_SHUT_RD) {
+            // Nobody will read it; accept and forget
+        } else {
+            skb_pull(skb, (th->doff >> 4) * 4);
+            INET_SKB_CB(skb)->saddr = sk->daddr;
+            INET_SKB_CB(skb)->sport = sk->dport;
+            sk->rcv_queued += payload;
+            skb_queue_tail(&sk->receive_queue, skb);
+            queued = true;
+        }
+    }
+
+    if (th->flags & TCP_FIN) {
+        sk->rcv_nxt++;
+        sk->shutdown |= SK_SHUT_RD;
+        ack_now = true;
+        switch (sk->state) {
+        case TCP_ESTABLISHED:
+            sk->state = TCP_CLOSE_WAIT;
+            break;
+        case TCP_FIN_WAIT1:
+            sk->state = tcp_fin_acked(sk) ? TCP_CLOSED : TCP_CLOSING;
+            break;
+        case TCP_FIN_WAIT2:
+            sk->state = TCP_CLOSED;
+            break;
+        }
+    }
+
+    if (ack_now) tcp_send_ack(sk);
+    if (sk->state == TCP_CLOSED) tcp_done(sk);
+    return queued;
+}
+
+void tcp_rcv(sk_buff_t* skb) {
+    struct iphdr* iph = ip_hdr(skb);
+
+    if (skb->len < sizeof(struct tcphdr)) goto drop;
+    struct tcphdr* th = (struct tcphdr*)skb->data;
+    uint32_t hlen = (th->doff >> 4) * 4;
+    if (hlen < sizeof(struct tcphdr) || hlen > skb->len) goto drop;
+
+    if (skb->ip_summed != CHECKSUM_UNNECESSARY) {
+        uint32_t sum = csum_tcpudp_nofold(iph->saddr, iph->daddr, skb->len, IPPROTO_TCP, 0);
+        if (csum_fold(csum_partial(th, skb->len, sum)) != 0) goto drop;
+    }
+
+    // SYN and FIN each take a sequence number
+    uint32_t seg_len = skb->len - hlen;
+    if (th->flags & TCP_SYN) seg_len++;
+    if (th->flags & TCP_FIN) seg_len++;
+
+    struct sock* sk = tcp_lookup(iph->saddr, th->source, iph->daddr, th->dest);
+    if (!sk) {
+        if (!(th->flags & TCP_RST)) tcp_send_reset(iph, th, seg_len);
+        goto drop;
+    }
+
+    switch (sk->state) {
+    case TCP_LISTEN:
+        if (th->flags & TCP_RST) break;
+        if (th->flags & TCP_ACK) {
+            tcp_send_reset(iph, th, seg_len);
+        } else if (th->flags & TCP_SYN) {
+            tcp_conn_request(sk, iph, th);
+        }
+        break;
+    case TCP_SYN_SENT:
+        tcp_rcv_syn_sent(sk, skb, th);
+        break;
+    default:
+        if (tcp_rcv_state(sk, skb, th, seg_len)) return;
+        break;
+    }
+
+drop:
+    skb_free(skb);
+}
+
+const struct proto tcp_prot = {
+    .name = "TCP",
+    .bind = tcp_bind,
+    .connect = tcp_connect,
+    .listen = tcp_listen,
+    .accept = tcp_accept,
+    .sendmsg = tcp_sendmsg,
+    .send_skb = tcp_send_skb,
+    .recvd = tcp_recvd,
+    .shutdown = tcp_shutdown,
+    .close = tcp_close,
+};
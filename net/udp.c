@@ -0,0 +1,167 @@
+/**
+ * UDP - Bunix OS
+ *
+ * A datagram is one skb from sender to receiver: the payload is written
+ * once behind the headroom, the header is pushed in front of it, and on
+ * the way in the same skb is queued on the socket with the headers pulled
+ * off.
+ */
+
+#include "../include/net/sock.h"
+#include "../include/net/ip.h"
+#include "../include/net/inet.h"
+#include "../include/lib/string.h"
+#include "../include/lib/errno.h"
+
+struct udphdr {
+    uint16_t source;
+    uint16_t dest;
+    uint16_t len;
+    uint16_t check;
+} __attribute__((packed));
+
+static struct sock* udp_table = NULL;
+
+static struct sock* udp_lookup(uint32_t daddr, uint16_t dport) {
+    for (struct sock* sk = udp_table; sk; sk = sk->next) {
+        if (sk->sport == dport && (sk->saddr == INADDR_ANY || sk->saddr == daddr)) return sk;
+    }
+    return NULL;
+}
+
+static bool udp_port_in_use(uint16_t port) {
+    for (struct sock* sk = udp_table; sk; sk = sk->next) {
+        if (sk->sport == port) return true;
+    }
+    return false;
+}
+
+static int udp_bind(struct sock* sk, uint32_t addr, uint16_t port) {
+    if (sk->sport) return -EINVAL;
+    if (!port) {
+        port = inet_ephemeral_port(udp_port_in_use);
+        if (!port) return -EADDRINUSE;
+    } else if (udp_port_in_use(port)) {
+        return -EADDRINUSE;
+    }
+
+    sk->saddr = addr;
+    sk->sport = port;
+    sk->next = udp_table;
+    udp_table = sk;
+    return 0;
+}
+
+static int udp_connect(struct sock* sk, uint32_t daddr, uint16_t dport) {
+    if (!sk->sport) {
+        int err = udp_bind(sk, INADDR_ANY, 0);
+        if (err) return err;
+    }
+    sk->daddr = daddr;
+    sk->dport = dport;
+    return 0;
+}
+
+static int udp_send_skb(struct sock* sk, sk_buff_t* skb, int flags, uint32_t daddr, uint16_t dport) {
+    (void)flags;
+    if (!daddr) {
+        daddr = sk->daddr;
+        dport = sk->dport;
+    }
+    if (!daddr) {
+        skb_free(skb);
+        return -EDESTADDRREQ;
+    }
+    if (!sk->sport) {
+        int err = udp_bind(sk, INADDR_ANY, 0);
+        if (err) {
+            skb_free(skb);
+            return err;
+        }
+    }
+
+    uint32_t saddr;
+    netdev_t* dev = ip_route(daddr, &saddr);
+    if (!dev) {
+        skb_free(skb);
+        return -ENETUNREACH;
+    }
+    if (sk->saddr) saddr = sk->saddr;
+
+    uint32_t len = skb->len;
+    struct udphdr* uh = (struct udphdr*)skb_push(skb, sizeof(struct udphdr));
+    uh->source = sk->sport;
+    uh->dest = dport;
+    uh->len = htons(skb->len);
+    ip_transport_csum(skb, dev, saddr, daddr, IPPROTO_UDP, offsetof(struct udphdr, check));
+
+    int err = ip_send(skb, dev, saddr, daddr, IPPROTO_UDP);
+    return err ? err : (int)len;
+}
+
+static int udp_sendmsg(struct sock* sk, const void* buf, size_t len, int flags,
+                       uint32_t daddr, uint16_t dport) {
+    (void)flags;
+    // No fragmentation: a datagram has to fit one skb
+    if (len > SKB_MAX_DATA - sizeof(struct iphdr) - sizeof(struct udphdr)) return -EMSGSIZE;
+
+    sk_buff_t* skb = skb_alloc();
+    if (!skb) return -ENOBUFS;
+    memcpy(skb_put(skb, len), buf, len);
+    return udp_send_skb(sk, skb, 0, daddr, dport);
+}
+
+static void udp_close(struct sock* sk) {
+    for (struct sock** link = &udp_table; *link; link = &(*link)->next) {
+        if (*link == sk) {
+            *link = sk->next;
+            break;
+        }
+    }
+    sock_free(sk);
+}
+
+void udp_rcv(sk_buff_t* skb) {
+    struct iphdr* iph = ip_hdr(skb);
+
+    if (skb->len < sizeof(struct udphdr)) goto drop;
+    struct udphdr* uh = (struct udphdr*)skb->data;
+    uint32_t ulen = ntohs(uh->len);
+    if (ulen < sizeof(struct udphdr) || ulen > skb->len) goto drop;
+    skb_trim(skb, ulen);
+
+    if (uh->check && skb->ip_summed != CHECKSUM_UNNECESSARY) {
+        uint32_t sum = csum_tcpudp_nofold(iph->saddr, iph->daddr, ulen, IPPROTO_UDP, 0);
+        if (csum_fold(csum_partial(uh, ulen, sum)) != 0) goto drop;
+    }
+
+    struct sock* sk = udp_lookup(iph->daddr, uh->dest);
+    if (!sk || (sk->shutdown & SK_SHUT_RD)) goto drop;
+    if (sk->daddr && (sk->daddr != iph->saddr || sk->dport != uh->source)) goto drop;
+
+    uint32_t payload = ulen - sizeof(struct udphdr);
+    if (payload > sock_rspace(sk)) goto drop;
+
+    INET_SKB_CB(skb)->saddr = iph->saddr;
+    INET_SKB_CB(skb)->sport = uh->source;
+    skb_pull(skb, sizeof(struct udphdr));
+    sk->rcv_queued += payload;
+    skb_queue_tail(&sk->receive_queue, skb);
+    return;
+
+drop:
+    skb_free(skb);
+}
+
+const struct proto udp_prot = {
+    .name = "UDP",
+    .bind = udp_bind,
+    .connect = udp_connect,
+    .listen = NULL,
+    .accept = NULL,
+    .sendmsg = udp_sendmsg,
+    .send_skb = udp_send_skb,
+    .recvd = NULL,
+    .shutdown = NULL,
+    .close = udp_close,
+};
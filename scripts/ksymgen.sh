@@ -0,0 +1,72 @@
+#!/bin/sh
+#
+# ksymgen.sh - Bunix OS
+#
+# Reads "nm kernel.elf" on stdin and writes the C source of the kernel
+# symbol table on stdout: every text symbol, sorted by address, then
+# _etext to close the last one. Assembler-local labels (.L*, such as the
+# jump tables gcc leaves in .text) are not functions and are skipped.
+# Where several names share an address the first is kept. Empty input
+# gives an empty table, which is what the first link pass is built with
+# (see the kernel.elf rule in the Makefile).
+#
+# Names are prefix-compressed: each entry is the length of the prefix it
+# shares with the name before it, the length of the rest, and the rest.
+# Every 16th entry (KSYM_MARKER_STRIDE in ksym.h) is stored whole and
+# its offset is kept in ksyms_markers, so expanding any name decodes at
+# most 16 entries. Names are cut to 63 bytes (KSYM_NAME_LEN - 1).
+
+sort -s -k1,1 | awk '
+BEGIN {
+    n = 0
+    stride = 16
+    maxlen = 63
+}
+$2 ~ /^[Tt]$/ {
+    if ($3 == "_etext") { etext = $1; next }
+    if ($3 == "_text" || $3 ~ /^\.L/) next
+    if (n > 0 && $1 == addr[n - 1]) next
+    addr[n] = $1
+    name[n] = substr($3, 1, maxlen)
+    n++
+}
+END {
+    raw = 0
+    off = 0
+    for (i = 0; i < n; i++) {
+        shared = 0
+        if (i % stride) {
+            prev = name[i - 1]
+            while (shared < length(prev) && shared < length(name[i]) &&
+                   substr(prev, shared + 1, 1) == substr(name[i], shared + 1, 1))
+                shared++
+        }
+        prefix[i] = shared
+        rest[i] = substr(name[i], shared + 1)
+        if (i % stride == 0) marker[i / stride] = off
+        raw += length(name[i]) + 1
+        off += 2 + length(rest[i])
+    }
+
+    print "/* Generated by scripts/ksymgen.sh from nm output; do not edit */"
+    printf "/* %d symbols, names %d bytes packed into %d */\n", n, raw, off
+    print ""
+    print "#include <stdint.h>"
+    print ""
+    printf "const uint32_t ksyms_num = %d;\n", n
+    print ""
+    print "const uint32_t ksyms_addr[] = {"
+    for (i = 0; i < n; i++) printf "    0x%s,\n", addr[i]
+    printf "    0x%s,\n", (n > 0 ? etext : "0")
+    print "};"
+    print ""
+    print "const uint32_t ksyms_markers[] = {"
+    for (i = 0; i < n; i += stride) printf "    %d,\n", marker[i / stride]
+    print "    0,"
+    print "};"
+    print ""
+    print "const uint8_t ksyms_names[] ="
+    for (i = 0; i < n; i++) printf "    \"\\%03o\\%03o%s\"\n", prefix[i], length(rest[i]), rest[i]
+    print "    \"\";"
+}
+'
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+#
+# trace2json.py - Bunix OS
+#
+# Convert the tracepoint stream that "trace start" writes to COM1 into
+# Chrome trace JSON, for chrome://tracing or ui.perfetto.dev:
+#
+#   scripts/trace2json.py serial.log > trace.json
+#
+# The stream format is described in include/kernel/perf/trace.h. A serial
+# log may hold other output and any number of sessions; each session
+# shows up as its own process.
+
+import json
+import struct
+import sys
+
+MAGIC = b"BXTRACE1"
+HEADER = struct.Struct("<IHH")
+DESC = struct.Struct("<HcB8s20s32s")
+RECORD = struct.Struct("<QHBB3I")
+
+EVENT_LOST = 0xFFFE
+EVENT_END = 0xFFFF
+
+
+def cstr(raw):
+    return raw.split(b"\0", 1)[0].decode("ascii", "replace")
+
+
+def parse_session(data, pos, pid, out):
+    """Parse one session starting just past its magic; return where it ends."""
+    if pos + HEADER.size > len(data):
+        return len(data)
+    tsc_khz, record_size, nevents = HEADER.unpack_from(data, pos)
+    pos += HEADER.size
+
+    if record_size < RECORD.size:
+        sys.stderr.write("trace2json: bad record size %d\n" % record_size)
+        return pos
+
+    events = {}
+    for _ in range(nevents):
+        if pos + DESC.size > len(data):
+            return len(data)
+        event, phase, nargs, group, name, args = DESC.unpack_from(data, pos)
+        pos += DESC.size
+        arg_names = [a for a in cstr(args).split(",") if a][:nargs]
+        events[event] = (phase.decode(), cstr(group), cstr(name), arg_names)
+
+    if not tsc_khz:
+        sys.stderr.write("trace2json: TSC rate unknown, timestamps are in cycles\n")
+    scale = 1000.0 / tsc_khz if tsc_khz else 1.0
+
+    out.append({"name": "process_name", "ph": "M", "pid": pid,
+                "args": {"name": "bunix trace %d" % pid}})
+
+    base = None
+    while pos + record_size <= len(data):
+        if data.startswith(MAGIC, pos):
+            break
+        tsc, event, cpu, _, a0, a1, a2 = RECORD.unpack_from(data, pos)
+        pos += record_size
+        if base is None:
+            base = tsc
+        ts = (tsc - base) * scale
+
+        if event == EVENT_END:
+            if a0:
+                sys.stderr.write("trace2json: session %d lost %d records\n" % (pid, a0))
+            break
+        if event == EVENT_LOST:
+            out.append({"name": "lost", "cat": "trace", "ph": "i", "s": "p", "ts": ts,
+                        "pid": pid, "tid": cpu, "args": {"records": a0}})
+            continue
+
+        desc = events.get(event)
+        if desc is None:
+            phase, group, name, arg_names = "i", "unknown", "event_%#x" % event, []
+        else:
+            phase, group, name, arg_names = desc
+
+        entry = {"name": name, "cat": group, "ph": phase, "ts": ts, "pid": pid, "tid": cpu}
+        if phase == "i":
+            entry["s"] = "t"
+        values = (a0, a1, a2)
+        if arg_names:
+            entry["args"] = {n: values[i] for i, n in enumerate(arg_names)}
+        out.append(entry)
+    return pos
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.stderr.write("usage: %s serial.log > trace.json\n" % sys.argv[0])
+        return 1
+
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+
+    out = []
+    sessions = 0
+    pos = data.find(MAGIC)
+    while pos >= 0:
+        sessions += 1
+        pos = parse_session(data, pos + len(MAGIC), sessions, out)
+        pos = data.find(MAGIC, pos)
+
+    if not sessions:
+        sys.stderr.write("trace2json: no trace stream in %s\n" % sys.argv[1])
+        return 1
+
+    json.dump({"traceEvents": out, "displayTimeUnit": "ns"}, sys.stdout)
+    sys.stdout.write("\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,68 @@
+/**
+ * ACPI tables - Bunix OS
+ *
+ * Finds the RSDP the way the spec says to (first KiB of the EBDA, then
+ * 0xE0000-0xFFFFF on 16-byte boundaries) and walks the RSDT. Paging is
+ * off, so the tables are read in place.
+ */
+
+#include "../../../include/kernel/arch/x86/acpi.h"
+#include "../../../include/lib/string.h"
+#include <stddef.h>
+#include <stdbool.h>
+
+#define EBDA_SEGMENT_PTR  0x40E
+#define BIOS_AREA_START   0xE0000
+#define BIOS_AREA_END     0x100000
+
+typedef struct {
+    char signature[8];            // "RSD PTR "
+    uint8_t checksum;             // Over the first 20 bytes
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address;
+} __attribute__((packed)) acpi_rsdp_t;
+
+static const acpi_header_t* rsdt;
+static bool scanned;
+
+static bool checksum_ok(const void* p, uint32_t len) {
+    const uint8_t* b = p;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < len; i++) sum += b[i];
+    return sum == 0;
+}
+
+static const acpi_rsdp_t* scan_rsdp(uintptr_t start, uintptr_t end) {
+    for (uintptr_t p = start; p + sizeof(acpi_rsdp_t) <= end; p += 16) {
+        const acpi_rsdp_t* rsdp = (const acpi_rsdp_t*)p;
+        if (memcmp(rsdp->signature, "RSD PTR ", 8) == 0 && checksum_ok(rsdp, 20)) return rsdp;
+    }
+    return NULL;
+}
+
+static void acpi_scan(void) {
+    scanned = true;
+
+    uintptr_t ebda = (uintptr_t)*(volatile uint16_t*)EBDA_SEGMENT_PTR << 4;
+    const acpi_rsdp_t* rsdp = NULL;
+    if (ebda >= 0x80000 && ebda < 0xA0000) rsdp = scan_rsdp(ebda, ebda + 1024);
+    if (!rsdp) rsdp = scan_rsdp(BIOS_AREA_START, BIOS_AREA_END);
+    if (!rsdp || !rsdp->rsdt_address) return;
+
+    const acpi_header_t* t = (const acpi_header_t*)rsdp->rsdt_address;
+    if (memcmp(t->signature, "RSDT", 4) == 0 && checksum_ok(t, t->length)) rsdt = t;
+}
+
+const acpi_header_t* acpi_find_table(const char* signature) {
+    if (!scanned) acpi_scan();
+    if (!rsdt) return NULL;
+
+    const uint32_t* entries = (const uint32_t*)(rsdt + 1);
+    uint32_t count = (rsdt->length - sizeof(acpi_header_t)) / 4;
+    for (uint32_t i = 0; i < count; i++) {
+        const acpi_header_t* t = (const acpi_header_t*)entries[i];
+        if (t && memcmp(t->signature, signature, 4) == 0 && checksum_ok(t, t->length)) return t;
+    }
+    return NULL;
+}
@@ -0,0 +1,52 @@
+/**
+ * ACPI PM timer clock source - Bunix OS
+ *
+ * A 3.579545 MHz up-counter in I/O space, 24 bits wide unless the FADT
+ * says 32. It keeps counting through every power state, which makes it
+ * a good watchdog, but each read is a port access that a hypervisor has
+ * to emulate.
+ */
+
+#include "../../../include/kernel/arch/x86/timer.h"
+#include "../../../include/kernel/arch/x86/acpi.h"
+#include "../../../include/kernel/ports/ports.h"
+#include "../../../include/lib/errno.h"
+
+// FADT fields used here
+#define FADT_PM_TMR_BLK   76
+#define FADT_PM_TMR_LEN   91
+#define FADT_FLAGS        112
+#define FADT_TMR_VAL_EXT  (1 << 8)
+
+static uint16_t pm_port;
+
+static uint64_t acpi_pm_read(void) {
+    return inl(pm_port);
+}
+
+static clocksource_t acpi_pm_clocksource = {
+    .name = "acpi_pm",
+    .read = acpi_pm_read,
+    .mask = 0xFFFFFF,
+    .freq_hz = ACPI_PM_FREQ_HZ,
+    .rating = 200,
+    .flags = CLOCK_SOURCE_WATCHDOG,
+};
+
+int acpi_pm_clocksource_init(void) {
+    const acpi_header_t* fadt = acpi_find_table("FACP");
+    if (!fadt || fadt->length < FADT_FLAGS + 4) return -ENODEV;
+
+    const uint8_t* f = (const uint8_t*)fadt;
+    uint32_t port = *(const uint32_t*)(f + FADT_PM_TMR_BLK);
+    if (!port || port > 0xFFFF || f[FADT_PM_TMR_LEN] < 4) return -ENODEV;
+    pm_port = port;
+    if (*(const uint32_t*)(f + FADT_FLAGS) & FADT_TMR_VAL_EXT) acpi_pm_clocksource.mask = 0xFFFFFFFF;
+
+    // A dead port floats: make sure the counter moves
+    uint32_t first = inl(pm_port);
+    for (int i = 0; i < 100000; i++) {
+        if (inl(pm_port) != first) return clocksource_register(&acpi_pm_clocksource);
+    }
+    return -ENODEV;
+}
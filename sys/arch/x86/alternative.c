@@ -0,0 +1,53 @@
+/**
+ * Alternatives - Bunix OS
+ *
+ * Walks the table the ALTERNATIVE() macro builds in .altinstructions and
+ * rewrites each site whose feature the boot CPU has. Paging is off, so
+ * kernel text is writable as it stands. Everything runs once, from
+ * cpu_late_init, with interrupts off: a handler must never run half an
+ * instruction, and nothing here may call code that is itself a site,
+ * which is why the copy is a plain byte loop rather than memcpy.
+ */
+
+#include "../../../include/kernel/arch/x86/alternative.h"
+#include "../../../include/kernel/arch/x86/cpu.h"
+#include "../../../include/kernel/arch/x86/irq.h"
+#include "../../../include/kernel/panic/debug.h"
+
+#define NOP 0x90
+
+extern struct alt_instr __alt_instructions[];
+extern struct alt_instr __alt_instructions_end[];
+
+static bool patched;
+
+// The CPU checks stores against instructions already fetched, but only a
+// serializing instruction guarantees the new bytes are what runs next
+static void sync_core(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpu_cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+}
+
+int apply_alternatives(void) {
+    int count = 0;
+    if (patched) return 0;
+
+    uint32_t flags = irq_save();
+    for (struct alt_instr* a = __alt_instructions; a < __alt_instructions_end; a++) {
+        if (!cpu_has(a->feature)) continue;
+
+        volatile uint8_t* instr = (uint8_t*)&a->instr_offset + a->instr_offset;
+        const uint8_t* repl = (const uint8_t*)&a->repl_offset + a->repl_offset;
+        uint8_t i = 0;
+        for (; i < a->replacementlen; i++) instr[i] = repl[i];
+        for (; i < a->instrlen; i++) instr[i] = NOP;
+        count++;
+    }
+    sync_core();
+    patched = true;
+    irq_restore(flags);
+
+    DEBUG_INFO("Alternatives: patched %d of %d sites", count,
+               (int)(__alt_instructions_end - __alt_instructions));
+    return count;
+}
@@ -0,0 +1,177 @@
+/**
+ * Local APIC - Bunix OS
+ *
+ * Only the pieces needed for message-signalled interrupts: software
+ * enable, LINT0/LINT1 in virtual wire mode so the PIC keeps working, EOI,
+ * and a small vector allocator that wraps C handlers.
+ */
+
+#include "../../../include/kernel/arch/x86/apic.h"
+#include "../../../include/kernel/arch/x86/idt.h"
+#include "../../../include/kernel/arch/x86/cpu.h"
+#include "../../../include/kernel/ports/mmio.h"
+#include "../../../include/kernel/time/clocksource.h"
+#include "../../../include/lib/errno.h"
+
+#define IA32_APIC_BASE_MSR    0x1B
+#define APIC_BASE_ENABLE      (1 << 11)
+#define APIC_BASE_MASK        0xFFFFF000
+
+// Register offsets
+#define LAPIC_REG_ID          0x020
+#define LAPIC_REG_TPR         0x080
+#define LAPIC_REG_EOI         0x0B0
+#define LAPIC_REG_SVR         0x0F0
+#define LAPIC_REG_LVT_TIMER   0x320
+#define LAPIC_REG_LVT_PERF    0x340
+#define LAPIC_REG_LVT_LINT0   0x350
+#define LAPIC_REG_LVT_LINT1   0x360
+#define LAPIC_REG_TIMER_ICR   0x380
+#define LAPIC_REG_TIMER_CCR   0x390
+#define LAPIC_REG_TIMER_DCR   0x3E0
+
+#define LAPIC_SVR_ENABLE      (1 << 8)
+#define LAPIC_LVT_EXTINT      (7 << 8)
+#define LAPIC_LVT_NMI         (4 << 8)
+#define LAPIC_LVT_LEVEL       (1 << 15)
+#define LAPIC_LVT_MASKED      (1 << 16)
+#define LAPIC_TIMER_DEADLINE  (2 << 17)
+#define LAPIC_TIMER_DIV_1     0xB
+
+#define IA32_TSC_DEADLINE_MSR 0x6E0
+#define LAPIC_CALIBRATE_NS    10000000
+
+struct lapic_action {
+    irq_handler_t handler;
+    void* ctx;
+    uint32_t count;
+};
+
+static uintptr_t lapic_base = 0;
+static struct lapic_action actions[IDT_ENTRIES];
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return mmio_read32(lapic_base + reg);
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    mmio_write32(lapic_base + reg, value);
+}
+
+static void lapic_dispatch(interrupt_frame_t* frame) {
+    struct lapic_action* action = &actions[frame->vector];
+
+    action->count++;
+    if (action->handler) action->handler(action->ctx);
+    lapic_eoi();
+}
+
+// Spurious interrupts must not be acknowledged
+static void lapic_spurious(interrupt_frame_t* frame) {
+    (void)frame;
+}
+
+bool lapic_init(void) {
+    if (!cpu_has(X86_FEATURE_APIC) || !cpu_has(X86_FEATURE_MSR)) return false;
+
+    uint64_t base = cpu_read_msr(IA32_APIC_BASE_MSR);
+    if (!(base & APIC_BASE_ENABLE)) {
+        base |= APIC_BASE_ENABLE;
+        cpu_write_msr(IA32_APIC_BASE_MSR, base);
+    }
+    lapic_base = (uintptr_t)(base & APIC_BASE_MASK);
+
+    idt_set_handler(LAPIC_SPURIOUS_VECTOR, lapic_spurious);
+
+    // Virtual wire: PIC output on LINT0, NMI on LINT1
+    lapic_write(LAPIC_REG_LVT_LINT0, LAPIC_LVT_EXTINT);
+    lapic_write(LAPIC_REG_LVT_LINT1, LAPIC_LVT_NMI);
+    lapic_write(LAPIC_REG_TPR, 0);
+    lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+    return true;
+}
+
+bool lapic_available(void) {
+    return lapic_base != 0;
+}
+
+uint32_t lapic_id(void) {
+    return lapic_base ? lapic_read(LAPIC_REG_ID) >> 24 : 0;
+}
+
+void lapic_eoi(void) {
+    lapic_write(LAPIC_REG_EOI, 0);
+}
+
+int lapic_alloc_vector(irq_handler_t handler, void* ctx) {
+    if (!lapic_base) return -ENODEV;
+    if (!handler) return -EINVAL;
+
+    uint8_t vector = idt_alloc_vector(LAPIC_FIRST_VECTOR);
+    if (!vector) return -EBUSY;
+
+    actions[vector].handler = handler;
+    actions[vector].ctx = ctx;
+    actions[vector].count = 0;
+    idt_set_handler(vector, lapic_dispatch);
+    return vector;
+}
+
+void lapic_free_vector(uint8_t vector) {
+    if (idt_get_handler(vector) != lapic_dispatch) return;
+
+    idt_set_handler(vector, NULL);
+    actions[vector].handler = NULL;
+    actions[vector].ctx = NULL;
+}
+
+uint32_t lapic_vector_count(uint8_t vector) {
+    return actions[vector].count;
+}
+
+// Fixed delivery, physical destination, no redirection hint
+uint32_t lapic_msi_address(void) {
+    return LAPIC_DEFAULT_BASE | (lapic_id() << 12);
+}
+
+// Edge triggered, fixed delivery mode
+uint32_t lapic_msi_data(uint8_t vector) {
+    return vector;
+}
+
+// Undivided one-shot countdown, timed against the system clock
+uint32_t lapic_timer_frequency(void) {
+    if (!lapic_base) return 0;
+
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_REG_TIMER_DCR, LAPIC_TIMER_DIV_1);
+    uint64_t start = ktime_get_ns();
+    lapic_write(LAPIC_REG_TIMER_ICR, 0xFFFFFFFF);
+    uint64_t elapsed;
+    while ((elapsed = ktime_get_ns() - start) < LAPIC_CALIBRATE_NS)
+        ;
+    uint32_t ticks = 0xFFFFFFFF - lapic_read(LAPIC_REG_TIMER_CCR);
+    lapic_write(LAPIC_REG_TIMER_ICR, 0);
+    return (uint32_t)div_u64((uint64_t)ticks * 1000000000ull, (uint32_t)elapsed);
+}
+
+void lapic_timer_init(uint8_t vector, bool tsc_deadline) {
+    lapic_write(LAPIC_REG_TIMER_DCR, LAPIC_TIMER_DIV_1);
+    lapic_write(LAPIC_REG_LVT_TIMER, vector | (tsc_deadline ? LAPIC_TIMER_DEADLINE : 0));
+
+    // The mode switch must land before the first deadline write
+    mmio_mb();
+}
+
+void lapic_perf_init(uint8_t vector) {
+    if (!lapic_base) return;
+    lapic_write(LAPIC_REG_LVT_PERF, vector ? vector : LAPIC_LVT_MASKED);
+}
+
+void lapic_timer_arm(uint32_t count) {
+    lapic_write(LAPIC_REG_TIMER_ICR, count);
+}
+
+void lapic_timer_arm_deadline(uint64_t tsc) {
+    cpu_write_msr(IA32_TSC_DEADLINE_MSR, tsc);
+}
@@ -1,6 +1,7 @@
 #include "../../../include/kernel/arch/x86/cpu.h"
 #include "../../../include/video/vga.h"
 #include "../../../include/kernel/ports/ports.h"
+#include "../../../include/lib/math64.h"
 #include <string.h>
 #include <stddef.h>
 
@@ -81,7 +82,7 @@ static void print_feature(const char* name, bool present) {
 
 
 // Global CPU information
-static cpu_info_t global_cpu_info;
+cpu_info_t boot_cpu_info;
 static bool cpu_initialized = false;
 
 // Internal helper functions
@@ -178,7 +179,7 @@ static void detect_topology(cpu_info_t* info) {
     }
     
     // AMD topology extension
-    if (strcmp(info->identity.vendor_id, CPU_VENDOR_AMD) == 0 && info->features.topoext) {
+    if (strcmp(info->identity.vendor_id, CPU_VENDOR_AMD) == 0 && cpu_info_has(info, X86_FEATURE_TOPOEXT)) {
         cpuid(0x8000001E, 0, &eax, &ebx, &ecx, &edx);
         info->topology.core_id = eax & 0xFF;
         info->topology.smt_id = (eax >> 8) & 0xFF;
@@ -213,193 +214,42 @@ static void detect_topology(cpu_info_t* info) {
     }
 }
 
+// Keep each CPUID feature register whole: cpufeature.h names the bits
 static void detect_features(cpu_info_t* info) {
     uint32_t eax, ebx, ecx, edx;
-    
-    // Clear all features first
-    memset(&info->features, 0, sizeof(cpu_features_t));
-    
-    // Standard features (CPUID 1)
+    uint32_t* caps = info->capability;
+
+    memset(caps, 0, sizeof(info->capability));
+
     cpuid(1, 0, &eax, &ebx, &ecx, &edx);
-    
-    // EDX features
-    info->features.fpu = edx & (1 << 0);
-    info->features.vme = edx & (1 << 1);
-    info->features.de = edx & (1 << 2);
-    info->features.pse = edx & (1 << 3);
-    info->features.tsc = edx & (1 << 4);
-    info->features.msr = edx & (1 << 5);
-    info->features.pae = edx & (1 << 6);
-    info->features.mce = edx & (1 << 7);
-    info->features.cx8 = edx & (1 << 8);
-    info->features.apic = edx & (1 << 9);
-    info->features.sep = edx & (1 << 11);
-    info->features.mtrr = edx & (1 << 12);
-    info->features.pge = edx & (1 << 13);
-    info->features.mca = edx & (1 << 14);
-    info->features.cmov = edx & (1 << 15);
-    info->features.pat = edx & (1 << 16);
-    info->features.pse36 = edx & (1 << 17);
-    info->features.psn = edx & (1 << 18);
-    info->features.clfsh = edx & (1 << 19);
-    info->features.ds = edx & (1 << 21);
-    info->features.acpi = edx & (1 << 22);
-    info->features.mmx = edx & (1 << 23);
-    info->features.fxsr = edx & (1 << 24);
-    info->features.sse = edx & (1 << 25);
-    info->features.sse2 = edx & (1 << 26);
-    info->features.ss = edx & (1 << 27);
-    info->features.htt = edx & (1 << 28);
-    info->features.tm = edx & (1 << 29);
-    info->features.ia64 = edx & (1 << 30);
-    info->features.pbe = edx & (1 << 31);
-    
-    // ECX features
-    info->features.sse3 = ecx & (1 << 0);
-    info->features.pclmul = ecx & (1 << 1);
-    info->features.dtes64 = ecx & (1 << 2);
-    info->features.monitor = ecx & (1 << 3);
-    info->features.ds_cpl = ecx & (1 << 4);
-    info->features.vmx = ecx & (1 << 5);
-    info->features.smx = ecx & (1 << 6);
-    info->features.est = ecx & (1 << 7);
-    info->features.tm2 = ecx & (1 << 8);
-    info->features.ssse3 = ecx & (1 << 9);
-    info->features.cid = ecx & (1 << 10);
-    info->features.sdbg = ecx & (1 << 11);
-    info->features.fma = ecx & (1 << 12);
-    info->features.cx16 = ecx & (1 << 13);
-    info->features.xtpr = ecx & (1 << 14);
-    info->features.pdcm = ecx & (1 << 15);
-    info->features.pcid = ecx & (1 << 17);
-    info->features.dca = ecx & (1 << 18);
-    info->features.sse4_1 = ecx & (1 << 19);
-    info->features.sse4_2 = ecx & (1 << 20);
-    info->features.x2apic = ecx & (1 << 21);
-    info->features.movbe = ecx & (1 << 22);
-    info->features.popcnt = ecx & (1 << 23);
-    info->features.tsc_deadline = ecx & (1 << 24);
-    info->features.aes = ecx & (1 << 25);
-    info->features.xsave = ecx & (1 << 26);
-    info->features.osxsave = ecx & (1 << 27);
-    info->features.avx = ecx & (1 << 28);
-    info->features.f16c = ecx & (1 << 29);
-    info->features.rdrand = ecx & (1 << 30);
-    info->features.hypervisor = ecx & (1 << 31);
-    
-    // Extended features (CPUID 7)
-    cpuid(7, 0, &eax, &ebx, &ecx, &edx);
-    
-    // EBX features
-    info->features.fsgsbase = ebx & (1 << 0);
-    info->features.ia32_tsc_adjust = ebx & (1 << 1);
-    info->features.sgx = ebx & (1 << 2);
-    info->features.bmi1 = ebx & (1 << 3);
-    info->features.hle = ebx & (1 << 4);
-    info->features.avx2 = ebx & (1 << 5);
-    info->features.fdp_excptn_only = ebx & (1 << 6);
-    info->features.smep = ebx & (1 << 7);
-    info->features.bmi2 = ebx & (1 << 8);
-    info->features.erms = ebx & (1 << 9);
-    info->features.invpcid = ebx & (1 << 10);
-    info->features.rtm = ebx & (1 << 11);
-    info->features.pqm = ebx & (1 << 12);
-    info->features.dep_fpu_csds = ebx & (1 << 13);
-    info->features.mpx = ebx & (1 << 14);
-    info->features.pqe = ebx & (1 << 15);
-    info->features.avx512f = ebx & (1 << 16);
-    info->features.avx512dq = ebx & (1 << 17);
-    info->features.rdseed = ebx & (1 << 18);
-    info->features.adx = ebx & (1 << 19);
-    info->features.smap = ebx & (1 << 20);
-    info->features.avx512ifma = ebx & (1 << 21);
-    info->features.pcommit = ebx & (1 << 22);
-    info->features.clflushopt = ebx & (1 << 23);
-    info->features.clwb = ebx & (1 << 24);
-    info->features.intel_pt = ebx & (1 << 25);
-    info->features.avx512pf = ebx & (1 << 26);
-    info->features.avx512er = ebx & (1 << 27);
-    info->features.avx512cd = ebx & (1 << 28);
-    info->features.sha = ebx & (1 << 29);
-    info->features.avx512bw = ebx & (1 << 30);
-    info->features.avx512vl = ebx & (1 << 31);
-    
-    // ECX features
-    info->features.prefetchwt1 = ecx & (1 << 0);
-    info->features.avx512vbmi = ecx & (1 << 1);
-    info->features.umip = ecx & (1 << 2);
-    info->features.pku = ecx & (1 << 3);
-    info->features.ospke = ecx & (1 << 4);
-    info->features.waitpkg = ecx & (1 << 5);
-    info->features.avx512_vbmi2 = ecx & (1 << 6);
-    info->features.cet_ss = ecx & (1 << 7);
-    info->features.gfni = ecx & (1 << 8);
-    info->features.vaes = ecx & (1 << 9);
-    info->features.vpclmulqdq = ecx & (1 << 10);
-    info->features.avx512_vnni = ecx & (1 << 11);
-    info->features.avx512_bitalg = ecx & (1 << 12);
-    info->features.tme = ecx & (1 << 13);
-    info->features.avx512_vpopcntdq = ecx & (1 << 14);
-    info->features.la57 = ecx & (1 << 16);
-    info->features.rdpid = ecx & (1 << 22);
-    info->features.kl = ecx & (1 << 23);
-    info->features.bus_lock_detect = ecx & (1 << 24);
-    info->features.cldemote = ecx & (1 << 25);
-    info->features.movdiri = ecx & (1 << 27);
-    info->features.movdir64b = ecx & (1 << 28);
-    info->features.enqcmd = ecx & (1 << 29);
-    info->features.sgx_lc = ecx & (1 << 30);
-    info->features.pks = ecx & (1 << 31);
-    
-    // EDX features
-    info->features.mawau = (edx >> 17) & 0x1F;
-    
-    // AMD-specific features
-    cpuid(0x80000001, 0, &eax, &ebx, &ecx, &edx);
-    info->features.syscall = edx & (1 << 11);
-    info->features.mp = edx & (1 << 19);
-    info->features.nx = edx & (1 << 20);
-    info->features.mmxext = edx & (1 << 22);
-    info->features.fxsr_opt = edx & (1 << 25);
-    info->features.pdpe1gb = edx & (1 << 26);
-    info->features.rdtscp = edx & (1 << 27);
-    info->features.lm = edx & (1 << 29);
-    info->features._3dnowext = edx & (1 << 30);
-    info->features._3dnow = edx & (1 << 31);
-    
-    info->features.lahf_lm = ecx & (1 << 0);
-    info->features.cmp_legacy = ecx & (1 << 1);
-    info->features.svm = ecx & (1 << 2);
-    info->features.extapic = ecx & (1 << 3);
-    info->features.cr8_legacy = ecx & (1 << 4);
-    info->features.abm = ecx & (1 << 5);
-    info->features.sse4a = ecx & (1 << 6);
-    info->features.misalignsse = ecx & (1 << 7);
-    info->features._3dnowprefetch = ecx & (1 << 8);
-    info->features.osvw = ecx & (1 << 9);
-    info->features.ibs = ecx & (1 << 10);
-    info->features.xop = ecx & (1 << 11);
-    info->features.skinit = ecx & (1 << 12);
-    info->features.wdt = ecx & (1 << 13);
-    info->features.lwp = ecx & (1 << 15);
-    info->features.fma4 = ecx & (1 << 16);
-    info->features.tce = ecx & (1 << 17);
-    info->features.nodeid_msr = ecx & (1 << 19);
-    info->features.tbm = ecx & (1 << 21);
-    info->features.topoext = ecx & (1 << 22);
-    info->features.perfctr_core = ecx & (1 << 23);
-    info->features.perfctr_nb = ecx & (1 << 24);
-    info->features.dbx = ecx & (1 << 26);
-    info->features.perfctr_llc = ecx & (1 << 28);
-    info->features.mwaitx = ecx & (1 << 29);
-    info->features.hw_pstate = ecx & (1 << 31);
+    caps[CPUID_1_EDX] = edx;
+    caps[CPUID_1_ECX] = ecx;
+
+    // Asking for a leaf past the maximum returns the highest one instead
+    if (info->identity.max_cpuid >= 7) {
+        cpuid(7, 0, &eax, &ebx, &ecx, &edx);
+        caps[CPUID_7_0_EBX] = ebx;
+        caps[CPUID_7_0_ECX] = ecx;
+    }
+
+    if (info->identity.max_ext_cpuid >= 0x80000001) {
+        cpuid(0x80000001, 0, &eax, &ebx, &ecx, &edx);
+        caps[CPUID_8000_0001_EDX] = edx;
+        caps[CPUID_8000_0001_ECX] = ecx;
+    }
+
+    if (info->identity.max_ext_cpuid >= 0x80000007) {
+        cpuid(0x80000007, 0, &eax, &ebx, &ecx, &edx);
+        caps[CPUID_8000_0007_EDX] = edx;
+    }
 }
 
 static void detect_tsc_frequency(cpu_info_t* info) {
-    if (!info->features.tsc) {
+    if (!cpu_info_has(info, X86_FEATURE_TSC)) {
         info->tsc_frequency = 0;
         return;
     }
+    if (info->tsc_frequency) return;    // Already calibrated
     
     uint32_t eax, ebx, ecx, edx;
     cpuid(0x15, 0, &eax, &ebx, &ecx, &edx);
@@ -413,8 +263,7 @@ static void detect_tsc_frequency(cpu_info_t* info) {
             uint64_t bus_freq = 100000; // Default 100MHz
             info->tsc_frequency = bus_ratio * bus_freq;
         } else if (strcmp(info->identity.vendor_id, CPU_VENDOR_AMD) == 0) {
-            cpuid(0x80000007, 0, &eax, &ebx, &ecx, &edx);
-            if (edx & (1 << 8)) { // TSC invariant
+            if (cpu_info_has(info, X86_FEATURE_INVARIANT_TSC)) {
                 const char* brand = info->identity.brand_string;
                 const char* mhz = brand + strlen(brand) - 1;
                 
@@ -453,60 +302,60 @@ static void detect_tsc_frequency(cpu_info_t* info) {
 // Public API Implementation
 
 void cpu_early_init(void) {
-    memset(&global_cpu_info, 0, sizeof(cpu_info_t));
+    memset(&boot_cpu_info, 0, sizeof(cpu_info_t));
     
     // Basic CPU identification
     uint32_t eax, ebx, ecx, edx;
     cpuid(0, 0, &eax, &ebx, &ecx, &edx);
     
-    global_cpu_info.identity.max_cpuid = eax;
-    *((uint32_t*)&global_cpu_info.identity.vendor_id[0]) = ebx;
-    *((uint32_t*)&global_cpu_info.identity.vendor_id[4]) = edx;
-    *((uint32_t*)&global_cpu_info.identity.vendor_id[8]) = ecx;
-    global_cpu_info.identity.vendor_id[12] = '\0';
+    boot_cpu_info.identity.max_cpuid = eax;
+    *((uint32_t*)&boot_cpu_info.identity.vendor_id[0]) = ebx;
+    *((uint32_t*)&boot_cpu_info.identity.vendor_id[4]) = edx;
+    *((uint32_t*)&boot_cpu_info.identity.vendor_id[8]) = ecx;
+    boot_cpu_info.identity.vendor_id[12] = '\0';
     
     // Get processor info
     cpuid(1, 0, &eax, &ebx, &ecx, &edx);
-    global_cpu_info.identity.stepping = eax & 0xF;
-    global_cpu_info.identity.model = (eax >> 4) & 0xF;
-    global_cpu_info.identity.family = (eax >> 8) & 0xF;
+    boot_cpu_info.identity.stepping = eax & 0xF;
+    boot_cpu_info.identity.model = (eax >> 4) & 0xF;
+    boot_cpu_info.identity.family = (eax >> 8) & 0xF;
     
     // Extended model/family for Intel
-    if (global_cpu_info.identity.family == 0xF) {
-        global_cpu_info.identity.model |= ((eax >> 16) & 0xF) << 4;
-        global_cpu_info.identity.family += ((eax >> 20) & 0xFF);
+    if (boot_cpu_info.identity.family == 0xF) {
+        boot_cpu_info.identity.model |= ((eax >> 16) & 0xF) << 4;
+        boot_cpu_info.identity.family += ((eax >> 20) & 0xFF);
     }
     
-    global_cpu_info.apic_id = (ebx >> 24) & 0xFF;
+    boot_cpu_info.apic_id = (ebx >> 24) & 0xFF;
     
     // Get brand string if available
     cpuid(0x80000000, 0, &eax, &ebx, &ecx, &edx);
-    global_cpu_info.identity.max_ext_cpuid = eax;
+    boot_cpu_info.identity.max_ext_cpuid = eax;
     
     if (eax >= 0x80000004) {
         cpuid(0x80000002, 0, 
-              (uint32_t*)&global_cpu_info.identity.brand_string[0],
-              (uint32_t*)&global_cpu_info.identity.brand_string[4],
-              (uint32_t*)&global_cpu_info.identity.brand_string[8],
-              (uint32_t*)&global_cpu_info.identity.brand_string[12]);
+              (uint32_t*)&boot_cpu_info.identity.brand_string[0],
+              (uint32_t*)&boot_cpu_info.identity.brand_string[4],
+              (uint32_t*)&boot_cpu_info.identity.brand_string[8],
+              (uint32_t*)&boot_cpu_info.identity.brand_string[12]);
         cpuid(0x80000003, 0, 
-              (uint32_t*)&global_cpu_info.identity.brand_string[16],
-              (uint32_t*)&global_cpu_info.identity.brand_string[20],
-              (uint32_t*)&global_cpu_info.identity.brand_string[24],
-              (uint32_t*)&global_cpu_info.identity.brand_string[28]);
+              (uint32_t*)&boot_cpu_info.identity.brand_string[16],
+              (uint32_t*)&boot_cpu_info.identity.brand_string[20],
+              (uint32_t*)&boot_cpu_info.identity.brand_string[24],
+              (uint32_t*)&boot_cpu_info.identity.brand_string[28]);
         cpuid(0x80000004, 0, 
-              (uint32_t*)&global_cpu_info.identity.brand_string[32],
-              (uint32_t*)&global_cpu_info.identity.brand_string[36],
-              (uint32_t*)&global_cpu_info.identity.brand_string[40],
-              (uint32_t*)&global_cpu_info.identity.brand_string[44]);
-        global_cpu_info.identity.brand_string[48] = '\0';
+              (uint32_t*)&boot_cpu_info.identity.brand_string[32],
+              (uint32_t*)&boot_cpu_info.identity.brand_string[36],
+              (uint32_t*)&boot_cpu_info.identity.brand_string[40],
+              (uint32_t*)&boot_cpu_info.identity.brand_string[44]);
+        boot_cpu_info.identity.brand_string[48] = '\0';
     }
     
     // Early feature detection
-    detect_features(&global_cpu_info);
+    detect_features(&boot_cpu_info);
     
     // Enable required features
-    cpu_enable_features(&global_cpu_info);
+    cpu_enable_features(&boot_cpu_info);
     
     cpu_initialized = true;
 }
@@ -515,50 +364,35 @@ void cpu_late_init(void) {
     if (!cpu_initialized) return;
     
     // Detect cache topology
-    detect_caches(&global_cpu_info);
+    detect_caches(&boot_cpu_info);
     
     // Detect CPU topology
-    detect_topology(&global_cpu_info);
+    detect_topology(&boot_cpu_info);
     
     // Detect TSC frequency
-    detect_tsc_frequency(&global_cpu_info);
+    detect_tsc_frequency(&boot_cpu_info);
     
     // Get address sizes
     uint32_t eax, ebx, ecx, edx;
     cpuid(0x80000008, 0, &eax, &ebx, &ecx, &edx);
-    global_cpu_info.max_phy_addr_bits = eax & 0xFF;
-    global_cpu_info.max_lin_addr_bits = (eax >> 8) & 0xFF;
+    boot_cpu_info.max_phy_addr_bits = eax & 0xFF;
+    boot_cpu_info.max_lin_addr_bits = (eax >> 8) & 0xFF;
+
+    // Features are final: pick the instruction variants to run with
+    apply_alternatives();
 }
 
-void cpu_identify(cpu_info_t* info) {
-    if (info) {
-        memcpy(info, &global_cpu_info, sizeof(cpu_info_t));
-    }
+const cpu_info_t* cpu_identify(void) {
+    return &boot_cpu_info;
 }
 
 const char* cpu_vendor_name(const cpu_info_t* info) {
-    if (!info) info = &global_cpu_info;
+    if (!info) info = &boot_cpu_info;
     return info->identity.vendor_id;
 }
 
-bool cpu_has_feature(const cpu_info_t* info, const char* feature_name) {
-    if (!info) info = &global_cpu_info;
-    
-    // This is a simplified version - a real implementation would have a full mapping
-    // of feature names to feature flags. Here's just a few examples:
-    if (strcmp(feature_name, "sse") == 0) return info->features.sse;
-    if (strcmp(feature_name, "sse2") == 0) return info->features.sse2;
-    if (strcmp(feature_name, "avx") == 0) return info->features.avx;
-    if (strcmp(feature_name, "avx2") == 0) return info->features.avx2;
-    if (strcmp(feature_name, "aes") == 0) return info->features.aes;
-    if (strcmp(feature_name, "vmx") == 0) return info->features.vmx;
-    if (strcmp(feature_name, "svm") == 0) return info->features.svm;
-    
-    return false;
-}
-
 void cpu_detect_topology(cpu_info_t* info) {
-    if (!info) info = &global_cpu_info;
+    if (!info) info = &boot_cpu_info;
     detect_topology(info);
 }
 
@@ -573,28 +407,29 @@ uint32_t cpu_count_logical(void) {
 }
 
 void cpu_enable_features(cpu_info_t* info) {
-    if (!info) info = &global_cpu_info;
+    if (!info) info = &boot_cpu_info;
     
     uint32_t cr0 = read_cr0();
     cr0 |= (1 << 5);  // Set NE bit
     write_cr0(cr0);
     
     uint32_t cr4 = read_cr4();
-    if (info->features.sse || info->features.sse2 || info->features.sse3) {
+    if (cpu_info_has(info, X86_FEATURE_SSE) || cpu_info_has(info, X86_FEATURE_SSE2) ||
+        cpu_info_has(info, X86_FEATURE_SSE3)) {
         cr4 |= (1 << 9);   // OSFXSR
         cr4 |= (1 << 10);  // OSXMMEXCPT
     }
-    if (info->features.pge) cr4 |= (1 << 7);
-    if (info->features.smep) cr4 |= (1 << 20);
-    if (info->features.smap) cr4 |= (1 << 21);
-    if (info->features.umip) cr4 |= (1 << 11);
-    if (info->features.fsgsbase) cr4 |= (1 << 16);
+    if (cpu_info_has(info, X86_FEATURE_PGE)) cr4 |= (1 << 7);
+    if (cpu_info_has(info, X86_FEATURE_SMEP)) cr4 |= (1 << 20);
+    if (cpu_info_has(info, X86_FEATURE_SMAP)) cr4 |= (1 << 21);
+    if (cpu_info_has(info, X86_FEATURE_UMIP)) cr4 |= (1 << 11);
+    if (cpu_info_has(info, X86_FEATURE_FSGSBASE)) cr4 |= (1 << 16);
     write_cr4(cr4);
     
     // EFER is still MSR but we'll use 32-bit parts
     uint32_t efer_lo, efer_hi;
     asm volatile("rdmsr" : "=a"(efer_lo), "=d"(efer_hi) : "c"(0xC0000080));
-    if (info->features.nx) efer_lo |= (1 << 11);
+    if (cpu_info_has(info, X86_FEATURE_NX)) efer_lo |= (1 << 11);
     asm volatile("wrmsr" : : "a"(efer_lo), "d"(efer_hi), "c"(0xC0000080));
 }
 
@@ -677,10 +512,20 @@ uint64_t cpu_rdtscp(uint32_t* aux) {
     return ((uint64_t)high << 32) | low;
 }
 
-void cpu_calibrate_tsc(void) {
-    // TODO: Implement proper TSC calibration
-    // This would typically use PIT or HPET to measure real time
-    // and compare with TSC counts
+uint64_t cpu_tsc_to_ns(uint64_t cycles) {
+    uint32_t khz = boot_cpu_info.tsc_frequency;
+    if (khz == 0) khz = 2000000; // Same 2GHz fallback as detect_tsc_frequency
+
+    // Split the division so cycles * 10^6 cannot overflow
+    uint32_t rem;
+    uint64_t ms = div_u64_rem(cycles, khz, &rem);
+    return ms * 1000000ULL + div_u64((uint64_t)rem * 1000000ULL, khz);
+}
+
+// A measured rate (see sys/arch/x86/tsc.c) beats any of the guesses in
+// detect_tsc_frequency, which then leaves it alone
+void cpu_set_tsc_frequency(uint32_t khz) {
+    boot_cpu_info.tsc_frequency = khz;
 }
 
 void cpu_pause(void) {
@@ -742,7 +587,7 @@ void cpu_breakpoint(void) {
 }
 
 void cpu_debug_dump(const cpu_info_t* info) {
-    if (!info) info = &global_cpu_info;
+    if (!info) info = &boot_cpu_info;
     
     // TODO: Implement detailed debug dump of CPU information
     // This would print all detected features, topology, etc.
@@ -766,11 +611,11 @@ bool cpu_interrupts_enabled(void) {
 }
 
 bool cpu_vmx_supported(void) {
-    return global_cpu_info.features.vmx;
+    return cpu_has(X86_FEATURE_VMX);
 }
 
 bool cpu_svm_supported(void) {
-    return global_cpu_info.features.svm;
+    return cpu_has(X86_FEATURE_SVM);
 }
 
 void cpu_vmx_on(void) {
@@ -825,20 +670,21 @@ void cpu_clflush(const void* addr) {
     asm volatile("clflush (%0)" : : "r"(addr));
 }
 
+// Both fall back to clflush, with a DS prefix so the lengths match and
+// the site is patched without padding
+
 void cpu_clwb(const void* addr) {
-    if (global_cpu_info.features.clwb) {
-        asm volatile(".byte 0x66, 0x0F, 0xAE, 0x30" : : "r"(addr));
-    }
+    asm volatile(ALTERNATIVE(".byte 0x3e; clflush (%0)", "clwb (%0)", X86_FEATURE_CLWB)
+                 : : "r"(addr) : "memory");
 }
 
 void cpu_clflushopt(const void* addr) {
-    if (global_cpu_info.features.clflushopt) {
-        asm volatile(".byte 0x66, 0x0F, 0xAE, 0x38" : : "r"(addr));
-    }
+    asm volatile(ALTERNATIVE(".byte 0x3e; clflush (%0)", "clflushopt (%0)", X86_FEATURE_CLFLUSHOPT)
+                 : : "r"(addr) : "memory");
 }
 
 void cpu_debug_dump_ex(const cpu_info_t* info, uint32_t flags) {
-    if (!info) info = &global_cpu_info;
+    if (!info) info = &boot_cpu_info;
     
     // Save original color
     uint8_t original_color = vga_get_color();
@@ -962,73 +808,74 @@ void cpu_debug_dump_ex(const cpu_info_t* info, uint32_t flags) {
         
         vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
         vga_puts("Feature flags [");
-        vga_putdec(sizeof(cpu_features_t)*8, 0);
+        vga_putdec(NCAPINTS * 32, 0);
         vga_puts(" total]:\n");
         
         // Feature print helper
-        #define PRINT_FEATURE(name) do { \
+        #define PRINT_FEATURE(name, bit) do { \
+            bool present = cpu_info_has(info, X86_FEATURE_##bit); \
             vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK); \
             vga_puts("  • "); \
-            vga_set_color(info->features.name ? VGA_COLOR_LIGHT_GREEN : VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK); \
+            vga_set_color(present ? VGA_COLOR_LIGHT_GREEN : VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK); \
             vga_puts(#name); \
-            if(!info->features.name) vga_puts(" (unavailable)"); \
+            if(!present) vga_puts(" (unavailable)"); \
             vga_puts("\n"); \
         } while(0)
 
         // Basic features
         vga_set_color(VGA_COLOR_LIGHT_MAGENTA, VGA_COLOR_BLACK);
         vga_puts("\n[ Basic Features ]\n");
-        PRINT_FEATURE(fpu);
-        PRINT_FEATURE(vme);
-        PRINT_FEATURE(de);
-        PRINT_FEATURE(pse);
+        PRINT_FEATURE(fpu, FPU);
+        PRINT_FEATURE(vme, VME);
+        PRINT_FEATURE(de, DE);
+        PRINT_FEATURE(pse, PSE);
         /* ... continue with all features ... */
-        PRINT_FEATURE(sse);
-        PRINT_FEATURE(sse2);
-        PRINT_FEATURE(sse3);
-        PRINT_FEATURE(ssse3);
-        PRINT_FEATURE(sse4_1);
-        PRINT_FEATURE(sse4_2);
-        PRINT_FEATURE(avx);
-        PRINT_FEATURE(avx2);
+        PRINT_FEATURE(sse, SSE);
+        PRINT_FEATURE(sse2, SSE2);
+        PRINT_FEATURE(sse3, SSE3);
+        PRINT_FEATURE(ssse3, SSSE3);
+        PRINT_FEATURE(sse4_1, SSE4_1);
+        PRINT_FEATURE(sse4_2, SSE4_2);
+        PRINT_FEATURE(avx, AVX);
+        PRINT_FEATURE(avx2, AVX2);
 
         // Virtualization
         vga_set_color(VGA_COLOR_LIGHT_MAGENTA, VGA_COLOR_BLACK);
         vga_puts("\n[ Virtualization ]\n");
-        PRINT_FEATURE(vmx);
-        PRINT_FEATURE(svm);
+        PRINT_FEATURE(vmx, VMX);
+        PRINT_FEATURE(svm, SVM);
 
         // Security
         vga_set_color(VGA_COLOR_LIGHT_MAGENTA, VGA_COLOR_BLACK);
         vga_puts("\n[ Security Features ]\n");
-        PRINT_FEATURE(smep);
-        PRINT_FEATURE(smap);
-        PRINT_FEATURE(umip);
+        PRINT_FEATURE(smep, SMEP);
+        PRINT_FEATURE(smap, SMAP);
+        PRINT_FEATURE(umip, UMIP);
 
         // Advanced
         vga_set_color(VGA_COLOR_LIGHT_MAGENTA, VGA_COLOR_BLACK);
         vga_puts("\n[ Advanced Features ]\n");
-        PRINT_FEATURE(avx512f);
-        PRINT_FEATURE(avx512dq);
-        PRINT_FEATURE(avx512vl);
-        PRINT_FEATURE(avx512bw);
+        PRINT_FEATURE(avx512f, AVX512F);
+        PRINT_FEATURE(avx512dq, AVX512DQ);
+        PRINT_FEATURE(avx512vl, AVX512VL);
+        PRINT_FEATURE(avx512bw, AVX512BW);
 
         // AMD-specific
         if(strcmp(info->identity.vendor_id, CPU_VENDOR_AMD) == 0) {
             vga_set_color(VGA_COLOR_LIGHT_MAGENTA, VGA_COLOR_BLACK);
             vga_puts("\n[ AMD Features ]\n");
-            PRINT_FEATURE(svm);
-            PRINT_FEATURE(topoext);
-            PRINT_FEATURE(mwaitx);
+            PRINT_FEATURE(svm, SVM);
+            PRINT_FEATURE(topoext, TOPOEXT);
+            PRINT_FEATURE(mwaitx, MWAITX);
         }
 
         // Intel-specific
         if(strcmp(info->identity.vendor_id, CPU_VENDOR_INTEL) == 0) {
             vga_set_color(VGA_COLOR_LIGHT_MAGENTA, VGA_COLOR_BLACK);
             vga_puts("\n[ Intel Features ]\n");
-            PRINT_FEATURE(vmx);
-            PRINT_FEATURE(sgx);
-            PRINT_FEATURE(intel_pt);
+            PRINT_FEATURE(vmx, VMX);
+            PRINT_FEATURE(sgx, SGX);
+            PRINT_FEATURE(intel_pt, INTEL_PT);
         }
 
         #undef PRINT_FEATURE
@@ -0,0 +1,58 @@
+/**
+ * Global Descriptor Table - Bunix OS
+ *
+ * Replaces whatever GDT the bootloader left behind with a flat
+ * ring 0 code and data segment.
+ */
+
+#include "../../../include/kernel/arch/x86/gdt.h"
+
+struct gdt_entry {
+    uint16_t limit_low;
+    uint16_t base_low;
+    uint8_t  base_mid;
+    uint8_t  access;
+    uint8_t  granularity;
+    uint8_t  base_high;
+} __attribute__((packed));
+
+struct gdt_ptr {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed));
+
+static struct gdt_entry gdt[3] __attribute__((aligned(8)));
+static struct gdt_ptr gdt_descriptor;
+
+static void gdt_set_entry(int index, uint8_t access) {
+    gdt[index].limit_low = 0xFFFF;
+    gdt[index].base_low = 0;
+    gdt[index].base_mid = 0;
+    gdt[index].access = access;
+    gdt[index].granularity = 0xCF;   // 4K granularity, 32-bit, limit 0xFFFFF
+    gdt[index].base_high = 0;
+}
+
+void gdt_init(void) {
+    gdt[0] = (struct gdt_entry){0};
+    gdt_set_entry(1, 0x9A);          // Present, ring 0, code, readable
+    gdt_set_entry(2, 0x92);          // Present, ring 0, data, writable
+
+    gdt_descriptor.limit = sizeof(gdt) - 1;
+    gdt_descriptor.base = (uint32_t)&gdt;
+
+    __asm__ volatile (
+        "lgdt %0\n\t"
+        "ljmp %1, $1f\n"
+        "1:\n\t"
+        "mov %2, %%ax\n\t"
+        "mov %%ax, %%ds\n\t"
+        "mov %%ax, %%es\n\t"
+        "mov %%ax, %%fs\n\t"
+        "mov %%ax, %%gs\n\t"
+        "mov %%ax, %%ss\n\t"
+        :
+        : "m"(gdt_descriptor), "i"(GDT_KERNEL_CODE), "i"(GDT_KERNEL_DATA)
+        : "eax", "memory"
+    );
+}
@@ -0,0 +1,57 @@
+/**
+ * HPET clock source - Bunix OS
+ *
+ * The main counter of the High Precision Event Timer, found through the
+ * ACPI "HPET" table. Only its low 32 bits are read: one uncached MMIO
+ * load, and at the usual 10-100 MHz that is still tens of seconds
+ * before a wrap. None of the comparators are used.
+ */
+
+#include "../../../include/kernel/arch/x86/timer.h"
+#include "../../../include/kernel/arch/x86/acpi.h"
+#include "../../../include/kernel/ports/mmio.h"
+#include "../../../include/lib/math64.h"
+#include "../../../include/lib/errno.h"
+
+#define HPET_TABLE_ADDRESS  44        // Base address field of the table
+
+#define HPET_REG_PERIOD     0x004     // High half of GCAP_ID: tick in fs
+#define HPET_REG_CONFIG     0x010
+#define HPET_REG_COUNTER    0x0F0
+
+#define HPET_CONFIG_ENABLE  (1 << 0)
+
+#define HPET_MAX_PERIOD_FS  100000000 // Spec limit: 100 ns
+#define FS_PER_SEC          1000000000000000ull
+
+static uintptr_t hpet_base;
+
+static uint64_t hpet_read(void) {
+    return mmio_read32(hpet_base + HPET_REG_COUNTER);
+}
+
+static clocksource_t hpet_clocksource = {
+    .name = "hpet",
+    .read = hpet_read,
+    .mask = 0xFFFFFFFF,
+    .rating = 250,
+    .flags = CLOCK_SOURCE_WATCHDOG,
+};
+
+int hpet_clocksource_init(void) {
+    const acpi_header_t* table = acpi_find_table("HPET");
+    if (!table) return -ENODEV;
+
+    uint64_t base = *(const uint64_t*)((const uint8_t*)table + HPET_TABLE_ADDRESS);
+    if (!base || base >> 32) return -ENODEV;
+    hpet_base = (uintptr_t)base;
+
+    uint32_t period = mmio_read32(hpet_base + HPET_REG_PERIOD);
+    if (!period || period > HPET_MAX_PERIOD_FS) return -ENODEV;
+    hpet_clocksource.freq_hz = div_u64(FS_PER_SEC, period);
+
+    uint32_t config = mmio_read32(hpet_base + HPET_REG_CONFIG);
+    if (!(config & HPET_CONFIG_ENABLE)) mmio_write32(hpet_base + HPET_REG_CONFIG, config | HPET_CONFIG_ENABLE);
+
+    return clocksource_register(&hpet_clocksource);
+}
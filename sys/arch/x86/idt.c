@@ -0,0 +1,150 @@
+/**
+ * Interrupt Descriptor Table - Bunix OS
+ *
+ * Every vector gets a small assembly stub that normalises the stack to an
+ * interrupt_frame_t and calls interrupt_dispatch(), which looks up the C
+ * handler. Exceptions without a handler panic with the faulting address.
+ */
+
+#include "../../../include/kernel/arch/x86/idt.h"
+#include "../../../include/kernel/arch/x86/gdt.h"
+#include "../../../include/kernel/panic/panic.h"
+#include "../../../include/kernel/panic/ksym.h"
+#include "../../../include/video/vga.h"
+
+#define IDT_GATE_INTERRUPT 0x8E  // Present, ring 0, 32-bit interrupt gate
+#define IDT_STUB_SIZE      16
+
+struct idt_entry {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t  zero;
+    uint8_t  type_attr;
+    uint16_t offset_high;
+} __attribute__((packed));
+
+struct idt_ptr {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed));
+
+static struct idt_entry idt[IDT_ENTRIES] __attribute__((aligned(8)));
+static struct idt_ptr idt_descriptor;
+static interrupt_handler_t handlers[IDT_ENTRIES];
+static interrupt_frame_t* current_frame;
+
+void interrupt_dispatch(interrupt_frame_t* frame);
+
+// One fixed-size stub per vector. Vectors where the CPU pushes an error
+// code skip the dummy push so every frame has the same layout.
+__asm__ (
+    ".section .text\n"
+    ".align 16\n"
+    ".global isr_stub_table\n"
+    "isr_stub_table:\n"
+    ".set vec, 0\n"
+    ".rept 256\n"
+    "  .align 16\n"
+    "  .if !(vec == 8 || (vec >= 10 && vec <= 14) || vec == 17 || vec == 21 || vec == 29 || vec == 30)\n"
+    "    pushl $0\n"
+    "  .endif\n"
+    "  pushl $vec\n"
+    "  jmp isr_common\n"
+    "  .set vec, vec + 1\n"
+    ".endr\n"
+    "isr_common:\n"
+    "  pusha\n"
+    "  cld\n"
+    "  push %esp\n"
+    "  call interrupt_dispatch\n"
+    "  add $4, %esp\n"
+    "  popa\n"
+    "  add $8, %esp\n"
+    "  iret\n"
+);
+
+extern char isr_stub_table[];
+
+static const char* const exception_names[IDT_EXCEPTIONS] = {
+    "Divide error", "Debug", "NMI", "Breakpoint", "Overflow",
+    "BOUND range exceeded", "Invalid opcode", "Device not available",
+    "Double fault", "Coprocessor segment overrun", "Invalid TSS",
+    "Segment not present", "Stack-segment fault", "General protection fault",
+    "Page fault", "Reserved", "x87 floating-point error", "Alignment check",
+    "Machine check", "SIMD floating-point error", "Virtualization exception",
+    "Control protection exception", "Reserved", "Reserved", "Reserved",
+    "Reserved", "Reserved", "Reserved", "Hypervisor injection exception",
+    "VMM communication exception", "Security exception", "Reserved"
+};
+
+static void unhandled_exception(interrupt_frame_t* frame) {
+    vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_RED);
+    vga_puts("\nException ");
+    vga_putdec(frame->vector, 0);
+    vga_puts(": ");
+    vga_puts(exception_names[frame->vector]);
+    vga_puts(" at EIP ");
+    vga_puthex(frame->eip);
+    ksym_t sym;
+    if (ksym_lookup(frame->eip, &sym)) {
+        vga_puts(" (");
+        vga_puts(sym.name);
+        vga_puts(")");
+    }
+    vga_puts(" error ");
+    vga_puthex(frame->err_code);
+    vga_puts("\n");
+    panic(exception_names[frame->vector]);
+}
+
+void interrupt_dispatch(interrupt_frame_t* frame) {
+    interrupt_handler_t handler = handlers[frame->vector];
+    interrupt_frame_t* outer = current_frame;
+
+    current_frame = frame;
+    if (handler) {
+        handler(frame);
+    } else if (frame->vector < IDT_EXCEPTIONS) {
+        unhandled_exception(frame);
+    }
+    // Stray device vectors are ignored
+    current_frame = outer;
+}
+
+interrupt_frame_t* idt_current_frame(void) {
+    return current_frame;
+}
+
+static void idt_set_gate(uint8_t vector, uint32_t offset) {
+    idt[vector].offset_low = offset & 0xFFFF;
+    idt[vector].selector = GDT_KERNEL_CODE;
+    idt[vector].zero = 0;
+    idt[vector].type_attr = IDT_GATE_INTERRUPT;
+    idt[vector].offset_high = (offset >> 16) & 0xFFFF;
+}
+
+void idt_init(void) {
+    for (int i = 0; i < IDT_ENTRIES; i++) {
+        handlers[i] = NULL;
+        idt_set_gate(i, (uint32_t)isr_stub_table + i * IDT_STUB_SIZE);
+    }
+
+    idt_descriptor.limit = sizeof(idt) - 1;
+    idt_descriptor.base = (uint32_t)&idt;
+    __asm__ volatile ("lidt %0" : : "m"(idt_descriptor));
+}
+
+void idt_set_handler(uint8_t vector, interrupt_handler_t handler) {
+    handlers[vector] = handler;
+}
+
+interrupt_handler_t idt_get_handler(uint8_t vector) {
+    return handlers[vector];
+}
+
+uint8_t idt_alloc_vector(uint8_t first) {
+    for (int v = first; v < IDT_ENTRIES; v++) {
+        if (!handlers[v]) return (uint8_t)v;
+    }
+    return 0;
+}
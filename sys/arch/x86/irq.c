@@ -0,0 +1,145 @@
+/**
+ * 8259 PIC interrupt routing - Bunix OS
+ *
+ * Remaps both PICs to IRQ_BASE_VECTOR, keeps every line masked until a
+ * driver registers for it and fans each line out to its handlers.
+ */
+
+#include "../../../include/kernel/arch/x86/irq.h"
+#include "../../../include/kernel/arch/x86/idt.h"
+#include "../../../include/kernel/ports/ports.h"
+#include "../../../include/lib/errno.h"
+
+#define PIC1_COMMAND 0x20
+#define PIC1_DATA    0x21
+#define PIC2_COMMAND 0xA0
+#define PIC2_DATA    0xA1
+
+#define PIC_EOI      0x20
+#define PIC_READ_ISR 0x0B
+#define ICW1_INIT    0x11    // Edge triggered, cascade, ICW4 follows
+#define ICW4_8086    0x01
+
+struct irq_action {
+    irq_handler_t handler;
+    void* ctx;
+};
+
+static struct irq_action actions[IRQ_LINES][IRQ_MAX_SHARED];
+static uint32_t irq_counts[IRQ_LINES];
+static uint32_t spurious_count;
+static uint16_t irq_mask_bits = 0xFFFF;
+
+static void pic_write_mask(void) {
+    outb(PIC1_DATA, irq_mask_bits & 0xFF);
+    outb(PIC2_DATA, irq_mask_bits >> 8);
+}
+
+static uint16_t pic_read_isr(void) {
+    outb(PIC1_COMMAND, PIC_READ_ISR);
+    outb(PIC2_COMMAND, PIC_READ_ISR);
+    return inb(PIC1_COMMAND) | (inb(PIC2_COMMAND) << 8);
+}
+
+static void pic_send_eoi(uint8_t irq) {
+    if (irq >= 8) outb(PIC2_COMMAND, PIC_EOI);
+    outb(PIC1_COMMAND, PIC_EOI);
+}
+
+static void irq_dispatch(interrupt_frame_t* frame) {
+    uint8_t irq = frame->vector - IRQ_BASE_VECTOR;
+
+    // IRQ 7 and 15 fire spuriously when a request is withdrawn before the
+    // CPU acknowledges it; the ISR bit tells the two apart
+    if (irq == 7 || irq == 15) {
+        if (!(pic_read_isr() & (1 << irq))) {
+            spurious_count++;
+            if (irq == 15) outb(PIC1_COMMAND, PIC_EOI);
+            return;
+        }
+    }
+
+    irq_counts[irq]++;
+    for (int i = 0; i < IRQ_MAX_SHARED; i++) {
+        if (actions[irq][i].handler) actions[irq][i].handler(actions[irq][i].ctx);
+    }
+    pic_send_eoi(irq);
+}
+
+void irq_init(void) {
+    // ICW1-4: start init, vector offsets, cascade wiring, 8086 mode
+    outb(PIC1_COMMAND, ICW1_INIT);
+    outb(PIC2_COMMAND, ICW1_INIT);
+    outb(PIC1_DATA, IRQ_BASE_VECTOR);
+    outb(PIC2_DATA, IRQ_BASE_VECTOR + 8);
+    outb(PIC1_DATA, 1 << IRQ_CASCADE);
+    outb(PIC2_DATA, 2);
+    outb(PIC1_DATA, ICW4_8086);
+    outb(PIC2_DATA, ICW4_8086);
+
+    for (int irq = 0; irq < IRQ_LINES; irq++) {
+        for (int i = 0; i < IRQ_MAX_SHARED; i++) actions[irq][i].handler = NULL;
+        irq_counts[irq] = 0;
+        idt_set_handler(IRQ_BASE_VECTOR + irq, irq_dispatch);
+    }
+    spurious_count = 0;
+
+    // Everything masked except the cascade to the slave PIC
+    irq_mask_bits = 0xFFFF & ~(1 << IRQ_CASCADE);
+    pic_write_mask();
+}
+
+int irq_register(uint8_t irq, irq_handler_t handler, void* ctx) {
+    if (irq >= IRQ_LINES || !handler) return -EINVAL;
+
+    uint32_t flags = irq_save();
+    for (int i = 0; i < IRQ_MAX_SHARED; i++) {
+        if (!actions[irq][i].handler) {
+            actions[irq][i].handler = handler;
+            actions[irq][i].ctx = ctx;
+            irq_restore(flags);
+            irq_unmask(irq);
+            return 0;
+        }
+    }
+    irq_restore(flags);
+    return -EBUSY;
+}
+
+void irq_unregister(uint8_t irq, irq_handler_t handler, void* ctx) {
+    if (irq >= IRQ_LINES) return;
+
+    uint32_t flags = irq_save();
+    bool in_use = false;
+    for (int i = 0; i < IRQ_MAX_SHARED; i++) {
+        if (actions[irq][i].handler == handler && actions[irq][i].ctx == ctx) {
+            actions[irq][i].handler = NULL;
+            actions[irq][i].ctx = NULL;
+        }
+        if (actions[irq][i].handler) in_use = true;
+    }
+    if (!in_use && irq != IRQ_CASCADE) irq_mask(irq);
+    irq_restore(flags);
+}
+
+void irq_mask(uint8_t irq) {
+    uint32_t flags = irq_save();
+    irq_mask_bits |= (1 << irq);
+    pic_write_mask();
+    irq_restore(flags);
+}
+
+void irq_unmask(uint8_t irq) {
+    uint32_t flags = irq_save();
+    irq_mask_bits &= ~(1 << irq);
+    pic_write_mask();
+    irq_restore(flags);
+}
+
+uint32_t irq_get_count(uint8_t irq) {
+    return irq < IRQ_LINES ? irq_counts[irq] : 0;
+}
+
+uint32_t irq_get_spurious_count(void) {
+    return spurious_count;
+}
@@ -0,0 +1,52 @@
+/**
+ * PIT clock source - Bunix OS
+ *
+ * Channel 2 is the one channel whose gate software controls and which
+ * raises no interrupt, so it runs free in rate-generator mode with the
+ * largest reload. It counts down; the read inverts it. Sixteen bits at
+ * 1.19 MHz wrap every 55 ms and a read is three port accesses, so it is
+ * only a last resort and the reference for calibrating everything else
+ * on machines without ACPI.
+ */
+
+#include "../../../include/kernel/arch/x86/timer.h"
+#include "../../../include/kernel/arch/x86/irq.h"
+#include "../../../include/kernel/ports/ports.h"
+
+#define PIT_CH2_DATA      0x42
+#define PIT_COMMAND       0x43
+#define PIT_SPEAKER_PORT  0x61
+
+#define PIT_SEL_CH2       (2 << 6)
+#define PIT_ACCESS_LOHI   (3 << 4)
+#define PIT_MODE_RATE     (2 << 1)
+#define PIT_LATCH_CH2     (2 << 6)   // Access bits 0: counter latch
+
+#define SPEAKER_GATE2     0x01
+#define SPEAKER_DATA      0x02
+
+static uint64_t pit_read(void) {
+    uint32_t flags = irq_save();
+    outb(PIT_COMMAND, PIT_LATCH_CH2);
+    uint8_t lo = inb(PIT_CH2_DATA);
+    uint8_t hi = inb(PIT_CH2_DATA);
+    irq_restore(flags);
+    return (uint16_t)(0 - (lo | (hi << 8)));
+}
+
+static clocksource_t pit_clocksource = {
+    .name = "pit",
+    .read = pit_read,
+    .mask = 0xFFFF,
+    .freq_hz = PIT_FREQ_HZ,
+    .rating = 110,
+};
+
+int pit_clocksource_init(void) {
+    // Gate on, speaker output off
+    outb(PIT_SPEAKER_PORT, (inb(PIT_SPEAKER_PORT) & ~SPEAKER_DATA) | SPEAKER_GATE2);
+    outb(PIT_COMMAND, PIT_SEL_CH2 | PIT_ACCESS_LOHI | PIT_MODE_RATE);
+    outb(PIT_CH2_DATA, 0);          // Reload 0 means 65536
+    outb(PIT_CH2_DATA, 0);
+    return clocksource_register(&pit_clocksource);
+}
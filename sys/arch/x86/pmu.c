@@ -0,0 +1,287 @@
+/**
+ * Performance monitoring counters - Bunix OS
+ *
+ * Intel's architectural PMU: CPUID leaf 0xA gives the version, how many
+ * general-purpose counters there are and how wide, which of the seven
+ * architectural events work, and (from version 2) the fixed counters for
+ * instructions, core cycles and reference cycles. Fixed counters are
+ * used where they fit so the general ones stay free for the rest.
+ *
+ * Everything runs in ring 0, so counters count OS and user mode alike.
+ * Counting takes no interrupt: counters are 40 bits or wider, which at a
+ * few GHz is minutes before one wraps. Sampling does: general counter 0
+ * starts at -period and the LAPIC raises an ordinary (maskable)
+ * interrupt when it overflows, so code that runs with interrupts off is
+ * charged to wherever it turns them back on.
+ */
+
+#include "../../../include/kernel/arch/x86/pmu.h"
+#include "../../../include/kernel/arch/x86/cpu.h"
+#include "../../../include/kernel/arch/x86/irq.h"
+#include "../../../include/kernel/arch/x86/apic.h"
+#include "../../../include/lib/errno.h"
+
+#define MSR_PERFEVTSEL0        0x186
+#define MSR_PMC0               0x0C1
+#define MSR_FIXED_CTR0         0x309
+#define MSR_FIXED_CTR_CTRL     0x38D
+#define MSR_PERF_GLOBAL_CTRL   0x38F
+#define MSR_PERF_GLOBAL_OVF_CTRL 0x390
+
+#define EVTSEL_USR             (1u << 16)
+#define EVTSEL_OS              (1u << 17)
+#define EVTSEL_INT             (1u << 20)
+#define EVTSEL_EN              (1u << 22)
+
+#define FIXED_CTRL_OS          0x1
+#define FIXED_CTRL_USR         0x2
+
+#define SAMPLE_COUNTER         0
+
+typedef struct {
+    uint8_t event;
+    uint8_t umask;
+    const char* name;
+    int fixed;                    // Fixed counter that counts it, or -1
+} pmu_event_desc_t;
+
+// In CPUID 0xA EBX order: bit n set means event n is not available
+static const pmu_event_desc_t event_desc[PMU_EVENT_MAX] = {
+    [PMU_EVENT_CYCLES]         = { 0x3C, 0x00, "cycles",         1 },
+    [PMU_EVENT_INSTRUCTIONS]   = { 0xC0, 0x00, "instructions",   0 },
+    [PMU_EVENT_REF_CYCLES]     = { 0x3C, 0x01, "ref-cycles",     2 },
+    [PMU_EVENT_LLC_REFERENCES] = { 0x2E, 0x4F, "LLC-references", -1 },
+    [PMU_EVENT_LLC_MISSES]     = { 0x2E, 0x41, "LLC-misses",     -1 },
+    [PMU_EVENT_BRANCHES]       = { 0xC4, 0x00, "branches",       -1 },
+    [PMU_EVENT_BRANCH_MISSES]  = { 0xC5, 0x00, "branch-misses",  -1 },
+};
+
+// Per-CPU state; there is one CPU
+typedef struct {
+    pmu_counters_t* owner;
+    pmu_overflow_handler_t sample_handler;  // Set while sampling
+    void* sample_ctx;
+    uint32_t sample_period;
+    int sample_vector;            // LAPIC vector, 0 until first needed
+} pmu_cpu_t;
+
+static pmu_info_t info;
+static pmu_cpu_t cpus[1];
+static uint64_t gp_mask, fixed_mask;
+
+static pmu_cpu_t* this_cpu(void) {
+    return &cpus[0];
+}
+
+int pmu_init(void) {
+    const cpu_info_t* cpu = cpu_identify();
+    if (cpu->identity.max_cpuid < 0xA) return -ENODEV;
+
+    uint32_t eax, ebx, ecx, edx;
+    cpu_cpuid(0xA, 0, &eax, &ebx, &ecx, &edx);
+    uint8_t version = eax & 0xFF;
+    uint8_t gp = (eax >> 8) & 0xFF;
+    uint8_t width = (eax >> 16) & 0xFF;
+    uint8_t ebx_len = (eax >> 24) & 0xFF;
+    if (!version || !gp || !width) return -ENODEV;
+
+    info.version = version;
+    info.gp_counters = gp < PMU_MAX_GP ? gp : PMU_MAX_GP;
+    info.gp_width = width;
+    gp_mask = (1ull << width) - 1;
+
+    if (version >= 2) {
+        uint8_t fixed = edx & 0x1F;
+        info.fixed_counters = fixed < PMU_MAX_FIXED ? fixed : PMU_MAX_FIXED;
+        info.fixed_width = (edx >> 5) & 0xFF;
+        fixed_mask = info.fixed_width ? (1ull << info.fixed_width) - 1 : 0;
+        if (!fixed_mask) info.fixed_counters = 0;
+    }
+
+    // Only the first ebx_len bits of EBX mean anything
+    for (int e = 0; e < PMU_EVENT_MAX; e++) {
+        if (e < ebx_len && !(ebx & (1u << e))) info.events |= PMU_EVENT_BIT(e);
+    }
+    return 0;
+}
+
+const pmu_info_t* pmu_get_info(void) {
+    return &info;
+}
+
+const char* pmu_event_name(pmu_event_t event) {
+    return event < PMU_EVENT_MAX ? event_desc[event].name : "?";
+}
+
+int pmu_counters_init(pmu_counters_t* pc, uint32_t events) {
+    pc->events = events;
+    pc->counting = 0;
+    pc->enabled = false;
+    for (int e = 0; e < PMU_EVENT_MAX; e++) {
+        pc->counter[e] = -1;
+        pc->count[e] = 0;
+    }
+    if (!info.version) return -ENODEV;
+
+    uint32_t used_gp = 0;
+    for (int e = 0; e < PMU_EVENT_MAX; e++) {
+        if (!(events & info.events & PMU_EVENT_BIT(e))) continue;
+
+        int fixed = event_desc[e].fixed;
+        if (fixed >= 0 && fixed < info.fixed_counters) {
+            pc->counter[e] = PMU_FIXED(fixed);
+        } else if (used_gp < info.gp_counters) {
+            pc->counter[e] = used_gp++;
+        } else {
+            continue;
+        }
+        pc->counting |= PMU_EVENT_BIT(e);
+    }
+    return 0;
+}
+
+static uint64_t counter_read(int counter) {
+    if (counter >= PMU_FIXED(0)) {
+        return cpu_read_msr(MSR_FIXED_CTR0 + counter - PMU_FIXED(0)) & fixed_mask;
+    }
+    return cpu_read_msr(MSR_PMC0 + counter) & gp_mask;
+}
+
+int pmu_counters_enable(pmu_counters_t* pc) {
+    pmu_cpu_t* cpu = this_cpu();
+    if (!info.version) return -ENODEV;
+
+    uint32_t flags = irq_save();
+    if ((cpu->owner && cpu->owner != pc) || cpu->sample_handler) {
+        irq_restore(flags);
+        return -EBUSY;
+    }
+    cpu->owner = pc;
+
+    uint32_t fixed_ctrl = 0;
+    uint64_t global = 0;
+    for (int e = 0; e < PMU_EVENT_MAX; e++) {
+        int c = pc->counter[e];
+        if (c < 0) continue;
+
+        if (c >= PMU_FIXED(0)) {
+            int n = c - PMU_FIXED(0);
+            cpu_write_msr(MSR_FIXED_CTR0 + n, 0);
+            fixed_ctrl |= (FIXED_CTRL_OS | FIXED_CTRL_USR) << (n * 4);
+            global |= 1ull << (32 + n);
+        } else {
+            const pmu_event_desc_t* d = &event_desc[e];
+            cpu_write_msr(MSR_PMC0 + c, 0);
+            cpu_write_msr(MSR_PERFEVTSEL0 + c,
+                          d->event | (d->umask << 8) | EVTSEL_USR | EVTSEL_OS | EVTSEL_EN);
+            global |= 1ull << c;
+        }
+    }
+
+    // Version 1 has no global control: EN in each event select is enough
+    if (info.version >= 2) {
+        cpu_write_msr(MSR_FIXED_CTR_CTRL, fixed_ctrl);
+        cpu_write_msr(MSR_PERF_GLOBAL_CTRL, global);
+    }
+    pc->enabled = true;
+    irq_restore(flags);
+    return 0;
+}
+
+void pmu_counters_disable(pmu_counters_t* pc) {
+    pmu_cpu_t* cpu = this_cpu();
+    uint32_t flags = irq_save();
+    if (!pc->enabled || cpu->owner != pc) {
+        irq_restore(flags);
+        return;
+    }
+
+    if (info.version >= 2) cpu_write_msr(MSR_PERF_GLOBAL_CTRL, 0);
+    for (int e = 0; e < PMU_EVENT_MAX; e++) {
+        int c = pc->counter[e];
+        if (c < 0) continue;
+        if (c < PMU_FIXED(0)) cpu_write_msr(MSR_PERFEVTSEL0 + c, 0);
+        pc->count[e] += counter_read(c);
+    }
+    if (info.version >= 2) cpu_write_msr(MSR_FIXED_CTR_CTRL, 0);
+
+    pc->enabled = false;
+    cpu->owner = NULL;
+    irq_restore(flags);
+}
+
+uint64_t pmu_counters_read(const pmu_counters_t* pc, pmu_event_t event) {
+    if (event >= PMU_EVENT_MAX || pc->counter[event] < 0) return 0;
+
+    uint32_t flags = irq_save();
+    uint64_t count = pc->count[event];
+    if (pc->enabled) count += counter_read(pc->counter[event]);
+    irq_restore(flags);
+    return count;
+}
+
+static void sample_arm(pmu_cpu_t* cpu) {
+    // Counter writes sign-extend from bit 31 on CPUs without full-width
+    // writes, which is what -period needs anyway
+    cpu_write_msr(MSR_PMC0 + SAMPLE_COUNTER, -(uint64_t)cpu->sample_period & gp_mask);
+}
+
+static void pmu_interrupt(void* ctx) {
+    pmu_cpu_t* cpu = ctx;
+    if (!cpu->sample_handler) return;
+
+    sample_arm(cpu);
+    if (info.version >= 2) cpu_write_msr(MSR_PERF_GLOBAL_OVF_CTRL, 1ull << SAMPLE_COUNTER);
+    cpu->sample_handler(cpu->sample_ctx);
+    lapic_perf_init(cpu->sample_vector);
+}
+
+int pmu_sample_start(pmu_event_t event, uint32_t period,
+                     pmu_overflow_handler_t handler, void* ctx) {
+    pmu_cpu_t* cpu = this_cpu();
+    if (!info.version || !lapic_available()) return -ENODEV;
+    if (event >= PMU_EVENT_MAX || !(info.events & PMU_EVENT_BIT(event))) return -ENOENT;
+    if (!handler || !period || period >= 0x80000000u) return -EINVAL;
+
+    if (!cpu->sample_vector) {
+        int vector = lapic_alloc_vector(pmu_interrupt, cpu);
+        if (vector < 0) return vector;
+        cpu->sample_vector = vector;
+    }
+
+    uint32_t flags = irq_save();
+    if (cpu->owner || cpu->sample_handler) {
+        irq_restore(flags);
+        return -EBUSY;
+    }
+    cpu->sample_handler = handler;
+    cpu->sample_ctx = ctx;
+    cpu->sample_period = period;
+
+    const pmu_event_desc_t* d = &event_desc[event];
+    sample_arm(cpu);
+    lapic_perf_init(cpu->sample_vector);
+    cpu_write_msr(MSR_PERFEVTSEL0 + SAMPLE_COUNTER,
+                  d->event | (d->umask << 8) | EVTSEL_USR | EVTSEL_OS | EVTSEL_INT | EVTSEL_EN);
+    if (info.version >= 2) cpu_write_msr(MSR_PERF_GLOBAL_CTRL, 1ull << SAMPLE_COUNTER);
+    irq_restore(flags);
+    return 0;
+}
+
+void pmu_sample_stop(void) {
+    pmu_cpu_t* cpu = this_cpu();
+    uint32_t flags = irq_save();
+    if (!cpu->sample_handler) {
+        irq_restore(flags);
+        return;
+    }
+
+    if (info.version >= 2) cpu_write_msr(MSR_PERF_GLOBAL_CTRL, 0);
+    cpu_write_msr(MSR_PERFEVTSEL0 + SAMPLE_COUNTER, 0);
+    lapic_perf_init(0);
+    if (info.version >= 2) cpu_write_msr(MSR_PERF_GLOBAL_OVF_CTRL, 1ull << SAMPLE_COUNTER);
+
+    cpu->sample_handler = NULL;
+    cpu->sample_ctx = NULL;
+    irq_restore(flags);
+}
@@ -0,0 +1,75 @@
+/**
+ * TSC clock source - Bunix OS
+ *
+ * The time stamp counter is the cheapest clock there is, but nothing
+ * tells us its rate reliably: CPUID leaf 0x15 is often empty, and under
+ * a hypervisor the MSRs and brand string describe the host. So it is
+ * timed against the best other source for a few short windows at boot.
+ * It still has to earn its place: unless CPUID promises an invariant TSC
+ * it is rated lower, and either way the watchdog keeps checking it.
+ */
+
+#include "../../../include/kernel/arch/x86/timer.h"
+#include "../../../include/kernel/arch/x86/cpu.h"
+#include "../../../include/kernel/arch/x86/irq.h"
+#include "../../../include/lib/math64.h"
+#include "../../../include/lib/errno.h"
+
+#define TSC_CALIBRATE_MS    20
+#define TSC_CALIBRATE_RUNS  3
+
+// Ordered, so a read cannot drift ahead of the loads before it
+static uint64_t tsc_read(void) {
+    return cpu_rdtsc_ordered();
+}
+
+static clocksource_t tsc_clocksource = {
+    .name = "tsc",
+    .read = tsc_read,
+    .mask = ~0ull,
+    .rating = 200,
+    .flags = CLOCK_SOURCE_MUST_VERIFY | CLOCK_SOURCE_VDSO,
+};
+
+// TSC rate over one window of the reference, in Hz
+static uint64_t calibrate_once(clocksource_t* ref) {
+    uint64_t target = div_u64(ref->freq_hz * TSC_CALIBRATE_MS, 1000);
+    uint32_t flags = irq_save();
+
+    // Start on a tick edge so a partial first tick does not count
+    uint64_t last = ref->read(), now;
+    while ((now = ref->read()) == last)
+        ;
+    uint64_t start = cpu_rdtsc();
+    uint64_t ticks = 0;
+    last = now;
+    while (ticks < target) {
+        now = ref->read();
+        ticks += (now - last) & ref->mask;
+        last = now;
+    }
+    uint64_t cycles = cpu_rdtsc() - start;
+
+    irq_restore(flags);
+    return div64_u64(cycles * ref->freq_hz, ticks);
+}
+
+int tsc_clocksource_init(clocksource_t* ref) {
+    if (!cpu_has(X86_FEATURE_TSC) || !ref) return -ENODEV;
+    if (cpu_has(X86_FEATURE_INVARIANT_TSC)) tsc_clocksource.rating = 300;
+
+    // Median of a few windows: one of them may have been stretched by the
+    // hypervisor descheduling us
+    uint64_t hz[TSC_CALIBRATE_RUNS];
+    for (int i = 0; i < TSC_CALIBRATE_RUNS; i++) {
+        uint64_t v = calibrate_once(ref);
+        int j = i;
+        for (; j > 0 && hz[j - 1] > v; j--) hz[j] = hz[j - 1];
+        hz[j] = v;
+    }
+    tsc_clocksource.freq_hz = hz[TSC_CALIBRATE_RUNS / 2];
+    if (!tsc_clocksource.freq_hz) return -ENODEV;
+
+    cpu_set_tsc_frequency((uint32_t)div_u64(tsc_clocksource.freq_hz + 500, 1000));
+    return clocksource_register(&tsc_clocksource);
+}
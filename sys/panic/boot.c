@@ -11,9 +11,31 @@
 #include "../../include/mm/vmm.h"
 #include "../../include/kernel/panic/panic.h"
 #include "../../include/keyboard/kb.h"
+#include "../../include/serial/serial.h"
 #include "../../include/shell/shell.h"
 #include "../../include/kernel/panic/debug.h"
 #include "../../include/kernel/arch/x86/cpu.h"
+#include "../../include/mm/kmalloc.h"
+#include "../../include/mm/filemap.h"
+#include "../../include/mm/reclaim.h"
+#include "../../include/fs/vfs.h"
+#include "../../include/kernel/arch/x86/gdt.h"
+#include "../../include/kernel/arch/x86/idt.h"
+#include "../../include/kernel/arch/x86/irq.h"
+#include "../../include/kernel/arch/x86/apic.h"
+#include "../../include/kernel/arch/x86/pmu.h"
+#include "../../include/kernel/time/clocksource.h"
+#include "../../include/kernel/time/hrtimer.h"
+#include "../../include/kernel/rtc/rtc.h"
+#include "../../include/pci/pci.h"
+#include "../../include/block/ata.h"
+#include "../../include/block/virtio_blk.h"
+#include "../../include/block/nvme.h"
+#include "../../include/block/bcache.h"
+#include "../../include/net/netdev.h"
+#include "../../include/net/virtio_net.h"
+#include "../../include/net/e1000.h"
+#include "../../include/kernel/syscall/syscall.h"
 
 // Boot timing configuration
 #define BOOT_DELAY_SHORT    150000
@@ -58,10 +80,7 @@ static void verify_cpu_features(void) {
     DEBUG_SUCCESS("Register integrity verified");
 
     // Check TSC functionality
-    cpu_info_t cpu_info;
-    cpu_identify(&cpu_info);
-    
-    if (cpu_info.features.tsc) {
+    if (cpu_has(X86_FEATURE_TSC)) {
         const uint64_t tsc1 = cpu_rdtsc();
         boot_delay(1000);
         const uint64_t tsc2 = cpu_rdtsc();
@@ -82,12 +101,62 @@ void boot_screen(void) {
     vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
     vga_clear();
     DEBUG_SUCCESS("Video subsystem initialized");
+    if (serial_init() == 0) {
+        DEBUG_SUCCESS("Serial: COM1 at %d baud", SERIAL_BAUD);
+    } else {
+        DEBUG_INFO("No serial port on COM1");
+    }
     boot_delay(BOOT_DELAY_SHORT);
 
     // Early CPU initialization
     cpu_early_init();
     verify_cpu_features();
 
+    // Descriptor tables and interrupt routing; device lines stay masked
+    // until a driver claims them
+    gdt_init();
+    idt_init();
+    irq_init();
+    syscall_init();
+    cpu_enable_interrupts();
+    DEBUG_SUCCESS("Interrupts enabled (PIC remapped to vector 0x%x)", IRQ_BASE_VECTOR);
+    if (lapic_init()) {
+        DEBUG_SUCCESS("Local APIC %d enabled for message-signalled interrupts", (int)lapic_id());
+    } else {
+        DEBUG_INFO("No local APIC, devices use legacy interrupt lines");
+    }
+
+    // Time: calibrate the TSC and pick what timekeeping reads
+    clocksource_init();
+    clocksource_t* clock = clocksource_current();
+    if (clock) {
+        DEBUG_SUCCESS("Clocksource: %s, %d ns per read", clock->name, (int)clock->read_ns);
+    }
+    clocksource_t* tsc = clocksource_find("tsc");
+    if (tsc) {
+        DEBUG_INFO("TSC calibrated at %d kHz", (int)div_u64(tsc->freq_hz, 1000));
+    }
+    if (hrtimers_init()) {
+        hrtimer_stats_t timers;
+        hrtimer_get_stats(&timers);
+        DEBUG_SUCCESS("High-resolution timers on the %s timer, tickless", timers.mode);
+    } else {
+        DEBUG_INFO("No LAPIC timer, timers are polled");
+    }
+    if (rtc_init() == 0) {
+        struct rtc_date now;
+        rtc_read_full(&now);
+        DEBUG_SUCCESS("RTC: %d-%d-%d %d:%d:%d UTC, wall clock kept by IRQ %d", (int)now.year, (int)now.month,
+                      (int)now.day, (int)now.hour, (int)now.minute, (int)now.second, RTC_IRQ);
+    }
+    if (pmu_init() == 0) {
+        const pmu_info_t* pmu = pmu_get_info();
+        DEBUG_SUCCESS("PMU: version %d, %d x %d-bit counters, %d fixed", pmu->version,
+                      pmu->gp_counters, pmu->gp_width, pmu->fixed_counters);
+    } else {
+        DEBUG_INFO("No architectural PMU, perfstat shows elapsed time only");
+    }
+
     // Memory management initialization
     DEBUG_INFO("Initializing virtual memory manager");
     const struct multiboot_info* mb_info = (struct multiboot_info*)multiboot_info_ptr;
@@ -96,6 +165,55 @@ void boot_screen(void) {
     vmm_init((uint32_t*)&__bitmap_start, total_memory);
     DEBUG_SUCCESS("Memory manager initialized (%u MB)", 
                  total_memory / (1024 * 1024));
+    kmalloc_init();
+    DEBUG_SUCCESS("Kernel heap initialized");
+    filemap_init();
+    reclaim_init();
+    boot_delay(BOOT_DELAY_SHORT);
+
+    // Filesystems
+    vfs_init();
+    DEBUG_SUCCESS("VFS initialized, rootfs mounted on /");
+    boot_delay(BOOT_DELAY_SHORT);
+
+    // Buses and storage
+    blkdev_init();
+    bcache_init();
+    pci_init();
+    DEBUG_SUCCESS("PCI bus scanned, %d functions found", (int)pci_device_count());
+    int disks = ata_init();
+    if (disks > 0) {
+        DEBUG_SUCCESS("ATA: %d disk(s) using bus-master DMA", disks);
+    } else {
+        DEBUG_INFO("ATA: no disks found");
+    }
+    int vdisks = virtio_blk_init();
+    if (vdisks > 0) {
+        DEBUG_SUCCESS("virtio-blk: %d device(s)", vdisks);
+    }
+    int namespaces = nvme_init();
+    if (namespaces > 0) {
+        DEBUG_SUCCESS("NVMe: %d namespace(s)", namespaces);
+    }
+
+    // Network stack and the loopback device
+    net_init();
+    DEBUG_SUCCESS("Network stack initialized, lo up as 127.0.0.1");
+    int nics = virtio_net_init();
+    if (nics > 0) {
+        DEBUG_SUCCESS("virtio-net: %d device(s)", nics);
+    }
+    nics = e1000_init();
+    if (nics > 0) {
+        DEBUG_SUCCESS("e1000: %d device(s)", nics);
+    }
+    boot_delay(BOOT_DELAY_SHORT);
+
+    // The disc we booted from, for files too big to build into kernel.elf
+    blkdev_t* cdrom = ata_cdrom();
+    if (cdrom && vfs_mount("iso9660", cdrom->name, "/cdrom", VFS_MNT_RDONLY) == 0) {
+        DEBUG_SUCCESS("ISO9660: %s mounted on /cdrom", cdrom->name);
+    }
     boot_delay(BOOT_DELAY_SHORT);
 
     // Peripheral initialization
@@ -109,10 +227,9 @@ void boot_screen(void) {
     DEBUG_INFO("Performing final system checks");
     DEBUG_SUCCESS("Kernel base address: 0xC0000000");
     
-    cpu_info_t cpu_info;
-    cpu_identify(&cpu_info);
-    DEBUG_INFO("CPU Vendor: %s", cpu_info.identity.vendor_id);
-    DEBUG_INFO("CPU Model:  %s", cpu_info.identity.brand_string);
+    const cpu_info_t* cpu_info = cpu_identify();
+    DEBUG_INFO("CPU Vendor: %s", cpu_info->identity.vendor_id);
+    DEBUG_INFO("CPU Model:  %s", cpu_info->identity.brand_string);
 
     // Complete initialization
     cpu_late_init();
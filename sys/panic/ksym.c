@@ -0,0 +1,73 @@
+/**
+ * Kernel symbol lookup - Bunix OS
+ *
+ * Binary search over the address array scripts/ksymgen.sh generates.
+ * ksyms_addr has one entry past the last symbol, _etext, so symbol i
+ * always ends where entry i + 1 begins.
+ *
+ * A name entry is {shared prefix length, suffix length, suffix}. Entries
+ * at a multiple of KSYM_MARKER_STRIDE share nothing and ksyms_markers
+ * has their offsets, so a name is rebuilt by decoding forward from the
+ * start of its block into the caller's buffer.
+ */
+
+#include "../../include/kernel/panic/ksym.h"
+#include "../../include/lib/errno.h"
+
+extern const uint32_t ksyms_num;
+extern const uint32_t ksyms_addr[];
+extern const uint32_t ksyms_markers[];
+extern const uint8_t ksyms_names[];
+
+extern char _text[];
+extern char _etext[];
+
+uint32_t ksym_total(void) {
+    return ksyms_num;
+}
+
+bool ksym_is_text(uintptr_t addr) {
+    return addr >= (uintptr_t)_text && addr < (uintptr_t)_etext;
+}
+
+int ksym_index(uintptr_t addr) {
+    if (!ksyms_num || addr < ksyms_addr[0] || addr >= ksyms_addr[ksyms_num]) return -1;
+
+    // Invariant: ksyms_addr[lo] <= addr < ksyms_addr[hi]
+    uint32_t lo = 0, hi = ksyms_num;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (ksyms_addr[mid] <= addr) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int ksym_get(uint32_t index, ksym_t* out) {
+    if (index >= ksyms_num) return -ENOENT;
+
+    const uint8_t* entry = &ksyms_names[ksyms_markers[index / KSYM_MARKER_STRIDE]];
+    for (uint32_t i = index & ~(KSYM_MARKER_STRIDE - 1); ; i++) {
+        uint8_t shared = entry[0], len = entry[1];
+        for (uint8_t k = 0; k < len; k++) out->name[shared + k] = entry[2 + k];
+        out->name[shared + len] = '\0';
+        if (i == index) break;
+        entry += 2 + len;
+    }
+    out->addr = ksyms_addr[index];
+    out->size = ksyms_addr[index + 1] - ksyms_addr[index];
+    out->offset = 0;
+    return 0;
+}
+
+bool ksym_lookup(uintptr_t addr, ksym_t* out) {
+    int index = ksym_index(addr);
+    if (index < 0) return false;
+
+    ksym_get(index, out);
+    out->offset = addr - out->addr;
+    return true;
+}
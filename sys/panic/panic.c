@@ -1,6 +1,7 @@
 #include "../../include/kernel/panic/panic.h"
 #include "../../include/video/vga.h"
 #include "../../include/kernel/rtc/rtc.h"
+#include "../../include/kernel/panic/ksym.h"
 
 // Register structure with packed attribute
 struct __attribute__((packed)) Registers {
@@ -15,6 +16,31 @@ struct StackFrame {
     uint32_t return_addr;
 };
 
+// Hex without leading zeros, for symbol offsets
+static void print_hex_short(uint32_t value) {
+    const char hex_chars[] = "0123456789abcdef";
+    int shift = 28;
+    vga_puts("0x");
+    while (shift > 0 && !(value >> shift)) shift -= 4;
+    for (; shift >= 0; shift -= 4) vga_putchar(hex_chars[(value >> shift) & 0xF]);
+}
+
+// " name+0x1a/0x40" for an address in kernel text. A return address is
+// looked up one byte back: a call that ends its function returns just
+// past it, into whatever comes next.
+static void print_symbol(uint32_t addr, bool return_addr) {
+    ksym_t sym;
+    uint32_t back = return_addr ? 1 : 0;
+    if (!ksym_lookup(addr - back, &sym)) return;
+
+    vga_putchar(' ');
+    vga_puts(sym.name);
+    vga_putchar('+');
+    print_hex_short(sym.offset + back);
+    vga_putchar('/');
+    print_hex_short(sym.size);
+}
+
 // Enhanced register dump
 static void dump_registers(const struct Registers* regs) {
     vga_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLUE);
@@ -30,7 +56,8 @@ static void dump_registers(const struct Registers* regs) {
     vga_puts(" ESP: 0x"); vga_puthex(regs->esp);
     
     vga_puts("\nEIP: 0x"); vga_puthex(regs->eip);
-    vga_puts(" EFLAGS: 0x"); vga_puthex(regs->eflags);
+    print_symbol(regs->eip, true);
+    vga_puts("\nEFLAGS: 0x"); vga_puthex(regs->eflags);
     
     vga_puts("\nCS: 0x"); vga_puthex(regs->cs);
     vga_puts(" DS: 0x"); vga_puthex(regs->ds);
@@ -48,9 +75,14 @@ static void stack_trace(uint32_t max_frames) {
     vga_set_color(VGA_COLOR_YELLOW, VGA_COLOR_RED);
     vga_puts("\n\nStack Trace:");
     
+    // Stop at the first frame that does not return into the kernel: the
+    // loader's stack lies below main
     for(uint32_t i = 0; frame && i < max_frames; i++) {
+        if (!ksym_is_text(frame->return_addr)) break;
         vga_puts("\n#"); vga_putdec(i, 0);
         vga_puts(" 0x"); vga_puthex(frame->return_addr);
+        print_symbol(frame->return_addr, true);
+        if (frame->next <= frame) break;
         frame = frame->next;
     }
 }
@@ -0,0 +1,86 @@
+/**
+ * Call-graph recording - Bunix OS
+ *
+ * The -finstrument-functions hooks. This file is compiled without the
+ * flag (see the Makefile), and the hooks call nothing outside it except
+ * header inlines, which are compiled here too: that is what keeps them
+ * from recursing. Interrupts are off while an event is written, so an
+ * interrupt handler's calls land either wholly before or wholly after it
+ * and the buffer stays in time order.
+ */
+
+#include "../../include/kernel/perf/callgraph.h"
+#include "../../include/kernel/arch/x86/irq.h"
+#include "../../include/lib/errno.h"
+
+#define NO_INSTRUMENT __attribute__((no_instrument_function))
+
+void __cyg_profile_func_enter(void* fn, void* call_site) NO_INSTRUMENT;
+void __cyg_profile_func_exit(void* fn, void* call_site) NO_INSTRUMENT;
+
+static callgraph_event_t events[CALLGRAPH_EVENTS];
+static uint32_t count;
+static volatile bool recording;
+static bool full;
+
+static inline uint64_t read_tsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static void record(void* fn, uint32_t kind) {
+    uint32_t flags = irq_save();
+    if (recording) {
+        if (count < CALLGRAPH_EVENTS) {
+            callgraph_event_t* e = &events[count++];
+            e->tsc = read_tsc();
+            e->fn = (uint32_t)fn;
+            e->kind = kind;
+        } else {
+            recording = false;
+            full = true;
+        }
+    }
+    irq_restore(flags);
+}
+
+void __cyg_profile_func_enter(void* fn, void* call_site) {
+    (void)call_site;
+    if (recording) record(fn, CALLGRAPH_ENTER);
+}
+
+void __cyg_profile_func_exit(void* fn, void* call_site) {
+    (void)call_site;
+    if (recording) record(fn, CALLGRAPH_EXIT);
+}
+
+int callgraph_start(void) {
+    if (recording) return -EBUSY;
+
+    uint32_t flags = irq_save();
+    count = 0;
+    full = false;
+    recording = true;
+    irq_restore(flags);
+    return 0;
+}
+
+int callgraph_stop(void) {
+    if (full) return -ENOSPC;
+    if (!recording) return -EINVAL;
+    recording = false;
+    return 0;
+}
+
+void callgraph_get_stats(callgraph_stats_t* out) {
+    out->recording = recording;
+    out->full = full;
+    out->events = count;
+}
+
+const callgraph_event_t* callgraph_events(uint32_t* n) {
+    if (recording) return NULL;
+    *n = count;
+    return events;
+}
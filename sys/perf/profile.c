@@ -0,0 +1,168 @@
+/**
+ * Sampling profiler - Bunix OS
+ *
+ * Both sources end up in profile_sample(), in interrupt context, which
+ * copies the interrupted EIP and walks the frame-pointer chain from the
+ * interrupted EBP. The walk trusts nothing it reads: each frame must be
+ * aligned, above the one before, within PROFILE_STACK_SPAN of the first,
+ * and return into kernel text, or the chain ends there. That covers the
+ * bottom of the stack too, since boot.s enters main with whatever EBP
+ * the loader left.
+ *
+ * The ring is allocated on the first start and kept, so a report can be
+ * read any time after a stop.
+ */
+
+#include "../../include/kernel/perf/profile.h"
+#include "../../include/kernel/panic/ksym.h"
+#include "../../include/kernel/time/hrtimer.h"
+#include "../../include/kernel/time/clocksource.h"
+#include "../../include/kernel/arch/x86/idt.h"
+#include "../../include/kernel/arch/x86/irq.h"
+#include "../../include/mm/kmalloc.h"
+#include "../../include/lib/errno.h"
+
+#define NSEC_PER_SEC 1000000000u
+
+struct stack_frame {
+    const struct stack_frame* next;
+    uint32_t return_addr;
+};
+
+// Per-CPU state; there is one CPU
+typedef struct {
+    profile_sample_t* ring;
+    uint32_t head;                // Next slot to write
+    uint32_t taken;
+} profile_cpu_t;
+
+static profile_cpu_t cpus[1];
+static hrtimer_t timer;
+static profile_stats_t state;
+static uint64_t started_ns;
+
+static profile_cpu_t* this_cpu(void) {
+    return &cpus[0];
+}
+
+static uint32_t profile_callchain(uint32_t ebp, uint32_t* callers) {
+    const struct stack_frame* frame = (const struct stack_frame*)ebp;
+    uint32_t depth = 0;
+
+    while (depth < PROFILE_MAX_DEPTH && frame) {
+        uintptr_t at = (uintptr_t)frame;
+        if ((at & 3) || at - ebp > PROFILE_STACK_SPAN) break;
+        if (!ksym_is_text(frame->return_addr)) break;
+
+        callers[depth++] = frame->return_addr;
+        if (frame->next <= frame) break;
+        frame = frame->next;
+    }
+    return depth;
+}
+
+static void profile_sample(void) {
+    interrupt_frame_t* frame = idt_current_frame();
+    profile_cpu_t* cpu = this_cpu();
+    if (!frame || !cpu->ring) return;
+
+    profile_sample_t* sample = &cpu->ring[cpu->head];
+    sample->eip = frame->eip;
+    sample->depth = profile_callchain(frame->ebp, sample->callers);
+    cpu->head = (cpu->head + 1) % PROFILE_RING_SAMPLES;
+    cpu->taken++;
+}
+
+static hrtimer_restart_t profile_tick(hrtimer_t* t) {
+    profile_sample();
+    hrtimer_forward(t, ktime_get_ns(), state.period);
+    return HRTIMER_RESTART;
+}
+
+static void profile_overflow(void* ctx) {
+    (void)ctx;
+    profile_sample();
+}
+
+static int profile_prepare(void) {
+    profile_cpu_t* cpu = this_cpu();
+    if (state.running) return -EBUSY;
+
+    if (!cpu->ring) {
+        cpu->ring = kmalloc(PROFILE_RING_SAMPLES * sizeof(profile_sample_t));
+        if (!cpu->ring) return -ENOMEM;
+    }
+    cpu->head = 0;
+    cpu->taken = 0;
+    return 0;
+}
+
+static void profile_begin(profile_source_t source, uint32_t period) {
+    state.running = true;
+    state.source = source;
+    state.period = period;
+    state.elapsed_ns = 0;
+    started_ns = ktime_get_ns();
+}
+
+int profile_start_timer(uint32_t hz) {
+    if (!hz || hz > PROFILE_MAX_HZ) return -EINVAL;
+    if (!hrtimer_can_wake()) return -ENODEV;
+
+    int err = profile_prepare();
+    if (err) return err;
+
+    profile_begin(PROFILE_SOURCE_TIMER, NSEC_PER_SEC / hz);
+    hrtimer_init(&timer, profile_tick, NULL);
+    err = hrtimer_start(&timer, state.period, HRTIMER_MODE_REL);
+    if (err) state.running = false;
+    return err;
+}
+
+int profile_start_pmu(pmu_event_t event, uint32_t period) {
+    int err = profile_prepare();
+    if (err) return err;
+
+    profile_begin(PROFILE_SOURCE_PMU, period);
+    state.event = event;
+    err = pmu_sample_start(event, period, profile_overflow, NULL);
+    if (err) state.running = false;
+    return err;
+}
+
+int profile_stop(void) {
+    if (!state.running) return -EINVAL;
+
+    if (state.source == PROFILE_SOURCE_TIMER) {
+        hrtimer_cancel(&timer);
+    } else {
+        pmu_sample_stop();
+    }
+    state.elapsed_ns = ktime_get_ns() - started_ns;
+    state.running = false;
+    return 0;
+}
+
+void profile_get_stats(profile_stats_t* out) {
+    profile_cpu_t* cpu = this_cpu();
+    uint32_t flags = irq_save();
+
+    *out = state;
+    out->taken = cpu->taken;
+    out->held = cpu->taken < PROFILE_RING_SAMPLES ? cpu->taken : PROFILE_RING_SAMPLES;
+    if (state.running) out->elapsed_ns = ktime_get_ns() - started_ns;
+    irq_restore(flags);
+}
+
+int profile_for_each(void (*fn)(const profile_sample_t* sample, void* ctx), void* ctx) {
+    profile_cpu_t* cpu = this_cpu();
+    if (state.running) return -EBUSY;
+
+    uint32_t held = cpu->taken < PROFILE_RING_SAMPLES ? cpu->taken : PROFILE_RING_SAMPLES;
+    uint32_t slot = (cpu->head + PROFILE_RING_SAMPLES - held) % PROFILE_RING_SAMPLES;
+    for (uint32_t i = 0; i < held; i++) {
+        fn(&cpu->ring[slot], ctx);
+        slot = (slot + 1) % PROFILE_RING_SAMPLES;
+    }
+    return held;
+}
@@ -0,0 +1,200 @@
+/**
+ * Static tracepoints - Bunix OS
+ *
+ * Each ring slot carries a sequence word next to its record. A writer
+ * claims position p with an atomic increment of 'head', clears the
+ * slot's sequence, fills in the record and publishes it by storing p + 1.
+ * The reader copies a record only when the sequence says p + 1, and
+ * checks it again after the copy: anything else means the slot is still
+ * being written (stop and retry later) or was lapped by a writer (count
+ * it lost and move on). Writers never wait for the reader; when the ring
+ * is full the oldest unread records go.
+ */
+
+#include "../../include/kernel/perf/trace.h"
+#include "../../include/kernel/time/clocksource.h"
+#include "../../include/kernel/sched/idle.h"
+#include "../../include/kernel/arch/x86/cpu.h"
+#include "../../include/kernel/arch/x86/irq.h"
+#include "../../include/serial/serial.h"
+#include "../../include/mm/kmalloc.h"
+#include "../../include/lib/math64.h"
+#include "../../include/lib/errno.h"
+
+#define TRACE_IDLE_BATCH 32       // Records streamed per idle pass
+
+typedef struct {
+    volatile uint32_t seq;        // Position + 1 once the record is whole
+    uint32_t reserved;
+    trace_record_t record;
+} trace_slot_t;
+
+// Per-CPU state; there is one CPU
+typedef struct {
+    trace_slot_t* ring;
+    volatile uint32_t head;       // Next position a writer claims
+    uint32_t tail;                // Next position the reader streams
+} trace_cpu_t;
+
+static const trace_event_desc_t descs[] = {
+    { TRACE_MM_PAGE_ALLOC,  'i', 2, "mm",      "page_alloc", "page,used" },
+    { TRACE_MM_PAGE_FREE,   'i', 2, "mm",      "page_free",  "page,used" },
+    { TRACE_KB_SCANCODE,    'i', 1, "kb",      "scancode",   "code" },
+    { TRACE_KB_KEY,         'i', 1, "kb",      "key",        "char" },
+    { TRACE_VGA_PUTS_BEGIN, 'B', 0, "vga",     "vga_puts",   "" },
+    { TRACE_VGA_PUTS_END,   'E', 1, "vga",     "vga_puts",   "chars" },
+    { TRACE_VGA_SCROLL,     'i', 0, "vga",     "scroll",     "" },
+    { TRACE_SYS_ENTER,      'B', 3, "syscall", "syscall",    "nr,arg0,arg1" },
+    { TRACE_SYS_EXIT,       'E', 2, "syscall", "syscall",    "nr,ret" },
+};
+
+static const char* const group_names[TRACE_GROUPS] = {
+    [TRACE_GROUP_MM]      = "mm",
+    [TRACE_GROUP_KB]      = "kb",
+    [TRACE_GROUP_VGA]     = "vga",
+    [TRACE_GROUP_SYSCALL] = "syscall",
+};
+
+uint32_t trace_groups;
+
+static trace_cpu_t cpus[1];
+static bool streaming;
+static bool idle_registered;
+static uint32_t written, lost;
+
+static trace_cpu_t* this_cpu(void) {
+    return &cpus[0];
+}
+
+void trace_record(uint16_t event, uint32_t a0, uint32_t a1, uint32_t a2) {
+    trace_cpu_t* cpu = this_cpu();
+    if (!cpu->ring) return;
+
+    uint32_t pos = __atomic_fetch_add(&cpu->head, 1, __ATOMIC_RELAXED);
+    trace_slot_t* slot = &cpu->ring[pos & (TRACE_RING_SLOTS - 1)];
+
+    slot->seq = 0;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    slot->record.tsc = cpu_rdtsc();
+    slot->record.event = event;
+    slot->record.cpu = cpu - cpus;
+    slot->record.reserved = 0;
+    slot->record.args[0] = a0;
+    slot->record.args[1] = a1;
+    slot->record.args[2] = a2;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+static void stream_control(uint16_t event, uint32_t arg) {
+    trace_record_t record = { cpu_rdtsc(), event, 0, 0, { arg, 0, 0 } };
+    serial_write(&record, sizeof(record));
+}
+
+uint32_t trace_drain(uint32_t max) {
+    trace_cpu_t* cpu = this_cpu();
+    uint32_t count = 0;
+    if (!streaming) return 0;
+
+    while (count < max && cpu->tail != cpu->head) {
+        // Lapped: skip to the oldest record still in the ring
+        uint32_t behind = cpu->head - cpu->tail;
+        if (behind > TRACE_RING_SLOTS) {
+            uint32_t skipped = behind - TRACE_RING_SLOTS;
+            cpu->tail += skipped;
+            lost += skipped;
+            stream_control(TRACE_EVENT_LOST, skipped);
+            continue;
+        }
+
+        trace_slot_t* slot = &cpu->ring[cpu->tail & (TRACE_RING_SLOTS - 1)];
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq != cpu->tail + 1) {
+            // Zero or older: a writer has it now. Newer: it was lapped
+            // between the check above and here
+            if ((int32_t)(seq - (cpu->tail + 1)) <= 0) break;
+            cpu->tail++;
+            lost++;
+            continue;
+        }
+
+        trace_record_t record = slot->record;
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != seq) continue;
+
+        serial_write(&record, sizeof(record));
+        cpu->tail++;
+        written++;
+        count++;
+    }
+    return count;
+}
+
+static void trace_idle(void) {
+    trace_drain(TRACE_IDLE_BATCH);
+}
+
+static uint32_t tsc_khz(void) {
+    clocksource_t* tsc = clocksource_find("tsc");
+    return tsc ? (uint32_t)div_u64(tsc->freq_hz, 1000) : 0;
+}
+
+int trace_start(uint32_t groups) {
+    trace_cpu_t* cpu = this_cpu();
+    if (streaming) return -EBUSY;
+    if (!serial_available()) return -ENODEV;
+    if (!groups || (groups & ~TRACE_GROUPS_ALL)) return -EINVAL;
+
+    if (!cpu->ring) {
+        trace_slot_t* ring = kzalloc(TRACE_RING_SLOTS * sizeof(trace_slot_t));
+        if (!ring) return -ENOMEM;
+        cpu->ring = ring;
+    }
+    if (!idle_registered) {
+        int err = idle_register(trace_idle);
+        if (err) return err;
+        idle_registered = true;
+    }
+
+    trace_header_t header = { tsc_khz(), sizeof(trace_record_t), sizeof(descs) / sizeof(descs[0]) };
+    serial_write(TRACE_MAGIC, sizeof(TRACE_MAGIC) - 1);
+    serial_write(&header, sizeof(header));
+    serial_write(descs, sizeof(descs));
+
+    uint32_t flags = irq_save();
+    cpu->tail = cpu->head;
+    written = 0;
+    lost = 0;
+    streaming = true;
+    trace_groups = groups;
+    irq_restore(flags);
+    return 0;
+}
+
+int trace_stop(void) {
+    if (!streaming) return -EINVAL;
+
+    trace_groups = 0;
+    trace_drain(TRACE_RING_SLOTS);
+    stream_control(TRACE_EVENT_END, lost);
+    streaming = false;
+    return 0;
+}
+
+void trace_get_stats(trace_stats_t* out) {
+    trace_cpu_t* cpu = this_cpu();
+    uint32_t behind = cpu->head - cpu->tail;
+
+    out->groups = trace_groups;
+    out->written = written;
+    out->lost = lost;
+    out->pending = streaming ? (behind < TRACE_RING_SLOTS ? behind : TRACE_RING_SLOTS) : 0;
+}
+
+const char* trace_group_name(uint32_t group) {
+    return group < TRACE_GROUPS ? group_names[group] : "?";
+}
+
+const trace_event_desc_t* trace_event_descs(uint32_t* count) {
+    *count = sizeof(descs) / sizeof(descs[0]);
+    return descs;
+}
@@ -1,4 +1,7 @@
 #include <kernel/rtc/rtc.h>
+#include <kernel/time/clocksource.h>
+#include <kernel/arch/x86/irq.h>
+#include <lib/calendar.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -19,7 +22,15 @@ bool rtc_is_updating() {
 }
 
 // Date/Time Functions
-void rtc_read_full(struct rtc_date *date) { // <-- ADD THIS LINE
+
+#define RTC_RESYNC_NS 1000000ull    // Step the wall clock past 1 ms of error
+
+static bool wall_synced;
+static uint32_t updates;
+
+// Raw read of the chip: waits out an update in progress, then eight
+// register reads
+void rtc_read_cmos(struct rtc_date *date) {
     while (rtc_is_updating());  // Wait for update to complete
 
     // Read raw RTC values
@@ -29,12 +40,12 @@ void rtc_read_full(struct rtc_date *date) { // <-- ADD THIS LINE
     date->day = rtc_read_register(RTC_DAY_OF_MONTH);
     date->month = rtc_read_register(RTC_MONTH);
     uint8_t raw_year = rtc_read_register(RTC_YEAR);      // 0x09: 2-digit year
-    uint8_t raw_century = rtc_read_register(0x32);       // 0x32: Century
+    uint8_t raw_century = rtc_read_register(RTC_CENTURY);
 
-    // Read RTC configuration
+    // Read RTC configuration; the PM flag rides in the hour's top bit
     uint8_t statusB = rtc_read_register(RTC_STATUS_B);
-    date->is_24hour = statusB & RTC_24HOUR_MODE;
-    date->is_pm = (date->hour & 0x80) && !date->is_24hour;
+    bool pm = (date->hour & 0x80) && !(statusB & RTC_24HOUR_MODE);
+    date->hour &= 0x7F;
 
     // Convert BCD to binary if needed
     if (!(statusB & RTC_BCD_MODE)) {
@@ -46,9 +57,80 @@ void rtc_read_full(struct rtc_date *date) { // <-- ADD THIS LINE
         raw_year = bcd_to_bin(raw_year);
         raw_century = bcd_to_bin(raw_century);
     }
+    if (!(statusB & RTC_24HOUR_MODE)) date->hour = date->hour % 12 + (pm ? 12 : 0);
+    date->is_24hour = true;
+    date->is_pm = date->hour >= 12;
+
+    // Combine century and year into a 4-digit value; not every chip
+    // keeps the century register
+    date->year = (raw_century ? raw_century : 20) * 100 + raw_year;
+}
+
+uint32_t rtc_date_to_epoch(const struct rtc_date *date) {
+    int32_t days = days_from_civil(date->year, date->month, date->day);
+    if (days < 0) return 0;
+    return (uint32_t)days * SECS_PER_DAY + date->hour * 3600 + date->minute * 60 + date->second;
+}
+
+void rtc_date_from_epoch(uint32_t seconds, struct rtc_date *date) {
+    int32_t year;
+    uint32_t month, day;
+    civil_from_days(seconds / SECS_PER_DAY, &year, &month, &day);
+
+    uint32_t rem = seconds % SECS_PER_DAY;
+    date->year = year;
+    date->month = month;
+    date->day = day;
+    date->hour = rem / 3600;
+    date->minute = rem / 60 % 60;
+    date->second = rem % 60;
+    date->is_24hour = true;
+    date->is_pm = date->hour >= 12;
+}
 
-    // Combine century and year into a 4-digit value
-    date->year = (raw_century * 100) + raw_year;
+// A second has just ticked over, so the registers are stable for nearly
+// a second and the time is exact to the interrupt latency
+static void rtc_irq(void *ctx) {
+    (void)ctx;
+    uint64_t mono = ktime_get_ns();
+    if (!(rtc_read_register(RTC_STATUS_C) & RTC_UPDATE_ENDED)) return;
+
+    struct rtc_date date;
+    rtc_read_cmos(&date);
+    uint64_t real = (uint64_t)rtc_date_to_epoch(&date) * 1000000000ull;
+
+    // Leave small errors alone rather than jitter the clock every second
+    uint64_t ours = ktime_mono_to_real(mono);
+    uint64_t error = real > ours ? real - ours : ours - real;
+    if (error > RTC_RESYNC_NS) timekeeping_set_wall(real, mono);
+    updates++;
+}
+
+int rtc_init(void) {
+    struct rtc_date date;
+    rtc_read_cmos(&date);
+    timekeeping_set_wall((uint64_t)rtc_date_to_epoch(&date) * 1000000000ull, ktime_get_ns());
+
+    uint32_t flags = irq_save();
+    rtc_write_register(RTC_STATUS_B, rtc_read_register(RTC_STATUS_B) | RTC_UPDATE_IRQ);
+    rtc_read_register(RTC_STATUS_C);
+    irq_restore(flags);
+
+    int err = irq_register(RTC_IRQ, rtc_irq, NULL);
+    if (!err) wall_synced = true;
+    return err;
+}
+
+uint32_t rtc_update_count(void) {
+    return updates;
+}
+
+void rtc_read_full(struct rtc_date *date) {
+    if (!wall_synced) {
+        rtc_read_cmos(date);
+        return;
+    }
+    rtc_date_from_epoch(ktime_get_real_seconds(), date);
 }
 
 // Conversion Functions
@@ -74,74 +156,5 @@ uint8_t days_in_month(uint8_t month, uint8_t year) {
 }
 
 uint8_t day_of_week(uint8_t day, uint8_t month, uint16_t year) {
-    if (month < 3) {
-        month += 12;
-        year--; // Adjust year for January/February
-    }
-    uint8_t q = day;                // Day of the month
-    uint8_t m = month;              // Adjusted month (March=3, ..., February=14)
-    uint8_t k = year % 100;         // Year of the century (last two digits)
-    uint8_t j = year / 100;         // Zero-based century (e.g., 2025 → 20)
-    
-    // Zeller's Congruence (Gregorian calendar)
-    uint8_t h = (q + (13 * (m + 1) / 5) + k + (k / 4) + (j / 4) + 5 * j) % 7;
-    
-    // Adjust result to match 0=Sunday, 1=Monday, ..., 6=Saturday
-    return (h + 6) % 7;
-}
-
-// DST Calculations
-bool is_dst_eu(uint8_t month, uint8_t day, uint8_t year) {
-    if (month < 3 || month > 10) return false;
-    if (month > 3 && month < 10) return true;
-
-    // DST starts last Sunday in March
-    if (month == 3) {
-        uint8_t last_sunday = 31 - (5 + year + year / 4) % 7;
-        return day >= last_sunday;
-    }
-
-    // DST ends last Sunday in October
-    uint8_t last_sunday = 31 - (5 + year + year / 4) % 7;
-    return day < last_sunday;
-}
-
-bool is_dst_us(uint8_t month, uint8_t day, uint8_t year) {
-    if (month < 3 || month > 11) return false;
-    if (month > 3 && month < 11) return true;
-
-    // DST starts second Sunday in March
-    if (month == 3) {
-        uint8_t second_sunday = 14 - (1 + year + year / 4) % 7;
-        return day >= second_sunday;
-    }
-
-    // DST ends first Sunday in November
-    uint8_t first_sunday = 7 - (1 + year + year / 4) % 7;
-    return day < first_sunday;
-}
-
-// Utility Functions
-uint8_t rtc_calculate_last_sunday(uint8_t month, uint8_t year) {
-    return days_in_month(month, year) - (5 + year + year / 4) % 7;
-}
-
-uint8_t rtc_calculate_nth_weekday(uint8_t month, uint8_t year, uint8_t n, uint8_t weekday) {
-    uint8_t first_day = day_of_week(1, month, year);
-    uint8_t offset = (weekday - first_day + 7) % 7;
-    return 1 + offset + (n - 1) * 7;
-}
-
-// Timezone Functions
-void rtc_adjust_timezone(struct rtc_date *date, int8_t offset) {
-    date->hour += offset;
-
-    // Handle overflow/underflow
-    if (date->hour >= 24) {
-        date->hour -= 24;
-        date->day++;
-    } else if (date->hour < 0) {
-        date->hour += 24;
-        date->day--;
-    }
+    return weekday_from_days(days_from_civil(year, month, day));
 }
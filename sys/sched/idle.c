@@ -0,0 +1,53 @@
+/**
+ * Idle work - Bunix OS
+ */
+
+#include "../../include/kernel/sched/idle.h"
+#include "../../include/kernel/time/hrtimer.h"
+#include "../../include/kernel/arch/x86/irq.h"
+#include "../../include/kernel/arch/x86/cpu.h"
+#include "../../include/lib/errno.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+static idle_work_t work_items[IDLE_MAX_WORK];
+static int num_work = 0;
+static bool in_idle = false;
+
+int idle_register(idle_work_t work) {
+    if (!work) return -EINVAL;
+    if (num_work >= IDLE_MAX_WORK) return -ENOSPC;
+    work_items[num_work++] = work;
+    return 0;
+}
+
+void idle_poll(void) {
+    // Work may itself wait on devices; don't recurse into it
+    if (in_idle) return;
+    in_idle = true;
+
+    // Nothing interrupts us when timers expire; catch up on them here
+    if (!hrtimer_can_wake()) hrtimer_run_expired();
+    for (int i = 0; i < num_work; i++) work_items[i]();
+    in_idle = false;
+}
+
+// Fires only to end a halt; idle_poll does the work afterwards
+static hrtimer_restart_t idle_wake(hrtimer_t* timer) {
+    (void)timer;
+    return HRTIMER_NORESTART;
+}
+
+static hrtimer_t housekeeping = { .function = idle_wake, .index = -1 };
+
+void idle_sleep(void) {
+    if (!hrtimer_can_wake()) return;
+
+    uint32_t flags = irq_save();
+    if (num_work && !hrtimer_active(&housekeeping)) {
+        hrtimer_start(&housekeeping, IDLE_HOUSEKEEPING_NS, HRTIMER_MODE_REL);
+    }
+    cpu_sleep();
+    irq_restore(flags);
+}
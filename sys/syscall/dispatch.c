@@ -0,0 +1,123 @@
+/**
+ * System call dispatch - Bunix OS
+ *
+ * int 0x80 with the Linux i386 convention: EAX holds the call number,
+ * EBX, ECX and EDX the arguments, and the result (or -errno) goes back
+ * in EAX. The interrupt gate enters with interrupts off; they are turned
+ * back on if the caller had them, since socket calls wait on devices.
+ */
+
+#include "../../include/kernel/syscall/syscall.h"
+#include "../../include/kernel/arch/x86/idt.h"
+#include "../../include/kernel/arch/x86/cpu.h"
+#include "../../include/kernel/time/clocksource.h"
+#include "../../include/net/socket.h"
+#include "../../include/fs/vfs.h"
+#include "../../include/video/vga.h"
+#include "../../include/kernel/perf/trace.h"
+#include "../../include/lib/time.h"
+#include "../../include/lib/math64.h"
+#include "../../include/lib/errno.h"
+
+#define EFLAGS_IF (1 << 9)
+
+static int do_write(int fd, const void* buf, size_t count) {
+    if (fd == 1 || fd == 2) {
+        const char* s = buf;
+        for (size_t i = 0; i < count; i++) vga_putchar(s[i]);
+        return count;
+    }
+    if (socket_is_fd(fd)) return socket_sendto(fd, buf, count, 0, NULL, 0);
+    return vfs_write(fd, buf, count);
+}
+
+static int do_read(int fd, void* buf, size_t count) {
+    if (socket_is_fd(fd)) return socket_recvfrom(fd, buf, count, 0, NULL, NULL);
+    return vfs_read(fd, buf, count);
+}
+
+static int do_close(int fd) {
+    if (socket_is_fd(fd)) return socket_close(fd);
+    return vfs_close(fd);
+}
+
+static int do_clock_gettime(int clock, struct timespec* ts) {
+    uint64_t ns;
+    if (clock == CLOCK_MONOTONIC) ns = ktime_get_ns();
+    else if (clock == CLOCK_REALTIME) ns = ktime_get_real_ns();
+    else return -EINVAL;
+
+    uint32_t rem;
+    ts->tv_sec = (int32_t)div_u64_rem(ns, 1000000000, &rem);
+    ts->tv_nsec = (int32_t)rem;
+    return 0;
+}
+
+static int do_socketcall(int call, const uint32_t* a) {
+    switch (call) {
+    case SYS_SOCKET:
+        return socket_create(a[0], a[1], a[2]);
+    case SYS_BIND:
+        return socket_bind(a[0], (const struct sockaddr*)a[1], a[2]);
+    case SYS_CONNECT:
+        return socket_connect(a[0], (const struct sockaddr*)a[1], a[2]);
+    case SYS_LISTEN:
+        return socket_listen(a[0], a[1]);
+    case SYS_ACCEPT:
+        return socket_accept(a[0], (struct sockaddr*)a[1], (socklen_t*)a[2]);
+    case SYS_GETSOCKNAME:
+        return socket_getsockname(a[0], (struct sockaddr*)a[1], (socklen_t*)a[2]);
+    case SYS_SEND:
+        return socket_sendto(a[0], (const void*)a[1], a[2], a[3], NULL, 0);
+    case SYS_RECV:
+        return socket_recvfrom(a[0], (void*)a[1], a[2], a[3], NULL, NULL);
+    case SYS_SENDTO:
+        return socket_sendto(a[0], (const void*)a[1], a[2], a[3], (const struct sockaddr*)a[4], a[5]);
+    case SYS_RECVFROM:
+        return socket_recvfrom(a[0], (void*)a[1], a[2], a[3], (struct sockaddr*)a[4], (socklen_t*)a[5]);
+    case SYS_SHUTDOWN:
+        return socket_shutdown(a[0], a[1]);
+    case SYS_SETSOCKOPT:
+        return socket_setsockopt(a[0], a[1], a[2], (const void*)a[3], a[4]);
+    case SYS_GETSOCKOPT:
+        return socket_getsockopt(a[0], a[1], a[2], (void*)a[3], (socklen_t*)a[4]);
+    }
+    return -EINVAL;
+}
+
+static void syscall_handler(interrupt_frame_t* frame) {
+    int ret;
+
+    TRACE(TRACE_SYS_ENTER, frame->eax, frame->ebx, frame->ecx);
+    if (frame->eflags & EFLAGS_IF) cpu_enable_interrupts();
+
+    switch (frame->eax) {
+    case SYS_READ:
+        ret = do_read(frame->ebx, (void*)frame->ecx, frame->edx);
+        break;
+    case SYS_WRITE:
+        ret = do_write(frame->ebx, (const void*)frame->ecx, frame->edx);
+        break;
+    case SYS_CLOSE:
+        ret = do_close(frame->ebx);
+        break;
+    case SYS_SOCKETCALL:
+        ret = do_socketcall(frame->ebx, (const uint32_t*)frame->ecx);
+        break;
+    case SYS_CLOCK_GETTIME:
+        ret = do_clock_gettime(frame->ebx, (struct timespec*)frame->ecx);
+        break;
+    default:
+        ret = -ENOSYS;              // Including exit: there are no processes
+        break;
+    }
+
+    TRACE(TRACE_SYS_EXIT, frame->eax, ret, 0);
+
+    // popa hands this back in EAX
+    frame->eax = ret;
+}
+
+void syscall_init(void) {
+    idt_set_handler(SYSCALL_VECTOR, syscall_handler);
+}
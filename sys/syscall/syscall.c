@@ -16,6 +16,28 @@ int sys_write(int fd, const void *buf, size_t count) {
     return ret;
 }
 
+int sys_read(int fd, void *buf, size_t count) {
+    int ret;
+    __asm__ volatile (
+        "int $0x80"
+        : "=a" (ret)
+        : "a" (SYS_READ), "b" (fd), "c" (buf), "d" (count)
+        : "memory"
+    );
+    return ret;
+}
+
+int sys_close(int fd) {
+    int ret;
+    __asm__ volatile (
+        "int $0x80"
+        : "=a" (ret)
+        : "a" (SYS_CLOSE), "b" (fd)
+        : "memory"
+    );
+    return ret;
+}
+
 // Implementation of the sys_exit function
 void sys_exit(int status) {
     __asm__ volatile (
@@ -26,3 +48,83 @@ void sys_exit(int status) {
         : "memory"        // Clobbered memory
     );
 }
+
+int sys_clock_gettime(int clock, struct timespec *ts) {
+    int ret;
+    __asm__ volatile (
+        "int $0x80"
+        : "=a" (ret)
+        : "a" (SYS_CLOCK_GETTIME), "b" (clock), "c" (ts)
+        : "memory"
+    );
+    return ret;
+}
+
+// Every socket call goes through one system call, arguments in memory
+static int sys_socketcall(int call, uint32_t *args) {
+    int ret;
+    __asm__ volatile (
+        "int $0x80"
+        : "=a" (ret)
+        : "a" (SYS_SOCKETCALL), "b" (call), "c" (args)
+        : "memory"
+    );
+    return ret;
+}
+
+int sys_socket(int family, int type, int protocol) {
+    uint32_t args[3] = { family, type, protocol };
+    return sys_socketcall(SYS_SOCKET, args);
+}
+
+int sys_bind(int fd, const struct sockaddr *addr, uint32_t addrlen) {
+    uint32_t args[3] = { fd, (uint32_t)addr, addrlen };
+    return sys_socketcall(SYS_BIND, args);
+}
+
+int sys_connect(int fd, const struct sockaddr *addr, uint32_t addrlen) {
+    uint32_t args[3] = { fd, (uint32_t)addr, addrlen };
+    return sys_socketcall(SYS_CONNECT, args);
+}
+
+int sys_listen(int fd, int backlog) {
+    uint32_t args[2] = { fd, backlog };
+    return sys_socketcall(SYS_LISTEN, args);
+}
+
+int sys_accept(int fd, struct sockaddr *addr, uint32_t *addrlen) {
+    uint32_t args[3] = { fd, (uint32_t)addr, (uint32_t)addrlen };
+    return sys_socketcall(SYS_ACCEPT, args);
+}
+
+int sys_send(int fd, const void *buf, size_t len, int flags) {
+    uint32_t args[4] = { fd, (uint32_t)buf, len, flags };
+    return sys_socketcall(SYS_SEND, args);
+}
+
+int sys_recv(int fd, void *buf, size_t len, int flags) {
+    uint32_t args[4] = { fd, (uint32_t)buf, len, flags };
+    return sys_socketcall(SYS_RECV, args);
+}
+
+int sys_sendto(int fd, const void *buf, size_t len, int flags,
+               const struct sockaddr *addr, uint32_t addrlen) {
+    uint32_t args[6] = { fd, (uint32_t)buf, len, flags, (uint32_t)addr, addrlen };
+    return sys_socketcall(SYS_SENDTO, args);
+}
+
+int sys_recvfrom(int fd, void *buf, size_t len, int flags,
+                 struct sockaddr *addr, uint32_t *addrlen) {
+    uint32_t args[6] = { fd, (uint32_t)buf, len, flags, (uint32_t)addr, (uint32_t)addrlen };
+    return sys_socketcall(SYS_RECVFROM, args);
+}
+
+int sys_shutdown(int fd, int how) {
+    uint32_t args[2] = { fd, how };
+    return sys_socketcall(SYS_SHUTDOWN, args);
+}
+
+int sys_setsockopt(int fd, int level, int name, const void *val, uint32_t len) {
+    uint32_t args[5] = { fd, level, name, (uint32_t)val, len };
+    return sys_socketcall(SYS_SETSOCKOPT, args);
+}
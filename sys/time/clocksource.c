@@ -0,0 +1,297 @@
+/**
+ * Clock sources and timekeeping - Bunix OS
+ *
+ * Keeps the list of counters, picks the one timekeeping reads, and turns
+ * its cycles into a monotonic nanosecond clock. The current source is
+ * read on every ktime_get_ns; a base of nanoseconds at a known cycle
+ * count is folded forward before the counter can wrap past it. Each new
+ * base is copied to the time page, where user code reads the clock too.
+ *
+ * The watchdog runs from idle time. Every half second it reads the
+ * source under suspicion (the TSC) and a trusted one (HPET, else the
+ * ACPI PM timer) back to back and compares how far each moved. A TSC
+ * that keeps disagreeing is marked unstable and timekeeping moves off it.
+ */
+
+#include "../../include/kernel/time/clocksource.h"
+#include "../../include/kernel/time/vdso.h"
+#include "../../include/kernel/arch/x86/timer.h"
+#include "../../include/kernel/arch/x86/irq.h"
+#include "../../include/kernel/panic/debug.h"
+#include "../../include/kernel/sched/idle.h"
+#include "../../include/lib/string.h"
+#include "../../include/lib/errno.h"
+
+#define NSEC_PER_SEC            1000000000ull
+#define READ_COST_SAMPLES       256
+
+#define WATCHDOG_INTERVAL_NS    500000000ull
+#define WATCHDOG_SLACK_NS       500000      // A vCPU preempted between the reads
+#define WATCHDOG_PPM_SHIFT      10          // Plus ~1000 ppm of the interval
+#define WATCHDOG_STRIKES        3           // Consecutive failures to demote
+
+static clocksource_t* sources[CLOCKSOURCE_MAX];
+static size_t source_count;
+
+// Timekeeping: base_ns was the time when 'current' read cycle_last
+static clocksource_t* current;
+static uint64_t cycle_last;
+static uint64_t base_ns;
+static uint64_t last_ns;
+static uint64_t wall_offset_ns;
+
+static clocksource_watchdog_t wd;
+static uint64_t wd_ref_last, wd_cs_last;
+static uint64_t wd_ref_wrap_ns;
+static uint64_t wd_next_ns;
+static bool wd_primed;
+static int wd_strikes;
+static int64_t wd_max_mag;
+
+// Largest shift whose multiplier still fits 32 bits: the most precision
+// mul_u64_u32_shr can carry
+static void calc_mult_shift(clocksource_t* cs) {
+    for (uint32_t shift = 31; shift > 0; shift--) {
+        uint64_t mult = div64_u64((NSEC_PER_SEC << shift) + cs->freq_hz / 2, cs->freq_hz);
+        if (mult <= 0xFFFFFFFF) {
+            cs->mult = (uint32_t)mult;
+            cs->shift = shift;
+            return;
+        }
+    }
+}
+
+int clocksource_register(clocksource_t* cs) {
+    if (!cs->read || !cs->freq_hz) return -EINVAL;
+    if (source_count == CLOCKSOURCE_MAX) return -ENOSPC;
+    calc_mult_shift(cs);
+    sources[source_count++] = cs;
+    return 0;
+}
+
+size_t clocksource_count(void) {
+    return source_count;
+}
+
+clocksource_t* clocksource_get(size_t index) {
+    return index < source_count ? sources[index] : NULL;
+}
+
+clocksource_t* clocksource_find(const char* name) {
+    for (size_t i = 0; i < source_count; i++) {
+        if (strcmp(sources[i]->name, name) == 0) return sources[i];
+    }
+    return NULL;
+}
+
+clocksource_t* clocksource_current(void) {
+    return current;
+}
+
+// Copy the base out to the time page. Interrupts must be off.
+static void timekeeping_publish(void) {
+    vdso_update(current, cycle_last, base_ns, wall_offset_ns);
+}
+
+// Move base_ns up to now. Interrupts must be off.
+static void timekeeping_fold(void) {
+    uint64_t now = current->read();
+    base_ns += clocksource_cyc2ns(current, (now - cycle_last) & current->mask);
+    cycle_last = now;
+    timekeeping_publish();
+}
+
+static void timekeeping_switch(clocksource_t* cs) {
+    uint32_t flags = irq_save();
+    if (current) timekeeping_fold();
+    current = cs;
+    cycle_last = cs->read();
+    timekeeping_publish();
+    irq_restore(flags);
+}
+
+uint64_t ktime_get_ns(void) {
+    uint32_t flags = irq_save();
+    uint64_t ns = 0;
+    if (current) {
+        uint64_t delta = (current->read() - cycle_last) & current->mask;
+        ns = base_ns + clocksource_cyc2ns(current, delta);
+        if (delta > current->mask >> 1) {
+            base_ns = ns;
+            cycle_last = (cycle_last + delta) & current->mask;
+            timekeeping_publish();
+        }
+
+        // Truncation at a fold or a change of source can lose a
+        // nanosecond; never let that show as time going backwards
+        if (ns < last_ns) ns = last_ns;
+        last_ns = ns;
+    }
+    irq_restore(flags);
+    return ns;
+}
+
+void timekeeping_set_wall(uint64_t real_ns, uint64_t mono_ns) {
+    uint32_t flags = irq_save();
+    wall_offset_ns = real_ns - mono_ns;
+    if (current) timekeeping_publish();
+    irq_restore(flags);
+}
+
+uint64_t ktime_get_real_ns(void) {
+    uint32_t flags = irq_save();
+    uint64_t ns = ktime_get_ns() + wall_offset_ns;
+    irq_restore(flags);
+    return ns;
+}
+
+uint64_t ktime_mono_to_real(uint64_t mono_ns) {
+    uint32_t flags = irq_save();
+    uint64_t ns = mono_ns + wall_offset_ns;
+    irq_restore(flags);
+    return ns;
+}
+
+uint32_t ktime_get_real_seconds(void) {
+    return (uint32_t)div_u64(ktime_get_real_ns(), NSEC_PER_SEC);
+}
+
+// The cheapest good source; failing that, the best rated one left
+static clocksource_t* best_source(void) {
+    clocksource_t* best = NULL;
+    for (size_t i = 0; i < source_count; i++) {
+        clocksource_t* cs = sources[i];
+        if ((cs->flags & CLOCK_SOURCE_UNSTABLE) || cs->rating < CLOCKSOURCE_RATING_GOOD) continue;
+        if (!best || cs->read_ns < best->read_ns || (cs->read_ns == best->read_ns && cs->rating > best->rating)) {
+            best = cs;
+        }
+    }
+    if (best) return best;
+
+    for (size_t i = 0; i < source_count; i++) {
+        clocksource_t* cs = sources[i];
+        if (cs->flags & CLOCK_SOURCE_UNSTABLE) continue;
+        if (!best || cs->rating > best->rating) best = cs;
+    }
+    return best;
+}
+
+int clocksource_select(const char* name) {
+    clocksource_t* cs = clocksource_find(name);
+    if (!cs) return -ENODEV;
+    if (cs != current) timekeeping_switch(cs);
+    return 0;
+}
+
+static void watchdog_demote(clocksource_t* cs, uint64_t skew_ns) {
+    cs->flags |= CLOCK_SOURCE_UNSTABLE;
+    DEBUG_WARN("clocksource: %s is off by %d us against %s, marked unstable",
+               cs->name, (int)div_u64(skew_ns, 1000), wd.reference->name);
+    if (cs == current) {
+        clocksource_t* next = best_source();
+        if (next) {
+            timekeeping_switch(next);
+            DEBUG_WARN("clocksource: switched to %s", next->name);
+        }
+    }
+}
+
+static void clocksource_watchdog(void) {
+    uint64_t now = ktime_get_ns();
+    if (now < wd_next_ns) return;
+    wd_next_ns = now + WATCHDOG_INTERVAL_NS;
+
+    // Keep the fold well inside the wrap of a narrow counter
+    uint32_t flags = irq_save();
+    timekeeping_fold();
+    irq_restore(flags);
+
+    clocksource_t* cs = wd.checked;
+    clocksource_t* ref = wd.reference;
+    if (cs->flags & CLOCK_SOURCE_UNSTABLE) return;
+
+    flags = irq_save();
+    uint64_t ref_now = ref->read();
+    uint64_t cs_now = cs->read();
+    irq_restore(flags);
+
+    uint64_t ref_ns = clocksource_cyc2ns(ref, (ref_now - wd_ref_last) & ref->mask);
+    uint64_t cs_ns = clocksource_cyc2ns(cs, (cs_now - wd_cs_last) & cs->mask);
+    wd_ref_last = ref_now;
+    wd_cs_last = cs_now;
+    if (!wd_primed) {
+        wd_primed = true;
+        return;
+    }
+
+    // Idle work was held off long enough for the reference to wrap; the
+    // interval says nothing
+    if (cs_ns > wd_ref_wrap_ns / 2) return;
+
+    int64_t skew = (int64_t)(cs_ns - ref_ns);
+    int64_t mag = skew < 0 ? -skew : skew;
+    wd.checks++;
+    wd.last_skew_ns = skew;
+    if (mag > wd_max_mag) {
+        wd_max_mag = mag;
+        wd.max_skew_ns = skew;
+    }
+
+    if ((uint64_t)mag <= WATCHDOG_SLACK_NS + (ref_ns >> WATCHDOG_PPM_SHIFT)) {
+        wd_strikes = 0;
+    } else if (++wd_strikes == WATCHDOG_STRIKES) {
+        watchdog_demote(cs, mag);
+    }
+}
+
+void clocksource_watchdog_stats(clocksource_watchdog_t* out) {
+    *out = wd;
+}
+
+// Average cost of one read, timed with 'clock'
+static uint32_t measure_read_ns(clocksource_t* cs, clocksource_t* clock) {
+    uint32_t flags = irq_save();
+    cs->read();
+    uint64_t start = clock->read();
+    for (int i = 0; i < READ_COST_SAMPLES; i++) cs->read();
+    uint64_t end = clock->read();
+    irq_restore(flags);
+    return (uint32_t)div_u64(clocksource_cyc2ns(clock, (end - start) & clock->mask), READ_COST_SAMPLES);
+}
+
+static clocksource_t* highest_rated(uint32_t need_flags) {
+    clocksource_t* best = NULL;
+    for (size_t i = 0; i < source_count; i++) {
+        clocksource_t* cs = sources[i];
+        if ((cs->flags & need_flags) != need_flags) continue;
+        if (!best || cs->rating > best->rating) best = cs;
+    }
+    return best;
+}
+
+void clocksource_init(void) {
+    pit_clocksource_init();
+    acpi_pm_clocksource_init();
+    hpet_clocksource_init();
+
+    // The TSC is timed against the best of the others, and then times them
+    clocksource_t* ref = highest_rated(0);
+    tsc_clocksource_init(ref);
+    clocksource_t* tsc = clocksource_find("tsc");
+    clocksource_t* clock = tsc ? tsc : ref;
+    if (!clock) return;
+
+    for (size_t i = 0; i < source_count; i++) {
+        sources[i]->read_ns = measure_read_ns(sources[i], clock);
+    }
+    timekeeping_switch(best_source());
+
+    wd.checked = highest_rated(CLOCK_SOURCE_MUST_VERIFY);
+    wd.reference = highest_rated(CLOCK_SOURCE_WATCHDOG);
+    if (wd.checked && wd.reference) {
+        wd_ref_wrap_ns = clocksource_cyc2ns(wd.reference, wd.reference->mask);
+        idle_register(clocksource_watchdog);
+    } else {
+        wd.checked = NULL;
+    }
+}
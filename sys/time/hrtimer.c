@@ -0,0 +1,222 @@
+/**
+ * High-resolution timers - Bunix OS
+ *
+ * One min-heap of pending timers per CPU (there is one CPU), keyed by
+ * expiry. Only the heap's head is ever armed in hardware, so an idle
+ * machine with nothing pending takes no timer interrupts at all.
+ *
+ * The local APIC timer is the event device. With TSC-deadline mode the
+ * expiry goes in as an absolute TSC value; otherwise the one-shot
+ * countdown is loaded with the distance, converted at its calibrated
+ * rate. Either way the hardware is never armed more than a second out,
+ * so rounding and drift against ktime stay small, and an interrupt that
+ * lands a little early just rearms for the remainder.
+ */
+
+#include "../../include/kernel/time/hrtimer.h"
+#include "../../include/kernel/time/clocksource.h"
+#include "../../include/kernel/arch/x86/apic.h"
+#include "../../include/kernel/arch/x86/cpu.h"
+#include "../../include/kernel/arch/x86/irq.h"
+#include "../../include/lib/math64.h"
+#include "../../include/lib/errno.h"
+
+#define HRTIMER_MAX_PROGRAM_NS  1000000000ull
+
+typedef struct {
+    hrtimer_t* heap[HRTIMER_HEAP_MAX];
+    uint32_t count;
+    uint64_t armed;               // Expiry the hardware is set for, 0 if none
+    hrtimer_stats_t stats;
+} hrtimer_base_t;
+
+static hrtimer_base_t bases[1];
+static bool have_hardware;
+static bool tsc_deadline;
+static uint32_t tsc_khz;
+
+static hrtimer_base_t* this_base(void) {
+    return &bases[0];
+}
+
+static void heap_set(hrtimer_base_t* base, uint32_t i, hrtimer_t* timer) {
+    base->heap[i] = timer;
+    timer->index = i;
+}
+
+static void sift_up(hrtimer_base_t* base, uint32_t i) {
+    hrtimer_t* timer = base->heap[i];
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (base->heap[parent]->expires <= timer->expires) break;
+        heap_set(base, i, base->heap[parent]);
+        i = parent;
+    }
+    heap_set(base, i, timer);
+}
+
+static void sift_down(hrtimer_base_t* base, uint32_t i) {
+    hrtimer_t* timer = base->heap[i];
+    for (;;) {
+        uint32_t child = i * 2 + 1;
+        if (child >= base->count) break;
+        if (child + 1 < base->count && base->heap[child + 1]->expires < base->heap[child]->expires) child++;
+        if (timer->expires <= base->heap[child]->expires) break;
+        heap_set(base, i, base->heap[child]);
+        i = child;
+    }
+    heap_set(base, i, timer);
+}
+
+static int heap_insert(hrtimer_base_t* base, hrtimer_t* timer) {
+    if (base->count == HRTIMER_HEAP_MAX) return -ENOSPC;
+    heap_set(base, base->count++, timer);
+    sift_up(base, timer->index);
+    return 0;
+}
+
+static void heap_remove(hrtimer_base_t* base, hrtimer_t* timer) {
+    uint32_t i = timer->index;
+    hrtimer_t* last = base->heap[--base->count];
+    timer->index = -1;
+    if (last == timer) return;
+
+    heap_set(base, i, last);
+    if (i > 0 && base->heap[(i - 1) / 2]->expires > last->expires) sift_up(base, i);
+    else sift_down(base, i);
+}
+
+// Arm the hardware for the head of the heap, or disarm it
+static void hrtimer_program(hrtimer_base_t* base) {
+    if (!have_hardware) return;
+
+    if (!base->count) {
+        if (base->armed) {
+            if (tsc_deadline) lapic_timer_arm_deadline(0);
+            else lapic_timer_arm(0);
+            base->armed = 0;
+        }
+        return;
+    }
+
+    uint64_t expires = base->heap[0]->expires;
+    if (expires == base->armed) return;
+
+    uint64_t now = ktime_get_ns();
+    uint64_t delta = expires > now ? expires - now : 0;
+    if (delta > HRTIMER_MAX_PROGRAM_NS) delta = HRTIMER_MAX_PROGRAM_NS;
+
+    if (tsc_deadline) {
+        lapic_timer_arm_deadline(cpu_rdtsc() + div_u64(delta * tsc_khz, 1000000) + 1);
+    } else {
+        uint32_t count = (uint32_t)div_u64(delta * base->stats.lapic_hz, 1000000000);
+        lapic_timer_arm(count ? count : 1);
+    }
+    base->armed = now + delta;
+    base->stats.programmed++;
+}
+
+void hrtimer_run_expired(void) {
+    hrtimer_base_t* base = this_base();
+    uint32_t flags = irq_save();
+
+    for (;;) {
+        uint64_t now = ktime_get_ns();
+        while (base->count && base->heap[0]->expires <= now) {
+            hrtimer_t* timer = base->heap[0];
+            heap_remove(base, timer);
+            base->stats.expired++;
+            if (timer->function(timer) == HRTIMER_RESTART) heap_insert(base, timer);
+        }
+        hrtimer_program(base);
+
+        // Callbacks take time too: go round again rather than arm for a
+        // moment that has already gone
+        if (!base->count || base->heap[0]->expires > ktime_get_ns()) break;
+    }
+
+    irq_restore(flags);
+}
+
+static void hrtimer_interrupt(void* ctx) {
+    hrtimer_base_t* base = ctx;
+    base->stats.interrupts++;
+    base->armed = 0;
+    hrtimer_run_expired();
+}
+
+bool hrtimers_init(void) {
+    hrtimer_base_t* base = this_base();
+    if (!lapic_available()) return false;
+
+    int vector = lapic_alloc_vector(hrtimer_interrupt, base);
+    if (vector < 0) return false;
+
+    clocksource_t* tsc = clocksource_find("tsc");
+    if (cpu_has(X86_FEATURE_TSC_DEADLINE) && tsc) {
+        tsc_deadline = true;
+        tsc_khz = (uint32_t)div_u64(tsc->freq_hz, 1000);
+        base->stats.mode = "tsc-deadline";
+    } else {
+        base->stats.lapic_hz = lapic_timer_frequency();
+        if (!base->stats.lapic_hz) {
+            lapic_free_vector(vector);
+            return false;
+        }
+        base->stats.mode = "lapic";
+    }
+
+    lapic_timer_init(vector, tsc_deadline);
+    have_hardware = true;
+    return true;
+}
+
+bool hrtimer_can_wake(void) {
+    return have_hardware;
+}
+
+void hrtimer_init(hrtimer_t* timer, hrtimer_restart_t (*function)(hrtimer_t*), void* ctx) {
+    timer->expires = 0;
+    timer->function = function;
+    timer->ctx = ctx;
+    timer->index = -1;
+}
+
+int hrtimer_start(hrtimer_t* timer, uint64_t expires, hrtimer_mode_t mode) {
+    hrtimer_base_t* base = this_base();
+    if (mode == HRTIMER_MODE_REL) expires += ktime_get_ns();
+
+    uint32_t flags = irq_save();
+    if (hrtimer_active(timer)) heap_remove(base, timer);
+    timer->expires = expires;
+    int err = heap_insert(base, timer);
+    if (!err && base->heap[0] == timer) hrtimer_program(base);
+    irq_restore(flags);
+    return err;
+}
+
+bool hrtimer_cancel(hrtimer_t* timer) {
+    hrtimer_base_t* base = this_base();
+    uint32_t flags = irq_save();
+    bool was_active = hrtimer_active(timer);
+    if (was_active) {
+        bool was_first = base->heap[0] == timer;
+        heap_remove(base, timer);
+        if (was_first) hrtimer_program(base);
+    }
+    irq_restore(flags);
+    return was_active;
+}
+
+uint32_t hrtimer_forward(hrtimer_t* timer, uint64_t now, uint64_t interval) {
+    if (now < timer->expires || !interval) return 0;
+    uint64_t steps = div64_u64(now - timer->expires, interval) + 1;
+    timer->expires += steps * interval;
+    return (uint32_t)steps;
+}
+
+void hrtimer_get_stats(hrtimer_stats_t* out) {
+    hrtimer_base_t* base = this_base();
+    *out = base->stats;
+    out->pending = base->count;
+}
@@ -0,0 +1,38 @@
+/**
+ * Time page - Bunix OS
+ *
+ * The page is a static object padded out to a page of its own, so that
+ * once processes have address spaces it can be mapped into each of them
+ * read-only without exposing anything next to it. Only timekeeping
+ * writes it, always with interrupts off, so on one CPU a reader can see
+ * an odd sequence only if it was itself interrupted mid-copy; the second
+ * sequence read catches that.
+ */
+
+#include "../../include/kernel/time/vdso.h"
+#include "../../include/mm/vmm.h"
+
+static union {
+    vdso_time_t time;
+    uint8_t page[PAGE_SIZE];
+} vdso_page __attribute__((aligned(PAGE_SIZE)));
+
+// What user code links against: the page, as the mapping would show it
+extern const vdso_time_t vdso_time_page __attribute__((alias("vdso_page")));
+
+#define barrier() __asm__ volatile("" ::: "memory")
+
+void vdso_update(const clocksource_t* cs, uint64_t cycle_last, uint64_t mono_ns, uint64_t wall_offset_ns) {
+    vdso_time_t* t = &vdso_page.time;
+
+    t->seq++;
+    barrier();
+    t->mode = (cs && (cs->flags & CLOCK_SOURCE_VDSO)) ? VDSO_CLOCK_TSC : VDSO_CLOCK_NONE;
+    t->cycle_last = cycle_last;
+    t->mono_ns = mono_ns;
+    t->wall_offset_ns = wall_offset_ns;
+    t->mult = cs ? cs->mult : 0;
+    t->shift = cs ? cs->shift : 0;
+    barrier();
+    t->seq++;
+}